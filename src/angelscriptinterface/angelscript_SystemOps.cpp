@@ -55,6 +55,18 @@ namespace angelscript
             asCALL_GENERIC);
         check_register_rc(rc, __LINE__, result);
 
+        rc = engine.RegisterGlobalFunction(
+            "bool start_database_backup()",
+            asFUNCTION(start_database_backup),
+            asCALL_GENERIC);
+        check_register_rc(rc, __LINE__, result);
+
+        rc = engine.RegisterGlobalFunction(
+            "array<string> @get_formatted_backup_status()",
+            asFUNCTION(get_formatted_backup_status),
+            asCALL_GENERIC);
+        check_register_rc(rc, __LINE__, result);
+
         rc = engine.RegisterGlobalFunction(
             "Entity@ get_me()",
             asFUNCTION(get_me),
@@ -146,6 +158,112 @@ namespace angelscript
         *(CScriptArray **)gen_ptr->GetAddressOfReturnLocation() = result_ptr;
     }
 
+    // ----------------------------------------------------------------------
+    void SystemOps::start_database_backup(asIScriptGeneric *gen_ptr)
+    {
+        if (not gen_ptr)
+        {
+            LOG(fatal, "angelscript", "start_database_backup",
+                "gen_ptr is null");
+            return;
+        }
+
+        asIScriptEngine * const engine_ptr = gen_ptr->GetEngine();
+
+        // What will be our return value.
+        //
+        bool started = false;
+
+        try
+        {
+            const primitives::Result prim_result =
+                primitives::PrimitivesAccess::instance()->
+                    system_prims().start_database_backup(
+                        *ScriptUtilities::get_my_security_context(engine_ptr));
+
+            if (prim_result.is_security_violation())
+            {
+                throw AngelException(
+                    "",
+                    prim_result,
+                    AS_OBJECT_TYPE_NAME,
+                    "start_database_backup()");
+            }
+
+            started = prim_result.is_success();
+        }
+        catch (std::exception &ex)
+        {
+            ScriptUtilities::set_exception_info(engine_ptr, ex);
+            throw;
+        }
+        catch (...)
+        {
+            ScriptUtilities::set_exception_info(engine_ptr);
+            throw;
+        }
+
+        // Return the result
+        *(bool *)gen_ptr->GetAddressOfReturnLocation() = started;
+    }
+
+    // ----------------------------------------------------------------------
+    void SystemOps::get_formatted_backup_status(asIScriptGeneric *gen_ptr)
+    {
+        if (not gen_ptr)
+        {
+            LOG(fatal, "angelscript", "get_formatted_backup_status",
+                "gen_ptr is null");
+            return;
+        }
+
+        asIScriptEngine * const engine_ptr = gen_ptr->GetEngine();
+
+        // What will be our return value.
+        //
+        CScriptArray *result_ptr = 0;
+
+        try
+        {
+            std::string raw_output;
+
+            const primitives::Result prim_result =
+                primitives::PrimitivesAccess::instance()->
+                    system_prims().get_formatted_backup_status(
+                        *ScriptUtilities::get_my_security_context(engine_ptr),
+                        raw_output);
+
+            if (not prim_result.is_success())
+            {
+                throw AngelException(
+                    "",
+                    prim_result,
+                    AS_OBJECT_TYPE_NAME,
+                    "get_formatted_backup_status()");
+            }
+            else
+            {
+                result_ptr = ScriptUtilities::multiline_string_to_array(
+                    engine_ptr,
+                    raw_output,
+                    true);
+            }
+        }
+        catch (std::exception &ex)
+        {
+            ScriptUtilities::set_exception_info(engine_ptr, ex);
+            throw;
+        }
+        catch (...)
+        {
+            ScriptUtilities::set_exception_info(engine_ptr);
+            throw;
+        }
+
+        // Return the result
+        *(CScriptArray **)gen_ptr->GetAddressOfReturnLocation() = result_ptr;
+    }
+
     // ----------------------------------------------------------------------
     void SystemOps::get_online_players(asIScriptGeneric *gen_ptr)
     {
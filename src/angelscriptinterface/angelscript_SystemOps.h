@@ -50,6 +50,34 @@ namespace angelscript
          */
         static void get_formatted_processes(asIScriptGeneric *gen_ptr);
 
+        /**
+         * Using generic interface to get needed engine pointer.
+         *
+         * Actual method signature:
+         * bool start_database_backup(void);
+         * @param gen_ptr[in] Generic interface to get and set arguments and
+         * return value.
+         * @return True if the backup was started, false if it could not be
+         * (for instance, one is already running).
+         * @see primitives::SystemPrims::start_database_backup() for
+         * documentation.
+         */
+        static void start_database_backup(asIScriptGeneric *gen_ptr);
+
+        /**
+         * Using generic interface to get needed engine pointer.
+         *
+         * Actual method signature:
+         * CScriptArray *get_formatted_backup_status(void);
+         * @param gen_ptr[in] Generic interface to get and set arguments and
+         * return value.
+         * @return The status of the current or most recent database
+         * backup, formatted as an array of lines.
+         * @see primitives::SystemPrims::get_formatted_backup_status() for
+         * documentation.
+         */
+        static void get_formatted_backup_status(asIScriptGeneric *gen_ptr);
+
         /**
          * Using generic interface to get needed engine pointer.
          *
@@ -38,7 +38,8 @@ namespace dbdump
         current_site_id(0),
         site_valid(false),
         mode(NORMAL),
-        temp_ser_id_name(0)
+        temp_ser_id_name(0),
+        entities_created(0)
     {
         db->startup();
     }
@@ -55,6 +56,34 @@ namespace dbdump
         db->destroy_singleton();
     }
 
+    // ----------------------------------------------------------------------
+    bool DumpReaderInterface::begin_bulk_load(void)
+    {
+        const bool result = db->begin_bulk_load();
+
+        if (not result)
+        {
+            LOG(error, "dbdump", "begin_bulk_load",
+                "Unable to enter bulk load mode.");
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DumpReaderInterface::end_bulk_load(void)
+    {
+        const bool result = db->end_bulk_load();
+
+        if (not result)
+        {
+            LOG(error, "dbdump", "end_bulk_load",
+                "Unable to complete bulk load.");
+        }
+
+        return result;
+    }
+
     // ----------------------------------------------------------------------
     void DumpReaderInterface::set_error(void)
     {
@@ -208,6 +237,7 @@ namespace dbdump
             {
                 // All set!
                 result = current_entity.id();
+                ++entities_created;
 
                 LOG(debug, "dbdump", "make_entity", "Created Entity "
                     + result.to_string(true) + " of type "
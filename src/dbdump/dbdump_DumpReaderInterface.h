@@ -75,6 +75,27 @@ namespace dbdump
         dbinterface::DatabaseAccess *get_dbinterface(void) const
           { return db; }
 
+        /**
+         * Puts the database into bulk load mode, which is much faster when
+         * loading a large dump.  Should be called before anything else.
+         * @return True if bulk load mode was entered.
+         * @see dbinterface::DatabaseAccess::begin_bulk_load()
+         */
+        bool begin_bulk_load(void);
+
+        /**
+         * Ends bulk load mode, finishing all deferred work.  This can
+         * take a while for a large dump.
+         * @return True if success.
+         */
+        bool end_bulk_load(void);
+
+        /**
+         * @return How many Entities have been created so far.
+         */
+        MG_LongUnsignedInt get_entities_created(void) const
+          { return entities_created; }
+
         /**
          * Indicates the underlying parser found an error.  Clear any
          * references to pointers that may be deleted to avoid coredumps.
@@ -412,6 +433,7 @@ namespace dbdump
         SetMode mode; ///< The current 'set mode' for the Entity.
         dbtype::PropertyDirectory::PathString current_application; ///< Application being worked on for security
         MG_LongUnsignedInt temp_ser_id_name; ///< Serial number that can be used for temp names, etc.
+        MG_LongUnsignedInt entities_created; ///< How many Entities were made
     };
 }
 }
@@ -4,6 +4,7 @@
 
 #include <stddef.h>
 #include <fstream>
+#include <chrono>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 #include "text/text_StringConversion.h"
@@ -39,8 +40,11 @@ namespace dbdump
     // ----------------------------------------------------------------------
     MutgosDumpFileReader::MutgosDumpFileReader(
         const std::string &file_name,
-        const std::string &base_path)
-      : error_condition(false),
+        const std::string &base_path,
+        const bool bulk)
+      : bulk_load(bulk),
+        parse_seconds(0),
+        error_condition(false),
         file_parsed(false),
         parser_mode(MutgosDumpFileReader::PARSER_NONE),
         subparser_mode(MutgosDumpFileReader::SUBPARSER_NONE),
@@ -87,7 +91,10 @@ namespace dbdump
     // ----------------------------------------------------------------------
     bool MutgosDumpFileReader::parse(std::string &message)
     {
+        const std::chrono::steady_clock::time_point start_time =
+            std::chrono::steady_clock::now();
         bool result = true;
+        bool bulk_load_started = false;
         message.clear();
 
         if (error_condition)
@@ -101,6 +108,16 @@ namespace dbdump
             FileStream *file  = file_stack.back();
             std::string line;
 
+            if (bulk_load)
+            {
+                bulk_load_started = db.begin_bulk_load();
+
+                if (not bulk_load_started)
+                {
+                    set_error("Unable to enter bulk load mode.");
+                }
+            }
+
             // Confirm version
             //
             file->increment_line();
@@ -202,6 +219,19 @@ namespace dbdump
             }
         }
 
+        // Whatever was loaded is kept even if there was an error, just as
+        // when not bulk loading.
+        //
+        if (bulk_load_started and (not db.end_bulk_load()) and result)
+        {
+            result = false;
+            message = "Unable to complete bulk load.";
+        }
+
+        parse_seconds = std::chrono::duration_cast<
+            std::chrono::duration<double> >(
+                std::chrono::steady_clock::now() - start_time).count();
+
         return result;
     }
 
@@ -32,10 +32,15 @@ namespace dbdump
          * @param file_name[in] The file to parse.
          * @param base_path[in] The base path for includes (generally the
          * same directory as the dump file).
+         * @param bulk[in] True to load the dump in bulk load mode, which
+         * is much faster for large dumps.  Nothing else may use the
+         * database while parsing.
+         * @see dbinterface::DatabaseAccess::begin_bulk_load()
          */
         MutgosDumpFileReader(
             const std::string &file_name,
-            const std::string &base_path);
+            const std::string &base_path,
+            const bool bulk = false);
 
         /**
          * Destructor.
@@ -75,6 +80,19 @@ namespace dbdump
          */
         std::string get_prev_file(void) const;
 
+        /**
+         * @return How many Entities have been created so far.
+         */
+        MG_LongUnsignedInt get_entities_created(void) const
+          { return db.get_entities_created(); }
+
+        /**
+         * @return How long parse() took, in seconds, including finishing
+         * a bulk load.  0 if not yet parsed.
+         */
+        double get_parse_seconds(void) const
+          { return parse_seconds; }
+
     private:
 
         /**
@@ -326,6 +344,8 @@ namespace dbdump
         /** Maps dynamic variable name to ID */
         typedef std::map<std::string, dbtype::Id> VariableMap;
 
+        const bool bulk_load;  // True if parsing in bulk load mode
+        double parse_seconds;  // How long parse() took
         bool error_condition;  // True if error and parser needs to stop
         bool file_parsed;       // True if file completed parsing.
         std::string status_message; // Message to be passed back to class caller
@@ -0,0 +1,476 @@
+/*
+ * dbdump_MutgosDumpFileWriter.cpp
+ */
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/bind.hpp>
+
+#include "text/text_StringConversion.h"
+#include "logging/log_Logger.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+
+#include "dbdump_MutgosDumpFileWriter.h"
+#include "dbdump_SiteDumpWriter.h"
+
+namespace
+{
+    const std::string DUMP_VERSION_LINE = "MUTGOS DUMP VERSION 1";
+    const std::string DUMP_END_LINE = "MUTGOS DUMP END";
+    const std::string MANIFEST_VERSION_LINE = "MUTGOS DUMP MANIFEST 1";
+    const std::string MANIFEST_SITE = "site";
+    const std::string MANIFEST_ENTITY = "entity";
+    const std::string SITE_FILE_SUFFIX = ".dump";
+}
+
+namespace mutgos
+{
+namespace dbdump
+{
+    // ----------------------------------------------------------------------
+    MutgosDumpFileWriter::MutgosDumpFileWriter(
+        const std::string &file_name,
+        const MG_UnsignedInt threads,
+        const std::string &previous_manifest_file,
+        const std::string &manifest_file)
+      : db(dbinterface::DatabaseAccess::make_singleton()),
+        main_file(file_name),
+        thread_count(threads ? threads : 1),
+        previous_manifest(previous_manifest_file),
+        manifest(manifest_file),
+        entities_written(0),
+        entities_unchanged(0),
+        write_seconds(0)
+    {
+        // Site files go next to the main file, and are named after it.
+        //
+        const size_t separator = main_file.rfind('/');
+
+        if (separator == std::string::npos)
+        {
+            base_path = ".";
+            file_stem = main_file;
+        }
+        else
+        {
+            base_path = main_file.substr(0, separator);
+            file_stem = main_file.substr(separator + 1);
+
+            if (base_path.empty())
+            {
+                base_path = "/";
+            }
+        }
+
+        const size_t extension = file_stem.rfind('.');
+
+        if ((extension != std::string::npos) and extension)
+        {
+            file_stem.erase(extension);
+        }
+
+        stamp = text::to_string((MG_LongUnsignedInt) std::time(0));
+
+        db->startup();
+    }
+
+    // ----------------------------------------------------------------------
+    MutgosDumpFileWriter::~MutgosDumpFileWriter()
+    {
+        db->destroy_singleton();
+    }
+
+    // ----------------------------------------------------------------------
+    bool MutgosDumpFileWriter::write(std::string &message)
+    {
+        const std::chrono::steady_clock::time_point start_time =
+            std::chrono::steady_clock::now();
+        bool success = true;
+
+        if (not previous_manifest.empty())
+        {
+            success = read_manifest(message);
+        }
+
+        if (success)
+        {
+            sites_to_write = db->get_all_site_ids();
+
+            // Threads take sites from the back; do them in order.
+            std::sort(sites_to_write.rbegin(), sites_to_write.rend());
+
+            boost::thread_group threads;
+
+            for (MG_UnsignedInt index = 0; index < thread_count; ++index)
+            {
+                threads.create_thread(
+                    boost::bind(&MutgosDumpFileWriter::write_sites, this));
+            }
+
+            threads.join_all();
+
+            if (not error_message.empty())
+            {
+                message = error_message;
+                success = false;
+            }
+        }
+
+        if (success)
+        {
+            success = write_main_file(message);
+        }
+
+        if (success and (not manifest.empty()))
+        {
+            success = write_manifest(message);
+        }
+
+        write_seconds = std::chrono::duration_cast<
+            std::chrono::duration<double> >(
+                std::chrono::steady_clock::now() - start_time).count();
+
+        if (success)
+        {
+            message = "Wrote " + text::to_string(site_files.size())
+                + " site(s) to " + main_file;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool MutgosDumpFileWriter::read_manifest(std::string &message)
+    {
+        std::ifstream input(previous_manifest.c_str());
+        std::string line;
+
+        if (not input.is_open())
+        {
+            message = "Unable to open previous manifest " + previous_manifest;
+            return false;
+        }
+
+        if ((not std::getline(input, line)) or (line != MANIFEST_VERSION_LINE))
+        {
+            message = "Previous manifest is not a manifest or has the wrong "
+                "version: " + previous_manifest;
+            return false;
+        }
+
+        while (std::getline(input, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+
+            std::istringstream line_stream(line);
+            std::string type;
+            dbtype::Id::SiteIdType site_id = 0;
+
+            line_stream >> type >> site_id;
+
+            if (line_stream.fail())
+            {
+                message = "Bad line in previous manifest: " + line;
+                return false;
+            }
+
+            if (type == MANIFEST_SITE)
+            {
+                FileList &files = previous_site_files[site_id];
+                std::string file;
+
+                while (line_stream >> file)
+                {
+                    files.push_back(file);
+                }
+            }
+            else if (type == MANIFEST_ENTITY)
+            {
+                dbtype::Id::EntityIdType entity_id = 0;
+                SiteDumpWriter::EntityFingerprint fingerprint;
+
+                line_stream >> entity_id >> fingerprint.first
+                    >> fingerprint.second;
+
+                if (line_stream.fail())
+                {
+                    message = "Bad entity in previous manifest: " + line;
+                    return false;
+                }
+
+                previous_fingerprints[dbtype::Id(site_id, entity_id)] =
+                    fingerprint;
+            }
+            else
+            {
+                message = "Unknown line in previous manifest: " + line;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool MutgosDumpFileWriter::write_manifest(std::string &message)
+    {
+        std::ofstream output(manifest.c_str(), std::ios::trunc);
+
+        if (not output.is_open())
+        {
+            message = "Unable to open manifest " + manifest;
+            return false;
+        }
+
+        output << MANIFEST_VERSION_LINE << std::endl;
+
+        for (SiteFiles::const_iterator site_iter = site_files.begin();
+            site_iter != site_files.end();
+            ++site_iter)
+        {
+            output << MANIFEST_SITE << " " << site_iter->first;
+
+            for (FileList::const_iterator file_iter = site_iter->second.begin();
+                file_iter != site_iter->second.end();
+                ++file_iter)
+            {
+                output << " " << *file_iter;
+            }
+
+            output << std::endl;
+        }
+
+        for (SiteDumpWriter::EntityFingerprints::const_iterator entity_iter =
+                fingerprints.begin();
+            entity_iter != fingerprints.end();
+            ++entity_iter)
+        {
+            output << MANIFEST_ENTITY << " "
+                   << entity_iter->first.get_site_id() << " "
+                   << entity_iter->first.get_entity_id() << " "
+                   << entity_iter->second.first << " "
+                   << entity_iter->second.second << std::endl;
+        }
+
+        output.flush();
+
+        if (not output.good())
+        {
+            message = "Unable to write manifest " + manifest;
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool MutgosDumpFileWriter::write_main_file(std::string &message)
+    {
+        std::ofstream output(main_file.c_str(), std::ios::trunc);
+
+        if (not output.is_open())
+        {
+            message = "Unable to open dump file " + main_file;
+            return false;
+        }
+
+        output << DUMP_VERSION_LINE << std::endl
+               << "# Written " << stamp << std::endl;
+
+        for (SiteFiles::const_iterator site_iter = site_files.begin();
+            site_iter != site_files.end();
+            ++site_iter)
+        {
+            output << std::endl;
+
+            for (FileList::const_iterator file_iter = site_iter->second.begin();
+                file_iter != site_iter->second.end();
+                ++file_iter)
+            {
+                output << "@@INCLUDE " << *file_iter << std::endl;
+            }
+
+            output << "end site" << std::endl;
+        }
+
+        output << std::endl << DUMP_END_LINE << std::endl;
+        output.flush();
+
+        if (not output.good())
+        {
+            message = "Unable to write dump file " + main_file;
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    void MutgosDumpFileWriter::write_sites(void)
+    {
+        while (true)
+        {
+            dbtype::Id::SiteIdType site_id = 0;
+
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+
+                if (sites_to_write.empty() or (not error_message.empty()))
+                {
+                    break;
+                }
+
+                site_id = sites_to_write.back();
+                sites_to_write.pop_back();
+            }
+
+            if (not write_site(site_id))
+            {
+                break;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool MutgosDumpFileWriter::write_site(const dbtype::Id::SiteIdType site_id)
+    {
+        const SiteFiles::const_iterator previous_iter =
+            previous_site_files.find(site_id);
+        const bool incremental = (previous_iter != previous_site_files.end());
+        const std::string file_name =
+            make_site_file_name(site_id, incremental);
+        const std::string file_path = base_path + "/" + file_name;
+        std::ofstream output(file_path.c_str(), std::ios::trunc);
+
+        if (not output.is_open())
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            set_error("Unable to open site file " + file_path);
+            return false;
+        }
+
+        if (incremental)
+        {
+            output << "# Changes to site " << site_id << " since the "
+                   << "previous export" << std::endl;
+        }
+        else
+        {
+            std::string site_name;
+            std::string site_description;
+
+            if ((db->get_site_name(site_id, site_name) !=
+                    dbinterface::DBRESULTCODE_OK) or
+                (db->get_site_description(site_id, site_description) !=
+                    dbinterface::DBRESULTCODE_OK))
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+                set_error("Unable to get information for site "
+                    + text::to_string(site_id));
+                return false;
+            }
+
+            output << "mksite " << site_name << std::endl;
+
+            if (not site_description.empty())
+            {
+                output << "setsitedesc " << site_description << std::endl;
+            }
+        }
+
+        SiteDumpWriter writer(
+            *db,
+            site_id,
+            output,
+            incremental ? &previous_fingerprints : 0);
+
+        const bool success = writer.write_entities();
+
+        output.close();
+
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        if (not success)
+        {
+            set_error("Unable to write site " + text::to_string(site_id)
+                + " to " + file_path);
+            return false;
+        }
+
+        FileList &files = site_files[site_id];
+
+        if (incremental)
+        {
+            files = previous_iter->second;
+
+            if (writer.get_entities_written())
+            {
+                files.push_back(file_name);
+            }
+            else
+            {
+                // Nothing changed; the file is not needed.
+                std::remove(file_path.c_str());
+            }
+        }
+        else
+        {
+            files.push_back(file_name);
+        }
+
+        fingerprints.insert(
+            writer.get_fingerprints().begin(),
+            writer.get_fingerprints().end());
+        entities_written += writer.get_entities_written();
+        entities_unchanged += writer.get_entities_unchanged();
+
+        LOG(info, "dbdump", "write_site",
+            "Wrote site " + text::to_string(site_id) + ": "
+            + text::to_string(writer.get_entities_written()) + " written, "
+            + text::to_string(writer.get_entities_unchanged()) + " unchanged, "
+            + text::to_string(writer.get_entities_deleted()) + " deleted.");
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string MutgosDumpFileWriter::make_site_file_name(
+        const dbtype::Id::SiteIdType site_id,
+        const bool incremental) const
+    {
+        std::string file_name =
+            file_stem + "_site" + text::to_string(site_id);
+
+        if (incremental)
+        {
+            file_name += "_" + stamp;
+        }
+
+        return file_name + SITE_FILE_SUFFIX;
+    }
+
+    // ----------------------------------------------------------------------
+    void MutgosDumpFileWriter::set_error(const std::string &message)
+    {
+        LOG(error, "dbdump", "set_error", message);
+
+        if (error_message.empty())
+        {
+            error_message = message;
+        }
+    }
+}
+}
@@ -0,0 +1,180 @@
+/*
+ * dbdump_MutgosDumpFileWriter.h
+ */
+
+#ifndef MUTGOS_DBDUMP_MUTGOSDUMPFILEWRITER_H
+#define MUTGOS_DBDUMP_MUTGOSDUMPFILEWRITER_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+
+#include "dbdump_SiteDumpWriter.h"
+
+namespace mutgos
+{
+namespace dbdump
+{
+    /**
+     * Writes the entire database out as a dump that MutgosDumpFileReader
+     * can read back in.  The main dump file only has the site commands and
+     * includes; each site's Entities are written to their own file next to
+     * it, named after the main file ('mutgos.dump' writes
+     * 'mutgos_site1.dump', etc).  Sites are written in parallel, one per
+     * thread, and each is streamed from the database so memory use stays
+     * small no matter how big the database is.
+     * <p>
+     * If a manifest file is given, the fingerprint of every Entity written
+     * is saved to it.  If the manifest of a previous export is given, the
+     * export is incremental: sites from the previous export reuse its
+     * files, and only Entities that are new or changed are written to a
+     * new, much smaller, file that is included after them.  Incremental
+     * exports must be written to the same directory as the export they
+     * build on.  Since the dump format can only add, anything removed from
+     * a changed Entity (a flag, property, etc) or a deleted Entity will
+     * still be there when loaded; write a full export periodically.
+     * <p>
+     * Nothing else should be modifying the database while writing.
+     */
+    class MutgosDumpFileWriter
+    {
+    public:
+        /**
+         * Constructs a writer.  This will start up the database.
+         * @param file_name[in] The main dump file to write.
+         * @param threads[in] How many sites to write at once.
+         * @param previous_manifest_file[in] The manifest of the previous
+         * export, if this export is to be incremental, or empty.
+         * @param manifest_file[in] Where to save the manifest of this
+         * export, or empty to not save one.
+         */
+        MutgosDumpFileWriter(
+            const std::string &file_name,
+            const MG_UnsignedInt threads,
+            const std::string &previous_manifest_file = "",
+            const std::string &manifest_file = "");
+
+        /**
+         * Destructor.  This will shut down the database.
+         */
+        ~MutgosDumpFileWriter();
+
+        /**
+         * Writes the dump.  This can only be called once.
+         * @param message[out] The error message, if any.
+         * @return True if the dump was completely written.
+         */
+        bool write(std::string &message);
+
+        /**
+         * @return How many Entities were written.
+         */
+        MG_LongUnsignedInt get_entities_written(void) const
+          { return entities_written; }
+
+        /**
+         * @return How many Entities were not written because they have not
+         * changed since the previous export.
+         */
+        MG_LongUnsignedInt get_entities_unchanged(void) const
+          { return entities_unchanged; }
+
+        /**
+         * @return How long write() took, in seconds.  0 if not yet written.
+         */
+        double get_write_seconds(void) const
+          { return write_seconds; }
+
+    private:
+        /** Ordered list of dump files */
+        typedef std::vector<std::string> FileList;
+        /** Maps site ID to the files (relative to the main dump) for it */
+        typedef std::map<dbtype::Id::SiteIdType, FileList> SiteFiles;
+
+        /**
+         * Reads the previous manifest.
+         * @param message[out] The error message, if any.
+         * @return True if success.
+         */
+        bool read_manifest(std::string &message);
+
+        /**
+         * Writes the manifest for this export.
+         * @param message[out] The error message, if any.
+         * @return True if success.
+         */
+        bool write_manifest(std::string &message);
+
+        /**
+         * Writes the main dump file.
+         * @param message[out] The error message, if any.
+         * @return True if success.
+         */
+        bool write_main_file(std::string &message);
+
+        /**
+         * Run by each thread; writes sites until there are none left or
+         * a site fails.
+         */
+        void write_sites(void);
+
+        /**
+         * Writes a single site to its own file.
+         * @param site_id[in] The site to write.
+         * @return True if success.  On failure, the error message will
+         * be set.
+         */
+        bool write_site(const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * @param site_id[in] The site.
+         * @param incremental[in] True if this is an incremental file.
+         * @return The name (without directory) of a new file for the site.
+         */
+        std::string make_site_file_name(
+            const dbtype::Id::SiteIdType site_id,
+            const bool incremental) const;
+
+        /**
+         * Sets the error message, if not already set.  Must be called with
+         * the mutex locked.
+         * @param message[in] The error message.
+         */
+        void set_error(const std::string &message);
+
+        dbinterface::DatabaseAccess * const db; ///< The database to write
+        const std::string main_file; ///< The main dump file
+        std::string base_path; ///< Directory of the main dump file
+        std::string file_stem; ///< Main file name without directory or extension
+        const MG_UnsignedInt thread_count; ///< How many sites to write at once
+        const std::string previous_manifest; ///< Previous manifest, if any
+        const std::string manifest; ///< Manifest to write, if any
+        std::string stamp; ///< Makes incremental file names unique
+
+        boost::mutex mutex; ///< Guards everything below
+        dbtype::Id::SiteIdVector sites_to_write; ///< Sites not yet started
+        SiteFiles previous_site_files; ///< Site files from the previous export
+        SiteFiles site_files; ///< Site files for this export
+        SiteDumpWriter::EntityFingerprints previous_fingerprints; ///< From the previous export
+        SiteDumpWriter::EntityFingerprints fingerprints; ///< For this export
+        std::string error_message; ///< First error encountered, if any
+        MG_LongUnsignedInt entities_written; ///< Entities written
+        MG_LongUnsignedInt entities_unchanged; ///< Entities skipped as unchanged
+        double write_seconds; ///< How long write() took
+
+        // No copying
+        //
+        MutgosDumpFileWriter(const MutgosDumpFileWriter &rhs);
+        MutgosDumpFileWriter &operator=(const MutgosDumpFileWriter &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_DBDUMP_MUTGOSDUMPFILEWRITER_H
@@ -0,0 +1,844 @@
+/*
+ * dbdump_SiteDumpWriter.cpp
+ */
+
+#include <string>
+#include <ostream>
+#include <sstream>
+
+#include "dbdump/dbdump_SiteDumpWriter.h"
+
+#include "text/text_StringConversion.h"
+#include "logging/log_Logger.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_EntityField.h"
+#include "dbtypes/dbtype_Security.h"
+#include "dbtypes/dbtype_PropertySecurity.h"
+#include "dbtypes/dbtype_Lock.h"
+#include "dbtypes/dbtype_PropertyData.h"
+#include "dbtypes/dbtype_PropertyDataType.h"
+#include "dbtypes/dbtype_DocumentProperty.h"
+#include "dbtypes/dbtype_IdProperty.h"
+#include "dbtypes/dbtype_SetProperty.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_ContainerPropertyEntity.h"
+#include "dbtypes/dbtype_Player.h"
+#include "dbtypes/dbtype_Thing.h"
+#include "dbtypes/dbtype_Puppet.h"
+#include "dbtypes/dbtype_Vehicle.h"
+#include "dbtypes/dbtype_Group.h"
+#include "dbtypes/dbtype_Program.h"
+#include "dbtypes/dbtype_ActionEntity.h"
+#include "dbtypes/dbtype_Exit.h"
+
+namespace
+{
+    const std::string INDENT = "  ";
+    const std::string FIELD_INDENT = INDENT + INDENT;
+    const std::string SECURITY_INDENT = FIELD_INDENT + INDENT;
+
+    const MG_LongUnsignedInt FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const MG_LongUnsignedInt FNV_PRIME = 1099511628211ULL;
+}
+
+namespace mutgos
+{
+namespace dbdump
+{
+    // ----------------------------------------------------------------------
+    SiteDumpWriter::SiteDumpWriter(
+        dbinterface::DatabaseAccess &database,
+        const dbtype::Id::SiteIdType site_id,
+        std::ostream &output,
+        const EntityFingerprints *previous_ptr)
+      : db(database),
+        site(site_id),
+        out(output),
+        previous_fingerprints_ptr(previous_ptr),
+        pass(PASS_MAKE),
+        entities_written(0),
+        entities_unchanged(0),
+        entities_deleted(0)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    SiteDumpWriter::~SiteDumpWriter()
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteDumpWriter::write_entities(void)
+    {
+        pass = PASS_MAKE;
+
+        if (not db.visit_site_entities(site, *this))
+        {
+            LOG(error, "dbdump", "write_entities",
+                "Could not make Entities for site "
+                + text::to_string(site));
+            return false;
+        }
+
+        pass = PASS_MODIFY;
+
+        if (not db.visit_site_entities(site, *this))
+        {
+            LOG(error, "dbdump", "write_entities",
+                "Could not modify Entities for site "
+                + text::to_string(site));
+            return false;
+        }
+
+        write_deleted_entities();
+        out.flush();
+
+        return out.good();
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SiteDumpWriter::make_variable(const dbtype::Id &id)
+    {
+        return "{e" + text::to_string(id.get_site_id()) + "_"
+            + text::to_string(id.get_entity_id()) + "}";
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteDumpWriter::visit_entity(dbtype::Entity *entity_ptr)
+    {
+        if (pass == PASS_MAKE)
+        {
+            write_make_entity(entity_ptr);
+        }
+        else
+        {
+            write_modify_entity(entity_ptr);
+        }
+
+        return out.good();
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::write_make_entity(dbtype::Entity *entity_ptr)
+    {
+        const dbtype::Id &id = entity_ptr->get_entity_id();
+
+        site_entity_ids.insert(id.get_entity_id());
+
+        if (previous_fingerprints_ptr and
+            (previous_fingerprints_ptr->find(id) !=
+                previous_fingerprints_ptr->end()))
+        {
+            // Already made by the previous export.
+            return;
+        }
+
+        out << "mkentity "
+            << dbtype::entity_type_to_string(entity_ptr->get_entity_type())
+            << " " << make_variable(id) << std::endl
+            << "end entity" << std::endl;
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::write_modify_entity(dbtype::Entity *entity_ptr)
+    {
+        const dbtype::Id &id = entity_ptr->get_entity_id();
+        std::string variable;
+
+        entity_text.str("");
+        entity_text.clear();
+
+        entity_text << "modentity " << make_variable(id) << std::endl;
+
+        const std::string name = single_line(entity_ptr->get_entity_name());
+
+        if (not name.empty())
+        {
+            entity_text << INDENT << "name " << name << std::endl;
+        }
+
+        const dbtype::Id owner = entity_ptr->get_entity_owner();
+
+        if (get_variable(owner, variable))
+        {
+            entity_text << INDENT << "owner " << variable << std::endl;
+        }
+        else if (not owner.is_default())
+        {
+            entity_text << INDENT << "# owner " << owner.to_string(true)
+                        << " is not in this site" << std::endl;
+        }
+
+        const dbtype::Entity::FlagSet flags = entity_ptr->get_entity_flags();
+
+        for (dbtype::Entity::FlagSet::const_iterator flag_iter = flags.begin();
+            flag_iter != flags.end();
+            ++flag_iter)
+        {
+            entity_text << INDENT << "flag " << single_line(*flag_iter)
+                        << std::endl;
+        }
+
+        entity_text << INDENT << "security" << std::endl;
+        format_security(entity_ptr->get_entity_security(), FIELD_INDENT);
+        entity_text << INDENT << "end security" << std::endl;
+
+        format_fields(entity_ptr);
+
+        dbtype::PropertyEntity * const property_entity_ptr =
+            dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+
+        if (property_entity_ptr)
+        {
+            format_properties(property_entity_ptr);
+        }
+
+        entity_text << "end entity" << std::endl;
+
+        // Only write it if it is new or has changed.
+        //
+        const std::string text = entity_text.str();
+        const EntityFingerprint fingerprint(
+            entity_ptr->get_entity_version(),
+            checksum(text));
+
+        fingerprints[id] = fingerprint;
+
+        if (previous_fingerprints_ptr)
+        {
+            const EntityFingerprints::const_iterator previous_iter =
+                previous_fingerprints_ptr->find(id);
+
+            if ((previous_iter != previous_fingerprints_ptr->end()) and
+                (previous_iter->second == fingerprint))
+            {
+                ++entities_unchanged;
+                return;
+            }
+        }
+
+        out << text;
+        ++entities_written;
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::write_deleted_entities(void)
+    {
+        if (not previous_fingerprints_ptr)
+        {
+            return;
+        }
+
+        // The fingerprints are sorted by ID, so this site's are together.
+        //
+        for (EntityFingerprints::const_iterator previous_iter =
+                previous_fingerprints_ptr->lower_bound(dbtype::Id(site, 0));
+            (previous_iter != previous_fingerprints_ptr->end()) and
+                (previous_iter->first.get_site_id() == site);
+            ++previous_iter)
+        {
+            if (site_entity_ids.find(previous_iter->first.get_entity_id()) ==
+                site_entity_ids.end())
+            {
+                // Dumps have no way to delete an Entity.
+                out << "# " << make_variable(previous_iter->first)
+                    << " has been deleted" << std::endl;
+                ++entities_deleted;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_security(
+        const dbtype::Security &security,
+        const std::string &indent)
+    {
+        std::string variable;
+        const dbtype::Security::SecurityIds &admin_ids =
+            security.get_admin_ids();
+        const dbtype::Security::SecurityIds &list_ids =
+            security.get_list_ids();
+
+        for (dbtype::Security::SecurityIds::const_iterator id_iter =
+                admin_ids.begin();
+            id_iter != admin_ids.end();
+            ++id_iter)
+        {
+            if (get_variable(*id_iter, variable))
+            {
+                entity_text << indent << "admin " << variable << std::endl;
+            }
+            else
+            {
+                entity_text << indent << "# admin " << id_iter->to_string(true)
+                            << " is not in this site" << std::endl;
+            }
+        }
+
+        for (dbtype::Security::SecurityIds::const_iterator id_iter =
+                list_ids.begin();
+            id_iter != list_ids.end();
+            ++id_iter)
+        {
+            if (get_variable(*id_iter, variable))
+            {
+                entity_text << indent << "group " << variable << std::endl;
+            }
+            else
+            {
+                entity_text << indent << "# group " << id_iter->to_string(true)
+                            << " is not in this site" << std::endl;
+            }
+        }
+
+        for (MG_UnsignedInt flag = dbtype::SECURITYFLAG_read;
+            flag < dbtype::SECURITYFLAG_invalid;
+            ++flag)
+        {
+            if (security.get_list_security_flag((dbtype::SecurityFlag) flag))
+            {
+                entity_text << indent << "flag group "
+                            << dbtype::Security::security_flag_to_string(
+                                   (dbtype::SecurityFlag) flag)
+                            << std::endl;
+            }
+        }
+
+        for (MG_UnsignedInt flag = dbtype::SECURITYFLAG_read;
+            flag < dbtype::SECURITYFLAG_invalid;
+            ++flag)
+        {
+            if (security.get_other_security_flag((dbtype::SecurityFlag) flag))
+            {
+                entity_text << indent << "flag other "
+                            << dbtype::Security::security_flag_to_string(
+                                   (dbtype::SecurityFlag) flag)
+                            << std::endl;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_fields(dbtype::Entity *entity_ptr)
+    {
+        const std::streampos fields_start = entity_text.tellp();
+
+        entity_text << INDENT << "fields" << std::endl;
+
+        const std::streampos fields_empty = entity_text.tellp();
+
+        format_string_field(
+            dbtype::ENTITYFIELD_note,
+            entity_ptr->get_entity_note());
+
+        dbtype::ContainerPropertyEntity * const container_ptr =
+            dynamic_cast<dbtype::ContainerPropertyEntity *>(entity_ptr);
+
+        if (container_ptr)
+        {
+            format_id_field(
+                dbtype::ENTITYFIELD_contained_by,
+                container_ptr->get_contained_by());
+
+            const dbtype::Entity::IdVector programs =
+                container_ptr->get_linked_programs();
+
+            for (dbtype::Entity::IdVector::const_iterator id_iter =
+                    programs.begin();
+                id_iter != programs.end();
+                ++id_iter)
+            {
+                format_id_field(dbtype::ENTITYFIELD_linked_programs, *id_iter);
+            }
+        }
+
+        dbtype::Player * const player_ptr =
+            dynamic_cast<dbtype::Player *>(entity_ptr);
+
+        if (player_ptr)
+        {
+            format_string_field(
+                dbtype::ENTITYFIELD_player_display_name,
+                player_ptr->get_display_name(false));
+            format_id_field(
+                dbtype::ENTITYFIELD_player_home,
+                player_ptr->get_player_home());
+        }
+
+        dbtype::Thing * const thing_ptr =
+            dynamic_cast<dbtype::Thing *>(entity_ptr);
+
+        if (thing_ptr)
+        {
+            format_id_field(
+                dbtype::ENTITYFIELD_thing_home,
+                thing_ptr->get_thing_home());
+            format_lock_field(
+                dbtype::ENTITYFIELD_thing_lock,
+                thing_ptr->get_thing_lock());
+        }
+
+        dbtype::Puppet * const puppet_ptr =
+            dynamic_cast<dbtype::Puppet *>(entity_ptr);
+
+        if (puppet_ptr)
+        {
+            format_string_field(
+                dbtype::ENTITYFIELD_puppet_display_name,
+                puppet_ptr->get_puppet_display_name());
+        }
+
+        dbtype::Vehicle * const vehicle_ptr =
+            dynamic_cast<dbtype::Vehicle *>(entity_ptr);
+
+        if (vehicle_ptr)
+        {
+            format_id_field(
+                dbtype::ENTITYFIELD_vehicle_interior,
+                vehicle_ptr->get_vehicle_interior());
+            format_id_field(
+                dbtype::ENTITYFIELD_vehicle_controller,
+                vehicle_ptr->get_vehicle_controller());
+        }
+
+        dbtype::Group * const group_ptr =
+            dynamic_cast<dbtype::Group *>(entity_ptr);
+
+        if (group_ptr)
+        {
+            const dbtype::Entity::IdVector members =
+                group_ptr->get_all_in_group();
+
+            for (dbtype::Entity::IdVector::const_iterator id_iter =
+                    members.begin();
+                id_iter != members.end();
+                ++id_iter)
+            {
+                format_id_field(dbtype::ENTITYFIELD_group_ids, *id_iter);
+            }
+        }
+
+        dbtype::Program * const program_ptr =
+            dynamic_cast<dbtype::Program *>(entity_ptr);
+
+        if (program_ptr)
+        {
+            format_string_field(
+                dbtype::ENTITYFIELD_program_reg_name,
+                program_ptr->get_program_reg_name());
+            format_string_field(
+                dbtype::ENTITYFIELD_program_language,
+                program_ptr->get_program_language());
+
+            const dbtype::DocumentProperty source =
+                program_ptr->get_source_code();
+
+            if (source.get_number_lines())
+            {
+                // The field takes the place of the property path.
+                format_property_data(
+                    dbtype::entity_field_to_string(
+                        dbtype::ENTITYFIELD_program_source_code),
+                    source,
+                    FIELD_INDENT);
+            }
+        }
+
+        dbtype::ActionEntity * const action_ptr =
+            dynamic_cast<dbtype::ActionEntity *>(entity_ptr);
+
+        if (action_ptr)
+        {
+            format_id_field(
+                dbtype::ENTITYFIELD_action_contained_by,
+                action_ptr->get_action_contained_by());
+
+            const dbtype::Entity::IdVector targets =
+                action_ptr->get_action_targets();
+
+            for (dbtype::Entity::IdVector::const_iterator id_iter =
+                    targets.begin();
+                id_iter != targets.end();
+                ++id_iter)
+            {
+                format_id_field(dbtype::ENTITYFIELD_action_targets, *id_iter);
+            }
+
+            format_lock_field(
+                dbtype::ENTITYFIELD_action_lock,
+                action_ptr->get_action_lock());
+            format_string_field(
+                dbtype::ENTITYFIELD_action_succ_msg,
+                action_ptr->get_action_success_message());
+            format_string_field(
+                dbtype::ENTITYFIELD_action_succ_room_msg,
+                action_ptr->get_action_success_room_message());
+            format_string_field(
+                dbtype::ENTITYFIELD_action_fail_msg,
+                action_ptr->get_action_fail_message());
+            format_string_field(
+                dbtype::ENTITYFIELD_action_fail_room_msg,
+                action_ptr->get_action_fail_room_message());
+
+            const dbtype::ActionEntity::CommandList commands =
+                action_ptr->get_action_commands();
+
+            for (dbtype::ActionEntity::CommandList::const_iterator
+                    command_iter = commands.begin();
+                command_iter != commands.end();
+                ++command_iter)
+            {
+                format_string_field(
+                    dbtype::ENTITYFIELD_action_commands,
+                    *command_iter);
+            }
+        }
+
+        dbtype::Exit * const exit_ptr =
+            dynamic_cast<dbtype::Exit *>(entity_ptr);
+
+        if (exit_ptr)
+        {
+            format_string_field(
+                dbtype::ENTITYFIELD_exit_arrive_msg,
+                exit_ptr->get_exit_arrive_message());
+            format_string_field(
+                dbtype::ENTITYFIELD_exit_arrive_room_msg,
+                exit_ptr->get_exit_arrive_room_message());
+        }
+
+        if (entity_text.tellp() == fields_empty)
+        {
+            // No fields; take back the start of the section.
+            entity_text.seekp(fields_start);
+        }
+        else
+        {
+            entity_text << INDENT << "end fields" << std::endl;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_string_field(
+        const dbtype::EntityField field,
+        const std::string &value)
+    {
+        if (not value.empty())
+        {
+            entity_text << FIELD_INDENT << dbtype::entity_field_to_string(field)
+                        << "=" << single_line(value) << std::endl;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_id_field(
+        const dbtype::EntityField field,
+        const dbtype::Id &id)
+    {
+        std::string variable;
+
+        if (get_variable(id, variable))
+        {
+            entity_text << FIELD_INDENT << dbtype::entity_field_to_string(field)
+                        << "=" << variable << std::endl;
+        }
+        else if (not id.is_default())
+        {
+            entity_text << FIELD_INDENT << "# "
+                        << dbtype::entity_field_to_string(field) << " "
+                        << id.to_string(true) << " is not in this site"
+                        << std::endl;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_lock_field(
+        const dbtype::EntityField field,
+        const dbtype::Lock &lock)
+    {
+        const std::string &field_string = dbtype::entity_field_to_string(field);
+        const std::string operation_not = lock.get_operation_not() ? "!" : "";
+        std::string variable;
+
+        switch (lock.get_lock_type())
+        {
+            case dbtype::Lock::LOCK_BY_ID:
+            case dbtype::Lock::LOCK_BY_GROUP:
+            {
+                if (get_variable(lock.get_id(), variable))
+                {
+                    entity_text << FIELD_INDENT << field_string << "="
+                                << operation_not << "id" << std::endl
+                                << FIELD_INDENT << variable << std::endl
+                                << FIELD_INDENT << "end lock" << std::endl;
+                }
+                else
+                {
+                    entity_text << FIELD_INDENT << "# " << field_string << " "
+                                << lock.get_id().to_string(true)
+                                << " is not in this site" << std::endl;
+                }
+
+                break;
+            }
+
+            case dbtype::Lock::LOCK_BY_PROPERTY:
+            {
+                if (lock.get_path_data())
+                {
+                    entity_text << FIELD_INDENT << field_string << "="
+                                << operation_not << "property" << std::endl;
+                    format_property_data(
+                        lock.get_path(),
+                        *lock.get_path_data(),
+                        FIELD_INDENT);
+                    entity_text << FIELD_INDENT << "end lock" << std::endl;
+                }
+
+                break;
+            }
+
+            default:
+            {
+                // Not locked.
+                break;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_properties(dbtype::PropertyEntity *entity_ptr)
+    {
+        std::string application = entity_ptr->get_first_application_name();
+
+        if (application.empty())
+        {
+            return;
+        }
+
+        std::string variable;
+
+        entity_text << INDENT << "properties" << std::endl;
+
+        while (not application.empty())
+        {
+            const dbtype::PropertyEntity::ApplicationOwnerSecurity security =
+                entity_ptr->get_application_security_settings(application);
+
+            if (not get_variable(security.first, variable))
+            {
+                // An application cannot be added without an owner.
+                entity_text << FIELD_INDENT << "# application " << application
+                            << " owner " << security.first.to_string(true)
+                            << " is not in this site" << std::endl;
+            }
+            else
+            {
+                entity_text << FIELD_INDENT << "security " << application
+                            << " " << variable << std::endl;
+                format_security(security.second, SECURITY_INDENT);
+                entity_text << FIELD_INDENT << "end security" << std::endl;
+
+                format_property_directory(entity_ptr, application);
+            }
+
+            application = entity_ptr->get_next_application_name(application);
+        }
+
+        entity_text << INDENT << "end properties" << std::endl;
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_property_directory(
+        dbtype::PropertyEntity *entity_ptr,
+        const std::string &path)
+    {
+        std::string property_path = entity_ptr->get_first_property(path);
+
+        while (not property_path.empty())
+        {
+            dbtype::PropertyData *data_ptr =
+                entity_ptr->get_property(property_path);
+
+            if (data_ptr)
+            {
+                format_property_data(property_path, *data_ptr, FIELD_INDENT);
+                delete data_ptr;
+                data_ptr = 0;
+            }
+
+            if (entity_ptr->is_property_directory(property_path))
+            {
+                format_property_directory(entity_ptr, property_path);
+            }
+
+            property_path = entity_ptr->get_next_property(property_path);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteDumpWriter::format_property_data(
+        const std::string &path,
+        const dbtype::PropertyData &data,
+        const std::string &indent)
+    {
+        const dbtype::PropertyDataType type = data.get_data_type();
+        const std::string &type_string =
+            dbtype::property_data_type_to_string(type);
+
+        switch (type)
+        {
+            case dbtype::PROPERTYDATATYPE_id:
+            {
+                const dbtype::IdProperty &id_data =
+                    static_cast<const dbtype::IdProperty &>(data);
+                std::string variable;
+
+                if (get_variable(id_data.get(), variable))
+                {
+                    entity_text << indent << type_string << " " << path << "="
+                                << variable << std::endl;
+                }
+                else
+                {
+                    entity_text << indent << "# " << path << " "
+                                << id_data.get().to_string(true)
+                                << " is not in this site" << std::endl;
+                }
+
+                break;
+            }
+
+            case dbtype::PROPERTYDATATYPE_document:
+            {
+                const dbtype::DocumentProperty &document =
+                    static_cast<const dbtype::DocumentProperty &>(data);
+                const MG_UnsignedInt lines = document.get_number_lines();
+
+                // Program source is a field rather than a property, so it
+                // has no type.  Only property paths start at the root.
+                //
+                entity_text << indent;
+
+                if ((not path.empty()) and (path[0] == '/'))
+                {
+                    entity_text << type_string << " ";
+                }
+
+                entity_text << path << "=lines " << lines << std::endl;
+
+                for (MG_UnsignedInt line = 0; line < lines; ++line)
+                {
+                    const std::string &line_text = document.get_line(line);
+
+                    // Empty lines are skipped by the reader.
+                    entity_text << (line_text.empty() ? " " : line_text)
+                                << std::endl;
+                }
+
+                entity_text << "end lines" << std::endl;
+                break;
+            }
+
+            case dbtype::PROPERTYDATATYPE_set:
+            {
+                const dbtype::SetProperty &set =
+                    static_cast<const dbtype::SetProperty &>(data);
+                const dbtype::PropertyDataType contained_type =
+                    set.get_contained_type();
+
+                if ((contained_type == dbtype::PROPERTYDATATYPE_id) or
+                    (contained_type == dbtype::PROPERTYDATATYPE_document) or
+                    (contained_type == dbtype::PROPERTYDATATYPE_set))
+                {
+                    entity_text << indent << "# " << path << " is a set of "
+                                << dbtype::property_data_type_to_string(
+                                       contained_type)
+                                << ", which cannot be written" << std::endl;
+                    break;
+                }
+
+                entity_text << indent << type_string << " "
+                            << dbtype::property_data_type_to_string(
+                                   (contained_type ==
+                                       dbtype::PROPERTYDATATYPE_invalid) ?
+                                     dbtype::PROPERTYDATATYPE_string :
+                                     contained_type)
+                            << " " << path << "=items " << set.size()
+                            << std::endl;
+
+                for (const dbtype::PropertyData *item_ptr = set.iter_first();
+                    item_ptr;
+                    item_ptr = set.iter_next(item_ptr))
+                {
+                    entity_text << single_line(item_ptr->get_as_string())
+                                << std::endl;
+                }
+
+                entity_text << "end items" << std::endl;
+                break;
+            }
+
+            default:
+            {
+                entity_text << indent << type_string << " " << path << "="
+                            << single_line(data.get_as_string()) << std::endl;
+                break;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteDumpWriter::get_variable(
+        const dbtype::Id &id,
+        std::string &variable) const
+    {
+        if ((id.get_site_id() != site) or
+            (site_entity_ids.find(id.get_entity_id()) ==
+                site_entity_ids.end()))
+        {
+            return false;
+        }
+
+        variable = make_variable(id);
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SiteDumpWriter::single_line(const std::string &text)
+    {
+        std::string result = text;
+
+        for (std::string::iterator char_iter = result.begin();
+            char_iter != result.end();
+            ++char_iter)
+        {
+            if ((*char_iter == '\n') or (*char_iter == '\r'))
+            {
+                *char_iter = ' ';
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_LongUnsignedInt SiteDumpWriter::checksum(const std::string &text)
+    {
+        MG_LongUnsignedInt hash = FNV_OFFSET_BASIS;
+
+        for (std::string::const_iterator char_iter = text.begin();
+            char_iter != text.end();
+            ++char_iter)
+        {
+            hash ^= (unsigned char) *char_iter;
+            hash *= FNV_PRIME;
+        }
+
+        return hash;
+    }
+}
+}
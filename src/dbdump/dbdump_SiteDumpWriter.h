@@ -0,0 +1,279 @@
+/*
+ * dbdump_SiteDumpWriter.h
+ */
+
+#ifndef MUTGOS_DBDUMP_SITEDUMPWRITER_H
+#define MUTGOS_DBDUMP_SITEDUMPWRITER_H
+
+#include <string>
+#include <ostream>
+#include <sstream>
+#include <map>
+#include <set>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityField.h"
+#include "dbtypes/dbtype_Security.h"
+#include "dbtypes/dbtype_Lock.h"
+#include "dbtypes/dbtype_PropertyData.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+#include "dbinterface/dbinterface_EntityVisitor.h"
+
+namespace mutgos
+{
+namespace dbdump
+{
+    /**
+     * Writes the Entities of one site in the format read by
+     * MutgosDumpFileReader.  Entities are streamed straight from the
+     * database, one at a time, so the site is never in memory all at once.
+     * Only the IDs of the site's Entities, and a small fingerprint of each,
+     * are kept.
+     * <p>
+     * The site is read twice.  The first pass makes every Entity
+     * (mkentity), so the second pass can refer to any of them by
+     * variable no matter what order they are in.  The second pass fills in
+     * everything else (modentity).  The variable for an Entity is made from
+     * its ID, so it is the same in every export.
+     * <p>
+     * If fingerprints from a previous export are provided, only Entities
+     * that are new or have changed since then are written.  An Entity's
+     * fingerprint is its version plus a checksum of the text written for
+     * it, since the version alone does not change when an Entity is
+     * edited.
+     * <p>
+     * Some things cannot be written, and are left as comments instead:
+     * references to Entities in other sites or that no longer exist, and
+     * sets of IDs.  Passwords are stored hashed and are never written.
+     * The site commands themselves (mksite, end site) are up to the
+     * caller.
+     * <p>
+     * This class is not thread safe, but different sites can be written
+     * at once by different instances.
+     */
+    class SiteDumpWriter : public dbinterface::EntityVisitor
+    {
+    public:
+        /** The version of an Entity and a checksum of its written text */
+        typedef std::pair<dbtype::Entity::VersionType, MG_LongUnsignedInt>
+            EntityFingerprint;
+        /** Maps Entity ID to its fingerprint */
+        typedef std::map<dbtype::Id, EntityFingerprint> EntityFingerprints;
+
+        /**
+         * Constructor.
+         * @param database[in] The database to read the site from.
+         * @param site_id[in] The site to write.
+         * @param output[in] Where to write the site's Entities.
+         * @param previous_ptr[in] If not null, the fingerprints from a
+         * previous export; only Entities that are new or changed since
+         * then will be written.  Must stay valid while writing.
+         */
+        SiteDumpWriter(
+            dbinterface::DatabaseAccess &database,
+            const dbtype::Id::SiteIdType site_id,
+            std::ostream &output,
+            const EntityFingerprints *previous_ptr);
+
+        /**
+         * Destructor.
+         */
+        virtual ~SiteDumpWriter();
+
+        /**
+         * Writes the site's Entities to the output.  This can only be
+         * called once.
+         * @return True if success, false if the database could not be
+         * read or the output could not be written.
+         */
+        bool write_entities(void);
+
+        /**
+         * @param id[in] The ID of an Entity.
+         * @return The dump variable (including braces) used for the Entity.
+         */
+        static std::string make_variable(const dbtype::Id &id);
+
+        /**
+         * @return The fingerprints of every Entity in the site, including
+         * ones that were not written because they have not changed.
+         */
+        const EntityFingerprints &get_fingerprints(void) const
+          { return fingerprints; }
+
+        /**
+         * @return How many Entities were written.
+         */
+        MG_LongUnsignedInt get_entities_written(void) const
+          { return entities_written; }
+
+        /**
+         * @return How many Entities were not written because they have not
+         * changed since the previous export.
+         */
+        MG_LongUnsignedInt get_entities_unchanged(void) const
+          { return entities_unchanged; }
+
+        /**
+         * @return How many Entities were in the previous export but no
+         * longer exist.
+         */
+        MG_LongUnsignedInt get_entities_deleted(void) const
+          { return entities_deleted; }
+
+        /**
+         * Called by the database for each Entity in the site.
+         * @param entity_ptr[in] The Entity to write.
+         * @return True to continue, false if the output has failed.
+         */
+        virtual bool visit_entity(dbtype::Entity *entity_ptr);
+
+    private:
+        /** Which pass through the site is being made */
+        enum WritePass
+        {
+            PASS_MAKE,  ///< Making each Entity (mkentity)
+            PASS_MODIFY ///< Filling in each Entity (modentity)
+        };
+
+        /**
+         * Writes the mkentity for an Entity, if it is new.
+         * @param entity_ptr[in] The Entity to make.
+         */
+        void write_make_entity(dbtype::Entity *entity_ptr);
+
+        /**
+         * Writes the modentity for an Entity, if it is new or has changed.
+         * @param entity_ptr[in] The Entity to fill in.
+         */
+        void write_modify_entity(dbtype::Entity *entity_ptr);
+
+        /**
+         * Writes a comment for each Entity in the previous export that is
+         * no longer in the site.
+         */
+        void write_deleted_entities(void);
+
+        /**
+         * Formats the security settings (without the surrounding
+         * security / end security lines).
+         * @param security[in] The security settings to format.
+         * @param indent[in] The indentation to use.
+         */
+        void format_security(
+            const dbtype::Security &security,
+            const std::string &indent);
+
+        /**
+         * Formats all the fields of an Entity, by type.
+         * @param entity_ptr[in] The Entity whose fields are to be formatted.
+         */
+        void format_fields(dbtype::Entity *entity_ptr);
+
+        /**
+         * Formats a string field, if not empty.
+         * @param field[in] The field.
+         * @param value[in] The value of the field.
+         */
+        void format_string_field(
+            const dbtype::EntityField field,
+            const std::string &value);
+
+        /**
+         * Formats an ID field, if not default.  IDs that cannot be
+         * referred to are formatted as a comment.
+         * @param field[in] The field.
+         * @param id[in] The value of the field.
+         */
+        void format_id_field(
+            const dbtype::EntityField field,
+            const dbtype::Id &id);
+
+        /**
+         * Formats a lock field, if the lock is valid.
+         * @param field[in] The field.
+         * @param lock[in] The value of the field.
+         */
+        void format_lock_field(
+            const dbtype::EntityField field,
+            const dbtype::Lock &lock);
+
+        /**
+         * Formats the applications and properties of an Entity, if any.
+         * @param entity_ptr[in] The Entity whose properties are to be
+         * formatted.
+         */
+        void format_properties(dbtype::PropertyEntity *entity_ptr);
+
+        /**
+         * Formats every property in a property directory, recursively.
+         * @param entity_ptr[in] The Entity the properties are on.
+         * @param path[in] The full path of the directory (or just the
+         * application name, for the top).
+         */
+        void format_property_directory(
+            dbtype::PropertyEntity *entity_ptr,
+            const std::string &path);
+
+        /**
+         * Formats a single property.  Properties that cannot be written
+         * are formatted as a comment.
+         * @param path[in] The full path of the property.
+         * @param data[in] The property data.
+         * @param indent[in] The indentation to use.
+         */
+        void format_property_data(
+            const std::string &path,
+            const dbtype::PropertyData &data,
+            const std::string &indent);
+
+        /**
+         * @param id[in] The ID to refer to.
+         * @param variable[out] The variable for the ID, if it can be
+         * referred to.
+         * @return True if the ID is an Entity in this site.
+         */
+        bool get_variable(const dbtype::Id &id, std::string &variable) const;
+
+        /**
+         * @param text[in] Text that may contain newlines.
+         * @return The text with newlines replaced by spaces, since the dump
+         * format is line based.
+         */
+        static std::string single_line(const std::string &text);
+
+        /**
+         * @param text[in] The text to checksum.
+         * @return A 64 bit FNV-1a hash of the text.
+         */
+        static MG_LongUnsignedInt checksum(const std::string &text);
+
+        /** Entity IDs (without the site) in this site */
+        typedef std::set<dbtype::Id::EntityIdType> SiteEntityIds;
+
+        dbinterface::DatabaseAccess &db; ///< Where the site is read from
+        const dbtype::Id::SiteIdType site; ///< The site being written
+        std::ostream &out; ///< Where the site is written to
+        const EntityFingerprints * const previous_fingerprints_ptr; ///< Previous export, if incremental
+        WritePass pass; ///< Which pass is in progress
+        SiteEntityIds site_entity_ids; ///< Found during the first pass
+        EntityFingerprints fingerprints; ///< Made during the second pass
+        std::ostringstream entity_text; ///< The Entity being formatted
+        MG_LongUnsignedInt entities_written; ///< Entities written
+        MG_LongUnsignedInt entities_unchanged; ///< Entities skipped as unchanged
+        MG_LongUnsignedInt entities_deleted; ///< Entities gone since the previous export
+
+        // No copying
+        //
+        SiteDumpWriter(const SiteDumpWriter &rhs);
+        SiteDumpWriter &operator=(const SiteDumpWriter &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_DBDUMP_SITEDUMPWRITER_H
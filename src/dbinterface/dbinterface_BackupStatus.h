@@ -0,0 +1,68 @@
+/*
+ * dbinterface_BackupStatus.h
+ */
+
+#ifndef MUTGOS_DBINTERFACE_BACKUPSTATUS_H
+#define MUTGOS_DBINTERFACE_BACKUPSTATUS_H
+
+#include <string>
+#include <stddef.h>
+
+#include "dbtypes/dbtype_TimeStamp.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    /**
+     * Simple container class with the progress of the current (or most
+     * recent) online database backup.
+     */
+    class BackupStatus
+    {
+    public:
+        /**
+         * Constructor that zeroes everything.
+         */
+        BackupStatus(void)
+            : in_progress(false),
+              completed(false),
+              started(false),
+              finished(false),
+              total_pages(0),
+              remaining_pages(0)
+        {
+        }
+
+        /**
+         * @return How far along the backup is, from 0 to 100.
+         */
+        unsigned int percent_done(void) const
+        {
+            if (completed)
+            {
+                return 100;
+            }
+
+            if (not total_pages)
+            {
+                return 0;
+            }
+
+            return (unsigned int)
+                (((total_pages - remaining_pages) * 100) / total_pages);
+        }
+
+        bool in_progress; ///< True if a backup is currently running
+        bool completed; ///< True if the most recent backup succeeded
+        std::string backup_file; ///< Where the backup is being written
+        dbtype::TimeStamp started; ///< When the backup started
+        dbtype::TimeStamp finished; ///< When the backup finished
+        size_t total_pages; ///< Pages in the database being backed up
+        size_t remaining_pages; ///< Pages still to be copied
+        std::string error; ///< Why the most recent backup failed, if it did
+    };
+}
+}
+
+#endif //MUTGOS_DBINTERFACE_BACKUPSTATUS_H
@@ -0,0 +1,51 @@
+/*
+ * dbinterface_CacheStats.h
+ */
+
+#ifndef MUTGOS_DBINTERFACE_CACHESTATS_H
+#define MUTGOS_DBINTERFACE_CACHESTATS_H
+
+#include <stddef.h>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    /**
+     * Simple container class with statistics about the Entity cache for a
+     * site.  The counters are since the cache was created (usually
+     * server startup).  This is primarily for tuning the cache size.
+     */
+    class CacheStats
+    {
+    public:
+        /**
+         * Constructor that zeroes everything.
+         */
+        CacheStats(void)
+            : hits(0),
+              misses(0),
+              evictions(0),
+              resident_entities(0),
+              resident_bytes(0),
+              max_bytes(0),
+              prog_reg_hits(0),
+              prog_reg_misses(0)
+        {
+        }
+
+        MG_LongUnsignedInt hits; ///< Entity requests found in the cache
+        MG_LongUnsignedInt misses; ///< Entity requests loaded from database
+        MG_LongUnsignedInt evictions; ///< Entities evicted to save memory
+        size_t resident_entities; ///< How many Entities currently in cache
+        size_t resident_bytes; ///< Approximate memory used by cached Entities
+        size_t max_bytes; ///< Memory limit of the cache, or 0 for no limit
+        MG_LongUnsignedInt prog_reg_hits; ///< Program registration lookups answered without the database
+        MG_LongUnsignedInt prog_reg_misses; ///< Program registration lookups sent to the database
+    };
+}
+}
+
+#endif //MUTGOS_DBINTERFACE_CACHESTATS_H
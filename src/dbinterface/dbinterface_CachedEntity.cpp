@@ -2,8 +2,7 @@
 
 #include "dbinterface_CachedEntity.h"
 
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/lock_guard.hpp>
+#include <boost/atomic/atomic.hpp>
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbinterface_EntityRef.h"
@@ -18,7 +17,9 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     CachedEntity::CachedEntity(dbtype::Entity *entity)
       : ref_count(0),
-        entity_ptr(entity)
+        entity_ptr(entity),
+        recently_used(true),
+        mem_size(0)
     {
         if (not entity_ptr)
         {
@@ -36,7 +37,7 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     CachedEntity::~CachedEntity()
     {
-        if (ref_count)
+        if (ref_count.load(boost::memory_order_acquire))
         {
             LOG(fatal, "dbinterface", "~CachedEntity()",
                 "Being destructed when there are still references!  ID: "
@@ -62,8 +63,9 @@ namespace dbinterface
         }
         else
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
-            ++ref_count;
+            // Whoever is adding a reference already has one (or the
+            // SiteCache lock), so no ordering is needed.
+            ref_count.fetch_add(1, boost::memory_order_relaxed);
         }
     }
 
@@ -77,14 +79,13 @@ namespace dbinterface
         }
         else
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
-
-            if (ref_count)
-            {
-                --ref_count;
-            }
-            else
+            // Release, so anything done through the reference is visible
+            // to the SiteCache once it sees the count at zero.
+            //
+            if (not ref_count.fetch_sub(1, boost::memory_order_release))
             {
+                ref_count.fetch_add(1, boost::memory_order_relaxed);
+
                 LOG(fatal, "dbinterface", "mem_reference_removed()",
                     "More references than were counted!");
             }
@@ -100,9 +101,7 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     bool CachedEntity::is_referenced()
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
-        return ref_count;
+        return ref_count.load(boost::memory_order_acquire);
     }
 
     // ----------------------------------------------------------------------
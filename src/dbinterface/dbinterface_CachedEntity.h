@@ -1,7 +1,8 @@
 #ifndef MUTGOS_DBINTERFACE_CACHEDENTITY_H
 #define MUTGOS_DBINTERFACE_CACHEDENTITY_H
 
-#include <boost/thread/mutex.hpp>
+#include <stddef.h>
+#include <boost/atomic/atomic.hpp>
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_Id.h"
@@ -16,6 +17,13 @@ namespace dbinterface
      * Contains metadata and the pointer to an Entity being cached.
      * Also used to help determine if an Entity is memory is still being
      * referenced.
+     *
+     * The reference count is atomic, so copying and destroying EntityRefs
+     * never takes a lock.  The count can only go from zero to one through
+     * get_reference(), which the owning SiteCache only calls while locked.
+     * Therefore once the SiteCache sees is_referenced() return false while
+     * locked, nothing can start referencing the Entity until it unlocks,
+     * and it is safe to evict or delete.
      */
     class CachedEntity : public EntityRefCounter
     {
@@ -54,6 +62,7 @@ namespace dbinterface
         /**
          * Sets the provided EntityRef to refer to the Entity contained by
          * this class.  Also sets the ref counter callback.
+         * The owning SiteCache must be locked.
          * @param ref[out] The EntityRef to update.
          */
         void get_reference(EntityRef &ref);
@@ -68,10 +77,42 @@ namespace dbinterface
          */
         const dbtype::Id &get_id(void) const;
 
+        /**
+         * Used by the cache eviction algorithm.  Not thread safe; the
+         * owning SiteCache must be locked.
+         * @param used[in] True if the Entity has been requested since the
+         * last time eviction considered it.
+         */
+        void set_recently_used(const bool used)
+            { recently_used = used; }
+
+        /**
+         * Not thread safe; the owning SiteCache must be locked.
+         * @return True if the Entity has been requested since the last
+         * time eviction considered it.
+         */
+        bool is_recently_used(void) const
+            { return recently_used; }
+
+        /**
+         * Not thread safe; the owning SiteCache must be locked.
+         * @param bytes[in] The memory used by the Entity, as last measured.
+         */
+        void set_mem_size(const size_t bytes)
+            { mem_size = bytes; }
+
+        /**
+         * Not thread safe; the owning SiteCache must be locked.
+         * @return The memory used by the Entity, as last measured.
+         */
+        size_t get_mem_size(void) const
+            { return mem_size; }
+
     private:
-        boost::mutex mutex; ///< Enforces single access at a time.
-        unsigned int ref_count; ///< How many references to Entity exist
+        boost::atomic<unsigned int> ref_count; ///< How many references to Entity exist
         dbtype::Entity *entity_ptr; ///< Pointer to cached Entity.
+        bool recently_used; ///< For eviction.  Protected by SiteCache.
+        size_t mem_size; ///< Last measured size.  Protected by SiteCache.
 
         // No copying
         //
@@ -0,0 +1,60 @@
+/*
+ * dbinterface_CommitStats.h
+ */
+
+#ifndef MUTGOS_DBINTERFACE_COMMITSTATS_H
+#define MUTGOS_DBINTERFACE_COMMITSTATS_H
+
+#include <stddef.h>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    /**
+     * Simple container class with statistics about how changed Entities
+     * are being committed to the database.  The counters are since the
+     * UpdateManager was created (usually server startup).  This is
+     * primarily for tuning the commit settings.
+     */
+    class CommitStats
+    {
+    public:
+        /**
+         * Constructor that zeroes everything.
+         */
+        CommitStats(void)
+            : commits(0),
+              time_commits(0),
+              entity_limit_commits(0),
+              memory_limit_commits(0),
+              committed_entities(0),
+              last_batch_entities(0),
+              max_batch_entities(0),
+              last_commit_usecs(0),
+              max_commit_usecs(0),
+              total_commit_usecs(0),
+              pending_entities(0),
+              pending_bytes(0)
+        {
+        }
+
+        MG_LongUnsignedInt commits; ///< Commit batches done
+        MG_LongUnsignedInt time_commits; ///< Batches started by the time limit
+        MG_LongUnsignedInt entity_limit_commits; ///< Batches started by too many changed Entities
+        MG_LongUnsignedInt memory_limit_commits; ///< Batches started by too much changed memory
+        MG_LongUnsignedInt committed_entities; ///< Total Entities committed
+        size_t last_batch_entities; ///< Entities in the most recent batch
+        size_t max_batch_entities; ///< Entities in the largest batch
+        MG_LongUnsignedInt last_commit_usecs; ///< How long the most recent batch took
+        MG_LongUnsignedInt max_commit_usecs; ///< How long the slowest batch took
+        MG_LongUnsignedInt total_commit_usecs; ///< Time spent in all batches
+        size_t pending_entities; ///< Changed Entities waiting to be committed
+        size_t pending_bytes; ///< Approximate memory of waiting Entities
+    };
+}
+}
+
+#endif //MUTGOS_DBINTERFACE_COMMITSTATS_H
@@ -1,12 +1,23 @@
 #include <deque>
+#include <chrono>
+#include <algorithm>
 
 #include "dbinterface_DatabaseAccess.h"
 #include "dbinterface_UpdateManager.h"
 #include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteShardedBackend.h"
+#include "memoryinterface/memoryinterface_InMemoryBackend.h"
+#include "logstoreinterface/logstoreinterface_LogStoreBackend.h"
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbinterface/dbinterface_SiteInfo.h"
 
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
 #include "concurrency/concurrency_WriterLockToken.h"
 #include "concurrency/concurrency_ReaderLockToken.h"
 
@@ -30,6 +41,7 @@ namespace dbinterface
     //
     DatabaseAccess *DatabaseAccess::singleton_ptr = 0;
     DatabaseAccess::EntityListenerList DatabaseAccess::entity_listeners;
+    const size_t DatabaseAccess::WARM_UP_CHUNK_SIZE;
 
     // TODO Finds need to check cached items before checking database, since the DB is not always up to date yet.
 
@@ -53,7 +65,27 @@ namespace dbinterface
     }
 
     // ----------------------------------------------------------------------
-    bool DatabaseAccess::startup(void)
+    DbBackend *DatabaseAccess::make_backend(void)
+    {
+        if (config::db::backend() == "memory")
+        {
+            return new memoryinterface::InMemoryBackend();
+        }
+        else if (config::db::backend() == "logstore")
+        {
+            return new logstoreinterface::LogStoreBackend();
+        }
+        else if (config::db::site_files())
+        {
+            return new sqliteinterface::SqliteShardedBackend(
+                config::db::site_files());
+        }
+
+        return new sqliteinterface::SqliteBackend();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::startup(const bool warm_up)
     {
         LOG(info, "dbinterface", "startup", "Starting up...");
 
@@ -61,7 +93,11 @@ namespace dbinterface
 
         if (not db_backend_ptr)
         {
-            db_backend_ptr = new sqliteinterface::SqliteBackend();
+            db_backend_ptr = make_backend();
+
+            LOG(info, "dbinterface", "startup",
+                "Using database backend: "
+                + db_backend_ptr->get_backend_name());
 
             success = db_backend_ptr->init();
 
@@ -81,6 +117,11 @@ namespace dbinterface
                 {
                     add_site_info_to_cache(*site_iter);
                 }
+
+                if (warm_up and config::db::warmup_entities())
+                {
+                    warm_up_cache(site_ids);
+                }
             }
         }
 
@@ -231,6 +272,70 @@ namespace dbinterface
         return ref;
     }
 
+    // ----------------------------------------------------------------------
+    EntityRefVector DatabaseAccess::get_entities(
+        const dbtype::Entity::IdVector &ids)
+    {
+        typedef std::map<dbtype::Id::SiteIdType, std::vector<size_t> >
+            SitePositions;
+
+        EntityRefVector refs(ids.size());
+        SitePositions site_positions;
+        dbtype::Entity::IdVector site_ids;
+        EntityRefVector site_refs;
+
+        // Group by site, so each site's cache is only used once.
+        //
+        for (size_t index = 0; index < ids.size(); ++index)
+        {
+            if (not ids[index].is_default())
+            {
+                site_positions[ids[index].get_site_id()].push_back(index);
+            }
+        }
+
+        for (SitePositions::const_iterator site_iter = site_positions.begin();
+            site_iter != site_positions.end();
+            ++site_iter)
+        {
+            SiteCache *cache_ptr = get_site_cache(site_iter->first);
+
+            if (not cache_ptr)
+            {
+                LOG(error, "dbinterface", "get_entities",
+                    "Could not get site cache for site "
+                    + text::to_string(site_iter->first));
+                continue;
+            }
+
+            site_ids.clear();
+
+            for (std::vector<size_t>::const_iterator position_iter =
+                    site_iter->second.begin();
+                position_iter != site_iter->second.end();
+                ++position_iter)
+            {
+                site_ids.push_back(ids[*position_iter]);
+            }
+
+            cache_ptr->get_entity_refs(site_ids, site_refs);
+
+            for (size_t index = 0; index < site_refs.size(); ++index)
+            {
+                EntityRef &ref = site_refs[index];
+
+                // Filter out anything in the process of being deleted.
+                //
+                if (ref.valid() and (not ref.is_delete_pending()))
+                {
+                    refs[site_iter->second[index]] = ref;
+                }
+            }
+        }
+
+        return refs;
+    }
+
     // ----------------------------------------------------------------------
     bool DatabaseAccess::entity_exists(const dbtype::Id &id)
     {
@@ -340,7 +445,7 @@ namespace dbinterface
                     // invalid name or already in use), delete the Player
                     // and return an error code.
                     //
-                    boost::lock_guard<boost::mutex> guard(mutex);
+                    boost::lock_guard<boost::mutex> guard(player_create_mutex);
 
                     const std::string temp_name = ::TEMP_PLAYER_NAME_PREFIX +
                         text::to_string(player_name_ser++);
@@ -370,7 +475,17 @@ namespace dbinterface
                     // channels so it's cached and provided as a ref.
                     entity_ref = get_entity(entity_ptr->get_entity_id());
 
-                    if (type == dbtype::ENTITYTYPE_player)
+                    if (not entity_ref.valid())
+                    {
+                        LOG(error, "dbinterface", "new_entity",
+                            "Could not load newly created Entity "
+                            + entity_ptr->get_entity_id().to_string(true));
+
+                        rc = DBRESULTCODE_ERROR;
+                        delete entity_ptr;
+                        entity_ptr = 0;
+                    }
+                    else if (type == dbtype::ENTITYTYPE_player)
                     {
                         // Attempt to set the actual name
                         if (not entity_ref->set_entity_name(name))
@@ -637,8 +752,9 @@ namespace dbinterface
         dbtype::Id &prog_id)
     {
         DbResultCode rc = DBRESULTCODE_OK;
+        SiteCache * const cache_ptr = get_site_cache(site_id);
 
-        if (not get_site_cache(site_id))
+        if (not cache_ptr)
         {
             rc = DBRESULTCODE_BAD_SITE_ID;
             prog_id = dbtype::Id();
@@ -651,8 +767,7 @@ namespace dbinterface
             if (prog_id.is_default())
             {
                 // Didn't find in active renames, check database.
-                prog_id =
-                    db_backend_ptr->find_program_reg_in_db(site_id, regname);
+                prog_id = cache_ptr->find_program_reg(regname);
             }
         }
 
@@ -663,7 +778,7 @@ namespace dbinterface
     dbtype::Id::SiteIdVector DatabaseAccess::get_all_site_ids(void)
     {
         dbtype::Id::SiteIdVector sites;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
 
         sites.reserve(site_id_to_info_cache.size());
 
@@ -682,7 +797,7 @@ namespace dbinterface
     DatabaseAccess::SiteInfoVector DatabaseAccess::get_all_site_info(void)
     {
         SiteInfoVector result;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
 
         result.reserve(site_id_to_info_cache.size());
 
@@ -703,7 +818,7 @@ namespace dbinterface
         std::string &site_name)
     {
         DbResultCode rc = DBRESULTCODE_BAD_SITE_ID;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
         SiteIdToInfo::const_iterator site_iter =
             site_id_to_info_cache.find(site_id);
 
@@ -733,18 +848,34 @@ namespace dbinterface
         }
         else
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
-            SiteIdToInfo::iterator site_iter =
-                site_id_to_info_cache.find(site_id);
+            // The backend may have to wait for a commit batch, which could
+            // need the cache lock, so it is not held while writing.
+            //
+            boost::lock_guard<boost::mutex> site_guard(site_change_mutex);
+            bool site_found = false;
+
+            {
+                boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+                site_found = site_id_to_info_cache.count(site_id);
+            }
 
-            if (site_iter != site_id_to_info_cache.end())
+            if (site_found)
             {
                 if (db_backend_ptr->set_site_description_in_db(
                     site_id,
                     site_desc_trimmed))
                 {
+                    boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+                    SiteIdToInfo::iterator site_iter =
+                        site_id_to_info_cache.find(site_id);
+
                     rc = DBRESULTCODE_OK;
-                    site_iter->second.set_site_description(site_desc_trimmed);
+
+                    if (site_iter != site_id_to_info_cache.end())
+                    {
+                        site_iter->second.set_site_description(
+                            site_desc_trimmed);
+                    }
                 }
                 else
                 {
@@ -762,7 +893,7 @@ namespace dbinterface
         std::string &site_description)
     {
         DbResultCode rc = DBRESULTCODE_BAD_SITE_ID;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
         SiteIdToInfo::const_iterator site_iter =
             site_id_to_info_cache.find(site_id);
 
@@ -792,40 +923,55 @@ namespace dbinterface
         }
         else
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
-
-            // Confirm name not in use
+            // Serializes site changes so the name can't be taken by
+            // someone else before it's written.  The cache lock is not held
+            // while writing, since the backend may have to wait for a
+            // commit batch, which could need the cache lock.
             //
-            for (SiteIdToInfo::const_iterator site_check_iter =
-                    site_id_to_info_cache.begin();
-                site_check_iter != site_id_to_info_cache.end();
-                ++site_check_iter)
+            boost::lock_guard<boost::mutex> site_guard(site_change_mutex);
+            bool site_found = false;
+
             {
-                if (site_check_iter->second.get_site_name() == site_name_trimmed)
+                boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+                // Confirm name not in use
+                //
+                for (SiteIdToInfo::const_iterator site_check_iter =
+                        site_id_to_info_cache.begin();
+                    site_check_iter != site_id_to_info_cache.end();
+                    ++site_check_iter)
                 {
-                    rc = DBRESULTCODE_BAD_NAME;
-                    break;
+                    if (site_check_iter->second.get_site_name() ==
+                        site_name_trimmed)
+                    {
+                        rc = DBRESULTCODE_BAD_NAME;
+                        break;
+                    }
                 }
+
+                site_found = site_id_to_info_cache.count(site_id);
             }
 
-            if (rc != DBRESULTCODE_BAD_NAME)
+            if ((rc != DBRESULTCODE_BAD_NAME) and site_found)
             {
-                SiteIdToInfo::iterator site_iter =
-                    site_id_to_info_cache.find(site_id);
-
-                if (site_iter != site_id_to_info_cache.end())
+                if (db_backend_ptr->set_site_name_in_db(
+                    site_id,
+                    site_name_trimmed))
                 {
-                    if (db_backend_ptr->set_site_name_in_db(
-                        site_id,
-                        site_name_trimmed))
+                    boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+                    SiteIdToInfo::iterator site_iter =
+                        site_id_to_info_cache.find(site_id);
+
+                    rc = DBRESULTCODE_OK;
+
+                    if (site_iter != site_id_to_info_cache.end())
                     {
-                        rc = DBRESULTCODE_OK;
                         site_iter->second.set_site_name(site_name_trimmed);
                     }
-                    else
-                    {
-                        rc = DBRESULTCODE_ERROR;
-                    }
+                }
+                else
+                {
+                    rc = DBRESULTCODE_ERROR;
                 }
             }
         }
@@ -836,12 +982,14 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     DbResultCode DatabaseAccess::new_site(dbtype::Id::SiteIdType &site_id)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
         DbResultCode rc = DBRESULTCODE_OK;
 
+        // The cache lock is not held while writing, since the backend may
+        // have to wait for a commit batch, which could need the cache lock.
+        //
         if (db_backend_ptr->new_site_in_db(site_id))
         {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
             add_site_info_to_cache(site_id);
         }
         else
@@ -856,10 +1004,9 @@ namespace dbinterface
     DbResultCode DatabaseAccess::delete_site(
         const dbtype::Id::SiteIdType site_id)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
         DbResultCode rc = DBRESULTCODE_OK;
 
+        // get_site_cache() does its own locking.
         SiteCache *cache_ptr = get_site_cache(site_id, true);
 
         if (not cache_ptr)
@@ -895,10 +1042,14 @@ namespace dbinterface
             {
                 // Nothing is referencing the site, safe to delete immediately.
                 //
-                delete cache_ptr;
-                cache_ptr = 0;
-                site_id_to_info_cache.erase(site_id);
-                entity_cache.erase(site_id);
+                {
+                    boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+                    delete cache_ptr;
+                    cache_ptr = 0;
+                    site_id_to_info_cache.erase(site_id);
+                    entity_cache.erase(site_id);
+                }
 
                 if (not db_backend_ptr->delete_site_in_db(site_id))
                 {
@@ -910,6 +1061,87 @@ namespace dbinterface
         return rc;
     }
 
+    // ----------------------------------------------------------------------
+    DbResultCode DatabaseAccess::get_cache_stats(
+        const dbtype::Id::SiteIdType site_id,
+        CacheStats &stats)
+    {
+        DbResultCode rc = DBRESULTCODE_OK;
+        SiteCache * const cache_ptr = get_site_cache(site_id);
+
+        if (not cache_ptr)
+        {
+            rc = DBRESULTCODE_BAD_SITE_ID;
+        }
+        else
+        {
+            stats = cache_ptr->get_stats();
+        }
+
+        return rc;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::start_backup(void)
+    {
+        return db_backend_ptr and
+            db_backend_ptr->start_backup_db(config::db::backup_file());
+    }
+
+    // ----------------------------------------------------------------------
+    BackupStatus DatabaseAccess::get_backup_status(void)
+    {
+        return db_backend_ptr ?
+            db_backend_ptr->get_backup_status_db() : BackupStatus();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::begin_bulk_load(void)
+    {
+        const bool success = db_backend_ptr and
+            db_backend_ptr->begin_bulk_load_db();
+
+        if (success)
+        {
+            UpdateManager::instance()->begin_bulk_load();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::end_bulk_load(void)
+    {
+        bool success = db_backend_ptr;
+
+        if (success)
+        {
+            // Everything must be committed before the backend finishes the
+            // bulk load.
+            //
+            UpdateManager::instance()->end_bulk_load();
+            success = db_backend_ptr->end_bulk_load_db();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::visit_site_entities(
+        const dbtype::Id::SiteIdType site_id,
+        EntityVisitor &visitor)
+    {
+        bool success = db_backend_ptr;
+
+        if (success)
+        {
+            UpdateManager::instance()->flush();
+            success = db_backend_ptr->visit_site_entities_db(site_id, visitor);
+        }
+
+        return success;
+    }
+
     // ----------------------------------------------------------------------
     bool DatabaseAccess::internal_commit_entity(EntityRef entity)
     {
@@ -923,6 +1155,212 @@ namespace dbinterface
         return success;
     }
 
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_begin_commit_batch(void)
+    {
+        return db_backend_ptr and db_backend_ptr->begin_transaction_db();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_commit_entities(
+        const EntityRefVector &entities,
+        dbtype::Entity::IdVector &failed_ids)
+    {
+        bool success = false;
+
+        if (db_backend_ptr)
+        {
+            DbBackend::EntityPtrVector entity_ptrs;
+            entity_ptrs.reserve(entities.size());
+
+            for (EntityRefVector::const_iterator entity_iter =
+                    entities.begin();
+                 entity_iter != entities.end();
+                 ++entity_iter)
+            {
+                if (entity_iter->valid())
+                {
+                    entity_ptrs.push_back(entity_iter->get());
+                }
+            }
+
+            success = db_backend_ptr->save_entities_db(entity_ptrs, failed_ids);
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_end_commit_batch(void)
+    {
+        return db_backend_ptr and db_backend_ptr->commit_transaction_db();
+    }
+
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::internal_enforce_cache_limits(void)
+    {
+        std::vector<SiteCache *> caches;
+
+        {
+            // Copy so the lock isn't held while evicting.
+            //
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            caches.reserve(entity_cache.size());
+
+            for (CacheMap::iterator cache_iter = entity_cache.begin();
+                 cache_iter != entity_cache.end();
+                 ++cache_iter)
+            {
+                caches.push_back(cache_iter->second);
+            }
+        }
+
+        for (std::vector<SiteCache *>::iterator cache_iter = caches.begin();
+             cache_iter != caches.end();
+             ++cache_iter)
+        {
+            (*cache_iter)->enforce_memory_limit();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    size_t DatabaseAccess::internal_get_average_entity_mem(void)
+    {
+        std::vector<SiteCache *> caches;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            caches.reserve(entity_cache.size());
+
+            for (CacheMap::iterator cache_iter = entity_cache.begin();
+                 cache_iter != entity_cache.end();
+                 ++cache_iter)
+            {
+                caches.push_back(cache_iter->second);
+            }
+        }
+
+        size_t total_entities = 0;
+        size_t total_bytes = 0;
+
+        for (std::vector<SiteCache *>::iterator cache_iter = caches.begin();
+             cache_iter != caches.end();
+             ++cache_iter)
+        {
+            const CacheStats stats = (*cache_iter)->get_stats();
+
+            total_entities += stats.resident_entities;
+            total_bytes += stats.resident_bytes;
+        }
+
+        return total_entities ? (total_bytes / total_entities) : 0;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_save_access_stats(
+        DbBackend::AccessStatsMap &stats)
+    {
+        std::vector<SiteCache *> caches;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            caches.reserve(entity_cache.size());
+
+            for (CacheMap::iterator cache_iter = entity_cache.begin();
+                 cache_iter != entity_cache.end();
+                 ++cache_iter)
+            {
+                caches.push_back(cache_iter->second);
+            }
+        }
+
+        stats.clear();
+
+        for (std::vector<SiteCache *>::iterator cache_iter = caches.begin();
+             cache_iter != caches.end();
+             ++cache_iter)
+        {
+            (*cache_iter)->take_access_stats(stats);
+        }
+
+        if (stats.empty())
+        {
+            return true;
+        }
+
+        const bool success = db_backend_ptr->save_access_stats_db(stats);
+
+        if (not success)
+        {
+            LOG(error, "dbinterface", "internal_save_access_stats",
+                "Failed to save access statistics for "
+                + text::to_string(stats.size()) + " Entities.");
+
+            internal_restore_access_stats(stats);
+            stats.clear();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::internal_restore_access_stats(
+        const DbBackend::AccessStatsMap &stats)
+    {
+        typedef std::map<dbtype::Id::SiteIdType, DbBackend::AccessStatsMap>
+            SiteAccessStats;
+
+        SiteAccessStats site_stats;
+
+        for (DbBackend::AccessStatsMap::const_iterator stats_iter =
+                stats.begin();
+             stats_iter != stats.end();
+             ++stats_iter)
+        {
+            site_stats[stats_iter->first.get_site_id()].insert(*stats_iter);
+        }
+
+        std::vector<std::pair<SiteCache *, SiteAccessStats::const_iterator> >
+            caches;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            caches.reserve(site_stats.size());
+
+            for (SiteAccessStats::const_iterator site_iter =
+                    site_stats.begin();
+                 site_iter != site_stats.end();
+                 ++site_iter)
+            {
+                CacheMap::const_iterator cache_iter =
+                    entity_cache.find(site_iter->first);
+
+                if (cache_iter != entity_cache.end())
+                {
+                    caches.push_back(
+                        std::make_pair(cache_iter->second, site_iter));
+                }
+            }
+        }
+
+        for (size_t index = 0; index < caches.size(); ++index)
+        {
+            caches[index].first->restore_access_stats(
+                caches[index].second->second);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_delete_site_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        return db_backend_ptr and db_backend_ptr->delete_site_in_db(site_id);
+    }
+
     // ----------------------------------------------------------------------
     DbResultCode DatabaseAccess::internal_delete_entity(
         const dbtype::Id &entity_id)
@@ -963,6 +1401,33 @@ namespace dbinterface
         return rc;
     }
 
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_update_references(
+        const dbtype::Id &source_id,
+        const dbtype::Entity::ChangedIdFieldsMap &changed_fields)
+    {
+        return db_backend_ptr and
+            db_backend_ptr->update_references_db(source_id, changed_fields);
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_references_saved(void)
+    {
+        return db_backend_ptr and db_backend_ptr->references_saved_db();
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdFieldsMap DatabaseAccess::internal_get_references_from(
+        const dbtype::Id &source_id)
+    {
+        if (not db_backend_ptr)
+        {
+            return dbtype::Entity::IdFieldsMap();
+        }
+
+        return db_backend_ptr->get_references_from_db(source_id);
+    }
+
     // ----------------------------------------------------------------------
     DbResultCode DatabaseAccess::internal_get_prog_by_regname(
         const dbtype::Id::SiteIdType &site_id,
@@ -970,15 +1435,16 @@ namespace dbinterface
         dbtype::Id &prog_id)
     {
         DbResultCode rc = DBRESULTCODE_OK;
+        SiteCache * const cache_ptr = get_site_cache(site_id);
 
-        if (not get_site_cache(site_id))
+        if (not cache_ptr)
         {
             rc = DBRESULTCODE_BAD_SITE_ID;
             prog_id = dbtype::Id();
         }
         else
         {
-            prog_id = db_backend_ptr->find_program_reg_in_db(site_id, regname);
+            prog_id = cache_ptr->find_program_reg(regname);
         }
 
         return rc;
@@ -1021,20 +1487,34 @@ namespace dbinterface
         std::string &regname)
     {
         DbResultCode rc = DBRESULTCODE_OK;
+        SiteCache * const cache_ptr = get_site_cache(prog_id.get_site_id());
 
-        if (not get_site_cache(prog_id.get_site_id()))
+        if (not cache_ptr)
         {
             rc = DBRESULTCODE_BAD_SITE_ID;
             regname.clear();
         }
         else
         {
-            regname = db_backend_ptr->find_program_reg_name_in_db(prog_id);
+            regname = cache_ptr->find_program_reg_name(prog_id.get_entity_id());
         }
 
         return rc;
     }
 
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::internal_program_reg_changed(
+        const dbtype::Id &prog_id,
+        const bool deleted)
+    {
+        SiteCache * const cache_ptr = get_site_cache(prog_id.get_site_id());
+
+        if (cache_ptr)
+        {
+            cache_ptr->program_reg_changed(prog_id.get_entity_id(), deleted);
+        }
+    }
+
     // ----------------------------------------------------------------------
     DatabaseAccess::DatabaseAccess(void)
       : db_backend_ptr(0),
@@ -1061,7 +1541,15 @@ namespace dbinterface
 
         entities.clear();
 
+        if (not (db_backend_ptr and
+            db_backend_ptr->entity_exists_db(root_entity_id)))
+        {
+            return;
+        }
+
         // Prime the loop.  This is a non-recursive breadth-first search.
+        // Nothing is loaded; the reference index only contains Entities
+        // that exist.
         //
         deletes_to_process.push_back(root_entity_id);
 
@@ -1072,34 +1560,27 @@ namespace dbinterface
             current_id = deletes_to_process.front();
             deletes_to_process.pop_front();
 
-            if (entities.find(current_id) == entities.end())
+            if (entities.insert(current_id).second)
             {
-                EntityRef current_entity = get_entity_deleted(current_id);
-
-                if (current_entity.valid())
-                {
-                    entities.insert(current_id);
-
-                    // Find everything 'under' this Entity in the hierarchy by
-                    // looking at the references.  Append them to the deletes
-                    // to process.
-                    //
-                    concurrency::ReaderLockToken token(*current_entity.get());
-
-                    current_references = current_entity.get()->get_reference_ids(
-                        dbtype::ENTITYFIELD_contained_by, token);
-                    deletes_to_process.insert(
-                        deletes_to_process.end(),
-                        current_references.begin(),
-                        current_references.end());
-
-                    current_references = current_entity.get()->get_reference_ids(
-                        dbtype::ENTITYFIELD_action_contained_by, token);
-                    deletes_to_process.insert(
-                        deletes_to_process.end(),
-                        current_references.begin(),
-                        current_references.end());
-                }
+                // Find everything 'under' this Entity in the hierarchy by
+                // looking at the reference index.  Append them to the
+                // deletes to process.
+                //
+                current_references = db_backend_ptr->get_references_to_db(
+                    current_id,
+                    dbtype::ENTITYFIELD_contained_by);
+                deletes_to_process.insert(
+                    deletes_to_process.end(),
+                    current_references.begin(),
+                    current_references.end());
+
+                current_references = db_backend_ptr->get_references_to_db(
+                    current_id,
+                    dbtype::ENTITYFIELD_action_contained_by);
+                deletes_to_process.insert(
+                    deletes_to_process.end(),
+                    current_references.begin(),
+                    current_references.end());
             }
         }
     }
@@ -1109,33 +1590,186 @@ namespace dbinterface
         const dbtype::Id::SiteIdType site_id,
         const bool include_delete_pending)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
         SiteCache *site_ptr = 0;
 
-        if (site_id_to_info_cache.find(site_id) != site_id_to_info_cache.end())
         {
-            CacheMap::iterator cache_iter = entity_cache.find(site_id);
+            // Almost always the cache already exists, so only a shared lock
+            // is needed.
+            //
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
 
-            if (cache_iter == entity_cache.end())
+            CacheMap::const_iterator cache_iter = entity_cache.find(site_id);
+
+            if (cache_iter != entity_cache.end())
             {
-                // Doesn't exist; create.
-                //
-                entity_cache[site_id] = new SiteCache(db_backend_ptr, site_id);
-                cache_iter = entity_cache.find(site_id);
+                site_ptr = cache_iter->second;
             }
+        }
 
-            const bool delete_pending = cache_iter->second->is_delete_pending();
+        if (not site_ptr)
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
 
-            if ((not delete_pending) or (delete_pending and include_delete_pending))
+            if (site_id_to_info_cache.find(site_id) !=
+                site_id_to_info_cache.end())
             {
+                CacheMap::iterator cache_iter = entity_cache.find(site_id);
+
+                if (cache_iter == entity_cache.end())
+                {
+                    // Doesn't exist; create.
+                    //
+                    entity_cache[site_id] = new SiteCache(
+                        db_backend_ptr,
+                        site_id,
+                        ((size_t) config::db::cache_max_site_memory()) * 1024);
+                    cache_iter = entity_cache.find(site_id);
+                }
+
                 site_ptr = cache_iter->second;
             }
         }
 
+        if (site_ptr and site_ptr->is_delete_pending() and
+            (not include_delete_pending))
+        {
+            site_ptr = 0;
+        }
+
         return site_ptr;
     }
 
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::warm_up_cache(const dbtype::Id::SiteIdVector &site_ids)
+    {
+        const std::chrono::steady_clock::time_point start_time =
+            std::chrono::steady_clock::now();
+        WarmUpWork work;
+
+        // Split each site's Entities into chunks, so the threads can share
+        // the work even when there is only one site.
+        //
+        for (dbtype::Id::SiteIdVector::const_iterator site_iter =
+                site_ids.begin();
+            site_iter != site_ids.end();
+            ++site_iter)
+        {
+            const dbtype::Entity::IdVector ids =
+                db_backend_ptr->get_recently_accessed_db(
+                    *site_iter,
+                    config::db::warmup_entities());
+
+            for (size_t index = 0; index < ids.size();
+                index += WARM_UP_CHUNK_SIZE)
+            {
+                work.chunks.push_back(dbtype::Entity::IdVector(
+                    ids.begin() + index,
+                    ids.begin() + std::min(index + WARM_UP_CHUNK_SIZE,
+                        ids.size())));
+            }
+
+            work.entities_total += ids.size();
+        }
+
+        if (work.chunks.empty())
+        {
+            LOG(info, "dbinterface", "warm_up_cache",
+                "Nothing to warm up.");
+            return;
+        }
+
+        const size_t thread_count = std::min(
+            (size_t) std::max(config::db::warmup_threads(), (MG_UnsignedInt) 1),
+            work.chunks.size());
+
+        LOG(info, "dbinterface", "warm_up_cache",
+            "Warming up cache with " + text::to_string(work.entities_total)
+            + " Entities from " + text::to_string(site_ids.size())
+            + " site(s), using " + text::to_string(thread_count)
+            + " thread(s)...");
+
+        boost::thread_group threads;
+
+        for (size_t index = 0; index < thread_count; ++index)
+        {
+            threads.create_thread(boost::bind(
+                &DatabaseAccess::warm_up_worker,
+                this,
+                boost::ref(work)));
+        }
+
+        threads.join_all();
+
+        const double seconds = std::chrono::duration_cast<
+            std::chrono::duration<double> >(
+                std::chrono::steady_clock::now() - start_time).count();
+
+        LOG(info, "dbinterface", "warm_up_cache",
+            "Cache warm-up done in " + text::to_string(seconds)
+            + " seconds.  Loaded "
+            + text::to_string(work.entities_loaded - work.entities_skipped)
+            + " Entities, skipped "
+            + text::to_string(work.entities_skipped)
+            + " because a site cache was full.");
+    }
+
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::warm_up_worker(WarmUpWork &work)
+    {
+        EntityRefVector refs;
+
+        while (true)
+        {
+            const dbtype::Entity::IdVector *chunk_ptr = 0;
+
+            {
+                boost::lock_guard<boost::mutex> guard(work.mutex);
+
+                if (work.next_chunk >= work.chunks.size())
+                {
+                    break;
+                }
+
+                chunk_ptr = &work.chunks[work.next_chunk];
+                ++work.next_chunk;
+            }
+
+            SiteCache * const cache_ptr =
+                get_site_cache(chunk_ptr->front().get_site_id());
+            const bool skipped = (not cache_ptr) or cache_ptr->is_full();
+
+            if (not skipped)
+            {
+                // Loading is not an access; it would make whatever was
+                // warmed up look recently used forever.
+                //
+                cache_ptr->get_entity_refs(*chunk_ptr, refs, false);
+                refs.clear();
+            }
+
+            boost::lock_guard<boost::mutex> guard(work.mutex);
+
+            work.entities_loaded += chunk_ptr->size();
+
+            if (skipped)
+            {
+                work.entities_skipped += chunk_ptr->size();
+            }
+
+            const size_t percent =
+                (work.entities_loaded * 100) / work.entities_total;
+
+            if (percent >= work.next_progress_percent)
+            {
+                LOG(info, "dbinterface", "warm_up_worker",
+                    "Cache warm-up " + text::to_string(percent)
+                    + "% done.");
+
+                work.next_progress_percent = ((percent / 10) + 1) * 10;
+            }
+        }
+    }
+
     // ----------------------------------------------------------------------
     void DatabaseAccess::add_site_info_to_cache(
         const mutgos::dbtype::Id::SiteIdType site_id)
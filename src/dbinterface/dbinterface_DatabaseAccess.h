@@ -12,12 +12,16 @@
 #include "dbinterface/dbinterface_DbBackend.h"
 #include "sqliteinterface/sqliteinterface_SqliteBackend.h"
 #include "dbinterface/dbinterface_SiteCache.h"
+#include "dbinterface/dbinterface_CacheStats.h"
+#include "dbinterface/dbinterface_BackupStatus.h"
+#include "dbinterface/dbinterface_EntityVisitor.h"
 #include "dbinterface/dbinterface_DatabaseEntityListener.h"
 #include "dbinterface/dbinterface_SiteInfo.h"
 
 #include "dbinterface_DbResultCode.h"
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace mutgos
 {
@@ -60,13 +64,26 @@ namespace dbinterface
          */
         static void destroy_singleton(void);
 
+        /**
+         * Creates the database backend selected in the configuration.  It
+         * has not been initialized yet.  This is what startup() uses; it
+         * is also available to tools that want to work with the backend
+         * directly.
+         * @return The new backend.  Caller must manage the pointer.
+         */
+        static DbBackend *make_backend(void);
+
         /**
          * Initializes the singleton instance; called once as MUTGOS is coming
          * up and before any methods below are called.
+         * @param warm_up[in] True to load the most recently accessed
+         * Entities of each site into the cache, as configured, before
+         * returning.  This avoids a burst of slow cache misses when players
+         * first connect after a restart.
          * @return True if success.  If false is returned, MUTGOS should
          * fail initialization completely.
          */
-        bool startup(void);
+        bool startup(const bool warm_up = false);
 
         /**
          * Shuts down the singleton instance; called when MUTGOS is coming down.
@@ -126,6 +143,19 @@ namespace dbinterface
          */
         EntityRef get_entity_deleted(const dbtype::Id &id);
 
+        /**
+         * Gets several Entities from the database at once.  This is more
+         * efficient than calling get_entity() for each, since each site's
+         * cache is locked only once and any Entities not cached are loaded
+         * together.
+         * NOTE: This will not return any Entities that are marked as deleted.
+         * @param ids[in] The IDs of the Entities to get.
+         * @return A reference for each ID, in the same order as ids.  A
+         * reference will be invalid if its ID is defaulted, not found,
+         * marked as deleted, or has an error.
+         */
+        EntityRefVector get_entities(const dbtype::Entity::IdVector &ids);
+
         /**
          * Determines if an Entity with the given ID exists at all, even
          * if deleted.
@@ -347,6 +377,67 @@ namespace dbinterface
          */
         DbResultCode delete_site(const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * Gets statistics about the Entity cache for a site, such as
+         * hits, misses, evictions, and approximate memory used.  Also
+         * includes how many program registration lookups were answered
+         * without going to the database.
+         * @param site_id[in] The site ID to get cache statistics for.
+         * @param stats[out] The statistics for the site's cache.
+         * @return The status code.  Can return
+         * DBRESULTCODE_OK,
+         * DBRESULTCODE_BAD_SITE_ID
+         */
+        DbResultCode get_cache_stats(
+            const dbtype::Id::SiteIdType site_id,
+            CacheStats &stats);
+
+        /**
+         * Starts an online backup of the database to the configured backup
+         * file.  The backup runs in the background while the database
+         * remains in use; use get_backup_status() to follow its progress.
+         * @return True if the backup was started, false if error, a backup
+         * is already running, or the database does not support online
+         * backups.
+         */
+        bool start_backup(void);
+
+        /**
+         * @return The progress of the current or most recent online backup.
+         */
+        BackupStatus get_backup_status(void);
+
+        /**
+         * Puts the database into bulk load mode, for loading a large number
+         * of Entities at once (such as from a dump).  Updates to
+         * back-references are saved up until the end, and the database
+         * backend may defer indexing and durability.  Must be called while
+         * nothing else is using the database.
+         * @return True if bulk load mode was entered.
+         */
+        bool begin_bulk_load(void);
+
+        /**
+         * Ends bulk load mode, updating all saved up back-references and
+         * waiting until everything has been committed.
+         * @return True if success.
+         */
+        bool end_bulk_load(void);
+
+        /**
+         * Calls the visitor with every Entity in a site, straight from the
+         * database and without caching them, such as for writing a dump.
+         * Changes waiting to be committed are committed first.  Changes
+         * made while visiting may or may not be seen.
+         * @param site_id[in] The site whose Entities are to be visited.
+         * @param visitor[in] What to call for each Entity.
+         * @return True if every Entity was visited, false if error or the
+         * visitor stopped early.
+         */
+        bool visit_site_entities(
+            const dbtype::Id::SiteIdType site_id,
+            EntityVisitor &visitor);
+
         /**
          * ** Internal namespace use only **
          * Commits an Entity's changes to the actual database backend.
@@ -355,6 +446,79 @@ namespace dbinterface
          */
         bool internal_commit_entity(EntityRef entity);
 
+        /**
+         * ** Internal namespace use only **
+         * Starts a batch of commits, deletes, and site deletes that will
+         * be written to the database backend as a single transaction.
+         * Must be followed by internal_end_commit_batch().
+         * @return True if the batch was started.  If false, changes are
+         * still written but each individually.
+         */
+        bool internal_begin_commit_batch(void);
+
+        /**
+         * ** Internal namespace use only **
+         * Commits the changes of several Entities to the actual database
+         * backend.
+         * @param entities[in] The Entities to commit.  Invalid references
+         * are skipped.
+         * @param failed_ids[out] The IDs of any Entities that failed to
+         * commit will be appended to this.
+         * @return True if all Entities were committed.
+         */
+        bool internal_commit_entities(
+            const EntityRefVector &entities,
+            dbtype::Entity::IdVector &failed_ids);
+
+        /**
+         * ** Internal namespace use only **
+         * Ends the batch started by internal_begin_commit_batch(), making
+         * all changes in it durable.
+         * @return True if success, false if the batch could not be
+         * committed and everything in it has been discarded by the
+         * backend.
+         */
+        bool internal_end_commit_batch(void);
+
+        /**
+         * ** Internal namespace use only **
+         * Evicts unused Entities from any site cache that is over its
+         * memory limit.  Must not be called while a commit batch is open.
+         */
+        void internal_enforce_cache_limits(void);
+
+        /**
+         * ** Internal namespace use only **
+         * @return The approximate average memory used by a cached Entity,
+         * across all site caches, or 0 if nothing is cached.
+         */
+        size_t internal_get_average_entity_mem(void);
+
+        /**
+         * ** Internal namespace use only **
+         * Saves the access statistics (last accessed time and access count)
+         * recorded by every site cache since the last save.  These are
+         * kept out of the Entity itself so that merely reading an Entity
+         * does not cause it to be rewritten.
+         * @param stats[out] The statistics that were saved, so they can be
+         * restored with internal_restore_access_stats() if the commit
+         * batch they were saved in fails.
+         * @return True if success or nothing to save.  On failure the
+         * statistics are put back into the site caches to be saved later.
+         */
+        bool internal_save_access_stats(DbBackend::AccessStatsMap &stats);
+
+        /**
+         * ** Internal namespace use only **
+         * Puts access statistics that could not be saved back into their
+         * site caches, to be saved later.  Statistics recorded since are
+         * newer and are kept instead.  Statistics for sites no longer
+         * cached are dropped.
+         * @param stats[in] The statistics to put back.
+         */
+        void internal_restore_access_stats(
+            const DbBackend::AccessStatsMap &stats);
+
         /**
          * ** Internal namespace use only **
          * Deletes an Entity from its cache and the actual database backend,
@@ -369,8 +533,49 @@ namespace dbinterface
 
         /**
          * ** Internal namespace use only **
-         * Finds a program's ID by regname.  Checks the database only;
-         * renames in progress will not be found.
+         * Deletes a site from the database backend only.  Used to try again
+         * when delete_site() removed the site from memory but the deletion
+         * could not be committed to the database.
+         * @param site_id[in] The site ID to delete.
+         * @return True if success.
+         */
+        bool internal_delete_site_db(const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * ** Internal namespace use only **
+         * Updates the backend's reference index with the ID fields that
+         * changed on an Entity.
+         * @param source_id[in] The ID of the Entity whose fields changed.
+         * @param changed_fields[in] The IDs removed and added, per field.
+         * @return True if success.
+         */
+        bool internal_update_references(
+            const dbtype::Id &source_id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields);
+
+        /**
+         * ** Internal namespace use only **
+         * Tells the backend that every Entity whose references were
+         * updated has now been saved in the current commit batch.
+         * @return True if success.
+         */
+        bool internal_references_saved(void);
+
+        /**
+         * ** Internal namespace use only **
+         * Gets everything an Entity references from the backend's
+         * reference index, without loading the Entity.
+         * @param source_id[in] The ID of the Entity doing the referencing.
+         * @return A map of the referenced IDs to the fields on source_id
+         * that reference them.
+         */
+        dbtype::Entity::IdFieldsMap internal_get_references_from(
+            const dbtype::Id &source_id);
+
+        /**
+         * ** Internal namespace use only **
+         * Finds a program's ID by regname.  Checks the database (or its
+         * cache) only; renames in progress will not be found.
          * @param site_id[in] The site ID to check.
          * @param regname[in] The registration name to look for.
          * @param prog_id[out] The ID of the found program.  If the
@@ -403,8 +608,8 @@ namespace dbinterface
 
         /**
          * ** Internal namespace use only **
-         * Finds a program's regname by ID.  Checks the database only;
-         * renames in progress will not be found.
+         * Finds a program's regname by ID.  Checks the database (or its
+         * cache) only; renames in progress will not be found.
          * @param prog_id[in] The ID of the program whose registration name
          * is to be looked up.
          * @param regname[out] The found registration name.  Will be
@@ -418,6 +623,18 @@ namespace dbinterface
             const dbtype::Id &prog_id,
             std::string &regname);
 
+        /**
+         * ** Internal namespace use only **
+         * Lets the program registration name cache know a change to a
+         * Program's registration name, or the deletion of an Entity, has
+         * been committed to the database.
+         * @param prog_id[in] The ID of the changed or deleted Entity.
+         * @param deleted[in] True if the Entity was deleted.
+         */
+        void internal_program_reg_changed(
+            const dbtype::Id &prog_id,
+            const bool deleted);
+
     private:
         /**
          * Private singleton constructor.
@@ -462,6 +679,47 @@ namespace dbinterface
          */
         void add_site_info_to_cache(const dbtype::Id::SiteIdType site_id);
 
+        /** How many Entities a warm-up thread loads at a time */
+        static const size_t WARM_UP_CHUNK_SIZE = 64;
+
+        /**
+         * The Entities to be loaded by the warm-up threads, and how far
+         * along they are.
+         */
+        struct WarmUpWork
+        {
+            WarmUpWork(void)
+              : next_chunk(0),
+                entities_total(0),
+                entities_loaded(0),
+                entities_skipped(0),
+                next_progress_percent(10)
+            {
+            }
+
+            boost::mutex mutex; ///< Protects everything below
+            std::vector<dbtype::Entity::IdVector> chunks; ///< Each chunk is from a single site
+            size_t next_chunk; ///< Index of the next chunk to be loaded
+            size_t entities_total; ///< Entities in all chunks
+            size_t entities_loaded; ///< Entities in chunks that are done
+            size_t entities_skipped; ///< Entities not loaded because the cache was full
+            size_t next_progress_percent; ///< When to next log progress
+        };
+
+        /**
+         * Loads the most recently accessed Entities of each site into the
+         * cache, using several threads.  Progress and timing are logged.
+         * @param site_ids[in] The sites to warm up.
+         */
+        void warm_up_cache(const dbtype::Id::SiteIdVector &site_ids);
+
+        /**
+         * Run by each warm-up thread; loads chunks of Entities until there
+         * are none left.
+         * @param work[in,out] The Entities to be loaded.
+         */
+        void warm_up_worker(WarmUpWork &work);
+
         typedef std::map<dbtype::Id::SiteIdType, SiteCache *> CacheMap;
         typedef std::map<dbtype::Id::SiteIdType, SiteInfo> SiteIdToInfo;
         typedef std::vector<DatabaseEntityListener *> EntityListenerList;
@@ -472,7 +730,9 @@ namespace dbinterface
         CacheMap entity_cache; ///< Cache of entities, organized by site.
         SiteIdToInfo site_id_to_info_cache; ///< All known existing site IDs and their info
         unsigned short int player_name_ser; ///< Looping serial number for temporary player creation name
-        boost::mutex mutex; ///< Enforces single access at a time.
+        boost::shared_mutex mutex; ///< Protects entity_cache and site_id_to_info_cache.
+        boost::mutex player_create_mutex; ///< Serializes creating Players
+        boost::mutex site_change_mutex; ///< Serializes site name and description changes
     };
 }
 }
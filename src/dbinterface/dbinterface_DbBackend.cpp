@@ -9,8 +9,12 @@
 #include "dbtypes/dbtype_Id.h"
 #include "concurrency/concurrency_WriterLockToken.h"
 
+#include "dbtypes/dbtype_CompactArchive.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "utilities/utility_MemoryBuffer.h"
+#include "logging/log_Logger.h"
+
 #include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
 
 #include "dbtypes/dbtype_Group.h"
 #include "dbtypes/dbtype_Capability.h"
@@ -32,6 +36,195 @@ namespace mutgos
 {
 namespace dbinterface
 {
+    namespace
+    {
+        /**
+         * Deserializes an Entity of a particular class from the given archive.
+         * @param archive[in] The archive to deserialize from.
+         * @param existing_ptr[in] The Entity to deserialize into, or null to
+         * create a new one.  An existing Entity has already set what it is
+         * decoding.
+         * @param phase[in] What to decode, if creating a new Entity.
+         * @return The Entity deserialized into, or null if existing_ptr is
+         * not of the class.
+         */
+        template<class EntityClass, class Archive>
+        dbtype::Entity *deserialize_as(
+            Archive &archive,
+            dbtype::Entity *existing_ptr,
+            const dbtype::Entity::DecodePhase phase)
+        {
+            EntityClass *entity_ptr = 0;
+
+            if (existing_ptr)
+            {
+                entity_ptr = dynamic_cast<EntityClass *>(existing_ptr);
+
+                if (entity_ptr)
+                {
+                    archive >> *entity_ptr;
+                }
+            }
+            else
+            {
+                entity_ptr = new EntityClass();
+
+                entity_ptr->set_decode_phase(phase);
+                archive >> *entity_ptr;
+                entity_ptr->set_decode_phase(dbtype::Entity::DECODE_all);
+            }
+
+            return entity_ptr;
+        }
+
+        /**
+         * Given a type, creates a corresponding new Entity in memory only (or
+         * uses an existing one), and deserializes it from the given archive.
+         * @param type[in] The type of Entity to deserialize.
+         * @param archive[in] The archive to deserialize from.
+         * @param existing_ptr[in] The Entity to deserialize into, or null to
+         * create a new one.
+         * @param phase[in] What to decode, if creating a new Entity.
+         * @return The pointer to the deserialized entity, or null if invalid
+         * type.  restore_complete() has not been called on a new Entity.
+         */
+        template<class Archive>
+        dbtype::Entity *deserialize_from_archive(
+            const dbtype::EntityType type,
+            Archive &archive,
+            dbtype::Entity *existing_ptr,
+            const dbtype::Entity::DecodePhase phase)
+        {
+            dbtype::Entity *entity_ptr = 0;
+
+            switch (type)
+            {
+                case dbtype::ENTITYTYPE_group:
+                {
+                    entity_ptr = deserialize_as<dbtype::Group>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_capability:
+                {
+                    entity_ptr = deserialize_as<dbtype::Capability>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_container_property_entity:
+                {
+                    entity_ptr = deserialize_as<dbtype::ContainerPropertyEntity>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_region:
+                {
+                    entity_ptr = deserialize_as<dbtype::Region>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_room:
+                {
+                    entity_ptr = deserialize_as<dbtype::Room>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_player:
+                {
+                    entity_ptr = deserialize_as<dbtype::Player>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_guest:
+                {
+                    entity_ptr = deserialize_as<dbtype::Guest>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_thing:
+                {
+                    entity_ptr = deserialize_as<dbtype::Thing>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_puppet:
+                {
+                    entity_ptr = deserialize_as<dbtype::Puppet>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_vehicle:
+                {
+                    entity_ptr = deserialize_as<dbtype::Vehicle>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_program:
+                {
+                    entity_ptr = deserialize_as<dbtype::Program>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_exit:
+                {
+                    entity_ptr = deserialize_as<dbtype::Exit>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_command:
+                {
+                    entity_ptr = deserialize_as<dbtype::Command>(
+                        archive,
+                        existing_ptr,
+                        phase);
+                    break;
+                }
+
+                default:
+                {
+                }
+            }
+
+            return entity_ptr;
+        }
+    }
+
     // ----------------------------------------------------------------------
     DbBackend::DbBackend(void)
     {
@@ -54,6 +247,133 @@ namespace dbinterface
         return true;
     }
 
+    // ----------------------------------------------------------------------
+    void DbBackend::get_entities_db(
+        const dbtype::Entity::IdVector &ids,
+        EntityPtrVector &entities)
+    {
+        entities.clear();
+        entities.reserve(ids.size());
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+             id_iter != ids.end();
+             ++id_iter)
+        {
+            entities.push_back(get_entity_db(*id_iter));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::save_entities_db(
+        const EntityPtrVector &entities,
+        dbtype::Entity::IdVector &failed_ids)
+    {
+        bool success = true;
+
+        for (EntityPtrVector::const_iterator entity_iter = entities.begin();
+             entity_iter != entities.end();
+             ++entity_iter)
+        {
+            if (*entity_iter and (not save_entity_db(*entity_iter)))
+            {
+                failed_ids.push_back((*entity_iter)->get_entity_id());
+                success = false;
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::begin_transaction_db(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::commit_transaction_db(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::begin_bulk_load_db(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::end_bulk_load_db(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::start_backup_db(const std::string &backup_file)
+    {
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    BackupStatus DbBackend::get_backup_status_db(void)
+    {
+        return BackupStatus();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::references_saved_db(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::visit_site_entities_db(
+        const dbtype::Id::SiteIdType site_id,
+        EntityVisitor &visitor)
+    {
+        bool success = true;
+        const dbtype::Entity::IdVector ids = find_in_db(site_id);
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            success and (id_iter != ids.end());
+            ++id_iter)
+        {
+            // A private copy, so the site cache cannot free it (or have
+            // it freed) while it is being visited.
+            dbtype::Entity * const entity_ptr = load_entity_copy_db(*id_iter);
+
+            if (not entity_ptr)
+            {
+                LOG(error, "dbinterface", "visit_site_entities_db",
+                    "Could not get Entity " + id_iter->to_string(true));
+                success = false;
+            }
+            else
+            {
+                success = visitor.visit_entity(entity_ptr);
+                delete entity_ptr;
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *DbBackend::load_entity_copy_db(const dbtype::Id &id)
+    {
+        LOG(error, "dbinterface", "load_entity_copy_db",
+            "Not supported by this backend.");
+        return 0;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector DbBackend::get_recently_accessed_db(
+        const dbtype::Id::SiteIdType site_id,
+        const size_t max_entities)
+    {
+        return dbtype::Entity::IdVector();
+    }
+
     // ----------------------------------------------------------------------
     bool DbBackend::added_mem_owned(dbtype::Entity *entity_ptr)
     {
@@ -177,6 +497,34 @@ namespace dbinterface
         return result_ptr;
     }
 
+    // ----------------------------------------------------------------------
+    dbtype::EntityType DbBackend::get_entity_type_mem(const dbtype::Id &id)
+    {
+        dbtype::EntityType type = dbtype::ENTITYTYPE_invalid;
+
+        if (not id.is_default())
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(
+                entity_mem_map_mutex);
+
+            OwnedSiteMemMap::iterator site_iter =
+                owned_entity_mem_map.find(id.get_site_id());
+
+            if (site_iter != owned_entity_mem_map.end())
+            {
+                OwnedEntityMemMap::iterator iter =
+                    site_iter->second.find(id.get_entity_id());
+
+                if (iter != site_iter->second.end())
+                {
+                    type = iter->second->get_entity_type();
+                }
+            }
+        }
+
+        return type;
+    }
+
     // ----------------------------------------------------------------------
     bool DbBackend::any_mem_owned(void)
     {
@@ -307,135 +655,61 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     dbtype::Entity* DbBackend::make_deserialize_entity(
         const dbtype::EntityType type,
-        utility::MemoryBuffer &buffer)
+        const void *data_ptr,
+        const size_t data_size,
+        const bool full_decode)
     {
         dbtype::Entity *entity_ptr = 0;
-        boost::archive::binary_iarchive archive(buffer);
 
-        switch (type)
+        if (dbtype::CompactArchive::is_compact_format(data_ptr, data_size))
         {
-            case dbtype::ENTITYTYPE_group:
-            {
-                dbtype::Group *group_ptr = new dbtype::Group();
-                archive >> *group_ptr;
-
-                entity_ptr = group_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_capability:
-            {
-                dbtype::Capability *capability_ptr = new dbtype::Capability();
-                archive >> *capability_ptr;
-
-                entity_ptr = capability_ptr;
-                break;
-            }
+            dbtype::CompactIArchive archive(data_ptr, data_size);
 
-            case dbtype::ENTITYTYPE_container_property_entity:
-            {
-                dbtype::ContainerPropertyEntity *containerprop_ptr =
-                    new dbtype::ContainerPropertyEntity();
-                archive >> *containerprop_ptr;
-
-                entity_ptr = containerprop_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_region:
+            if (not archive.good())
             {
-                dbtype::Region *region_ptr = new dbtype::Region();
-                archive >> *region_ptr;
-
-                entity_ptr = region_ptr;
-                break;
+                LOG(error, "dbinterface", "make_deserialize_entity",
+                    "Entity data is from an unsupported format version.");
             }
-
-            case dbtype::ENTITYTYPE_room:
-            {
-                dbtype::Room *room_ptr = new dbtype::Room();
-                archive >> *room_ptr;
-
-                entity_ptr = room_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_player:
-            {
-                dbtype::Player *player_ptr = new dbtype::Player();
-                archive >> *player_ptr;
-
-                entity_ptr = player_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_guest:
-            {
-                dbtype::Guest *guest_ptr = new dbtype::Guest();
-                archive >> *guest_ptr;
-
-                entity_ptr = guest_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_thing:
-            {
-                dbtype::Thing *thing_ptr = new dbtype::Thing();
-                archive >> *thing_ptr;
-
-                entity_ptr = thing_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_puppet:
-            {
-                dbtype::Puppet *puppet_ptr = new dbtype::Puppet();
-                archive >> *puppet_ptr;
-
-                entity_ptr = puppet_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_vehicle:
-            {
-                dbtype::Vehicle *vehicle_ptr = new dbtype::Vehicle();
-                archive >> *vehicle_ptr;
-
-                entity_ptr = vehicle_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_program:
-            {
-                dbtype::Program *program_ptr = new dbtype::Program();
-                archive >> *program_ptr;
-
-                entity_ptr = program_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_exit:
-            {
-                dbtype::Exit *exit_ptr = new dbtype::Exit();
-                archive >> *exit_ptr;
-
-                entity_ptr = exit_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_command:
+            else
             {
-                dbtype::Command *command_ptr = new dbtype::Command();
-                archive >> *command_ptr;
-
-                entity_ptr = command_ptr;
-                break;
-            }
+                entity_ptr = deserialize_from_archive(
+                    type,
+                    archive,
+                    0,
+                    full_decode ?
+                        dbtype::Entity::DECODE_all :
+                        dbtype::Entity::DECODE_header);
+
+                if (entity_ptr and (not archive.good()))
+                {
+                    LOG(error, "dbinterface", "make_deserialize_entity",
+                        "Entity data is corrupt: "
+                        + entity_ptr->get_entity_id().to_string(true));
 
-            default:
-            {
+                    delete entity_ptr;
+                    entity_ptr = 0;
+                }
+                else if (entity_ptr and (not full_decode))
+                {
+                    // The rest is decoded by load_entity_body() when
+                    // first needed.
+                    entity_ptr->defer_body(data_ptr, data_size, this);
+                }
             }
         }
+        else
+        {
+            // Legacy format, from before the database was migrated.
+            //
+            utility::MemoryBuffer buffer(data_ptr, data_size);
+            boost::archive::binary_iarchive archive(buffer);
+
+            entity_ptr = deserialize_from_archive(
+                type,
+                archive,
+                0,
+                dbtype::Entity::DECODE_all);
+        }
 
         if (entity_ptr)
         {
@@ -445,16 +719,42 @@ namespace dbinterface
         return entity_ptr;
     }
 
+    // ----------------------------------------------------------------------
+    bool DbBackend::load_entity_body(
+        dbtype::Entity *entity_ptr,
+        const std::string &data)
+    {
+        bool success = false;
+
+        if (entity_ptr)
+        {
+            dbtype::CompactIArchive archive(data.data(), data.size());
+
+            success = archive.good() and
+                (deserialize_from_archive(
+                    entity_ptr->get_entity_type(),
+                    archive,
+                    entity_ptr,
+                    dbtype::Entity::DECODE_body) == entity_ptr) and
+                archive.good();
+        }
+
+        return success;
+    }
+
     // ----------------------------------------------------------------------
     bool DbBackend::serialize_entity(
         dbtype::Entity *entity_ptr,
-        utility::MemoryBuffer &buffer)
+        std::string &buffer)
     {
-        bool success = entity_ptr;
+        // An Entity that was only partially decoded must be fully decoded
+        // before it can be written back out.
+        //
+        bool success = entity_ptr and entity_ptr->ensure_body_loaded();
 
         if (success)
         {
-            boost::archive::binary_oarchive archive(buffer);
+            dbtype::CompactOArchive archive(buffer);
 
             switch (entity_ptr->get_entity_type())
             {
@@ -690,5 +990,50 @@ namespace dbinterface
 
         return success;
     }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::serialize_application_properties(
+        const dbtype::ApplicationProperties &properties,
+        std::string &buffer)
+    {
+        dbtype::CompactOArchive archive(buffer);
+
+        archive << properties;
+
+        return not buffer.empty();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::deserialize_application_properties(
+        const void *data_ptr,
+        const size_t data_size,
+        dbtype::ApplicationProperties &properties)
+    {
+        dbtype::CompactIArchive archive(data_ptr, data_size);
+        bool success = archive.good();
+
+        if (success)
+        {
+            // Use a temporary so properties is untouched if corrupt.
+            dbtype::ApplicationProperties loaded_properties;
+
+            archive >> loaded_properties;
+            success = archive.good();
+
+            if (success)
+            {
+                properties = loaded_properties;
+            }
+        }
+
+        if (not success)
+        {
+            LOG(error, "dbinterface", "deserialize_application_properties",
+                "Application properties data is corrupt or from an "
+                "unsupported format version.");
+        }
+
+        return success;
+    }
 }
 }
@@ -8,15 +8,19 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <stddef.h>
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_EntityType.h"
 #include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_TimeStamp.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_EntityBodyLoader.h"
 
 #include "dbinterface/dbinterface_CommonTypes.h"
 #include "dbinterface/dbinterface_EntityMetadata.h"
-
-#include "utilities/utility_MemoryBuffer.h"
+#include "dbinterface/dbinterface_BackupStatus.h"
+#include "dbinterface/dbinterface_EntityVisitor.h"
 
 #include <boost/thread/shared_mutex.hpp>
 
@@ -44,11 +48,24 @@ namespace dbinterface
      * free up its ID for another to use.  Site IDs start at 0, Entity IDs
      * start at 1.
      *
+     * Entities loaded from the compact archive format only have their
+     * header decoded at first; DbBackend decodes the rest when the Entity
+     * first needs it.
+     *
      * This code must be thread safe.
      */
-    class DbBackend
+    class DbBackend : public dbtype::EntityBodyLoader
     {
     public:
+        /** Batch of Entity pointers to be saved together */
+        typedef std::vector<dbtype::Entity *> EntityPtrVector;
+
+        /** An Entity's last accessed timestamp and access count */
+        typedef std::pair<dbtype::TimeStamp, dbtype::Entity::AccessCountType>
+            AccessStats;
+        /** Maps an Entity ID to its most recent access statistics */
+        typedef std::map<dbtype::Id, AccessStats> AccessStatsMap;
+
         /**
          * Default.
          */
@@ -122,6 +139,23 @@ namespace dbinterface
          */
         virtual dbtype::Entity *get_entity_db(const dbtype::Id &id) =0;
 
+        /**
+         * Gets several Entities from the database.  Entities already present
+         * in memory are returned as-is.  This will generally be more
+         * efficient than getting one at a time.
+         * The default implementation simply calls get_entity_db() for each
+         * ID.
+         * Caller must manage the pointers and delete them with
+         * delete_entity_mem().
+         * @param ids[in] The IDs of the Entities to retrieve.
+         * @param entities[out] The Entities retrieved, one per ID and in the
+         * same order as ids.  An Entity not found will be null.  Any
+         * existing contents are replaced.
+         */
+        virtual void get_entities_db(
+            const dbtype::Entity::IdVector &ids,
+            EntityPtrVector &entities);
+
         /**
          * Determines if the given entity ID exists in the database.
          * @param id[in] The ID to check.
@@ -137,6 +171,92 @@ namespace dbinterface
          */
         virtual bool save_entity_db(dbtype::Entity *entity_ptr) =0;
 
+        /**
+         * Saves a batch of Entities to the database.  This will generally
+         * be more efficient than saving one at a time, especially when
+         * done while a transaction is open.
+         * The default implementation simply calls save_entity_db() for each
+         * Entity.
+         * @param entities[in] The Entities to save.
+         * @param failed_ids[out] The IDs of any Entities that could not be
+         * saved will be appended to this.
+         * @return True if all Entities were saved, false if any failed.
+         */
+        virtual bool save_entities_db(
+            const EntityPtrVector &entities,
+            dbtype::Entity::IdVector &failed_ids);
+
+        /**
+         * Starts a transaction.  Until commit_transaction_db() is called,
+         * all modifications to the database (saves, deletes, site deletes,
+         * etc) are grouped together and either all applied or none applied.
+         * This is primarily used to flush many changes at once without
+         * paying the cost of an individual commit for each.
+         * Whether modifications made by other threads while the
+         * transaction is open become part of it depends on the backend.
+         * Only one transaction may be open at a time.
+         * The default implementation does nothing and returns true.
+         * @return True if the transaction was started, false if error or
+         * one is already in progress.
+         */
+        virtual bool begin_transaction_db(void);
+
+        /**
+         * Commits the transaction started with begin_transaction_db().
+         * If the commit fails, the transaction is rolled back and the
+         * caller should assume nothing done since begin_transaction_db()
+         * was saved.
+         * The default implementation does nothing and returns true.
+         * @return True if the transaction was committed, false if error
+         * (rolled back) or no transaction was open.
+         */
+        virtual bool commit_transaction_db(void);
+
+        /**
+         * Prepares the database to have a large number of Entities loaded
+         * at once, such as when reading in a dump.  The backend may trade
+         * away durability and concurrency until end_bulk_load_db() is
+         * called, for instance by putting everything in one transaction
+         * or deferring the building of secondary indexes.  Reads must
+         * still see everything written during the bulk load.
+         * Must be called while the database is otherwise idle.  While a
+         * bulk load is in progress, begin_transaction_db() and
+         * commit_transaction_db() may become part of it.
+         * The default implementation does nothing and returns true.
+         * @return True if the bulk load was started, false if error or
+         * one is already in progress.
+         */
+        virtual bool begin_bulk_load_db(void);
+
+        /**
+         * Finishes a bulk load started with begin_bulk_load_db(),
+         * building anything that was deferred and making everything
+         * durable.
+         * The default implementation does nothing and returns true.
+         * @return True if success, false if error or no bulk load was
+         * in progress.
+         */
+        virtual bool end_bulk_load_db(void);
+
+        /**
+         * Starts copying the database to a backup file in the background,
+         * while the database stays in use.  Progress can be checked with
+         * get_backup_status_db().
+         * The default implementation does nothing and returns false, for
+         * backends that cannot do online backups.
+         * @param backup_file[in] The file to write the backup to.  Any
+         * existing file is replaced when the backup completes.
+         * @return True if the backup was started, false if error or a
+         * backup is already running.
+         */
+        virtual bool start_backup_db(const std::string &backup_file);
+
+        /**
+         * The default implementation returns an empty status.
+         * @return The progress of the current or most recent backup.
+         */
+        virtual BackupStatus get_backup_status_db(void);
+
         /**
          * Deletes the given Entity from the database.  If the Entity is
          * currently in memory, deletion will fail.
@@ -152,6 +272,63 @@ namespace dbinterface
          */
         virtual dbtype::EntityType get_entity_type_db(const dbtype::Id &id) =0;
 
+        /**
+         * Saves the access statistics (last accessed timestamp and access
+         * count) of Entities.  These are saved apart from the rest of the
+         * Entity, so merely accessing an Entity never causes it to be
+         * saved in full.  The saved statistics must be applied to the
+         * Entity when it is next loaded.  Statistics for Entities that no
+         * longer exist are ignored.
+         * @param stats[in] The access statistics to save.
+         * @return True if success.
+         */
+        virtual bool save_access_stats_db(const AccessStatsMap &stats) =0;
+
+        /**
+         * Updates the reference index with the ID fields that changed on
+         * an Entity.  The index mirrors the reverse references kept on each
+         * Entity, so reverse lookups can be done without loading anything.
+         * References to or from an Entity or site are removed from the
+         * index when it is deleted.
+         * @param source_id[in] The ID of the Entity whose fields changed.
+         * @param changed_fields[in] The IDs removed and added, per field.
+         * @return True if success.
+         */
+        virtual bool update_references_db(
+            const dbtype::Id &source_id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields) =0;
+
+        /**
+         * Called during a commit batch once every Entity changed by earlier
+         * calls to update_references_db() has been saved in it.  A backend
+         * that writes the reference index apart from the Entities can note
+         * here that the two agree again.  The default does nothing.
+         * @return True if success.
+         */
+        virtual bool references_saved_db(void);
+
+        /**
+         * Uses the reference index to find the Entities referencing an
+         * Entity by a particular field.
+         * @param target_id[in] The ID of the Entity being referenced.
+         * @param field[in] The field on the other Entities doing the
+         * referencing.
+         * @return The IDs of the Entities whose field references target_id,
+         * or empty if none or error.
+         */
+        virtual dbtype::Entity::IdVector get_references_to_db(
+            const dbtype::Id &target_id,
+            const dbtype::EntityField field) =0;
+
+        /**
+         * Uses the reference index to find everything an Entity references.
+         * @param source_id[in] The ID of the Entity doing the referencing.
+         * @return A map of the referenced IDs to the fields on source_id
+         * that reference them, or empty if none or error.
+         */
+        virtual dbtype::Entity::IdFieldsMap get_references_from_db(
+            const dbtype::Id &source_id) =0;
+
         /**
          * Searches for entities using the parameters specified that
          * contain the given string somewhere in their name, or an exact
@@ -182,6 +359,38 @@ namespace dbinterface
         virtual dbtype::Entity::IdVector find_in_db(
             const dbtype::Id::SiteIdType site_id) =0;
 
+        /**
+         * Calls the visitor with every Entity in a site, in Entity ID
+         * order, without keeping the site in memory.  Entities are visited
+         * as they were last saved to the database; use this when the
+         * Entities are not otherwise being changed, such as when writing
+         * a dump.  Different sites may be visited by different threads at
+         * the same time.
+         * The default implementation loads a private copy of each Entity
+         * one at a time using load_entity_copy_db(), freeing it after it
+         * has been visited.
+         * @param site_id[in] The site whose Entities are to be visited.
+         * @param visitor[in] What to call for each Entity.
+         * @return True if every Entity was visited, false if error or the
+         * visitor stopped early.
+         */
+        virtual bool visit_site_entities_db(
+            const dbtype::Id::SiteIdType site_id,
+            EntityVisitor &visitor);
+
+        /**
+         * Used to pick what to load into the cache at startup.
+         * The default implementation does not track access, and returns
+         * nothing.
+         * @param site_id[in] The site to get Entity IDs for.
+         * @param max_entities[in] The most IDs to return.
+         * @return The IDs of the site's Entities, most recently accessed
+         * first (and then most accessed), up to max_entities.
+         */
+        virtual dbtype::Entity::IdVector get_recently_accessed_db(
+            const dbtype::Id::SiteIdType site_id,
+            const size_t max_entities);
+
         /**
          * Searches the given site for the program registration name.
          * @param site_id[in] The site ID to search for the program
@@ -285,7 +494,32 @@ namespace dbinterface
             const dbtype::Id::SiteIdType site_id,
             const std::string &site_description) =0;
 
+        /**
+         * Decodes everything but the header of an Entity created by
+         * make_deserialize_entity().
+         * @param entity_ptr[in,out] The Entity to decode into.
+         * @param data[in] The serialized Entity, as originally loaded.
+         * @return True if success, false if the data is corrupt.
+         */
+        virtual bool load_entity_body(
+            dbtype::Entity *entity_ptr,
+            const std::string &data);
+
     protected:
+        /**
+         * Loads a copy of an Entity as it was last saved to the database.
+         * The copy is not owned by this DbBackend and is never handed out
+         * by get_entity_db(), so it cannot be changed or freed by anyone
+         * else while it is being used.  Backends using the default
+         * visit_site_entities_db() must override this; the default always
+         * fails.
+         * Caller must manage the pointer, and must not delete this
+         * DbBackend while the Entity exists.
+         * @param id[in] The ID of the Entity to load.
+         * @return The copy, or null if not found or error.
+         */
+        virtual dbtype::Entity *load_entity_copy_db(const dbtype::Id &id);
+
         /**
          * Adds an entity pointer as being owned by this DbBackend.
          * @param entity_ptr[in] The entity pointer to mark as owned.
@@ -321,6 +555,16 @@ namespace dbinterface
          */
         dbtype::Entity *get_entity_pointer(const dbtype::Id &id);
 
+        /**
+         * Gets the type of an Entity in memory.  The in-memory lookup table
+         * stays locked while the Entity is looked at, so it cannot be
+         * freed by delete_entity_mem() in the meantime.
+         * @param id[in] The ID of the Entity.
+         * @return The type of the Entity, or invalid if not in memory or
+         * not owned by this DbBackend.
+         */
+        dbtype::EntityType get_entity_type_mem(const dbtype::Id &id);
+
         /**
          * @return True if any pointers are owned by this DbBackend.
          */
@@ -346,26 +590,69 @@ namespace dbinterface
         /**
          * Given a type, creates a corresponding new Entity in memory only, and
          * deserializes it.
-         * Caller must manage the pointer.
+         * Both the compact archive format and legacy Boost binary archives
+         * are supported.  For the compact format, normally only the
+         * Entity header is decoded here; the data is copied into the
+         * Entity and the rest is decoded the first time it is accessed.
+         * Legacy archives are always decoded in full, in place.
+         * Caller must manage the pointer, and must not delete this
+         * DbBackend while the Entity exists.
          * @param type[in] The type of Entity to deserialize.
-         * @param_type[in,out] The buffer of data to be deserialized.  The
-         * position within the buffer is modified.
+         * @param data_ptr[in] The serialized Entity.
+         * @param data_size[in] The size of the serialized Entity, in bytes.
+         * @param full_decode[in] True to decode the entire Entity now, for
+         * Entities that are only briefly used.
          * @return The pointer to the newly created and deserialized entity,
          * or null if error or invalid type.
+         * @see dbtype::CompactArchive
          */
         dbtype::Entity *make_deserialize_entity(
             const dbtype::EntityType type,
-            utility::MemoryBuffer &buffer);
+            const void *data_ptr,
+            const size_t data_size,
+            const bool full_decode = false);
 
         /**
-         * Given an Entity, serialize it and place the result into the buffer.
+         * Given an Entity, serialize it in the compact archive format and
+         * place the result into the buffer.
          * @param entity_ptr[in] The Entity to serialize.
-         * @param buffer[out] The serialized Entity placed in the buffer.
+         * @param buffer[out] The serialized Entity.  Any existing contents
+         * are replaced, but the capacity is kept so the buffer can be reused.
          * @return True if success, false if error.
+         * @see dbtype::CompactArchive
          */
         bool serialize_entity(
             dbtype::Entity *entity_ptr,
-            utility::MemoryBuffer &buffer);
+            std::string &buffer);
+
+        /**
+         * Serializes an application's properties in the compact archive
+         * format, for backends that store them separately from the
+         * PropertyEntity they belong to.
+         * @param properties[in] The application properties to serialize.
+         * @param buffer[out] The serialized properties.  Any existing
+         * contents are replaced, but the capacity is kept so the buffer can
+         * be reused.
+         * @return True if success, false if error.
+         * @see dbtype::PropertyEntity
+         */
+        bool serialize_application_properties(
+            const dbtype::ApplicationProperties &properties,
+            std::string &buffer);
+
+        /**
+         * Deserializes application properties previously serialized by
+         * serialize_application_properties().
+         * @param data_ptr[in] The serialized application properties.
+         * @param data_size[in] The size of the serialized data, in bytes.
+         * @param properties[out] The deserialized application properties.
+         * Unchanged if error.
+         * @return True if success, false if error or corrupt data.
+         */
+        bool deserialize_application_properties(
+            const void *data_ptr,
+            const size_t data_size,
+            dbtype::ApplicationProperties &properties);
 
     private:
         // Map of entity ID to the entity pointer.
@@ -0,0 +1,21 @@
+/*
+ * dbinterface_EntityVisitor.cpp
+ */
+
+#include "dbinterface/dbinterface_EntityVisitor.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    // ----------------------------------------------------------------------
+    EntityVisitor::EntityVisitor(void)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    EntityVisitor::~EntityVisitor()
+    {
+    }
+}
+}
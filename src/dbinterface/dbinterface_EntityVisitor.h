@@ -0,0 +1,45 @@
+/*
+ * dbinterface_EntityVisitor.h
+ */
+
+#ifndef MUTGOS_DBINTERFACE_ENTITYVISITOR_H
+#define MUTGOS_DBINTERFACE_ENTITYVISITOR_H
+
+#include "dbtypes/dbtype_Entity.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    /**
+     * Implemented by anything that needs to look at every Entity in a
+     * site without loading the whole site into memory at once, such as
+     * the dump writer.
+     * @see DbBackend::visit_site_entities_db()
+     */
+    class EntityVisitor
+    {
+    public:
+        /**
+         * Default constructor.
+         */
+        EntityVisitor(void);
+
+        /**
+         * Destructor.
+         */
+        virtual ~EntityVisitor();
+
+        /**
+         * Called once for each Entity visited.
+         * The Entity may be a temporary copy that is deleted as soon as
+         * this returns; do not keep the pointer.  It must not be modified.
+         * @param entity_ptr[in] The Entity being visited.
+         * @return True to continue visiting, false to stop.
+         */
+        virtual bool visit_entity(dbtype::Entity *entity_ptr) =0;
+    };
+}
+}
+
+#endif //MUTGOS_DBINTERFACE_ENTITYVISITOR_H
@@ -1,7 +1,11 @@
 #include "dbinterface_SiteCache.h"
 
+#include <vector>
+
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include "dbtypes/dbtype_Id.h"
 
@@ -13,6 +17,14 @@
 
 #include "logging/log_Logger.h"
 
+namespace
+{
+    /** Most registration names cached per site.  Names that are not
+        registered are cached too, so this keeps lookups of arbitrary
+        names from growing the cache forever. */
+    const size_t MAX_CACHED_PROG_REG_NAMES = 4096;
+}
+
 namespace mutgos
 {
 namespace dbinterface
@@ -20,10 +32,20 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     SiteCache::SiteCache(
         DbBackend *db_backend,
-        const dbtype::Id::SiteIdType site)
+        const dbtype::Id::SiteIdType site,
+        const size_t max_mem_bytes)
       : db_backend_ptr(db_backend),
         site_id(site),
-        delete_pending(false)
+        delete_pending(false),
+        max_bytes(max_mem_bytes),
+        resident_bytes(0),
+        clock_hand(0),
+        hits(0),
+        misses(0),
+        evictions(0),
+        prog_reg_generation(0),
+        prog_reg_hits(0),
+        prog_reg_misses(0)
     {
         LOG(debug, "dbinterface", "SiteCache()",
             "Constructing site cache for site ID "
@@ -76,15 +98,13 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     void SiteCache::set_delete_pending(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        delete_pending = true;
+        delete_pending.store(true);
     }
 
     // ----------------------------------------------------------------------
     bool SiteCache::is_delete_pending(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        return delete_pending;
+        return delete_pending.load();
     }
 
     // ----------------------------------------------------------------------
@@ -100,24 +120,42 @@ namespace dbinterface
         }
         else
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
+            const dbtype::Id::EntityIdType entity_id = id.get_entity_id();
+            boost::unique_lock<boost::mutex> lock(mutex);
 
-            // See if it's already cached
+            // See if it's already cached, waiting for any load of it
+            // already in progress.
             //
-            EntityCacheMap::iterator find_iter =
-                cached_entities.find(id.get_entity_id());
+            EntityCacheMap::iterator find_iter = cached_entities.find(entity_id);
+
+            while ((find_iter == cached_entities.end()) and
+                loading_entities.count(entity_id))
+            {
+                loading_cond.wait(lock);
+                find_iter = cached_entities.find(entity_id);
+            }
 
             if (find_iter != cached_entities.end())
             {
                 // Found it in the cache
                 //
                 find_iter->second->get_reference(ref);
+                find_iter->second->set_recently_used(true);
+                ++hits;
             }
             else
             {
-                // Not cached, so load it
+                // Not cached, so load it.  The lock is released while
+                // loading so the rest of the site can still be served.
                 //
+                ++misses;
+                loading_entities.insert(entity_id);
+
+                lock.unlock();
                 dbtype::Entity *entity_ptr = db_backend_ptr->get_entity_db(id);
+                lock.lock();
+
+                loading_entities.erase(entity_id);
 
                 if (not entity_ptr)
                 {
@@ -125,20 +163,137 @@ namespace dbinterface
                 }
                 else
                 {
-                    // Make a new cache entry and get a reference
-                    //
-                    CachedEntity *cached_ptr = new CachedEntity(entity_ptr);
-                    cached_ptr->get_reference(ref);
-                    cached_entities[id.get_entity_id()] = cached_ptr;
-
-                    entity_ptr->set_entity_accessed_timestamp();
+                    add_loaded_entity(entity_ptr)->get_reference(ref);
                 }
+
+                loading_cond.notify_all();
             }
         }
 
         return return_code;
     }
 
+    // ----------------------------------------------------------------------
+    void SiteCache::get_entity_refs(
+        const dbtype::Entity::IdVector &ids,
+        EntityRefVector &refs,
+        const bool record_access)
+    {
+        // Entity ID to load, mapped to where it goes in refs.
+        typedef std::map<dbtype::Id::EntityIdType, std::vector<size_t> >
+            LoadPositions;
+
+        LoadPositions load_positions;
+        std::vector<size_t> wait_positions;
+        dbtype::Entity::IdVector load_ids;
+        DbBackend::EntityPtrVector loaded_entities;
+
+        refs.clear();
+        refs.resize(ids.size());
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        // Get everything already cached, and note what needs to be loaded
+        // or is being loaded by someone else.
+        //
+        for (size_t index = 0; index < ids.size(); ++index)
+        {
+            if (ids[index].get_site_id() == site_id)
+            {
+                const dbtype::Id::EntityIdType entity_id =
+                    ids[index].get_entity_id();
+                EntityCacheMap::iterator find_iter =
+                    cached_entities.find(entity_id);
+
+                if (find_iter != cached_entities.end())
+                {
+                    find_iter->second->get_reference(refs[index]);
+                    find_iter->second->set_recently_used(true);
+                    ++hits;
+                }
+                else if (load_positions.count(entity_id))
+                {
+                    // Asked for more than once.
+                    load_positions[entity_id].push_back(index);
+                }
+                else if (loading_entities.count(entity_id))
+                {
+                    wait_positions.push_back(index);
+                }
+                else
+                {
+                    loading_entities.insert(entity_id);
+                    load_positions[entity_id].push_back(index);
+                    load_ids.push_back(ids[index]);
+                }
+            }
+        }
+
+        if (not load_ids.empty())
+        {
+            // Load everything else at once, without holding the lock, and
+            // make new cache entries.  load_ids is in the same order as
+            // load_positions.
+            //
+            misses += load_ids.size();
+
+            lock.unlock();
+            db_backend_ptr->get_entities_db(load_ids, loaded_entities);
+            lock.lock();
+
+            size_t index = 0;
+
+            for (LoadPositions::const_iterator load_iter =
+                    load_positions.begin();
+                 load_iter != load_positions.end();
+                 ++load_iter, ++index)
+            {
+                loading_entities.erase(load_iter->first);
+
+                dbtype::Entity * const entity_ptr =
+                    (index < loaded_entities.size() ?
+                        loaded_entities[index] : 0);
+
+                if (entity_ptr)
+                {
+                    CachedEntity * const cached_ptr =
+                        add_loaded_entity(entity_ptr, record_access);
+
+                    for (std::vector<size_t>::const_iterator position_iter =
+                            load_iter->second.begin();
+                         position_iter != load_iter->second.end();
+                         ++position_iter)
+                    {
+                        cached_ptr->get_reference(refs[*position_iter]);
+                    }
+                }
+            }
+
+            loading_cond.notify_all();
+        }
+
+        lock.unlock();
+
+        // Anything another thread was loading is gotten individually, which
+        // waits for that load to finish.
+        //
+        for (std::vector<size_t>::const_iterator wait_iter =
+                wait_positions.begin();
+             wait_iter != wait_positions.end();
+             ++wait_iter)
+        {
+            get_entity_ref(ids[*wait_iter], refs[*wait_iter]);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteCache::is_full(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        return max_bytes and (resident_bytes >= max_bytes);
+    }
+
     // ----------------------------------------------------------------------
     bool SiteCache::is_entity_cached(const dbtype::Id &id)
     {
@@ -169,7 +324,12 @@ namespace dbinterface
         EntityCacheMap::iterator find_iter =
             cached_entities.find(id.get_entity_id());
 
-        if (find_iter != cached_entities.end())
+        if (loading_entities.count(id.get_entity_id()))
+        {
+            // Being loaded right now, so it is about to be in use.
+            deleted = false;
+        }
+        else if (find_iter != cached_entities.end())
         {
             // Found it in the cache.  Check if dirty or in use.
             //
@@ -179,10 +339,7 @@ namespace dbinterface
             if (deleted)
             {
                 // Can be deleted.  No one is using it and it's not dirty.
-                db_backend_ptr->delete_entity_mem(
-                    find_iter->second->get_entity());
-                delete find_iter->second;
-                cached_entities.erase(find_iter);
+                remove_cached_entity(find_iter);
             }
         }
 
@@ -192,12 +349,14 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     bool SiteCache::is_anything_referenced(void)
     {
-        bool referenced = false;
-
         boost::lock_guard<boost::mutex> guard(mutex);
 
+        // A load in progress has no reference yet, but the loader will
+        // come back to this cache when it is done.
+        bool referenced = not loading_entities.empty();
+
         for (EntityCacheMap::iterator iter = cached_entities.begin();
-             iter != cached_entities.end();
+             (not referenced) and (iter != cached_entities.end());
              ++iter)
         {
             if (iter->second->is_referenced())
@@ -210,5 +369,316 @@ namespace dbinterface
 
         return referenced;
     }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::enforce_memory_limit(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        if (max_bytes and (resident_bytes > max_bytes))
+        {
+            const MG_LongUnsignedInt starting_evictions = evictions;
+
+            // Each Entity gets at most two looks: one to clear the recently
+            // used flag, and one to evict it.
+            //
+            size_t examine_count = cached_entities.size() * 2;
+            EntityCacheMap::iterator iter =
+                cached_entities.lower_bound(clock_hand);
+            CachedEntity *cached_ptr = 0;
+
+            while ((resident_bytes > max_bytes) and examine_count
+                and (not cached_entities.empty()))
+            {
+                if (iter == cached_entities.end())
+                {
+                    // Wrap around
+                    iter = cached_entities.begin();
+                }
+
+                --examine_count;
+                cached_ptr = iter->second;
+
+                if (cached_ptr->is_referenced())
+                {
+                    // In use, can't touch it.
+                    ++iter;
+                }
+                else
+                {
+                    // Size may have changed since last measured.
+                    update_mem_size(cached_ptr);
+
+                    if (cached_ptr->get_entity()->is_dirty())
+                    {
+                        // Needs to be saved first.
+                        ++iter;
+                    }
+                    else if (cached_ptr->is_recently_used())
+                    {
+                        // Give it a second chance.
+                        cached_ptr->set_recently_used(false);
+                        ++iter;
+                    }
+                    else
+                    {
+                        remove_cached_entity(iter++);
+                        ++evictions;
+                    }
+                }
+            }
+
+            clock_hand = (iter == cached_entities.end()) ? 0 : iter->first;
+
+            LOG(debug, "dbinterface", "enforce_memory_limit",
+                "Site " + text::to_string(site_id) + " evicted "
+                + text::to_string(evictions - starting_evictions)
+                + " Entities.  Resident bytes: "
+                + text::to_string(resident_bytes));
+
+            if (resident_bytes > max_bytes)
+            {
+                LOG(warning, "dbinterface", "enforce_memory_limit",
+                    "Site " + text::to_string(site_id)
+                    + " is still over its cache memory limit; too many "
+                      "Entities are in use or dirty.");
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    CacheStats SiteCache::get_stats(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+        CacheStats stats;
+
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.evictions = evictions;
+        stats.resident_entities = cached_entities.size();
+        stats.resident_bytes = resident_bytes;
+        stats.max_bytes = max_bytes;
+
+        {
+            boost::lock_guard<boost::mutex> reg_guard(prog_reg_mutex);
+
+            stats.prog_reg_hits = prog_reg_hits;
+            stats.prog_reg_misses = prog_reg_misses;
+        }
+
+        return stats;
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::take_access_stats(DbBackend::AccessStatsMap &stats)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        if (stats.empty())
+        {
+            stats.swap(pending_access_stats);
+        }
+        else
+        {
+            stats.insert(
+                pending_access_stats.begin(),
+                pending_access_stats.end());
+            pending_access_stats.clear();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::restore_access_stats(
+        const DbBackend::AccessStatsMap &stats)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        // insert() leaves alone any Entity that already has newer stats.
+        pending_access_stats.insert(stats.begin(), stats.end());
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id SiteCache::find_program_reg(const std::string &reg_name)
+    {
+        const std::string lower_name = text::to_lower_copy(reg_name);
+        MG_LongUnsignedInt generation = 0;
+
+        {
+            boost::lock_guard<boost::mutex> guard(prog_reg_mutex);
+
+            const ProgRegNameCache::const_iterator name_iter =
+                prog_reg_by_name.find(lower_name);
+
+            if (name_iter != prog_reg_by_name.end())
+            {
+                ++prog_reg_hits;
+
+                return name_iter->second ?
+                    dbtype::Id(site_id, name_iter->second) : dbtype::Id();
+            }
+
+            ++prog_reg_misses;
+            generation = prog_reg_generation;
+        }
+
+        // Not cached.  Look it up without the lock, since the database may
+        // be slow.
+        //
+        const dbtype::Id prog_id =
+            db_backend_ptr->find_program_reg_in_db(site_id, reg_name);
+
+        {
+            boost::lock_guard<boost::mutex> guard(prog_reg_mutex);
+
+            // If anything changed while looking it up, what was found may
+            // already be out of date.
+            //
+            if (generation == prog_reg_generation)
+            {
+                if (prog_reg_by_name.size() >= MAX_CACHED_PROG_REG_NAMES)
+                {
+                    prog_reg_by_name.clear();
+                }
+
+                prog_reg_by_name[lower_name] = prog_id.get_entity_id();
+            }
+        }
+
+        return prog_id;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SiteCache::find_program_reg_name(
+        const dbtype::Id::EntityIdType entity_id)
+    {
+        MG_LongUnsignedInt generation = 0;
+
+        {
+            boost::lock_guard<boost::mutex> guard(prog_reg_mutex);
+
+            const ProgRegIdCache::const_iterator id_iter =
+                prog_reg_by_id.find(entity_id);
+
+            if (id_iter != prog_reg_by_id.end())
+            {
+                ++prog_reg_hits;
+                return id_iter->second;
+            }
+
+            ++prog_reg_misses;
+            generation = prog_reg_generation;
+        }
+
+        const std::string reg_name =
+            db_backend_ptr->find_program_reg_name_in_db(
+                dbtype::Id(site_id, entity_id));
+
+        {
+            boost::lock_guard<boost::mutex> guard(prog_reg_mutex);
+
+            if (generation == prog_reg_generation)
+            {
+                if (prog_reg_by_id.size() >= MAX_CACHED_PROG_REG_NAMES)
+                {
+                    prog_reg_by_id.clear();
+                }
+
+                prog_reg_by_id[entity_id] = reg_name;
+            }
+        }
+
+        return reg_name;
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::program_reg_changed(
+        const dbtype::Id::EntityIdType entity_id,
+        const bool deleted)
+    {
+        boost::lock_guard<boost::mutex> guard(prog_reg_mutex);
+
+        ++prog_reg_generation;
+        prog_reg_by_id.erase(entity_id);
+
+        if (deleted)
+        {
+            // Only names registered to it are affected.
+            //
+            ProgRegNameCache::iterator name_iter = prog_reg_by_name.begin();
+
+            while (name_iter != prog_reg_by_name.end())
+            {
+                if (name_iter->second == entity_id)
+                {
+                    name_iter = prog_reg_by_name.erase(name_iter);
+                }
+                else
+                {
+                    ++name_iter;
+                }
+            }
+        }
+        else
+        {
+            // The new name is not known here, and it may be cached as
+            // unregistered.  Renames are rare, so just start over.
+            prog_reg_by_name.clear();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::update_mem_size(CachedEntity *cached_ptr)
+    {
+        const size_t new_size = cached_ptr->get_entity()->mem_used();
+
+        resident_bytes -= cached_ptr->get_mem_size();
+        resident_bytes += new_size;
+        cached_ptr->set_mem_size(new_size);
+    }
+
+    // ----------------------------------------------------------------------
+    CachedEntity *SiteCache::add_loaded_entity(
+        dbtype::Entity *entity_ptr,
+        const bool record_access)
+    {
+        const dbtype::Id::EntityIdType entity_id =
+            entity_ptr->get_entity_id().get_entity_id();
+        EntityCacheMap::iterator find_iter = cached_entities.find(entity_id);
+
+        if (find_iter != cached_entities.end())
+        {
+            // Another load finished first.  The backend gives out only one
+            // instance per ID, so it is the same Entity.
+            //
+            return find_iter->second;
+        }
+
+        CachedEntity * const cached_ptr = new CachedEntity(entity_ptr);
+        update_mem_size(cached_ptr);
+        cached_entities[entity_id] = cached_ptr;
+
+        if (record_access)
+        {
+            entity_ptr->set_entity_accessed_timestamp();
+            pending_access_stats[entity_ptr->get_entity_id()] =
+                DbBackend::AccessStats(
+                    entity_ptr->get_entity_accessed_timestamp(),
+                    entity_ptr->get_entity_access_count());
+        }
+
+        return cached_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::remove_cached_entity(EntityCacheMap::iterator iter)
+    {
+        CachedEntity * const cached_ptr = iter->second;
+
+        resident_bytes -= cached_ptr->get_mem_size();
+        cached_entities.erase(iter);
+
+        db_backend_ptr->delete_entity_mem(cached_ptr->get_entity());
+        delete cached_ptr;
+    }
+}
 }
-}
\ No newline at end of file
@@ -2,23 +2,44 @@
 #define MUTGOS_DBINTERFACE_SITE_CACHE_H
 
 #include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <stddef.h>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic/atomic.hpp>
 
 #include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "osinterface/osinterface_OsTypes.h"
 
 #include "dbinterface_CachedEntity.h"
+#include "dbinterface_CacheStats.h"
 #include "dbinterface_DbBackend.h"
 #include "dbinterface_DbResultCode.h"
+#include "dbinterface_EntityRef.h"
 
 namespace mutgos
 {
 namespace dbinterface
 {
     /**
-     * This class manages the cache for a specific site.  Right now the cache
-     * is very simple - it doesn't evict old Entities.  This is an area
-     * that will need significant work post-demo.
+     * This class manages the cache for a specific site.
+     *
+     * The cache can be given a memory limit.  When enforce_memory_limit()
+     * is called and the cache is over the limit, Entities that are not
+     * referenced and not dirty are evicted using the CLOCK algorithm (an
+     * approximation of least recently used) until it is under the limit.
+     * Memory use is tracked via Entity::mem_used(), measured when an Entity
+     * is loaded and again whenever eviction examines it, so it is
+     * approximate.
+     *
+     * Entities are loaded from the database without holding the cache
+     * lock, so a slow load does not hold up the rest of the site.  Only
+     * one load of an Entity happens at a time; anyone else wanting it
+     * waits for that load to finish.
      */
     class SiteCache
     {
@@ -28,8 +49,13 @@ namespace dbinterface
          * @param db_backend[in] The database to get or set data from.  Must not
          * be null.
          * @param site[in] The site ID this SiteCache is for.
+         * @param max_mem_bytes[in] The approximate maximum memory, in bytes,
+         * the cached Entities should use, or 0 for no limit.
          */
-        SiteCache(DbBackend *db_backend, const dbtype::Id::SiteIdType site);
+        SiteCache(
+            DbBackend *db_backend,
+            const dbtype::Id::SiteIdType site,
+            const size_t max_mem_bytes);
 
         /**
          * Destructor.
@@ -68,6 +94,30 @@ namespace dbinterface
          */
         DbResultCode get_entity_ref(const dbtype::Id &id, EntityRef &ref);
 
+        /**
+         * Gets references to several Entities, loading any that are not
+         * cached from the database together.  This is more efficient than
+         * calling get_entity_ref() for each, since the database is only
+         * asked once.
+         * @param ids[in] The IDs of the Entities to get.
+         * @param refs[out] A reference for each ID, in the same order as
+         * ids.  A reference will be invalid if the Entity was not found or
+         * is not in this site.  Any existing contents are replaced.
+         * @param record_access[in] False to not count loading the Entities
+         * as an access, such as when warming up the cache.
+         */
+        void get_entity_refs(
+            const dbtype::Entity::IdVector &ids,
+            EntityRefVector &refs,
+            const bool record_access = true);
+
+        /**
+         * @return True if the cache is using at least as much memory as it
+         * is allowed.  Unused Entities will be evicted after the next
+         * commit.
+         */
+        bool is_full(void);
+
         /**
          * Determines if an entity is currently cached.
          * @param id[in] The ID to check.
@@ -86,18 +136,137 @@ namespace dbinterface
         /**
          * This is expensive.
          * @return True if any Entity in this site is being referenced in
-         * memory.
+         * memory or is being loaded.
          */
         bool is_anything_referenced(void);
 
+        /**
+         * If the cache is using more memory than allowed, evicts unreferenced
+         * and non-dirty Entities until it is under the limit or nothing
+         * else can be evicted.
+         * This must only be called when the database backend has no open
+         * transaction, otherwise an Entity that was saved but not yet
+         * committed could be evicted and then reloaded with old data.
+         */
+        void enforce_memory_limit(void);
+
+        /**
+         * @return Statistics about this cache.
+         */
+        CacheStats get_stats(void);
+
+        /**
+         * Moves the access statistics recorded since the last call into
+         * the given map, for saving to the database.  Access statistics
+         * are not part of an Entity's dirty state, so this is the only way
+         * they get saved.
+         * @param stats[out] The map to add this site's pending access
+         * statistics to.  Existing entries for other sites are untouched.
+         */
+        void take_access_stats(DbBackend::AccessStatsMap &stats);
+
+        /**
+         * Puts back access statistics taken by take_access_stats() that
+         * could not be saved, so they are saved later.  Statistics
+         * recorded for an Entity since then are newer and are kept
+         * instead.
+         * @param stats[in] The access statistics to put back.  Must only
+         * be for this site.
+         */
+        void restore_access_stats(const DbBackend::AccessStatsMap &stats);
+
+        /**
+         * Finds a Program by registration name, using the cached
+         * registration names when possible.  Renames not yet committed
+         * will not be found.
+         * @param reg_name[in] The registration name (case insensitive).
+         * @return The ID of the Program, or default if the name is not
+         * registered.
+         */
+        dbtype::Id find_program_reg(const std::string &reg_name);
+
+        /**
+         * Finds the registration name of a Program, using the cached
+         * registration names when possible.  Renames not yet committed
+         * will not be found.
+         * @param entity_id[in] The ID of the Program.
+         * @return The registration name, or empty if none or the Program
+         * does not exist.
+         */
+        std::string find_program_reg_name(
+            const dbtype::Id::EntityIdType entity_id);
+
+        /**
+         * Discards cached registration names that may no longer be
+         * correct.  Call after a change to an Entity's registration name,
+         * or its deletion, has been committed to the database.
+         * @param entity_id[in] The ID of the changed or deleted Entity.
+         * @param deleted[in] True if the Entity was deleted, false if its
+         * registration name changed.
+         */
+        void program_reg_changed(
+            const dbtype::Id::EntityIdType entity_id,
+            const bool deleted);
+
     private:
         typedef std::map<dbtype::Id::EntityIdType, CachedEntity *> EntityCacheMap;
+        /** Lowercase registration name to Program ID, or 0 if unregistered */
+        typedef std::unordered_map<std::string, dbtype::Id::EntityIdType>
+            ProgRegNameCache;
+        /** Program ID to registration name, or empty if unregistered */
+        typedef std::unordered_map<dbtype::Id::EntityIdType, std::string>
+            ProgRegIdCache;
+
+        /**
+         * Remeasures the memory used by a cached Entity and updates the
+         * resident byte count.  Assumes the mutex is locked and the Entity
+         * is not being referenced.
+         * @param cached_ptr[in] The cached Entity to measure.
+         */
+        void update_mem_size(CachedEntity *cached_ptr);
+
+        /**
+         * Makes a cache entry for a freshly loaded Entity, or returns the
+         * existing entry if there already is one.  Assumes the mutex is
+         * locked.
+         * @param entity_ptr[in] The loaded Entity.
+         * @param record_access[in] True to count loading the Entity as an
+         * access.
+         * @return The cache entry for the Entity.
+         */
+        CachedEntity *add_loaded_entity(
+            dbtype::Entity *entity_ptr,
+            const bool record_access = true);
+
+        /**
+         * Removes a cached Entity from memory.  Assumes the mutex is locked
+         * and the Entity is neither referenced nor dirty.
+         * @param iter[in] The cache entry to remove.  It will be erased.
+         */
+        void remove_cached_entity(EntityCacheMap::iterator iter);
 
         DbBackend *db_backend_ptr; ///< Database backend so we can load Entities
         const dbtype::Id::SiteIdType site_id; ///< Site ID this cache manages
         boost::mutex mutex; ///< Enforces single access at a time.
-        bool delete_pending; ///< True if Site scheduled to be deleted from the database
+        boost::atomic<bool> delete_pending; ///< True if Site scheduled to be deleted from the database
         EntityCacheMap cached_entities; ///< The entity cache, lookup by Entity ID.
+        std::set<dbtype::Id::EntityIdType> loading_entities; ///< Entities being loaded
+        boost::condition_variable loading_cond; ///< Signaled when loads finish
+        DbBackend::AccessStatsMap pending_access_stats; ///< Access stats not yet saved
+
+        const size_t max_bytes; ///< Max memory cache should use, or 0 for none
+        size_t resident_bytes; ///< Approximate memory used by cached Entities
+        dbtype::Id::EntityIdType clock_hand; ///< Where eviction resumes
+        MG_LongUnsignedInt hits; ///< Count of Entities found in cache
+        MG_LongUnsignedInt misses; ///< Count of Entities loaded from database
+        MG_LongUnsignedInt evictions; ///< Count of Entities evicted
+
+        boost::mutex prog_reg_mutex; ///< Protects the registration caches
+        ProgRegNameCache prog_reg_by_name; ///< Registration name lookups
+        ProgRegIdCache prog_reg_by_id; ///< Registration name by Program
+        MG_LongUnsignedInt prog_reg_generation; ///< Bumped on every change
+        MG_LongUnsignedInt prog_reg_hits; ///< Lookups found in cache
+        MG_LongUnsignedInt prog_reg_misses; ///< Lookups sent to database
     };
 }
 }
@@ -35,10 +35,11 @@
 
 #include "text/text_StringConversion.h"
 #include "logging/log_Logger.h"
+#include "utilities/mutgos_config.h"
 
-// Seconds between commits of changed Entities.  This is approximate
-// and may delay up to twice the time.
-#define DB_COMMIT_INTERVAL_SECS 5
+// Until the caches have measured some Entities, assume they are about this
+// big when estimating the memory of changed Entities.
+#define DEFAULT_AVERAGE_ENTITY_BYTES 1024
 
 // The immediate update queue has at least this many elements pre-reserved
 #define IMMEDIATE_QUEUE_RESERVE_SIZE 64
@@ -82,6 +83,11 @@ namespace dbinterface
 
         if (not thread_ptr)
         {
+            commit_interval_secs = config::db::commit_interval();
+            commit_max_entities = config::db::commit_max_entities();
+            commit_max_bytes = config::db::commit_max_memory() * 1024;
+            backup_interval_mins = config::db::backup_interval();
+
             thread_ptr = new boost::thread(boost::ref(*this));
             dbtype::Entity::register_change_listener(this);
         }
@@ -94,6 +100,9 @@ namespace dbinterface
 
         if (thread_ptr)
         {
+            // A bulk load left open still needs its references updated.
+            end_bulk_load();
+
             shutdown_thread_flag.store(true);
 
             thread_ptr->join();
@@ -123,6 +132,12 @@ namespace dbinterface
     {
     }
 
+    // ----------------------------------------------------------------------
+    UpdateManager::EntityUpdate::EntityUpdate(const dbtype::Id &id)
+      : entity_id(id)
+    {
+    }
+
     // ----------------------------------------------------------------------
     void UpdateManager::entity_changed(
        dbtype::Entity *entity,
@@ -137,7 +152,26 @@ namespace dbinterface
         //
         if (entity)
         {
-            if (not ids_changed.empty())
+            if ((not ids_changed.empty()) and bulk_load)
+            {
+                // References changed, but during a bulk load they are
+                // saved up and processed all at once when it ends.  The
+                // rest of the change is committed normally, below.
+                //
+                PendingUpdatesMap::iterator deferred_iter =
+                    deferred_references.find(entity->get_entity_id());
+
+                if (deferred_iter == deferred_references.end())
+                {
+                    deferred_iter = deferred_references.insert(std::make_pair(
+                        entity->get_entity_id(),
+                        new EntityUpdate(entity))).first;
+                }
+
+                deferred_iter->second->merge_net_ids(ids_changed);
+            }
+
+            if ((not ids_changed.empty()) and (not bulk_load))
             {
                 // References changed, so detour to the immediate update
                 // queue before committing.
@@ -170,7 +204,6 @@ namespace dbinterface
 
                     new_update->fields_changed = fields_changed;
                     new_update->flags_changed = flags_changed;
-                    new_update->ids_changed = ids_changed;
 
                     pending_updates.insert(std::make_pair(
                         entity->get_entity_id(),
@@ -178,14 +211,24 @@ namespace dbinterface
                 }
                 else
                 {
-                    // Existing.  Need to merge.
+                    // Existing.  Need to merge.  Any ID changes were
+                    // deferred above.
                     //
                     update_iter->second->merge_update(
                         fields_changed,
                         flags_changed,
-                        ids_changed);
+                        dbtype::Entity::ChangedIdFieldsMap());
                 }
             }
+
+            if ((not commit_requested) and
+                (get_commit_limit_reached() != COMMIT_REASON_NONE))
+            {
+                // Too much is waiting; wake up the thread to commit early.
+                //
+                commit_requested = true;
+                immediate_update_queue_sem.post();
+            }
         }
     }
 
@@ -591,30 +634,117 @@ namespace dbinterface
         pending_site_deletes.push_back(site_id);
     }
 
+    // ----------------------------------------------------------------------
+    CommitStats UpdateManager::get_commit_stats(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+        CommitStats stats = commit_stats;
+
+        stats.pending_entities =
+            pending_updates.size() + immediate_update_queue.size();
+        stats.pending_bytes = stats.pending_entities * average_entity_bytes;
+
+        return stats;
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::begin_bulk_load(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        LOG(info, "dbinterface", "begin_bulk_load",
+            "Deferring reference updates for bulk load.");
+
+        bulk_load = true;
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::end_bulk_load(void)
+    {
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            if (not bulk_load)
+            {
+                return;
+            }
+
+            LOG(info, "dbinterface", "end_bulk_load",
+                "Updating references for "
+                + text::to_string(deferred_references.size())
+                + " Entities.");
+
+            bulk_load = false;
+
+            // The thread does the actual work, as one large batch.
+            //
+            immediate_update_queue.reserve(
+                immediate_update_queue.size() + deferred_references.size());
+
+            for (PendingUpdatesMap::iterator deferred_iter =
+                    deferred_references.begin();
+                deferred_iter != deferred_references.end();
+                ++deferred_iter)
+            {
+                immediate_update_queue.push_back(deferred_iter->second);
+            }
+
+            deferred_references.clear();
+        }
+
+        flush();
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::flush(void)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        if (thread_ptr)
+        {
+            const MG_LongUnsignedInt flush_request = ++flushes_requested;
+
+            immediate_update_queue_sem.post();
+
+            while (flushes_done < flush_request)
+            {
+                flush_cond.wait(lock);
+            }
+        }
+    }
+
     // ----------------------------------------------------------------------
     void UpdateManager::thread_main(void)
     {
         bool do_shutdown = false;
         std::chrono::steady_clock::time_point last_db_commit_time =
             std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point last_backup_time =
+            last_db_commit_time;
 
-        // The timing is far from exact, but it will guarantee DB changes
-        // will be committed in at most (DB_COMMIT_INTERVAL_SECS * 2) seconds,
-        // with the expected time being a lot closer to DB_COMMIT_INTERVAL_SECS.
-        //
-        // This algorithm can always be made more exact later if timing
-        // becomes super important, which it shouldn't need to be.
+        // Changes are committed when the commit interval has passed since
+        // the last commit, or sooner if entity_changed() finds too many
+        // changed Entities waiting and wakes us up.
         //
         while (not do_shutdown)
         {
+            const std::chrono::steady_clock::time_point commit_deadline =
+                last_db_commit_time
+                  + std::chrono::seconds(commit_interval_secs);
+            const std::chrono::steady_clock::time_point now =
+                std::chrono::steady_clock::now();
+            const MG_LongUnsignedInt wait_msecs = (commit_deadline > now) ?
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    commit_deadline - now).count() : 0;
+
             // Wait on the immediate update queue
             //
             try
             {
-                // Wait a little for semaphore to be posted or a timeout.
+                // Wait for semaphore to be posted or the commit deadline.
                 immediate_update_queue_sem.timed_wait(
                     boost::posix_time::microsec_clock::universal_time()
-                      + boost::posix_time::seconds(DB_COMMIT_INTERVAL_SECS));
+                      + boost::posix_time::milliseconds(wait_msecs));
             }
             catch (...)
             {
@@ -622,16 +752,86 @@ namespace dbinterface
                     "Exception while doing timed_wait() on semaphore!");
             }
 
+            // Anything queued before a flush was requested is processed
+            // and committed in this pass.
+            //
+            MG_LongUnsignedInt flush_request = 0;
+
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+
+                if (flushes_requested != flushes_done)
+                {
+                    flush_request = flushes_requested;
+                }
+            }
+
             process_immediate_updates();
 
-            if (std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::steady_clock::now() - last_db_commit_time).count() >=
-                    DB_COMMIT_INTERVAL_SECS)
+            CommitReason reason = COMMIT_REASON_NONE;
+
             {
-                // We haven't committed DB changes for a while, so do that now.
+                boost::lock_guard<boost::mutex> guard(mutex);
+
+                reason = get_commit_limit_reached();
+                commit_requested = false;
+            }
+
+            if ((reason == COMMIT_REASON_NONE) and flush_request)
+            {
+                // Counted as a time commit since it isn't due to a limit.
+                reason = COMMIT_REASON_TIME;
+            }
+
+            if ((reason == COMMIT_REASON_NONE) and
+                (std::chrono::steady_clock::now() >= commit_deadline))
+            {
+                reason = COMMIT_REASON_TIME;
+            }
+
+            if (reason != COMMIT_REASON_NONE)
+            {
+                const std::chrono::steady_clock::time_point commit_start =
+                    std::chrono::steady_clock::now();
+
+                const size_t batch_entities = process_db_commits();
+
+                // Now that everything is committed, it's safe to trim the
+                // caches.
                 //
-                process_db_commits();
+                DatabaseAccess::instance()->internal_enforce_cache_limits();
                 last_db_commit_time = std::chrono::steady_clock::now();
+
+                record_commit(
+                    reason,
+                    batch_entities,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        last_db_commit_time - commit_start).count());
+            }
+
+            if (flush_request)
+            {
+                {
+                    boost::lock_guard<boost::mutex> guard(mutex);
+                    flushes_done = flush_request;
+                }
+
+                flush_cond.notify_all();
+            }
+
+            if (backup_interval_mins and
+                ((std::chrono::steady_clock::now() - last_backup_time) >=
+                    std::chrono::minutes(backup_interval_mins)))
+            {
+                // Time for a scheduled backup.  It runs in the background.
+                //
+                if (not DatabaseAccess::instance()->start_backup())
+                {
+                    LOG(warning, "dbinterface", "thread_main",
+                        "Unable to start scheduled database backup.");
+                }
+
+                last_backup_time = std::chrono::steady_clock::now();
             }
 
             // Only shutdown if the pending updates are all finished
@@ -640,7 +840,9 @@ namespace dbinterface
                 boost::lock_guard<boost::mutex> guard(mutex);
                 do_shutdown = pending_updates.empty()
                   and pending_deletes.empty()
+                  and pending_db_site_deletes.empty()
                   and immediate_update_queue.empty()
+                  and unsaved_references.empty()
                   and shutdown_thread_flag.load();
             }
         }
@@ -650,6 +852,7 @@ namespace dbinterface
     void UpdateManager::process_immediate_updates(void)
     {
         ImmediateUpdateQueue queue_copy;
+        PendingUpdatesMap references_copy;
 
         {
             // Grab the stuff to update en masse to avoid locking the data
@@ -662,12 +865,67 @@ namespace dbinterface
                 queue_copy.reserve(IMMEDIATE_QUEUE_RESERVE_SIZE);
                 queue_copy.swap(immediate_update_queue);
             }
+
+            references_copy.swap(unsaved_references);
+        }
+
+        if (not references_copy.empty())
+        {
+            // Reference index changes that could not be written last time
+            // are older than anything in the queue, so they go first.
+            // Only the index is written again; the referenced Entities
+            // were already updated.
+            //
+            DatabaseAccess * const db = DatabaseAccess::instance();
+            const bool batch_started = db->internal_begin_commit_batch();
+            bool success = true;
+
+            for (PendingUpdatesMap::iterator reference_iter =
+                    references_copy.begin();
+                reference_iter != references_copy.end();
+                ++reference_iter)
+            {
+                success = db->internal_update_references(
+                    reference_iter->first,
+                    reference_iter->second->ids_changed) and success;
+            }
+
+            if (batch_started and (not db->internal_end_commit_batch()))
+            {
+                success = false;
+            }
+
+            if (success)
+            {
+                for (PendingUpdatesMap::iterator reference_iter =
+                        references_copy.begin();
+                    reference_iter != references_copy.end();
+                    ++reference_iter)
+                {
+                    delete reference_iter->second;
+                }
+
+                references_copy.clear();
+            }
+            else
+            {
+                LOG(error, "dbinterface", "process_immediate_updates",
+                    "Could not write reference index updates for "
+                    + text::to_string(references_copy.size())
+                    + " Entities again.  Will retry.");
+            }
         }
 
         if (not queue_copy.empty())
         {
-            // Process the reference changes
+            // Process the reference changes.  The reference index updates
+            // are written as a single transaction.
             //
+            DatabaseAccess * const db = DatabaseAccess::instance();
+            const bool batch_started = db->internal_begin_commit_batch();
+            PendingUpdatesMap written_references;
+            dbtype::Entity::IdSet failed_references;
+
             for (ImmediateUpdateQueue::iterator immediate_iter =
                     queue_copy.begin();
                  immediate_iter != queue_copy.end();
@@ -676,9 +934,20 @@ namespace dbinterface
                 if (not (*immediate_iter)->ids_changed.empty())
                 {
                     // References changed. Update them
-                    process_id_references(
+                    if (not process_id_references(
+                        (*immediate_iter)->entity_id,
+                        (*immediate_iter)->ids_changed))
+                    {
+                        failed_references.insert(
+                            (*immediate_iter)->entity_id);
+                    }
+
+                    // Kept until the index updates are committed, in case
+                    // they have to be written again.
+                    merge_reference_update(
                         (*immediate_iter)->entity_id,
-                        (*immediate_iter)->ids_changed);
+                        (*immediate_iter)->ids_changed,
+                        written_references);
 
                     // Now that we've updated them, take them out of the update
                     // info so we don't do them again.
@@ -686,6 +955,47 @@ namespace dbinterface
                 }
             }
 
+            const bool batch_failed =
+                batch_started and (not db->internal_end_commit_batch());
+
+            if (batch_failed)
+            {
+                LOG(error, "dbinterface", "process_immediate_updates",
+                    "Could not commit reference index updates.  Will retry.");
+            }
+
+            // Anything not written is tried again on the next pass.  An
+            // Entity whose older changes are still waiting has the new
+            // ones added to them, so they stay in order.
+            //
+            for (PendingUpdatesMap::iterator written_iter =
+                    written_references.begin();
+                written_iter != written_references.end();
+                ++written_iter)
+            {
+                if (batch_failed or
+                    failed_references.count(written_iter->first) or
+                    references_copy.count(written_iter->first))
+                {
+                    merge_reference_update(
+                        written_iter->first,
+                        written_iter->second->ids_changed,
+                        references_copy);
+                }
+
+                delete written_iter->second;
+            }
+        }
+
+        if (not references_copy.empty())
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            unsaved_references.swap(references_copy);
+        }
+
+        if (not queue_copy.empty())
+        {
+
             {
                 // Move everything processed into the pending update queue so
                 // it'll be committed.
@@ -726,12 +1036,93 @@ namespace dbinterface
     }
 
     // ----------------------------------------------------------------------
-    void UpdateManager::process_db_commits(void)
+    UpdateManager::CommitReason UpdateManager::get_commit_limit_reached(void)
+        const
+    {
+        const size_t pending_entities =
+            pending_updates.size() + immediate_update_queue.size();
+
+        if (commit_max_entities and (pending_entities >= commit_max_entities))
+        {
+            return COMMIT_REASON_ENTITIES;
+        }
+
+        if (commit_max_bytes and
+            ((pending_entities * average_entity_bytes) >= commit_max_bytes))
+        {
+            return COMMIT_REASON_MEMORY;
+        }
+
+        return COMMIT_REASON_NONE;
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::record_commit(
+        const CommitReason reason,
+        const size_t batch_entities,
+        const MG_LongUnsignedInt commit_usecs)
+    {
+        // Done outside the lock since it has to look at every site cache.
+        //
+        const size_t entity_bytes =
+            DatabaseAccess::instance()->internal_get_average_entity_mem();
+
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        if (entity_bytes)
+        {
+            average_entity_bytes = entity_bytes;
+        }
+
+        ++commit_stats.commits;
+
+        switch (reason)
+        {
+            case COMMIT_REASON_ENTITIES:
+            {
+                ++commit_stats.entity_limit_commits;
+                break;
+            }
+
+            case COMMIT_REASON_MEMORY:
+            {
+                ++commit_stats.memory_limit_commits;
+                break;
+            }
+
+            default:
+            {
+                ++commit_stats.time_commits;
+                break;
+            }
+        }
+
+        commit_stats.committed_entities += batch_entities;
+        commit_stats.last_batch_entities = batch_entities;
+
+        if (batch_entities > commit_stats.max_batch_entities)
+        {
+            commit_stats.max_batch_entities = batch_entities;
+        }
+
+        commit_stats.last_commit_usecs = commit_usecs;
+        commit_stats.total_commit_usecs += commit_usecs;
+
+        if (commit_usecs > commit_stats.max_commit_usecs)
+        {
+            commit_stats.max_commit_usecs = commit_usecs;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    size_t UpdateManager::process_db_commits(void)
     {
         DatabaseAccess * const db = DatabaseAccess::instance();
         PendingUpdatesMap updates_copy;
         dbtype::Entity::IdSet deletes_copy;
         dbtype::Id::SiteIdVector site_deletes_copy;
+        dbtype::Id::SiteIdVector db_site_deletes_copy;
+        dbtype::Entity::IdSet failed_update_ids;
 
         {
             // Grab the stuff to update and delete en masse to avoid
@@ -741,38 +1132,40 @@ namespace dbinterface
             updates_copy = pending_updates;
             deletes_copy = pending_deletes;
             site_deletes_copy = pending_site_deletes;
+            db_site_deletes_copy.swap(pending_db_site_deletes);
 
             pending_updates.clear();
             pending_deletes.clear();
             pending_site_deletes.clear();
         }
 
+        // Everything is gathered and prepared before the batch is started,
+        // so the batch only has to write.  Backends may hold up other
+        // threads' writes while a batch is open, so it should not be open
+        // while Entities are loaded or references to deleted Entities are
+        // removed.
+        //
+        // References were already updated in process_immediate_updates()
+        //
+        EntityRefVector updated_entities;
+        dbtype::Entity::IdVector failed_ids;
+
+        updated_entities.reserve(updates_copy.size());
+
         for (PendingUpdatesMap::iterator update_iter = updates_copy.begin();
              update_iter != updates_copy.end();
              ++update_iter)
         {
-            // References were already updated in process_immediate_updates()
-
-            // Commit the changes to the database.
-            //
             EntityRef updated_entity = db->get_entity(update_iter->first);
 
             if (updated_entity.valid())
             {
-                if (not db->internal_commit_entity(updated_entity))
-                {
-                    LOG(error, "dbinterface", "thread_main",
-                        "Could not commit Entity with ID "
-                        + update_iter->first.to_string(true)
-                        + " to database.");
-                }
+                updated_entities.push_back(updated_entity);
             }
         }
 
-        // Process deletes.  Remove all references to each Entity being
-        // deleted, then attempt to remove it from the database and
-        // cache.  If it is not in use this will succeed, otherwise
-        // reinsert it into the pending deletes to try again later.
+        // Remove all references to each Entity being deleted.  It is
+        // removed from the database and cache in the batch below.
         //
         EntityRef deleted_entity_ref;
 
@@ -785,15 +1178,16 @@ namespace dbinterface
 
             if (deleted_entity_ref.valid())
             {
-                remove_all_references(deleted_entity_ref);
-            }
+                remove_all_references(deleted_entity_ref, deletes_copy);
 
-            // Scope for clearing dirty info on Entity.  Lock needs to
-            // be released to avoid potential crashes while doing the
-            // actual delete.
-            {
-                concurrency::WriterLockToken token(*deleted_entity_ref.get());
-                deleted_entity_ref->clear_dirty(token);
+                // Scope for clearing dirty info on Entity.  Lock needs to
+                // be released to avoid potential crashes while doing the
+                // actual delete.
+                {
+                    concurrency::WriterLockToken token(
+                        *deleted_entity_ref.get());
+                    deleted_entity_ref->clear_dirty(token);
+                }
             }
 
             deleted_entity_ref.clear();
@@ -806,10 +1200,93 @@ namespace dbinterface
                 boost::lock_guard<boost::mutex> guard(mutex);
                 pending_updates.erase(*deleted_id_iter);
             }
+        }
 
-            // Attempt to do the actual deletion.  If it fails, reinsert
-            // to try again later.
+        // Process site deletes.  Simply call DatabaseAccess again.  If the
+        // site is still in use, the ID has been automatically reinserted
+        // into the delete list to try again later.  Otherwise it is gone
+        // from memory and, unless that failed, from the database.
+        //
+        dbtype::Id::SiteIdVector db_site_deletes;
+        dbtype::Id::SiteIdVector failed_site_deletes;
+
+        for (dbtype::Id::SiteIdVector::iterator site_iter =
+            site_deletes_copy.begin();
+             site_iter != site_deletes_copy.end();
+             ++site_iter)
+        {
+            if (db->delete_site(*site_iter) == DBRESULTCODE_ERROR)
+            {
+                failed_site_deletes.push_back(*site_iter);
+            }
+        }
+
+        // Everything below (commits, deletes, site deletes) is written to
+        // the database as a single transaction, to avoid paying for a
+        // commit per Entity.  If the batch cannot be started, everything
+        // is still written, just individually.
+        //
+        const bool batch_started = db->internal_begin_commit_batch();
+
+        if (not batch_started)
+        {
+            LOG(error, "dbinterface", "process_db_commits",
+                "Could not start commit batch.  Committing individually.");
+        }
+
+        // Commit the changes to the database.
+        //
+        if ((not updated_entities.empty()) and
+            (not db->internal_commit_entities(
+                updated_entities,
+                failed_ids)))
+        {
+            for (dbtype::Entity::IdVector::const_iterator failed_iter =
+                    failed_ids.begin();
+                 failed_iter != failed_ids.end();
+                 ++failed_iter)
+            {
+                LOG(error, "dbinterface", "process_db_commits",
+                    "Could not commit Entity with ID "
+                    + failed_iter->to_string(true)
+                    + " to database.  Will retry.");
+            }
+
+            // Put back on the queue below, as if the batch failed.
+            failed_update_ids.insert(failed_ids.begin(), failed_ids.end());
+        }
+        else if (batch_started)
+        {
+            // Every Entity touched by the reference index updates
+            // done so far by process_immediate_updates() (on this same
+            // thread) is in this batch, so once it commits the index
+            // and the Entities agree.
             //
+            if (not db->internal_references_saved())
+            {
+                LOG(warning, "dbinterface", "process_db_commits",
+                    "Could not mark reference index as saved.");
+            }
+        }
+
+        // The references are released before deletes are attempted.
+        updated_entities.clear();
+
+        // Access statistics aren't part of the Entity commits above, so
+        // they are saved on their own (in the same batch).
+        //
+        DbBackend::AccessStatsMap saved_access_stats;
+        db->internal_save_access_stats(saved_access_stats);
+
+        // Attempt to remove each deleted Entity from the database and
+        // cache.  If it is not in use this will succeed, otherwise
+        // reinsert it into the pending deletes to try again later.
+        //
+        for (dbtype::Entity::IdSet::const_iterator deleted_id_iter =
+                 deletes_copy.begin();
+             deleted_id_iter != deletes_copy.end();
+             ++deleted_id_iter)
+        {
             if (db->internal_delete_entity(*deleted_id_iter) ==
                 DBRESULTCODE_ERROR_ENTITY_IN_USE)
             {
@@ -818,25 +1295,92 @@ namespace dbinterface
             }
         }
 
-        // Process site deletes.  Simply call DatabaseAccess again.  If it
-        // succeeds, then we're done, otherwise the ID has been automatically
-        // reinserted into the delete list to try again later.
+        // Sites whose deletion from the database failed before.  These
+        // are remembered until the deletion has been committed.
         //
         for (dbtype::Id::SiteIdVector::iterator site_iter =
-            site_deletes_copy.begin();
-             site_iter != site_deletes_copy.end();
+            db_site_deletes_copy.begin();
+             site_iter != db_site_deletes_copy.end();
              ++site_iter)
         {
-            db->delete_site(*site_iter);
+            if (db->internal_delete_site_db(*site_iter))
+            {
+                db_site_deletes.push_back(*site_iter);
+            }
+            else
+            {
+                failed_site_deletes.push_back(*site_iter);
+            }
         }
 
-        // Clear the temporary holds for the next use
+        // Make it all durable.  If the batch failed, the backend has
+        // discarded everything in it, so queue it all up to try again.
         //
-        for (PendingUpdatesMap::iterator update_iter = updates_copy.begin();
+        const bool batch_failed =
+            batch_started and (not db->internal_end_commit_batch());
+
+        if (batch_failed)
+        {
+            LOG(error, "dbinterface", "process_db_commits",
+                "Could not commit batch of "
+                + text::to_string(updates_copy.size()) + " updates and "
+                + text::to_string(deletes_copy.size())
+                + " deletes to database.  Will retry.");
+
+            // These go back into the site caches, which have their own
+            // locking.
+            db->internal_restore_access_stats(saved_access_stats);
+
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            pending_deletes.insert(deletes_copy.begin(), deletes_copy.end());
+
+            // The sites are already gone from memory, so only their
+            // deletion from the database is tried again.
+            failed_site_deletes.insert(
+                failed_site_deletes.end(),
+                db_site_deletes.begin(),
+                db_site_deletes.end());
+        }
+
+        if (not failed_site_deletes.empty())
+        {
+            LOG(error, "dbinterface", "process_db_commits",
+                "Could not delete "
+                + text::to_string(failed_site_deletes.size())
+                + " sites from database.  Will retry.");
+
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            pending_db_site_deletes.insert(
+                pending_db_site_deletes.end(),
+                failed_site_deletes.begin(),
+                failed_site_deletes.end());
+        }
+
+        // Now that the batch is visible to everyone, let the program
+        // registration cache know what may have changed.  This must be
+        // done before the pending renames are checked against the database
+        // below.
+        //
+        for (PendingUpdatesMap::const_iterator update_iter =
+                updates_copy.begin();
              update_iter != updates_copy.end();
              ++update_iter)
         {
-            delete update_iter->second;
+            if (update_iter->second->fields_changed.count(
+                dbtype::ENTITYFIELD_program_reg_name))
+            {
+                db->internal_program_reg_changed(update_iter->first, false);
+            }
+        }
+
+        for (dbtype::Entity::IdSet::const_iterator delete_iter =
+                deletes_copy.begin();
+             delete_iter != deletes_copy.end();
+             ++delete_iter)
+        {
+            db->internal_program_reg_changed(*delete_iter, true);
         }
 
         {
@@ -875,12 +1419,15 @@ namespace dbinterface
 
                 site_iter = pending_program_registrations.end();
 
-                // Remove all completed program reg renames
+                // Remove all completed program reg renames.  If the batch
+                // failed, the database doesn't have them yet (a removed
+                // registration would look complete), so they are checked
+                // again when it is retried.
                 //
-
                 for (PendingUpdatesMap::const_iterator update_iter =
                     updates_copy.begin();
-                     update_iter != updates_copy.end();
+                     (not batch_failed) and
+                        (update_iter != updates_copy.end());
                      ++update_iter)
                 {
                     if (pending_program_registrations.count(
@@ -954,12 +1501,13 @@ namespace dbinterface
 
                 site_iter = pending_player_names.end();
 
-                // Remove all completed player renames
+                // Remove all completed player renames, unless the batch
+                // failed and they are still to be retried.
                 //
-
                 for (PendingUpdatesMap::const_iterator update_iter =
                     updates_copy.begin();
-                     update_iter != updates_copy.end();
+                     (not batch_failed) and
+                        (update_iter != updates_copy.end());
                      ++update_iter)
                 {
                     if (pending_player_names.count(
@@ -999,13 +1547,58 @@ namespace dbinterface
             }
         }
 
+        // Clear the temporary holds for the next use, or put them back
+        // if they need to be committed again.  Done last since everything
+        // above still looks at them.
+        //
+        for (PendingUpdatesMap::iterator update_iter = updates_copy.begin();
+             update_iter != updates_copy.end();
+             ++update_iter)
+        {
+            bool requeued = false;
+
+            if ((batch_failed or failed_update_ids.count(update_iter->first))
+                and (deletes_copy.find(update_iter->first) == deletes_copy.end()))
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+
+                const std::pair<PendingUpdatesMap::iterator, bool> insert_rc =
+                    pending_updates.insert(*update_iter);
+                requeued = insert_rc.second;
+
+                if (not requeued)
+                {
+                    // A newer update is already pending and will cause the
+                    // Entity to be committed anyway, but it needs to know
+                    // what changed here for the renames to complete.
+                    insert_rc.first->second->merge_update(
+                        update_iter->second->fields_changed,
+                        update_iter->second->flags_changed,
+                        update_iter->second->ids_changed);
+                }
+            }
+
+            if (not requeued)
+            {
+                delete update_iter->second;
+            }
+        }
+
+        // Nothing was committed if the batch failed, nor were the
+        // Entities that failed on their own; they will be counted when
+        // they are retried.
+        const size_t batch_entities = (batch_failed ? 0 :
+            updates_copy.size() - failed_update_ids.size());
+
         updates_copy.clear();
         deletes_copy.clear();
         site_deletes_copy.clear();
+
+        return batch_entities;
     }
 
     // ----------------------------------------------------------------------
-    void UpdateManager::process_id_references(
+    bool UpdateManager::process_id_references(
         const dbtype::Id &id,
         const dbtype::Entity::ChangedIdFieldsMap changed_fields)
     {
@@ -1064,195 +1657,65 @@ namespace dbinterface
                 }
             }
         }
-    }
-
-    // ----------------------------------------------------------------------
-    void UpdateManager::remove_all_references(EntityRef &entity)
-    {
-        // TODO Create a new virtual method on Entity that can get a list to avoid all this
-
-        // Try casting the Entity to all the different types it could be
-        // that has ID references, and then go to the Entity referenced and
-        // remove itself from the other Entity's reference list.
-        //
-
-        const dbtype::Id entity_id = entity.id();
-        dbtype::Id current_id;
-
-        // Check Entity (owner, security)
-        //
-        current_id = entity.get()->get_entity_owner();
-        remove_reference(entity_id, current_id, dbtype::ENTITYFIELD_owner);
-
-        const dbtype::Security entity_security =
-            entity.get()->get_entity_security();
-        const dbtype::Security::SecurityIds &security_admin_ids =
-            entity_security.get_admin_ids();
-
-        for (dbtype::Security::SecurityIds::const_iterator sec_iter =
-                security_admin_ids.begin();
-            sec_iter != security_admin_ids.end();
-            ++sec_iter)
-        {
-            remove_reference(entity_id, *sec_iter, dbtype::ENTITYFIELD_security);
-        }
-
-        const dbtype::Security::SecurityIds &security_list_ids =
-            entity_security.get_list_ids();
-
-        for (dbtype::Security::SecurityIds::const_iterator ids_iter =
-            security_list_ids.begin();
-             ids_iter != security_list_ids.end();
-             ++ids_iter)
-        {
-            remove_reference(entity_id, *ids_iter, dbtype::ENTITYFIELD_security);
-        }
-
-        // Check ContainerPropertyEntity (contained by, programs)
-        //
-        dbtype::ContainerPropertyEntity *container =
-            dynamic_cast<dbtype::ContainerPropertyEntity *>(entity.get());
-
-        if (container)
-        {
-            current_id = container->get_contained_by();
-
-            remove_reference(
-                entity_id,
-                current_id,
-                dbtype::ENTITYFIELD_contained_by);
-
-            const dbtype::Entity::IdVector program_ids =
-                container->get_linked_programs();
-
-            for (dbtype::Entity::IdVector::const_iterator iter =
-                    program_ids.begin();
-                iter != program_ids.end();
-                ++iter)
-            {
-                remove_reference(
-                    entity_id,
-                    *iter,
-                    dbtype::ENTITYFIELD_linked_programs);
-            }
-        }
-
-        // Check Player (home)
-        //
-        dbtype::Player *player =
-            dynamic_cast<dbtype::Player *>(entity.get());
-
-        if (player)
-        {
-            current_id = player->get_player_home();
-
-            remove_reference(
-                entity_id,
-                current_id,
-                dbtype::ENTITYFIELD_player_home);
-        }
-
-        // Check Thing (home)
-        //
-        dbtype::Thing *thing =
-            dynamic_cast<dbtype::Thing *>(entity.get());
 
-        if (thing)
+        if (not db->internal_update_references(id, changed_fields))
         {
-            current_id = thing->get_thing_home();
-
-            remove_reference(
-                entity_id,
-                current_id,
-                dbtype::ENTITYFIELD_thing_home);
+            LOG(error, "dbinterface", "process_id_references",
+                "Could not update reference index for "
+                + id.to_string(true));
+            return false;
         }
 
-        // Check Vehicle (interior, controller)
-        //
-        dbtype::Vehicle *vehicle =
-            dynamic_cast<dbtype::Vehicle *>(entity.get());
-
-        if (vehicle)
-        {
-            current_id = vehicle->get_vehicle_interior();
-            remove_reference(
-                entity_id,
-                current_id,
-                dbtype::ENTITYFIELD_vehicle_interior);
-
-            current_id = vehicle->get_vehicle_controller();
-            remove_reference(
-                entity_id,
-                current_id,
-                dbtype::ENTITYFIELD_vehicle_controller);
-        }
+        return true;
+    }
 
-        // Check Group (members)
-        //
-        dbtype::Group *group =
-            dynamic_cast<dbtype::Group *>(entity.get());
+    // ----------------------------------------------------------------------
+    void UpdateManager::merge_reference_update(
+        const dbtype::Id &id,
+        const dbtype::Entity::ChangedIdFieldsMap &changed_fields,
+        PendingUpdatesMap &updates)
+    {
+        PendingUpdatesMap::iterator update_iter = updates.find(id);
 
-        if (group)
+        if (update_iter == updates.end())
         {
-            const dbtype::Entity::IdVector group_members =
-                group->get_all_in_group();
-
-            for (dbtype::Entity::IdVector::const_iterator iter =
-                    group_members.begin();
-                iter != group_members.end();
-                ++iter)
-            {
-                remove_reference(entity_id, *iter, dbtype::ENTITYFIELD_group_ids);
-            }
+            update_iter = updates.insert(std::make_pair(
+                id,
+                new EntityUpdate(id))).first;
         }
 
-        // Program (code includes)
-        //
-        dbtype::Program *program = dynamic_cast<dbtype::Program *>(entity.get());
-
-        if (program)
-        {
-            const dbtype::Entity::IdSet linked_programs =
-                program->get_program_includes();
-
-            for (dbtype::Entity::IdSet::const_iterator iter =
-                linked_programs.begin();
-                 iter != linked_programs.end();
-                 ++iter)
-            {
-                remove_reference(
-                    entity_id,
-                    *iter,
-                    dbtype::ENTITYFIELD_program_includes);
-            }
-        }
+        update_iter->second->merge_net_ids(changed_fields);
+    }
 
-        // ActionEntity (targets, contained by)
+    // ----------------------------------------------------------------------
+    void UpdateManager::remove_all_references(
+        EntityRef &entity,
+        const dbtype::Entity::IdSet &deleting)
+    {
+        // Go to each Entity referenced and remove this one from the other
+        // Entity's reference list.  Entities being deleted are skipped, so
+        // deleting a large area does not load it all just to update
+        // references that are going away anyway.
         //
-        dbtype::ActionEntity *action =
-            dynamic_cast<dbtype::ActionEntity *>(entity.get());
+        DatabaseAccess * const db = DatabaseAccess::instance();
+        const dbtype::Id entity_id = entity.id();
+        const dbtype::Entity::IdFieldsMap referenced =
+            db->internal_get_references_from(entity_id);
 
-        if (action)
+        for (dbtype::Entity::IdFieldsMap::const_iterator ref_id_iter =
+                referenced.begin();
+            ref_id_iter != referenced.end();
+            ++ref_id_iter)
         {
-            current_id = action->get_action_contained_by();
-            remove_reference(
-                entity_id,
-                current_id,
-                dbtype::ENTITYFIELD_action_contained_by);
-
-
-            const dbtype::Entity::IdVector action_targets =
-                action->get_action_targets();
-
-            for (dbtype::Entity::IdVector::const_iterator iter =
-                action_targets.begin();
-                 iter != action_targets.end();
-                 ++iter)
+            if (not is_being_deleted(ref_id_iter->first, deleting))
             {
-                remove_reference(
-                    entity_id,
-                    *iter,
-                    dbtype::ENTITYFIELD_action_targets);
+                for (dbtype::Entity::EntityFieldSet::const_iterator field_iter =
+                        ref_id_iter->second.begin();
+                    field_iter != ref_id_iter->second.end();
+                    ++field_iter)
+                {
+                    remove_reference(entity_id, ref_id_iter->first, *field_iter);
+                }
             }
         }
 
@@ -1267,11 +1730,14 @@ namespace dbinterface
             ref_id_iter != references.end();
             ++ref_id_iter)
         {
-            current_id = ref_id_iter->first;
-            EntityRef current_entity = DatabaseAccess::instance()->
-                get_entity_deleted(current_id);
+            if (is_being_deleted(ref_id_iter->first, deleting))
+            {
+                continue;
+            }
 
-            if (entity.valid())
+            EntityRef current_entity = db->get_entity_deleted(ref_id_iter->first);
+
+            if (current_entity.valid())
             {
                 for (dbtype::Entity::EntityFieldSet::const_iterator field_iter =
                         ref_id_iter->second.begin();
@@ -1287,6 +1753,15 @@ namespace dbinterface
         }
     }
 
+    // ----------------------------------------------------------------------
+    bool UpdateManager::is_being_deleted(
+        const dbtype::Id &id,
+        const dbtype::Entity::IdSet &deleting)
+    {
+        return (deleting.find(id) != deleting.end()) or
+            is_entity_delete_pending(id);
+    }
+
     // ----------------------------------------------------------------------
     void UpdateManager::remove_reference_from_source(
         const dbtype::Id &target,
@@ -1640,6 +2115,15 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     UpdateManager::UpdateManager(void)
       : thread_ptr(0),
+        commit_interval_secs(5),
+        commit_max_entities(0),
+        commit_max_bytes(0),
+        backup_interval_mins(0),
+        average_entity_bytes(DEFAULT_AVERAGE_ENTITY_BYTES),
+        commit_requested(false),
+        bulk_load(false),
+        flushes_requested(0),
+        flushes_done(0),
         immediate_update_queue_sem(0),
         shutdown_thread_flag(false)
     {
@@ -1698,5 +2182,51 @@ namespace dbinterface
                 incoming_iter->second.second.end());
         }
     }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::EntityUpdate::merge_net_ids(
+        const dbtype::Entity::ChangedIdFieldsMap &ids)
+    {
+        for (dbtype::Entity::ChangedIdFieldsMap::const_iterator incoming_iter =
+              ids.begin();
+             incoming_iter != ids.end();
+            ++incoming_iter)
+        {
+            dbtype::Entity::IdsRemovedAdded &net_ids =
+                ids_changed[incoming_iter->first];
+
+            // Removing an ID that was added earlier cancels out the add,
+            // and adding an ID that was removed earlier cancels out the
+            // remove.  Removals are handled first, the same order
+            // process_id_references() uses.
+            //
+            for (dbtype::Entity::IdSet::const_iterator removed_iter =
+                    incoming_iter->second.first.begin();
+                removed_iter != incoming_iter->second.first.end();
+                ++removed_iter)
+            {
+                if (not net_ids.second.erase(*removed_iter))
+                {
+                    net_ids.first.insert(*removed_iter);
+                }
+            }
+
+            for (dbtype::Entity::IdSet::const_iterator added_iter =
+                    incoming_iter->second.second.begin();
+                added_iter != incoming_iter->second.second.end();
+                ++added_iter)
+            {
+                if (not net_ids.first.erase(*added_iter))
+                {
+                    net_ids.second.insert(*added_iter);
+                }
+            }
+
+            if (net_ids.first.empty() and net_ids.second.empty())
+            {
+                ids_changed.erase(incoming_iter->first);
+            }
+        }
+    }
 }
 }
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
 #include <boost/atomic/atomic.hpp>
@@ -16,6 +17,7 @@
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_DatabaseEntityChangeListener.h"
 #include "dbinterface_EntityRef.h"
+#include "dbinterface_CommitStats.h"
 #include "dbtypes/dbtype_EntityField.h"
 
 namespace mutgos
@@ -34,6 +36,18 @@ namespace dbinterface
      * Pending operations are queued for periodic processing on a thread.
      * In the future this could allow for some sort of transaction-based updates
      * to preserve integrity.
+     *
+     * Changes are committed in batches, when the configured commit interval
+     * has passed or sooner if too many changed Entities (by count or
+     * approximate memory) are waiting, whichever comes first.  The memory
+     * estimate uses the average Entity size measured by the site caches.
+     *
+     * If configured, this also starts an online database backup
+     * periodically.
+     *
+     * During a bulk load, back-references are not updated as each Entity
+     * changes.  The reference changes are merged per Entity and processed
+     * in a single pass when the bulk load ends.
      */
     class UpdateManager : public dbtype::DatabaseEntityChangeListener,
                                  osinterface::TimeJumpListener
@@ -197,6 +211,33 @@ namespace dbinterface
          */
         void site_deleted(const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * @return Statistics about commits to the database, and how many
+         * changes are waiting to be committed.
+         */
+        CommitStats get_commit_stats(void);
+
+        /**
+         * Enters bulk load mode.  Until end_bulk_load() is called, changes
+         * to ID fields are saved up rather than updating the referenced
+         * Entities' back-references immediately.
+         */
+        void begin_bulk_load(void);
+
+        /**
+         * Leaves bulk load mode, updating all the back-references saved up
+         * since begin_bulk_load() in one pass, and then waits until
+         * everything pending has been committed.
+         */
+        void end_bulk_load(void);
+
+        /**
+         * Blocks until everything changed before this call has been
+         * committed to the database.  Returns immediately if the thread is
+         * not running.
+         */
+        void flush(void);
+
         /**
          * Main loop of UpdateManager thread.
          */
@@ -209,6 +250,15 @@ namespace dbinterface
         typedef std::map<dbtype::Id::EntityIdType, OldNewName> RenameInfo;
         typedef std::map<dbtype::Id::SiteIdType , RenameInfo> PendingRename;
 
+        /** Why a batch of changes is being committed */
+        enum CommitReason
+        {
+            COMMIT_REASON_NONE, ///< Not committing
+            COMMIT_REASON_TIME, ///< Commit interval has passed
+            COMMIT_REASON_ENTITIES, ///< Too many changed Entities
+            COMMIT_REASON_MEMORY ///< Changed Entities use too much memory
+        };
+
         /**
          * Container class to hold all the updates pending for a given
          * Entity.
@@ -222,6 +272,12 @@ namespace dbinterface
              */
             EntityUpdate(dbtype::Entity *entity);
 
+            /**
+             * Container constructor, for when only the ID is known.
+             * @param id The ID of the Entity the update is for.
+             */
+            EntityUpdate(const dbtype::Id &id);
+
             /**
              * Takes the provided changes and merges them into what's
              * already in this instance.
@@ -235,6 +291,16 @@ namespace dbinterface
                 const dbtype::Entity::FlagsRemovedAdded &flags,
                 const dbtype::Entity::ChangedIdFieldsMap &ids);
 
+            /**
+             * Takes the provided ID changes and merges them into what's
+             * already in this instance, cancelling out an add and remove
+             * of the same ID so only the net change remains.  Unlike
+             * merge_update(), the result can be applied in one step.
+             * @param ids[in] Detailed information about changes
+             * concerning fields of type ID (or lists of IDs).
+             */
+            void merge_net_ids(const dbtype::Entity::ChangedIdFieldsMap &ids);
+
             const dbtype::Id entity_id; ///< ID of the Entity being updated
             dbtype::Entity::EntityFieldSet fields_changed; ///< Changed fields
             dbtype::Entity::FlagsRemovedAdded flags_changed; ///< Changed flags
@@ -252,8 +318,31 @@ namespace dbinterface
         /**
          * Called by the update thread, this will commit any changed
          * objects.
+         * @return How many changed Entities were committed by the batch,
+         * or 0 if it failed.
+         */
+        size_t process_db_commits(void);
+
+        /**
+         * Assumes locking has been done.
+         * @return Which limit on waiting changes has been reached, or
+         * COMMIT_REASON_NONE if none.  The commit interval is not checked.
+         */
+        CommitReason get_commit_limit_reached(void) const;
+
+        /**
+         * Updates the commit statistics and the average Entity size after
+         * a batch has been committed.
+         * The lock mutex is assumed to be UNLOCKED.
+         * @param reason[in] Why the batch was committed.
+         * @param batch_entities[in] How many changed Entities were in the
+         * batch.
+         * @param commit_usecs[in] How long the batch took, in microseconds.
          */
-        void process_db_commits(void);
+        void record_commit(
+            const CommitReason reason,
+            const size_t batch_entities,
+            const MG_LongUnsignedInt commit_usecs);
 
         /**
          * Given the IDs added and removed on a given Entity, update the
@@ -262,16 +351,46 @@ namespace dbinterface
          * @param id[in] The Entity whose fields are being updated.
          * @param changed_fields[in] The fields which have IDs being added
          * and/or removed.
+         * @return True if the reference index was updated.
          */
-        void process_id_references(
+        bool process_id_references(
             const dbtype::Id &id,
             const dbtype::Entity::ChangedIdFieldsMap changed_fields);
 
         /**
-         * Removes all references to the provided Entity.
+         * Merges reference index changes for an Entity into updates,
+         * adding an entry if needed.
+         * @param id[in] The Entity whose fields changed.
+         * @param changed_fields[in] The fields which have IDs being added
+         * and/or removed.
+         * @param updates[in,out] The reference index changes to merge
+         * into.
+         */
+        static void merge_reference_update(
+            const dbtype::Id &id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields,
+            PendingUpdatesMap &updates);
+
+        /**
+         * Removes all references to the provided Entity.  What it references
+         * comes from the reference index.  Entities that are themselves
+         * about to be deleted are not loaded or updated.
          * @param entity[in] The Entity to remove all references to.
+         * @param deleting[in] The other Entities being deleted along with
+         * this one.
          */
-        void remove_all_references(EntityRef &entity);
+        void remove_all_references(
+            EntityRef &entity,
+            const dbtype::Entity::IdSet &deleting);
+
+        /**
+         * @param id[in] The ID to check.
+         * @param deleting[in] The Entities currently being deleted.
+         * @return True if id is being deleted or is pending deletion.
+         */
+        bool is_being_deleted(
+            const dbtype::Id &id,
+            const dbtype::Entity::IdSet &deleting);
 
         /**
          * Given a valid target and source, remove the target from the source's
@@ -347,9 +466,22 @@ namespace dbinterface
 
         boost::mutex mutex; ///< Enforces single access at a time.
         boost::thread *thread_ptr; ///< Non-null when thread is running.
+        MG_UnsignedInt commit_interval_secs; ///< Max seconds between commits
+        size_t commit_max_entities; ///< Commit early if this many changed, or 0
+        size_t commit_max_bytes; ///< Commit early if this much memory changed, or 0
+        MG_UnsignedInt backup_interval_mins; ///< Minutes between backups, or 0
+        size_t average_entity_bytes; ///< Approximate memory of an Entity
+        bool commit_requested; ///< True if thread woken up to commit early
+        CommitStats commit_stats; ///< Commit statistics so far
+        bool bulk_load; ///< True if back-reference updates are deferred
+        MG_LongUnsignedInt flushes_requested; ///< Incremented by each flush()
+        MG_LongUnsignedInt flushes_done; ///< Last flush request committed
+        boost::condition_variable flush_cond; ///< Signalled when a flush is done
 
         PendingUpdatesMap pending_updates; ///< Updates to be committed
+        PendingUpdatesMap deferred_references; ///< Bulk load ID changes awaiting back-reference updates
         ImmediateUpdateQueue immediate_update_queue; ///< Updates to be processed immediately
+        PendingUpdatesMap unsaved_references; ///< Reference index changes to be written again
         PendingRename pending_program_registrations; ///< Program registrations about to be committed.
         PendingRename pending_player_names; ///< Player names about to be committed.
 
@@ -359,6 +491,7 @@ namespace dbinterface
 
         dbtype::Entity::IdSet pending_deletes; ///< Deletes to be committed
         dbtype::Id::SiteIdVector pending_site_deletes; ///< Pending site deletes
+        dbtype::Id::SiteIdVector pending_db_site_deletes; ///< Sites gone from cache, still in database
         boost::atomic<bool> shutdown_thread_flag; ///< True if thread should shutdown
     };
 
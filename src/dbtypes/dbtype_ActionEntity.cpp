@@ -53,7 +53,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new ActionEntity(
                 id,
@@ -128,7 +128,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             bool found_existing = false;
 
@@ -178,7 +178,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             bool found_existing = false;
 
@@ -226,7 +226,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not action_entity_targets.empty())
             {
@@ -267,7 +267,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (clear_action_target(token))
             {
@@ -310,7 +310,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not action_entity_targets.empty())
             {
@@ -341,7 +341,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity::IdVector::const_iterator iter = std::find(
                     action_entity_targets.begin(),
@@ -376,7 +376,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not action_entity_targets.empty())
             {
@@ -406,7 +406,7 @@ namespace dbtype
     {
         Entity::IdVector result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_targets;
         }
@@ -433,7 +433,7 @@ namespace dbtype
     {
         size_t result = 0;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_targets.size();
         }
@@ -461,7 +461,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (action_entity_lock_ptr)
             {
@@ -498,7 +498,7 @@ namespace dbtype
     {
         Lock result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (action_entity_lock_ptr)
             {
@@ -535,7 +535,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             action_entity_succ_msg = message;
             notify_field_changed(ENTITYFIELD_action_succ_msg);
@@ -565,7 +565,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_succ_msg;
         }
@@ -599,7 +599,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             action_entity_succ_room_msg = message;
             notify_field_changed(ENTITYFIELD_action_succ_room_msg);
@@ -630,7 +630,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_succ_room_msg;
         }
@@ -664,7 +664,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             action_entity_fail_msg = message;
             notify_field_changed(ENTITYFIELD_action_fail_msg);
@@ -694,7 +694,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_fail_msg;
         }
@@ -728,7 +728,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             action_entity_fail_room_msg = message;
             notify_field_changed(ENTITYFIELD_action_fail_room_msg);
@@ -759,7 +759,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_fail_room_msg;
         }
@@ -787,7 +787,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             set_single_id_field(
                 ENTITYFIELD_action_contained_by,
@@ -822,7 +822,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_contained_by;
         }
@@ -865,7 +865,7 @@ namespace dbtype
             }
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             action_entity_commands = commands;
             action_entity_commands.shrink_to_fit();
@@ -898,7 +898,7 @@ namespace dbtype
     {
         CommandList result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_commands;
         }
@@ -925,7 +925,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not action_entity_commands.empty())
             {
@@ -955,7 +955,7 @@ namespace dbtype
     {
         size_t result = 0;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = action_entity_commands.size();
         }
@@ -983,7 +983,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             const std::string command_normalized =
                 text::to_lower_copy(command);
@@ -1014,7 +1014,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = has_action_command_internal(command_lower);
         }
@@ -624,6 +624,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<PropertyEntity>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & action_entity_targets;
 
             bool has_lock = false;
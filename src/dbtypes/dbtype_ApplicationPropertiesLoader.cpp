@@ -0,0 +1,21 @@
+/*
+ * dbtype_ApplicationPropertiesLoader.cpp
+ */
+
+#include "dbtypes/dbtype_ApplicationPropertiesLoader.h"
+
+namespace mutgos
+{
+namespace dbtype
+{
+    // ----------------------------------------------------------------------
+    ApplicationPropertiesLoader::ApplicationPropertiesLoader(void)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    ApplicationPropertiesLoader::~ApplicationPropertiesLoader()
+    {
+    }
+} /* namespace dbtype */
+} /* namespace mutgos */
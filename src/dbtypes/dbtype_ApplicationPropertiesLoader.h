@@ -0,0 +1,57 @@
+/*
+ * dbtype_ApplicationPropertiesLoader.h
+ */
+
+#ifndef MUTGOS_DBTYPE_APPLICATIONPROPERTIESLOADER_H_
+#define MUTGOS_DBTYPE_APPLICATIONPROPERTIESLOADER_H_
+
+#include <string>
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+
+namespace mutgos
+{
+namespace dbtype
+{
+    /**
+     * Implemented by a database backend that stores the application
+     * properties of a PropertyEntity separately from the rest of the
+     * Entity.  The PropertyEntity calls this the first time an application
+     * is accessed, so Entities can be loaded without their (potentially
+     * large) property trees.
+     * @see PropertyEntity
+     */
+    class ApplicationPropertiesLoader
+    {
+    public:
+        /**
+         * Default constructor.
+         */
+        ApplicationPropertiesLoader(void);
+
+        /**
+         * Destructor.
+         */
+        virtual ~ApplicationPropertiesLoader();
+
+        /**
+         * Loads an application's properties from storage.
+         * This is called while the PropertyEntity is locked, so it must
+         * not try to lock the Entity or call back into it.
+         * @param entity_id[in] The ID of the PropertyEntity that owns the
+         * application.
+         * @param application[in] The name of the application to load.
+         * @param properties[out] The loaded application properties.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_application_properties(
+            const Id &entity_id,
+            const std::string &application,
+            ApplicationProperties &properties) =0;
+    };
+
+} /* namespace dbtype */
+} /* namespace mutgos */
+
+#endif /* MUTGOS_DBTYPE_APPLICATIONPROPERTIESLOADER_H_ */
@@ -46,7 +46,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Capability(
                 id,
@@ -38,7 +38,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Command(
                 id,
@@ -0,0 +1,206 @@
+/*
+ * dbtype_CompactArchive.cpp
+ */
+
+#include <string>
+#include <string.h>
+#include <stddef.h>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbtype_CompactArchive.h"
+
+namespace
+{
+    // Initial capacity of an empty output buffer.
+    const size_t INITIAL_BUFFER_SIZE = 512;
+}
+
+namespace mutgos
+{
+namespace dbtype
+{
+    const unsigned int CompactArchive::FORMAT_VERSION;
+    const unsigned int CompactArchive::EXTERNAL_APPLICATIONS_VERSION;
+    const unsigned int CompactArchive::EXTERNAL_COMPILED_CODE_VERSION;
+    const size_t CompactArchive::HEADER_SIZE;
+    const char CompactArchive::MAGIC_BYTES[HEADER_SIZE - 1] = { 'M', 'G', 'C' };
+    const unsigned char CompactArchive::SECTION_PLACEHOLDER;
+    const size_t CompactArchive::MAX_VARINT_SIZE;
+
+    // ----------------------------------------------------------------------
+    bool CompactArchive::is_compact_format(
+        const void *data_ptr,
+        const size_t data_size)
+    {
+        return data_ptr and (data_size >= HEADER_SIZE) and
+            (not memcmp(data_ptr, MAGIC_BYTES, sizeof(MAGIC_BYTES)));
+    }
+
+    // ----------------------------------------------------------------------
+    CompactOArchive::CompactOArchive(std::string &buffer)
+      : output(buffer)
+    {
+        output.clear();
+
+        if (output.capacity() < INITIAL_BUFFER_SIZE)
+        {
+            output.reserve(INITIAL_BUFFER_SIZE);
+        }
+
+        output.append(MAGIC_BYTES, sizeof(MAGIC_BYTES));
+        output.push_back((char) FORMAT_VERSION);
+    }
+
+    // ----------------------------------------------------------------------
+    CompactOArchive::~CompactOArchive()
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::write_varint(MG_VeryLongUnsignedInt value)
+    {
+        while (value >= 0x80)
+        {
+            output.push_back((char) ((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+
+        output.push_back((char) value);
+    }
+
+    // ----------------------------------------------------------------------
+    size_t CompactOArchive::begin_section(void)
+    {
+        // Nearly all sections are under 128 bytes, so reserve a single
+        // byte for the length and make room later if it turns out to be
+        // bigger.
+        //
+        const size_t section_start = output.size();
+        output.push_back((char) SECTION_PLACEHOLDER);
+        return section_start;
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::end_section(const size_t section_start)
+    {
+        MG_VeryLongUnsignedInt length = output.size() - section_start - 1;
+
+        if (length < 0x80)
+        {
+            output[section_start] = (char) length;
+        }
+        else
+        {
+            char encoded[MAX_VARINT_SIZE];
+            size_t encoded_size = 0;
+
+            while (length >= 0x80)
+            {
+                encoded[encoded_size++] = (char) ((length & 0x7F) | 0x80);
+                length >>= 7;
+            }
+
+            encoded[encoded_size++] = (char) length;
+
+            output[section_start] = encoded[0];
+            output.insert(section_start + 1, encoded + 1, encoded_size - 1);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    CompactIArchive::CompactIArchive(
+        const void *data_ptr,
+        const size_t data_size)
+      : data((const char *) data_ptr),
+        data_size(data_size),
+        position(HEADER_SIZE),
+        section_end(data_size),
+        format_version(0),
+        error(false)
+    {
+        if (not is_compact_format(data_ptr, data_size))
+        {
+            error = true;
+        }
+        else
+        {
+            format_version =
+                (unsigned char) data[HEADER_SIZE - 1];
+
+            // Data written by a newer version cannot be understood.
+            error = (not format_version) or (format_version > FORMAT_VERSION);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    CompactIArchive::~CompactIArchive()
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    bool CompactIArchive::read_varint(MG_VeryLongUnsignedInt &value)
+    {
+        bool success = has_field();
+
+        if (success)
+        {
+            MG_VeryLongUnsignedInt result = 0;
+            unsigned int shift = 0;
+            bool more = true;
+
+            while (more and (not error))
+            {
+                if ((position >= section_end) or (shift >= 64))
+                {
+                    // Ran off the end of the section, or too long.
+                    error = true;
+                }
+                else
+                {
+                    const unsigned char byte =
+                        (unsigned char) data[position++];
+
+                    result |= ((MG_VeryLongUnsignedInt) (byte & 0x7F)) << shift;
+                    shift += 7;
+                    more = byte & 0x80;
+                }
+            }
+
+            success = not error;
+
+            if (success)
+            {
+                value = result;
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool CompactIArchive::read_count(size_t &count)
+    {
+        MG_VeryLongUnsignedInt value = 0;
+        bool success = read_varint(value);
+
+        if (success)
+        {
+            // Every element takes at least one byte, so anything larger
+            // than what's left is corrupt.
+            //
+            if (value > (section_end - position))
+            {
+                error = true;
+                success = false;
+            }
+            else
+            {
+                count = value;
+            }
+        }
+
+        return success;
+    }
+} /* namespace dbtype */
+} /* namespace mutgos */
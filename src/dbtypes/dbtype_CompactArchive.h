@@ -0,0 +1,811 @@
+/*
+ * dbtype_CompactArchive.h
+ */
+
+#ifndef MUTGOS_DBTYPE_COMPACTARCHIVE_H_
+#define MUTGOS_DBTYPE_COMPACTARCHIVE_H_
+
+#include <string>
+#include <set>
+#include <map>
+#include <vector>
+#include <bitset>
+#include <utility>
+#include <string.h>
+#include <stddef.h>
+
+#include <boost/mpl/bool.hpp>
+#include <boost/mpl/eval_if.hpp>
+#include <boost/mpl/identity.hpp>
+#include <boost/type_traits/is_enum.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/serialization/serialization.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbtypes/dbtype_Id.h"
+
+namespace mutgos
+{
+namespace dbtype
+{
+    /**
+     * Common definitions for the compact archive format, used to store
+     * Entities in the database.
+     *
+     * The format is a short header (magic bytes and a format version)
+     * followed by the serialized object.  Integers and enums are stored as
+     * variable length integers, floating point and booleans as raw bytes,
+     * strings and containers as a count followed by their contents.  Every
+     * class (other than Id) is stored as a length prefixed section, and a
+     * field is identified by its position within the section of the class
+     * that serializes it.
+     *
+     * Because sections have a length, a field may be appended to the end of
+     * any class's save()/load() without changing the format version:  when
+     * reading older data, fields past the end of a section are left at
+     * whatever the constructor set them to, and when reading newer data,
+     * unknown trailing fields are skipped.  Any other change (removing,
+     * reordering or changing the type of a field) requires incrementing
+     * FORMAT_VERSION; the version is passed to every load() so a class can
+     * tell what it is reading.
+     *
+     * Floating point values are stored in native byte order, as the
+     * previous Boost binary archives were.
+     *
+     * Format versions:
+     *   1 - Initial version.
+     *   2 - PropertyEntity stores only its application names; the
+     *       application properties themselves are stored separately by the
+     *       database backend.
+     *   3 - Program stores only whether it has compiled code; the compiled
+     *       code itself is stored separately by the database backend.
+     */
+    class CompactArchive
+    {
+    public:
+        /** The format version written by CompactOArchive */
+        static const unsigned int FORMAT_VERSION = 3;
+
+        /** First format version where a PropertyEntity's application
+            properties are stored outside of the Entity */
+        static const unsigned int EXTERNAL_APPLICATIONS_VERSION = 2;
+
+        /** First format version where a Program's compiled code is stored
+            outside of the Entity */
+        static const unsigned int EXTERNAL_COMPILED_CODE_VERSION = 3;
+
+        /** Size of the header, in bytes */
+        static const size_t HEADER_SIZE = 4;
+
+        /**
+         * Determines if the given data is in the compact archive format,
+         * as opposed to a legacy Boost archive.  The version is not checked.
+         * @param data_ptr[in] The data to check.
+         * @param data_size[in] The size of the data, in bytes.
+         * @return True if the data has a compact archive header.
+         */
+        static bool is_compact_format(
+            const void *data_ptr,
+            const size_t data_size);
+
+    protected:
+        /** Magic bytes that start every compact archive */
+        static const char MAGIC_BYTES[HEADER_SIZE - 1];
+
+        /** Placeholder for the length of a section that's being written */
+        static const unsigned char SECTION_PLACEHOLDER = 0;
+
+        /** Maximum size of a variable length 64 bit integer */
+        static const size_t MAX_VARINT_SIZE = 10;
+
+        // Used to select how each type of value is stored.
+        //
+        struct ClassValue {};
+        struct EnumValue {};
+        struct IntegerValue {};
+        struct FloatValue {};
+
+        /**
+         * Determines which of the above value types T is.
+         */
+        template<class T>
+        struct ValueCategory
+        {
+            typedef typename boost::mpl::eval_if<
+                boost::is_enum<T>,
+                boost::mpl::identity<EnumValue>,
+                boost::mpl::eval_if<
+                    boost::is_floating_point<T>,
+                    boost::mpl::identity<FloatValue>,
+                    boost::mpl::eval_if<
+                        boost::is_integral<T>,
+                        boost::mpl::identity<IntegerValue>,
+                        boost::mpl::identity<ClassValue> > > >::type type;
+        };
+
+        /**
+         * Encodes a signed integer so that small negative numbers also
+         * encode to small unsigned numbers.
+         * @param value[in] The value to encode.
+         * @return The encoded value.
+         */
+        static inline MG_VeryLongUnsignedInt zigzag_encode(
+            const long long value)
+        {
+            return (((MG_VeryLongUnsignedInt) value) << 1) ^
+                ((MG_VeryLongUnsignedInt) (value >> 63));
+        }
+
+        /**
+         * Decodes a value encoded with zigzag_encode().
+         * @param value[in] The value to decode.
+         * @return The decoded value.
+         */
+        static inline long long zigzag_decode(
+            const MG_VeryLongUnsignedInt value)
+        {
+            return (long long) ((value >> 1) ^ (~(value & 1) + 1));
+        }
+
+        CompactArchive(void)
+          { }
+
+        ~CompactArchive()
+          { }
+    };
+
+    /**
+     * Serializes anything that supports Boost Serialization style
+     * save()/load() into the compact archive format.  This is not a Boost
+     * archive; it only provides what the dbtypes classes use, and none of the
+     * Boost archive machinery (class information, object tracking, etc).
+     *
+     * The output is written directly into a caller provided buffer, which is
+     * cleared (but keeps its capacity) when this is constructed.  This allows
+     * the buffer to be reused when serializing many objects.
+     *
+     * This class is not thread safe.
+     */
+    class CompactOArchive : public CompactArchive
+    {
+    public:
+        typedef boost::mpl::bool_<true> is_saving;
+        typedef boost::mpl::bool_<false> is_loading;
+
+        /**
+         * Constructs an output archive and writes the header.
+         * @param buffer[out] The buffer to write the serialized data to.  It
+         * must remain valid for the life of this archive.
+         */
+        CompactOArchive(std::string &buffer);
+
+        /**
+         * Destructor.
+         */
+        ~CompactOArchive();
+
+        /**
+         * Serializes a value.
+         * @param value[in] The value to serialize.
+         * @return This.
+         */
+        template<class T>
+        CompactOArchive &operator&(const T &value)
+        {
+            save(value);
+            return *this;
+        }
+
+        /**
+         * Serializes a value.
+         * @param value[in] The value to serialize.
+         * @return This.
+         */
+        template<class T>
+        CompactOArchive &operator<<(const T &value)
+        {
+            save(value);
+            return *this;
+        }
+
+    private:
+        /**
+         * Serializes a value of any supported type.
+         * @param value[in] The value to serialize.
+         */
+        template<class T>
+        void save(const T &value)
+        {
+            save_value(value, typename ValueCategory<T>::type());
+        }
+
+        /**
+         * Serializes a boolean.
+         * @param value[in] The value to serialize.
+         */
+        void save(const bool value)
+        {
+            output.push_back(value ? 1 : 0);
+        }
+
+        /**
+         * Serializes a string.
+         * @param value[in] The value to serialize.
+         */
+        void save(const std::string &value)
+        {
+            write_varint(value.size());
+            output.append(value);
+        }
+
+        /**
+         * Serializes an Id.  Ids are so common that they are not put in
+         * their own section.
+         * @param value[in] The value to serialize.
+         */
+        void save(const Id &value)
+        {
+            write_varint(value.get_site_id());
+            write_varint(value.get_entity_id());
+        }
+
+        /**
+         * Serializes a pair.
+         * @param value[in] The value to serialize.
+         */
+        template<class F, class S>
+        void save(const std::pair<F, S> &value)
+        {
+            save(value.first);
+            save(value.second);
+        }
+
+        /**
+         * Serializes a vector.
+         * @param value[in] The value to serialize.
+         */
+        template<class T, class A>
+        void save(const std::vector<T, A> &value)
+        {
+            write_varint(value.size());
+
+            for (typename std::vector<T, A>::const_iterator iter =
+                    value.begin();
+                iter != value.end();
+                ++iter)
+            {
+                save(*iter);
+            }
+        }
+
+        /**
+         * Serializes a set.
+         * @param value[in] The value to serialize.
+         */
+        template<class T, class C, class A>
+        void save(const std::set<T, C, A> &value)
+        {
+            write_varint(value.size());
+
+            for (typename std::set<T, C, A>::const_iterator iter =
+                    value.begin();
+                iter != value.end();
+                ++iter)
+            {
+                save(*iter);
+            }
+        }
+
+        /**
+         * Serializes a map.
+         * @param value[in] The value to serialize.
+         */
+        template<class K, class V, class C, class A>
+        void save(const std::map<K, V, C, A> &value)
+        {
+            write_varint(value.size());
+
+            for (typename std::map<K, V, C, A>::const_iterator iter =
+                    value.begin();
+                iter != value.end();
+                ++iter)
+            {
+                save(iter->first);
+                save(iter->second);
+            }
+        }
+
+        /**
+         * Serializes a bitset.
+         * @param value[in] The value to serialize.
+         */
+        template<size_t N>
+        void save(const std::bitset<N> &value)
+        {
+            unsigned char bits = 0;
+
+            write_varint(N);
+
+            for (size_t index = 0; index < N; ++index)
+            {
+                if (value.test(index))
+                {
+                    bits |= (unsigned char) (1 << (index % 8));
+                }
+
+                if (((index % 8) == 7) or (index == (N - 1)))
+                {
+                    output.push_back(bits);
+                    bits = 0;
+                }
+            }
+        }
+
+        /**
+         * Serializes a class in its own section, using its save() method.
+         * @param value[in] The value to serialize.
+         */
+        template<class T>
+        void save_value(const T &value, const ClassValue &)
+        {
+            const size_t section_start = begin_section();
+
+            boost::serialization::serialize_adl(
+                *this,
+                const_cast<T &>(value),
+                FORMAT_VERSION);
+
+            end_section(section_start);
+        }
+
+        /**
+         * Serializes an enum.
+         * @param value[in] The value to serialize.
+         */
+        template<class T>
+        void save_value(const T &value, const EnumValue &)
+        {
+            write_varint(zigzag_encode((long long) value));
+        }
+
+        /**
+         * Serializes an integer.
+         * @param value[in] The value to serialize.
+         */
+        template<class T>
+        void save_value(const T &value, const IntegerValue &)
+        {
+            if (boost::is_signed<T>::value)
+            {
+                write_varint(zigzag_encode((long long) value));
+            }
+            else
+            {
+                write_varint((MG_VeryLongUnsignedInt) value);
+            }
+        }
+
+        /**
+         * Serializes a floating point number.
+         * @param value[in] The value to serialize.
+         */
+        template<class T>
+        void save_value(const T &value, const FloatValue &)
+        {
+            output.append((const char *) &value, sizeof(T));
+        }
+
+        /**
+         * Writes a variable length integer.
+         * @param value[in] The value to write.
+         */
+        void write_varint(MG_VeryLongUnsignedInt value);
+
+        /**
+         * Starts a length prefixed section.
+         * @return The offset of the section's length, to be passed to
+         * end_section().
+         */
+        size_t begin_section(void);
+
+        /**
+         * Finishes a length prefixed section by filling in its length.
+         * @param section_start[in] What begin_section() returned.
+         */
+        void end_section(const size_t section_start);
+
+        std::string &output; ///< Where the serialized data goes
+
+        // No copying
+        //
+        CompactOArchive(const CompactOArchive &rhs);
+        CompactOArchive &operator=(const CompactOArchive &rhs);
+    };
+
+    /**
+     * Deserializes anything that supports Boost Serialization style
+     * save()/load() from the compact archive format.  Data is read in place
+     * from the provided pointer; nothing is copied except into the object
+     * being deserialized.
+     *
+     * If the data is corrupt or from an unsupported version, good() will
+     * return false and nothing more will be read.  Deserialized objects
+     * may be incomplete in that case.
+     *
+     * This class is not thread safe.
+     */
+    class CompactIArchive : public CompactArchive
+    {
+    public:
+        typedef boost::mpl::bool_<false> is_saving;
+        typedef boost::mpl::bool_<true> is_loading;
+
+        /**
+         * Constructs an input archive and checks the header.
+         * @param data_ptr[in] The data to read.  It must remain valid and
+         * unchanged for the life of this archive.
+         * @param data_size[in] The size of the data, in bytes.
+         */
+        CompactIArchive(const void *data_ptr, const size_t data_size);
+
+        /**
+         * Destructor.
+         */
+        ~CompactIArchive();
+
+        /**
+         * @return True if no errors have been encountered.
+         */
+        bool good(void) const
+          { return not error; }
+
+        /**
+         * @return The format version of the data being read.
+         */
+        unsigned int get_format_version(void) const
+          { return format_version; }
+
+        /**
+         * Deserializes a value.
+         * @param value[out] The value to deserialize into.
+         * @return This.
+         */
+        template<class T>
+        CompactIArchive &operator&(T &value)
+        {
+            load(value);
+            return *this;
+        }
+
+        /**
+         * Deserializes a value.
+         * @param value[out] The value to deserialize into.
+         * @return This.
+         */
+        template<class T>
+        CompactIArchive &operator>>(T &value)
+        {
+            load(value);
+            return *this;
+        }
+
+    private:
+        /**
+         * Deserializes a value of any supported type.  If the current
+         * section has no more fields, the value is left unchanged.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T>
+        void load(T &value)
+        {
+            load_value(value, typename ValueCategory<T>::type());
+        }
+
+        /**
+         * Deserializes a boolean.
+         * @param value[out] The value to deserialize into.
+         */
+        void load(bool &value)
+        {
+            if (has_field())
+            {
+                const unsigned char byte = (unsigned char) data[position++];
+
+                if (byte > 1)
+                {
+                    error = true;
+                }
+                else
+                {
+                    value = byte;
+                }
+            }
+        }
+
+        /**
+         * Deserializes a string.
+         * @param value[out] The value to deserialize into.
+         */
+        void load(std::string &value)
+        {
+            MG_VeryLongUnsignedInt length = 0;
+
+            if (read_varint(length))
+            {
+                if (length > (section_end - position))
+                {
+                    error = true;
+                }
+                else
+                {
+                    value.assign(data + position, length);
+                    position += length;
+                }
+            }
+        }
+
+        /**
+         * Deserializes an Id.
+         * @param value[out] The value to deserialize into.
+         */
+        void load(Id &value)
+        {
+            MG_VeryLongUnsignedInt site_id = 0;
+            MG_VeryLongUnsignedInt entity_id = 0;
+
+            if (read_varint(site_id) and read_varint(entity_id))
+            {
+                value = Id(site_id, entity_id);
+            }
+        }
+
+        /**
+         * Deserializes a pair.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class F, class S>
+        void load(std::pair<F, S> &value)
+        {
+            load(value.first);
+            load(value.second);
+        }
+
+        /**
+         * Deserializes a vector.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T, class A>
+        void load(std::vector<T, A> &value)
+        {
+            size_t count = 0;
+
+            if (read_count(count))
+            {
+                value.clear();
+                value.resize(count);
+
+                for (size_t index = 0; index < count; ++index)
+                {
+                    load(value[index]);
+                }
+            }
+        }
+
+        /**
+         * Deserializes a set.  Sets are saved in order, so each element is
+         * inserted at the end.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T, class C, class A>
+        void load(std::set<T, C, A> &value)
+        {
+            size_t count = 0;
+
+            if (read_count(count))
+            {
+                value.clear();
+
+                for (size_t index = 0; index < count; ++index)
+                {
+                    T element = T();
+                    load(element);
+                    value.insert(value.end(), element);
+                }
+            }
+        }
+
+        /**
+         * Deserializes a map.  Maps are saved in order, so each element is
+         * inserted at the end, and then its value is loaded in place.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class K, class V, class C, class A>
+        void load(std::map<K, V, C, A> &value)
+        {
+            size_t count = 0;
+
+            if (read_count(count))
+            {
+                value.clear();
+
+                for (size_t index = 0; index < count; ++index)
+                {
+                    K key = K();
+                    load(key);
+
+                    typename std::map<K, V, C, A>::iterator iter =
+                        value.insert(value.end(), std::make_pair(key, V()));
+                    load(iter->second);
+                }
+            }
+        }
+
+        /**
+         * Deserializes a bitset.
+         * @param value[out] The value to deserialize into.
+         */
+        template<size_t N>
+        void load(std::bitset<N> &value)
+        {
+            MG_VeryLongUnsignedInt bit_count = 0;
+
+            if (read_varint(bit_count))
+            {
+                const MG_VeryLongUnsignedInt byte_count = (bit_count + 7) / 8;
+
+                if (byte_count > (section_end - position))
+                {
+                    error = true;
+                }
+                else
+                {
+                    value.reset();
+
+                    for (size_t index = 0;
+                         (index < bit_count) and (index < N);
+                         ++index)
+                    {
+                        value.set(
+                            index,
+                            (((unsigned char) data[position + (index / 8)])
+                                >> (index % 8)) & 1);
+                    }
+
+                    position += byte_count;
+                }
+            }
+        }
+
+        /**
+         * Deserializes a class from its section, using its load() method.
+         * Any fields in the section that load() did not read are skipped.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T>
+        void load_value(T &value, const ClassValue &)
+        {
+            MG_VeryLongUnsignedInt length = 0;
+
+            if (read_varint(length))
+            {
+                if (length > (section_end - position))
+                {
+                    error = true;
+                }
+                else
+                {
+                    const size_t outer_section_end = section_end;
+                    section_end = position + length;
+
+                    boost::serialization::serialize_adl(
+                        *this,
+                        value,
+                        format_version);
+
+                    position = section_end;
+                    section_end = outer_section_end;
+                }
+            }
+        }
+
+        /**
+         * Deserializes an enum.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T>
+        void load_value(T &value, const EnumValue &)
+        {
+            MG_VeryLongUnsignedInt encoded = 0;
+
+            if (read_varint(encoded))
+            {
+                value = static_cast<T>(zigzag_decode(encoded));
+            }
+        }
+
+        /**
+         * Deserializes an integer.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T>
+        void load_value(T &value, const IntegerValue &)
+        {
+            MG_VeryLongUnsignedInt encoded = 0;
+
+            if (read_varint(encoded))
+            {
+                if (boost::is_signed<T>::value)
+                {
+                    value = (T) zigzag_decode(encoded);
+                }
+                else
+                {
+                    value = (T) encoded;
+                }
+            }
+        }
+
+        /**
+         * Deserializes a floating point number.
+         * @param value[out] The value to deserialize into.
+         */
+        template<class T>
+        void load_value(T &value, const FloatValue &)
+        {
+            if (has_field())
+            {
+                if (sizeof(T) > (section_end - position))
+                {
+                    error = true;
+                }
+                else
+                {
+                    memcpy(&value, data + position, sizeof(T));
+                    position += sizeof(T);
+                }
+            }
+        }
+
+        /**
+         * @return True if there are more fields to read in the current
+         * section and no error has occurred.
+         */
+        bool has_field(void) const
+          { return (not error) and (position < section_end); }
+
+        /**
+         * Reads a variable length integer.
+         * @param value[out] The integer read.
+         * @return True if an integer was read, false if there are no more
+         * fields in the section or an error occurred.
+         */
+        bool read_varint(MG_VeryLongUnsignedInt &value);
+
+        /**
+         * Reads the number of elements in a container, sanity checking it
+         * against the remaining data.
+         * @param count[out] The number of elements.
+         * @return True if a count was read, false if there are no more
+         * fields in the section or an error occurred.
+         */
+        bool read_count(size_t &count);
+
+        const char * const data; ///< The data being read
+        const size_t data_size; ///< Size of data
+        size_t position; ///< Offset in data of next byte to read
+        size_t section_end; ///< Offset in data where current section ends
+        unsigned int format_version; ///< Version of data being read
+        bool error; ///< True if corrupt or unsupported data was found
+
+        // No copying
+        //
+        CompactIArchive(const CompactIArchive &rhs);
+        CompactIArchive &operator=(const CompactIArchive &rhs);
+    };
+} /* namespace dbtype */
+} /* namespace mutgos */
+
+#endif /* MUTGOS_DBTYPE_COMPACTARCHIVE_H_ */
@@ -43,7 +43,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new ContainerPropertyEntity(
                 id,
@@ -84,6 +84,7 @@ namespace dbtype
     std::string ContainerPropertyEntity::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -186,7 +187,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (linked_programs.insert(id).second)
             {
@@ -221,7 +222,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdSet::iterator prog_iter = linked_programs.find(id);
 
@@ -260,7 +261,7 @@ namespace dbtype
     {
         bool linked = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             linked = linked_programs.find(id) != linked_programs.end();
         }
@@ -287,7 +288,7 @@ namespace dbtype
     {
         size_t result = 0;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = linked_programs.size();
         }
@@ -314,7 +315,7 @@ namespace dbtype
     {
         IdVector result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result.reserve(linked_programs.size());
             result.insert(
@@ -345,7 +346,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not linked_programs.empty())
             {
@@ -376,7 +377,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdSet::const_iterator prog_iter = linked_programs.find(id);
 
@@ -415,7 +416,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not linked_programs.empty())
             {
@@ -446,7 +447,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -484,7 +485,7 @@ namespace dbtype
     {
         PathString result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -517,7 +518,7 @@ namespace dbtype
     {
         PathString result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -550,7 +551,7 @@ namespace dbtype
     {
         PathString result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -583,7 +584,7 @@ namespace dbtype
     {
         PathString result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -615,7 +616,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -660,7 +661,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not registrations_ptr)
             {
@@ -702,7 +703,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -733,7 +734,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (registrations_ptr)
             {
@@ -763,7 +764,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = true;
 
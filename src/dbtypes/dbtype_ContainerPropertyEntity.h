@@ -545,7 +545,24 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<PropertyEntity>(*this);
 
-            ar & contained_by;
+            if (is_decoding_body())
+            {
+                // Decoded earlier as part of the header, and may have
+                // changed since.
+                //
+                Id header_contained_by;
+                ar & header_contained_by;
+            }
+            else
+            {
+                ar & contained_by;
+
+                if (is_decoding_header())
+                {
+                    return;
+                }
+            }
+
             ar & linked_programs;
 
             bool has_reg = false;
@@ -18,6 +18,7 @@
 #include "dbtypes/dbtype_EntityType.h"
 #include "dbtypes/dbtype_Id.h"
 #include "dbtypes/dbtype_DatabaseEntityChangeListener.h"
+#include "dbtypes/dbtype_EntityBodyLoader.h"
 
 #include "concurrency/concurrency_ReaderLockToken.h"
 #include "concurrency/concurrency_WriterLockToken.h"
@@ -54,7 +55,10 @@ namespace dbtype
         dirty_flag(false),
         ignore_changes(false),
         locked_thread_id_valid(false),
-        inner_lock_count(0)
+        inner_lock_count(0),
+        decode_phase(DECODE_all),
+        body_deferred(false),
+        body_loader_ptr(0)
     {
         notify_field_changed(ENTITYFIELD_type);
         notify_field_changed(ENTITYFIELD_id);
@@ -85,7 +89,10 @@ namespace dbtype
         dirty_flag(false),
         ignore_changes(true),
         locked_thread_id_valid(false),
-        inner_lock_count(0)
+        inner_lock_count(0),
+        decode_phase(DECODE_all),
+        body_deferred(false),
+        body_loader_ptr(0)
     {
         entity_references_field.resize(ENTITYFIELD_END, 0);
     }
@@ -103,6 +110,11 @@ namespace dbtype
     {
         if (token.has_lock(*this))
         {
+            // Counting what has been decoded so far must not happen
+            // while the body is being decoded by another reader.
+            //
+            boost::lock_guard<boost::mutex> guard(body_load_mutex);
+
             return sizeof(*this) + mem_used_fields();
         }
         else
@@ -143,7 +155,10 @@ namespace dbtype
         dirty_flag(false),
         ignore_changes(restoring),
         locked_thread_id_valid(false),
-        inner_lock_count(0)
+        inner_lock_count(0),
+        decode_phase(DECODE_all),
+        body_deferred(false),
+        body_loader_ptr(0)
     {
         if (not restoring)
         {
@@ -172,7 +187,7 @@ namespace dbtype
         const Entity::InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Entity(
                 id,
@@ -237,6 +252,94 @@ namespace dbtype
         }
     }
 
+    // -----------------------------------------------------------------------
+    void Entity::set_decode_phase(const Entity::DecodePhase phase)
+    {
+        if (ignore_changes)
+        {
+            decode_phase = phase;
+        }
+        else
+        {
+            LOG(error, "dbtype", "set_decode_phase",
+                "Called when not deserializing!");
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    void Entity::defer_body(
+        const void *data_ptr,
+        const size_t data_size,
+        EntityBodyLoader *loader_ptr)
+    {
+        if (ignore_changes)
+        {
+            deferred_data.assign((const char *) data_ptr, data_size);
+            body_loader_ptr = loader_ptr;
+            body_deferred = true;
+        }
+        else
+        {
+            LOG(error, "dbtype", "defer_body",
+                "Called when not deserializing!");
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    bool Entity::ensure_body_loaded(void)
+    {
+        if (not body_deferred)
+        {
+            return true;
+        }
+
+        // Readers may get here at the same time, so decoding is
+        // serialized.  Once decoded, the body is never deferred again.
+        //
+        boost::lock_guard<boost::mutex> guard(body_load_mutex);
+
+        if (body_deferred)
+        {
+            decode_phase = DECODE_body;
+
+            const bool decoded = body_loader_ptr and
+                body_loader_ptr->load_entity_body(this, deferred_data);
+
+            decode_phase = DECODE_all;
+
+            if (decoded)
+            {
+                std::string().swap(deferred_data);
+                body_deferred = false;
+            }
+            else
+            {
+                LOG(error, "dbtype", "ensure_body_loaded",
+                    "Could not decode the rest of "
+                    + entity_id.to_string(true));
+
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------
+    bool Entity::has_lock_and_body(concurrency::ReaderLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            // If the body cannot be decoded, the error has been logged
+            // and the accessor will act as if the fields are empty.
+            //
+            ensure_body_loaded();
+            return true;
+        }
+
+        return false;
+    }
+
     // -----------------------------------------------------------------------
     void Entity::restore_complete(void)
     {
@@ -296,6 +399,7 @@ namespace dbtype
     std::string Entity::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -664,8 +768,10 @@ namespace dbtype
     {
         if (token.has_lock(*this))
         {
+            // Not a change to the Entity as such; the database saves these
+            // separately, so don't make the Entity dirty.
+            //
             entity_accessed_timestamp.set_to_now();
-            notify_field_changed(ENTITYFIELD_accessed_timestamp);
 
             if (entity_access_count <
                 std::numeric_limits<AccessCountType>::max())
@@ -673,8 +779,6 @@ namespace dbtype
                 ++entity_access_count;
             }
 
-            notify_field_changed(ENTITYFIELD_access_count);
-
             return true;
         }
         else
@@ -782,7 +886,7 @@ namespace dbtype
     {
         std::string add_flag = flag;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (entity_flags.find(add_flag) != entity_flags.end())
             {
@@ -817,7 +921,7 @@ namespace dbtype
     {
         std::string remove_flag = flag;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             FlagSet::iterator iter = entity_flags.find(remove_flag);
 
@@ -855,7 +959,7 @@ namespace dbtype
     {
         std::string check_flag = flag;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             FlagSet::iterator iter = entity_flags.find(check_flag);
 
@@ -891,7 +995,7 @@ namespace dbtype
     // -----------------------------------------------------------------------
     Entity::FlagSet Entity::get_entity_flags(concurrency::ReaderLockToken& token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             return entity_flags;
         }
@@ -925,7 +1029,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             entity_references[id].insert(field);
 
@@ -975,7 +1079,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdFieldsMap::iterator entity_iter =
                 entity_references.find(id);
@@ -1030,7 +1134,7 @@ namespace dbtype
         const Id &id,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdFieldsMap::iterator iter = entity_references.find(id);
 
@@ -1086,7 +1190,7 @@ namespace dbtype
         const Id &id,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdFieldsMap::iterator entity_iter =
                 entity_references.find(id);
@@ -1121,7 +1225,7 @@ namespace dbtype
     // -----------------------------------------------------------------------
     Entity::IdSet Entity::get_reference_ids(concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdSet ids;
 
@@ -1156,7 +1260,7 @@ namespace dbtype
     Entity::IdFieldsMap Entity::get_all_references(
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             return entity_references;
         }
@@ -1180,7 +1284,7 @@ namespace dbtype
     // -----------------------------------------------------------------------
     Id Entity::get_first_reference(concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not entity_references.empty())
             {
@@ -1209,7 +1313,7 @@ namespace dbtype
         const Id &id,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             IdFieldsMap::const_iterator entity_iter =
                 entity_references.find(id);
@@ -1244,7 +1348,7 @@ namespace dbtype
     // -----------------------------------------------------------------------
     Id Entity::get_last_reference(concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not entity_references.empty())
             {
@@ -1280,7 +1384,7 @@ namespace dbtype
             LOG(fatal, "dbtype", "get_reference_ids(field)",
                 "field out of range!");
         }
-        else if (token.has_lock(*this))
+        else if (has_lock_and_body(token))
         {
             IdSet *id_set_ptr = entity_references_field[field];
 
@@ -1324,7 +1428,7 @@ namespace dbtype
             LOG(fatal, "dbtype", "get_reference_ids_append(field)",
                 "field out of range!");
         }
-        else if (token.has_lock(*this))
+        else if (has_lock_and_body(token))
         {
             IdSet *id_set_ptr = entity_references_field[field];
 
@@ -1367,7 +1471,7 @@ namespace dbtype
             LOG(fatal, "dbtype", "get_first_reference(field)",
                 "field out of range!");
         }
-        else if (token.has_lock(*this))
+        else if (has_lock_and_body(token))
         {
             IdSet *id_set_ptr = entity_references_field[field];
 
@@ -1404,7 +1508,7 @@ namespace dbtype
             LOG(fatal, "dbtype", "get_next_reference(field)",
                 "field out of range!");
         }
-        else if (token.has_lock(*this))
+        else if (has_lock_and_body(token))
         {
             IdSet *id_set_ptr = entity_references_field[field];
 
@@ -1451,7 +1555,7 @@ namespace dbtype
             LOG(fatal, "dbtype", "get_last_reference(field)",
                 "field out of range!");
         }
-        else if (token.has_lock(*this))
+        else if (has_lock_and_body(token))
         {
             IdSet *id_set_ptr = entity_references_field[field];
 
@@ -1480,7 +1584,7 @@ namespace dbtype
     // -----------------------------------------------------------------------
     bool Entity::clear_all_references(concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             entity_references.clear();
             clear_entity_references_field();
@@ -1509,7 +1613,7 @@ namespace dbtype
     Entity::DeleteBatchId Entity::get_delete_batch_id(
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             return entity_delete_batch_id;
         }
@@ -1535,7 +1639,7 @@ namespace dbtype
         const Entity::DeleteBatchId delete_id,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             entity_delete_batch_id = delete_id;
             notify_field_changed(ENTITYFIELD_delete_batch_id);
@@ -1563,7 +1667,7 @@ namespace dbtype
     // -----------------------------------------------------------------------
     bool Entity::get_deleted_flag(concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             return entity_deleted_flag;
         }
@@ -1589,7 +1693,7 @@ namespace dbtype
         const bool deleted,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             entity_deleted_flag = deleted;
             notify_field_changed(ENTITYFIELD_deleted_flag);
@@ -1755,6 +1859,10 @@ namespace dbtype
                    + (ref_iter->second.size() * sizeof(EntityField));
         }
 
+        // Not yet decoded
+        //
+        memory += deferred_data.capacity();
+
         return memory;
     }
 
@@ -20,6 +20,7 @@
 
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/atomic/atomic.hpp>
 
 #include "osinterface/osinterface_OsTypes.h"
 #include "osinterface/osinterface_ThreadUtils.h"
@@ -50,6 +51,7 @@ namespace mutgos
 namespace dbtype
 {
     class DatabaseEntityChangeListener;
+    class EntityBodyLoader;
 
     /**
      * Represents an Entity database type, the root object type of everything
@@ -121,6 +123,16 @@ namespace dbtype
             FLAGRC_lock_error ///< Wrong lock token used
         };
 
+        /** How much of a serialized Entity load() is to decode.  The
+         *  header is every Entity field up to and including the owner,
+         *  plus what ContainerPropertyEntity is contained by. */
+        enum DecodePhase
+        {
+            DECODE_all,     ///< Decode everything (normal)
+            DECODE_header,  ///< Decode only the header
+            DECODE_body     ///< Decode everything but the header
+        };
+
         /**
          * Constructs an Entity (final type).
          * @param id[in] The ID of the entity.
@@ -298,7 +310,7 @@ namespace dbtype
          * @param token[in] The lock token.
          * @return True if success (valid lock).
          */
-        bool clear_dirty(concurrency::WriterLockToken &token);
+        virtual bool clear_dirty(concurrency::WriterLockToken &token);
 
         /**
          * This method will automatically get a lock.
@@ -359,6 +371,38 @@ namespace dbtype
          */
         void set_entity_flags(const FlagSet &flags);
 
+        /**
+         * Sets how much of the serialized Entity the next load() will
+         * decode.  This is NOT thread safe and is for deserialization only.
+         * @param phase[in] What to decode.
+         */
+        void set_decode_phase(const DecodePhase phase);
+
+        /**
+         * Used by the database subsystem after only the header of the
+         * Entity has been decoded.  The rest is decoded by the loader the
+         * first time it is needed.  This is NOT thread safe and is for
+         * deserialization only.
+         * @param data_ptr[in] The entire serialized Entity.  It is copied.
+         * @param data_size[in] The size of data_ptr.
+         * @param loader_ptr[in] The loader that will decode the rest of
+         * the Entity.  It must remain valid as long as this Entity exists.
+         */
+        void defer_body(
+            const void *data_ptr,
+            const size_t data_size,
+            EntityBodyLoader *loader_ptr);
+
+        /**
+         * Decodes the rest of the Entity if only its header was decoded
+         * when loaded.  Accessors do this automatically; the database
+         * subsystem calls it before serializing the Entity.
+         * The Entity must be locked.
+         * @return True if the Entity is fully decoded, false if the
+         * deferred data could not be decoded.
+         */
+        bool ensure_body_loaded(void);
+
         ///////////////////////////////////////////////
 
         /**
@@ -548,8 +592,8 @@ namespace dbtype
         /**
          * Sets the Entity's 'last accessed' field to 'now'.  It will also
          * increment the access count.
-         * This field is automatically updated if something is set on the
-         * Entity.
+         * This does not make the Entity dirty; the database interface
+         * tracks and saves access statistics separately.
          * @param token[in] The lock token.
          * @return True if successfully set.
          */
@@ -559,8 +603,8 @@ namespace dbtype
         /**
          * Sets the Entity's 'last accessed' field to 'now' (locking).
          * It will also increment the access count.
-         * This field is automatically updated if something is set on the
-         * Entity.
+         * This does not make the Entity dirty; the database interface
+         * tracks and saves access statistics separately.
          * This method will automatically get a lock.
          * @return True if successfully set.
          */
@@ -1135,6 +1179,36 @@ namespace dbtype
          */
         virtual size_t mem_used_fields(void);
 
+        /**
+         * Used instead of token.has_lock() by accessors of anything not in
+         * the Entity header, this also makes sure the rest of the Entity
+         * has been decoded.
+         * @param token[in] The lock token.
+         * @return True if the token has this Entity locked.
+         */
+        bool has_lock_and_body(concurrency::ReaderLockToken &token);
+
+        /**
+         * Used by load() in subclasses, which should stop after their
+         * header fields when this is true.
+         * @return True if only the header is being decoded.
+         */
+        inline bool is_decoding_header(void) const
+        {
+            return decode_phase == DECODE_header;
+        }
+
+        /**
+         * Used by load() in subclasses, which should skip (but still
+         * read) their header fields when this is true, since the header
+         * may have changed since it was decoded.
+         * @return True if everything but the header is being decoded.
+         */
+        inline bool is_decoding_body(void) const
+        {
+            return decode_phase == DECODE_body;
+        }
+
         /**
          * @return True if Entity is deleted.
          */
@@ -1262,18 +1336,58 @@ namespace dbtype
         template<class Archive>
         void load(Archive & ar, const unsigned int version)
         {
-            ar & entity_type;
-            ar & entity_id;
-            ar & entity_instance;
-            ar & entity_version;
-            ar & entity_name;
-            ar & entity_note;
-            ar & entity_security;
-            ar & entity_created_timestamp;
-            ar & entity_updated_timestamp;
-            ar & entity_accessed_timestamp;
-            ar & entity_access_count;
-            ar & entity_owner;
+            if (is_decoding_body())
+            {
+                // The header was decoded earlier and may have changed
+                // since, so it is read and thrown away.
+                //
+                EntityType header_type = ENTITYTYPE_entity;
+                Id header_id;
+                InstanceType header_instance = 0;
+                VersionType header_version = 0;
+                std::string header_name;
+                std::string header_note;
+                Security header_security;
+                TimeStamp header_created(false);
+                TimeStamp header_updated(false);
+                TimeStamp header_accessed(false);
+                AccessCountType header_access_count = 0;
+                Id header_owner;
+
+                ar & header_type;
+                ar & header_id;
+                ar & header_instance;
+                ar & header_version;
+                ar & header_name;
+                ar & header_note;
+                ar & header_security;
+                ar & header_created;
+                ar & header_updated;
+                ar & header_accessed;
+                ar & header_access_count;
+                ar & header_owner;
+            }
+            else
+            {
+                ar & entity_type;
+                ar & entity_id;
+                ar & entity_instance;
+                ar & entity_version;
+                ar & entity_name;
+                ar & entity_note;
+                ar & entity_security;
+                ar & entity_created_timestamp;
+                ar & entity_updated_timestamp;
+                ar & entity_accessed_timestamp;
+                ar & entity_access_count;
+                ar & entity_owner;
+
+                if (is_decoding_header())
+                {
+                    return;
+                }
+            }
+
             ar & entity_flags;
             ar & entity_references;
             ar & entity_delete_batch_id;
@@ -1327,6 +1441,12 @@ namespace dbtype
         bool locked_thread_id_valid; ///< True if locked_thread_id is valid.
         osinterface::ThreadUtils::ThreadId locked_thread_id; ///< What thread has write lock.
         osinterface::OsTypes::UnsignedInt inner_lock_count; ///< how many locks inside the write lock do we have
+
+        DecodePhase decode_phase; ///< What load() is to decode
+        boost::atomic<bool> body_deferred; ///< True if body not decoded yet
+        std::string deferred_data; ///< Serialized Entity, while deferred
+        EntityBodyLoader *body_loader_ptr; ///< Decodes the deferred body
+        boost::mutex body_load_mutex; ///< Serializes decoding the body
     };
 
 } /* namespace dbtype */
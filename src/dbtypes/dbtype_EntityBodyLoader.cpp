@@ -0,0 +1,21 @@
+/*
+ * dbtype_EntityBodyLoader.cpp
+ */
+
+#include "dbtypes/dbtype_EntityBodyLoader.h"
+
+namespace mutgos
+{
+namespace dbtype
+{
+    // ----------------------------------------------------------------------
+    EntityBodyLoader::EntityBodyLoader(void)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    EntityBodyLoader::~EntityBodyLoader()
+    {
+    }
+} /* namespace dbtype */
+} /* namespace mutgos */
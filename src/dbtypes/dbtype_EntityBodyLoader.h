@@ -0,0 +1,57 @@
+/*
+ * dbtype_EntityBodyLoader.h
+ */
+
+#ifndef MUTGOS_DBTYPE_ENTITYBODYLOADER_H_
+#define MUTGOS_DBTYPE_ENTITYBODYLOADER_H_
+
+#include <string>
+
+namespace mutgos
+{
+namespace dbtype
+{
+    class Entity;
+
+    /**
+     * Implemented by the database subsystem to finish deserializing an
+     * Entity that was only partially decoded when loaded.  The Entity
+     * keeps its serialized data and calls this the first time anything
+     * beyond its header (ID, type, name, owner, security, etc) is
+     * accessed, so Entities that are only looked at briefly never pay
+     * for decoding all their fields.
+     * @see Entity
+     */
+    class EntityBodyLoader
+    {
+    public:
+        /**
+         * Default constructor.
+         */
+        EntityBodyLoader(void);
+
+        /**
+         * Destructor.
+         */
+        virtual ~EntityBodyLoader();
+
+        /**
+         * Decodes everything but the header of an Entity from its
+         * serialized data, by deserializing it again with the Entity
+         * already set to DECODE_body.  The header fields already on the
+         * Entity are left alone.
+         * This is called while the Entity is locked, so it must not try
+         * to lock the Entity or call back into it.
+         * @param entity_ptr[in,out] The Entity to decode into.
+         * @param data[in] The serialized Entity, as originally loaded.
+         * @return True if success, false if the data is corrupt.
+         */
+        virtual bool load_entity_body(
+            Entity *entity_ptr,
+            const std::string &data) =0;
+    };
+
+} /* namespace dbtype */
+} /* namespace mutgos */
+
+#endif /* MUTGOS_DBTYPE_ENTITYBODYLOADER_H_ */
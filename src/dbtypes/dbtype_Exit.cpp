@@ -45,7 +45,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Exit(
                 id,
@@ -95,7 +95,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             exit_arrive_message = message;
             notify_field_changed(ENTITYFIELD_exit_arrive_msg);
@@ -125,7 +125,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = exit_arrive_message;
         }
@@ -159,7 +159,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             exit_arrive_room_message = message;
             notify_field_changed(ENTITYFIELD_exit_arrive_room_msg);
@@ -189,7 +189,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = exit_arrive_room_message;
         }
@@ -194,6 +194,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<ActionEntity>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & exit_arrive_message;
             ar & exit_arrive_room_message;
         }
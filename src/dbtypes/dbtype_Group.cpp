@@ -49,7 +49,7 @@ namespace dbtype
         const Entity::InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Group(
                 id,
@@ -103,6 +103,7 @@ namespace dbtype
     std::string Group::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -153,7 +154,7 @@ namespace dbtype
         // Cannot add ourself or an invalid ID to the group - meaningless.
         if ((id_to_add != get_entity_id()) and (not id_to_add.is_default()))
         {
-            if (token.has_lock(*this))
+            if (has_lock_and_body(token))
             {
                 success = group_ids.insert(id_to_add).second;
 
@@ -186,7 +187,7 @@ namespace dbtype
         const Id &id_to_remove,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (group_ids.erase(id_to_remove))
             {
@@ -224,7 +225,7 @@ namespace dbtype
 
         if (not id_to_check.is_default())
         {
-            if (token.has_lock(*this))
+            if (has_lock_and_body(token))
             {
                 // In the group only if it's not disabled and in the list of
                 // group IDs.
@@ -256,7 +257,7 @@ namespace dbtype
     {
         Entity::IdVector entries;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             entries.reserve(group_ids.size());
 
@@ -285,7 +286,7 @@ namespace dbtype
     {
         Id first;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not group_ids.empty())
             {
@@ -316,7 +317,7 @@ namespace dbtype
     {
         Id next;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not current_id.is_default())
             {
@@ -357,7 +358,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             // Only add if it's in the group IDs.
             if (group_ids.find(id_to_add) != group_ids.end())
@@ -393,7 +394,7 @@ namespace dbtype
         const Id &id_to_remove,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (disabled_ids.erase(id_to_remove))
             {
@@ -423,7 +424,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             success = disabled_ids.find(id_to_check) != disabled_ids.end();
         }
@@ -450,7 +451,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not disabled_ids.empty())
             {
@@ -481,7 +482,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             GroupSet::const_iterator group_iter = disabled_ids.find(current_id);
 
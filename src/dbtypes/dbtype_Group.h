@@ -330,6 +330,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<Entity>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & group_ids;
             ar & disabled_ids;
         }
@@ -127,6 +127,14 @@ namespace dbtype
          */
         const PropertyData *get_path_data(void) const;
 
+        /**
+         * @return True if the result of evaluating the lock is 'not'ed.
+         */
+        bool get_operation_not(void) const
+        {
+            return operation_not;
+        }
+
         /**
          * 'Unlocks' the Lock by clearing out all lock parameters, marking it
          * invalid.
@@ -56,7 +56,7 @@ namespace dbtype
         return 0;
 
 /** Currently cannot be cloned due to unique naming requirements
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Player(
                 id,
@@ -95,6 +95,7 @@ namespace dbtype
     std::string Player::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -179,7 +180,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             encrypted_password = BCrypt::generateHash(
                 new_password,
@@ -212,7 +213,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             success = BCrypt::validatePassword(password, encrypted_password);
         }
@@ -246,7 +247,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             display_name = name;
             notify_field_changed(ENTITYFIELD_player_display_name);
@@ -274,7 +275,7 @@ namespace dbtype
         const bool fallback,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (display_name.empty() and fallback)
             {
@@ -309,7 +310,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (home != player_home)
             {
@@ -342,7 +343,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = player_home;
         }
@@ -368,7 +369,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             player_last_connect.set_to_now();
             notify_field_changed(ENTITYFIELD_player_last_connect);
@@ -397,7 +398,7 @@ namespace dbtype
     {
         TimeStamp result(false);
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = player_last_connect;
         }
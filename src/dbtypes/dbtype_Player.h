@@ -281,6 +281,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<ContainerPropertyEntity>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & encrypted_password;
             ar & display_name;
             ar & player_home;
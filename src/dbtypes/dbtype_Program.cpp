@@ -7,6 +7,8 @@
 #include <iostream>
 #include <stddef.h>
 
+#include <boost/thread/locks.hpp>
+
 #include "osinterface/osinterface_OsTypes.h"
 
 #include "dbtypes/dbtype_Program.h"
@@ -15,6 +17,7 @@
 #include "dbtypes/dbtype_PropertyEntity.h"
 #include "dbtypes/dbtype_Id.h"
 #include "dbtypes/dbtype_DocumentProperty.h"
+#include "dbtypes/dbtype_ProgramCodeLoader.h"
 
 #include "concurrency/concurrency_ReaderLockToken.h"
 #include "concurrency/concurrency_WriterLockToken.h"
@@ -32,7 +35,10 @@ namespace dbtype
     // ----------------------------------------------------------------------
     Program::Program()
         : PropertyEntity(),
-          program_runtime_sec(0)
+          program_runtime_sec(0),
+          compiled_code_unloaded(false),
+          compiled_code_changed(false),
+          code_loader_ptr(0)
     {
         program_source_code.set_max_lines(config::db::limits_program_lines());
     }
@@ -40,7 +46,10 @@ namespace dbtype
     // ----------------------------------------------------------------------
     Program::Program(const Id &id)
         : PropertyEntity(id, ENTITYTYPE_program, 0, 0),
-          program_runtime_sec(0)
+          program_runtime_sec(0),
+          compiled_code_unloaded(false),
+          compiled_code_changed(false),
+          code_loader_ptr(0)
     {
         program_source_code.set_max_lines(config::db::limits_program_lines());
     }
@@ -57,7 +66,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Program(
                 id,
@@ -82,6 +91,7 @@ namespace dbtype
     std::string Program::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -92,8 +102,22 @@ namespace dbtype
                   << std::endl
                   << "Source code (lines): "
                   << program_source_code.get_number_lines()  << std::endl
-                  << "Compiled code (bytes): " << program_compiled_code.size()
-                  << std::endl
+                  << "Compiled code (bytes): ";
+
+        {
+            boost::lock_guard<boost::mutex> guard(code_load_mutex);
+
+            if (compiled_code_unloaded)
+            {
+                strstream << "(not loaded)";
+            }
+            else
+            {
+                strstream << program_compiled_code.size();
+            }
+        }
+
+        strstream << std::endl
                   << "Program language: " << program_language
                   << std::endl
                   << "Program includes:";
@@ -110,6 +134,56 @@ namespace dbtype
         return strstream.str();
     }
 
+    // ----------------------------------------------------------------------
+    bool Program::clear_dirty(concurrency::WriterLockToken &token)
+    {
+        const bool success = PropertyEntity::clear_dirty(token);
+
+        if (success)
+        {
+            compiled_code_changed = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void Program::set_program_code_loader(ProgramCodeLoader *loader_ptr)
+    {
+        code_loader_ptr = loader_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    bool Program::get_compiled_code_for_save(
+        const bool include_unchanged,
+        const std::string *&code_ptr,
+        concurrency::WriterLockToken &token)
+    {
+        bool success = false;
+
+        if (has_lock_and_body(token))
+        {
+            boost::lock_guard<boost::mutex> guard(code_load_mutex);
+
+            // Changed code is always in memory, since setting it replaces
+            // whatever was in storage.
+            //
+            if (compiled_code_changed or
+                (include_unchanged and (not compiled_code_unloaded)))
+            {
+                code_ptr = &program_compiled_code;
+                success = true;
+            }
+        }
+        else
+        {
+            LOG(error, "dbtype", "get_compiled_code_for_save",
+                "Using the wrong lock token!");
+        }
+
+        return success;
+    }
+
     // ----------------------------------------------------------------------
     bool Program::increment_runtime(
         const osinterface::OsTypes::Double seconds,
@@ -117,7 +191,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             program_runtime_sec += seconds;
             notify_field_changed(ENTITYFIELD_program_runtime_sec);
@@ -144,7 +218,7 @@ namespace dbtype
     std::string Program::get_program_reg_name(
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             return program_reg_name;
         }
@@ -188,7 +262,7 @@ namespace dbtype
             return result;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             // We need to give listeners a chance to veto the change.
             //
@@ -238,7 +312,7 @@ namespace dbtype
     DocumentProperty Program::get_source_code(
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             // operator= not supported
             return program_source_code;
@@ -268,7 +342,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = program_source_code.set_from_string(
                 source_code.get_as_string());
@@ -304,9 +378,13 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
-            result = not program_compiled_code.empty();
+            // Does not need to load the code to know it is there.
+            boost::lock_guard<boost::mutex> guard(code_load_mutex);
+
+            result = compiled_code_unloaded or
+                (not program_compiled_code.empty());
         }
         else
         {
@@ -325,9 +403,10 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
-            if (program_compiled_code.empty())
+            if ((not ensure_compiled_code_loaded()) or
+                program_compiled_code.empty())
             {
                 data_ptr = 0;
                 data_size = 0;
@@ -370,7 +449,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if ((data_size <= 0) or (not data))
             {
@@ -381,6 +460,9 @@ namespace dbtype
                 program_compiled_code.assign(data, data_size);
             }
 
+            // Anything still in storage is now out of date.
+            compiled_code_unloaded = false;
+            compiled_code_changed = true;
             notify_field_changed(ENTITYFIELD_program_compiled_code);
             result = true;
         }
@@ -409,7 +491,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = program_language;
         }
@@ -443,7 +525,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             program_language = language;
             notify_field_changed(ENTITYFIELD_program_language);
@@ -474,7 +556,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             // Mark all existing as removed.  If they weren't actually removed,
             // it will cancel out on its own...
@@ -527,7 +609,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result =
                 (program_includes.find(program_id) != program_includes.end());
@@ -555,7 +637,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = set_program_includes(IdSet());
         }
@@ -582,7 +664,7 @@ namespace dbtype
     {
         IdSet result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = program_includes;
         }
@@ -608,7 +690,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not program_includes.empty())
             {
@@ -639,7 +721,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not program_includes.empty())
             {
@@ -678,7 +760,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not program_includes.empty())
             {
@@ -708,7 +790,7 @@ namespace dbtype
     {
         size_t result = 0;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = program_includes.size();
         }
@@ -737,7 +819,10 @@ namespace dbtype
         const InstanceType instance,
         const bool restoring)
       : PropertyEntity(id, type, version, instance, restoring),
-        program_runtime_sec(0)
+        program_runtime_sec(0),
+        compiled_code_unloaded(false),
+        compiled_code_changed(false),
+        code_loader_ptr(0)
     {
     }
 
@@ -781,7 +866,9 @@ namespace dbtype
             cast_ptr->program_source_code.set(program_source_code.get());
             cast_ptr->notify_field_changed(ENTITYFIELD_program_source_code);
 
+            ensure_compiled_code_loaded();
             cast_ptr->program_compiled_code = program_compiled_code;
+            cast_ptr->compiled_code_changed = true;
             cast_ptr->notify_field_changed(ENTITYFIELD_program_compiled_code);
 
             cast_ptr->program_language = program_language;
@@ -800,5 +887,37 @@ namespace dbtype
             cast_ptr->notify_field_changed(ENTITYFIELD_program_includes);
         }
     }
+
+    // ----------------------------------------------------------------------
+    bool Program::ensure_compiled_code_loaded(void)
+    {
+        bool loaded = true;
+
+        // Readers may get here at the same time, so loading is serialized.
+        // Once loaded, the compiled code is never unloaded.
+        //
+        boost::lock_guard<boost::mutex> guard(code_load_mutex);
+
+        if (compiled_code_unloaded)
+        {
+            loaded = code_loader_ptr and
+                code_loader_ptr->load_compiled_code(
+                    get_entity_id(),
+                    program_compiled_code);
+
+            if (loaded)
+            {
+                compiled_code_unloaded = false;
+            }
+            else
+            {
+                LOG(error, "dbtype", "ensure_compiled_code_loaded",
+                    "Could not load compiled code for "
+                    + get_entity_id().to_string(true));
+            }
+        }
+
+        return loaded;
+    }
 } /* namespace dbtype */
 } /* namespace mutgos */
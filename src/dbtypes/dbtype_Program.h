@@ -16,10 +16,13 @@
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/string.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_Id.h"
 #include "dbtypes/dbtype_DocumentProperty.h"
+#include "dbtypes/dbtype_CompactArchive.h"
+#include "dbtypes/dbtype_ProgramCodeLoader.h"
 
 #include "concurrency/concurrency_ReaderLockToken.h"
 #include "concurrency/concurrency_WriterLockToken.h"
@@ -29,6 +32,17 @@ namespace mutgos
 {
 namespace dbtype
 {
+    /**
+     * A program that can be run by the softcode interpreter.
+     *
+     * When serialized in the compact archive format, the compiled code is
+     * not included; only whether the Program has any.  The database
+     * backend stores the compiled code separately, saving it only when it
+     * changes, and provides a ProgramCodeLoader so it is only loaded when
+     * actually retrieved.  Checking if the Program has compiled code does
+     * not load it.
+     * @see ProgramCodeLoader
+     */
     class Program : public PropertyEntity
     {
     public:
@@ -70,6 +84,42 @@ namespace dbtype
          */
         virtual std::string to_string(void);
 
+        /**
+         * Clears the dirty flag and any information regarding what was
+         * dirty, including if the compiled code has changed.
+         * @param token[in] The lock token.
+         * @return True if success (valid lock).
+         */
+        virtual bool clear_dirty(concurrency::WriterLockToken &token);
+
+        /**
+         * Used by the database subsystem when restoring a Program from
+         * storage, this sets where the compiled code is loaded from if not
+         * yet in memory.  Must be called before the Program is used by
+         * anything else.
+         * @param loader_ptr[in] The loader.  The pointer must remain valid
+         * for the life of this Program.
+         */
+        void set_program_code_loader(ProgramCodeLoader *loader_ptr);
+
+        /**
+         * Used by the database subsystem to get the compiled code for
+         * saving.
+         * @param include_unchanged[in] If true, get the compiled code even
+         * if it has not changed, as long as it is in memory.  Used when a
+         * previous save did not make it to storage.
+         * @param code_ptr[out] The compiled code, which will be empty if
+         * there is none.  The pointer is only valid while locked.
+         * @param token[in] The lock token.
+         * @return True if code_ptr was set, false if the compiled code has
+         * not changed since the dirty information was last cleared (or is
+         * still in storage), or if error.
+         */
+        bool get_compiled_code_for_save(
+            const bool include_unchanged,
+            const std::string *&code_ptr,
+            concurrency::WriterLockToken &token);
+
         /**
          * Increments the culmulative runtime by the given seconds.
          * This is very approximate and subject to the CPU level of
@@ -431,6 +481,15 @@ namespace dbtype
         virtual void copy_fields(Entity *entity_ptr);
 
     private:
+        /**
+         * Loads the compiled code from storage if it has not yet been
+         * loaded.  Reader locking is assumed to have already been
+         * performed.
+         * @return True if the compiled code is now in memory, false if it
+         * could not be loaded.
+         */
+        bool ensure_compiled_code_loaded(void);
+
         // Binary stored as std::string for ease of serialization and
         // memory management.
         typedef std::string CompiledCode;
@@ -443,6 +502,10 @@ namespace dbtype
         CompiledCode program_compiled_code; ///< Optional compiled opaque binary
         std::string program_language; ///< Code language program is in
         Entity::IdSet program_includes; ///< What other programs this one uses
+        bool compiled_code_unloaded; ///< Compiled code still in storage
+        bool compiled_code_changed; ///< Compiled code not yet saved
+        ProgramCodeLoader *code_loader_ptr; ///< Loads compiled code
+        boost::mutex code_load_mutex; ///< Protects loading compiled code
 
         /**
          * Serialization using Boost Serialization.  MUST be locked externally,
@@ -457,7 +520,20 @@ namespace dbtype
             ar & program_runtime_sec;
             ar & program_reg_name;
             ar & program_source_code;
-            ar & program_compiled_code;
+
+            if (version >= CompactArchive::EXTERNAL_COMPILED_CODE_VERSION)
+            {
+                // The backend saves the compiled code itself.
+                const bool has_code = compiled_code_unloaded or
+                    (not program_compiled_code.empty());
+
+                ar & has_code;
+            }
+            else
+            {
+                ar & program_compiled_code;
+            }
+
             ar & program_language;
             ar & program_includes;
         }
@@ -467,10 +543,28 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<PropertyEntity>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & program_runtime_sec;
             ar & program_reg_name;
             ar & program_source_code;
-            ar & program_compiled_code;
+
+            if (version >= CompactArchive::EXTERNAL_COMPILED_CODE_VERSION)
+            {
+                // Compiled code will be loaded when first retrieved.
+                ar & compiled_code_unloaded;
+            }
+            else
+            {
+                // Older data has the compiled code inline.  It has never
+                // been saved separately, so mark it as changed.
+                ar & program_compiled_code;
+                compiled_code_changed = not program_compiled_code.empty();
+            }
+
             ar & program_language;
             ar & program_includes;
         }
@@ -0,0 +1,21 @@
+/*
+ * dbtype_ProgramCodeLoader.cpp
+ */
+
+#include "dbtypes/dbtype_ProgramCodeLoader.h"
+
+namespace mutgos
+{
+namespace dbtype
+{
+    // ----------------------------------------------------------------------
+    ProgramCodeLoader::ProgramCodeLoader(void)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    ProgramCodeLoader::~ProgramCodeLoader()
+    {
+    }
+} /* namespace dbtype */
+} /* namespace mutgos */
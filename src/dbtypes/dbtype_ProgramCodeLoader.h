@@ -0,0 +1,53 @@
+/*
+ * dbtype_ProgramCodeLoader.h
+ */
+
+#ifndef MUTGOS_DBTYPE_PROGRAMCODELOADER_H_
+#define MUTGOS_DBTYPE_PROGRAMCODELOADER_H_
+
+#include <string>
+
+#include "dbtypes/dbtype_Id.h"
+
+namespace mutgos
+{
+namespace dbtype
+{
+    /**
+     * Implemented by a database backend that stores the compiled code of
+     * a Program separately from the rest of the Entity.  The Program calls
+     * this the first time its compiled code is retrieved, so Programs can
+     * be loaded (for instance, to check security) without their
+     * potentially large bytecode.
+     * @see Program
+     */
+    class ProgramCodeLoader
+    {
+    public:
+        /**
+         * Default constructor.
+         */
+        ProgramCodeLoader(void);
+
+        /**
+         * Destructor.
+         */
+        virtual ~ProgramCodeLoader();
+
+        /**
+         * Loads a Program's compiled code from storage.
+         * This is called while the Program is locked, so it must not try
+         * to lock the Entity or call back into it.
+         * @param program_id[in] The ID of the Program.
+         * @param compiled_code[out] The loaded compiled code.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_compiled_code(
+            const Id &program_id,
+            std::string &compiled_code) =0;
+    };
+
+} /* namespace dbtype */
+} /* namespace mutgos */
+
+#endif /* MUTGOS_DBTYPE_PROGRAMCODELOADER_H_ */
@@ -701,7 +701,18 @@ namespace dbtype
 
         edge_path.clear();
 
-        if (not trimmed_path.empty())
+        if (trimmed_path.empty() or (trimmed_path == PATH_SEPARATOR))
+        {
+            // The root directory (this instance).
+            //
+            if (not property_map.empty())
+            {
+                edge_path = PATH_SEPARATOR + (last ?
+                    property_map.rbegin()->first :
+                    property_map.begin()->first);
+            }
+        }
+        else
         {
             bool add_separator = true;
 
@@ -146,6 +146,7 @@ namespace dbtype
          * Returns the first property in the given directory.
          * @param path[in] The full path of the property directory to get the
          * first entry of.
+         * An empty path (or the separator alone) is this directory.
          * @return The full path of the first property entry in the directory
          * given by path.  If there are no entries or the path is invalid,
          * an empty string is returned.
@@ -156,6 +157,7 @@ namespace dbtype
          * Returns the last property in the given directory.
          * @param path[in] The full path of the property directory to get the
          * last entry of.
+         * An empty path (or the separator alone) is this directory.
          * @return The full path of the last property entry in the directory
          * given by path.  If there are no entries or the path is invalid,
          * an empty string is returned.
@@ -6,6 +6,8 @@
 #include <ostream>
 
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 
 #include "logging/log_Logger.h"
 #include "text/text_Utf8Tools.h"
@@ -36,7 +38,8 @@ namespace dbtype
 {
     // ----------------------------------------------------------------------
     PropertyEntity::PropertyEntity()
-      : Entity()
+      : Entity(),
+        application_loader_ptr(0)
     {
     }
 
@@ -46,7 +49,8 @@ namespace dbtype
           id,
           ENTITYTYPE_property_entity,
           0,
-          0)
+          0),
+        application_loader_ptr(0)
     {
     }
 
@@ -62,7 +66,7 @@ namespace dbtype
         const Entity::InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new PropertyEntity(
                 id,
@@ -108,11 +112,14 @@ namespace dbtype
     std::string PropertyEntity::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
         strstream << Entity::to_string();
 
+        load_all_applications();
+
         for (ApplicationPropertiesMap::iterator app_iter =
                 application_properties.begin();
             app_iter != application_properties.end();
@@ -126,6 +133,89 @@ namespace dbtype
         return strstream.str();
     }
 
+    // ----------------------------------------------------------------------
+    bool PropertyEntity::clear_dirty(concurrency::WriterLockToken &token)
+    {
+        const bool success = Entity::clear_dirty(token);
+
+        if (success)
+        {
+            changed_applications.clear();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void PropertyEntity::set_application_properties_loader(
+        ApplicationPropertiesLoader *loader_ptr)
+    {
+        application_loader_ptr = loader_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    bool PropertyEntity::get_changed_applications(
+        ApplicationNameSet &applications,
+        concurrency::WriterLockToken &token)
+    {
+        bool success = true;
+
+        if (has_lock_and_body(token))
+        {
+            applications.insert(
+                changed_applications.begin(),
+                changed_applications.end());
+        }
+        else
+        {
+            LOG(error, "dbtype", "get_changed_applications",
+                "Using the wrong lock token!");
+
+            success = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool PropertyEntity::get_application_properties_for_save(
+        const std::string &application,
+        const ApplicationProperties *&properties_ptr,
+        concurrency::WriterLockToken &token)
+    {
+        bool success = false;
+
+        if (has_lock_and_body(token))
+        {
+            ApplicationPropertiesMap::const_iterator app_iter =
+                application_properties.find(application);
+
+            if (app_iter == application_properties.end())
+            {
+                properties_ptr = 0;
+                success = true;
+            }
+            else
+            {
+                boost::lock_guard<boost::mutex> guard(application_load_mutex);
+
+                if (unloaded_applications.find(application) ==
+                    unloaded_applications.end())
+                {
+                    properties_ptr = &app_iter->second;
+                    success = true;
+                }
+            }
+        }
+        else
+        {
+            LOG(error, "dbtype", "get_application_properties_for_save",
+                "Using the wrong lock token!");
+        }
+
+        return success;
+    }
+
     // ----------------------------------------------------------------------
     bool PropertyEntity::application_exists(const std::string &path)
     {
@@ -141,7 +231,7 @@ namespace dbtype
     {
         bool exists = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             const std::string application =
                 get_application_name_from_path(path);
@@ -178,7 +268,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             const std::string application =
                 get_application_name_from_path(path);
@@ -200,7 +290,7 @@ namespace dbtype
                         first->second.get_security() = security;
 
                 success = true;
-                notify_field_changed(ENTITYFIELD_application_properties);
+                application_changed(application);
             }
         }
         else
@@ -226,13 +316,21 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             const std::string application =
                 get_application_name_from_path(path);
 
-            application_properties.erase(application);
-            notify_field_changed(ENTITYFIELD_application_properties);
+            if (application_properties.erase(application))
+            {
+                {
+                    boost::lock_guard<boost::mutex> guard(
+                        application_load_mutex);
+                    unloaded_applications.erase(application);
+                }
+
+                application_changed(application);
+            }
         }
         else
         {
@@ -257,7 +355,7 @@ namespace dbtype
         const std::string &path,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             const std::string application =
                 get_application_name_from_path(path);
@@ -265,7 +363,8 @@ namespace dbtype
             ApplicationPropertiesMap::iterator app_iter =
                 application_properties.find(application);
 
-            if (app_iter != application_properties.end())
+            if ((app_iter != application_properties.end()) and
+                ensure_application_loaded(app_iter))
             {
                 return std::make_pair(
                     app_iter->second.get_application_owner(),
@@ -298,7 +397,7 @@ namespace dbtype
         const PropertySecurity &security,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             const std::string application =
                 get_application_name_from_path(path);
@@ -306,10 +405,11 @@ namespace dbtype
             ApplicationPropertiesMap::iterator app_iter =
                 application_properties.find(application);
 
-            if (app_iter != application_properties.end())
+            if ((app_iter != application_properties.end()) and
+                ensure_application_loaded(app_iter))
             {
                 app_iter->second.get_security() = security;
-                notify_field_changed(ENTITYFIELD_application_properties);
+                application_changed(application);
                 return true;
             }
         }
@@ -337,7 +437,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             PropertyData *data_ptr = get_property_data_ptr(path);
 
@@ -370,7 +470,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             PropertyData *data_ptr = get_property_data_ptr(path);
 
@@ -403,7 +503,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             PropertyData *data_ptr = get_property_data_ptr(path);
 
@@ -455,7 +555,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             PropertyData *data_ptr = get_property_data_ptr(path);
 
@@ -529,7 +629,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -541,7 +641,7 @@ namespace dbtype
                     property_path,
                     data);
 
-                notify_field_changed(ENTITYFIELD_application_properties);
+                application_changed(properties_ptr->get_application_name());
             }
         }
         else
@@ -566,16 +666,21 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
 
-            if (get_application_properties(path, properties_ptr, property_path))
+            if (get_application_properties(
+                path,
+                properties_ptr,
+                property_path))
             {
                 // Found the application.  Now try and get the next property.
-                return properties_ptr->get_properties().get_next_property(
-                    property_path);
+                return make_full_path(
+                    properties_ptr->get_application_name(),
+                    properties_ptr->get_properties().get_next_property(
+                        property_path));
             }
         }
         else
@@ -601,16 +706,21 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
 
-            if (get_application_properties(path, properties_ptr, property_path))
+            if (get_application_properties(
+                path,
+                properties_ptr,
+                property_path))
             {
                 // Found the application.  Now try and get the prev property.
-                return properties_ptr->get_properties().get_previous_property(
-                    property_path);
+                return make_full_path(
+                    properties_ptr->get_application_name(),
+                    properties_ptr->get_properties().get_previous_property(
+                        property_path));
             }
         }
         else
@@ -636,16 +746,22 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
 
-            if (get_application_properties(path, properties_ptr, property_path))
+            if (get_application_properties(
+                path,
+                properties_ptr,
+                property_path,
+                true))
             {
                 // Found the application.  Now try and get the first property.
-                return properties_ptr->get_properties().get_first_property(
-                    property_path);
+                return make_full_path(
+                    properties_ptr->get_application_name(),
+                    properties_ptr->get_properties().get_first_property(
+                        property_path));
             }
         }
         else
@@ -671,16 +787,22 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
 
-            if (get_application_properties(path, properties_ptr, property_path))
+            if (get_application_properties(
+                path,
+                properties_ptr,
+                property_path,
+                true))
             {
                 // Found the application.  Now try and get the last property.
-                return properties_ptr->get_properties().get_last_property(
-                    property_path);
+                return make_full_path(
+                    properties_ptr->get_application_name(),
+                    properties_ptr->get_properties().get_last_property(
+                        property_path));
             }
         }
         else
@@ -706,7 +828,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -715,7 +837,7 @@ namespace dbtype
             {
                 // Found the application.  Now try and delete the property.
                 properties_ptr->get_properties().delete_property(property_path);
-                notify_field_changed(ENTITYFIELD_application_properties);
+                application_changed(properties_ptr->get_application_name());
             }
         }
         else
@@ -738,7 +860,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -748,7 +870,7 @@ namespace dbtype
                 // Found the application.  Now try and delete the property.
                 properties_ptr->get_properties().delete_property_data(
                     property_path);
-                notify_field_changed(ENTITYFIELD_application_properties);
+                application_changed(properties_ptr->get_application_name());
             }
         }
         else
@@ -771,7 +893,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             return get_property_data_ptr(path);
         }
@@ -798,7 +920,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -834,7 +956,7 @@ namespace dbtype
     {
         PropertyDataType result = PROPERTYDATATYPE_invalid;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -874,7 +996,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -908,7 +1030,7 @@ namespace dbtype
         const std::string &path,
         concurrency::WriterLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationProperties *properties_ptr = 0;
             std::string property_path;
@@ -917,7 +1039,7 @@ namespace dbtype
             {
                 // Found the application.  Clear all properties.
                 properties_ptr->get_properties().clear();
-                notify_field_changed(ENTITYFIELD_application_properties);
+                application_changed(properties_ptr->get_application_name());
             }
         }
         else
@@ -940,7 +1062,7 @@ namespace dbtype
     std::string PropertyEntity::get_first_application_name(
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not application_properties.empty())
             {
@@ -971,7 +1093,7 @@ namespace dbtype
         const std::string &path,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             ApplicationPropertiesMap::const_iterator app_iter =
                 application_properties.find(
@@ -999,7 +1121,8 @@ namespace dbtype
         const VersionType version,
         const InstanceType instance,
         const bool restoring)
-      : Entity(id, type, version, instance, restoring)
+      : Entity(id, type, version, instance, restoring),
+        application_loader_ptr(0)
     {
     }
 
@@ -1015,7 +1138,29 @@ namespace dbtype
             ((cast_ptr = (dynamic_cast<PropertyEntity *>(entity_ptr)))
              != 0))
         {
+            load_all_applications();
+
+            // Anything the copy had before is being replaced.
+            cast_ptr->changed_applications.clear();
+
+            for (ApplicationPropertiesMap::const_iterator app_iter =
+                    cast_ptr->application_properties.begin();
+                app_iter != cast_ptr->application_properties.end();
+                ++app_iter)
+            {
+                cast_ptr->changed_applications.insert(app_iter->first);
+            }
+
+            for (ApplicationPropertiesMap::const_iterator app_iter =
+                    application_properties.begin();
+                app_iter != application_properties.end();
+                ++app_iter)
+            {
+                cast_ptr->changed_applications.insert(app_iter->first);
+            }
+
             cast_ptr->application_properties = application_properties;
+            cast_ptr->unloaded_applications.clear();
             cast_ptr->notify_field_changed(ENTITYFIELD_application_properties);
         }
     }
@@ -1024,7 +1169,8 @@ namespace dbtype
     bool PropertyEntity::get_application_properties(
         const std::string &full_path,
         ApplicationProperties *&properties,
-        std::string &property_path)
+        std::string &property_path,
+        const bool allow_root)
     {
         std::string trimmed_path = boost::trim_copy(full_path);
 
@@ -1050,7 +1196,7 @@ namespace dbtype
         //
         trim_index = trimmed_path.find_first_of(PATH_SEPARATOR);
 
-        if (trim_index == std::string::npos)
+        if ((trim_index == std::string::npos) and (not allow_root))
         {
             // Not valid since there is no prop path after it.
             return false;
@@ -1059,10 +1205,12 @@ namespace dbtype
         const std::string application_name =
             trimmed_path.substr(0, trim_index);
         const std::string prop_path =
-            (trimmed_path.size() == (trim_index + 1)) ?
+            ((trim_index == std::string::npos) or
+              (trimmed_path.size() == (trim_index + 1))) ?
                 "" : trimmed_path.substr(trim_index + 1);
 
-        if (application_name.empty() or prop_path.empty())
+        if (application_name.empty() or
+            (prop_path.empty() and (not allow_root)))
         {
             // Application name or prop path are empty, which is invalid.
             return false;
@@ -1077,6 +1225,12 @@ namespace dbtype
             return false;
         }
 
+        if (not ensure_application_loaded(app_iter))
+        {
+            // Application exists but could not be loaded.
+            return false;
+        }
+
         // Looks like the application is valid, and we have a valid path.
         // Return everything to the caller.
         properties = &app_iter->second;
@@ -1084,6 +1238,80 @@ namespace dbtype
         return true;
     }
 
+    // ----------------------------------------------------------------------
+    bool PropertyEntity::ensure_application_loaded(
+        ApplicationPropertiesMap::iterator &app_iter)
+    {
+        bool loaded = true;
+
+        // Readers may get here at the same time, so loading is serialized.
+        // Once loaded, an application is never unloaded.
+        //
+        boost::lock_guard<boost::mutex> guard(application_load_mutex);
+
+        const ApplicationNameSet::iterator unloaded_iter =
+            unloaded_applications.find(app_iter->first);
+
+        if (unloaded_iter != unloaded_applications.end())
+        {
+            loaded = application_loader_ptr and
+                application_loader_ptr->load_application_properties(
+                    get_entity_id(),
+                    app_iter->first,
+                    app_iter->second);
+
+            if (loaded)
+            {
+                unloaded_applications.erase(unloaded_iter);
+            }
+            else
+            {
+                LOG(error, "dbtype", "ensure_application_loaded",
+                    "Could not load application " + app_iter->first
+                    + " for " + get_entity_id().to_string(true));
+            }
+        }
+
+        return loaded;
+    }
+
+    // ----------------------------------------------------------------------
+    void PropertyEntity::load_all_applications(void)
+    {
+        for (ApplicationPropertiesMap::iterator app_iter =
+                application_properties.begin();
+            app_iter != application_properties.end();
+            ++app_iter)
+        {
+            ensure_application_loaded(app_iter);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void PropertyEntity::application_changed(const std::string &application)
+    {
+        changed_applications.insert(application);
+        notify_field_changed(ENTITYFIELD_application_properties);
+    }
+
+    // ----------------------------------------------------------------------
+    std::string PropertyEntity::make_full_path(
+        const std::string &application,
+        const std::string &property_path)
+    {
+        if (property_path.empty())
+        {
+            return property_path;
+        }
+
+        const size_t start_index =
+            property_path.find_first_not_of(PATH_SEPARATOR);
+
+        return PATH_SEPARATOR + application + PATH_SEPARATOR +
+            ((start_index == std::string::npos) ?
+                "" : property_path.substr(start_index));
+    }
+
     // ----------------------------------------------------------------------
     std::string PropertyEntity::get_application_name_from_path(
         const std::string &full_path)
@@ -17,9 +17,12 @@
 #include <boost/serialization/split_member.hpp>
 
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_ApplicationPropertiesLoader.h"
+#include "dbtypes/dbtype_CompactArchive.h"
 #include "dbtypes/dbtype_PropertyData.h"
 #include "dbtypes/dbtype_PropertyDataType.h"
 #include "dbtypes/dbtype_PropertySecurity.h"
@@ -50,7 +53,14 @@ namespace dbtype
      * The property path refers to a path as defined by PropertyDirectory.
      * An Application Property is the combination of the application name and
      * property path.  For example: /MyApp/dirA/dirB/prop
+     *
+     * When serialized in the compact archive format, only the application
+     * names are included.  The database backend stores each application's
+     * properties separately, saving only the ones that changed, and
+     * provides an ApplicationPropertiesLoader so an application is only
+     * loaded the first time it is accessed.
      * @see PropertyDirectory
+     * @see ApplicationPropertiesLoader
      */
     class PropertyEntity : public Entity
     {
@@ -59,6 +69,9 @@ namespace dbtype
             for the application */
         typedef std::pair<Id, PropertySecurity> ApplicationOwnerSecurity;
 
+        /** A set of application names */
+        typedef std::set<std::string> ApplicationNameSet;
+
         /**
          * Constructor used for deserialization of a PropertyEntity.
          */
@@ -106,6 +119,55 @@ namespace dbtype
          */
         virtual std::string to_string(void);
 
+        /**
+         * Clears the dirty flag and any information regarding what was
+         * dirty, including which applications have changed.
+         * @param token[in] The lock token.
+         * @return True if success (valid lock).
+         */
+        virtual bool clear_dirty(concurrency::WriterLockToken &token);
+
+        /**
+         * Used by the database subsystem when restoring a PropertyEntity
+         * from storage, this sets where application properties not yet in
+         * memory are loaded from.  Must be called before the
+         * PropertyEntity is used by anything else.
+         * @param loader_ptr[in] The loader.  The pointer must remain valid
+         * for the life of this PropertyEntity.
+         */
+        void set_application_properties_loader(
+            ApplicationPropertiesLoader *loader_ptr);
+
+        /**
+         * Used by the database subsystem to determine which applications
+         * need to be saved.
+         * @param applications[out] The names of all applications added,
+         * changed, or removed since the dirty information was last
+         * cleared will be inserted into this.
+         * @param token[in] The lock token.
+         * @return True if success (valid lock).
+         */
+        bool get_changed_applications(
+            ApplicationNameSet &applications,
+            concurrency::WriterLockToken &token);
+
+        /**
+         * Used by the database subsystem to get an application's
+         * properties for saving.
+         * @param application[in] The application name.
+         * @param properties_ptr[out] The application's properties, or null
+         * if the application does not exist.  The pointer is only valid
+         * while locked.
+         * @param token[in] The lock token.
+         * @return True if properties_ptr was set, false if the application
+         * has not been loaded from storage (and therefore has not changed)
+         * or if error.
+         */
+        bool get_application_properties_for_save(
+            const std::string &application,
+            const ApplicationProperties *&properties_ptr,
+            concurrency::WriterLockToken &token);
+
 
         /**
          * This method will automatically get a lock.
@@ -419,6 +481,7 @@ namespace dbtype
          * This method will automatically get a lock.
          * @param path[in] The path of the application property directory to get
          * the first subproperty of.
+         * This may be just the application name, for the top level.
          * @return The full first application property inside of the
          * given application property directory, or empty if no subproperties
          * or not found.
@@ -429,6 +492,7 @@ namespace dbtype
          * Returns the first property within the given directory.
          * @param path[in] The path of the application property directory to get
          * the first subproperty of.
+         * This may be just the application name, for the top level.
          * @param token[in] The lock token.
          * @return The full first application property inside of the
          * given application property directory, or empty if no subproperties
@@ -444,6 +508,7 @@ namespace dbtype
          * This method will automatically get a lock.
          * @param path[in] The path of the application property directory to get
          * the last subproperty of.
+         * This may be just the application name, for the top level.
          * @return The full last application property inside of the
          * given application property directory, or empty if no subproperties
          * or not found.
@@ -454,6 +519,7 @@ namespace dbtype
          * Returns the last property within the given directory.
          * @param path[in] The path of the application property directory to get
          * the last subproperty of.
+         * This may be just the application name, for the top level.
          * @param token[in] The lock token.
          * @return The full last application property inside of the
          * given application property directory, or empty if no subproperties
@@ -689,13 +755,28 @@ namespace dbtype
          * contained within the path.
          * @param path[out] The path to the property within.  Does not
          * include the application name.
+         * @param allow_root[in] If true, full_path may be just the
+         * application name, in which case path will be empty (the root
+         * of the application).
          * @return True if application found, false if not. If false, the
          * outgoing arguments will NOT be populated.
          */
         bool get_application_properties(
             const std::string &full_path,
             ApplicationProperties *&properties,
-            std::string &property_path);
+            std::string &property_path,
+            const bool allow_root = false);
+
+        /**
+         * Converts a path returned by an application's PropertyDirectory
+         * back into a full path, including the application name.
+         * @param application[in] The application name.
+         * @param property_path[in] The path within the application.
+         * @return The full path, or empty string if property_path is empty.
+         */
+        static std::string make_full_path(
+            const std::string &application,
+            const std::string &property_path);
 
         /**
          * Given a full path, return the application data property, if any.
@@ -709,7 +790,37 @@ namespace dbtype
         typedef std::map<std::string, ApplicationProperties>
           ApplicationPropertiesMap;
 
+        /**
+         * Makes sure the given application's properties are in memory,
+         * loading them from storage if this is the first access.
+         * Locking is assumed to have already been performed (reader or
+         * writer).
+         * @param app_iter[in] The application to check.  Must be valid.
+         * @return True if the properties are in memory, false if they
+         * could not be loaded.
+         */
+        bool ensure_application_loaded(
+            ApplicationPropertiesMap::iterator &app_iter);
+
+        /**
+         * Loads every application not yet in memory.  Locking is assumed
+         * to have already been performed (reader or writer).
+         */
+        void load_all_applications(void);
+
+        /**
+         * Marks the given application as changed, so it will be saved.
+         * Writer locking is assumed to have already been performed.
+         * @param application[in] The application that was added, changed,
+         * or removed.
+         */
+        void application_changed(const std::string &application);
+
         ApplicationPropertiesMap application_properties; ///< App properties
+        ApplicationNameSet changed_applications; ///< Apps not yet saved
+        ApplicationNameSet unloaded_applications; ///< Apps still in storage
+        ApplicationPropertiesLoader *application_loader_ptr; ///< Loads apps
+        boost::mutex application_load_mutex; ///< Protects loading apps
 
         /**
          * Serialization using Boost Serialization.  MUST be locked externally,
@@ -721,7 +832,25 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<Entity>(*this);
 
-            ar & application_properties;
+            if (version >= CompactArchive::EXTERNAL_APPLICATIONS_VERSION)
+            {
+                // The backend saves the properties themselves.
+                ApplicationNameSet applications;
+
+                for (ApplicationPropertiesMap::const_iterator app_iter =
+                        application_properties.begin();
+                    app_iter != application_properties.end();
+                    ++app_iter)
+                {
+                    applications.insert(applications.end(), app_iter->first);
+                }
+
+                ar & applications;
+            }
+            else
+            {
+                ar & application_properties;
+            }
         }
 
         template<class Archive>
@@ -729,7 +858,44 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<Entity>(*this);
 
-            ar & application_properties;
+            if (is_decoding_header())
+            {
+                return;
+            }
+
+            if (version >= CompactArchive::EXTERNAL_APPLICATIONS_VERSION)
+            {
+                // Properties will be loaded when first accessed.
+                ar & unloaded_applications;
+
+                for (ApplicationNameSet::const_iterator app_iter =
+                        unloaded_applications.begin();
+                    app_iter != unloaded_applications.end();
+                    ++app_iter)
+                {
+                    application_properties.insert(
+                        application_properties.end(),
+                        std::make_pair(
+                            *app_iter,
+                            ApplicationProperties(*app_iter, Id())));
+                }
+            }
+            else
+            {
+                // Older data has the properties inline.  They have never
+                // been saved separately, so mark them all as changed.
+                ar & application_properties;
+
+                for (ApplicationPropertiesMap::const_iterator app_iter =
+                        application_properties.begin();
+                    app_iter != application_properties.end();
+                    ++app_iter)
+                {
+                    changed_applications.insert(
+                        changed_applications.end(),
+                        app_iter->first);
+                }
+            }
         }
         BOOST_SERIALIZATION_SPLIT_MEMBER();
         ////
@@ -46,7 +46,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Puppet(
                 id,
@@ -71,6 +71,7 @@ namespace dbtype
     std::string Puppet::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -108,7 +109,7 @@ namespace dbtype
             return false;
         }
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             puppet_display_name = name;
             notify_field_changed(ENTITYFIELD_puppet_display_name);
@@ -138,7 +139,7 @@ namespace dbtype
     {
         std::string result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = puppet_display_name;
         }
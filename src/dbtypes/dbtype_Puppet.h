@@ -175,6 +175,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<Thing>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & puppet_display_name;
         }
         BOOST_SERIALIZATION_SPLIT_MEMBER();
@@ -60,6 +60,18 @@ namespace dbtype
         return result;
     }
 
+    // -----------------------------------------------------------------------
+    const std::string &Security::security_flag_to_string(
+        const SecurityFlag flag)
+    {
+        if ((flag < SECURITYFLAG_read) or (flag > SECURITYFLAG_invalid))
+        {
+            return SECURITY_FLAGS_LONG_STRING[SECURITYFLAG_invalid];
+        }
+
+        return SECURITY_FLAGS_LONG_STRING[flag];
+    }
+
     // -----------------------------------------------------------------------
     Security::Security(void)
       : list_flags(SECURITYFLAG_invalid),
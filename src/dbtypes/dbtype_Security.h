@@ -66,6 +66,14 @@ namespace dbtype
          */
         static SecurityFlag security_flag_from_string(const std::string &flag);
 
+        /**
+         * @param flag[in] The flag as an enum.
+         * @return The flag in (long) string format, suitable for
+         * security_flag_from_string().
+         */
+        static const std::string &security_flag_to_string(
+            const SecurityFlag flag);
+
         /**
          * Standard constructor.
          */
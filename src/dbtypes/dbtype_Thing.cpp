@@ -46,7 +46,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Thing(
                 id,
@@ -71,6 +71,7 @@ namespace dbtype
     std::string Thing::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -90,7 +91,7 @@ namespace dbtype
     {
         bool success = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             set_single_id_field(
                 ENTITYFIELD_thing_home,
@@ -122,7 +123,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = thing_home;
         }
@@ -150,7 +151,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             thing_lock = lock;
             notify_field_changed(ENTITYFIELD_thing_lock);
@@ -178,7 +179,7 @@ namespace dbtype
     {
         Lock result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = thing_lock;
         }
@@ -205,7 +206,7 @@ namespace dbtype
     {
         Lock::LockType result = Lock::LOCK_INVALID;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = thing_lock.get_lock_type();
         }
@@ -223,7 +224,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = thing_lock.get_id();
         }
@@ -242,7 +243,7 @@ namespace dbtype
     {
         PropertyDirectory::PathString result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = thing_lock.get_path();
         }
@@ -263,7 +264,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not entity_ptr)
             {
@@ -291,7 +292,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             if (not entity_ptr)
             {
@@ -246,6 +246,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<ContainerPropertyEntity>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & thing_home;
             ar & thing_lock;
         }
@@ -43,7 +43,7 @@ namespace dbtype
         const InstanceType instance,
         concurrency::ReaderLockToken &token)
     {
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             Entity *copy_ptr = new Vehicle(
                 id,
@@ -68,6 +68,7 @@ namespace dbtype
     std::string Vehicle::to_string(void)
     {
         concurrency::ReaderLockToken token(*this);
+        ensure_body_loaded();
 
         std::ostringstream strstream;
 
@@ -87,7 +88,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             set_single_id_field(
                 ENTITYFIELD_vehicle_interior,
@@ -119,7 +120,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = vehicle_interior;
         }
@@ -147,7 +148,7 @@ namespace dbtype
     {
         bool result = false;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             set_single_id_field(
                 ENTITYFIELD_vehicle_controller,
@@ -179,7 +180,7 @@ namespace dbtype
     {
         Id result;
 
-        if (token.has_lock(*this))
+        if (has_lock_and_body(token))
         {
             result = vehicle_controller;
         }
@@ -198,6 +198,11 @@ namespace dbtype
         {
             ar & boost::serialization::base_object<Thing>(*this);
 
+            if (is_decoding_header())
+            {
+                return;
+            }
+
             ar & vehicle_interior;
             ar & vehicle_controller;
         }
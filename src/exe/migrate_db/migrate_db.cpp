@@ -0,0 +1,256 @@
+/*
+ * migrate_db.cpp
+ *
+ * One time utility that rewrites every Entity in an existing database using
+ * the current serialization format (see dbtype::CompactArchive).  The server
+ * can still read Entities saved in the legacy Boost archive format, but
+ * loading them is much slower.  It is safe to run this more than once.
+ *
+ * The server must not be running while this is used.
+ */
+
+#include <string>
+#include <iostream>
+#include <boost/program_options.hpp>
+
+#include "text/text_StringConversion.h"
+#include "logging/log_Logger.h"
+#include "utilities/mutgos_config.h"
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+
+#define HELP_ARG "help"
+#define CONFIGFILE_ARG "configfile"
+#define DATAPATH_ARG "datapath"
+#define BATCHSIZE_ARG "batchsize"
+
+/**
+ * Parses the commandline.
+ * @param options[in] The arguments allowed.
+ * @param args[out] The parsed arguments.
+ * @param argc[in] Argument count from the raw commandline.
+ * @param argv[in] The raw arguments from the raw commandline.
+ * @return True if successfully parsed.
+ */
+bool parse_commandline(
+    boost::program_options::options_description &options,
+    boost::program_options::variables_map &args,
+    int argc,
+    char *argv[])
+{
+    bool success = true;
+
+    try
+    {
+        boost::program_options::store(
+            boost::program_options::parse_command_line(argc, argv, options),
+            args);
+        boost::program_options::notify(args);
+    }
+    catch (boost::program_options::error &eex)
+    {
+        success = false;
+
+        std::cout << "ERROR: "
+                  << "Error parsing arguments: "  << eex.what() << std::endl;
+    }
+
+    return success;
+}
+
+/**
+ * Saves a batch of Entities in a single transaction, then frees them.
+ * @param backend[in] The database backend.
+ * @param entities[in,out] The Entities to save.  Will be cleared.
+ * @param failed_ids[out] IDs of Entities that could not be saved are
+ * added to this.
+ * @return True if the batch was committed.
+ */
+bool save_batch(
+    mutgos::sqliteinterface::SqliteBackend &backend,
+    mutgos::dbinterface::DbBackend::EntityPtrVector &entities,
+    mutgos::dbtype::Entity::IdVector &failed_ids)
+{
+    mutgos::dbtype::Entity::IdVector batch_failed_ids;
+    bool success = entities.empty();
+
+    if (not success)
+    {
+        success = backend.begin_transaction_db();
+
+        if (success)
+        {
+            // Individual failures are in batch_failed_ids; the rest are
+            // still committed.
+            backend.save_entities_db(entities, batch_failed_ids);
+            success = backend.commit_transaction_db();
+        }
+    }
+
+    if (success)
+    {
+        failed_ids.insert(
+            failed_ids.end(),
+            batch_failed_ids.begin(),
+            batch_failed_ids.end());
+    }
+
+    for (mutgos::dbinterface::DbBackend::EntityPtrVector::iterator
+            entity_iter = entities.begin();
+        entity_iter != entities.end();
+        ++entity_iter)
+    {
+        if (not success)
+        {
+            // Entire batch was rolled back.
+            failed_ids.push_back((*entity_iter)->get_entity_id());
+        }
+
+        backend.delete_entity_mem(*entity_iter);
+    }
+
+    entities.clear();
+
+    return success;
+}
+
+int main(int argc, char* argv[])
+{
+    std::cout << "Database Migration Utility.  Use --help for usage "
+              << "information."
+              << std::endl
+              << std::endl;
+
+    boost::program_options::options_description
+        option_desc("Database Migration Utility Options");
+
+    option_desc.add_options()
+           (HELP_ARG, "Show this help screen")
+           (CONFIGFILE_ARG,
+               boost::program_options::value<std::string>(),
+               "The config file to load and use.  Default is mutgos.conf")
+           (DATAPATH_ARG,
+               boost::program_options::value<std::string>(),
+               "Specifies the path of the database to migrate.  File name is specified in the config file.  Default is what's in the config file.")
+           (BATCHSIZE_ARG,
+               boost::program_options::value<size_t>(),
+               "How many Entities to save per transaction.  Default is 1000.")
+        ;
+
+    boost::program_options::variables_map args;
+    std::string config_file = "mutgos.conf";
+    std::string data_path = "";
+    size_t batch_size = 1000;
+    const bool good_parse = parse_commandline(option_desc, args, argc, argv);
+
+    if (not good_parse)
+    {
+        // Error message already printed.
+        return -1;
+    }
+
+    if (args.count(HELP_ARG))
+    {
+        std::cout << option_desc << std::endl;
+        return 0;
+    }
+
+    if (args.count(CONFIGFILE_ARG))
+    {
+        config_file = args[CONFIGFILE_ARG].as<std::string>();
+    }
+
+    if (args.count(DATAPATH_ARG))
+    {
+        data_path = args[DATAPATH_ARG].as<std::string>();
+    }
+
+    if (args.count(BATCHSIZE_ARG) and args[BATCHSIZE_ARG].as<size_t>())
+    {
+        batch_size = args[BATCHSIZE_ARG].as<size_t>();
+    }
+
+    mutgos::log::Logger::init(true);
+
+    if (not mutgos::config::parse_config(config_file, data_path))
+    {
+        std::cout << "ERROR: Failed to parse config file." << std::endl;
+        return -1;
+    }
+
+    mutgos::sqliteinterface::SqliteBackend backend;
+
+    if (not backend.init())
+    {
+        std::cout << "ERROR: Failed to open database." << std::endl;
+        return -1;
+    }
+
+    const mutgos::dbtype::Id::SiteIdVector site_ids =
+        backend.get_site_ids_in_db();
+    mutgos::dbinterface::DbBackend::EntityPtrVector entities;
+    mutgos::dbtype::Entity::IdVector failed_ids;
+    size_t entity_count = 0;
+
+    entities.reserve(batch_size);
+
+    for (mutgos::dbtype::Id::SiteIdVector::const_iterator site_iter =
+            site_ids.begin();
+        site_iter != site_ids.end();
+        ++site_iter)
+    {
+        const mutgos::dbtype::Entity::IdVector entity_ids =
+            backend.find_in_db(*site_iter);
+
+        std::cout << "Migrating site " << *site_iter << " ("
+                  << entity_ids.size() << " Entities)..." << std::endl;
+
+        for (mutgos::dbtype::Entity::IdVector::const_iterator id_iter =
+                entity_ids.begin();
+            id_iter != entity_ids.end();
+            ++id_iter)
+        {
+            mutgos::dbtype::Entity * const entity_ptr =
+                backend.get_entity_db(*id_iter);
+
+            if (not entity_ptr)
+            {
+                failed_ids.push_back(*id_iter);
+            }
+            else
+            {
+                entities.push_back(entity_ptr);
+            }
+
+            ++entity_count;
+
+            if (entities.size() >= batch_size)
+            {
+                save_batch(backend, entities, failed_ids);
+            }
+        }
+
+        save_batch(backend, entities, failed_ids);
+    }
+
+    backend.shutdown();
+
+    for (mutgos::dbtype::Entity::IdVector::const_iterator failed_iter =
+            failed_ids.begin();
+        failed_iter != failed_ids.end();
+        ++failed_iter)
+    {
+        std::cout << "ERROR: Could not migrate Entity "
+                  << failed_iter->to_string(true) << std::endl;
+    }
+
+    std::cout << "Migrated " << (entity_count - failed_ids.size())
+              << " of " << entity_count << " Entities with "
+              << failed_ids.size() << " failures." << std::endl;
+
+    return failed_ids.empty() ? 0 : -1;
+}
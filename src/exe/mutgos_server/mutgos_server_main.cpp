@@ -178,7 +178,7 @@ int main(int argc, char* argv[])
      */
 
     if (good_init and
-        not mutgos::dbinterface::DatabaseAccess::make_singleton()->startup())
+        not mutgos::dbinterface::DatabaseAccess::make_singleton()->startup(true))
     {
         std::cout << "Failed to init dbinterface" << std::endl;
         good_init = false;
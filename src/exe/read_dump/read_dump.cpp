@@ -16,6 +16,7 @@
 #define CONFIGFILE_ARG "configfile"
 #define DUMPFILE_ARG "dumpfile"
 #define DATAPATH_ARG "datapath"
+#define BULK_ARG "bulk"
 
 // TODO Update documentation for how to run.
 
@@ -106,12 +107,15 @@ int main(int argc, char* argv[])
            (DATAPATH_ARG,
                boost::program_options::value<std::string>(),
                "Specifies the path to save the generated database.  File name is specified in the config file.  Default is what's in the config file.")
+           (BULK_ARG,
+               "Load the dump in bulk load mode: one large transaction, with indexes and references built at the end.  Much faster for large dumps.")
         ;
 
     boost::program_options::variables_map args;
     std::string config_file = "mutgos.conf";
     std::string dump_file = "mutgos.dump";
     std::string data_path = "";
+    bool bulk_load = false;
     const bool good_parse = parse_commandline(option_desc, args, argc, argv);
 
     if (not good_parse)
@@ -141,6 +145,11 @@ int main(int argc, char* argv[])
         data_path = args[DATAPATH_ARG].as<std::string>();
     }
 
+    if (args.count(BULK_ARG))
+    {
+        bulk_load = true;
+    }
+
     mutgos::log::Logger::init(true);
     const bool good_config_read = mutgos::config::parse_config(config_file, data_path);
 
@@ -161,9 +170,19 @@ int main(int argc, char* argv[])
 
     mutgos::dbdump::MutgosDumpFileReader reader(
         dump_file,
-        parent_path);
+        parent_path,
+        bulk_load);
+
+    const bool good_parse_dump = reader.parse(message);
+    const double parse_seconds = reader.get_parse_seconds();
+    const MG_LongUnsignedInt entities = reader.get_entities_created();
+
+    std::cout << "Created " << entities << " entities in "
+              << parse_seconds << " seconds ("
+              << (parse_seconds > 0 ? (entities / parse_seconds) : 0)
+              << " entities/second)." << std::endl;
 
-    if (reader.parse(message))
+    if (good_parse_dump)
     {
         std::cout << "Success: Parsing complete." << std::endl
                   << "  Message: " << message << std::endl;
@@ -0,0 +1,265 @@
+/*
+ * dbbackend_td.cpp
+ * Compares how quickly the SQLite and log store database backends can
+ * create, save, and load Entities, and checks that what is loaded back
+ * matches what was created.
+ *
+ * Usage: dbbackend_td <config file> <data path> [entity count] [saves]
+ * The data path should point somewhere with a scratch database and log
+ * store, since a temporary site is created (and deleted) in each.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+#include "logging/log_Logger.h"
+#include "utilities/mutgos_config.h"
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+#include "logstoreinterface/logstoreinterface_LogStoreBackend.h"
+
+#include "exe/test/test_Timing.h"
+
+using namespace mutgos;
+
+/**
+ * Runs the benchmark on an initialized backend.
+ * @param backend[in] The backend to benchmark.
+ * @param entity_count[in] How many Entities to create.
+ * @param save_count[in] How many times each Entity is saved.
+ * @return True if everything succeeded.
+ */
+bool run_benchmark(
+    dbinterface::DbBackend &backend,
+    const size_t entity_count,
+    const size_t save_count)
+{
+    std::cout << backend.get_backend_name() << ":" << std::endl;
+
+    dbtype::Id::SiteIdType site_id = 0;
+
+    if (not backend.new_site_in_db(site_id))
+    {
+        std::cerr << "FAILED to create site." << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    dbtype::Entity::IdVector ids;
+    dbinterface::DbBackend::EntityPtrVector entities;
+    std::vector<dbtype::EntityType> types;
+    dbtype::Entity::IdVector owners;
+    std::vector<std::string> names;
+
+    ids.reserve(entity_count);
+    entities.reserve(entity_count);
+    types.reserve(entity_count);
+    owners.reserve(entity_count);
+    names.reserve(entity_count);
+
+    // Create
+    //
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    for (size_t index = 0; index < entity_count; ++index)
+    {
+        // Vary what is created so the reload check below means something.
+        //
+        types.push_back(
+            (index % 2) ? dbtype::ENTITYTYPE_room : dbtype::ENTITYTYPE_thing);
+        owners.push_back(ids.empty() ? dbtype::Id() : ids.front());
+        names.push_back("Benchmark Entity " + std::to_string(index));
+
+        dbtype::Entity * const entity_ptr = backend.new_entity(
+            types.back(),
+            site_id,
+            owners.back(),
+            names.back());
+
+        if (not entity_ptr)
+        {
+            std::cerr << "FAILED to create Entity." << std::endl;
+            success = false;
+            break;
+        }
+
+        ids.push_back(entity_ptr->get_entity_id());
+        delete entity_ptr;
+    }
+
+    test::print_rate("  Create", ids.size(), "entities", start);
+
+    // Load
+    //
+    start = std::chrono::steady_clock::now();
+
+    for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+        success and (id_iter != ids.end());
+        ++id_iter)
+    {
+        dbtype::Entity * const entity_ptr = backend.get_entity_db(*id_iter);
+
+        if (not entity_ptr)
+        {
+            std::cerr << "FAILED to load Entity." << std::endl;
+            success = false;
+        }
+        else
+        {
+            entities.push_back(entity_ptr);
+        }
+    }
+
+    test::print_rate("  Load", entities.size(), "entities", start);
+
+    // Save each Entity repeatedly, as happens while they are in use.
+    //
+    start = std::chrono::steady_clock::now();
+
+    for (size_t save = 0; success and (save < save_count); ++save)
+    {
+        for (dbinterface::DbBackend::EntityPtrVector::iterator entity_iter =
+                entities.begin();
+            success and (entity_iter != entities.end());
+            ++entity_iter)
+        {
+            if (not backend.save_entity_db(*entity_iter))
+            {
+                std::cerr << "FAILED to save Entity." << std::endl;
+                success = false;
+            }
+        }
+    }
+
+    test::print_rate(
+        "  Save",
+        entities.size() * save_count,
+        "entities",
+        start);
+
+    // Unload, then load again from what was saved.
+    //
+    for (dbinterface::DbBackend::EntityPtrVector::iterator entity_iter =
+            entities.begin();
+        entity_iter != entities.end();
+        ++entity_iter)
+    {
+        backend.delete_entity_mem(*entity_iter);
+    }
+
+    entities.clear();
+    start = std::chrono::steady_clock::now();
+
+    for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+        success and (id_iter != ids.end());
+        ++id_iter)
+    {
+        dbtype::Entity * const entity_ptr = backend.get_entity_db(*id_iter);
+
+        if (not entity_ptr)
+        {
+            std::cerr << "FAILED to reload Entity." << std::endl;
+            success = false;
+        }
+        else
+        {
+            entities.push_back(entity_ptr);
+        }
+    }
+
+    test::print_rate("  Reload", entities.size(), "entities", start);
+
+    // Make sure what was reloaded is what was created.
+    //
+    for (size_t index = 0; success and (index < entities.size()); ++index)
+    {
+        dbtype::Entity * const entity_ptr = entities[index];
+
+        if ((entity_ptr->get_entity_id() != ids[index]) or
+            (entity_ptr->get_entity_type() != types[index]) or
+            (entity_ptr->get_entity_owner() != owners[index]) or
+            (entity_ptr->get_entity_name() != names[index]))
+        {
+            std::cerr << "FAILED: reloaded Entity "
+                      << ids[index].to_string(true)
+                      << " does not match what was created." << std::endl;
+            success = false;
+        }
+    }
+
+    // Clean up.
+    //
+    for (dbinterface::DbBackend::EntityPtrVector::iterator entity_iter =
+            entities.begin();
+        entity_iter != entities.end();
+        ++entity_iter)
+    {
+        backend.delete_entity_mem(*entity_iter);
+    }
+
+    entities.clear();
+    backend.delete_site_in_db(site_id);
+
+    return success;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: dbbackend_td <config file> <data path> "
+                  << "[entity count] [saves]" << std::endl;
+        return -1;
+    }
+
+    const size_t entity_count = (argc > 3) ? atol(argv[3]) : 5000;
+    const size_t save_count = (argc > 4) ? atol(argv[4]) : 10;
+
+    log::Logger::init(true);
+
+    if (not config::parse_config(argv[1], argv[2]))
+    {
+        std::cerr << "FAILED to parse config file." << std::endl;
+        return -1;
+    }
+
+    bool success = true;
+
+    {
+        sqliteinterface::SqliteBackend backend;
+
+        if (not backend.init())
+        {
+            std::cerr << "FAILED to init SQLite backend." << std::endl;
+            return -1;
+        }
+
+        success = run_benchmark(backend, entity_count, save_count);
+        backend.shutdown();
+    }
+
+    {
+        logstoreinterface::LogStoreBackend backend;
+
+        if (not backend.init())
+        {
+            std::cerr << "FAILED to init log store backend." << std::endl;
+            return -1;
+        }
+
+        success = run_benchmark(backend, entity_count, save_count) and
+            success;
+        backend.shutdown();
+    }
+
+    return success ? 0 : -1;
+}
@@ -0,0 +1,171 @@
+/*
+ * dbcommit_td.cpp
+ * Measures how quickly the database backend can commit Entities, both
+ * individually (one transaction per Entity) and as a single batch.
+ *
+ * Usage: dbcommit_td <config file> <data path> [entity count]
+ * The data path should point somewhere with a scratch database, since a
+ * temporary site is created (and deleted) in it.
+ */
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+#include "logging/log_Logger.h"
+#include "utilities/mutgos_config.h"
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+
+#include "exe/test/test_Timing.h"
+
+using namespace mutgos;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: dbcommit_td <config file> <data path> "
+                  << "[entity count]" << std::endl;
+        return -1;
+    }
+
+    const size_t entity_count = (argc > 3) ? atol(argv[3]) : 5000;
+
+    log::Logger::init(true);
+
+    if (not config::parse_config(argv[1], argv[2]))
+    {
+        std::cerr << "FAILED to parse config file." << std::endl;
+        return -1;
+    }
+
+    sqliteinterface::SqliteBackend backend;
+    dbtype::Id::SiteIdType site_id = 0;
+
+    if (not (backend.init() and backend.new_site_in_db(site_id)))
+    {
+        std::cerr << "FAILED to init database and create site." << std::endl;
+        return -1;
+    }
+
+    // Create the Entities to commit.  What new_entity() returns is not
+    // owned by the backend and cannot be saved, so delete it and load it
+    // back from the database.
+    //
+    dbinterface::DbBackend::EntityPtrVector entities;
+    dbtype::Entity::IdVector ids;
+    dbtype::Entity::IdVector failed_ids;
+    bool success = true;
+
+    ids.reserve(entity_count);
+    entities.reserve(entity_count);
+
+    for (size_t index = 0; index < entity_count; ++index)
+    {
+        dbtype::Entity * const entity_ptr = backend.new_entity(
+            dbtype::ENTITYTYPE_thing,
+            site_id,
+            dbtype::Id(),
+            "Benchmark Thing");
+
+        if (not entity_ptr)
+        {
+            std::cerr << "FAILED to create Entity." << std::endl;
+            success = false;
+            break;
+        }
+
+        ids.push_back(entity_ptr->get_entity_id());
+        delete entity_ptr;
+    }
+
+    for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+        success and (id_iter != ids.end());
+        ++id_iter)
+    {
+        dbtype::Entity * const entity_ptr = backend.get_entity_db(*id_iter);
+
+        if (not entity_ptr)
+        {
+            std::cerr << "FAILED to load Entity." << std::endl;
+            success = false;
+        }
+        else
+        {
+            entities.push_back(entity_ptr);
+        }
+    }
+
+    // One transaction per Entity, which is how every commit used to be
+    // done.
+    //
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    for (dbinterface::DbBackend::EntityPtrVector::iterator entity_iter =
+            entities.begin();
+         success and (entity_iter != entities.end());
+         ++entity_iter)
+    {
+        if (not backend.save_entity_db(*entity_iter))
+        {
+            failed_ids.push_back((*entity_iter)->get_entity_id());
+        }
+    }
+
+    test::print_rate(
+        "Individual commits",
+        entities.size(),
+        "entities",
+        start);
+
+    // All Entities in a single transaction.
+    //
+    start = std::chrono::steady_clock::now();
+
+    bool batch_success = success and backend.begin_transaction_db();
+
+    if (batch_success)
+    {
+        // Individual failures are in failed_ids; the rest still commit.
+        backend.save_entities_db(entities, failed_ids);
+        batch_success = backend.commit_transaction_db();
+    }
+
+    test::print_rate("Batch commit", entities.size(), "entities", start);
+
+    // Clean up.
+    //
+    for (dbinterface::DbBackend::EntityPtrVector::iterator entity_iter =
+            entities.begin();
+         entity_iter != entities.end();
+         ++entity_iter)
+    {
+        backend.delete_entity_mem(*entity_iter);
+    }
+
+    entities.clear();
+    backend.delete_site_in_db(site_id);
+    backend.shutdown();
+
+    if (not success)
+    {
+        return -1;
+    }
+
+    if ((not batch_success) or (not failed_ids.empty()))
+    {
+        std::cerr << "FAILED to commit " << failed_ids.size()
+                  << " entities." << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
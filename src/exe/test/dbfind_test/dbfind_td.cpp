@@ -0,0 +1,219 @@
+/*
+ * dbfind_td.cpp
+ * Measures how quickly the configured database backend can find Entities
+ * by owner on a large site, such as all the puppets of a player or all
+ * the programs a player owns.
+ *
+ * Usage: dbfind_td <config file> <data path> [entity count] [player count]
+ * The data path should point somewhere with a scratch database, since a
+ * temporary site is created (and deleted) in it.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+#include "logging/log_Logger.h"
+#include "utilities/mutgos_config.h"
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+
+#include "exe/test/test_Timing.h"
+
+using namespace mutgos;
+
+/**
+ * Times a search by owner for every player.
+ * @param backend[in] The backend to search.
+ * @param site_id[in] The site to search.
+ * @param players[in] The players to search for.
+ * @param type[in] The type to search for, or invalid for all.
+ * @param expected[in] How many Entities the searches should find in
+ * total.
+ * @param label[in] What the search is.
+ * @return True if the expected number of Entities were found.
+ */
+bool time_owner_search(
+    dbinterface::DbBackend &backend,
+    const dbtype::Id::SiteIdType site_id,
+    const dbtype::Entity::IdVector &players,
+    const dbtype::EntityType type,
+    const size_t expected,
+    const std::string &label)
+{
+    size_t found = 0;
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    for (dbtype::Entity::IdVector::const_iterator player_iter =
+            players.begin();
+        player_iter != players.end();
+        ++player_iter)
+    {
+        found += backend.find_in_db(
+            site_id,
+            type,
+            player_iter->get_entity_id(),
+            std::string(),
+            false).size();
+    }
+
+    test::print_rate(label, players.size(), "searches", start);
+    std::cout << "  " << found << " found" << std::endl;
+
+    if (found != expected)
+    {
+        std::cerr << "FAILED: " << label << " should have found "
+                  << expected << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: dbfind_td <config file> <data path> "
+                  << "[entity count] [player count]" << std::endl;
+        return -1;
+    }
+
+    const size_t entity_count = (argc > 3) ? atol(argv[3]) : 1000000;
+    const size_t player_count = (argc > 4) ? atol(argv[4]) : 1000;
+
+    log::Logger::init(true);
+
+    if (not player_count)
+    {
+        std::cerr << "Player count must be at least 1." << std::endl;
+        return -1;
+    }
+
+    if (not config::parse_config(argv[1], argv[2]))
+    {
+        std::cerr << "FAILED to parse config file." << std::endl;
+        return -1;
+    }
+
+    dbinterface::DbBackend * const backend_ptr =
+        dbinterface::DatabaseAccess::make_backend();
+
+    dbtype::Id::SiteIdType site_id = 0;
+
+    if (not (backend_ptr->init() and backend_ptr->new_site_in_db(site_id)))
+    {
+        std::cerr << "FAILED to init database and create site." << std::endl;
+        delete backend_ptr;
+        return -1;
+    }
+
+    std::cout << "Backend: " << backend_ptr->get_backend_name()
+              << std::endl;
+
+    // Fill the site.  Everything is owned by one of the players, and is
+    // a mix of puppets, programs, and things.
+    //
+    const dbtype::EntityType types[] =
+        { dbtype::ENTITYTYPE_thing,
+          dbtype::ENTITYTYPE_thing,
+          dbtype::ENTITYTYPE_puppet,
+          dbtype::ENTITYTYPE_program };
+    const size_t type_count = sizeof(types) / sizeof(types[0]);
+    dbtype::Entity::IdVector players;
+    size_t puppets = 0;
+    size_t programs = 0;
+    size_t owned = 0;
+    bool success = backend_ptr->begin_bulk_load_db();
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    for (size_t index = 0; success and (index < entity_count); ++index)
+    {
+        const bool is_player = (index < player_count);
+        dbtype::Entity * const entity_ptr = backend_ptr->new_entity(
+            is_player ? dbtype::ENTITYTYPE_player : types[index % type_count],
+            site_id,
+            is_player ? dbtype::Id() : players[index % player_count],
+            "Benchmark Entity " + std::to_string(index));
+
+        if (not entity_ptr)
+        {
+            std::cerr << "FAILED to create Entity." << std::endl;
+            success = false;
+        }
+        else
+        {
+            if (is_player)
+            {
+                players.push_back(entity_ptr->get_entity_id());
+            }
+            else
+            {
+                ++owned;
+
+                if (entity_ptr->get_entity_type() == dbtype::ENTITYTYPE_puppet)
+                {
+                    ++puppets;
+                }
+                else if (entity_ptr->get_entity_type() ==
+                    dbtype::ENTITYTYPE_program)
+                {
+                    ++programs;
+                }
+            }
+
+            delete entity_ptr;
+        }
+    }
+
+    success = backend_ptr->end_bulk_load_db() and success;
+
+    test::print_rate("Create", entity_count, "entities", start);
+
+    if (not success)
+    {
+        std::cerr << "FAILED to create site." << std::endl;
+    }
+    else
+    {
+        success = time_owner_search(
+            *backend_ptr,
+            site_id,
+            players,
+            dbtype::ENTITYTYPE_puppet,
+            puppets,
+            "Puppets by owner");
+        success = time_owner_search(
+            *backend_ptr,
+            site_id,
+            players,
+            dbtype::ENTITYTYPE_program,
+            programs,
+            "Programs by owner") and success;
+        success = time_owner_search(
+            *backend_ptr,
+            site_id,
+            players,
+            dbtype::ENTITYTYPE_invalid,
+            owned,
+            "Everything by owner") and success;
+    }
+
+    // Clean up.
+    //
+    backend_ptr->delete_site_in_db(site_id);
+    backend_ptr->shutdown();
+    delete backend_ptr;
+
+    return success ? 0 : -1;
+}
@@ -0,0 +1,210 @@
+/*
+ * entityref_td.cpp
+ * Measures how quickly EntityRefs can be copied when every executor
+ * thread is copying references to the same Entity, comparing
+ * CachedEntity's atomic reference count to the mutex protected count it
+ * replaced.
+ *
+ * Usage: entityref_td <config file> <data path> [copies per thread]
+ * The config file supplies the executor thread count.
+ */
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/bind.hpp>
+
+#include "logging/log_Logger.h"
+#include "utilities/mutgos_config.h"
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_Thing.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include "dbinterface/dbinterface_EntityRef.h"
+#include "dbinterface/dbinterface_EntityRefCounter.h"
+#include "dbinterface/dbinterface_CachedEntity.h"
+
+#include "exe/test/test_Timing.h"
+
+using namespace mutgos;
+
+/**
+ * CachedEntity's reference counting as it was before the count became
+ * atomic: every reference added or removed locks a mutex.  The reference
+ * paths are copied unchanged, so the two can be compared side by side.
+ */
+class BaselineCachedEntity : public dbinterface::EntityRefCounter
+{
+public:
+    BaselineCachedEntity(dbtype::Entity *entity)
+      : ref_count(0),
+        entity_ptr(entity)
+    {
+    }
+
+    virtual ~BaselineCachedEntity()
+    {
+    }
+
+    virtual void mem_reference_added(const dbtype::Entity *entity)
+    {
+        if (entity != entity_ptr)
+        {
+            LOG(fatal, "entityref_td", "mem_reference_added()",
+                "Mismatched entity pointers!");
+        }
+        else
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            ++ref_count;
+        }
+    }
+
+    virtual void mem_reference_removed(const dbtype::Entity *entity)
+    {
+        if (entity != entity_ptr)
+        {
+            LOG(fatal, "entityref_td", "mem_reference_removed()",
+                "Mismatched entity pointers!");
+        }
+        else
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            if (ref_count)
+            {
+                --ref_count;
+            }
+            else
+            {
+                LOG(fatal, "entityref_td", "mem_reference_removed()",
+                    "More references than were counted!");
+            }
+        }
+    }
+
+    void get_reference(dbinterface::EntityRef &ref)
+    {
+        ref.set_reference(entity_ptr, this);
+    }
+
+    bool is_referenced(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        return ref_count;
+    }
+
+private:
+    boost::mutex mutex;
+    unsigned int ref_count;
+    dbtype::Entity *entity_ptr;
+};
+
+/**
+ * Repeatedly copies and destroys an EntityRef.
+ * @param ref[in] The reference to copy.
+ * @param copies[in] How many copies to make.
+ */
+void copy_refs(const dbinterface::EntityRef &ref, const size_t copies)
+{
+    for (size_t count = 0; count < copies; ++count)
+    {
+        dbinterface::EntityRef copy(ref);
+    }
+}
+
+/**
+ * Runs copy_refs() on several threads at once and prints the rate.
+ * @param label[in] What is being run.
+ * @param ref[in] The reference each thread copies.
+ * @param thread_count[in] How many threads to run.
+ * @param copies[in] How many copies each thread makes.
+ */
+void run_threads(
+    const std::string &label,
+    const dbinterface::EntityRef &ref,
+    const size_t thread_count,
+    const size_t copies)
+{
+    boost::thread_group threads;
+
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    for (size_t index = 0; index < thread_count; ++index)
+    {
+        threads.create_thread(boost::bind(&copy_refs, boost::cref(ref), copies));
+    }
+
+    threads.join_all();
+
+    test::print_rate(
+        label + " (" + std::to_string(thread_count) + " threads)",
+        thread_count * copies,
+        "copies",
+        start);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: entityref_td <config file> <data path> "
+                  << "[copies per thread]" << std::endl;
+        return -1;
+    }
+
+    const size_t copies = (argc > 3) ? atol(argv[3]) : 10000000;
+
+    log::Logger::init(true);
+
+    if (not config::parse_config(argv[1], argv[2]))
+    {
+        std::cerr << "FAILED to parse config file." << std::endl;
+        return -1;
+    }
+
+    const size_t thread_count = config::executor::thread_count();
+    dbtype::Thing thing(dbtype::Id(1, 1));
+
+    {
+        BaselineCachedEntity baseline_entity(&thing);
+        dbinterface::EntityRef ref;
+
+        baseline_entity.get_reference(ref);
+        run_threads("Mutex count", ref, thread_count, copies);
+        ref.clear();
+
+        if (baseline_entity.is_referenced())
+        {
+            std::cerr << "FAILED: mutex count references remain after all "
+                      << "copies were destroyed." << std::endl;
+            return -1;
+        }
+    }
+
+    {
+        dbinterface::CachedEntity cached_entity(&thing);
+        dbinterface::EntityRef ref;
+
+        cached_entity.get_reference(ref);
+        run_threads("Atomic count", ref, thread_count, copies);
+        ref.clear();
+
+        if (cached_entity.is_referenced())
+        {
+            std::cerr << "FAILED: atomic count references remain after all "
+                      << "copies were destroyed." << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * test_Timing.h
+ * Timing helpers shared by the test drivers.
+ */
+
+#ifndef MUTGOS_TEST_TIMING_H
+#define MUTGOS_TEST_TIMING_H
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <stddef.h>
+
+namespace mutgos
+{
+namespace test
+{
+    /**
+     * @param start[in] When the run started.
+     * @return How many seconds have passed since start.
+     */
+    inline double seconds_since(
+        const std::chrono::steady_clock::time_point &start)
+    {
+        return std::chrono::duration_cast<std::chrono::duration<double> >(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * Prints how long a timed run took and how many operations per second
+     * it managed, as "label: count units in S seconds (R units/sec)".
+     * @param label[in] What was run.
+     * @param count[in] How many operations were done.
+     * @param units[in] What an operation is, such as "entities".
+     * @param start[in] When the run started.
+     */
+    inline void print_rate(
+        const std::string &label,
+        const size_t count,
+        const std::string &units,
+        const std::chrono::steady_clock::time_point &start)
+    {
+        const double seconds = seconds_since(start);
+
+        std::cout << label << ": " << count << " " << units << " in "
+                  << seconds << " seconds ("
+                  << (seconds > 0 ? (count / seconds) : 0)
+                  << " " << units << "/sec)" << std::endl;
+    }
+}
+}
+
+#endif //MUTGOS_TEST_TIMING_H
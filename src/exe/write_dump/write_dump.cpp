@@ -0,0 +1,217 @@
+/*
+ * write_dump.cpp
+ */
+
+#include <string>
+#include <iostream>
+#include "text/text_StringConversion.h"
+#include <boost/program_options.hpp>
+
+#include "logging/log_Logger.h"
+#include "dbdump/dbdump_MutgosDumpFileWriter.h"
+#include "utilities/mutgos_config.h"
+
+#define HELP_ARG "help"
+#define CONFIGFILE_ARG "configfile"
+#define DUMPFILE_ARG "dumpfile"
+#define DATAPATH_ARG "datapath"
+#define THREADS_ARG "threads"
+#define PREVIOUS_ARG "previous"
+#define MANIFEST_ARG "manifest"
+
+/**
+ * Parses the commandline.
+ * @param options[in] The arguments allowed.
+ * @param args[out] The parsed arguments.
+ * @param argc[in] Argument count from the raw commandline.
+ * @param argv[in] The raw arguments from the raw commandline.
+ * @return True if successfully parsed.
+ */
+bool parse_commandline(
+    boost::program_options::options_description &options,
+    boost::program_options::variables_map &args,
+    int argc,
+    char *argv[])
+{
+    bool success = true;
+
+    try
+    {
+        boost::program_options::store(
+            boost::program_options::parse_command_line(argc, argv, options),
+            args);
+        boost::program_options::notify(args);
+    }
+    catch (boost::program_options::unknown_option &uoex)
+    {
+        success = false;
+
+        std::cout << "ERROR: "
+                  << "Unknown argument: " << uoex.get_option_name() << std::endl;
+    }
+    catch (boost::program_options::validation_error &vex)
+    {
+        success = false;
+
+        std::cout << "ERROR: "
+                  << "Bad value for argument: " << vex.get_option_name()
+                  << std::endl;
+    }
+    catch (boost::program_options::multiple_occurrences &moex)
+    {
+        success = false;
+
+        std::cout << "ERROR: "
+                  << "More than one instance of argument: "
+                  << moex.get_option_name() << std::endl;
+    }
+    catch (boost::program_options::multiple_values &mvex)
+    {
+        success = false;
+
+        std::cout << "ERROR: "
+                  << "More than one value of argument: "
+                  << mvex.get_option_name() << std::endl;
+    }
+    catch (boost::program_options::error &eex)
+    {
+        success = false;
+
+        std::cout << "ERROR: "
+                  << "Error parsing arguments: "  << eex.what() << std::endl;
+    }
+
+    return success;
+}
+
+int main(int argc, char* argv[])
+{
+    int rc = 0;
+
+    std::cout << "Write Dump Utility.  Use --help for usage information."
+              << std::endl
+              << std::endl;
+
+    boost::program_options::options_description
+        option_desc("Write Dump Utility Options");
+
+    option_desc.add_options()
+           (HELP_ARG, "Show this help screen")
+           (CONFIGFILE_ARG,
+               boost::program_options::value<std::string>(),
+               "The config file to load and use.  Default is mutgos.conf")
+           (DUMPFILE_ARG,
+               boost::program_options::value<std::string>(),
+               "The dump file to write.  Each site is written to its own file next to it.  Default is mutgos.dump")
+           (DATAPATH_ARG,
+               boost::program_options::value<std::string>(),
+               "Specifies the path to the database to dump.  File name is specified in the config file.  Default is what's in the config file.")
+           (THREADS_ARG,
+               boost::program_options::value<MG_UnsignedInt>(),
+               "How many sites to write at once.  Default is the executor thread count in the config file.")
+           (PREVIOUS_ARG,
+               boost::program_options::value<std::string>(),
+               "The manifest of a previous export.  Only Entities that are new or changed since then will be written.  The dump file must be in the same directory as the previous export.")
+           (MANIFEST_ARG,
+               boost::program_options::value<std::string>(),
+               "Where to save the manifest of this export, for use with a later incremental export.")
+        ;
+
+    boost::program_options::variables_map args;
+    std::string config_file = "mutgos.conf";
+    std::string dump_file = "mutgos.dump";
+    std::string data_path = "";
+    std::string previous_manifest;
+    std::string manifest;
+    MG_UnsignedInt threads = 0;
+    const bool good_parse = parse_commandline(option_desc, args, argc, argv);
+
+    if (not good_parse)
+    {
+        // Error message already printed.
+        return -1;
+    }
+
+    if (args.count(HELP_ARG))
+    {
+        std::cout << option_desc << std::endl;
+        return 0;
+    }
+
+    if (args.count(CONFIGFILE_ARG))
+    {
+        config_file = args[CONFIGFILE_ARG].as<std::string>();
+    }
+
+    if (args.count(DUMPFILE_ARG))
+    {
+        dump_file = args[DUMPFILE_ARG].as<std::string>();
+    }
+
+    if (args.count(DATAPATH_ARG))
+    {
+        data_path = args[DATAPATH_ARG].as<std::string>();
+    }
+
+    if (args.count(THREADS_ARG))
+    {
+        threads = args[THREADS_ARG].as<MG_UnsignedInt>();
+    }
+
+    if (args.count(PREVIOUS_ARG))
+    {
+        previous_manifest = args[PREVIOUS_ARG].as<std::string>();
+    }
+
+    if (args.count(MANIFEST_ARG))
+    {
+        manifest = args[MANIFEST_ARG].as<std::string>();
+    }
+
+    mutgos::log::Logger::init(true);
+    const bool good_config_read = mutgos::config::parse_config(config_file, data_path);
+
+    if (not good_config_read)
+    {
+        std::cout << "ERROR: Failed to parse config file." << std::endl;
+        return -1;
+    }
+
+    if (not threads)
+    {
+        threads = mutgos::config::executor::thread_count();
+    }
+
+    std::string message;
+
+    mutgos::dbdump::MutgosDumpFileWriter writer(
+        dump_file,
+        threads,
+        previous_manifest,
+        manifest);
+
+    const bool good_write = writer.write(message);
+    const double write_seconds = writer.get_write_seconds();
+    const MG_LongUnsignedInt entities = writer.get_entities_written();
+
+    std::cout << "Wrote " << entities << " entities ("
+              << writer.get_entities_unchanged() << " unchanged) in "
+              << write_seconds << " seconds ("
+              << (write_seconds > 0 ? (entities / write_seconds) : 0)
+              << " entities/second)." << std::endl;
+
+    if (good_write)
+    {
+        std::cout << "Success: Dump written." << std::endl
+                  << "  Message: " << message << std::endl;
+    }
+    else
+    {
+        std::cerr << "FAILURE: Dump NOT completely written." << std::endl
+                  << "  Message: " << message << std::endl;
+
+        rc = -1;
+    }
+
+    return rc;
+}
\ No newline at end of file
@@ -0,0 +1,313 @@
+/*
+ * logstoreinterface_LogRecord.cpp
+ */
+
+#include <string>
+#include <stddef.h>
+#include <boost/crc.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbtypes/dbtype_CompactArchive.h"
+
+#include "logstoreinterface_LogRecord.h"
+
+namespace
+{
+    /** Starts every record header ("MGLR") */
+    const MG_UnsignedInt RECORD_MAGIC = 0x524C474D;
+
+    /** Largest payload a record may have.  Anything bigger in a header
+        means the header is damaged. */
+    const size_t MAX_PAYLOAD_SIZE = 256 * 1024 * 1024;
+
+    /**
+     * Writes a 32 bit unsigned integer, little endian.
+     * @param value[in] The value to write.
+     * @param buffer[out] Where to append the value.
+     */
+    void write_uint32(const MG_UnsignedInt value, std::string &buffer)
+    {
+        buffer.push_back((char) (value & 0xFF));
+        buffer.push_back((char) ((value >> 8) & 0xFF));
+        buffer.push_back((char) ((value >> 16) & 0xFF));
+        buffer.push_back((char) ((value >> 24) & 0xFF));
+    }
+
+    /**
+     * Reads a 32 bit unsigned integer, little endian.
+     * @param data_ptr[in] Where to read the value from.
+     * @return The value.
+     */
+    MG_UnsignedInt read_uint32(const char *data_ptr)
+    {
+        const unsigned char * const bytes_ptr =
+            (const unsigned char *) data_ptr;
+
+        return ((MG_UnsignedInt) bytes_ptr[0]) |
+            (((MG_UnsignedInt) bytes_ptr[1]) << 8) |
+            (((MG_UnsignedInt) bytes_ptr[2]) << 16) |
+            (((MG_UnsignedInt) bytes_ptr[3]) << 24);
+    }
+
+    /**
+     * @param data_ptr[in] The data to checksum.
+     * @param data_size[in] The size of the data, in bytes.
+     * @return The CRC-32 of the data.
+     */
+    MG_UnsignedInt checksum(const char *data_ptr, const size_t data_size)
+    {
+        boost::crc_32_type crc;
+
+        crc.process_bytes(data_ptr, data_size);
+        return crc.checksum();
+    }
+}
+
+namespace mutgos
+{
+namespace logstoreinterface
+{
+    // Statics
+    //
+    const size_t LogRecord::HEADER_SIZE;
+
+    // ----------------------------------------------------------------------
+    LogRecord::LogRecord(void)
+      : type(RECORD_invalid),
+        in_transaction(false),
+        sequence(0),
+        site_id(0),
+        entity_id(0),
+        incarnation(0),
+        entity_type(dbtype::ENTITYTYPE_invalid),
+        owner(0),
+        version(0),
+        accessed(0),
+        access_count(0)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    LogRecord::~LogRecord()
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    void LogRecord::clear(void)
+    {
+        type = RECORD_invalid;
+        in_transaction = false;
+        sequence = 0;
+        site_id = 0;
+        entity_id = 0;
+        incarnation = 0;
+        entity_type = dbtype::ENTITYTYPE_invalid;
+        owner = 0;
+        version = 0;
+        name.clear();
+        text.clear();
+        data.clear();
+        accessed = 0;
+        access_count = 0;
+        references.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    void LogRecord::encode(std::string &buffer) const
+    {
+        std::string payload;
+
+        {
+            dbtype::CompactOArchive archive(payload);
+
+            archive << (MG_UnsignedInt) type << in_transaction << sequence
+                    << site_id;
+
+            // Only the fields used by each type are written.
+            //
+            switch (type)
+            {
+                case RECORD_site:
+                {
+                    archive << incarnation << name << text;
+                    break;
+                }
+
+                case RECORD_entity:
+                {
+                    archive << entity_id << incarnation << entity_type
+                            << owner << version << name << text << data;
+                    break;
+                }
+
+                case RECORD_entity_delete:
+                {
+                    archive << entity_id << incarnation;
+                    break;
+                }
+
+                case RECORD_application:
+                {
+                    archive << entity_id << incarnation << name << data;
+                    break;
+                }
+
+                case RECORD_application_delete:
+                {
+                    archive << entity_id << incarnation << name;
+                    break;
+                }
+
+                case RECORD_access:
+                {
+                    archive << entity_id << incarnation
+                            << (MG_VeryLongUnsignedInt) accessed
+                            << access_count;
+                    break;
+                }
+
+                case RECORD_references:
+                {
+                    archive << entity_id << incarnation << references;
+                    break;
+                }
+
+                case RECORD_program_code:
+                {
+                    archive << entity_id << incarnation << data;
+                    break;
+                }
+
+                default:
+                {
+                    // Site delete and commit have nothing extra.
+                    break;
+                }
+            }
+        }
+
+        buffer.clear();
+        buffer.reserve(HEADER_SIZE + payload.size());
+
+        write_uint32(RECORD_MAGIC, buffer);
+        write_uint32((MG_UnsignedInt) payload.size(), buffer);
+        write_uint32(checksum(payload.data(), payload.size()), buffer);
+        buffer.append(payload);
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogRecord::decode_header(
+        const char *header_ptr,
+        size_t &payload_size)
+    {
+        if (read_uint32(header_ptr) != RECORD_MAGIC)
+        {
+            return false;
+        }
+
+        payload_size = read_uint32(header_ptr + 4);
+
+        return payload_size and (payload_size <= MAX_PAYLOAD_SIZE);
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogRecord::decode(const char *data_ptr, const size_t data_size)
+    {
+        size_t payload_size = 0;
+
+        clear();
+
+        if ((data_size < HEADER_SIZE) or
+            (not decode_header(data_ptr, payload_size)) or
+            (data_size != (HEADER_SIZE + payload_size)) or
+            (read_uint32(data_ptr + 8) !=
+                checksum(data_ptr + HEADER_SIZE, payload_size)))
+        {
+            return false;
+        }
+
+        dbtype::CompactIArchive archive(data_ptr + HEADER_SIZE, payload_size);
+        MG_UnsignedInt type_int = RECORD_invalid;
+
+        archive >> type_int >> in_transaction >> sequence >> site_id;
+
+        if ((type_int == RECORD_invalid) or (type_int >= RECORD_END_INVALID))
+        {
+            clear();
+            return false;
+        }
+
+        type = (RecordType) type_int;
+
+        switch (type)
+        {
+            case RECORD_site:
+            {
+                archive >> incarnation >> name >> text;
+                break;
+            }
+
+            case RECORD_entity:
+            {
+                archive >> entity_id >> incarnation >> entity_type
+                        >> owner >> version >> name >> text >> data;
+                break;
+            }
+
+            case RECORD_entity_delete:
+            {
+                archive >> entity_id >> incarnation;
+                break;
+            }
+
+            case RECORD_application:
+            {
+                archive >> entity_id >> incarnation >> name >> data;
+                break;
+            }
+
+            case RECORD_application_delete:
+            {
+                archive >> entity_id >> incarnation >> name;
+                break;
+            }
+
+            case RECORD_access:
+            {
+                MG_VeryLongUnsignedInt accessed_int = 0;
+
+                archive >> entity_id >> incarnation >> accessed_int
+                        >> access_count;
+                accessed = (osinterface::OsTypes::TimeEpochType) accessed_int;
+                break;
+            }
+
+            case RECORD_references:
+            {
+                archive >> entity_id >> incarnation >> references;
+                break;
+            }
+
+            case RECORD_program_code:
+            {
+                archive >> entity_id >> incarnation >> data;
+                break;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+
+        if (not archive.good())
+        {
+            clear();
+            return false;
+        }
+
+        return true;
+    }
+}
+}
@@ -0,0 +1,153 @@
+/*
+ * logstoreinterface_LogRecord.h
+ */
+
+#ifndef MUTGOS_LOGSTOREINTERFACE_LOGRECORD_H
+#define MUTGOS_LOGSTOREINTERFACE_LOGRECORD_H
+
+#include <string>
+#include <stddef.h>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+
+namespace mutgos
+{
+namespace logstoreinterface
+{
+    /**
+     * A single record in a log store segment.  Every change to the
+     * database is written as one record appended to the end of the log;
+     * nothing already written is ever changed.
+     * <p>
+     * On disk, a record is a small fixed header (magic number, payload
+     * size, CRC-32 of the payload) followed by the payload, which is a
+     * compact archive of the fields used by the record type.  The header
+     * lets a recovery scan find the end of the log and detect a record
+     * that was only partly written.
+     * <p>
+     * Every record has a sequence number, increasing across the whole log.
+     * Records copied forward by compaction keep theirs, so the newest
+     * version of anything can always be found no matter which segment it
+     * is in.  Each Entity also has an incarnation, which is the sequence
+     * number of the record that created it; since Entity IDs are reused,
+     * this tells records for a deleted Entity apart from those for a new
+     * Entity with the same ID.
+     * <p>
+     * This is a plain value class and is not thread safe.
+     */
+    class LogRecord
+    {
+    public:
+        /** Sequence numbers and incarnations */
+        typedef MG_VeryLongUnsignedInt SequenceType;
+
+        /** The kinds of records */
+        enum RecordType
+        {
+            RECORD_invalid = 0,  ///< Not a valid record
+            RECORD_site,         ///< A site's name and description
+            RECORD_site_delete,  ///< A site and its Entities were deleted
+            RECORD_entity,       ///< An Entity was created or saved
+            RECORD_entity_delete,///< An Entity was deleted
+            RECORD_application,  ///< An application's properties were saved
+            RECORD_application_delete, ///< An application was removed
+            RECORD_access,       ///< An Entity's access statistics
+            RECORD_references,   ///< Everything an Entity references
+            RECORD_commit,       ///< Commits the transaction before it
+            RECORD_program_code, ///< A Program's compiled code was saved
+            RECORD_END_INVALID   ///< Must always be last
+        };
+
+        /** Result of reading a record */
+        enum ReadResult
+        {
+            READ_ok,       ///< Record was read
+            READ_end,      ///< No more records
+            READ_corrupt   ///< Record is incomplete or damaged
+        };
+
+        /** Size of the header in front of every record, in bytes */
+        static const size_t HEADER_SIZE = 12;
+
+        /**
+         * Constructs an invalid record.
+         */
+        LogRecord(void);
+
+        /**
+         * Destructor.
+         */
+        ~LogRecord();
+
+        /**
+         * Resets the record to be invalid, with all fields cleared.
+         * The capacity of the strings is kept, so the record can be
+         * reused.
+         */
+        void clear(void);
+
+        /**
+         * Encodes the record, including its header.
+         * @param buffer[out] The encoded record.  Any existing contents
+         * are replaced.
+         */
+        void encode(std::string &buffer) const;
+
+        /**
+         * Checks a record header.
+         * @param header_ptr[in] The header, HEADER_SIZE bytes.
+         * @param payload_size[out] The size of the payload following the
+         * header.
+         * @return True if this looks like a valid header.
+         */
+        static bool decode_header(
+            const char *header_ptr,
+            size_t &payload_size);
+
+        /**
+         * Decodes an entire record, including its header.
+         * @param data_ptr[in] The encoded record.
+         * @param data_size[in] The size of the encoded record, in bytes.
+         * @return True if success, false if the record is corrupt.
+         */
+        bool decode(const char *data_ptr, const size_t data_size);
+
+        /**
+         * @return True if the record is a tombstone (records that
+         * something was deleted).
+         */
+        bool is_tombstone(void) const
+          { return (type == RECORD_site_delete) or
+                (type == RECORD_entity_delete) or
+                (type == RECORD_application_delete); }
+
+        /**
+         * @return The ID of the Entity the record is for.
+         */
+        dbtype::Id get_id(void) const
+          { return dbtype::Id(site_id, entity_id); }
+
+        RecordType type; ///< What kind of record this is
+        bool in_transaction; ///< True if written while a transaction was open
+        SequenceType sequence; ///< Sequence number of the record
+        dbtype::Id::SiteIdType site_id; ///< Site the record is for
+        dbtype::Id::EntityIdType entity_id; ///< Entity the record is for, if any
+        SequenceType incarnation; ///< Entity incarnation, or site's cleared sequence
+        dbtype::EntityType entity_type; ///< Type of Entity
+        dbtype::Id::EntityIdType owner; ///< Entity owner, in the same site
+        dbtype::Entity::VersionType version; ///< Entity version
+        std::string name; ///< Entity, site, or application name
+        std::string text; ///< Site description or program registration
+        std::string data; ///< Serialized Entity, application properties, or compiled code
+        osinterface::OsTypes::TimeEpochType accessed; ///< When last accessed
+        dbtype::Entity::AccessCountType access_count; ///< Times accessed
+        dbtype::Entity::IdFieldsMap references; ///< What the Entity references
+    };
+}
+}
+
+#endif //MUTGOS_LOGSTOREINTERFACE_LOGRECORD_H
@@ -0,0 +1,3173 @@
+/*
+ * logstoreinterface_LogStoreBackend.cpp
+ */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "text/text_StringConversion.h"
+#include "utilities/mutgos_config.h"
+
+#include "logstoreinterface_LogStoreBackend.h"
+#include "logstoreinterface_LogRecord.h"
+#include "logstoreinterface_SegmentFile.h"
+
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+#include "dbinterface/dbinterface_EntityRef.h"
+
+#include "concurrency/concurrency_ReaderLockToken.h"
+#include "concurrency/concurrency_WriterLockToken.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_Program.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_TimeStamp.h"
+
+#include "logging/log_Logger.h"
+
+namespace
+{
+    /** How many records the compactor copies at a time while holding the
+        lock */
+    const size_t COMPACT_BATCH_RECORDS = 64;
+
+    /** An Entity ID, with how recently and how often it was accessed */
+    struct AccessedEntity
+    {
+        mutgos::dbtype::Id::EntityIdType entity_id;
+        mutgos::osinterface::OsTypes::TimeEpochType accessed;
+        mutgos::dbtype::Entity::AccessCountType count;
+
+        /** Sorts most recently accessed first, then most accessed */
+        bool operator<(const AccessedEntity &rhs) const
+        {
+            if (accessed != rhs.accessed)
+            {
+                return accessed > rhs.accessed;
+            }
+
+            return count > rhs.count;
+        }
+    };
+}
+
+namespace mutgos
+{
+namespace logstoreinterface
+{
+    /**
+     * The newest record found for everything while scanning the log at
+     * startup.  Which of them are still current is only known once the
+     * whole log has been scanned, since compaction moves records between
+     * segments.
+     */
+    class LogStoreBackend::RecoveryState
+    {
+    public:
+        /** Newest site record */
+        struct SiteCandidate
+        {
+            SiteCandidate(void) : sequence(0), cleared_sequence(0) { }
+
+            LogRecord::SequenceType sequence;
+            LogRecord::SequenceType cleared_sequence;
+            std::string name;
+            std::string description;
+            RecordLocation location;
+        };
+
+        /** Newest Entity record */
+        struct EntityCandidate
+        {
+            EntityCandidate(void)
+              : sequence(0),
+                incarnation(0),
+                type(dbtype::ENTITYTYPE_invalid),
+                owner(0),
+                version(0)
+              { }
+
+            LogRecord::SequenceType sequence;
+            LogRecord::SequenceType incarnation;
+            dbtype::EntityType type;
+            dbtype::Id::EntityIdType owner;
+            dbtype::Entity::VersionType version;
+            std::string name;
+            std::string program_reg_name;
+            RecordLocation location;
+        };
+
+        /** Newest application, access statistics, references, or
+            compiled code record */
+        struct ItemCandidate
+        {
+            ItemCandidate(void)
+              : sequence(0),
+                incarnation(0),
+                removed(false),
+                accessed(0),
+                access_count(0)
+              { }
+
+            LogRecord::SequenceType sequence;
+            LogRecord::SequenceType incarnation;
+            bool removed;
+            osinterface::OsTypes::TimeEpochType accessed;
+            dbtype::Entity::AccessCountType access_count;
+            dbtype::Entity::IdFieldsMap references;
+            RecordLocation location;
+        };
+
+        /** Application of an Entity */
+        typedef std::pair<dbtype::Id, std::string> ApplicationKey;
+
+        RecoveryState(void)
+          : max_site_id(0),
+            max_sequence(0)
+          { }
+
+        std::map<dbtype::Id::SiteIdType, SiteCandidate> sites;
+        std::map<dbtype::Id::SiteIdType, LogRecord::SequenceType> site_deletes;
+        std::map<dbtype::Id, EntityCandidate> entities;
+        std::map<dbtype::Id, LogRecord::SequenceType> entity_deletes;
+        std::map<ApplicationKey, ItemCandidate> applications;
+        std::map<dbtype::Id, ItemCandidate> access;
+        std::map<dbtype::Id, ItemCandidate> references;
+        std::map<dbtype::Id, ItemCandidate> program_code;
+        dbtype::Id::SiteIdType max_site_id;
+        LogRecord::SequenceType max_sequence;
+
+        /** Records of a transaction that has not been committed yet */
+        std::vector<std::pair<LogRecord, RecordLocation> > pending;
+    };
+
+    // ----------------------------------------------------------------------
+    LogStoreBackend::LogStoreBackend(void)
+      : segment_size(0),
+        sync_commits(true),
+        sync_writes(false),
+        transaction_open(false),
+        bulk_load(false),
+        next_sequence(1),
+        next_site_id(1),
+        compactor_stop(false),
+        compactor_thread_ptr(0)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    LogStoreBackend::~LogStoreBackend()
+    {
+        shutdown();
+
+        for (Segments::iterator segment_iter = segments.begin();
+            segment_iter != segments.end();
+            ++segment_iter)
+        {
+            delete segment_iter->second.file_ptr;
+        }
+
+        segments.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::init(void)
+    {
+        const std::string &durability = config::db::durability();
+
+        directory = config::db::logstore_directory();
+        segment_size =
+            ((SegmentFile::Offset) config::db::logstore_segment_size()) * 1024;
+        sync_writes = (durability == "full");
+        sync_commits = (durability != "fast");
+
+        LOG(info, "logstoreinterface", "init",
+            "Opening log store in " + directory);
+
+        bool success = false;
+
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            success = recover();
+
+            if (success)
+            {
+                size_t entity_count = 0;
+
+                for (IndexedSites::const_iterator site_iter = sites.begin();
+                    site_iter != sites.end();
+                    ++site_iter)
+                {
+                    entity_count += site_iter->second.entities.size();
+                }
+
+                LOG(info, "logstoreinterface", "init",
+                    "Log store has " + text::to_string(sites.size())
+                    + " sites and " + text::to_string(entity_count)
+                    + " Entities in " + text::to_string(segments.size())
+                    + " segments.");
+            }
+        }
+
+        if (success)
+        {
+            boost::lock_guard<boost::mutex> guard(compactor_mutex);
+
+            compactor_stop = false;
+            compactor_thread_ptr = new boost::thread(boost::bind(
+                &LogStoreBackend::compactor_thread_main,
+                this));
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::shutdown(void)
+    {
+        LOG(info, "logstoreinterface", "shutdown", "Shutting down...");
+
+        stop_compactor();
+
+        const bool success = not any_mem_owned();
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        if (not sync_active_segment())
+        {
+            LOG(error, "logstoreinterface", "shutdown",
+                "Could not sync the log to disk.");
+        }
+
+        if (success)
+        {
+            for (Segments::iterator segment_iter = segments.begin();
+                segment_iter != segments.end();
+                ++segment_iter)
+            {
+                delete segment_iter->second.file_ptr;
+            }
+
+            segments.clear();
+            sites.clear();
+            reuse_site_ids.clear();
+            next_site_id = 1;
+            deleted_sites.clear();
+            references_from.clear();
+            references_to.clear();
+            next_sequence = 1;
+            transaction_open = false;
+            bulk_load = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string LogStoreBackend::get_backend_name(void)
+    {
+        return "Log store";
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::entity_mem_owned_by_this(
+        const dbtype::Entity *entity_ptr)
+    {
+        return is_mem_owned(entity_ptr);
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::delete_entity_mem(dbtype::Entity *entity_ptr)
+    {
+        if (removed_mem_owned(entity_ptr))
+        {
+            delete entity_ptr;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *LogStoreBackend::new_entity(
+        const dbtype::EntityType type,
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::Id &owner,
+        const std::string &name)
+    {
+        dbtype::Id::EntityIdType entity_id = 0;
+
+        // Do this in an inner scope so we can lock just this section
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            IndexedSites::iterator site_iter = sites.find(site_id);
+
+            if (site_iter == sites.end())
+            {
+                LOG(error, "logstoreinterface", "new_entity",
+                    "Site does not exist: " + text::to_string(site_id));
+                return 0;
+            }
+
+            IndexedSite &site = site_iter->second;
+
+            if (site.reuse_ids.empty())
+            {
+                entity_id = site.next_entity_id++;
+            }
+            else
+            {
+                entity_id = *site.reuse_ids.begin();
+                site.reuse_ids.erase(site.reuse_ids.begin());
+            }
+        }
+
+        // Don't lock ourselves here to avoid recursive locking
+        // due to callbacks elsewhere wanting to call into us (creating new
+        // player with unique name, etc).
+        dbtype::Entity *entity_ptr = make_new_entity(
+            type,
+            dbtype::Id(site_id, entity_id),
+            owner,
+            name);
+
+        if (entity_ptr)
+        {
+            concurrency::WriterLockToken token(*entity_ptr);
+            LogRecord record;
+
+            record.type = LogRecord::RECORD_entity;
+            record.site_id = site_id;
+            record.entity_id = entity_id;
+            record.entity_type = entity_ptr->get_entity_type();
+            record.owner = owner.get_entity_id();
+            record.version = entity_ptr->get_entity_version();
+            record.name = name;
+
+            if (not serialize_entity(entity_ptr, record.data))
+            {
+                LOG(error, "logstoreinterface", "new_entity",
+                    "Could not serialize new Entity.  Aborted.  ID: "
+                    + entity_ptr->get_entity_id().to_string(true));
+
+                delete entity_ptr;
+                entity_ptr = 0;
+            }
+            else
+            {
+                boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+                IndexedSites::iterator site_iter = sites.find(site_id);
+                RecordLocation location;
+
+                // An Entity's incarnation is the sequence number of the
+                // record that created it.
+                record.incarnation = next_sequence;
+
+                if (site_iter == sites.end())
+                {
+                    LOG(error, "logstoreinterface", "new_entity",
+                        "Site was deleted while creating Entity: "
+                        + text::to_string(site_id));
+
+                    delete entity_ptr;
+                    entity_ptr = 0;
+                }
+                else if (not append_record(record, location))
+                {
+                    LOG(error, "logstoreinterface", "new_entity",
+                        "Could not write new Entity.  Aborted.  ID: "
+                        + entity_ptr->get_entity_id().to_string(true));
+
+                    site_iter->second.reuse_ids.insert(entity_id);
+                    delete entity_ptr;
+                    entity_ptr = 0;
+                }
+                else
+                {
+                    IndexedEntity &indexed =
+                        site_iter->second.entities[entity_id];
+
+                    indexed.incarnation = record.incarnation;
+                    indexed.type = record.entity_type;
+                    indexed.owner = record.owner;
+                    indexed.name = name;
+                    indexed.lower_name = text::to_lower_copy(name);
+                    indexed.version = record.version;
+                    update_location(indexed.location, location);
+                    site_iter->second.owned[indexed.owner].insert(entity_id);
+                }
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *LogStoreBackend::get_entity_db(const dbtype::Id &id)
+    {
+        dbtype::Entity *entity_ptr = get_entity_pointer(id);
+
+        if (not entity_ptr)
+        {
+            // Not in memory, deserialize a copy of what was last saved.
+            //
+            entity_ptr = load_entity_copy_db(id);
+
+            if (entity_ptr and (not added_mem_owned(entity_ptr)))
+            {
+                // Another thread loaded it at the same time.  Use theirs.
+                //
+                delete entity_ptr;
+                entity_ptr = get_entity_pointer(id);
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *LogStoreBackend::load_entity_copy_db(const dbtype::Id &id)
+    {
+        dbtype::EntityType type = dbtype::ENTITYTYPE_invalid;
+        std::string encoded;
+        bool has_access_stats = false;
+        dbtype::TimeStamp accessed_timestamp(false);
+        dbtype::Entity::AccessCountType access_count = 0;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            const IndexedEntity * const indexed_ptr =
+                find_indexed_entity(id);
+
+            if ((not indexed_ptr) or
+                (not read_encoded(indexed_ptr->location, encoded)))
+            {
+                return 0;
+            }
+
+            type = indexed_ptr->type;
+            has_access_stats = indexed_ptr->has_access_stats;
+            accessed_timestamp = indexed_ptr->accessed_timestamp;
+            access_count = indexed_ptr->access_count;
+        }
+
+        LogRecord record;
+
+        if (not record.decode(encoded.data(), encoded.size()))
+        {
+            LOG(error, "logstoreinterface", "load_entity_copy_db",
+                "Entity record is corrupt: " + id.to_string(true));
+            return 0;
+        }
+
+        dbtype::Entity * const entity_ptr = make_deserialize_entity(
+            type,
+            record.data.data(),
+            record.data.size());
+
+        if (not entity_ptr)
+        {
+            LOG(error, "logstoreinterface", "load_entity_copy_db",
+                "Could not deserialize: " + id.to_string(true));
+        }
+        else
+        {
+            if (has_access_stats)
+            {
+                entity_ptr->set_entity_accessed_timestamp(
+                    accessed_timestamp);
+                entity_ptr->set_entity_access_count(access_count);
+            }
+
+            dbtype::PropertyEntity * const property_entity_ptr =
+                dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+
+            if (property_entity_ptr)
+            {
+                // Applications are loaded when first used.
+                property_entity_ptr->
+                    set_application_properties_loader(this);
+            }
+
+            dbtype::Program * const program_ptr =
+                dynamic_cast<dbtype::Program *>(entity_ptr);
+
+            if (program_ptr)
+            {
+                // Compiled code is loaded when about to be run.
+                program_ptr->set_program_code_loader(this);
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::entity_exists_db(const dbtype::Id &id)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        return find_indexed_entity(id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::save_entity_db(dbtype::Entity *entity_ptr)
+    {
+        bool success = entity_ptr and is_mem_owned(entity_ptr);
+
+        if (success)
+        {
+            concurrency::WriterLockToken token(*entity_ptr);
+            const dbtype::Id &id = entity_ptr->get_entity_id();
+            LogRecord record;
+            PendingApplications applications;
+            const std::string *code_ptr = 0;
+            bool code_changed = false;
+
+            record.type = LogRecord::RECORD_entity;
+            record.site_id = id.get_site_id();
+            record.entity_id = id.get_entity_id();
+            record.entity_type = entity_ptr->get_entity_type();
+            record.owner =
+                entity_ptr->get_entity_owner(token).get_entity_id();
+            record.version = entity_ptr->get_entity_version();
+            record.name = entity_ptr->get_entity_name(token);
+
+            dbtype::Program * const program_ptr =
+                dynamic_cast<dbtype::Program *>(entity_ptr);
+
+            if (program_ptr)
+            {
+                record.text = program_ptr->get_program_reg_name(token);
+
+                // If the compiled code was never loaded, what's in the
+                // log is already current.
+                //
+                code_changed = program_ptr->get_compiled_code_for_save(
+                    false,
+                    code_ptr,
+                    token);
+            }
+
+            success = serialize_entity(entity_ptr, record.data);
+
+            if (not success)
+            {
+                LOG(error, "logstoreinterface", "save_entity_db",
+                    "Could not serialize entity: " + id.to_string(true));
+            }
+            else
+            {
+                dbtype::PropertyEntity * const property_entity_ptr =
+                    dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+
+                if (property_entity_ptr and
+                    (not serialize_applications(
+                        property_entity_ptr,
+                        token,
+                        applications)))
+                {
+                    success = false;
+                }
+
+                boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+                IndexedSites::iterator site_iter =
+                    sites.find(id.get_site_id());
+                IndexedEntities::iterator entity_iter;
+
+                if (site_iter != sites.end())
+                {
+                    entity_iter =
+                        site_iter->second.entities.find(id.get_entity_id());
+                }
+
+                if ((site_iter == sites.end()) or
+                    (entity_iter == site_iter->second.entities.end()))
+                {
+                    LOG(error, "logstoreinterface", "save_entity_db",
+                        "Entity is not in the database: "
+                        + id.to_string(true));
+                    success = false;
+                }
+                else
+                {
+                    IndexedSite &site = site_iter->second;
+                    IndexedEntity &indexed = entity_iter->second;
+                    const std::string lower_reg_name =
+                        text::to_lower_copy(record.text);
+
+                    if (not record.text.empty())
+                    {
+                        const ProgramRegistrations::const_iterator reg_iter =
+                            site.program_regs.find(lower_reg_name);
+
+                        if ((reg_iter != site.program_regs.end()) and
+                            (reg_iter->second != id.get_entity_id()))
+                        {
+                            LOG(error, "logstoreinterface", "save_entity_db",
+                                "Program registration name already in use: "
+                                + record.text);
+                            success = false;
+                        }
+                    }
+
+                    // Nothing is written unless all of it can be, so the
+                    // Entity stays dirty.
+                    //
+                    if (success)
+                    {
+                        RecordLocation location;
+
+                        record.incarnation = indexed.incarnation;
+
+                        if (not append_record(record, location))
+                        {
+                            LOG(error, "logstoreinterface", "save_entity_db",
+                                "Could not write Entity: "
+                                + id.to_string(true));
+                            success = false;
+                        }
+                        else
+                        {
+                            if (record.owner != indexed.owner)
+                            {
+                                delete_owned(
+                                    site,
+                                    indexed.owner,
+                                    id.get_entity_id());
+                                site.owned[record.owner].insert(
+                                    id.get_entity_id());
+                                indexed.owner = record.owner;
+                            }
+
+                            indexed.name = record.name;
+                            indexed.lower_name =
+                                text::to_lower_copy(record.name);
+                            indexed.version = record.version;
+                            update_location(indexed.location, location);
+
+                            delete_program_reg(site, indexed);
+
+                            if (not record.text.empty())
+                            {
+                                site.program_regs[lower_reg_name] =
+                                    id.get_entity_id();
+                                indexed.program_reg_name = record.text;
+                            }
+
+                            // Now the applications that changed.
+                            //
+                            for (PendingApplications::iterator app_iter =
+                                    applications.begin();
+                                app_iter != applications.end();
+                                ++app_iter)
+                            {
+                                LogRecord app_record;
+
+                                app_record.type = app_iter->removed ?
+                                    LogRecord::RECORD_application_delete :
+                                    LogRecord::RECORD_application;
+                                app_record.site_id = record.site_id;
+                                app_record.entity_id = record.entity_id;
+                                app_record.incarnation = indexed.incarnation;
+                                app_record.name = app_iter->name;
+                                app_record.data.swap(app_iter->data);
+
+                                if (not append_record(app_record, location))
+                                {
+                                    LOG(error, "logstoreinterface",
+                                        "save_entity_db",
+                                        "Could not write application "
+                                        + app_iter->name + " for Entity "
+                                        + id.to_string(true));
+                                    success = false;
+                                }
+                                else if (app_iter->removed)
+                                {
+                                    const IndexedApplications::iterator
+                                        indexed_app_iter =
+                                            indexed.applications.find(
+                                                app_iter->name);
+
+                                    if (indexed_app_iter !=
+                                        indexed.applications.end())
+                                    {
+                                        update_location(
+                                            indexed_app_iter->second,
+                                            RecordLocation());
+                                        indexed.applications.erase(
+                                            indexed_app_iter);
+                                    }
+                                }
+                                else
+                                {
+                                    update_location(
+                                        indexed.applications[app_iter->name],
+                                        location);
+                                }
+                            }
+
+                            // And the compiled code, if it changed.  Empty
+                            // code means it was removed.
+                            //
+                            if (code_changed)
+                            {
+                                LogRecord code_record;
+
+                                code_record.type =
+                                    LogRecord::RECORD_program_code;
+                                code_record.site_id = record.site_id;
+                                code_record.entity_id = record.entity_id;
+                                code_record.incarnation = indexed.incarnation;
+                                code_record.data = *code_ptr;
+
+                                if (not append_record(code_record, location))
+                                {
+                                    LOG(error, "logstoreinterface",
+                                        "save_entity_db",
+                                        "Could not write compiled code for "
+                                        "Program " + id.to_string(true));
+                                    success = false;
+                                }
+                                else
+                                {
+                                    update_location(
+                                        indexed.code_location,
+                                        location);
+                                }
+                            }
+
+                            if (success)
+                            {
+                                // Only once every record was written, or the
+                                // retry would have nothing left to write.
+                                //
+                                entity_ptr->clear_dirty(token);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::begin_transaction_db(void)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        if (transaction_open)
+        {
+            LOG(error, "logstoreinterface", "begin_transaction_db",
+                "A transaction is already open.");
+            return false;
+        }
+
+        transaction_open = true;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::commit_transaction_db(void)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        if (not transaction_open)
+        {
+            LOG(error, "logstoreinterface", "commit_transaction_db",
+                "No transaction is open.");
+            return false;
+        }
+
+        LogRecord record;
+        RecordLocation location;
+
+        record.type = LogRecord::RECORD_commit;
+
+        bool success = append_record(record, location);
+
+        transaction_open = false;
+
+        if (not success)
+        {
+            LOG(error, "logstoreinterface", "commit_transaction_db",
+                "Could not write commit.  Changes made during the transaction "
+                "will be lost when the server restarts.");
+        }
+        else if (sync_commits and (not bulk_load))
+        {
+            success = sync_active_segment();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::begin_bulk_load_db(void)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        if (bulk_load)
+        {
+            LOG(error, "logstoreinterface", "begin_bulk_load_db",
+                "A bulk load is already in progress.");
+            return false;
+        }
+
+        bulk_load = true;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::end_bulk_load_db(void)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        if (not bulk_load)
+        {
+            LOG(error, "logstoreinterface", "end_bulk_load_db",
+                "No bulk load is in progress.");
+            return false;
+        }
+
+        bulk_load = false;
+        return sync_active_segment();
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::delete_entity_db(const dbtype::Id &id)
+    {
+        // Confirm not still in memory
+        bool success = not is_mem_owned(id);
+
+        if (success and (not id.is_default()))
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            const IndexedSites::iterator site_iter =
+                sites.find(id.get_site_id());
+            IndexedEntities::iterator entity_iter;
+
+            if (site_iter != sites.end())
+            {
+                entity_iter =
+                    site_iter->second.entities.find(id.get_entity_id());
+            }
+
+            if ((site_iter != sites.end()) and
+                (entity_iter != site_iter->second.entities.end()))
+            {
+                IndexedSite &site = site_iter->second;
+                LogRecord record;
+                RecordLocation location;
+
+                record.type = LogRecord::RECORD_entity_delete;
+                record.site_id = id.get_site_id();
+                record.entity_id = id.get_entity_id();
+                record.incarnation = entity_iter->second.incarnation;
+
+                if (not append_record(record, location))
+                {
+                    LOG(error, "logstoreinterface", "delete_entity_db",
+                        "Could not write delete of Entity: "
+                        + id.to_string(true));
+                    success = false;
+                }
+                else
+                {
+                    // Everything written for it is now garbage, including
+                    // its program registration.
+                    forget_entity(site, entity_iter);
+
+                    // Add ID for future reuse
+                    site.reuse_ids.insert(id.get_entity_id());
+
+                    // Delete anything referencing it or referenced by it.
+                    delete_entity_references(id, 0);
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::EntityType LogStoreBackend::get_entity_type_db(
+        const dbtype::Id &id)
+    {
+        const dbtype::EntityType mem_type = get_entity_type_mem(id);
+
+        if (mem_type != dbtype::ENTITYTYPE_invalid)
+        {
+            // In our cache of Entities in use.  Return the type.
+            return mem_type;
+        }
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedEntity * const indexed_ptr = find_indexed_entity(id);
+
+        return indexed_ptr ? indexed_ptr->type : dbtype::ENTITYTYPE_invalid;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::save_access_stats_db(const AccessStatsMap &stats)
+    {
+        bool success = true;
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        for (AccessStatsMap::const_iterator stats_iter = stats.begin();
+            stats_iter != stats.end();
+            ++stats_iter)
+        {
+            IndexedEntity * const indexed_ptr =
+                find_indexed_entity(stats_iter->first);
+
+            if (indexed_ptr)
+            {
+                LogRecord record;
+                RecordLocation location;
+
+                record.type = LogRecord::RECORD_access;
+                record.site_id = stats_iter->first.get_site_id();
+                record.entity_id = stats_iter->first.get_entity_id();
+                record.incarnation = indexed_ptr->incarnation;
+                record.accessed = stats_iter->second.first.get_time();
+                record.access_count = stats_iter->second.second;
+
+                if (not append_record(record, location))
+                {
+                    LOG(error, "logstoreinterface", "save_access_stats_db",
+                        "Could not write access statistics for Entity "
+                        + stats_iter->first.to_string(true));
+                    success = false;
+                }
+                else
+                {
+                    indexed_ptr->has_access_stats = true;
+                    indexed_ptr->accessed_timestamp = stats_iter->second.first;
+                    indexed_ptr->access_count = stats_iter->second.second;
+                    update_location(indexed_ptr->access_location, location);
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::update_references_db(
+        const dbtype::Id &source_id,
+        const dbtype::Entity::ChangedIdFieldsMap &changed_fields)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        for (dbtype::Entity::ChangedIdFieldsMap::const_iterator field_iter =
+                changed_fields.begin();
+            field_iter != changed_fields.end();
+            ++field_iter)
+        {
+            // Removals first, then additions.
+            //
+            for (dbtype::Entity::IdSet::const_iterator removed_iter =
+                    field_iter->second.first.begin();
+                removed_iter != field_iter->second.first.end();
+                ++removed_iter)
+            {
+                remove_reference(
+                    references_from,
+                    source_id,
+                    *removed_iter,
+                    field_iter->first);
+                remove_reference(
+                    references_to,
+                    *removed_iter,
+                    source_id,
+                    field_iter->first);
+            }
+
+            for (dbtype::Entity::IdSet::const_iterator added_iter =
+                    field_iter->second.second.begin();
+                added_iter != field_iter->second.second.end();
+                ++added_iter)
+            {
+                references_from[source_id][*added_iter].insert(
+                    field_iter->first);
+                references_to[*added_iter][source_id].insert(
+                    field_iter->first);
+            }
+        }
+
+        // Everything the source references is written out each time, so
+        // only the newest record is ever needed.
+        //
+        return write_references(source_id);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector LogStoreBackend::get_references_to_db(
+        const dbtype::Id &target_id,
+        const dbtype::EntityField field)
+    {
+        dbtype::Entity::IdVector result;
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const ReferenceIndex::const_iterator target_iter =
+            references_to.find(target_id);
+
+        if (target_iter != references_to.end())
+        {
+            for (dbtype::Entity::IdFieldsMap::const_iterator source_iter =
+                    target_iter->second.begin();
+                source_iter != target_iter->second.end();
+                ++source_iter)
+            {
+                if (source_iter->second.count(field))
+                {
+                    result.push_back(source_iter->first);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdFieldsMap LogStoreBackend::get_references_from_db(
+        const dbtype::Id &source_id)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const ReferenceIndex::const_iterator source_iter =
+            references_from.find(source_id);
+
+        if (source_iter == references_from.end())
+        {
+            return dbtype::Entity::IdFieldsMap();
+        }
+
+        return source_iter->second;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector LogStoreBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::EntityType type,
+        const dbtype::Id::EntityIdType owner_id,
+        const std::string &name,
+        const bool exact)
+    {
+        dbtype::Entity::IdVector result;
+
+        if (not site_id)
+        {
+            LOG(error, "logstoreinterface", "find_in_db()",
+                "Site was not specified; cannot search");
+            return result;
+        }
+
+        if ((type == dbtype::ENTITYTYPE_invalid) and (not owner_id) and
+            name.empty())
+        {
+            LOG(error, "logstoreinterface", "find_in_db()",
+                "Bad combination of parameters given; cannot search");
+            return result;
+        }
+
+        // Like the SQLite backend, exact matches are only done when
+        // searching by type.
+        //
+        const std::string lower_name = text::to_lower_copy(name);
+        const bool match_exact =
+            exact and (type != dbtype::ENTITYTYPE_invalid);
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return result;
+        }
+
+        const IndexedSite &site = site_iter->second;
+
+        if (owner_id)
+        {
+            // Only need to look at what the owner owns.
+            //
+            const OwnerIndex::const_iterator owned_iter =
+                site.owned.find(owner_id);
+
+            if (owned_iter != site.owned.end())
+            {
+                for (std::set<dbtype::Id::EntityIdType>::const_iterator
+                        id_iter = owned_iter->second.begin();
+                    id_iter != owned_iter->second.end();
+                    ++id_iter)
+                {
+                    const IndexedEntities::const_iterator entity_iter =
+                        site.entities.find(*id_iter);
+
+                    if ((entity_iter != site.entities.end()) and
+                        search_matches(
+                            entity_iter->second,
+                            type,
+                            lower_name,
+                            match_exact))
+                    {
+                        result.push_back(dbtype::Id(site_id, *id_iter));
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (IndexedEntities::const_iterator entity_iter =
+                    site.entities.begin();
+                entity_iter != site.entities.end();
+                ++entity_iter)
+            {
+                if (search_matches(
+                    entity_iter->second,
+                    type,
+                    lower_name,
+                    match_exact))
+                {
+                    result.push_back(dbtype::Id(site_id, entity_iter->first));
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector LogStoreBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        dbtype::Entity::IdVector result;
+
+        if (not site_id)
+        {
+            LOG(error, "logstoreinterface", "find_in_db(site)",
+                "Site was not specified; cannot search");
+            return result;
+        }
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter != sites.end())
+        {
+            result.reserve(site_iter->second.entities.size());
+
+            for (IndexedEntities::const_iterator entity_iter =
+                    site_iter->second.entities.begin();
+                entity_iter != site_iter->second.entities.end();
+                ++entity_iter)
+            {
+                result.push_back(dbtype::Id(site_id, entity_iter->first));
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector LogStoreBackend::get_recently_accessed_db(
+        const dbtype::Id::SiteIdType site_id,
+        const size_t max_entities)
+    {
+        dbtype::Entity::IdVector result;
+        std::vector<AccessedEntity> accessed;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            const IndexedSites::const_iterator site_iter =
+                sites.find(site_id);
+
+            if (site_iter == sites.end())
+            {
+                return result;
+            }
+
+            for (IndexedEntities::const_iterator entity_iter =
+                    site_iter->second.entities.begin();
+                entity_iter != site_iter->second.entities.end();
+                ++entity_iter)
+            {
+                if (entity_iter->second.has_access_stats)
+                {
+                    AccessedEntity entry;
+
+                    entry.entity_id = entity_iter->first;
+                    entry.accessed =
+                        entity_iter->second.accessed_timestamp.get_time();
+                    entry.count = entity_iter->second.access_count;
+
+                    accessed.push_back(entry);
+                }
+            }
+        }
+
+        const size_t count = std::min(max_entities, accessed.size());
+
+        std::partial_sort(
+            accessed.begin(),
+            accessed.begin() + count,
+            accessed.end());
+
+        result.reserve(count);
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            result.push_back(dbtype::Id(site_id, accessed[index].entity_id));
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id LogStoreBackend::find_program_reg_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &registration_name)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter != sites.end())
+        {
+            const ProgramRegistrations::const_iterator reg_iter =
+                site_iter->second.program_regs.find(
+                    text::to_lower_copy(registration_name));
+
+            if (reg_iter != site_iter->second.program_regs.end())
+            {
+                return dbtype::Id(site_id, reg_iter->second);
+            }
+        }
+
+        return dbtype::Id();
+    }
+
+    // ----------------------------------------------------------------------
+    std::string LogStoreBackend::find_program_reg_name_in_db(
+        const dbtype::Id &id)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedEntity * const indexed_ptr = find_indexed_entity(id);
+
+        return indexed_ptr ? indexed_ptr->program_reg_name : std::string();
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id::SiteIdVector LogStoreBackend::get_site_ids_in_db(void)
+    {
+        dbtype::Id::SiteIdVector result;
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        result.reserve(sites.size());
+
+        for (IndexedSites::const_iterator site_iter = sites.begin();
+            site_iter != sites.end();
+            ++site_iter)
+        {
+            result.push_back(site_iter->first);
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::EntityMetadata LogStoreBackend::get_entity_metadata(
+        const dbtype::Id &id)
+    {
+        dbinterface::EntityMetadata result;
+
+        // See if in memory;  If so, use that version instead
+        if (is_mem_owned(id))
+        {
+            get_metadata_in_mem(id, result);
+        }
+        else
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+            get_metadata_internal(id, result);
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::MetadataVector LogStoreBackend::get_entity_metadata(
+        const dbtype::Entity::IdVector &ids)
+    {
+        dbinterface::MetadataVector result;
+        std::vector<const dbtype::Id *> not_in_mem;
+
+        result.reserve(ids.size());
+        not_in_mem.reserve(ids.size());
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            if (is_mem_owned(*id_iter))
+            {
+                result.push_back(dbinterface::EntityMetadata());
+                get_metadata_in_mem(*id_iter, result.back());
+
+                if (not result.back().valid())
+                {
+                    result.pop_back();
+                }
+            }
+            else
+            {
+                not_in_mem.push_back(&(*id_iter));
+            }
+        }
+
+        if (not not_in_mem.empty())
+        {
+            // Do them all at once under the same lock.
+            //
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            for (std::vector<const dbtype::Id *>::const_iterator id_ptr_iter =
+                    not_in_mem.begin();
+                id_ptr_iter != not_in_mem.end();
+                ++id_ptr_iter)
+            {
+                result.push_back(dbinterface::EntityMetadata());
+                get_metadata_internal(**id_ptr_iter, result.back());
+
+                if (not result.back().valid())
+                {
+                    result.pop_back();
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::new_site_in_db(dbtype::Id::SiteIdType &site_id)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        // Reuse a deleted site if possible, otherwise get a new one.
+        //
+        if (reuse_site_ids.empty())
+        {
+            site_id = next_site_id++;
+        }
+        else
+        {
+            site_id = *reuse_site_ids.begin();
+            reuse_site_ids.erase(reuse_site_ids.begin());
+        }
+
+        IndexedSite &site = sites[site_id];
+        const std::map<dbtype::Id::SiteIdType, LogRecord::SequenceType>::
+            iterator deleted_iter = deleted_sites.find(site_id);
+
+        site.name = "Untitled Site " + text::to_string(site_id);
+
+        // Records from when this site ID was last used must stay deleted.
+        //
+        if (deleted_iter != deleted_sites.end())
+        {
+            site.cleared_sequence = deleted_iter->second;
+        }
+
+        if (not write_site(site_id, site))
+        {
+            LOG(error, "logstoreinterface", "new_site_in_db",
+                "Could not write new site " + text::to_string(site_id));
+
+            sites.erase(site_id);
+            reuse_site_ids.insert(site_id);
+            return false;
+        }
+
+        if (deleted_iter != deleted_sites.end())
+        {
+            deleted_sites.erase(deleted_iter);
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::delete_site_in_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        const IndexedSites::iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return false;
+        }
+
+        IndexedSite &site = site_iter->second;
+        LogRecord record;
+        RecordLocation location;
+
+        record.type = LogRecord::RECORD_site_delete;
+        record.site_id = site_id;
+
+        if (not append_record(record, location))
+        {
+            LOG(error, "logstoreinterface", "delete_site_in_db",
+                "Could not write delete of site " + text::to_string(site_id));
+            return false;
+        }
+
+        // Delete anything referencing the site's Entities or referenced
+        // by them, and then the Entities themselves.
+        //
+        std::set<dbtype::Id> changed_sources;
+
+        for (IndexedEntities::const_iterator entity_iter =
+                site.entities.begin();
+            entity_iter != site.entities.end();
+            ++entity_iter)
+        {
+            delete_entity_references(
+                dbtype::Id(site_id, entity_iter->first),
+                &changed_sources);
+        }
+
+        while (not site.entities.empty())
+        {
+            forget_entity(site, site.entities.begin());
+        }
+
+        update_location(site.location, RecordLocation());
+        sites.erase(site_iter);
+        reuse_site_ids.insert(site_id);
+        deleted_sites[site_id] = record.sequence;
+
+        // Entities in other sites that referenced this one need their
+        // references written out again.  Those in this site are gone and
+        // are skipped.
+        //
+        for (std::set<dbtype::Id>::const_iterator source_iter =
+                changed_sources.begin();
+            source_iter != changed_sources.end();
+            ++source_iter)
+        {
+            write_references(*source_iter);
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::get_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_name)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            site_name.clear();
+            return false;
+        }
+
+        site_name = site_iter->second.name;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::set_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_name)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        const IndexedSites::iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return false;
+        }
+
+        const std::string old_name = site_iter->second.name;
+
+        site_iter->second.name = site_name;
+
+        if (not write_site(site_id, site_iter->second))
+        {
+            site_iter->second.name = old_name;
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::get_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_description)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const IndexedSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            site_description.clear();
+            return false;
+        }
+
+        site_description = site_iter->second.description;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::set_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_description)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        const IndexedSites::iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return false;
+        }
+
+        const std::string old_description = site_iter->second.description;
+
+        site_iter->second.description = site_description;
+
+        if (not write_site(site_id, site_iter->second))
+        {
+            site_iter->second.description = old_description;
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::load_application_properties(
+        const dbtype::Id &entity_id,
+        const std::string &application,
+        dbtype::ApplicationProperties &properties)
+    {
+        std::string encoded;
+        bool found = false;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            const IndexedEntity * const indexed_ptr =
+                find_indexed_entity(entity_id);
+
+            if (indexed_ptr)
+            {
+                const IndexedApplications::const_iterator app_iter =
+                    indexed_ptr->applications.find(application);
+
+                found = (app_iter != indexed_ptr->applications.end()) and
+                    read_encoded(app_iter->second, encoded);
+            }
+        }
+
+        if (found)
+        {
+            LogRecord record;
+
+            if (record.decode(encoded.data(), encoded.size()))
+            {
+                return deserialize_application_properties(
+                    record.data.data(),
+                    record.data.size(),
+                    properties);
+            }
+        }
+
+        LOG(error, "logstoreinterface", "load_application_properties",
+            "Application " + application + " not found for Entity "
+            + entity_id.to_string(true));
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::load_compiled_code(
+        const dbtype::Id &program_id,
+        std::string &compiled_code)
+    {
+        std::string encoded;
+        bool found = false;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            const IndexedEntity * const indexed_ptr =
+                find_indexed_entity(program_id);
+
+            found = indexed_ptr and indexed_ptr->code_location.valid() and
+                read_encoded(indexed_ptr->code_location, encoded);
+        }
+
+        if (found)
+        {
+            LogRecord record;
+
+            if (record.decode(encoded.data(), encoded.size()))
+            {
+                compiled_code.swap(record.data);
+                return true;
+            }
+        }
+
+        LOG(error, "logstoreinterface", "load_compiled_code",
+            "Compiled code not found for Program "
+            + program_id.to_string(true));
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::recover(void)
+    {
+        boost::system::error_code fs_error;
+
+        boost::filesystem::create_directories(directory, fs_error);
+
+        if (fs_error)
+        {
+            LOG(fatal, "logstoreinterface", "recover",
+                "Could not create directory " + directory + ": "
+                + fs_error.message());
+            return false;
+        }
+
+        // Find all the segments.  They are scanned oldest first.
+        //
+        boost::filesystem::directory_iterator dir_iter(directory, fs_error);
+        const boost::filesystem::directory_iterator dir_end;
+        std::set<SegmentFile::SegmentNumber> numbers;
+
+        while ((not fs_error) and (dir_iter != dir_end))
+        {
+            SegmentFile::SegmentNumber number = 0;
+
+            if (SegmentFile::parse_file_name(
+                dir_iter->path().filename().string(),
+                number))
+            {
+                numbers.insert(number);
+            }
+
+            dir_iter.increment(fs_error);
+        }
+
+        if (fs_error)
+        {
+            LOG(fatal, "logstoreinterface", "recover",
+                "Could not list directory " + directory + ": "
+                + fs_error.message());
+            return false;
+        }
+
+        for (std::set<SegmentFile::SegmentNumber>::const_iterator number_iter =
+                numbers.begin();
+            number_iter != numbers.end();
+            ++number_iter)
+        {
+            SegmentFile * const file_ptr =
+                new SegmentFile(directory, *number_iter);
+
+            if (not file_ptr->open())
+            {
+                delete file_ptr;
+                return false;
+            }
+
+            segments[*number_iter].file_ptr = file_ptr;
+        }
+
+        // Scan every record.
+        //
+        RecoveryState state;
+        std::string buffer;
+        LogRecord record;
+
+        for (Segments::iterator segment_iter = segments.begin();
+            segment_iter != segments.end();
+            ++segment_iter)
+        {
+            SegmentFile * const file_ptr = segment_iter->second.file_ptr;
+            RecordLocation location;
+            size_t record_size = 0;
+            LogRecord::ReadResult result = LogRecord::READ_ok;
+
+            location.segment = segment_iter->first;
+
+            while ((result = file_ptr->read_next(
+                location.offset,
+                buffer,
+                record,
+                record_size)) == LogRecord::READ_ok)
+            {
+                location.size = record_size;
+
+                if (record.sequence > state.max_sequence)
+                {
+                    state.max_sequence = record.sequence;
+                }
+
+                if (record.type == LogRecord::RECORD_commit)
+                {
+                    for (size_t index = 0; index < state.pending.size();
+                         ++index)
+                    {
+                        recover_record(
+                            state.pending[index].first,
+                            state.pending[index].second,
+                            state);
+                    }
+
+                    state.pending.clear();
+                }
+                else if (record.in_transaction)
+                {
+                    state.pending.push_back(std::make_pair(record, location));
+                }
+                else
+                {
+                    if (not state.pending.empty())
+                    {
+                        // The commit for these was never written.  They
+                        // are remembered so compaction does not copy
+                        // them.
+                        LOG(warning, "logstoreinterface", "recover",
+                            "Ignoring " + text::to_string(state.pending.size())
+                            + " records of a transaction that was not "
+                              "committed.");
+
+                        for (size_t index = 0; index < state.pending.size();
+                             ++index)
+                        {
+                            uncommitted_sequences.insert(
+                                state.pending[index].first.sequence);
+                        }
+
+                        state.pending.clear();
+                    }
+
+                    recover_record(record, location, state);
+                }
+
+                location.offset += record_size;
+            }
+
+            if (result == LogRecord::READ_corrupt)
+            {
+                if (segment_iter->first == segments.rbegin()->first)
+                {
+                    // Most likely the server stopped while writing it.
+                    LOG(warning, "logstoreinterface", "recover",
+                        "Discarding incomplete record at the end of "
+                        + file_ptr->get_path() + ", offset "
+                        + text::to_string(location.offset));
+
+                    if (not file_ptr->truncate(location.offset))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    LOG(error, "logstoreinterface", "recover",
+                        "Corrupt record in " + file_ptr->get_path()
+                        + " at offset " + text::to_string(location.offset)
+                        + "; the rest of the segment is ignored.");
+                }
+            }
+        }
+
+        // A transaction still open at the end of the log was never
+        // committed.  Cut it off so nothing is appended after it.
+        //
+        if (not state.pending.empty())
+        {
+            const RecordLocation first = state.pending.front().second;
+
+            LOG(warning, "logstoreinterface", "recover",
+                "Discarding " + text::to_string(state.pending.size())
+                + " records of a transaction that was not committed.");
+
+            while (segments.rbegin()->first > first.segment)
+            {
+                Segments::iterator last_iter = --segments.end();
+
+                last_iter->second.file_ptr->remove();
+                delete last_iter->second.file_ptr;
+                segments.erase(last_iter);
+            }
+
+            if (not segments.rbegin()->second.file_ptr->truncate(
+                first.offset))
+            {
+                return false;
+            }
+
+            state.pending.clear();
+        }
+
+        build_index(state);
+        next_sequence = state.max_sequence + 1;
+
+        if (segments.empty())
+        {
+            return start_segment();
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::recover_record(
+        const LogRecord &record,
+        const RecordLocation &location,
+        RecoveryState &state)
+    {
+        if (record.site_id > state.max_site_id)
+        {
+            state.max_site_id = record.site_id;
+        }
+
+        switch (record.type)
+        {
+            case LogRecord::RECORD_site:
+            {
+                RecoveryState::SiteCandidate &candidate =
+                    state.sites[record.site_id];
+
+                if (record.sequence > candidate.sequence)
+                {
+                    candidate.sequence = record.sequence;
+                    candidate.cleared_sequence = record.incarnation;
+                    candidate.name = record.name;
+                    candidate.description = record.text;
+                    candidate.location = location;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_site_delete:
+            {
+                LogRecord::SequenceType &deleted =
+                    state.site_deletes[record.site_id];
+
+                deleted = std::max(deleted, record.sequence);
+                break;
+            }
+
+            case LogRecord::RECORD_entity:
+            {
+                RecoveryState::EntityCandidate &candidate =
+                    state.entities[record.get_id()];
+
+                if (record.sequence > candidate.sequence)
+                {
+                    candidate.sequence = record.sequence;
+                    candidate.incarnation = record.incarnation;
+                    candidate.type = record.entity_type;
+                    candidate.owner = record.owner;
+                    candidate.version = record.version;
+                    candidate.name = record.name;
+                    candidate.program_reg_name = record.text;
+                    candidate.location = location;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_entity_delete:
+            {
+                LogRecord::SequenceType &deleted =
+                    state.entity_deletes[record.get_id()];
+
+                deleted = std::max(deleted, record.incarnation);
+                break;
+            }
+
+            case LogRecord::RECORD_application:
+            case LogRecord::RECORD_application_delete:
+            {
+                RecoveryState::ItemCandidate &candidate =
+                    state.applications[std::make_pair(
+                        record.get_id(),
+                        record.name)];
+
+                if (record.sequence > candidate.sequence)
+                {
+                    candidate.sequence = record.sequence;
+                    candidate.incarnation = record.incarnation;
+                    candidate.removed =
+                        (record.type == LogRecord::RECORD_application_delete);
+                    candidate.location = location;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_access:
+            {
+                RecoveryState::ItemCandidate &candidate =
+                    state.access[record.get_id()];
+
+                if (record.sequence > candidate.sequence)
+                {
+                    candidate.sequence = record.sequence;
+                    candidate.incarnation = record.incarnation;
+                    candidate.accessed = record.accessed;
+                    candidate.access_count = record.access_count;
+                    candidate.location = location;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_references:
+            {
+                RecoveryState::ItemCandidate &candidate =
+                    state.references[record.get_id()];
+
+                if (record.sequence > candidate.sequence)
+                {
+                    candidate.sequence = record.sequence;
+                    candidate.incarnation = record.incarnation;
+                    candidate.references = record.references;
+                    candidate.location = location;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_program_code:
+            {
+                RecoveryState::ItemCandidate &candidate =
+                    state.program_code[record.get_id()];
+
+                if (record.sequence > candidate.sequence)
+                {
+                    candidate.sequence = record.sequence;
+                    candidate.incarnation = record.incarnation;
+                    candidate.location = location;
+                }
+
+                break;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::build_index(const RecoveryState &state)
+    {
+        // Sites that were not deleted after they were last written.
+        //
+        for (std::map<dbtype::Id::SiteIdType,
+                RecoveryState::SiteCandidate>::const_iterator candidate_iter =
+                    state.sites.begin();
+            candidate_iter != state.sites.end();
+            ++candidate_iter)
+        {
+            const RecoveryState::SiteCandidate &candidate =
+                candidate_iter->second;
+            const std::map<dbtype::Id::SiteIdType, LogRecord::SequenceType>::
+                const_iterator deleted_iter =
+                    state.site_deletes.find(candidate_iter->first);
+            LogRecord::SequenceType cleared_sequence =
+                candidate.cleared_sequence;
+
+            if (deleted_iter != state.site_deletes.end())
+            {
+                if (deleted_iter->second > candidate.sequence)
+                {
+                    continue;
+                }
+
+                cleared_sequence =
+                    std::max(cleared_sequence, deleted_iter->second);
+            }
+
+            IndexedSite &site = sites[candidate_iter->first];
+
+            site.name = candidate.name;
+            site.description = candidate.description;
+            site.cleared_sequence = cleared_sequence;
+            update_location(site.location, candidate.location);
+        }
+
+        for (std::map<dbtype::Id::SiteIdType, LogRecord::SequenceType>::
+                const_iterator deleted_iter = state.site_deletes.begin();
+            deleted_iter != state.site_deletes.end();
+            ++deleted_iter)
+        {
+            if (not sites.count(deleted_iter->first))
+            {
+                deleted_sites[deleted_iter->first] = deleted_iter->second;
+            }
+        }
+
+        next_site_id = state.max_site_id + 1;
+
+        for (dbtype::Id::SiteIdType site_id = 1;
+             site_id < next_site_id;
+             ++site_id)
+        {
+            if (not sites.count(site_id))
+            {
+                reuse_site_ids.insert(site_id);
+            }
+        }
+
+        // Entities created after their site ID was last cleared, and not
+        // deleted since.
+        //
+        for (std::map<dbtype::Id, RecoveryState::EntityCandidate>::
+                const_iterator candidate_iter = state.entities.begin();
+            candidate_iter != state.entities.end();
+            ++candidate_iter)
+        {
+            const dbtype::Id &id = candidate_iter->first;
+            const RecoveryState::EntityCandidate &candidate =
+                candidate_iter->second;
+            const IndexedSites::iterator site_iter =
+                sites.find(id.get_site_id());
+
+            if ((site_iter == sites.end()) or
+                (candidate.incarnation <= site_iter->second.cleared_sequence))
+            {
+                continue;
+            }
+
+            const std::map<dbtype::Id, LogRecord::SequenceType>::
+                const_iterator deleted_iter = state.entity_deletes.find(id);
+
+            if ((deleted_iter != state.entity_deletes.end()) and
+                (candidate.incarnation <= deleted_iter->second))
+            {
+                continue;
+            }
+
+            IndexedSite &site = site_iter->second;
+            IndexedEntity &indexed = site.entities[id.get_entity_id()];
+
+            indexed.incarnation = candidate.incarnation;
+            indexed.type = candidate.type;
+            indexed.owner = candidate.owner;
+            indexed.name = candidate.name;
+            indexed.lower_name = text::to_lower_copy(candidate.name);
+            indexed.version = candidate.version;
+            update_location(indexed.location, candidate.location);
+            site.owned[indexed.owner].insert(id.get_entity_id());
+
+            if (not candidate.program_reg_name.empty())
+            {
+                indexed.program_reg_name = candidate.program_reg_name;
+                site.program_regs[text::to_lower_copy(
+                    candidate.program_reg_name)] = id.get_entity_id();
+            }
+        }
+
+        // Everything else only counts if it belongs to the Entity as it
+        // is now, and not an earlier one with the same ID.
+        //
+        for (std::map<RecoveryState::ApplicationKey,
+                RecoveryState::ItemCandidate>::const_iterator candidate_iter =
+                    state.applications.begin();
+            candidate_iter != state.applications.end();
+            ++candidate_iter)
+        {
+            IndexedEntity * const indexed_ptr =
+                find_indexed_entity(candidate_iter->first.first);
+
+            if (indexed_ptr and (not candidate_iter->second.removed) and
+                (indexed_ptr->incarnation ==
+                    candidate_iter->second.incarnation))
+            {
+                update_location(
+                    indexed_ptr->applications[candidate_iter->first.second],
+                    candidate_iter->second.location);
+            }
+        }
+
+        for (std::map<dbtype::Id, RecoveryState::ItemCandidate>::
+                const_iterator candidate_iter = state.access.begin();
+            candidate_iter != state.access.end();
+            ++candidate_iter)
+        {
+            IndexedEntity * const indexed_ptr =
+                find_indexed_entity(candidate_iter->first);
+
+            if (indexed_ptr and (indexed_ptr->incarnation ==
+                candidate_iter->second.incarnation))
+            {
+                indexed_ptr->has_access_stats = true;
+                indexed_ptr->accessed_timestamp =
+                    dbtype::TimeStamp(candidate_iter->second.accessed);
+                indexed_ptr->access_count =
+                    candidate_iter->second.access_count;
+                update_location(
+                    indexed_ptr->access_location,
+                    candidate_iter->second.location);
+            }
+        }
+
+        for (std::map<dbtype::Id, RecoveryState::ItemCandidate>::
+                const_iterator candidate_iter = state.program_code.begin();
+            candidate_iter != state.program_code.end();
+            ++candidate_iter)
+        {
+            IndexedEntity * const indexed_ptr =
+                find_indexed_entity(candidate_iter->first);
+
+            if (indexed_ptr and (indexed_ptr->incarnation ==
+                candidate_iter->second.incarnation))
+            {
+                update_location(
+                    indexed_ptr->code_location,
+                    candidate_iter->second.location);
+            }
+        }
+
+        for (std::map<dbtype::Id, RecoveryState::ItemCandidate>::
+                const_iterator candidate_iter = state.references.begin();
+            candidate_iter != state.references.end();
+            ++candidate_iter)
+        {
+            const dbtype::Id &source_id = candidate_iter->first;
+            IndexedEntity * const indexed_ptr =
+                find_indexed_entity(source_id);
+
+            if ((not indexed_ptr) or (indexed_ptr->incarnation !=
+                candidate_iter->second.incarnation))
+            {
+                continue;
+            }
+
+            update_location(
+                indexed_ptr->references_location,
+                candidate_iter->second.location);
+
+            const dbtype::Entity::IdFieldsMap &references =
+                candidate_iter->second.references;
+
+            if (not references.empty())
+            {
+                references_from[source_id] = references;
+
+                for (dbtype::Entity::IdFieldsMap::const_iterator target_iter =
+                        references.begin();
+                    target_iter != references.end();
+                    ++target_iter)
+                {
+                    references_to[target_iter->first][source_id] =
+                        target_iter->second;
+                }
+            }
+        }
+
+        // IDs not in use below the highest one are available for reuse.
+        //
+        for (IndexedSites::iterator site_iter = sites.begin();
+            site_iter != sites.end();
+            ++site_iter)
+        {
+            IndexedSite &site = site_iter->second;
+
+            site.next_entity_id = site.entities.empty() ?
+                1 : site.entities.rbegin()->first + 1;
+
+            for (dbtype::Id::EntityIdType entity_id = 1;
+                 entity_id < site.next_entity_id;
+                 ++entity_id)
+            {
+                if (not site.entities.count(entity_id))
+                {
+                    site.reuse_ids.insert(entity_id);
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::append_record(
+        LogRecord &record,
+        RecordLocation &location)
+    {
+        std::string encoded;
+
+        record.sequence = next_sequence;
+        record.in_transaction = transaction_open;
+        record.encode(encoded);
+
+        if (not append_encoded(encoded, location))
+        {
+            return false;
+        }
+
+        ++next_sequence;
+
+        if (sync_writes and (not transaction_open) and (not bulk_load))
+        {
+            return sync_active_segment();
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::append_encoded(
+        const std::string &encoded,
+        RecordLocation &location)
+    {
+        SegmentFile *active_ptr = get_active_segment();
+
+        if ((not active_ptr) or
+            (active_ptr->get_size() and
+              (active_ptr->get_size() + encoded.size() > segment_size)))
+        {
+            if (not start_segment())
+            {
+                return false;
+            }
+
+            active_ptr = get_active_segment();
+        }
+
+        if (not active_ptr->append(encoded, location.offset))
+        {
+            return false;
+        }
+
+        location.segment = active_ptr->get_number();
+        location.size = encoded.size();
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::start_segment(void)
+    {
+        SegmentFile * const active_ptr = get_active_segment();
+        SegmentFile::SegmentNumber number = 1;
+
+        if (active_ptr)
+        {
+            // Once sealed, a segment is never synced again.  The compactor
+            // also relies on this before removing what it copied.
+            if (not active_ptr->sync())
+            {
+                return false;
+            }
+
+            number = active_ptr->get_number() + 1;
+        }
+
+        SegmentFile * const file_ptr = new SegmentFile(directory, number);
+
+        if (not file_ptr->open())
+        {
+            delete file_ptr;
+            return false;
+        }
+
+        segments[number].file_ptr = file_ptr;
+
+        LOG(debug, "logstoreinterface", "start_segment",
+            "Started segment " + file_ptr->get_path());
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    SegmentFile *LogStoreBackend::get_active_segment(void) const
+    {
+        return segments.empty() ? 0 : segments.rbegin()->second.file_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::read_encoded(
+        const RecordLocation &location,
+        std::string &encoded)
+    {
+        const Segments::const_iterator segment_iter =
+            segments.find(location.segment);
+
+        if ((segment_iter == segments.end()) or
+            (not segment_iter->second.file_ptr->read(
+                location.offset,
+                location.size,
+                encoded)))
+        {
+            LOG(error, "logstoreinterface", "read_encoded",
+                "Could not read record in segment "
+                + text::to_string(location.segment) + " at offset "
+                + text::to_string(location.offset));
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::update_location(
+        RecordLocation &current,
+        const RecordLocation &new_location)
+    {
+        if (current.valid())
+        {
+            const Segments::iterator segment_iter =
+                segments.find(current.segment);
+
+            if (segment_iter != segments.end())
+            {
+                segment_iter->second.live_bytes -=
+                    std::min(
+                        segment_iter->second.live_bytes,
+                        (SegmentFile::Offset) current.size);
+            }
+        }
+
+        current = new_location;
+
+        if (current.valid())
+        {
+            const Segments::iterator segment_iter =
+                segments.find(current.segment);
+
+            if (segment_iter != segments.end())
+            {
+                segment_iter->second.live_bytes += current.size;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    const LogStoreBackend::IndexedEntity *LogStoreBackend::find_indexed_entity(
+        const dbtype::Id &id) const
+    {
+        const IndexedSites::const_iterator site_iter =
+            sites.find(id.get_site_id());
+
+        if (site_iter != sites.end())
+        {
+            const IndexedEntities::const_iterator entity_iter =
+                site_iter->second.entities.find(id.get_entity_id());
+
+            if (entity_iter != site_iter->second.entities.end())
+            {
+                return &entity_iter->second;
+            }
+        }
+
+        return 0;
+    }
+
+    // ----------------------------------------------------------------------
+    LogStoreBackend::IndexedEntity *LogStoreBackend::find_indexed_entity(
+        const dbtype::Id &id)
+    {
+        const IndexedSites::iterator site_iter = sites.find(id.get_site_id());
+
+        if (site_iter != sites.end())
+        {
+            const IndexedEntities::iterator entity_iter =
+                site_iter->second.entities.find(id.get_entity_id());
+
+            if (entity_iter != site_iter->second.entities.end())
+            {
+                return &entity_iter->second;
+            }
+        }
+
+        return 0;
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::delete_program_reg(
+        IndexedSite &site,
+        IndexedEntity &indexed)
+    {
+        if (not indexed.program_reg_name.empty())
+        {
+            site.program_regs.erase(
+                text::to_lower_copy(indexed.program_reg_name));
+            indexed.program_reg_name.clear();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::delete_owned(
+        IndexedSite &site,
+        const dbtype::Id::EntityIdType owner,
+        const dbtype::Id::EntityIdType entity_id)
+    {
+        const OwnerIndex::iterator owned_iter = site.owned.find(owner);
+
+        if (owned_iter != site.owned.end())
+        {
+            owned_iter->second.erase(entity_id);
+
+            if (owned_iter->second.empty())
+            {
+                site.owned.erase(owned_iter);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::search_matches(
+        const IndexedEntity &indexed,
+        const dbtype::EntityType type,
+        const std::string &lower_name,
+        const bool exact)
+    {
+        if ((type != dbtype::ENTITYTYPE_invalid) and (indexed.type != type))
+        {
+            return false;
+        }
+
+        if (lower_name.empty())
+        {
+            return true;
+        }
+
+        if (exact)
+        {
+            return indexed.lower_name == lower_name;
+        }
+
+        return indexed.lower_name.find(lower_name) != std::string::npos;
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::forget_entity(
+        IndexedSite &site,
+        IndexedEntities::iterator entity_iter)
+    {
+        IndexedEntity &indexed = entity_iter->second;
+        const RecordLocation no_location;
+
+        delete_program_reg(site, indexed);
+        delete_owned(site, indexed.owner, entity_iter->first);
+
+        update_location(indexed.location, no_location);
+        update_location(indexed.access_location, no_location);
+        update_location(indexed.references_location, no_location);
+        update_location(indexed.code_location, no_location);
+
+        for (IndexedApplications::iterator app_iter =
+                indexed.applications.begin();
+            app_iter != indexed.applications.end();
+            ++app_iter)
+        {
+            update_location(app_iter->second, no_location);
+        }
+
+        site.entities.erase(entity_iter);
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::get_metadata_internal(
+        const dbtype::Id &id,
+        dbinterface::EntityMetadata &metadata) const
+    {
+        const IndexedEntity * const indexed_ptr = find_indexed_entity(id);
+
+        if (not indexed_ptr)
+        {
+            metadata.reset();
+        }
+        else
+        {
+            metadata.set(
+                id,
+                dbtype::Id(id.get_site_id(), indexed_ptr->owner),
+                indexed_ptr->type,
+                indexed_ptr->version,
+                indexed_ptr->name);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::get_metadata_in_mem(
+        const dbtype::Id &id,
+        dbinterface::EntityMetadata &metadata)
+    {
+        dbinterface::EntityRef entity_ref =
+            dbinterface::DatabaseAccess::instance()->get_entity(id);
+
+        if (not entity_ref.valid())
+        {
+            metadata.reset();
+        }
+        else
+        {
+            concurrency::ReaderLockToken token(*entity_ref.get());
+
+            metadata.set(
+                id,
+                entity_ref->get_entity_owner(token),
+                entity_ref->get_entity_type(),
+                entity_ref->get_entity_version(),
+                entity_ref->get_entity_name(token));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::serialize_applications(
+        dbtype::PropertyEntity *entity_ptr,
+        concurrency::WriterLockToken &token,
+        PendingApplications &applications)
+    {
+        dbtype::PropertyEntity::ApplicationNameSet changed;
+        bool success = entity_ptr->get_changed_applications(changed, token);
+
+        for (dbtype::PropertyEntity::ApplicationNameSet::const_iterator
+                app_iter = changed.begin();
+            app_iter != changed.end();
+            ++app_iter)
+        {
+            const dbtype::ApplicationProperties *properties_ptr = 0;
+
+            // If the application was never loaded, what's in the log is
+            // already current.
+            //
+            if (entity_ptr->get_application_properties_for_save(
+                *app_iter,
+                properties_ptr,
+                token))
+            {
+                applications.push_back(PendingApplication());
+
+                PendingApplication &pending = applications.back();
+
+                pending.name = *app_iter;
+                // Null properties means the application was removed.
+                pending.removed = not properties_ptr;
+
+                if (properties_ptr and (not serialize_application_properties(
+                    *properties_ptr,
+                    pending.data)))
+                {
+                    LOG(error, "logstoreinterface", "serialize_applications",
+                        "Could not serialize application " + *app_iter
+                        + " for Entity "
+                        + entity_ptr->get_entity_id().to_string(true));
+
+                    applications.pop_back();
+                    success = false;
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::write_site(
+        const dbtype::Id::SiteIdType site_id,
+        IndexedSite &site)
+    {
+        LogRecord record;
+        RecordLocation location;
+
+        record.type = LogRecord::RECORD_site;
+        record.site_id = site_id;
+        record.incarnation = site.cleared_sequence;
+        record.name = site.name;
+        record.text = site.description;
+
+        if (not append_record(record, location))
+        {
+            LOG(error, "logstoreinterface", "write_site",
+                "Could not write site " + text::to_string(site_id));
+            return false;
+        }
+
+        update_location(site.location, location);
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::write_references(const dbtype::Id &id)
+    {
+        IndexedEntity * const indexed_ptr = find_indexed_entity(id);
+
+        if (not indexed_ptr)
+        {
+            // Not in the database (anymore), so nothing to write.
+            return true;
+        }
+
+        LogRecord record;
+        RecordLocation location;
+        const ReferenceIndex::const_iterator from_iter =
+            references_from.find(id);
+
+        record.type = LogRecord::RECORD_references;
+        record.site_id = id.get_site_id();
+        record.entity_id = id.get_entity_id();
+        record.incarnation = indexed_ptr->incarnation;
+
+        if (from_iter != references_from.end())
+        {
+            record.references = from_iter->second;
+        }
+
+        if (not append_record(record, location))
+        {
+            LOG(error, "logstoreinterface", "write_references",
+                "Could not write references for Entity "
+                + id.to_string(true));
+            return false;
+        }
+
+        update_location(indexed_ptr->references_location, location);
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::remove_reference(
+        ReferenceIndex &index,
+        const dbtype::Id &key_id,
+        const dbtype::Id &other_id,
+        const dbtype::EntityField field)
+    {
+        const ReferenceIndex::iterator key_iter = index.find(key_id);
+
+        if (key_iter != index.end())
+        {
+            const dbtype::Entity::IdFieldsMap::iterator other_iter =
+                key_iter->second.find(other_id);
+
+            if (other_iter != key_iter->second.end())
+            {
+                other_iter->second.erase(field);
+
+                if (other_iter->second.empty())
+                {
+                    key_iter->second.erase(other_iter);
+
+                    if (key_iter->second.empty())
+                    {
+                        index.erase(key_iter);
+                    }
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::delete_entity_references(
+        const dbtype::Id &id,
+        std::set<dbtype::Id> *changed_sources)
+    {
+        // Everything it references no longer has it as a source.
+        //
+        ReferenceIndex::iterator from_iter = references_from.find(id);
+
+        if (from_iter != references_from.end())
+        {
+            for (dbtype::Entity::IdFieldsMap::const_iterator target_iter =
+                    from_iter->second.begin();
+                target_iter != from_iter->second.end();
+                ++target_iter)
+            {
+                const ReferenceIndex::iterator to_iter =
+                    references_to.find(target_iter->first);
+
+                if (to_iter != references_to.end())
+                {
+                    to_iter->second.erase(id);
+
+                    if (to_iter->second.empty())
+                    {
+                        references_to.erase(to_iter);
+                    }
+                }
+            }
+
+            references_from.erase(from_iter);
+        }
+
+        // Everything referencing it no longer has it as a target, and
+        // needs its references written out again.
+        //
+        ReferenceIndex::iterator to_iter = references_to.find(id);
+        std::vector<dbtype::Id> sources;
+
+        if (to_iter != references_to.end())
+        {
+            for (dbtype::Entity::IdFieldsMap::const_iterator source_iter =
+                    to_iter->second.begin();
+                source_iter != to_iter->second.end();
+                ++source_iter)
+            {
+                const ReferenceIndex::iterator source_from_iter =
+                    references_from.find(source_iter->first);
+
+                if (source_from_iter != references_from.end())
+                {
+                    source_from_iter->second.erase(id);
+
+                    if (source_from_iter->second.empty())
+                    {
+                        references_from.erase(source_from_iter);
+                    }
+                }
+
+                if (source_iter->first != id)
+                {
+                    sources.push_back(source_iter->first);
+                }
+            }
+
+            references_to.erase(to_iter);
+        }
+
+        for (std::vector<dbtype::Id>::const_iterator source_iter =
+                sources.begin();
+            source_iter != sources.end();
+            ++source_iter)
+        {
+            if (changed_sources)
+            {
+                changed_sources->insert(*source_iter);
+            }
+            else
+            {
+                write_references(*source_iter);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::sync_active_segment(void)
+    {
+        SegmentFile * const active_ptr = get_active_segment();
+
+        return (not active_ptr) or active_ptr->sync();
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::compactor_thread_main(void)
+    {
+        const boost::posix_time::seconds interval(
+            config::db::logstore_compact_interval());
+
+        while (true)
+        {
+            {
+                boost::unique_lock<boost::mutex> lock(compactor_mutex);
+
+                if (not compactor_stop)
+                {
+                    compactor_cond.timed_wait(lock, interval);
+                }
+
+                if (compactor_stop)
+                {
+                    break;
+                }
+            }
+
+            // Keep going while there is something to compact, in case a
+            // lot has piled up.
+            //
+            while (compact_segment())
+            {
+                boost::lock_guard<boost::mutex> guard(compactor_mutex);
+
+                if (compactor_stop)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::compact_segment(void)
+    {
+        SegmentFile *file_ptr = 0;
+        SegmentFile::SegmentNumber number = 0;
+
+        // Pick the sealed segment with the most garbage.
+        //
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            if (transaction_open or bulk_load or (segments.size() < 2))
+            {
+                return false;
+            }
+
+            const SegmentFile::Offset garbage_percent =
+                config::db::logstore_compact_garbage();
+            const Segments::const_iterator active_iter = --segments.end();
+            SegmentFile::Offset most_garbage = 0;
+
+            for (Segments::const_iterator segment_iter = segments.begin();
+                segment_iter != active_iter;
+                ++segment_iter)
+            {
+                const SegmentFile::Offset size =
+                    segment_iter->second.file_ptr->get_size();
+                const SegmentFile::Offset garbage =
+                    size - std::min(size, segment_iter->second.live_bytes);
+
+                if ((garbage * 100 >= size * garbage_percent) and
+                    ((not file_ptr) or (garbage > most_garbage)))
+                {
+                    file_ptr = segment_iter->second.file_ptr;
+                    number = segment_iter->first;
+                    most_garbage = garbage;
+                }
+            }
+        }
+
+        if (not file_ptr)
+        {
+            return false;
+        }
+
+        LOG(info, "logstoreinterface", "compact_segment",
+            "Compacting " + file_ptr->get_path());
+
+        // A sealed segment never changes, and only the compactor removes
+        // segments, so it can be read without the lock.  What is still
+        // current is copied over a batch at a time, so nothing else is
+        // held up for long.
+        //
+        std::vector<LogRecord> records;
+        std::vector<RecordLocation> locations;
+        std::string buffer;
+        RecordLocation location;
+        LogRecord::ReadResult result = LogRecord::READ_ok;
+        bool success = true;
+
+        location.segment = number;
+
+        while (success and (result == LogRecord::READ_ok))
+        {
+            size_t count = 0;
+
+            while (count < COMPACT_BATCH_RECORDS)
+            {
+                size_t record_size = 0;
+
+                if (records.size() <= count)
+                {
+                    records.resize(count + 1);
+                    locations.resize(count + 1);
+                }
+
+                result = file_ptr->read_next(
+                    location.offset,
+                    buffer,
+                    records[count],
+                    record_size);
+
+                if (result != LogRecord::READ_ok)
+                {
+                    break;
+                }
+
+                location.size = record_size;
+                locations[count] = location;
+                location.offset += record_size;
+                ++count;
+            }
+
+            if (result == LogRecord::READ_corrupt)
+            {
+                // Keep the segment around so nothing more is lost.
+                LOG(error, "logstoreinterface", "compact_segment",
+                    "Corrupt record in " + file_ptr->get_path()
+                    + " at offset " + text::to_string(location.offset)
+                    + "; not compacting it.");
+                success = false;
+            }
+
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            if (transaction_open or bulk_load)
+            {
+                // Copies must not end up in the middle of a transaction,
+                // or they would be lost if it was never committed.  What
+                // was already copied is fine; the rest will be done next
+                // time.
+                success = false;
+            }
+
+            // Copies of records that were part of a transaction are
+            // written together after the others, followed by a commit of
+            // their own, so they are recovered like any other committed
+            // transaction.
+            //
+            bool transaction_copied = false;
+
+            for (size_t index = 0; success and (index < count); ++index)
+            {
+                bool copied = false;
+
+                if (not records[index].in_transaction)
+                {
+                    success = compact_record(
+                        number,
+                        records[index],
+                        locations[index],
+                        copied);
+                }
+            }
+
+            for (size_t index = 0; success and (index < count); ++index)
+            {
+                bool copied = false;
+
+                if (records[index].in_transaction)
+                {
+                    success = compact_record(
+                        number,
+                        records[index],
+                        locations[index],
+                        copied);
+                    transaction_copied = transaction_copied or copied;
+                }
+            }
+
+            if (success and transaction_copied)
+            {
+                LogRecord commit_record;
+                RecordLocation commit_location;
+
+                commit_record.type = LogRecord::RECORD_commit;
+                success = append_record(commit_record, commit_location);
+            }
+        }
+
+        if (success)
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            // The copies must be on disk before the originals are removed.
+            success = sync_active_segment();
+
+            if (success)
+            {
+                const Segments::iterator segment_iter = segments.find(number);
+
+                file_ptr->remove();
+                delete file_ptr;
+                segments.erase(segment_iter);
+
+                LOG(info, "logstoreinterface", "compact_segment",
+                    "Removed segment " + text::to_string(number));
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool LogStoreBackend::compact_record(
+        const SegmentFile::SegmentNumber segment_number,
+        const LogRecord &record,
+        const RecordLocation &location,
+        bool &copied)
+    {
+        RecordLocation *index_location_ptr = 0;
+        bool needed = false;
+
+        copied = false;
+
+        if (record.in_transaction and
+            uncommitted_sequences.erase(record.sequence))
+        {
+            // Never committed, so it was never current.
+            return true;
+        }
+
+        switch (record.type)
+        {
+            case LogRecord::RECORD_site:
+            {
+                const IndexedSites::iterator site_iter =
+                    sites.find(record.site_id);
+
+                if ((site_iter != sites.end()) and
+                    (site_iter->second.location == location))
+                {
+                    index_location_ptr = &site_iter->second.location;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_entity:
+            case LogRecord::RECORD_application:
+            case LogRecord::RECORD_access:
+            case LogRecord::RECORD_references:
+            case LogRecord::RECORD_program_code:
+            {
+                IndexedEntity * const indexed_ptr =
+                    find_indexed_entity(record.get_id());
+
+                if (not indexed_ptr)
+                {
+                    break;
+                }
+
+                RecordLocation *candidate_ptr = 0;
+
+                if (record.type == LogRecord::RECORD_entity)
+                {
+                    candidate_ptr = &indexed_ptr->location;
+                }
+                else if (record.type == LogRecord::RECORD_access)
+                {
+                    candidate_ptr = &indexed_ptr->access_location;
+                }
+                else if (record.type == LogRecord::RECORD_references)
+                {
+                    candidate_ptr = &indexed_ptr->references_location;
+                }
+                else if (record.type == LogRecord::RECORD_program_code)
+                {
+                    candidate_ptr = &indexed_ptr->code_location;
+                }
+                else
+                {
+                    const IndexedApplications::iterator app_iter =
+                        indexed_ptr->applications.find(record.name);
+
+                    if (app_iter != indexed_ptr->applications.end())
+                    {
+                        candidate_ptr = &app_iter->second;
+                    }
+                }
+
+                if (candidate_ptr and (*candidate_ptr == location))
+                {
+                    index_location_ptr = candidate_ptr;
+                }
+
+                break;
+            }
+
+            case LogRecord::RECORD_site_delete:
+            case LogRecord::RECORD_entity_delete:
+            case LogRecord::RECORD_application_delete:
+            {
+                // Whatever a tombstone deleted is either in the same
+                // segment or an older one.  Once no older segments are
+                // left, it has nothing left to hide.
+                needed = segments.begin()->first < segment_number;
+                break;
+            }
+
+            default:
+            {
+                // Commits are only needed until the segment is sealed,
+                // since compaction never happens during a transaction.
+                break;
+            }
+        }
+
+        if (index_location_ptr or needed)
+        {
+            std::string encoded;
+            RecordLocation new_location;
+
+            // The sequence number and transaction flag stay the same, so
+            // the newest version of everything can still be found, and it
+            // is only used if its transaction was committed.
+            record.encode(encoded);
+
+            if (not append_encoded(encoded, new_location))
+            {
+                LOG(error, "logstoreinterface", "compact_record",
+                    "Could not copy record to the newest segment.");
+                return false;
+            }
+
+            if (index_location_ptr)
+            {
+                update_location(*index_location_ptr, new_location);
+            }
+
+            copied = true;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    void LogStoreBackend::stop_compactor(void)
+    {
+        if (compactor_thread_ptr)
+        {
+            {
+                boost::lock_guard<boost::mutex> guard(compactor_mutex);
+                compactor_stop = true;
+            }
+
+            compactor_cond.notify_all();
+            compactor_thread_ptr->join();
+
+            delete compactor_thread_ptr;
+            compactor_thread_ptr = 0;
+        }
+    }
+}
+}
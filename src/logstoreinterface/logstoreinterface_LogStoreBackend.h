@@ -0,0 +1,870 @@
+/*
+ * logstoreinterface_LogStoreBackend.h
+ */
+
+#ifndef MUTGOS_LOGSTOREINTERFACE_LOGSTOREBACKEND_H
+#define MUTGOS_LOGSTOREINTERFACE_LOGSTOREBACKEND_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "dbinterface/dbinterface_EntityMetadata.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_TimeStamp.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_ApplicationPropertiesLoader.h"
+#include "dbtypes/dbtype_ProgramCodeLoader.h"
+
+#include "concurrency/concurrency_WriterLockToken.h"
+
+#include "logstoreinterface_LogRecord.h"
+#include "logstoreinterface_SegmentFile.h"
+
+namespace mutgos
+{
+namespace logstoreinterface
+{
+    /**
+     * Implements a DbBackend that appends every change to a log made of
+     * segment files, instead of updating a database in place.  Saving an
+     * Entity is a single sequential write of its serialized form, no
+     * matter how big the database is.
+     * <p>
+     * An index of every Entity (where its latest record is, plus its
+     * name, owner, type, and program registration) is kept in memory, so
+     * searches and metadata never touch the disk, and loading an Entity is
+     * a single read.  The index is rebuilt at startup by scanning every
+     * segment; a record that was only partly written when the server
+     * stopped is detected by its checksum and cut off.
+     * <p>
+     * Application properties and the compiled code of Programs are
+     * written as records of their own, only when they change, and are
+     * read from the log the first time they are needed.
+     * <p>
+     * Old versions of Entities and deleted Entities are left behind in
+     * the log.  A background thread periodically picks the older segment
+     * with the most of them, copies whatever in it is still current to the
+     * newest segment, and then deletes it.
+     * <p>
+     * Changes made while a transaction is open are marked, and a commit
+     * record is written when it is committed.  Marked changes with no
+     * commit after them are thrown away at startup.  Transactions cannot
+     * be rolled back while the server is running, however.  Bulk loads
+     * simply skip syncing the log to disk until the bulk load is done.
+     * Online backups are not supported; the segment files may be copied
+     * while the server is stopped instead.
+     * <p>
+     * The index is guarded by a single reader/writer lock.  Appends are
+     * done with it exclusively locked, and reads with it shared.  Entities
+     * are serialized and deserialized outside of the lock.
+     */
+    class LogStoreBackend : public dbinterface::DbBackend,
+        public dbtype::ApplicationPropertiesLoader,
+        public dbtype::ProgramCodeLoader
+    {
+    public:
+        /**
+         * Constructor.
+         */
+        LogStoreBackend(void);
+
+        /**
+         * Destructor.
+         */
+        virtual ~LogStoreBackend();
+
+        /**
+         * Opens the segments, rebuilds the index from them, and starts
+         * the compactor.
+         * @return True if success.
+         */
+        virtual bool init(void);
+
+        /**
+         * Informs the DbBackend that it is to be shut down.  The compactor
+         * is stopped and everything is synced to disk.
+         * @return True if success, false if Entities are still in memory.
+         */
+        virtual bool shutdown(void);
+
+        /**
+         * @return The name of this backend.  This should be a string
+         * suitable for logging and display and is for informational
+         * purposes only.
+         */
+        virtual std::string get_backend_name(void);
+
+        /**
+         * @param entity_ptr[in] A pointer to an Entity.
+         * @return True if this pointer was created by this DbBackend.  If
+         * true, when Entity is to be deleted from memory, you MUST use
+         * delete_entity_mem().
+         */
+        virtual bool entity_mem_owned_by_this(
+            const dbtype::Entity *entity_ptr);
+
+        /**
+         * Deletes the given entity from memory, if owned by this DbBackend.
+         * The Entity will NOT be deleted from the database.
+         * @param entity_ptr[in] The entity pointer to delete from memory.
+         */
+        virtual void delete_entity_mem(dbtype::Entity *entity_ptr);
+
+        /**
+         * Creates a new Entity of the given type (version 0), in memory and the
+         * database.
+         * Caller must manage pointer and delete it with delete_entity_mem().
+         * @param type[in] The type of Entity to create.
+         * @param site_id[in] The valid Site ID the Entity is associated with.
+         * @param owner[in] The owner of the new Entity.
+         * @param name[in] The name of the new Entity.
+         * @return The newly created entity as a pointer, or null if error.
+         */
+        virtual dbtype::Entity *new_entity(
+            const dbtype::EntityType type,
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::Id &owner,
+            const std::string &name);
+
+        /**
+         * Gets the Entity from the database.  If the Entity is already
+         * present in memory, the existing pointer is returned.
+         * Caller must manage pointer and delete it with delete_entity_mem().
+         * @param id[in] The ID of the Entity to retrieve.
+         * @return A pointer to the Entity retrieved, or null if not found.
+         */
+        virtual dbtype::Entity *get_entity_db(const dbtype::Id &id);
+
+        /**
+         * Determines if the given entity ID exists in the database.
+         * @param id[in] The ID to check.
+         * @return True if it exists, false if not.
+         */
+        virtual bool entity_exists_db(const dbtype::Id &id);
+
+        /**
+         * Saves the given Entity to the database, by appending it to the
+         * log.
+         * @param entity_ptr[in] The Entity to save.
+         * @return True if success.
+         */
+        virtual bool save_entity_db(dbtype::Entity *entity_ptr);
+
+        /**
+         * Starts a transaction.  Everything written until
+         * commit_transaction_db() is called is marked as part of it.
+         * @return True if the transaction was started, false if error or
+         * one is already in progress.
+         */
+        virtual bool begin_transaction_db(void);
+
+        /**
+         * Commits the transaction started with begin_transaction_db(), by
+         * writing a commit record.
+         * @return True if the transaction was committed, false if error
+         * or no transaction was open.
+         */
+        virtual bool commit_transaction_db(void);
+
+        /**
+         * Starts a bulk load.  The log is not synced to disk, and no
+         * compaction is done, until the bulk load is finished.
+         * @return True if the bulk load was started, false if error or
+         * one is already in progress.
+         */
+        virtual bool begin_bulk_load_db(void);
+
+        /**
+         * Finishes a bulk load by syncing the log to disk.
+         * @return True if success, false if error or no bulk load was
+         * in progress.
+         */
+        virtual bool end_bulk_load_db(void);
+
+        /**
+         * Deletes the given Entity from the database.  If the Entity is
+         * currently in memory, deletion will fail.
+         * @param id[in] The ID of the Entity to delete.
+         * @return True if success (or does not exist), false if failure.
+         */
+        virtual bool delete_entity_db(const dbtype::Id &id);
+
+        /**
+         * Deleted entities are included in this query.
+         * @param id[in] The ID whose type is to be retrieved.
+         * @return The type of the given ID, or 'invalid' if not found.
+         */
+        virtual dbtype::EntityType get_entity_type_db(const dbtype::Id &id);
+
+        /**
+         * Saves the access statistics (last accessed timestamp and access
+         * count) of Entities, to be applied when they are next loaded.
+         * Statistics for Entities that do not exist are ignored.
+         * @param stats[in] The access statistics to save.
+         * @return True if success.
+         */
+        virtual bool save_access_stats_db(const AccessStatsMap &stats);
+
+        /**
+         * Updates the reference index with the ID fields that changed on
+         * an Entity.
+         * @param source_id[in] The ID of the Entity whose fields changed.
+         * @param changed_fields[in] The IDs removed and added, per field.
+         * @return True if success.
+         */
+        virtual bool update_references_db(
+            const dbtype::Id &source_id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields);
+
+        /**
+         * Uses the reference index to find the Entities referencing an
+         * Entity by a particular field.
+         * @param target_id[in] The ID of the Entity being referenced.
+         * @param field[in] The field on the other Entities doing the
+         * referencing.
+         * @return The IDs of the Entities whose field references target_id,
+         * or empty if none or error.
+         */
+        virtual dbtype::Entity::IdVector get_references_to_db(
+            const dbtype::Id &target_id,
+            const dbtype::EntityField field);
+
+        /**
+         * Uses the reference index to find everything an Entity references.
+         * @param source_id[in] The ID of the Entity doing the referencing.
+         * @return A map of the referenced IDs to the fields on source_id
+         * that reference them, or empty if none or error.
+         */
+        virtual dbtype::Entity::IdFieldsMap get_references_from_db(
+            const dbtype::Id &source_id);
+
+        /**
+         * Searches for entities using the parameters specified that
+         * contain the given string somewhere in their name, or an exact
+         * name match if specified.
+         * @param site_id[in] The site to search within.
+         * @param type[in] The type of entity to search for, or invalid
+         * for all types.
+         * @param owner_id[in] The ID of the owner, or default for all owners.
+         * @param name[in] The name of the Entity to look for.  Can be empty
+         * in some situations to search for all names.
+         * @param exact[in] If true, match name exactly.  Note you may still
+         * get multiple matches depending on the type.  This is ignored
+         * when no name given.
+         * @return The matching IDs, or empty if none.
+         */
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::EntityType type,
+            const dbtype::Id::EntityIdType owner_id,
+            const std::string &name,
+            const bool exact);
+
+        /**
+         * @param site_id[in] The site ID to get all IDs for.
+         * @return All valid Entity IDs for the given site, or empty if none
+         * or site doesn't exist.
+         */
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * @param site_id[in] The site to get Entity IDs for.
+         * @param max_entities[in] The most IDs to return.
+         * @return The IDs of the site's Entities, most recently accessed
+         * first (and then most accessed), up to max_entities.
+         */
+        virtual dbtype::Entity::IdVector get_recently_accessed_db(
+            const dbtype::Id::SiteIdType site_id,
+            const size_t max_entities);
+
+        /**
+         * Searches the given site for the program registration name.
+         * @param site_id[in] The site ID to search for the program
+         * registration name.
+         * @param registration_name[in] The program registration name to
+         * find.
+         * @return The ID of the Program found, or default/invalid if none
+         * found matching or the site is invalid.
+         */
+        virtual dbtype::Id find_program_reg_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &registration_name);
+
+        /**
+         * Searches for the given ID and determines if a registration
+         * is associated with it.
+         * @param id[in] The ID to search for.
+         * @return The registration name of the Program found, or empty if none
+         * found matching or the ID is invalid.
+         */
+        virtual std::string find_program_reg_name_in_db(
+            const dbtype::Id &id);
+
+        /**
+         * @return A list of all known site IDs in the database.
+         */
+        virtual dbtype::Id::SiteIdVector get_site_ids_in_db(void);
+
+        /**
+         * Gets the metadata for a single Entity.
+         * @param id[in] The ID of the entity to get metadata for.
+         * @return The Metadata for the Entity, or invalid if not found.
+         */
+        virtual dbinterface::EntityMetadata get_entity_metadata(
+            const dbtype::Id &id);
+
+        /**
+         * Gets the metadata for a group of Entities.
+         * @param ids[in] The IDs of the entities to get metadata for.
+         * @return The Metadata for the Entities, or empty if not found.
+         * If only a few Entities cannot be found, there will simply not be
+         * an entry for them.
+         */
+        virtual dbinterface::MetadataVector get_entity_metadata(
+            const dbtype::Entity::IdVector &ids);
+
+        /**
+         * Creates a new site in the database.
+         * @param site_id[out] The ID of the site that was created, if success.
+         * @return True if successfully created the new site (site_id will be
+         * populated if so).
+         */
+        virtual bool new_site_in_db(dbtype::Id::SiteIdType &site_id);
+
+        /**
+         * Deletes a site and all its entities in the database.  The site ID
+         * will then be available for reuse.
+         * @param site_id[in] The site ID to delete.
+         * @return True if success, false if the site ID cannot be found.
+         */
+        virtual bool delete_site_in_db(const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * Gets the name for a site.
+         * @param site_id[in] The existing site ID to get the name for.
+         * @param site_name[out] The site name, or empty if error or none.
+         * @return True if successfully retrieved the site name.
+         */
+        virtual bool get_site_name_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            std::string &site_name);
+
+        /**
+         * Sets the name for a site.
+         * @param site_id[in] The existing site ID to set the name for.
+         * @param site_name[in] The site's new name.
+         * @return True if successfully set the site name.
+         */
+        virtual bool set_site_name_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &site_name);
+
+        /**
+         * Gets the description for a site.
+         * @param site_id[in] The existing site ID to get the description for.
+         * @param site_description[out] The site description, or empty if
+         * error or none.
+         * @return True if successfully retrieved the site description.
+         */
+        virtual bool get_site_description_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            std::string &site_description);
+
+        /**
+         * Sets the description for a site.
+         * @param site_id[in] The existing site ID to set the description for.
+         * @param site_description[in] The site's new description.
+         * @return True if successfully set the site description.
+         */
+        virtual bool set_site_description_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &site_description);
+
+        /**
+         * Loads an application's properties from the log.
+         * @param entity_id[in] The ID of the PropertyEntity that owns the
+         * application.
+         * @param application[in] The name of the application to load.
+         * @param properties[out] The loaded application properties.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_application_properties(
+            const dbtype::Id &entity_id,
+            const std::string &application,
+            dbtype::ApplicationProperties &properties);
+
+        /**
+         * Loads a Program's compiled code from the log.
+         * @param program_id[in] The ID of the Program.
+         * @param compiled_code[out] The loaded compiled code.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_compiled_code(
+            const dbtype::Id &program_id,
+            std::string &compiled_code);
+
+    protected:
+        virtual dbtype::Entity *load_entity_copy_db(const dbtype::Id &id);
+
+    private:
+        /**
+         * Where a record is in the log.
+         */
+        struct RecordLocation
+        {
+            RecordLocation(void)
+              : segment(0),
+                offset(0),
+                size(0)
+              { }
+
+            /**
+             * @return True if this points to a record.
+             */
+            bool valid(void) const
+              { return size; }
+
+            /**
+             * @param rhs[in] The location to compare against.
+             * @return True if both point to the same record.
+             */
+            bool operator==(const RecordLocation &rhs) const
+              { return (segment == rhs.segment) and (offset == rhs.offset); }
+
+            SegmentFile::SegmentNumber segment; ///< Segment the record is in
+            SegmentFile::Offset offset; ///< Where it starts in the segment
+            MG_UnsignedInt size; ///< Size including header, or 0 if none
+        };
+
+        /** Maps application name to where its properties are */
+        typedef std::map<std::string, RecordLocation> IndexedApplications;
+
+        /**
+         * The index entry for an Entity, as it was last saved.
+         */
+        struct IndexedEntity
+        {
+            IndexedEntity(void)
+              : incarnation(0),
+                type(dbtype::ENTITYTYPE_invalid),
+                owner(0),
+                version(0),
+                has_access_stats(false),
+                access_count(0)
+              { }
+
+            LogRecord::SequenceType incarnation; ///< When it was created
+            dbtype::EntityType type; ///< Type of the Entity
+            dbtype::Id::EntityIdType owner; ///< Owner, in the same site
+            std::string name; ///< Name of the Entity
+            std::string lower_name; ///< Lowercase name, for searches
+            dbtype::Entity::VersionType version; ///< Version when saved
+            std::string program_reg_name; ///< Program registration, if any
+            RecordLocation location; ///< Where the Entity record is
+            IndexedApplications applications; ///< Where applications are
+            bool has_access_stats; ///< True if stats below were saved
+            dbtype::TimeStamp accessed_timestamp; ///< When last accessed
+            dbtype::Entity::AccessCountType access_count; ///< Times accessed
+            RecordLocation access_location; ///< Where access stats are
+            RecordLocation references_location; ///< Where references are
+            RecordLocation code_location; ///< Where compiled code is
+        };
+
+        /** Maps Entity ID to its index entry */
+        typedef std::map<dbtype::Id::EntityIdType, IndexedEntity>
+            IndexedEntities;
+        /** Maps lowercase program registration name to Program ID */
+        typedef std::map<std::string, dbtype::Id::EntityIdType>
+            ProgramRegistrations;
+        /** Maps an owner to the Entities it owns, in the same site */
+        typedef std::map<dbtype::Id::EntityIdType,
+            std::set<dbtype::Id::EntityIdType> > OwnerIndex;
+
+        /**
+         * The index entry for a site and everything in it.
+         */
+        struct IndexedSite
+        {
+            IndexedSite(void)
+              : cleared_sequence(0),
+                next_entity_id(1)
+              { }
+
+            std::string name; ///< Name of the site
+            std::string description; ///< Description of the site
+            LogRecord::SequenceType cleared_sequence; ///< When ID last deleted
+            RecordLocation location; ///< Where the site record is
+            IndexedEntities entities; ///< All Entities in the site
+            ProgramRegistrations program_regs; ///< Registered Programs
+            OwnerIndex owned; ///< Entities by owner, for searches
+            std::set<dbtype::Id::EntityIdType> reuse_ids; ///< Deleted IDs
+            dbtype::Id::EntityIdType next_entity_id; ///< Next unused ID
+        };
+
+        /** Maps site ID to the site */
+        typedef std::map<dbtype::Id::SiteIdType, IndexedSite> IndexedSites;
+
+        /**
+         * A segment of the log, and how much of it is still current.
+         */
+        struct Segment
+        {
+            Segment(void)
+              : file_ptr(0),
+                live_bytes(0)
+              { }
+
+            SegmentFile *file_ptr; ///< The open segment file
+            SegmentFile::Offset live_bytes; ///< Bytes of current records
+        };
+
+        /** Maps segment number to segment.  The last is the one appended
+            to. */
+        typedef std::map<SegmentFile::SegmentNumber, Segment> Segments;
+        /** Maps an Entity ID to the IDs it references (or is referenced
+            by) and the fields doing the referencing */
+        typedef std::map<dbtype::Id, dbtype::Entity::IdFieldsMap>
+            ReferenceIndex;
+
+        /**
+         * An application's properties, serialized and waiting to be
+         * written.
+         */
+        struct PendingApplication
+        {
+            std::string name; ///< Name of the application
+            bool removed; ///< True if the application was removed
+            std::string data; ///< Serialized properties, if not removed
+        };
+
+        /** Applications waiting to be written */
+        typedef std::vector<PendingApplication> PendingApplications;
+
+        /** What was found while scanning the log at startup */
+        class RecoveryState;
+
+        /**
+         * Scans every segment, rebuilding the index.  Mutex must be
+         * exclusively locked before calling.
+         * @return True if success.
+         */
+        bool recover(void);
+
+        /**
+         * Applies a record found during recovery to the recovery state.
+         * @param record[in] The record.
+         * @param location[in] Where the record is.
+         * @param state[in,out] The recovery state.
+         */
+        void recover_record(
+            const LogRecord &record,
+            const RecordLocation &location,
+            RecoveryState &state);
+
+        /**
+         * Builds the index from what was found during recovery.  Mutex
+         * must be exclusively locked before calling.
+         * @param state[in] The recovery state.
+         */
+        void build_index(const RecoveryState &state);
+
+        /**
+         * Appends a new record to the log, giving it the next sequence
+         * number and syncing it to disk if the durability setting calls
+         * for it.  Mutex must be exclusively locked before calling.
+         * @param record[in,out] The record to append.  The sequence number
+         * and transaction flag will be filled in.
+         * @param location[out] Where the record was written.
+         * @return True if success.
+         */
+        bool append_record(LogRecord &record, RecordLocation &location);
+
+        /**
+         * Appends an already encoded record to the newest segment,
+         * starting a new segment first if the newest one is full.  Mutex
+         * must be exclusively locked before calling.
+         * @param encoded[in] The encoded record.
+         * @param location[out] Where the record was written.
+         * @return True if success.
+         */
+        bool append_encoded(
+            const std::string &encoded,
+            RecordLocation &location);
+
+        /**
+         * Starts a new segment to append to.  Mutex must be exclusively
+         * locked before calling.
+         * @return True if success.
+         */
+        bool start_segment(void);
+
+        /**
+         * @return The segment being appended to, or null if none.  Mutex
+         * must be locked (either way) before calling.
+         */
+        SegmentFile *get_active_segment(void) const;
+
+        /**
+         * Reads a record without decoding it, so it can be decoded after
+         * the mutex is unlocked.  Mutex must be locked (either way) before
+         * calling.
+         * @param location[in] Where the record is.
+         * @param encoded[out] The encoded record.
+         * @return True if success.
+         */
+        bool read_encoded(
+            const RecordLocation &location,
+            std::string &encoded);
+
+        /**
+         * Points an index entry at a new record, updating how much of each
+         * segment is current.  Mutex must be exclusively locked before
+         * calling.
+         * @param current[in,out] The index entry's location.
+         * @param new_location[in] Where the new record is, or an invalid
+         * location if the index entry no longer points to anything.
+         */
+        void update_location(
+            RecordLocation &current,
+            const RecordLocation &new_location);
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param id[in] The ID of the Entity to find.
+         * @return The index entry for the Entity, or null if not found.
+         */
+        const IndexedEntity *find_indexed_entity(const dbtype::Id &id) const;
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param id[in] The ID of the Entity to find.
+         * @return The index entry for the Entity, or null if not found.
+         */
+        IndexedEntity *find_indexed_entity(const dbtype::Id &id);
+
+        /**
+         * Removes the program registration of an Entity, if any.
+         * Mutex must be exclusively locked before calling.
+         * @param site[in,out] The site the Entity is in.
+         * @param indexed[in,out] The Entity's index entry.
+         */
+        static void delete_program_reg(
+            IndexedSite &site,
+            IndexedEntity &indexed);
+
+        /**
+         * Removes an Entity from its owner's entry in the owner index.
+         * Mutex must be exclusively locked before calling.
+         * @param site[in,out] The site the Entity is in.
+         * @param owner[in] The owner of the Entity.
+         * @param entity_id[in] The ID of the Entity.
+         */
+        static void delete_owned(
+            IndexedSite &site,
+            const dbtype::Id::EntityIdType owner,
+            const dbtype::Id::EntityIdType entity_id);
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param indexed[in] The indexed Entity to check.
+         * @param type[in] The type to match, or invalid for all types.
+         * @param lower_name[in] The lowercase name to match, or empty
+         * for all names.
+         * @param exact[in] True if the name must match exactly, false
+         * for a substring match.
+         * @return True if the indexed Entity matches the search.
+         */
+        static bool search_matches(
+            const IndexedEntity &indexed,
+            const dbtype::EntityType type,
+            const std::string &lower_name,
+            const bool exact);
+
+        /**
+         * Removes an Entity from the index, marking all its records as no
+         * longer current.  Nothing is written to the log.  Mutex must be
+         * exclusively locked before calling.
+         * @param site[in,out] The site the Entity is in.
+         * @param entity_iter[in] The Entity to remove.
+         */
+        void forget_entity(
+            IndexedSite &site,
+            IndexedEntities::iterator entity_iter);
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param id[in] The ID of the Entity to find.
+         * @param metadata[out] The metadata for the indexed Entity, or reset
+         * if not found.
+         */
+        void get_metadata_internal(
+            const dbtype::Id &id,
+            dbinterface::EntityMetadata &metadata) const;
+
+        /**
+         * Gets the metadata of an Entity that is in memory, since it may
+         * have changes that were not saved yet.  Mutex must NOT be
+         * locked before calling.
+         * @param id[in] The ID of the Entity in memory.
+         * @param metadata[out] The metadata for the Entity, or reset if
+         * not found.
+         */
+        void get_metadata_in_mem(
+            const dbtype::Id &id,
+            dbinterface::EntityMetadata &metadata);
+
+        /**
+         * Serializes the applications of a PropertyEntity that have
+         * changed.  The Entity must be locked.  Mutex must NOT be locked
+         * before calling.
+         * @param entity_ptr[in] The PropertyEntity being saved.
+         * @param token[in] The lock token for the Entity.
+         * @param applications[out] The serialized applications.
+         * @return True if success.
+         */
+        bool serialize_applications(
+            dbtype::PropertyEntity *entity_ptr,
+            concurrency::WriterLockToken &token,
+            PendingApplications &applications);
+
+        /**
+         * Appends a site record with the site's current name and
+         * description.  Mutex must be exclusively locked before calling.
+         * @param site_id[in] The ID of the site.
+         * @param site[in,out] The site.
+         * @return True if success.
+         */
+        bool write_site(
+            const dbtype::Id::SiteIdType site_id,
+            IndexedSite &site);
+
+        /**
+         * Appends a record with everything an Entity currently references.
+         * Mutex must be exclusively locked before calling.
+         * @param id[in] The ID of the Entity.
+         * @return True if success.
+         */
+        bool write_references(const dbtype::Id &id);
+
+        /**
+         * Removes a single reference from an index.  Mutex must be
+         * exclusively locked before calling.
+         * @param index[in,out] The index to remove from.
+         * @param key_id[in] The ID the index is keyed by.
+         * @param other_id[in] The ID on the other side of the reference.
+         * @param field[in] The field doing the referencing.
+         */
+        static void remove_reference(
+            ReferenceIndex &index,
+            const dbtype::Id &key_id,
+            const dbtype::Id &other_id,
+            const dbtype::EntityField field);
+
+        /**
+         * Removes every reference to or from an Entity from the reference
+         * index, and writes out the new references of every Entity that
+         * referenced it.  Mutex must be exclusively locked before calling.
+         * @param id[in] The ID of the Entity.
+         * @param changed_sources[in,out] IDs of other Entities that used
+         * to reference the Entity are added to this, if not null.  Their
+         * references are then not written out, so the caller can do it
+         * once for all of them.
+         */
+        void delete_entity_references(
+            const dbtype::Id &id,
+            std::set<dbtype::Id> *changed_sources);
+
+        /**
+         * Syncs everything appended so far to disk.  Mutex must be
+         * exclusively locked before calling.
+         * @return True if success.
+         */
+        bool sync_active_segment(void);
+
+        /**
+         * The compactor thread.  Checks for a segment to compact every so
+         * often, until told to stop.
+         */
+        void compactor_thread_main(void);
+
+        /**
+         * Compacts the sealed segment with the most records that are no
+         * longer current, if enough of it is.  Mutex must NOT be locked
+         * before calling.
+         * @return True if a segment was compacted.
+         */
+        bool compact_segment(void);
+
+        /**
+         * Determines if a record being compacted is still needed, and if
+         * so, copies it to the newest segment.  Records of a transaction
+         * that was never committed are dropped.  A copied record keeps its
+         * transaction flag, so the caller must write a commit after the
+         * copies of transaction records.  Mutex must be exclusively locked
+         * before calling.
+         * @param segment_number[in] The segment being compacted.
+         * @param record[in] The record to check.
+         * @param location[in] Where the record is now.
+         * @param copied[out] True if the record was copied.
+         * @return True if success (including when the record was not
+         * needed), false if the copy could not be written.
+         */
+        bool compact_record(
+            const SegmentFile::SegmentNumber segment_number,
+            const LogRecord &record,
+            const RecordLocation &location,
+            bool &copied);
+
+        /**
+         * Stops the compactor thread, if running.  Mutex must NOT be
+         * locked before calling.
+         */
+        void stop_compactor(void);
+
+        boost::shared_mutex mutex; ///< Guards everything below
+        std::string directory; ///< Directory segments are kept in
+        SegmentFile::Offset segment_size; ///< Size a segment may grow to
+        bool sync_commits; ///< True to sync after each commit
+        bool sync_writes; ///< True to sync after each write outside a commit
+        bool transaction_open; ///< True if in a transaction
+        bool bulk_load; ///< True if in a bulk load
+        LogRecord::SequenceType next_sequence; ///< Next sequence number
+        std::set<LogRecord::SequenceType>
+            uncommitted_sequences; ///< Records of never committed transactions
+        Segments segments; ///< All segments of the log, oldest first
+        IndexedSites sites; ///< All sites and their Entities
+        std::set<dbtype::Id::SiteIdType> reuse_site_ids; ///< Deleted sites
+        dbtype::Id::SiteIdType next_site_id; ///< Next unused site ID
+        std::map<dbtype::Id::SiteIdType, LogRecord::SequenceType>
+            deleted_sites; ///< When deleted site IDs were cleared
+        ReferenceIndex references_from; ///< Source to targets and fields
+        ReferenceIndex references_to; ///< Target to sources and fields
+
+        boost::mutex compactor_mutex; ///< Guards compactor stop flag
+        boost::condition_variable compactor_cond; ///< Wakes the compactor
+        bool compactor_stop; ///< True when compactor is to stop
+        boost::thread *compactor_thread_ptr; ///< Non-null if running
+
+        // No copying
+        //
+        LogStoreBackend(const LogStoreBackend &rhs);
+        LogStoreBackend &operator=(const LogStoreBackend &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_LOGSTOREINTERFACE_LOGSTOREBACKEND_H
@@ -0,0 +1,308 @@
+/*
+ * logstoreinterface_SegmentFile.cpp
+ */
+
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "text/text_StringConversion.h"
+#include "logging/log_Logger.h"
+
+#include "logstoreinterface_SegmentFile.h"
+#include "logstoreinterface_LogRecord.h"
+
+namespace
+{
+    const std::string SEGMENT_PREFIX = "segment_";
+    const std::string SEGMENT_SUFFIX = ".log";
+    const size_t SEGMENT_NUMBER_DIGITS = 8;
+}
+
+namespace mutgos
+{
+namespace logstoreinterface
+{
+    // ----------------------------------------------------------------------
+    SegmentFile::SegmentFile(
+        const std::string &directory,
+        const SegmentNumber number)
+      : number(number),
+        file_descriptor(-1),
+        size(0)
+    {
+        std::string number_str = text::to_string(number);
+
+        if (number_str.size() < SEGMENT_NUMBER_DIGITS)
+        {
+            number_str.insert(
+                0,
+                SEGMENT_NUMBER_DIGITS - number_str.size(),
+                '0');
+        }
+
+        path = directory + "/" + SEGMENT_PREFIX + number_str + SEGMENT_SUFFIX;
+    }
+
+    // ----------------------------------------------------------------------
+    SegmentFile::~SegmentFile()
+    {
+        close();
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::parse_file_name(
+        const std::string &file_name,
+        SegmentNumber &number)
+    {
+        if ((file_name.size() !=
+                (SEGMENT_PREFIX.size() + SEGMENT_NUMBER_DIGITS
+                 + SEGMENT_SUFFIX.size())) or
+            (file_name.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX)) or
+            (file_name.compare(
+                file_name.size() - SEGMENT_SUFFIX.size(),
+                SEGMENT_SUFFIX.size(),
+                SEGMENT_SUFFIX)))
+        {
+            return false;
+        }
+
+        const std::string number_str =
+            file_name.substr(SEGMENT_PREFIX.size(), SEGMENT_NUMBER_DIGITS);
+
+        if (number_str.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return false;
+        }
+
+        number = (SegmentNumber) strtoul(number_str.c_str(), 0, 10);
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::open(void)
+    {
+        if (file_descriptor >= 0)
+        {
+            return true;
+        }
+
+        file_descriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+
+        if (file_descriptor < 0)
+        {
+            LOG(error, "logstoreinterface", "open",
+                "Could not open segment " + path + ": "
+                + std::string(strerror(errno)));
+            return false;
+        }
+
+        struct stat file_stat;
+
+        if (fstat(file_descriptor, &file_stat))
+        {
+            LOG(error, "logstoreinterface", "open",
+                "Could not get size of segment " + path + ": "
+                + std::string(strerror(errno)));
+            close();
+            return false;
+        }
+
+        size = file_stat.st_size;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    void SegmentFile::close(void)
+    {
+        if (file_descriptor >= 0)
+        {
+            ::close(file_descriptor);
+            file_descriptor = -1;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::remove(void)
+    {
+        close();
+
+        if (unlink(path.c_str()) and (errno != ENOENT))
+        {
+            LOG(error, "logstoreinterface", "remove",
+                "Could not delete segment " + path + ": "
+                + std::string(strerror(errno)));
+            return false;
+        }
+
+        size = 0;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::append(const std::string &record, Offset &offset)
+    {
+        if (file_descriptor < 0)
+        {
+            return false;
+        }
+
+        const char *data_ptr = record.data();
+        size_t remaining = record.size();
+        Offset write_offset = size;
+
+        while (remaining)
+        {
+            const ssize_t written =
+                pwrite(file_descriptor, data_ptr, remaining, write_offset);
+
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                LOG(error, "logstoreinterface", "append",
+                    "Could not write to segment " + path + ": "
+                    + std::string(strerror(errno)));
+
+                // Don't leave part of a record behind.
+                truncate(size);
+                return false;
+            }
+
+            data_ptr += written;
+            remaining -= written;
+            write_offset += written;
+        }
+
+        offset = size;
+        size = write_offset;
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::read(
+        const Offset offset,
+        const size_t record_size,
+        std::string &record)
+    {
+        record.resize(record_size);
+
+        if (file_descriptor < 0)
+        {
+            return false;
+        }
+
+        size_t done = 0;
+
+        while (done < record_size)
+        {
+            const ssize_t bytes_read = pread(
+                file_descriptor,
+                &record[done],
+                record_size - done,
+                offset + done);
+
+            if (bytes_read < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                LOG(error, "logstoreinterface", "read",
+                    "Could not read from segment " + path + ": "
+                    + std::string(strerror(errno)));
+                return false;
+            }
+
+            if (not bytes_read)
+            {
+                // Past the end of the file.
+                record.resize(done);
+                return false;
+            }
+
+            done += bytes_read;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    LogRecord::ReadResult SegmentFile::read_next(
+        const Offset offset,
+        std::string &buffer,
+        LogRecord &record,
+        size_t &record_size)
+    {
+        if (offset >= size)
+        {
+            return LogRecord::READ_end;
+        }
+
+        size_t payload_size = 0;
+
+        if ((size - offset < LogRecord::HEADER_SIZE) or
+            (not read(offset, LogRecord::HEADER_SIZE, buffer)) or
+            (not LogRecord::decode_header(buffer.data(), payload_size)) or
+            (size - offset < LogRecord::HEADER_SIZE + payload_size) or
+            (not read(offset, LogRecord::HEADER_SIZE + payload_size, buffer)) or
+            (not record.decode(buffer.data(), buffer.size())))
+        {
+            return LogRecord::READ_corrupt;
+        }
+
+        record_size = buffer.size();
+        return LogRecord::READ_ok;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::sync(void)
+    {
+        if (file_descriptor < 0)
+        {
+            return false;
+        }
+
+        if (fdatasync(file_descriptor))
+        {
+            LOG(error, "logstoreinterface", "sync",
+                "Could not sync segment " + path + ": "
+                + std::string(strerror(errno)));
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SegmentFile::truncate(const Offset offset)
+    {
+        if (file_descriptor < 0)
+        {
+            return false;
+        }
+
+        if (ftruncate(file_descriptor, offset))
+        {
+            LOG(error, "logstoreinterface", "truncate",
+                "Could not truncate segment " + path + ": "
+                + std::string(strerror(errno)));
+            return false;
+        }
+
+        size = offset;
+        return true;
+    }
+}
+}
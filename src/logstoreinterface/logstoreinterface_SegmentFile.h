@@ -0,0 +1,159 @@
+/*
+ * logstoreinterface_SegmentFile.h
+ */
+
+#ifndef MUTGOS_LOGSTOREINTERFACE_SEGMENTFILE_H
+#define MUTGOS_LOGSTOREINTERFACE_SEGMENTFILE_H
+
+#include <string>
+#include <stddef.h>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "logstoreinterface_LogRecord.h"
+
+namespace mutgos
+{
+namespace logstoreinterface
+{
+    /**
+     * One segment file of the log store.  Records are only ever appended
+     * to the end of a segment, and can be read back from anywhere in it.
+     * <p>
+     * Reads may be done by several threads at once, and at the same time
+     * as an append, since records already written never change.  Appends,
+     * syncs and truncates must be done by one thread at a time.
+     */
+    class SegmentFile
+    {
+    public:
+        /** Segment numbers; newer segments have higher numbers */
+        typedef MG_UnsignedInt SegmentNumber;
+        /** Offsets within a segment */
+        typedef MG_VeryLongUnsignedInt Offset;
+
+        /**
+         * Constructor.  The file is not opened until open() is called.
+         * @param directory[in] The directory segments are kept in.
+         * @param number[in] The number of the segment.
+         */
+        SegmentFile(const std::string &directory, const SegmentNumber number);
+
+        /**
+         * Destructor.  Closes the file if open.
+         */
+        ~SegmentFile();
+
+        /**
+         * @param file_name[in] A file name (without directory).
+         * @param number[out] The segment number, if a segment file.
+         * @return True if the file name is that of a segment file.
+         */
+        static bool parse_file_name(
+            const std::string &file_name,
+            SegmentNumber &number);
+
+        /**
+         * Opens the segment file for reading and appending, creating it if
+         * it does not exist.
+         * @return True if success.
+         */
+        bool open(void);
+
+        /**
+         * Closes the segment file, if open.
+         */
+        void close(void);
+
+        /**
+         * Closes and deletes the segment file.
+         * @return True if success.
+         */
+        bool remove(void);
+
+        /**
+         * Appends an encoded record to the end of the segment.  If the
+         * record could not be completely written, the segment is put back
+         * the way it was.
+         * @param record[in] The encoded record.
+         * @param offset[out] Where the record was written.
+         * @return True if success.
+         */
+        bool append(const std::string &record, Offset &offset);
+
+        /**
+         * Reads an encoded record.
+         * @param offset[in] Where the record starts.
+         * @param record_size[in] The size of the entire record, including
+         * header.
+         * @param record[out] The encoded record.
+         * @return True if success.
+         */
+        bool read(
+            const Offset offset,
+            const size_t record_size,
+            std::string &record);
+
+        /**
+         * Reads and decodes the record at the given offset, for scanning
+         * through the segment.
+         * @param offset[in] Where the record starts.
+         * @param buffer[in,out] Buffer used to read the record.
+         * @param record[out] The decoded record, if success.
+         * @param record_size[out] The size of the entire record, including
+         * header, if success.
+         * @return The result of the read.
+         */
+        LogRecord::ReadResult read_next(
+            const Offset offset,
+            std::string &buffer,
+            LogRecord &record,
+            size_t &record_size);
+
+        /**
+         * Makes sure everything appended so far is on disk.
+         * @return True if success.
+         */
+        bool sync(void);
+
+        /**
+         * Cuts off the segment at the given offset, discarding everything
+         * after it.
+         * @param offset[in] The new size of the segment.
+         * @return True if success.
+         */
+        bool truncate(const Offset offset);
+
+        /**
+         * @return The number of this segment.
+         */
+        SegmentNumber get_number(void) const
+          { return number; }
+
+        /**
+         * @return The size of the segment, in bytes.
+         */
+        Offset get_size(void) const
+          { return size; }
+
+        /**
+         * @return The full path of the segment file.
+         */
+        const std::string &get_path(void) const
+          { return path; }
+
+    private:
+        const SegmentNumber number; ///< Number of this segment
+        std::string path; ///< Full path of the segment file
+        int file_descriptor; ///< The open file, or -1
+        Offset size; ///< Current size of the segment
+
+        // No copying
+        //
+        SegmentFile(const SegmentFile &rhs);
+        SegmentFile &operator=(const SegmentFile &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_LOGSTOREINTERFACE_SEGMENTFILE_H
@@ -0,0 +1,1374 @@
+/*
+ * memoryinterface_InMemoryBackend.cpp
+ */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "text/text_StringConversion.h"
+
+#include "memoryinterface/memoryinterface_InMemoryBackend.h"
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+#include "dbinterface/dbinterface_EntityRef.h"
+
+#include "concurrency/concurrency_ReaderLockToken.h"
+#include "concurrency/concurrency_WriterLockToken.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_Program.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_TimeStamp.h"
+
+#include "logging/log_Logger.h"
+
+namespace
+{
+    /** An Entity ID, with how recently and how often it was accessed */
+    struct AccessedEntity
+    {
+        mutgos::dbtype::Id::EntityIdType entity_id;
+        mutgos::osinterface::OsTypes::TimeEpochType accessed;
+        mutgos::dbtype::Entity::AccessCountType count;
+
+        /** Sorts most recently accessed first, then most accessed */
+        bool operator<(const AccessedEntity &rhs) const
+        {
+            if (accessed != rhs.accessed)
+            {
+                return accessed > rhs.accessed;
+            }
+
+            return count > rhs.count;
+        }
+    };
+}
+
+namespace mutgos
+{
+namespace memoryinterface
+{
+    // ----------------------------------------------------------------------
+    InMemoryBackend::InMemoryBackend(void)
+      : next_site_id(1)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    InMemoryBackend::~InMemoryBackend()
+    {
+        shutdown();
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::shutdown(void)
+    {
+        LOG(info, "memoryinterface", "shutdown", "Shutting down...");
+
+        const bool success = not any_mem_owned();
+
+        if (success)
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            sites.clear();
+            reuse_site_ids.clear();
+            next_site_id = 1;
+            references_from.clear();
+            references_to.clear();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string InMemoryBackend::get_backend_name(void)
+    {
+        return "In-memory";
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::entity_mem_owned_by_this(
+        const dbtype::Entity *entity_ptr)
+    {
+        return is_mem_owned(entity_ptr);
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::delete_entity_mem(dbtype::Entity *entity_ptr)
+    {
+        if (removed_mem_owned(entity_ptr))
+        {
+            delete entity_ptr;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *InMemoryBackend::new_entity(
+        const dbtype::EntityType type,
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::Id &owner,
+        const std::string &name)
+    {
+        dbtype::Id::EntityIdType entity_id = 0;
+
+        // Do this in an inner scope so we can lock just this section
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            StoredSites::iterator site_iter = sites.find(site_id);
+
+            if (site_iter == sites.end())
+            {
+                LOG(error, "memoryinterface", "new_entity",
+                    "Site does not exist: " + text::to_string(site_id));
+                return 0;
+            }
+
+            StoredSite &site = site_iter->second;
+
+            if (site.reuse_ids.empty())
+            {
+                entity_id = site.next_entity_id++;
+            }
+            else
+            {
+                entity_id = *site.reuse_ids.begin();
+                site.reuse_ids.erase(site.reuse_ids.begin());
+            }
+        }
+
+        // Don't lock ourselves here to avoid recursive locking
+        // due to callbacks elsewhere wanting to call into us (creating new
+        // player with unique name, etc).
+        dbtype::Entity *entity_ptr = make_new_entity(
+            type,
+            dbtype::Id(site_id, entity_id),
+            owner,
+            name);
+
+        if (entity_ptr)
+        {
+            concurrency::WriterLockToken token(*entity_ptr);
+            StoredEntity stored;
+
+            stored.type = entity_ptr->get_entity_type();
+            stored.owner = owner.get_entity_id();
+            stored.name = name;
+            stored.lower_name = text::to_lower_copy(name);
+            stored.version = entity_ptr->get_entity_version();
+
+            if (not serialize_entity(entity_ptr, stored.data))
+            {
+                LOG(error, "memoryinterface", "new_entity",
+                    "Could not serialize new Entity.  Aborted.  ID: "
+                    + entity_ptr->get_entity_id().to_string(true));
+
+                delete entity_ptr;
+                entity_ptr = 0;
+            }
+            else
+            {
+                boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+                StoredSites::iterator site_iter = sites.find(site_id);
+
+                if (site_iter == sites.end())
+                {
+                    LOG(error, "memoryinterface", "new_entity",
+                        "Site was deleted while creating Entity: "
+                        + text::to_string(site_id));
+
+                    delete entity_ptr;
+                    entity_ptr = 0;
+                }
+                else
+                {
+                    site_iter->second.entities[entity_id] = stored;
+                    site_iter->second.owned[stored.owner].insert(entity_id);
+                }
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *InMemoryBackend::get_entity_db(const dbtype::Id &id)
+    {
+        dbtype::Entity *entity_ptr = get_entity_pointer(id);
+
+        if (not entity_ptr)
+        {
+            // Not in memory, deserialize a copy of what was last saved.
+            //
+            entity_ptr = load_entity_copy_db(id);
+
+            if (entity_ptr and (not added_mem_owned(entity_ptr)))
+            {
+                // Another thread loaded it at the same time.  Use theirs.
+                //
+                delete entity_ptr;
+                entity_ptr = get_entity_pointer(id);
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *InMemoryBackend::load_entity_copy_db(const dbtype::Id &id)
+    {
+        dbtype::EntityType type = dbtype::ENTITYTYPE_invalid;
+        std::string data;
+        bool has_access_stats = false;
+        dbtype::TimeStamp accessed_timestamp(false);
+        dbtype::Entity::AccessCountType access_count = 0;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            const StoredEntity * const stored_ptr =
+                find_stored_entity(id);
+
+            if (not stored_ptr)
+            {
+                return 0;
+            }
+
+            type = stored_ptr->type;
+            data = stored_ptr->data;
+            has_access_stats = stored_ptr->has_access_stats;
+            accessed_timestamp = stored_ptr->accessed_timestamp;
+            access_count = stored_ptr->access_count;
+        }
+
+        dbtype::Entity * const entity_ptr = make_deserialize_entity(
+            type,
+            data.data(),
+            data.size());
+
+        if (not entity_ptr)
+        {
+            LOG(error, "memoryinterface", "load_entity_copy_db",
+                "Could not deserialize: " + id.to_string(true));
+        }
+        else
+        {
+            if (has_access_stats)
+            {
+                entity_ptr->set_entity_accessed_timestamp(
+                    accessed_timestamp);
+                entity_ptr->set_entity_access_count(access_count);
+            }
+
+            dbtype::PropertyEntity * const property_entity_ptr =
+                dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+
+            if (property_entity_ptr)
+            {
+                // Applications are loaded when first used.
+                property_entity_ptr->
+                    set_application_properties_loader(this);
+            }
+
+            dbtype::Program * const program_ptr =
+                dynamic_cast<dbtype::Program *>(entity_ptr);
+
+            if (program_ptr)
+            {
+                // Compiled code is loaded when about to be run.
+                program_ptr->set_program_code_loader(this);
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::entity_exists_db(const dbtype::Id &id)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        return find_stored_entity(id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::save_entity_db(dbtype::Entity *entity_ptr)
+    {
+        bool success = entity_ptr and is_mem_owned(entity_ptr);
+
+        if (success)
+        {
+            concurrency::WriterLockToken token(*entity_ptr);
+            const dbtype::Id &id = entity_ptr->get_entity_id();
+            std::string data;
+
+            success = serialize_entity(entity_ptr, data);
+
+            if (not success)
+            {
+                LOG(error, "memoryinterface", "save_entity_db",
+                    "Could not serialize entity: " + id.to_string(true));
+            }
+            else
+            {
+                boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+                StoredSites::iterator site_iter =
+                    sites.find(id.get_site_id());
+                StoredEntities::iterator entity_iter;
+
+                if (site_iter != sites.end())
+                {
+                    entity_iter =
+                        site_iter->second.entities.find(id.get_entity_id());
+                }
+
+                if ((site_iter == sites.end()) or
+                    (entity_iter == site_iter->second.entities.end()))
+                {
+                    LOG(error, "memoryinterface", "save_entity_db",
+                        "Entity is not in the database: "
+                        + id.to_string(true));
+                    success = false;
+                }
+                else
+                {
+                    StoredEntity &stored = entity_iter->second;
+                    const dbtype::Id::EntityIdType owner =
+                        entity_ptr->get_entity_owner(token).get_entity_id();
+
+                    if (owner != stored.owner)
+                    {
+                        delete_owned(
+                            site_iter->second,
+                            stored.owner,
+                            id.get_entity_id());
+                        site_iter->second.owned[owner].insert(
+                            id.get_entity_id());
+                        stored.owner = owner;
+                    }
+
+                    stored.name = entity_ptr->get_entity_name(token);
+                    stored.lower_name = text::to_lower_copy(stored.name);
+                    stored.version = entity_ptr->get_entity_version();
+                    stored.data.swap(data);
+
+                    // For now, brute force update program registration
+                    // cache, since updates are expected to be rare and cheap.
+                    //
+                    dbtype::Program * const program_ptr =
+                        dynamic_cast<dbtype::Program *>(entity_ptr);
+
+                    if (program_ptr)
+                    {
+                        const std::string *code_ptr = 0;
+
+                        // If the compiled code was never loaded, what's
+                        // stored is already current.
+                        //
+                        if (program_ptr->get_compiled_code_for_save(
+                            false,
+                            code_ptr,
+                            token))
+                        {
+                            stored.compiled_code = *code_ptr;
+                        }
+
+                        delete_program_reg(site_iter->second, stored);
+
+                        const std::string reg_name =
+                            program_ptr->get_program_reg_name(token);
+
+                        if (not reg_name.empty())
+                        {
+                            const std::string lower_reg_name =
+                                text::to_lower_copy(reg_name);
+                            ProgramRegistrations &program_regs =
+                                site_iter->second.program_regs;
+
+                            if (program_regs.count(lower_reg_name))
+                            {
+                                LOG(error, "memoryinterface",
+                                    "save_entity_db",
+                                    "Program registration name already in "
+                                    "use: " + reg_name);
+                                success = false;
+                            }
+                            else
+                            {
+                                program_regs[lower_reg_name] =
+                                    id.get_entity_id();
+                                stored.program_reg_name = reg_name;
+                            }
+                        }
+                    }
+
+                    dbtype::PropertyEntity * const property_entity_ptr =
+                        dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+
+                    if (property_entity_ptr and
+                        (not save_application_properties(
+                            property_entity_ptr,
+                            token,
+                            stored)))
+                    {
+                        success = false;
+                    }
+
+                    entity_ptr->clear_dirty(token);
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::delete_entity_db(const dbtype::Id &id)
+    {
+        // Confirm not still in memory
+        const bool success = not is_mem_owned(id);
+
+        if (success and (not id.is_default()))
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            const StoredSites::iterator site_iter =
+                sites.find(id.get_site_id());
+            StoredEntities::iterator entity_iter;
+
+            if (site_iter != sites.end())
+            {
+                entity_iter =
+                    site_iter->second.entities.find(id.get_entity_id());
+            }
+
+            if ((site_iter != sites.end()) and
+                (entity_iter != site_iter->second.entities.end()))
+            {
+                StoredSite &site = site_iter->second;
+
+                // Delete from program registration if present.
+                delete_program_reg(site, entity_iter->second);
+                delete_owned(
+                    site,
+                    entity_iter->second.owner,
+                    id.get_entity_id());
+
+                site.entities.erase(entity_iter);
+
+                // Add ID for future reuse
+                site.reuse_ids.insert(id.get_entity_id());
+
+                // Delete anything referencing it or referenced by it.
+                delete_entity_references(id);
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::EntityType InMemoryBackend::get_entity_type_db(
+        const dbtype::Id &id)
+    {
+        const dbtype::EntityType mem_type = get_entity_type_mem(id);
+
+        if (mem_type != dbtype::ENTITYTYPE_invalid)
+        {
+            // In our cache of Entities in use.  Return the type.
+            return mem_type;
+        }
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredEntity * const stored_ptr = find_stored_entity(id);
+
+        return stored_ptr ? stored_ptr->type : dbtype::ENTITYTYPE_invalid;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::save_access_stats_db(const AccessStatsMap &stats)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        for (AccessStatsMap::const_iterator stats_iter = stats.begin();
+            stats_iter != stats.end();
+            ++stats_iter)
+        {
+            StoredSites::iterator site_iter =
+                sites.find(stats_iter->first.get_site_id());
+
+            if (site_iter != sites.end())
+            {
+                StoredEntities::iterator entity_iter =
+                    site_iter->second.entities.find(
+                        stats_iter->first.get_entity_id());
+
+                if (entity_iter != site_iter->second.entities.end())
+                {
+                    entity_iter->second.has_access_stats = true;
+                    entity_iter->second.accessed_timestamp =
+                        stats_iter->second.first;
+                    entity_iter->second.access_count =
+                        stats_iter->second.second;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::update_references_db(
+        const dbtype::Id &source_id,
+        const dbtype::Entity::ChangedIdFieldsMap &changed_fields)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        for (dbtype::Entity::ChangedIdFieldsMap::const_iterator field_iter =
+                changed_fields.begin();
+            field_iter != changed_fields.end();
+            ++field_iter)
+        {
+            // Removals first, then additions.
+            //
+            for (dbtype::Entity::IdSet::const_iterator removed_iter =
+                    field_iter->second.first.begin();
+                removed_iter != field_iter->second.first.end();
+                ++removed_iter)
+            {
+                remove_reference(
+                    references_from,
+                    source_id,
+                    *removed_iter,
+                    field_iter->first);
+                remove_reference(
+                    references_to,
+                    *removed_iter,
+                    source_id,
+                    field_iter->first);
+            }
+
+            for (dbtype::Entity::IdSet::const_iterator added_iter =
+                    field_iter->second.second.begin();
+                added_iter != field_iter->second.second.end();
+                ++added_iter)
+            {
+                references_from[source_id][*added_iter].insert(
+                    field_iter->first);
+                references_to[*added_iter][source_id].insert(
+                    field_iter->first);
+            }
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector InMemoryBackend::get_references_to_db(
+        const dbtype::Id &target_id,
+        const dbtype::EntityField field)
+    {
+        dbtype::Entity::IdVector result;
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const ReferenceIndex::const_iterator target_iter =
+            references_to.find(target_id);
+
+        if (target_iter != references_to.end())
+        {
+            for (dbtype::Entity::IdFieldsMap::const_iterator source_iter =
+                    target_iter->second.begin();
+                source_iter != target_iter->second.end();
+                ++source_iter)
+            {
+                if (source_iter->second.count(field))
+                {
+                    result.push_back(source_iter->first);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdFieldsMap InMemoryBackend::get_references_from_db(
+        const dbtype::Id &source_id)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const ReferenceIndex::const_iterator source_iter =
+            references_from.find(source_id);
+
+        if (source_iter == references_from.end())
+        {
+            return dbtype::Entity::IdFieldsMap();
+        }
+
+        return source_iter->second;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector InMemoryBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::EntityType type,
+        const dbtype::Id::EntityIdType owner_id,
+        const std::string &name,
+        const bool exact)
+    {
+        dbtype::Entity::IdVector result;
+
+        if (not site_id)
+        {
+            LOG(error, "memoryinterface", "find_in_db()",
+                "Site was not specified; cannot search");
+            return result;
+        }
+
+        if ((type == dbtype::ENTITYTYPE_invalid) and (not owner_id) and
+            name.empty())
+        {
+            LOG(error, "memoryinterface", "find_in_db()",
+                "Bad combination of parameters given; cannot search");
+            return result;
+        }
+
+        // Like the SQLite backend, exact matches are only done when
+        // searching by type.
+        //
+        const std::string lower_name = text::to_lower_copy(name);
+        const bool match_exact =
+            exact and (type != dbtype::ENTITYTYPE_invalid);
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return result;
+        }
+
+        const StoredSite &site = site_iter->second;
+
+        if (owner_id)
+        {
+            // Only need to look at what the owner owns.
+            //
+            const OwnerIndex::const_iterator owned_iter =
+                site.owned.find(owner_id);
+
+            if (owned_iter != site.owned.end())
+            {
+                for (std::set<dbtype::Id::EntityIdType>::const_iterator
+                        id_iter = owned_iter->second.begin();
+                    id_iter != owned_iter->second.end();
+                    ++id_iter)
+                {
+                    const StoredEntities::const_iterator entity_iter =
+                        site.entities.find(*id_iter);
+
+                    if ((entity_iter != site.entities.end()) and
+                        search_matches(
+                            entity_iter->second,
+                            type,
+                            lower_name,
+                            match_exact))
+                    {
+                        result.push_back(dbtype::Id(site_id, *id_iter));
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (StoredEntities::const_iterator entity_iter =
+                    site.entities.begin();
+                entity_iter != site.entities.end();
+                ++entity_iter)
+            {
+                if (search_matches(
+                    entity_iter->second,
+                    type,
+                    lower_name,
+                    match_exact))
+                {
+                    result.push_back(dbtype::Id(site_id, entity_iter->first));
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector InMemoryBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        dbtype::Entity::IdVector result;
+
+        if (not site_id)
+        {
+            LOG(error, "memoryinterface", "find_in_db(site)",
+                "Site was not specified; cannot search");
+            return result;
+        }
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter != sites.end())
+        {
+            result.reserve(site_iter->second.entities.size());
+
+            for (StoredEntities::const_iterator entity_iter =
+                    site_iter->second.entities.begin();
+                entity_iter != site_iter->second.entities.end();
+                ++entity_iter)
+            {
+                result.push_back(dbtype::Id(site_id, entity_iter->first));
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector InMemoryBackend::get_recently_accessed_db(
+        const dbtype::Id::SiteIdType site_id,
+        const size_t max_entities)
+    {
+        dbtype::Entity::IdVector result;
+        std::vector<AccessedEntity> accessed;
+
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            const StoredSites::const_iterator site_iter =
+                sites.find(site_id);
+
+            if (site_iter == sites.end())
+            {
+                return result;
+            }
+
+            for (StoredEntities::const_iterator entity_iter =
+                    site_iter->second.entities.begin();
+                entity_iter != site_iter->second.entities.end();
+                ++entity_iter)
+            {
+                if (entity_iter->second.has_access_stats)
+                {
+                    AccessedEntity entry;
+
+                    entry.entity_id = entity_iter->first;
+                    entry.accessed =
+                        entity_iter->second.accessed_timestamp.get_time();
+                    entry.count = entity_iter->second.access_count;
+
+                    accessed.push_back(entry);
+                }
+            }
+        }
+
+        const size_t count = std::min(max_entities, accessed.size());
+
+        std::partial_sort(
+            accessed.begin(),
+            accessed.begin() + count,
+            accessed.end());
+
+        result.reserve(count);
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            result.push_back(dbtype::Id(site_id, accessed[index].entity_id));
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id InMemoryBackend::find_program_reg_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &registration_name)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter != sites.end())
+        {
+            const ProgramRegistrations::const_iterator reg_iter =
+                site_iter->second.program_regs.find(
+                    text::to_lower_copy(registration_name));
+
+            if (reg_iter != site_iter->second.program_regs.end())
+            {
+                return dbtype::Id(site_id, reg_iter->second);
+            }
+        }
+
+        return dbtype::Id();
+    }
+
+    // ----------------------------------------------------------------------
+    std::string InMemoryBackend::find_program_reg_name_in_db(
+        const dbtype::Id &id)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredEntity * const stored_ptr = find_stored_entity(id);
+
+        return stored_ptr ? stored_ptr->program_reg_name : std::string();
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id::SiteIdVector InMemoryBackend::get_site_ids_in_db(void)
+    {
+        dbtype::Id::SiteIdVector result;
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        result.reserve(sites.size());
+
+        for (StoredSites::const_iterator site_iter = sites.begin();
+            site_iter != sites.end();
+            ++site_iter)
+        {
+            result.push_back(site_iter->first);
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::EntityMetadata InMemoryBackend::get_entity_metadata(
+        const dbtype::Id &id)
+    {
+        dbinterface::EntityMetadata result;
+
+        // See if in memory;  If so, use that version instead
+        if (is_mem_owned(id))
+        {
+            get_metadata_in_mem(id, result);
+        }
+        else
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+            get_metadata_internal(id, result);
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::MetadataVector InMemoryBackend::get_entity_metadata(
+        const dbtype::Entity::IdVector &ids)
+    {
+        dbinterface::MetadataVector result;
+        std::vector<const dbtype::Id *> not_in_mem;
+
+        result.reserve(ids.size());
+        not_in_mem.reserve(ids.size());
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            if (is_mem_owned(*id_iter))
+            {
+                result.push_back(dbinterface::EntityMetadata());
+                get_metadata_in_mem(*id_iter, result.back());
+
+                if (not result.back().valid())
+                {
+                    result.pop_back();
+                }
+            }
+            else
+            {
+                not_in_mem.push_back(&(*id_iter));
+            }
+        }
+
+        if (not not_in_mem.empty())
+        {
+            // Do them all at once under the same lock.
+            //
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            for (std::vector<const dbtype::Id *>::const_iterator id_ptr_iter =
+                    not_in_mem.begin();
+                id_ptr_iter != not_in_mem.end();
+                ++id_ptr_iter)
+            {
+                result.push_back(dbinterface::EntityMetadata());
+                get_metadata_internal(**id_ptr_iter, result.back());
+
+                if (not result.back().valid())
+                {
+                    result.pop_back();
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::new_site_in_db(dbtype::Id::SiteIdType &site_id)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        // Reuse a deleted site if possible, otherwise get a new one.
+        //
+        if (reuse_site_ids.empty())
+        {
+            site_id = next_site_id++;
+        }
+        else
+        {
+            site_id = *reuse_site_ids.begin();
+            reuse_site_ids.erase(reuse_site_ids.begin());
+        }
+
+        StoredSite &site = sites[site_id];
+
+        site.name = "Untitled Site " + text::to_string(site_id);
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::delete_site_in_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        const StoredSites::iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return false;
+        }
+
+        // Delete anything referencing the site's Entities or referenced
+        // by them.
+        //
+        for (StoredEntities::const_iterator entity_iter =
+                site_iter->second.entities.begin();
+            entity_iter != site_iter->second.entities.end();
+            ++entity_iter)
+        {
+            delete_entity_references(dbtype::Id(site_id, entity_iter->first));
+        }
+
+        sites.erase(site_iter);
+        reuse_site_ids.insert(site_id);
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::get_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_name)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            site_name.clear();
+            return false;
+        }
+
+        site_name = site_iter->second.name;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::set_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_name)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        const StoredSites::iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return false;
+        }
+
+        site_iter->second.name = site_name;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::get_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_description)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredSites::const_iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            site_description.clear();
+            return false;
+        }
+
+        site_description = site_iter->second.description;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::set_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_description)
+    {
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        const StoredSites::iterator site_iter = sites.find(site_id);
+
+        if (site_iter == sites.end())
+        {
+            return false;
+        }
+
+        site_iter->second.description = site_description;
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::load_application_properties(
+        const dbtype::Id &entity_id,
+        const std::string &application,
+        dbtype::ApplicationProperties &properties)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredEntity * const stored_ptr = find_stored_entity(entity_id);
+
+        if (stored_ptr)
+        {
+            const StoredApplications::const_iterator app_iter =
+                stored_ptr->applications.find(application);
+
+            if (app_iter != stored_ptr->applications.end())
+            {
+                return deserialize_application_properties(
+                    app_iter->second.data(),
+                    app_iter->second.size(),
+                    properties);
+            }
+        }
+
+        LOG(error, "memoryinterface", "load_application_properties",
+            "Application " + application + " not found for Entity "
+            + entity_id.to_string(true));
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::load_compiled_code(
+        const dbtype::Id &program_id,
+        std::string &compiled_code)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        const StoredEntity * const stored_ptr = find_stored_entity(program_id);
+
+        if (not stored_ptr)
+        {
+            LOG(error, "memoryinterface", "load_compiled_code",
+                "Program not found: " + program_id.to_string(true));
+
+            return false;
+        }
+
+        compiled_code = stored_ptr->compiled_code;
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    const InMemoryBackend::StoredEntity *InMemoryBackend::find_stored_entity(
+        const dbtype::Id &id) const
+    {
+        const StoredSites::const_iterator site_iter =
+            sites.find(id.get_site_id());
+
+        if (site_iter != sites.end())
+        {
+            const StoredEntities::const_iterator entity_iter =
+                site_iter->second.entities.find(id.get_entity_id());
+
+            if (entity_iter != site_iter->second.entities.end())
+            {
+                return &entity_iter->second;
+            }
+        }
+
+        return 0;
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::delete_program_reg(
+        StoredSite &site,
+        StoredEntity &stored)
+    {
+        if (not stored.program_reg_name.empty())
+        {
+            site.program_regs.erase(
+                text::to_lower_copy(stored.program_reg_name));
+            stored.program_reg_name.clear();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::delete_owned(
+        StoredSite &site,
+        const dbtype::Id::EntityIdType owner,
+        const dbtype::Id::EntityIdType entity_id)
+    {
+        const OwnerIndex::iterator owned_iter = site.owned.find(owner);
+
+        if (owned_iter != site.owned.end())
+        {
+            owned_iter->second.erase(entity_id);
+
+            if (owned_iter->second.empty())
+            {
+                site.owned.erase(owned_iter);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::search_matches(
+        const StoredEntity &stored,
+        const dbtype::EntityType type,
+        const std::string &lower_name,
+        const bool exact)
+    {
+        if ((type != dbtype::ENTITYTYPE_invalid) and (stored.type != type))
+        {
+            return false;
+        }
+
+        if (lower_name.empty())
+        {
+            return true;
+        }
+
+        if (exact)
+        {
+            return stored.lower_name == lower_name;
+        }
+
+        return stored.lower_name.find(lower_name) != std::string::npos;
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::get_metadata_internal(
+        const dbtype::Id &id,
+        dbinterface::EntityMetadata &metadata) const
+    {
+        const StoredEntity * const stored_ptr = find_stored_entity(id);
+
+        if (not stored_ptr)
+        {
+            metadata.reset();
+        }
+        else
+        {
+            metadata.set(
+                id,
+                dbtype::Id(id.get_site_id(), stored_ptr->owner),
+                stored_ptr->type,
+                stored_ptr->version,
+                stored_ptr->name);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::get_metadata_in_mem(
+        const dbtype::Id &id,
+        dbinterface::EntityMetadata &metadata)
+    {
+        dbinterface::EntityRef entity_ref =
+            dbinterface::DatabaseAccess::instance()->get_entity(id);
+
+        if (not entity_ref.valid())
+        {
+            metadata.reset();
+        }
+        else
+        {
+            concurrency::ReaderLockToken token(*entity_ref.get());
+
+            metadata.set(
+                id,
+                entity_ref->get_entity_owner(token),
+                entity_ref->get_entity_type(),
+                entity_ref->get_entity_version(),
+                entity_ref->get_entity_name(token));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool InMemoryBackend::save_application_properties(
+        dbtype::PropertyEntity *entity_ptr,
+        concurrency::WriterLockToken &token,
+        StoredEntity &stored)
+    {
+        dbtype::PropertyEntity::ApplicationNameSet applications;
+        bool success = entity_ptr->get_changed_applications(applications, token);
+
+        for (dbtype::PropertyEntity::ApplicationNameSet::const_iterator
+                app_iter = applications.begin();
+            app_iter != applications.end();
+            ++app_iter)
+        {
+            const dbtype::ApplicationProperties *properties_ptr = 0;
+
+            // If the application was never loaded, what's stored is
+            // already current.
+            //
+            if (entity_ptr->get_application_properties_for_save(
+                *app_iter,
+                properties_ptr,
+                token))
+            {
+                if (not properties_ptr)
+                {
+                    // Null properties means the application was removed.
+                    stored.applications.erase(*app_iter);
+                }
+                else if (not serialize_application_properties(
+                    *properties_ptr,
+                    stored.applications[*app_iter]))
+                {
+                    LOG(error, "memoryinterface",
+                        "save_application_properties",
+                        "Could not serialize application " + *app_iter
+                        + " for Entity "
+                        + entity_ptr->get_entity_id().to_string(true));
+
+                    stored.applications.erase(*app_iter);
+                    success = false;
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::remove_reference(
+        ReferenceIndex &index,
+        const dbtype::Id &key_id,
+        const dbtype::Id &other_id,
+        const dbtype::EntityField field)
+    {
+        const ReferenceIndex::iterator key_iter = index.find(key_id);
+
+        if (key_iter != index.end())
+        {
+            const dbtype::Entity::IdFieldsMap::iterator other_iter =
+                key_iter->second.find(other_id);
+
+            if (other_iter != key_iter->second.end())
+            {
+                other_iter->second.erase(field);
+
+                if (other_iter->second.empty())
+                {
+                    key_iter->second.erase(other_iter);
+
+                    if (key_iter->second.empty())
+                    {
+                        index.erase(key_iter);
+                    }
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void InMemoryBackend::delete_entity_references(const dbtype::Id &id)
+    {
+        // Everything it references no longer has it as a source.
+        //
+        ReferenceIndex::iterator from_iter = references_from.find(id);
+
+        if (from_iter != references_from.end())
+        {
+            for (dbtype::Entity::IdFieldsMap::const_iterator target_iter =
+                    from_iter->second.begin();
+                target_iter != from_iter->second.end();
+                ++target_iter)
+            {
+                const ReferenceIndex::iterator to_iter =
+                    references_to.find(target_iter->first);
+
+                if (to_iter != references_to.end())
+                {
+                    to_iter->second.erase(id);
+
+                    if (to_iter->second.empty())
+                    {
+                        references_to.erase(to_iter);
+                    }
+                }
+            }
+
+            references_from.erase(from_iter);
+        }
+
+        // Everything referencing it no longer has it as a target.
+        //
+        ReferenceIndex::iterator to_iter = references_to.find(id);
+
+        if (to_iter != references_to.end())
+        {
+            for (dbtype::Entity::IdFieldsMap::const_iterator source_iter =
+                    to_iter->second.begin();
+                source_iter != to_iter->second.end();
+                ++source_iter)
+            {
+                const ReferenceIndex::iterator source_from_iter =
+                    references_from.find(source_iter->first);
+
+                if (source_from_iter != references_from.end())
+                {
+                    source_from_iter->second.erase(id);
+
+                    if (source_from_iter->second.empty())
+                    {
+                        references_from.erase(source_from_iter);
+                    }
+                }
+            }
+
+            references_to.erase(to_iter);
+        }
+    }
+}
+}
@@ -0,0 +1,554 @@
+/*
+ * memoryinterface_InMemoryBackend.h
+ */
+
+#ifndef MUTGOS_MEMORYINTERFACE_INMEMORYBACKEND_H
+#define MUTGOS_MEMORYINTERFACE_INMEMORYBACKEND_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "dbinterface/dbinterface_EntityMetadata.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_TimeStamp.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_ApplicationPropertiesLoader.h"
+#include "dbtypes/dbtype_ProgramCodeLoader.h"
+
+#include "concurrency/concurrency_WriterLockToken.h"
+
+namespace mutgos
+{
+namespace memoryinterface
+{
+    /**
+     * Implements a DbBackend that keeps everything in memory and never
+     * writes anything out.  The database starts out empty every time and
+     * is lost on shutdown.  This is meant for benchmarks and tests, so the
+     * cost of the cache, security and primitives can be measured without
+     * disk I/O getting in the way.
+     *
+     * It otherwise behaves like the SQLite backend: Entities are stored
+     * serialized, so loading and saving one costs what it would with a
+     * real database minus the I/O, and the application properties of each
+     * PropertyEntity (and the compiled code of each Program) are stored
+     * separately and loaded the first time they are accessed.  Searches,
+     * program registrations, the reference index, access statistics,
+     * metadata and ID reuse are all supported.  Name searches are case
+     * insensitive, and are done by going through every Entity in the
+     * site.
+     *
+     * Transactions, bulk loads and backups use the DbBackend defaults,
+     * since every change is applied immediately.
+     *
+     * All stored data is guarded by a single reader/writer lock, so loads
+     * and searches can run in parallel.  Entities are serialized and
+     * deserialized outside of the lock.
+     */
+    class InMemoryBackend : public dbinterface::DbBackend,
+        public dbtype::ApplicationPropertiesLoader,
+        public dbtype::ProgramCodeLoader
+    {
+    public:
+        /**
+         * Constructor.
+         */
+        InMemoryBackend(void);
+
+        /**
+         * Destructor.
+         */
+        virtual ~InMemoryBackend();
+
+        /**
+         * Informs the DbBackend that it is to be shut down.  Everything
+         * stored is discarded.
+         * @return True if success, false if Entities are still in memory.
+         */
+        virtual bool shutdown(void);
+
+        /**
+         * @return The name of this backend.  This should be a string
+         * suitable for logging and display and is for informational
+         * purposes only.
+         */
+        virtual std::string get_backend_name(void);
+
+        /**
+         * @param entity_ptr[in] A pointer to an Entity.
+         * @return True if this pointer was created by this DbBackend.  If
+         * true, when Entity is to be deleted from memory, you MUST use
+         * delete_entity_mem().
+         */
+        virtual bool entity_mem_owned_by_this(
+            const dbtype::Entity *entity_ptr);
+
+        /**
+         * Deletes the given entity from memory, if owned by this DbBackend.
+         * The Entity will NOT be deleted from the database.
+         * @param entity_ptr[in] The entity pointer to delete from memory.
+         */
+        virtual void delete_entity_mem(dbtype::Entity *entity_ptr);
+
+        /**
+         * Creates a new Entity of the given type (version 0), in memory and the
+         * database.
+         * Caller must manage pointer and delete it with delete_entity_mem().
+         * @param type[in] The type of Entity to create.
+         * @param site_id[in] The valid Site ID the Entity is associated with.
+         * @param owner[in] The owner of the new Entity.
+         * @param name[in] The name of the new Entity.
+         * @return The newly created entity as a pointer, or null if error.
+         */
+        virtual dbtype::Entity *new_entity(
+            const dbtype::EntityType type,
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::Id &owner,
+            const std::string &name);
+
+        /**
+         * Gets the Entity from the database.  If the Entity is already
+         * present in memory, the existing pointer is returned.
+         * Caller must manage pointer and delete it with delete_entity_mem().
+         * @param id[in] The ID of the Entity to retrieve.
+         * @return A pointer to the Entity retrieved, or null if not found.
+         */
+        virtual dbtype::Entity *get_entity_db(const dbtype::Id &id);
+
+        /**
+         * Determines if the given entity ID exists in the database.
+         * @param id[in] The ID to check.
+         * @return True if it exists, false if not.
+         */
+        virtual bool entity_exists_db(const dbtype::Id &id);
+
+        /**
+         * Saves the given Entity to the database.  Existing Entity data for
+         * that ID and version are overwritten.
+         * @param entity_ptr[in] The Entity to save.
+         * @return True if success.
+         */
+        virtual bool save_entity_db(dbtype::Entity *entity_ptr);
+
+        /**
+         * Deletes the given Entity from the database.  If the Entity is
+         * currently in memory, deletion will fail.
+         * @param id[in] The ID of the Entity to delete.
+         * @return True if success (or does not exist), false if failure.
+         */
+        virtual bool delete_entity_db(const dbtype::Id &id);
+
+        /**
+         * Deleted entities are included in this query.
+         * @param id[in] The ID whose type is to be retrieved.
+         * @return The type of the given ID, or 'invalid' if not found.
+         */
+        virtual dbtype::EntityType get_entity_type_db(const dbtype::Id &id);
+
+        /**
+         * Saves the access statistics (last accessed timestamp and access
+         * count) of Entities, to be applied when they are next loaded.
+         * Statistics for Entities that do not exist are ignored.
+         * @param stats[in] The access statistics to save.
+         * @return True if success.
+         */
+        virtual bool save_access_stats_db(const AccessStatsMap &stats);
+
+        /**
+         * Updates the reference index with the ID fields that changed on
+         * an Entity.
+         * @param source_id[in] The ID of the Entity whose fields changed.
+         * @param changed_fields[in] The IDs removed and added, per field.
+         * @return True if success.
+         */
+        virtual bool update_references_db(
+            const dbtype::Id &source_id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields);
+
+        /**
+         * Uses the reference index to find the Entities referencing an
+         * Entity by a particular field.
+         * @param target_id[in] The ID of the Entity being referenced.
+         * @param field[in] The field on the other Entities doing the
+         * referencing.
+         * @return The IDs of the Entities whose field references target_id,
+         * or empty if none or error.
+         */
+        virtual dbtype::Entity::IdVector get_references_to_db(
+            const dbtype::Id &target_id,
+            const dbtype::EntityField field);
+
+        /**
+         * Uses the reference index to find everything an Entity references.
+         * @param source_id[in] The ID of the Entity doing the referencing.
+         * @return A map of the referenced IDs to the fields on source_id
+         * that reference them, or empty if none or error.
+         */
+        virtual dbtype::Entity::IdFieldsMap get_references_from_db(
+            const dbtype::Id &source_id);
+
+        /**
+         * Searches for entities using the parameters specified that
+         * contain the given string somewhere in their name, or an exact
+         * name match if specified.
+         * @param site_id[in] The site to search within.
+         * @param type[in] The type of entity to search for, or invalid
+         * for all types.
+         * @param owner_id[in] The ID of the owner, or default for all owners.
+         * @param name[in] The name of the Entity to look for.  Can be empty
+         * in some situations to search for all names.
+         * @param exact[in] If true, match name exactly.  Note you may still
+         * get multiple matches depending on the type.  This is ignored
+         * when no name given.
+         * @return The matching IDs, or empty if none.
+         */
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::EntityType type,
+            const dbtype::Id::EntityIdType owner_id,
+            const std::string &name,
+            const bool exact);
+
+        /**
+         * @param site_id[in] The site ID to get all IDs for.
+         * @return All valid Entity IDs for the given site, or empty if none
+         * or site doesn't exist.
+         */
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * @param site_id[in] The site to get Entity IDs for.
+         * @param max_entities[in] The most IDs to return.
+         * @return The IDs of the site's Entities, most recently accessed
+         * first (and then most accessed), up to max_entities.
+         */
+        virtual dbtype::Entity::IdVector get_recently_accessed_db(
+            const dbtype::Id::SiteIdType site_id,
+            const size_t max_entities);
+
+        /**
+         * Searches the given site for the program registration name.
+         * @param site_id[in] The site ID to search for the program
+         * registration name.
+         * @param registration_name[in] The program registration name to
+         * find.
+         * @return The ID of the Program found, or default/invalid if none
+         * found matching or the site is invalid.
+         */
+        virtual dbtype::Id find_program_reg_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &registration_name);
+
+        /**
+         * Searches for the given ID and determines if a registration
+         * is associated with it.
+         * @param id[in] The ID to search for.
+         * @return The registration name of the Program found, or empty if none
+         * found matching or the ID is invalid.
+         */
+        virtual std::string find_program_reg_name_in_db(
+            const dbtype::Id &id);
+
+        /**
+         * @return A list of all known site IDs in the database.
+         */
+        virtual dbtype::Id::SiteIdVector get_site_ids_in_db(void);
+
+        /**
+         * Gets the metadata for a single Entity.
+         * @param id[in] The ID of the entity to get metadata for.
+         * @return The Metadata for the Entity, or invalid if not found.
+         */
+        virtual dbinterface::EntityMetadata get_entity_metadata(
+            const dbtype::Id &id);
+
+        /**
+         * Gets the metadata for a group of Entities.
+         * @param ids[in] The IDs of the entities to get metadata for.
+         * @return The Metadata for the Entities, or empty if not found.
+         * If only a few Entities cannot be found, there will simply not be
+         * an entry for them.
+         */
+        virtual dbinterface::MetadataVector get_entity_metadata(
+            const dbtype::Entity::IdVector &ids);
+
+        /**
+         * Creates a new site in the database.
+         * @param site_id[out] The ID of the site that was created, if success.
+         * @return True if successfully created the new site (site_id will be
+         * populated if so).
+         */
+        virtual bool new_site_in_db(dbtype::Id::SiteIdType &site_id);
+
+        /**
+         * Deletes a site and all its entities in the database.  The site ID
+         * will then be available for reuse.
+         * @param site_id[in] The site ID to delete.
+         * @return True if success, false if the site ID cannot be found.
+         */
+        virtual bool delete_site_in_db(const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * Gets the name for a site.
+         * @param site_id[in] The existing site ID to get the name for.
+         * @param site_name[out] The site name, or empty if error or none.
+         * @return True if successfully retrieved the site name.
+         */
+        virtual bool get_site_name_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            std::string &site_name);
+
+        /**
+         * Sets the name for a site.
+         * @param site_id[in] The existing site ID to set the name for.
+         * @param site_name[in] The site's new name.
+         * @return True if successfully set the site name.
+         */
+        virtual bool set_site_name_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &site_name);
+
+        /**
+         * Gets the description for a site.
+         * @param site_id[in] The existing site ID to get the description for.
+         * @param site_description[out] The site description, or empty if
+         * error or none.
+         * @return True if successfully retrieved the site description.
+         */
+        virtual bool get_site_description_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            std::string &site_description);
+
+        /**
+         * Sets the description for a site.
+         * @param site_id[in] The existing site ID to set the description for.
+         * @param site_description[in] The site's new description.
+         * @return True if successfully set the site description.
+         */
+        virtual bool set_site_description_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &site_description);
+
+        /**
+         * Loads an application's properties from memory.
+         * @param entity_id[in] The ID of the PropertyEntity that owns the
+         * application.
+         * @param application[in] The name of the application to load.
+         * @param properties[out] The loaded application properties.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_application_properties(
+            const dbtype::Id &entity_id,
+            const std::string &application,
+            dbtype::ApplicationProperties &properties);
+
+        /**
+         * Loads a Program's compiled code from memory.
+         * @param program_id[in] The ID of the Program.
+         * @param compiled_code[out] The loaded compiled code.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_compiled_code(
+            const dbtype::Id &program_id,
+            std::string &compiled_code);
+
+    protected:
+        /**
+         * Deserializes a new copy of an Entity from what was last saved.
+         * The copy is not owned by this backend.
+         * Caller must manage the pointer.
+         * @param id[in] The ID of the Entity to load.
+         * @return The copy, or null if not found or error.
+         */
+        virtual dbtype::Entity *load_entity_copy_db(const dbtype::Id &id);
+
+    private:
+        /** Maps application name to its serialized properties */
+        typedef std::map<std::string, std::string> StoredApplications;
+
+        /**
+         * An Entity as it was last saved.
+         */
+        struct StoredEntity
+        {
+            StoredEntity(void)
+              : type(dbtype::ENTITYTYPE_invalid),
+                owner(0),
+                version(0),
+                has_access_stats(false),
+                access_count(0)
+              { }
+
+            dbtype::EntityType type; ///< Type of the Entity
+            dbtype::Id::EntityIdType owner; ///< Owner, in the same site
+            std::string name; ///< Name of the Entity
+            std::string lower_name; ///< Lowercase name, for searches
+            dbtype::Entity::VersionType version; ///< Version when saved
+            std::string data; ///< The serialized Entity
+            StoredApplications applications; ///< Serialized applications
+            std::string compiled_code; ///< Program compiled code, if any
+            std::string program_reg_name; ///< Program registration, if any
+            bool has_access_stats; ///< True if stats below were saved
+            dbtype::TimeStamp accessed_timestamp; ///< When last accessed
+            dbtype::Entity::AccessCountType access_count; ///< Times accessed
+        };
+
+        /** Maps Entity ID to the stored Entity */
+        typedef std::map<dbtype::Id::EntityIdType, StoredEntity>
+            StoredEntities;
+        /** Maps lowercase program registration name to Program ID */
+        typedef std::map<std::string, dbtype::Id::EntityIdType>
+            ProgramRegistrations;
+        /** Maps an owner to the Entities it owns, in the same site */
+        typedef std::map<dbtype::Id::EntityIdType,
+            std::set<dbtype::Id::EntityIdType> > OwnerIndex;
+
+        /**
+         * A site and everything in it.
+         */
+        struct StoredSite
+        {
+            StoredSite(void)
+              : next_entity_id(1)
+              { }
+
+            std::string name; ///< Name of the site
+            std::string description; ///< Description of the site
+            StoredEntities entities; ///< All Entities in the site
+            ProgramRegistrations program_regs; ///< Registered Programs
+            OwnerIndex owned; ///< Entities by owner, for searches
+            std::set<dbtype::Id::EntityIdType> reuse_ids; ///< Deleted IDs
+            dbtype::Id::EntityIdType next_entity_id; ///< Next unused ID
+        };
+
+        /** Maps site ID to the site */
+        typedef std::map<dbtype::Id::SiteIdType, StoredSite> StoredSites;
+        /** Maps an Entity ID to the IDs it references (or is referenced
+            by) and the fields doing the referencing */
+        typedef std::map<dbtype::Id, dbtype::Entity::IdFieldsMap>
+            ReferenceIndex;
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param id[in] The ID of the Entity to find.
+         * @return The stored Entity, or null if not found.
+         */
+        const StoredEntity *find_stored_entity(const dbtype::Id &id) const;
+
+        /**
+         * Removes the program registration of a stored Entity, if any.
+         * Mutex must be exclusively locked before calling.
+         * @param site[in,out] The site the Entity is in.
+         * @param stored[in,out] The stored Entity.
+         */
+        static void delete_program_reg(StoredSite &site, StoredEntity &stored);
+
+        /**
+         * Removes an Entity from its owner's entry in the owner index.
+         * Mutex must be exclusively locked before calling.
+         * @param site[in,out] The site the Entity is in.
+         * @param owner[in] The owner of the Entity.
+         * @param entity_id[in] The ID of the Entity.
+         */
+        static void delete_owned(
+            StoredSite &site,
+            const dbtype::Id::EntityIdType owner,
+            const dbtype::Id::EntityIdType entity_id);
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param stored[in] The stored Entity to check.
+         * @param type[in] The type to match, or invalid for all types.
+         * @param lower_name[in] The lowercase name to match, or empty
+         * for all names.
+         * @param exact[in] True if the name must match exactly, false
+         * for a substring match.
+         * @return True if the stored Entity matches the search.
+         */
+        static bool search_matches(
+            const StoredEntity &stored,
+            const dbtype::EntityType type,
+            const std::string &lower_name,
+            const bool exact);
+
+        /**
+         * Mutex must be locked (either way) before calling.
+         * @param id[in] The ID of the Entity to find.
+         * @param metadata[out] The metadata for the stored Entity, or reset
+         * if not found.
+         */
+        void get_metadata_internal(
+            const dbtype::Id &id,
+            dbinterface::EntityMetadata &metadata) const;
+
+        /**
+         * Gets the metadata of an Entity that is in memory, since it may
+         * have changes that were not saved yet.  Mutex must NOT be
+         * locked before calling.
+         * @param id[in] The ID of the Entity in memory.
+         * @param metadata[out] The metadata for the Entity, or reset if
+         * not found.
+         */
+        void get_metadata_in_mem(
+            const dbtype::Id &id,
+            dbinterface::EntityMetadata &metadata);
+
+        /**
+         * Saves the applications of a PropertyEntity that have changed.
+         * The Entity must be locked.  Mutex must be exclusively locked
+         * before calling.
+         * @param entity_ptr[in] The PropertyEntity being saved.
+         * @param token[in] The lock token for the Entity.
+         * @param stored[in,out] Where the Entity is stored.
+         * @return True if success.
+         */
+        bool save_application_properties(
+            dbtype::PropertyEntity *entity_ptr,
+            concurrency::WriterLockToken &token,
+            StoredEntity &stored);
+
+        /**
+         * Removes a single reference from an index.  Mutex must be
+         * exclusively locked before calling.
+         * @param index[in,out] The index to remove from.
+         * @param key_id[in] The ID the index is keyed by.
+         * @param other_id[in] The ID on the other side of the reference.
+         * @param field[in] The field doing the referencing.
+         */
+        static void remove_reference(
+            ReferenceIndex &index,
+            const dbtype::Id &key_id,
+            const dbtype::Id &other_id,
+            const dbtype::EntityField field);
+
+        /**
+         * Removes every reference to or from an Entity from the reference
+         * index.  Mutex must be exclusively locked before calling.
+         * @param id[in] The ID of the Entity.
+         */
+        void delete_entity_references(const dbtype::Id &id);
+
+        boost::shared_mutex mutex; ///< Guards everything below
+        StoredSites sites; ///< All sites and their Entities
+        std::set<dbtype::Id::SiteIdType> reuse_site_ids; ///< Deleted sites
+        dbtype::Id::SiteIdType next_site_id; ///< Next unused site ID
+        ReferenceIndex references_from; ///< Source to targets and fields
+        ReferenceIndex references_to; ///< Target to sources and fields
+
+        // No copying
+        //
+        InMemoryBackend(const InMemoryBackend &rhs);
+        InMemoryBackend &operator=(const InMemoryBackend &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_MEMORYINTERFACE_INMEMORYBACKEND_H
@@ -2466,16 +2466,14 @@ namespace primitives
         const bool want_non_actions = (entity_types == CONTENTS_NON_ACTIONS_ONLY) or
             (entity_types == CONTENTS_ALL);
         const bool want_puppets_only = (entity_types == CONTENTS_PUPPETS_ONLY);
-        dbinterface::EntityRef entity_ref;
+        dbinterface::EntityRefVector entity_refs =
+            db_access->get_entities(contents);
 
         effective_contents.reserve(contents.size());
 
-        for (dbtype::Entity::IdVector::const_iterator id_iter =
-                contents.begin();
-            id_iter != contents.end();
-            ++id_iter)
+        for (size_t index = 0; index < contents.size(); ++index)
         {
-            entity_ref = db_access->get_entity(*id_iter);
+            dbinterface::EntityRef &entity_ref = entity_refs[index];
 
             if (entity_ref.valid())
             {
@@ -2483,7 +2481,7 @@ namespace primitives
                     dynamic_cast<dbtype::ActionEntity *>(entity_ref.get()))
                 {
                     // This is an action.  We can just add it as-is.
-                    effective_contents.push_back(*id_iter);
+                    effective_contents.push_back(contents[index]);
                 }
                 else if (dynamic_cast<dbtype::ContainerPropertyEntity *>(
                     entity_ref.get()))
@@ -2496,19 +2494,19 @@ namespace primitives
                     {
                         if (entity_ref.type() == dbtype::ENTITYTYPE_puppet)
                         {
-                            effective_contents.push_back(*id_iter);
+                            effective_contents.push_back(contents[index]);
                         }
                     }
                     else if (want_non_actions)
                     {
-                        effective_contents.push_back(*id_iter);
+                        effective_contents.push_back(contents[index]);
                     }
 
                     if (want_actions)
                     {
                         get_contents(
                             context,
-                            *id_iter,
+                            contents[index],
                             CONTENTS_ACTIONS_ONLY,
                             effective_contents,
                             false);
@@ -2535,14 +2533,12 @@ namespace primitives
 
         dbinterface::DatabaseAccess * const db_access =
             dbinterface::DatabaseAccess::instance();
+        dbinterface::EntityRefVector entity_refs =
+            db_access->get_entities(contents);
 
-        for (dbtype::Entity::IdVector::const_iterator entity_iter =
-            contents.begin();
-             entity_iter != contents.end();
-             ++entity_iter)
+        for (size_t index = 0; index < contents.size(); ++index)
         {
-            dbinterface::EntityRef entity_ref =
-                db_access->get_entity(*entity_iter);
+            dbinterface::EntityRef &entity_ref = entity_refs[index];
 
             if (entity_ref.valid())
             {
@@ -2583,7 +2579,7 @@ namespace primitives
                         {
                             // Found a better, exact match.
                             //
-                            found_entity = *entity_iter;
+                            found_entity = contents[index];
                             found_exact_match = true;
                             ambiguous = false;
                             matched_something = true;
@@ -2622,10 +2618,10 @@ namespace primitives
                             // Found a better (exact) match.
                             //
                             found_exact_match = true;
-                            found_entity = *entity_iter;
+                            found_entity = contents[index];
                         }
                         else if ((found_exact_match and temp_found_exact) and
-                            (found_entity == *entity_iter))
+                            (found_entity == contents[index]))
                         {
                             // Special situation where action name is the same
                             // as one of the aliases, of which both are an
@@ -2649,7 +2645,7 @@ namespace primitives
                         //
                         matched_something = true;
                         found_exact_match = temp_found_exact;
-                        found_entity = *entity_iter;
+                        found_entity = contents[index];
                     }
                 }
             }
@@ -113,6 +113,96 @@ namespace primitives
         return result;
     }
 
+    // ----------------------------------------------------------------------
+    Result SystemPrims::start_database_backup(
+        security::Context &context,
+        const bool throw_on_violation)
+    {
+        Result result;
+        bool security_success = false;
+
+        // Check security
+        //
+        security_success = security::SecurityAccess::instance()->security_check(
+            security::OPERATION_DATABASE_BACKUP,
+            context,
+            throw_on_violation);
+
+        if (not security_success)
+        {
+            result.set_status(Result::STATUS_SECURITY_VIOLATION);
+        }
+        else if (not dbinterface::DatabaseAccess::instance()->start_backup())
+        {
+            result.set_status(Result::STATUS_IMPOSSIBLE);
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    Result SystemPrims::get_formatted_backup_status(
+        security::Context &context,
+        std::string &output,
+        const bool throw_on_violation)
+    {
+        Result result;
+        bool security_success = false;
+
+        // Check security
+        //
+        security_success = security::SecurityAccess::instance()->security_check(
+            security::OPERATION_DATABASE_BACKUP,
+            context,
+            throw_on_violation);
+
+        if (not security_success)
+        {
+            result.set_status(Result::STATUS_SECURITY_VIOLATION);
+        }
+        else
+        {
+            const dbinterface::BackupStatus status =
+                dbinterface::DatabaseAccess::instance()->get_backup_status();
+            std::ostringstream strstream;
+
+            if (status.backup_file.empty())
+            {
+                strstream << "No backup has been made since startup."
+                          << std::endl;
+            }
+            else
+            {
+                strstream << "Backup file: " << status.backup_file << std::endl
+                          << "Started:     " << status.started.to_string()
+                          << std::endl;
+
+                if (status.in_progress)
+                {
+                    strstream << "Status:      In progress, "
+                              << status.percent_done() << "% ("
+                              << status.remaining_pages << " of "
+                              << status.total_pages << " pages left)"
+                              << std::endl;
+                }
+                else
+                {
+                    strstream << "Finished:    " << status.finished.to_string()
+                              << std::endl
+                              << "Status:      "
+                              << (status.completed ?
+                                  std::string("Completed") :
+                                  "Failed: " + status.error)
+                              << std::endl;
+                }
+            }
+
+            output = strstream.str();
+        }
+
+        return result;
+    }
+
     // ----------------------------------------------------------------------
     Result SystemPrims::get_online_players(
         security::Context &context,
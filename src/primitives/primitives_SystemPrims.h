@@ -62,6 +62,39 @@ namespace primitives
             std::string &output,
             const bool throw_on_violation = true);
 
+        /**
+         * Starts an online backup of the database.  The backup runs in the
+         * background while the game continues.
+         * @param context[in] The execution context.
+         * @param throw_on_violation[in] If true (default), throw a
+         * SecurityException if a security violation occurred.
+         * @return If the primitive succeeded or not.  If the backup could
+         * not be started (for instance, one is already running), the
+         * status will be STATUS_IMPOSSIBLE.
+         * @throws security::SecurityException If throw_on_violation is true
+         * and security denied the execution.
+         */
+        Result start_database_backup(
+            security::Context &context,
+            const bool throw_on_violation = true);
+
+        /**
+         * Outputs the progress of the current or most recent online
+         * backup of the database.
+         * @param context[in] The execution context.
+         * @param output[out] If successful, replaced with the formatted
+         * backup status.
+         * @param throw_on_violation[in] If true (default), throw a
+         * SecurityException if a security violation occurred.
+         * @return If the primitive succeeded or not.
+         * @throws security::SecurityException If throw_on_violation is true
+         * and security denied the execution.
+         */
+        Result get_formatted_backup_status(
+            security::Context &context,
+            std::string &output,
+            const bool throw_on_violation = true);
+
         /**
          * Gets a list of all currently online players. including metadata
          * such as idle time, how long they've been online, etc.
@@ -27,8 +27,10 @@ namespace
         "ENTITY_TOSTRING",
         "TRANSFER_ENTITY",
         "SEND_TEXT_ROOM_UNRESTRICTED",
+        "SEND_TEXT_ROOM",
         "SEND_TEXT_ENTITY",
         "USE_ACTION",
+        "DATABASE_BACKUP",
         "invalid"
     };
 
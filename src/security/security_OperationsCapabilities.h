@@ -105,6 +105,12 @@ namespace security
         /** Allows Entity to use/activate an action.
             Need the specific action as the Entity target */
         OPERATION_USE_ACTION,
+        /** Starts an online backup of the database, or gets the status
+            of one.
+            Need context only.
+            NOTE: Only admins may do this; no checker other than the
+            AdminSecurityChecker is registered. */
+        OPERATION_DATABASE_BACKUP,
         /** Do not use; for counting and bounds checking only. */
         OPERATION_END_INVALID
     };
@@ -3,28 +3,36 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
 #include <string>
+#include <algorithm>
 #include <sqlite3.h>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
 
 #include "utilities/mutgos_config.h"
 #include "text/text_StringConversion.h"
 
 #include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteReadConnection.h"
 #include "dbinterface/dbinterface_DatabaseAccess.h"
 
 #include "concurrency/concurrency_ReaderLockToken.h"
 
-#include "utilities/utility_MemoryBuffer.h"
 
 #include "dbtypes/dbtype_Id.h"
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_Program.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
 #include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_TimeStamp.h"
 #include "concurrency/concurrency_WriterLockToken.h"
 
 #include "logging/log_Logger.h"
@@ -34,26 +42,16 @@ namespace mutgos
 {
 namespace sqliteinterface
 {
+    // Statics
+    //
+    const size_t SqliteBackend::VISIT_PAGE_SIZE;
+    const size_t SqliteBackend::ID_BLOCK_SIZE;
+
     // ----------------------------------------------------------------------
-    SqliteBackend::SqliteBackend(void)
-      : dbhandle_ptr(0),
-        list_sites_stmt(0),
+    SqliteBackend::SqliteBackend(const std::string &file)
+      : database_file(file),
+        dbhandle_ptr(0),
         list_deleted_sites_stmt(0),
-        list_all_entities_site_stmt(0),
-        find_site_type_owner_name_exact_stmt(0),
-        find_site_type_owner_name_stmt(0),
-        find_site_type_name_exact_stmt(0),
-        find_site_type_name_stmt(0),
-        find_site_owner_type_stmt(0),
-        find_site_owner_name_stmt(0),
-        find_site_owner_stmt(0),
-        find_site_name_stmt(0),
-        get_entity_type_stmt(0),
-        get_site_name_stmt(0),
-        get_site_description_stmt(0),
-        find_program_reg_stmt(0),
-        find_program_reg_id_stmt(0),
-        entity_exists_stmt(0),
         undelete_site_stmt(0),
         next_site_id_stmt(0),
         insert_first_next_site_id_stmt(0),
@@ -62,24 +60,47 @@ namespace sqliteinterface
         insert_first_site_entity_id_stmt(0),
         delete_site_entities_stmt(0),
         delete_site_display_names_stmt(0),
+        delete_site_applications_stmt(0),
+        delete_site_references_stmt(0),
         set_site_name_stmt(0),
         set_site_description_stmt(0),
         update_entity_stmt(0),
-        get_entity_stmt(0),
-        get_entity_metadata_stmt(0),
-        get_next_deleted_entity_id_stmt(0),
-        mark_deleted_id_used_stmt(0),
+        save_application_stmt(0),
+        delete_application_stmt(0),
+        save_program_code_stmt(0),
+        delete_program_code_stmt(0),
+        insert_reference_stmt(0),
+        delete_reference_stmt(0),
+        save_access_stmt(0),
+        get_deleted_entity_ids_stmt(0),
+        mark_deleted_ids_used_stmt(0),
         get_next_entity_id_stmt(0),
         update_next_entity_id_stmt(0),
         add_entity_stmt(0),
         delete_entity_stmt(0),
         add_reuse_entity_id_stmt(0),
+        delete_reuse_entity_id_stmt(0),
+        delete_entity_applications_stmt(0),
+        delete_entity_references_stmt(0),
         mark_site_deleted_stmt(0),
         delete_all_site_entity_id_reuse_stmt(0),
         delete_site_next_entity_id_stmt(0),
         insert_program_reg_stmt(0),
-        delete_program_reg_stmt(0)
+        delete_program_reg_stmt(0),
+        begin_transaction_stmt(0),
+        commit_transaction_stmt(0),
+        rollback_transaction_stmt(0),
+        transaction_open(false),
+        transaction_begun(false),
+        bulk_load_open(false),
+        references_dirty(false),
+        backup_thread_ptr(0),
+        backup_cancel(false)
     {
+        if (database_file.empty())
+        {
+            database_file = config::db::db_file();
+        }
     }
 
     // ----------------------------------------------------------------------
@@ -97,11 +118,20 @@ namespace sqliteinterface
 
         if (not dbhandle_ptr)
         {
-            LOG(info, "sqliteinterface", "init", "Mounting database...");
+            LOG(info, "sqliteinterface", "init",
+                "Mounting database " + database_file + "...");
 
-            const int rc = sqlite3_open(
-                config::db::db_file().c_str(),
-                &dbhandle_ptr);
+            // Serialized (FULLMUTEX) because during a bulk load, and for
+            // threads in the open transaction, read connections share this
+            // handle and are used by other threads at the same time as the
+            // writer.  Don't rely on SQLite's compiled-in default for that.
+            //
+            const int rc = sqlite3_open_v2(
+                database_file.c_str(),
+                &dbhandle_ptr,
+                SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                    SQLITE_OPEN_FULLMUTEX,
+                0);
             success = (rc == SQLITE_OK);
 
             if (success)
@@ -124,13 +154,12 @@ namespace sqliteinterface
                         0,
                         0,
                         0) == SQLITE_OK) and
-                    (sqlite3_exec(
-                        dbhandle_ptr,
-                        "PRAGMA synchronous=NORMAL;",
-                        0,
-                        0,
-                        0) == SQLITE_OK)
-                    and create_tables() and sql_init();
+                    set_durability()
+                    and create_tables() and check_reference_index()
+                    and sql_init()
+                    and open_read_connections()
+                    and open_transaction_read_connections()
+                    and writer_read_connection.open(dbhandle_ptr);
 
                 if (success)
                 {
@@ -157,60 +186,41 @@ namespace sqliteinterface
     {
         LOG(info, "sqliteinterface", "shutdown", "Shutting down...");
 
-        bool success = not any_mem_owned();
+        // A backup in progress would be incomplete anyway.
+        stop_backup();
 
-        if (success and dbhandle_ptr)
+        if (bulk_load_open and (not end_bulk_load_db()) and bulk_load_open)
         {
-            sqlite3_finalize(list_sites_stmt);
-            list_sites_stmt = 0;
-
-            sqlite3_finalize(list_deleted_sites_stmt);
-            list_deleted_sites_stmt = 0;
-
-            sqlite3_finalize(list_all_entities_site_stmt);
-            list_all_entities_site_stmt = 0;
-
-            sqlite3_finalize(find_site_type_owner_name_exact_stmt);
-            find_site_type_owner_name_exact_stmt = 0;
-
-            sqlite3_finalize(find_site_type_owner_name_stmt);
-            find_site_type_owner_name_stmt = 0;
-
-            sqlite3_finalize(find_site_type_name_exact_stmt);
-            find_site_type_name_exact_stmt = 0;
-
-            sqlite3_finalize(find_site_type_name_stmt);
-            find_site_type_name_stmt = 0;
-
-            sqlite3_finalize(find_site_owner_type_stmt);
-            find_site_owner_type_stmt = 0;
-
-            sqlite3_finalize(find_site_owner_name_stmt);
-            find_site_owner_name_stmt = 0;
-
-            sqlite3_finalize(find_site_owner_stmt);
-            find_site_owner_stmt = 0;
-
-            sqlite3_finalize(find_site_name_stmt);
-            find_site_name_stmt = 0;
-
-            sqlite3_finalize(get_entity_type_stmt);
-            get_entity_type_stmt = 0;
+            LOG(error, "sqliteinterface", "shutdown",
+                "Bulk load could not be ended and will be rolled back.");
+        }
 
-            sqlite3_finalize(get_site_name_stmt);
-            get_site_name_stmt = 0;
+        bool success = not any_mem_owned();
 
-            sqlite3_finalize(get_site_description_stmt);
-            get_site_description_stmt = 0;
+        if (success and dbhandle_ptr)
+        {
+            if (transaction_begun)
+            {
+                // Leave the reserved IDs unused; they can't be given back
+                // outside of the transaction.
+                site_id_blocks.clear();
+            }
+            else
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+                release_id_blocks();
+            }
 
-            sqlite3_finalize(find_program_reg_stmt);
-            find_program_reg_stmt = 0;
+            close_read_connections();
+            close_transaction_read_connections();
 
-            sqlite3_finalize(find_program_reg_id_stmt);
-            find_program_reg_id_stmt = 0;
+            {
+                boost::lock_guard<boost::mutex> guard(writer_read_mutex);
+                writer_read_connection.close();
+            }
 
-            sqlite3_finalize(entity_exists_stmt);
-            entity_exists_stmt = 0;
+            sqlite3_finalize(list_deleted_sites_stmt);
+            list_deleted_sites_stmt = 0;
 
             sqlite3_finalize(undelete_site_stmt);
             undelete_site_stmt = 0;
@@ -236,6 +246,12 @@ namespace sqliteinterface
             sqlite3_finalize(delete_site_display_names_stmt);
             delete_site_display_names_stmt = 0;
 
+            sqlite3_finalize(delete_site_applications_stmt);
+            delete_site_applications_stmt = 0;
+
+            sqlite3_finalize(delete_site_references_stmt);
+            delete_site_references_stmt = 0;
+
             sqlite3_finalize(set_site_name_stmt);
             set_site_name_stmt = 0;
 
@@ -245,17 +261,32 @@ namespace sqliteinterface
             sqlite3_finalize(update_entity_stmt);
             update_entity_stmt = 0;
 
-            sqlite3_finalize(get_entity_stmt);
-            get_entity_stmt = 0;
+            sqlite3_finalize(save_application_stmt);
+            save_application_stmt = 0;
+
+            sqlite3_finalize(delete_application_stmt);
+            delete_application_stmt = 0;
+
+            sqlite3_finalize(save_program_code_stmt);
+            save_program_code_stmt = 0;
 
-            sqlite3_finalize(get_entity_metadata_stmt);
-            get_entity_metadata_stmt = 0;
+            sqlite3_finalize(delete_program_code_stmt);
+            delete_program_code_stmt = 0;
 
-            sqlite3_finalize(get_next_deleted_entity_id_stmt);
-            get_next_deleted_entity_id_stmt = 0;
+            sqlite3_finalize(insert_reference_stmt);
+            insert_reference_stmt = 0;
 
-            sqlite3_finalize(mark_deleted_id_used_stmt);
-            mark_deleted_id_used_stmt = 0;
+            sqlite3_finalize(delete_reference_stmt);
+            delete_reference_stmt = 0;
+
+            sqlite3_finalize(save_access_stmt);
+            save_access_stmt = 0;
+
+            sqlite3_finalize(get_deleted_entity_ids_stmt);
+            get_deleted_entity_ids_stmt = 0;
+
+            sqlite3_finalize(mark_deleted_ids_used_stmt);
+            mark_deleted_ids_used_stmt = 0;
 
             sqlite3_finalize(get_next_entity_id_stmt);
             get_next_entity_id_stmt = 0;
@@ -272,6 +303,15 @@ namespace sqliteinterface
             sqlite3_finalize(add_reuse_entity_id_stmt);
             add_reuse_entity_id_stmt = 0;
 
+            sqlite3_finalize(delete_reuse_entity_id_stmt);
+            delete_reuse_entity_id_stmt = 0;
+
+            sqlite3_finalize(delete_entity_applications_stmt);
+            delete_entity_applications_stmt = 0;
+
+            sqlite3_finalize(delete_entity_references_stmt);
+            delete_entity_references_stmt = 0;
+
             sqlite3_finalize(mark_site_deleted_stmt);
             mark_site_deleted_stmt = 0;
 
@@ -287,6 +327,15 @@ namespace sqliteinterface
             sqlite3_finalize(delete_program_reg_stmt);
             delete_program_reg_stmt = 0;
 
+            sqlite3_finalize(begin_transaction_stmt);
+            begin_transaction_stmt = 0;
+
+            sqlite3_finalize(commit_transaction_stmt);
+            commit_transaction_stmt = 0;
+
+            sqlite3_finalize(rollback_transaction_stmt);
+            rollback_transaction_stmt = 0;
+
             success = (sqlite3_close(dbhandle_ptr) == SQLITE_OK);
 
             if (success)
@@ -329,155 +378,15 @@ namespace sqliteinterface
     {
         dbtype::Entity *entity_ptr = 0;
         dbtype::Id::EntityIdType entity_id = 0;
-        int rc = SQLITE_OK;
         bool fatal_error = false;
 
         // Do this in an inner scope so we can lock just this section
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
-
-            // See if there is a deleted ID we can reuse.
-            // If so, remove from deleted list
-            //
-            if (sqlite3_bind_int(
-                get_next_deleted_entity_id_stmt,
-                sqlite3_bind_parameter_index(get_next_deleted_entity_id_stmt,
-                    "$SITEID"),
-                site_id) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "new_entity",
-              "For get_next_deleted_entity_id_stmt, could not bind $SITEID");
-            }
-
-            // Only stepping once since we just need one.
-            rc = sqlite3_step(get_next_deleted_entity_id_stmt);
-
-            if (rc == SQLITE_ROW)
-            {
-                // There is an ID we can use!
-                //
-                entity_id = sqlite3_column_int64(
-                    get_next_deleted_entity_id_stmt, 0);
-
-                fatal_error = not entity_id;
-
-                // Remove ID from the reuse table, since we are now using it.
-                //
-                if (sqlite3_bind_int(
-                    mark_deleted_id_used_stmt,
-                    sqlite3_bind_parameter_index(mark_deleted_id_used_stmt,
-                        "$SITEID"),
-                    site_id) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_entity",
-                  "For mark_deleted_id_used_stmt, could not bind $SITEID");
-                }
-
-                if (sqlite3_bind_int64(
-                    mark_deleted_id_used_stmt,
-                    sqlite3_bind_parameter_index(mark_deleted_id_used_stmt,
-                        "$ENTITYID"),
-                    entity_id) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_entity",
-                  "For mark_deleted_id_used_stmt, could not bind $ENTITYID");
-                }
-
-                rc = sqlite3_step(mark_deleted_id_used_stmt);
-
-                if (rc != SQLITE_DONE)
-                {
-                    LOG(error, "sqliteinterface", "new_entity",
-                        "Could not remove selected ID from reuse list: "
-                        + std::string(sqlite3_errstr(rc)));
-
-                    fatal_error = true;
-                }
-            }
-            else if (rc != SQLITE_DONE)
-            {
-                // An error occurred.
-                //
-                LOG(error, "sqliteinterface", "new_entity",
-                    "Could not get next available recycled ID: "
-                    + std::string(sqlite3_errstr(rc)));
-
-                fatal_error = true;
-            }
-
-            reset(get_next_deleted_entity_id_stmt);
-            reset(mark_deleted_id_used_stmt);
-
-            // If no existing ID, get a fresh one
-            //
-            if (not fatal_error and (not entity_id))
-            {
-                if (sqlite3_bind_int(
-                    get_next_entity_id_stmt,
-                    sqlite3_bind_parameter_index(get_next_entity_id_stmt,
-                        "$SITEID"),
-                    site_id) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_entity",
-                        "For get_next_entity_id_stmt, could not bind $SITEID");
-                }
-
-                rc = sqlite3_step(get_next_entity_id_stmt);
-
-                if (rc != SQLITE_ROW)
-                {
-                    LOG(error, "sqliteinterface", "new_entity",
-                        "Could not get next fresh ID: "
-                        + std::string(sqlite3_errstr(rc)));
-
-                    fatal_error = true;
-                }
-                else
-                {
-                    entity_id =
-                        (dbtype::Id::EntityIdType) sqlite3_column_int64(
-                            get_next_entity_id_stmt, 0);
-
-                    fatal_error = not entity_id;
-                }
-
-                if (not fatal_error)
-                {
-                    if (sqlite3_bind_int(
-                        update_next_entity_id_stmt,
-                        sqlite3_bind_parameter_index(
-                            update_next_entity_id_stmt, "$SITEID"),
-                        site_id) != SQLITE_OK)
-                    {
-                        LOG(error, "sqliteinterface", "new_entity",
-                     "For update_next_entity_id_stmt, could not bind $SITEID");
-                    }
-
-                    if (sqlite3_bind_int64(
-                        update_next_entity_id_stmt,
-                        sqlite3_bind_parameter_index(
-                            update_next_entity_id_stmt, "$NEXTID"),
-                        entity_id + 1) != SQLITE_OK)
-                    {
-                        LOG(error, "sqliteinterface", "new_entity",
-                     "For update_next_entity_id_stmt, could not bind $NEXTID");
-                    }
-
-                    rc = sqlite3_step(update_next_entity_id_stmt);
-
-                    if (rc != SQLITE_DONE)
-                    {
-                        LOG(error, "sqliteinterface", "new_entity",
-                            "Could not update next fresh ID: "
-                            + std::string(sqlite3_errstr(rc)));
-
-                        fatal_error = true;
-                    }
-                }
-            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            wait_for_transaction(lock);
 
-            reset(get_next_entity_id_stmt);
-            reset(update_next_entity_id_stmt);
+            entity_id = take_entity_id(site_id);
+            fatal_error = not entity_id;
         }
 
         // Don't lock ourselves here to avoid recursive locking
@@ -492,7 +401,8 @@ namespace sqliteinterface
 
         if (entity_ptr)
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
+            boost::unique_lock<boost::mutex> lock(mutex);
+            wait_for_transaction(lock);
             concurrency::WriterLockToken token(*entity_ptr);
 
             fatal_error = not bind_entity_update_params(
@@ -532,6 +442,20 @@ namespace sqliteinterface
                         + std::string(sqlite3_errstr(rc)));
                     fatal_error = true;
                 }
+                else if (transaction_begun and (not bulk_load_open))
+                {
+                    // If the transaction fails, the row has to be written
+                    // again since the Entity will still be in use.
+                    //
+                    NewEntityRow &row = transaction_new_entities[
+                        entity_ptr->get_entity_id()];
+
+                    row.owner = owner.get_entity_id();
+                    row.type = entity_ptr->get_entity_type();
+                    row.version = entity_ptr->get_entity_version();
+                    row.name = name;
+                    row.data = entity_data_buffer;
+                }
             }
 
             reset(add_entity_stmt);
@@ -549,7 +473,7 @@ namespace sqliteinterface
     // ----------------------------------------------------------------------
     dbtype::Entity *SqliteBackend::get_entity_db(const dbtype::Id &id)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        ReadConnectionGuard connection(*this);
 
         dbtype::Entity *entity_ptr = get_entity_pointer(id);
 
@@ -558,8 +482,10 @@ namespace sqliteinterface
             // Not in memory, try and get it from the database
             //
             if (sqlite3_bind_int(
-                get_entity_stmt,
-                sqlite3_bind_parameter_index(get_entity_stmt, "$SITEID"),
+                connection->get_entity_stmt,
+                sqlite3_bind_parameter_index(
+                    connection->get_entity_stmt,
+                    "$SITEID"),
                 id.get_site_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "get_entity_db",
@@ -567,8 +493,10 @@ namespace sqliteinterface
             }
 
             if (sqlite3_bind_int64(
-                get_entity_stmt,
-                sqlite3_bind_parameter_index(get_entity_stmt, "$ENTITYID"),
+                connection->get_entity_stmt,
+                sqlite3_bind_parameter_index(
+                    connection->get_entity_stmt,
+                    "$ENTITYID"),
                 id.get_entity_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "get_entity_db",
@@ -577,62 +505,159 @@ namespace sqliteinterface
 
             // Should be 0 or 1 lines
             //
-            if (sqlite3_step(get_entity_stmt) == SQLITE_ROW)
+            if (sqlite3_step(connection->get_entity_stmt) == SQLITE_ROW)
             {
                 // Entity exists.  Deserialize it.
                 //
-                const int entity_type_int = sqlite3_column_int(get_entity_stmt, 0);
-                const void *blob_ptr = sqlite3_column_blob(get_entity_stmt, 1);
-                const int blob_size = sqlite3_column_bytes(get_entity_stmt, 1);
+                entity_ptr =
+                    make_entity_from_row(connection->get_entity_stmt, 0, id);
+            }
+
+            reset(connection->get_entity_stmt);
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::get_entities_db(
+        const dbtype::Entity::IdVector &ids,
+        EntityPtrVector &entities)
+    {
+        // Maps each ID not in memory to where it goes in entities.
+        // Being sorted, IDs of the same site are next to each other.
+        typedef std::map<dbtype::Id, std::vector<size_t> > IdPositions;
+
+        IdPositions not_in_mem;
+
+        entities.assign(ids.size(), 0);
+
+        // Pointers already in memory are only handed back, never looked
+        // at here, since they may be freed by delete_entity_mem() at any
+        // time.  The SiteCache asking for them owns them and does not
+        // evict an Entity it is loading.
+        //
+        for (size_t index = 0; index < ids.size(); ++index)
+        {
+            if (not ids[index].is_default())
+            {
+                entities[index] = get_entity_pointer(ids[index]);
+
+                if (not entities[index])
+                {
+                    not_in_mem[ids[index]].push_back(index);
+                }
+            }
+        }
+
+        if (not_in_mem.empty())
+        {
+            return;
+        }
+
+        ReadConnectionGuard connection(*this);
+        sqlite3_stmt * const stmt = connection->get_entities_stmt;
+        IdPositions::const_iterator batch_iter = not_in_mem.begin();
+
+        while (batch_iter != not_in_mem.end())
+        {
+            // Bind as many IDs from the same site as will fit, and NULL
+            // for any unused parameters.
+            //
+            const dbtype::Id::SiteIdType site_id =
+                batch_iter->first.get_site_id();
+            IdPositions::const_iterator id_iter = batch_iter;
+
+            if (sqlite3_bind_int(stmt, 1, site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "get_entities_db",
+                    "For get_entities_stmt, could not bind $SITEID");
+            }
+
+            for (int param = 2;
+                 param <= SqliteReadConnection::GET_ENTITIES_BATCH_SIZE + 1;
+                 ++param)
+            {
+                int rc = SQLITE_OK;
 
-                if ((not blob_ptr) or (blob_size <= 0))
+                if ((id_iter != not_in_mem.end()) and
+                    (id_iter->first.get_site_id() == site_id))
                 {
-                    LOG(error, "sqliteinterface", "get_entity_db",
-                        "No blob data for ID " + id.to_string(true));
+                    rc = sqlite3_bind_int64(
+                        stmt,
+                        param,
+                        id_iter->first.get_entity_id());
+                    ++id_iter;
                 }
                 else
                 {
-                    const dbtype::EntityType entity_type =
-                        (dbtype::EntityType) entity_type_int;
+                    rc = sqlite3_bind_null(stmt, param);
+                }
+
+                if (rc != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "get_entities_db",
+                        "For get_entities_stmt, could not bind entity ID");
+                }
+            }
 
-                    utility::MemoryBuffer buffer(blob_ptr, blob_size);
-                    entity_ptr = make_deserialize_entity(entity_type, buffer);
+            int rc = sqlite3_step(stmt);
 
-                    if (not entity_ptr)
-                    {
-                        LOG(error, "sqliteinterface", "get_entity_db",
-                            "Unknown type to deserialize: "
-                              + dbtype::entity_type_to_string(entity_type)
-                              + "  ID: " + id.to_string(true));
-                    }
-                    else
+            while (rc == SQLITE_ROW)
+            {
+                const dbtype::Id id(
+                    site_id,
+                    (dbtype::Id::EntityIdType) sqlite3_column_int64(stmt, 0));
+                const IdPositions::const_iterator positions_iter =
+                    not_in_mem.find(id);
+                dbtype::Entity * const entity_ptr =
+                    make_entity_from_row(stmt, 1, id);
+
+                if (entity_ptr and (positions_iter != not_in_mem.end()))
+                {
+                    for (std::vector<size_t>::const_iterator position_iter =
+                            positions_iter->second.begin();
+                        position_iter != positions_iter->second.end();
+                        ++position_iter)
                     {
-                        // Put into lookup map
-                        added_mem_owned(entity_ptr);
+                        entities[*position_iter] = entity_ptr;
                     }
                 }
+
+                rc = sqlite3_step(stmt);
             }
 
-            reset(get_entity_stmt);
-        }
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "get_entities_db",
+                    "Error getting Entities: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
 
-        return entity_ptr;
+            reset(stmt);
+            batch_iter = id_iter;
+        }
     }
 
     // ----------------------------------------------------------------------
     bool SqliteBackend::entity_exists_db(const dbtype::Id &id)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
-        bool exists = get_entity_pointer(id);
+        // Only whether it is in memory matters, so the Entity itself is
+        // never looked at; it may be freed at any time.
+        //
+        bool exists = is_mem_owned(id);
 
         if (not exists)
         {
+            ReadConnectionGuard connection(*this);
+
             // Not in memory, try and get it from the database
             //
             if (sqlite3_bind_int(
-                entity_exists_stmt,
-                sqlite3_bind_parameter_index(entity_exists_stmt, "$SITEID"),
+                connection->entity_exists_stmt,
+                sqlite3_bind_parameter_index(
+                    connection->entity_exists_stmt,
+                    "$SITEID"),
                 id.get_site_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "entity_exists_db",
@@ -640,8 +665,10 @@ namespace sqliteinterface
             }
 
             if (sqlite3_bind_int64(
-                entity_exists_stmt,
-                sqlite3_bind_parameter_index(entity_exists_stmt, "$ENTITYID"),
+                connection->entity_exists_stmt,
+                sqlite3_bind_parameter_index(
+                    connection->entity_exists_stmt,
+                    "$ENTITYID"),
                 id.get_entity_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "entity_exists_db",
@@ -649,9 +676,9 @@ namespace sqliteinterface
             }
 
             // Should be 0 or 1 lines
-            exists = (sqlite3_step(entity_exists_stmt) == SQLITE_ROW);
+            exists = (sqlite3_step(connection->entity_exists_stmt) == SQLITE_ROW);
 
-            reset(entity_exists_stmt);
+            reset(connection->entity_exists_stmt);
         }
 
         return exists;
@@ -660,848 +687,908 @@ namespace sqliteinterface
     // ----------------------------------------------------------------------
     bool SqliteBackend::save_entity_db(dbtype::Entity *entity_ptr)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        dbtype::Entity::IdVector failed_ids;
 
-        bool success = entity_ptr and is_mem_owned(entity_ptr);
+        return save_entities_db(EntityPtrVector(1, entity_ptr), failed_ids);
+    }
 
-        if (success)
-        {
-            concurrency::WriterLockToken token(*entity_ptr);
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::save_entities_db(
+        const EntityPtrVector &entities,
+        dbtype::Entity::IdVector &failed_ids)
+    {
+        bool success = true;
+        EntityApplications retry_applications;
+        dbtype::Entity::IdSet retry_program_code;
+        EntitySaveRows rows;
 
-            success = bind_entity_update_params(
-                entity_ptr,
-                token,
-                update_entity_stmt);
+        rows.reserve(entities.size());
 
-            if (not success)
+        {
+            // Anything written in a transaction that failed to commit needs
+            // to be written again.
+            //
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            for (EntityPtrVector::const_iterator entity_iter =
+                    entities.begin();
+                 entity_iter != entities.end();
+                 ++entity_iter)
             {
-                LOG(error, "sqliteinterface", "save_entity_db",
-                    "Could not save entity!");
+                if (*entity_iter)
+                {
+                    const dbtype::Id &id = (*entity_iter)->get_entity_id();
+                    EntityApplications::iterator unsaved_iter =
+                        unsaved_applications.find(id);
+
+                    if (unsaved_iter != unsaved_applications.end())
+                    {
+                        retry_applications[id].swap(unsaved_iter->second);
+                        unsaved_applications.erase(unsaved_iter);
+                    }
+
+                    if (unsaved_program_code.erase(id))
+                    {
+                        retry_program_code.insert(id);
+                    }
+                }
             }
+        }
 
-            if (success)
+        // Serialize everything before taking the lock, so an open
+        // transaction is only begun once there is nothing left to do but
+        // write the rows.
+        //
+        for (EntityPtrVector::const_iterator entity_iter = entities.begin();
+             entity_iter != entities.end();
+             ++entity_iter)
+        {
+            if (*entity_iter)
             {
-                const int rc = sqlite3_step(update_entity_stmt);
+                rows.push_back(EntitySaveRow());
 
-                if (rc != SQLITE_DONE)
+                if (not serialize_entity_row(
+                    *entity_iter,
+                    retry_applications,
+                    retry_program_code,
+                    rows.back()))
                 {
-                    LOG(error, "sqliteinterface", "save_entity_db",
-                        "Could not update Entity: "
-                        + std::string(sqlite3_errstr(rc)));
+                    rows.pop_back();
+                    failed_ids.push_back((*entity_iter)->get_entity_id());
                     success = false;
                 }
-                else
-                {
-                    // For now, brute force update program registration
-                    // cache, since updates are expected to be rare and cheap.
-                    //
-                    dbtype::Program * const program_ptr =
-                        dynamic_cast<dbtype::Program *>(entity_ptr);
+            }
+        }
 
-                    if (program_ptr)
-                    {
-                        delete_program_reg(program_ptr->get_entity_id());
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        // Whatever is left was not serialized, and is tried again next time.
+        //
+        for (EntityApplications::iterator retry_iter =
+                retry_applications.begin();
+             retry_iter != retry_applications.end();
+             ++retry_iter)
+        {
+            unsaved_applications[retry_iter->first].insert(
+                retry_iter->second.begin(),
+                retry_iter->second.end());
+        }
 
-                        const std::string reg_name =
-                            program_ptr->get_program_reg_name(token);
+        unsaved_program_code.insert(
+            retry_program_code.begin(),
+            retry_program_code.end());
 
-                        if (not reg_name.empty())
-                        {
-                            if (not insert_program_reg(
-                                program_ptr->get_entity_id(),
-                                reg_name))
-                            {
-                                success = false;
-                            }
-                        }
-                    }
+        if (not rows.empty())
+        {
+            wait_for_transaction(lock);
 
-                    entity_ptr->clear_dirty(token);
+            for (EntitySaveRows::const_iterator row_iter = rows.begin();
+                 row_iter != rows.end();
+                 ++row_iter)
+            {
+                if (not write_entity_row(*row_iter))
+                {
+                    failed_ids.push_back(row_iter->id);
+                    success = false;
                 }
             }
-
-            reset(update_entity_stmt);
         }
 
         return success;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::delete_entity_db(const dbtype::Id &id)
+    bool SqliteBackend::begin_transaction_db(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
 
-        // Confirm not still in memory
-        const bool success = not is_mem_owned(id);
+        // During a bulk load, everything is part of its transaction.
+        //
+        bool success = bulk_load_open or
+            (dbhandle_ptr and (not transaction_open));
 
-        if (success and (not id.is_default()))
+        if (success and (not bulk_load_open))
         {
-            bool delete_good = true;
-            int rc = SQLITE_OK;
-
-            // Delete from entities table
+            // BEGIN waits for this thread's first write, so whatever is
+            // done until then doesn't hold up other threads' writes.
             //
+            transaction_open = true;
+            transaction_begun = false;
+            transaction_applications.clear();
+            transaction_program_code.clear();
+            transaction_new_entities.clear();
+
+            boost::lock_guard<boost::mutex> threads_guard(
+                transaction_threads_mutex);
+            transaction_threads.insert(boost::this_thread::get_id());
+        }
 
-            if (sqlite3_bind_int(
-                delete_entity_stmt,
-                sqlite3_bind_parameter_index(delete_entity_stmt, "$SITEID"),
-                id.get_site_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "delete_entity_db",
-                    "For delete_entity_stmt, could not bind $SITEID");
-            }
+        return success;
+    }
 
-            if (sqlite3_bind_int64(
-                delete_entity_stmt,
-                sqlite3_bind_parameter_index(delete_entity_stmt, "$ENTITYID"),
-                id.get_entity_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "delete_entity_db",
-                    "For delete_entity_stmt, could not bind $ENTITYID");
-            }
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::commit_transaction_db(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
 
-            rc = sqlite3_step(delete_entity_stmt);
+        // During a bulk load, the commit waits until end_bulk_load_db().
+        //
+        bool success = transaction_open;
 
-            if (rc == SQLITE_DONE)
+        if (success and (not bulk_load_open))
+        {
+            transaction_open = false;
+
+            if (not transaction_begun)
             {
-                delete_good = sqlite3_changes(dbhandle_ptr) > 0;
+                // Nothing was written, so there is nothing to commit.
             }
-            else
+            else if (sqlite3_get_autocommit(dbhandle_ptr))
             {
-                LOG(error, "sqliteinterface", "delete_entity_db",
-                    "Could not delete Entity: "
-                    + std::string(sqlite3_errstr(rc)));
-                delete_good = false;
+                // Some errors (disk full, I/O, etc) cause SQLite to roll
+                // back the transaction on its own.  Nothing to commit.
+                //
+                LOG(error, "sqliteinterface", "commit_transaction_db",
+                    "Transaction was already rolled back by SQLite.");
+                success = false;
             }
-
-            reset(delete_entity_stmt);
-
-            if (delete_good)
+            else
             {
-                // Delete worked, add ID into table for future reuse
-                //
-                if (sqlite3_bind_int(
-                    add_reuse_entity_id_stmt,
-                    sqlite3_bind_parameter_index(add_reuse_entity_id_stmt, "$SITEID"),
-                    id.get_site_id()) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "delete_entity_db",
-                        "For add_reuse_entity_id_stmt, could not bind $SITEID");
-                }
+                const int rc = sqlite3_step(commit_transaction_stmt);
 
-                if (sqlite3_bind_int64(
-                    add_reuse_entity_id_stmt,
-                    sqlite3_bind_parameter_index(add_reuse_entity_id_stmt, "$ENTITYID"),
-                    id.get_entity_id()) != SQLITE_OK)
+                if (rc != SQLITE_DONE)
                 {
-                    LOG(error, "sqliteinterface", "delete_entity_db",
-                        "For add_reuse_entity_id_stmt, could not bind $ENTITYID");
+                    LOG(error, "sqliteinterface", "commit_transaction_db",
+                        "Could not commit transaction, rolling back: "
+                        + std::string(sqlite3_errstr(rc)));
+                    success = false;
                 }
 
-                rc = sqlite3_step(add_reuse_entity_id_stmt);
+                reset(commit_transaction_stmt);
 
-                if (rc != SQLITE_DONE)
+                if ((not success) and (not sqlite3_get_autocommit(dbhandle_ptr)))
                 {
-                    LOG(error, "sqliteinterface", "delete_entity_db",
-                        "Could not insert Entity ID into reuse table: "
-                        + std::string(sqlite3_errstr(rc)));
+                    sqlite3_step(rollback_transaction_stmt);
+                    reset(rollback_transaction_stmt);
                 }
+            }
 
-                reset(add_reuse_entity_id_stmt);
-
-                // Delete from program registration if present.
-                delete_program_reg(id);
+            if (not success)
+            {
+                transaction_rolled_back();
             }
+
+            transaction_begun = false;
+            transaction_applications.clear();
+            transaction_program_code.clear();
+            transaction_new_entities.clear();
+            transaction_ended();
         }
 
         return success;
     }
 
     // ----------------------------------------------------------------------
-    dbtype::EntityType SqliteBackend::get_entity_type_db(const dbtype::Id &id)
+    bool SqliteBackend::join_transaction(const boost::thread::id &thread_id)
     {
-        dbtype::EntityType entity_type = dbtype::ENTITYTYPE_invalid;
-
         boost::lock_guard<boost::mutex> guard(mutex);
-        dbtype::Entity * const entity_ptr = get_entity_pointer(id);
 
-        if (entity_ptr)
+        const bool joined = transaction_open and
+            transaction_threads.count(thread_id);
+
+        if (joined)
         {
-            // In our cache of Entities in use.  Return the type.
-            entity_type = entity_ptr->get_entity_type();
+            boost::lock_guard<boost::mutex> threads_guard(
+                transaction_threads_mutex);
+            transaction_threads.insert(boost::this_thread::get_id());
         }
-        else
-        {
-            // Not in cache, try and get it from the database
-            //
-            if (sqlite3_bind_int(
-                get_entity_type_stmt,
-                sqlite3_bind_parameter_index(get_entity_type_stmt, "$SITEID"),
-                id.get_site_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "get_entity_type_db",
-                    "For get_entity_type_stmt, could not bind $SITEID");
-            }
-
-            if (sqlite3_bind_int64(
-                get_entity_type_stmt,
-                sqlite3_bind_parameter_index(get_entity_type_stmt, "$ENTITYID"),
-                id.get_entity_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "get_entity_type_db",
-                    "For get_entity_type_stmt, could not bind $ENTITYID");
-            }
-
-            // Should be 0 or 1 lines
-            //
-            if (sqlite3_step(get_entity_type_stmt) == SQLITE_ROW)
-            {
-                // Entity exists.  Get the type.
-                //
-                const int entity_type_int =
-                    sqlite3_column_int(get_entity_type_stmt, 0);
 
-                entity_type = (dbtype::EntityType) entity_type_int;
-            }
+        return joined;
+    }
 
-            reset(get_entity_type_stmt);
-        }
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::in_transaction(void)
+    {
+        boost::lock_guard<boost::mutex> threads_guard(
+            transaction_threads_mutex);
 
-        return entity_type;
+        return transaction_threads.count(boost::this_thread::get_id());
     }
 
     // ----------------------------------------------------------------------
-    dbtype::Entity::IdVector SqliteBackend::find_in_db(
-        const dbtype::Id::SiteIdType site_id,
-        const dbtype::EntityType type,
-        const dbtype::Id::EntityIdType owner_id,
-        const std::string &name,
-        const bool exact)
+    bool SqliteBackend::rollback_transaction_db(void)
     {
-        dbtype::Entity::IdVector result;
+        bool success = false;
+        bool was_bulk_load = false;
 
-        if (not site_id)
         {
-            LOG(error, "sqliteinterface", "find_in_db()",
-                "Site was not specified; cannot search");
-            return result;
-        }
-
-        boost::lock_guard<boost::mutex> guard(mutex);
+            boost::lock_guard<boost::mutex> guard(mutex);
 
-        sqlite3_stmt *stmt = 0;
+            success = transaction_open;
 
-        // Figure what type of search they want base don which parameters were
-        // filled in.
-        //
-        if (type == dbtype::ENTITYTYPE_invalid)
-        {
-            if (owner_id and (not name.empty()))
-            {
-                stmt = find_site_owner_name_stmt;
-            }
-            else if (owner_id)
-            {
-                stmt = find_site_owner_stmt;
-            }
-            else if (not name.empty())
-            {
-                stmt = find_site_name_stmt;
-            }
-        }
-        else
-        {
-            if (owner_id and name.empty())
-            {
-                stmt = find_site_owner_type_stmt;
-            }
-            else if (owner_id)
-            {
-                if (exact)
-                {
-                    stmt = find_site_type_owner_name_exact_stmt;
-                }
-                else
-                {
-                    stmt = find_site_type_owner_name_stmt;
-                }
-            }
-            else
+            if (success)
             {
-                if (exact)
-                {
-                    stmt = find_site_type_name_exact_stmt;
-                }
-                else
+                was_bulk_load = bulk_load_open;
+                transaction_open = false;
+                transaction_begun = false;
+                bulk_load_open = false;
+
+                if (not sqlite3_get_autocommit(dbhandle_ptr))
                 {
-                    stmt = find_site_type_name_stmt;
+                    const int rc = sqlite3_step(rollback_transaction_stmt);
+
+                    if (rc != SQLITE_DONE)
+                    {
+                        LOG(error, "sqliteinterface", "rollback_transaction_db",
+                            "Could not roll back transaction: "
+                            + std::string(sqlite3_errstr(rc)));
+                        success = false;
+                    }
+
+                    reset(rollback_transaction_stmt);
                 }
+
+                transaction_rolled_back();
+
+                transaction_applications.clear();
+                transaction_program_code.clear();
+                transaction_new_entities.clear();
+                transaction_ended();
             }
         }
 
-        if (not stmt)
+        if (was_bulk_load)
         {
-            LOG(error, "sqliteinterface", "find_in_db()",
-                "Bad combination of parameters given; cannot search");
-            return result;
-        }
+            close_read_connections();
+            success = open_read_connections() and success;
 
-        if (sqlite3_bind_int(
-            stmt,
-            sqlite3_bind_parameter_index(stmt, "$SITEID"),
-            site_id) != SQLITE_OK)
-        {
-            LOG(error, "sqliteinterface", "find_in_db()",
-                "For stmt, could not bind $SITEID");
+            LOG(info, "sqliteinterface", "rollback_transaction_db",
+                "Bulk load rolled back.");
         }
 
-        if (type != dbtype::ENTITYTYPE_invalid)
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::wait_for_transaction(
+        boost::unique_lock<boost::mutex> &lock)
+    {
+        // A bulk load is meant to take in everything, and the database is
+        // otherwise idle while it runs.
+        //
+        if (bulk_load_open)
         {
-            if (sqlite3_bind_int(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$TYPE"),
-                type) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "find_in_db()",
-                    "For stmt, could not bind $TYPE");
-            }
+            return;
         }
 
-        if (owner_id)
+        if (transaction_open and
+            transaction_threads.count(boost::this_thread::get_id()))
         {
-            if (sqlite3_bind_int(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$OWNER"),
-                owner_id) != SQLITE_OK)
+            if (not transaction_begun)
             {
-                LOG(error, "sqliteinterface", "find_in_db()",
-                    "For stmt, could not bind $OWNER");
+                begin_open_transaction();
             }
         }
-
-        if (not name.empty())
+        else
         {
-            if (sqlite3_bind_text(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$NAME"),
-                name.c_str(),
-                name.size(),
-                SQLITE_TRANSIENT) != SQLITE_OK)
+            // The transaction is only begun once everything it writes has
+            // been prepared, so this is not a long wait.
+            //
+            while (transaction_begun and (not bulk_load_open))
             {
-                LOG(error, "sqliteinterface", "find_in_db()",
-                    "For stmt, could not bind $NAME");
+                transaction_cond.wait(lock);
             }
         }
+    }
 
-        add_entity_ids(stmt, site_id, result);
+    // ----------------------------------------------------------------------
+    void SqliteBackend::begin_open_transaction(void)
+    {
+        const int rc = sqlite3_step(begin_transaction_stmt);
 
-        reset(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "begin_open_transaction",
+                "Could not begin transaction, writing without it: "
+                + std::string(sqlite3_errstr(rc)));
 
-        return result;
+            // Saving again is harmless, so let the commit fail and have
+            // the whole batch retried.
+            //
+            transaction_open = false;
+            transaction_applications.clear();
+            transaction_program_code.clear();
+            transaction_new_entities.clear();
+            transaction_ended();
+        }
+        else
+        {
+            transaction_begun = true;
+        }
+
+        reset(begin_transaction_stmt);
     }
 
     // ----------------------------------------------------------------------
-    dbtype::Entity::IdVector SqliteBackend::find_in_db(
-        const dbtype::Id::SiteIdType site_id)
+    void SqliteBackend::transaction_ended(void)
     {
-        dbtype::Entity::IdVector result;
-
-        if (not site_id)
         {
-            LOG(error, "sqliteinterface", "find_in_db(site)",
-                "Site was not specified; cannot search");
-            return result;
+            boost::lock_guard<boost::mutex> threads_guard(
+                transaction_threads_mutex);
+            transaction_threads.clear();
         }
 
-        boost::lock_guard<boost::mutex> guard(mutex);
+        transaction_cond.notify_all();
+    }
 
-        if (sqlite3_bind_int(
-            list_all_entities_site_stmt,
-            sqlite3_bind_parameter_index(list_all_entities_site_stmt, "$SITEID"),
-            site_id) != SQLITE_OK)
+    // ----------------------------------------------------------------------
+    void SqliteBackend::transaction_rolled_back(void)
+    {
+        // Any IDs reserved in this transaction are no longer
+        // reserved, so they must not be handed out.
+        site_id_blocks.clear();
+
+        // The dirty marker may have been rolled back.
+        references_dirty = false;
+
+        // The Entities will be saved again, but they no longer
+        // know which applications were in this transaction.
+        //
+        for (EntityApplications::const_iterator entity_iter =
+                transaction_applications.begin();
+            entity_iter != transaction_applications.end();
+            ++entity_iter)
         {
-            LOG(error, "sqliteinterface", "find_in_db(site)",
-                "For list_all_entities_site_stmt, could not bind $SITEID");
+            unsaved_applications[entity_iter->first].insert(
+                entity_iter->second.begin(),
+                entity_iter->second.end());
         }
 
-        add_entity_ids(list_all_entities_site_stmt, site_id, result);
+        unsaved_program_code.insert(
+            transaction_program_code.begin(),
+            transaction_program_code.end());
 
-        reset(list_all_entities_site_stmt);
-
-        return result;
+        // Entities created during the transaction are still in
+        // use, and nothing else will write their rows.
+        restore_new_entities();
     }
 
     // ----------------------------------------------------------------------
-    dbtype::Id SqliteBackend::find_program_reg_in_db(
-        const dbtype::Id::SiteIdType site_id,
-        const std::string &registration_name)
+    bool SqliteBackend::begin_bulk_load_db(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        dbtype::Id result;
+        // These are rebuilt by create_tables() at the end.  The name index
+        // triggers are dropped too; the name index is repopulated in one
+        // pass instead.
+        //
+        const std::string begin_bulk_load_str =
+            "BEGIN TRANSACTION;"
+            "DROP INDEX IF EXISTS entity_type_idx;"
+            "DROP INDEX IF EXISTS entity_owner_idx;"
+            "DROP INDEX IF EXISTS entity_references_source_idx;"
+            "DROP INDEX IF EXISTS program_registrations_idx;"
+            "DROP INDEX IF EXISTS display_name_player_idx;"
+            "DROP TRIGGER IF EXISTS entity_names_insert;"
+            "DROP TRIGGER IF EXISTS entity_names_update;"
+            "DROP TRIGGER IF EXISTS entity_names_delete;";
 
-        if (sqlite3_bind_int(
-            find_program_reg_stmt,
-            sqlite3_bind_parameter_index(find_program_reg_stmt, "$SITEID"),
-            site_id) != SQLITE_OK)
-        {
-            LOG(error, "sqliteinterface", "find_program_reg_in_db",
-                "For find_program_reg_stmt, could not bind $SITEID");
-        }
+        bool success = false;
 
-        if (sqlite3_bind_text(
-            find_program_reg_stmt,
-            sqlite3_bind_parameter_index(find_program_reg_stmt, "$REGNAME"),
-            registration_name.c_str(),
-            registration_name.size(),
-            SQLITE_TRANSIENT) != SQLITE_OK)
         {
-            LOG(error, "sqliteinterface", "find_program_reg_in_db",
-                "For find_program_reg_stmt, could not bind $REGNAME");
-        }
-
-        const int rc = sqlite3_step(find_program_reg_stmt);
+            boost::lock_guard<boost::mutex> guard(mutex);
 
-        // Expecting 0 or 1 results.
-        //
-        if (rc == SQLITE_ROW)
-        {
-            // Found a registration
-            //
-            result =
-                dbtype::Id(
-                    site_id,
-                    (dbtype::Id::EntityIdType)
-                        sqlite3_column_int64(find_program_reg_stmt, 0));
-        }
-        else if (rc != SQLITE_DONE)
-        {
-            LOG(error, "sqliteinterface", "find_program_reg_in_db",
-                "Error getting registration info for program.");
-        }
+            success = dbhandle_ptr and (not transaction_open) and
+                (not bulk_load_open);
 
-        reset (find_program_reg_stmt);
+            if (success)
+            {
+                char *rc_error_str_ptr = 0;
+                const int rc = sqlite3_exec(
+                    dbhandle_ptr,
+                    begin_bulk_load_str.c_str(),
+                    0,
+                    0,
+                    &rc_error_str_ptr);
 
-        return result;
-    }
+                if (rc != SQLITE_OK)
+                {
+                    success = false;
 
-    // ----------------------------------------------------------------------
-    std::string SqliteBackend::find_program_reg_name_in_db(
-        const dbtype::Id &id)
-    {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        std::string result;
+                    LOG(error, "sqliteinterface", "begin_bulk_load_db",
+                        "Unable to start bulk load: "
+                        + std::string(sqlite3_errstr(rc))
+                        + "   Full error: "
+                        + std::string(rc_error_str_ptr ?
+                            rc_error_str_ptr : ""));
 
-        if (sqlite3_bind_int(
-            find_program_reg_id_stmt,
-            sqlite3_bind_parameter_index(find_program_reg_id_stmt, "$SITEID"),
-            id.get_site_id()) != SQLITE_OK)
-        {
-            LOG(error, "sqliteinterface", "find_program_reg_name_in_db",
-                "For find_program_reg_id_stmt, could not bind $SITEID");
-        }
+                    sqlite3_free(rc_error_str_ptr);
+                    rc_error_str_ptr = 0;
 
-        if (sqlite3_bind_int(
-            find_program_reg_id_stmt,
-            sqlite3_bind_parameter_index(find_program_reg_id_stmt, "$ENTITYID"),
-            id.get_entity_id()) != SQLITE_OK)
-        {
-            LOG(error, "sqliteinterface", "find_program_reg_name_in_db",
-                "For find_program_reg_id_stmt, could not bind $REGNAME");
+                    if (not sqlite3_get_autocommit(dbhandle_ptr))
+                    {
+                        sqlite3_step(rollback_transaction_stmt);
+                        reset(rollback_transaction_stmt);
+                    }
+                }
+                else
+                {
+                    transaction_open = true;
+                    transaction_begun = true;
+                    bulk_load_open = true;
+                    transaction_applications.clear();
+                    transaction_program_code.clear();
+                    transaction_new_entities.clear();
+                }
+            }
         }
 
-        const int rc = sqlite3_step(find_program_reg_id_stmt);
-
-        // Expecting 0 or 1 results.
-        //
-        if (rc == SQLITE_ROW)
+        if (success)
         {
-            // Found a registration
+            // The read connections would not see anything until the
+            // commit, so they use the writer connection instead.
             //
-            const char *reg_char_ptr = (const char *)
-                sqlite3_column_text(find_program_reg_id_stmt, 0);
-            const int reg_char_size =
-                sqlite3_column_bytes(find_program_reg_id_stmt, 0);
+            close_read_connections();
+            success = open_read_connections(true);
 
-            if (reg_char_size)
+            if (success)
             {
-                result.assign(reg_char_ptr, reg_char_size);
+                LOG(info, "sqliteinterface", "begin_bulk_load_db",
+                    "Bulk load started.");
+            }
+            else
+            {
+                end_bulk_load_db();
             }
-        }
-        else if (rc != SQLITE_DONE)
-        {
-            LOG(error, "sqliteinterface", "find_program_reg_name_in_db",
-                "Error getting registration info for program.");
         }
 
-        reset (find_program_reg_id_stmt);
-
-        return result;
+        return success;
     }
 
     // ----------------------------------------------------------------------
-    dbtype::Id::SiteIdVector SqliteBackend::get_site_ids_in_db(void)
+    bool SqliteBackend::end_bulk_load_db(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
-        dbtype::Id::SiteIdVector result;
-        int rc = sqlite3_step(list_sites_stmt);
-
-        while (rc == SQLITE_ROW)
-        {
-            result.push_back(
-                (dbtype::Id::SiteIdType) sqlite3_column_int(list_sites_stmt, 0));
-            rc = sqlite3_step(list_sites_stmt);
-        }
+        bool success = false;
+        bool ended = false;
 
-        if (rc != SQLITE_DONE)
         {
-            LOG(error, "sqliteinterface", "get_site_ids_in_db",
-                "Error getting list of site IDs: "
-                + std::string(sqlite3_errstr(rc)));
-        }
+            boost::lock_guard<boost::mutex> guard(mutex);
 
-        reset(list_sites_stmt);
+            success = bulk_load_open;
 
-        return result;
-    }
+            if (success)
+            {
+                LOG(info, "sqliteinterface", "end_bulk_load_db",
+                    "Rebuilding indexes...");
 
-    // ----------------------------------------------------------------------
-    dbinterface::EntityMetadata
-    SqliteBackend::get_entity_metadata(const dbtype::Id &id)
-    {
-        dbinterface::EntityMetadata result;
+                // create_tables() recreates what was dropped, and fills in
+                // the name index if it's empty.  The savepoint lets a
+                // failed rebuild be undone without losing the load.
+                //
+                success = (sqlite3_exec(
+                    dbhandle_ptr,
+                    "SAVEPOINT bulk_load_rebuild;"
+                    "DELETE FROM entity_names;",
+                    0,
+                    0,
+                    0) == SQLITE_OK) and create_tables();
 
-        // See if in memory;  If so, use that version instead
-        if (is_mem_owned(id))
-        {
-            dbinterface::EntityRef entity_ref =
-                dbinterface::DatabaseAccess::instance()->get_entity(id);
+                if (success)
+                {
+                    success = sqlite3_exec(
+                        dbhandle_ptr,
+                        "RELEASE bulk_load_rebuild;",
+                        0,
+                        0,
+                        0) == SQLITE_OK;
+                }
 
-            if (entity_ref.valid())
-            {
-                concurrency::ReaderLockToken token(*entity_ref.get());
+                if (success or sqlite3_get_autocommit(dbhandle_ptr))
+                {
+                    // Either ready to commit, or SQLite already rolled
+                    // back the whole load on its own and there is nothing
+                    // left to retry.
+                    bulk_load_open = false;
+                    ended = true;
+                }
+                else
+                {
+                    LOG(error, "sqliteinterface", "end_bulk_load_db",
+                        "Unable to rebuild indexes.  Bulk load is still "
+                        "open.");
 
-                result.set(
-                    id,
-                    entity_ref->get_entity_owner(token),
-                    entity_ref->get_entity_type(),
-                    entity_ref->get_entity_version(),
-                    entity_ref->get_entity_name(token));
+                    sqlite3_exec(
+                        dbhandle_ptr,
+                        "ROLLBACK TO bulk_load_rebuild;"
+                        "RELEASE bulk_load_rebuild;",
+                        0,
+                        0,
+                        0);
+                }
             }
+        }
 
-            return result;
+        if (ended)
+        {
+            // Rolls back if the rebuild or the commit failed.
+            success = commit_transaction_db() and success;
+
+            close_read_connections();
+            success = open_read_connections() and success;
+
+            LOG(info, "sqliteinterface", "end_bulk_load_db",
+                "Bulk load ended, result: " + text::to_string(success));
         }
 
-        // Not in memory, use database metadata.
-        //
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::bulk_load_in_progress(void)
+    {
         boost::lock_guard<boost::mutex> guard(mutex);
-        get_metadata_internal(id, result);
 
-        return result;
+        return bulk_load_open;
     }
 
     // ----------------------------------------------------------------------
-    dbinterface::MetadataVector
-    SqliteBackend::get_entity_metadata(const dbtype::Entity::IdVector &ids)
+    bool SqliteBackend::start_backup_db(const std::string &backup_file)
     {
-        dbinterface::MetadataVector result;
-        std::vector<const dbtype::Id *> not_in_mem;
+        boost::lock_guard<boost::mutex> backup_guard(backup_mutex);
 
-        not_in_mem.reserve(ids.size());
+        if (backup_status.in_progress)
+        {
+            LOG(warning, "sqliteinterface", "start_backup_db",
+                "A backup is already running.");
+            return false;
+        }
 
-        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
-            id_iter != ids.end();
-            ++id_iter)
+        if (backup_file.empty() or (not dbhandle_ptr))
         {
-            if (is_mem_owned(*id_iter))
-            {
-                // Can look entity up directly in memory
-                //
-                dbinterface::EntityRef entity_ref =
-                    dbinterface::DatabaseAccess::instance()->get_entity(
-                        *id_iter);
+            return false;
+        }
 
-                if (entity_ref.valid())
-                {
-                    result.push_back(dbinterface::EntityMetadata());
-                    concurrency::ReaderLockToken token(*entity_ref.get());
+        if (backup_thread_ptr)
+        {
+            // Previous backup has finished; clean up after it.
+            //
+            backup_thread_ptr->join();
+            delete backup_thread_ptr;
+            backup_thread_ptr = 0;
+        }
 
-                    result.back().set(
-                        *id_iter,
-                        entity_ref->get_entity_owner(token),
-                        entity_ref->get_entity_type(),
-                        entity_ref->get_entity_version(),
-                        entity_ref->get_entity_name(token));
+        const std::string temp_file = backup_file + ".tmp";
+        sqlite3 *dest_handle_ptr = 0;
+        sqlite3_backup *backup_ptr = 0;
 
-                    if (not result.back().valid())
-                    {
-                        result.pop_back();
-                    }
-                }
-            }
-            else
-            {
-                // Need to look it up in the database in a batch operation.
-                not_in_mem.push_back(&(*id_iter));
-            }
+        if (sqlite3_open(temp_file.c_str(), &dest_handle_ptr) == SQLITE_OK)
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            backup_ptr = sqlite3_backup_init(
+                dest_handle_ptr,
+                "main",
+                dbhandle_ptr,
+                "main");
         }
 
-        if (not not_in_mem.empty())
+        if (not backup_ptr)
         {
-            // Have some IDs to look up direct in the database.
-            // Do them all at once under the same lock for efficiency
-            // (hopefully).
-            //
-            boost::lock_guard<boost::mutex> guard(mutex);
+            LOG(error, "sqliteinterface", "start_backup_db",
+                "Unable to start backup to " + temp_file + ": "
+                + (dest_handle_ptr ?
+                    std::string(sqlite3_errmsg(dest_handle_ptr)) :
+                    std::string("out of memory")));
+
+            sqlite3_close(dest_handle_ptr);
+            return false;
+        }
 
-            for (std::vector<const dbtype::Id *>::const_iterator id_ptr_iter =
-                not_in_mem.begin();
-                 id_ptr_iter != not_in_mem.end();
-                 ++id_ptr_iter)
-            {
-                result.push_back(dbinterface::EntityMetadata());
-                get_metadata_internal(**id_ptr_iter, result.back());
+        backup_status = dbinterface::BackupStatus();
+        backup_status.in_progress = true;
+        backup_status.backup_file = backup_file;
+        backup_status.started.set_to_now();
+        backup_cancel.store(false);
 
-                if (not result.back().valid())
-                {
-                    result.pop_back();
-                }
-            }
+        LOG(info, "sqliteinterface", "start_backup_db",
+            "Starting backup to " + backup_file);
 
-            not_in_mem.clear();
-        }
+        backup_thread_ptr = new boost::thread(boost::bind(
+            &SqliteBackend::backup_thread_main,
+            this,
+            backup_file,
+            temp_file,
+            dest_handle_ptr,
+            backup_ptr));
 
-        return result;
+        return true;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::new_site_in_db(dbtype::Id::SiteIdType &site_id)
+    dbinterface::BackupStatus SqliteBackend::get_backup_status_db(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::lock_guard<boost::mutex> backup_guard(backup_mutex);
 
-        bool success = false;
-        int rc = SQLITE_OK;
+        return backup_status;
+    }
 
-        // Query all deleted sites.  Pick first.  Mark as not deleted. Done.
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::delete_entity_db(const dbtype::Id &id)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
 
-        // See if we can reuse a site that has been deleted.
-        //
-        rc = sqlite3_step(list_deleted_sites_stmt);
+        // Confirm not still in memory
+        const bool success = not is_mem_owned(id);
 
-        if (rc == SQLITE_ROW)
+        if (success and (not id.is_default()))
         {
-            // Found one we can reuse!
-            //
-            site_id = (dbtype::Id::SiteIdType)
-                sqlite3_column_int(list_deleted_sites_stmt, 0);
+            bool delete_good = true;
+            int rc = SQLITE_OK;
 
-            // Update site as no longer deleted.
+            // Delete from entities table
             //
+
             if (sqlite3_bind_int(
-                undelete_site_stmt,
-                sqlite3_bind_parameter_index(undelete_site_stmt, "$SITEID"),
-                site_id) != SQLITE_OK)
+                delete_entity_stmt,
+                sqlite3_bind_parameter_index(delete_entity_stmt, "$SITEID"),
+                id.get_site_id()) != SQLITE_OK)
             {
-                LOG(error, "sqliteinterface", "new_site_in_db",
-                    "For undelete_site_stmt, could not bind $SITEID");
+                LOG(error, "sqliteinterface", "delete_entity_db",
+                    "For delete_entity_stmt, could not bind $SITEID");
             }
 
-            rc = sqlite3_step(undelete_site_stmt);
+            if (sqlite3_bind_int64(
+                delete_entity_stmt,
+                sqlite3_bind_parameter_index(delete_entity_stmt, "$ENTITYID"),
+                id.get_entity_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "delete_entity_db",
+                    "For delete_entity_stmt, could not bind $ENTITYID");
+            }
 
-            if (rc != SQLITE_DONE)
+            rc = sqlite3_step(delete_entity_stmt);
+
+            if (rc == SQLITE_DONE)
             {
-                LOG(error, "sqliteinterface", "new_site_in_db",
-                    "Could not reuse site: "
-                    + std::string(sqlite3_errstr(rc)));
+                delete_good = sqlite3_changes(dbhandle_ptr) > 0;
             }
             else
             {
-                rc = SQLITE_OK;
-                success = true;
+                LOG(error, "sqliteinterface", "delete_entity_db",
+                    "Could not delete Entity: "
+                    + std::string(sqlite3_errstr(rc)));
+                delete_good = false;
             }
 
-            reset(undelete_site_stmt);
-        }
-        else if (rc != SQLITE_DONE)
-        {
-            // Query errored out
-            LOG(error, "sqliteinterface", "new_site_in_db",
-                "Error getting list of deleted site IDs: "
-                + std::string(sqlite3_errstr(rc)));
-        }
-        else
-        {
-            // So the next section knows it wasn't an error that stopped us
-            // from getting an ID.
-            rc = SQLITE_OK;
-        }
-
-        reset(list_deleted_sites_stmt);
-
-        if ((not success) and (rc == SQLITE_OK))
-        {
-            // No available deleted sites to reuse.  Get a new one.
-            //
-            rc = sqlite3_step(next_site_id_stmt);
+            reset(delete_entity_stmt);
 
-            if (rc == SQLITE_ROW)
+            if (delete_good)
             {
-                // Found next ID.  Use it, and increment in table.
+                // Delete worked, add ID into table for future reuse
                 //
-                site_id = (dbtype::Id::SiteIdType)
-                    sqlite3_column_int(next_site_id_stmt, 0);
-
                 if (sqlite3_bind_int(
-                    update_next_site_id_stmt,
-                    sqlite3_bind_parameter_index(
-                        update_next_site_id_stmt,
-                        "$SITEID"),
-                    site_id + 1) != SQLITE_OK)
+                    add_reuse_entity_id_stmt,
+                    sqlite3_bind_parameter_index(add_reuse_entity_id_stmt, "$SITEID"),
+                    id.get_site_id()) != SQLITE_OK)
                 {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "For update_next_site_id_stmt, could not bind $SITEID");
+                    LOG(error, "sqliteinterface", "delete_entity_db",
+                        "For add_reuse_entity_id_stmt, could not bind $SITEID");
                 }
 
-                rc = sqlite3_step(update_next_site_id_stmt);
-
-                if (rc != SQLITE_DONE)
-                {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "Could not update next site ID: "
-                        + std::string(sqlite3_errstr(rc)));
-                }
-                else
+                if (sqlite3_bind_int64(
+                    add_reuse_entity_id_stmt,
+                    sqlite3_bind_parameter_index(add_reuse_entity_id_stmt, "$ENTITYID"),
+                    id.get_entity_id()) != SQLITE_OK)
                 {
-                    rc = SQLITE_OK;
-                    success = true;
+                    LOG(error, "sqliteinterface", "delete_entity_db",
+                        "For add_reuse_entity_id_stmt, could not bind $ENTITYID");
                 }
 
-                reset(update_next_site_id_stmt);
-            }
-            else
-            {
-                // No next ID found - first use.  Insert default and
-                // use it.
-                //
-                rc = sqlite3_step(insert_first_next_site_id_stmt);
+                rc = sqlite3_step(add_reuse_entity_id_stmt);
 
                 if (rc != SQLITE_DONE)
                 {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "Could not insert first next site ID: "
+                    LOG(error, "sqliteinterface", "delete_entity_db",
+                        "Could not insert Entity ID into reuse table: "
                         + std::string(sqlite3_errstr(rc)));
                 }
-                else
-                {
-                    rc = SQLITE_OK;
-                    success = true;
-                    site_id = 1;
-                }
 
-                reset(insert_first_next_site_id_stmt);
+                reset(add_reuse_entity_id_stmt);
+
+                // There is something to reuse again.
+                site_id_blocks[id.get_site_id()].reuse_checked = false;
+
+                // Delete from program registration if present.
+                delete_program_reg(id);
+
+                // Delete any application properties.
+                delete_entity_applications(id);
+
+                // Compiled code is deleted by a trigger.
+                unsaved_program_code.erase(id);
+
+                // Nothing to restore if the transaction fails.
+                transaction_new_entities.erase(id);
+                transaction_program_code.erase(id);
+
+                // Delete anything referencing it or referenced by it.
+                delete_entity_references(id);
             }
+        }
 
-            reset(next_site_id_stmt);
+        return success;
+    }
 
-            if (success)
+    // ----------------------------------------------------------------------
+    dbtype::EntityType SqliteBackend::get_entity_type_db(const dbtype::Id &id)
+    {
+        // In our cache of Entities in use, the type is known.  The Entity
+        // may be freed at any time, so it is looked at under the lock.
+        //
+        dbtype::EntityType entity_type = get_entity_type_mem(id);
+
+        if (entity_type == dbtype::ENTITYTYPE_invalid)
+        {
+            ReadConnectionGuard connection(*this);
+
+            // Not in cache, try and get it from the database
+            //
+            if (sqlite3_bind_int(
+                connection->get_entity_type_stmt,
+                sqlite3_bind_parameter_index(
+                    connection->get_entity_type_stmt,
+                    "$SITEID"),
+                id.get_site_id()) != SQLITE_OK)
             {
-                // Insert the new site into the sites table
+                LOG(error, "sqliteinterface", "get_entity_type_db",
+                    "For get_entity_type_stmt, could not bind $SITEID");
+            }
+
+            if (sqlite3_bind_int64(
+                connection->get_entity_type_stmt,
+                sqlite3_bind_parameter_index(
+                    connection->get_entity_type_stmt,
+                    "$ENTITYID"),
+                id.get_entity_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "get_entity_type_db",
+                    "For get_entity_type_stmt, could not bind $ENTITYID");
+            }
+
+            // Should be 0 or 1 lines
+            //
+            if (sqlite3_step(connection->get_entity_type_stmt) == SQLITE_ROW)
+            {
+                // Entity exists.  Get the type.
                 //
+                const int entity_type_int =
+                    sqlite3_column_int(connection->get_entity_type_stmt, 0);
 
-                if (sqlite3_bind_int(
-                    insert_new_site_stmt,
-                    sqlite3_bind_parameter_index(
-                        insert_new_site_stmt,
-                        "$SITEID"),
-                    site_id) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "For insert_new_site_stmt, could not bind $SITEID");
-                }
+                entity_type = (dbtype::EntityType) entity_type_int;
+            }
 
-                const std::string default_site_name =
-                    "Untitled Site " + text::to_string(site_id);
+            reset(connection->get_entity_type_stmt);
+        }
 
-                if (sqlite3_bind_text(
-                    insert_new_site_stmt,
-                    sqlite3_bind_parameter_index(
-                        insert_new_site_stmt,
-                        "$SITENAME"),
-                    default_site_name.c_str(),
-                    default_site_name.size(),
-                    SQLITE_TRANSIENT) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "For insert_new_site_stmt, could not bind $SITENAME");
-                }
+        return entity_type;
+    }
 
-                const std::string empty_description;
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::update_references_db(
+        const dbtype::Id &source_id,
+        const dbtype::Entity::ChangedIdFieldsMap &changed_fields)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
 
-                if (sqlite3_bind_text(
-                    insert_new_site_stmt,
-                    sqlite3_bind_parameter_index(
-                        insert_new_site_stmt,
-                        "$SITEDESCRIPTION"),
-                    empty_description.c_str(),
-                    empty_description.size(),
-                    SQLITE_TRANSIENT) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "For insert_new_site_stmt, could not bind $SITEDESCRIPTION");
-                }
+        bool success = dbhandle_ptr;
+        int rc = SQLITE_OK;
 
-                rc = sqlite3_step(insert_new_site_stmt);
+        if (success and (not references_dirty))
+        {
+            // The Entities these changes belong to are committed later.
+            // Until then, the index is ahead of them.
+            //
+            references_dirty = (sqlite3_exec(
+                dbhandle_ptr,
+                "INSERT OR IGNORE INTO reference_index_dirty(dirty) "
+                    "VALUES (1);",
+                0,
+                0,
+                0) == SQLITE_OK);
+            success = references_dirty;
 
-                if (rc != SQLITE_DONE)
+            if (not success)
+            {
+                LOG(error, "sqliteinterface", "update_references_db",
+                    "Could not mark reference index dirty: "
+                    + std::string(sqlite3_errmsg(dbhandle_ptr)));
+            }
+        }
+
+        for (dbtype::Entity::ChangedIdFieldsMap::const_iterator field_iter =
+                changed_fields.begin();
+            success and (field_iter != changed_fields.end());
+            ++field_iter)
+        {
+            // Removals first, then additions.
+            //
+            for (dbtype::Entity::IdSet::const_iterator removed_iter =
+                    field_iter->second.first.begin();
+                removed_iter != field_iter->second.first.end();
+                ++removed_iter)
+            {
+                if (bind_reference_params(
+                    delete_reference_stmt,
+                    *removed_iter,
+                    field_iter->first,
+                    source_id))
                 {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "Could not insert new site: "
-                        + std::string(sqlite3_errstr(rc)));
+                    rc = sqlite3_step(delete_reference_stmt);
 
-                    success = false;
+                    if (rc != SQLITE_DONE)
+                    {
+                        LOG(error, "sqliteinterface", "update_references_db",
+                            "Could not delete reference: "
+                            + std::string(sqlite3_errstr(rc)));
+                        success = false;
+                    }
                 }
                 else
                 {
-                    rc = SQLITE_OK;
+                    success = false;
                 }
 
-                reset(insert_new_site_stmt);
-
-                // Delete all existing entity data with that site ID in case
-                // anything is still there.
-                //
-                delete_site_entity_data(site_id);
+                reset(delete_reference_stmt);
             }
 
-            if (success)
+            for (dbtype::Entity::IdSet::const_iterator added_iter =
+                    field_iter->second.second.begin();
+                added_iter != field_iter->second.second.end();
+                ++added_iter)
             {
-                if (sqlite3_bind_int(
-                    insert_first_site_entity_id_stmt,
-                    sqlite3_bind_parameter_index(
-                        insert_first_site_entity_id_stmt,
-                        "$SITEID"),
-                    site_id) != SQLITE_OK)
-                {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "For insert_first_site_entity_id_stmt, could not bind $SITEID");
-                }
-
-                rc = sqlite3_step(insert_first_site_entity_id_stmt);
-
-                if (rc != SQLITE_DONE)
+                if (bind_reference_params(
+                    insert_reference_stmt,
+                    *added_iter,
+                    field_iter->first,
+                    source_id))
                 {
-                    LOG(error, "sqliteinterface", "new_site_in_db",
-                        "Could not insert new site first entity ID: "
-                        + std::string(sqlite3_errstr(rc)));
+                    rc = sqlite3_step(insert_reference_stmt);
 
-                    success = false;
+                    if (rc != SQLITE_DONE)
+                    {
+                        LOG(error, "sqliteinterface", "update_references_db",
+                            "Could not insert reference: "
+                            + std::string(sqlite3_errstr(rc)));
+                        success = false;
+                    }
                 }
                 else
                 {
-                    rc = SQLITE_OK;
+                    success = false;
                 }
 
-                reset(insert_first_site_entity_id_stmt);
+                reset(insert_reference_stmt);
             }
         }
 
@@ -1509,1274 +1596,4261 @@ namespace sqliteinterface
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::delete_site_in_db(const dbtype::Id::SiteIdType site_id)
+    bool SqliteBackend::references_saved_db(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
 
-        bool success = delete_site_entity_data(site_id);
-        int rc = SQLITE_OK;
+        // Always cleared, since a rolled back clear leaves the marker
+        // behind without references_dirty knowing.
+        //
+        const bool success = dbhandle_ptr and (sqlite3_exec(
+            dbhandle_ptr,
+            "DELETE FROM reference_index_dirty;",
+            0,
+            0,
+            0) == SQLITE_OK);
 
         if (success)
         {
-            if (sqlite3_bind_int(
-                mark_site_deleted_stmt,
-                sqlite3_bind_parameter_index(
-                    mark_site_deleted_stmt,
-                    "$SITEID"),
-                site_id) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "delete_site_in_db",
-                    "For mark_site_deleted_stmt, could not bind $SITEID");
-            }
+            references_dirty = false;
+        }
+        else
+        {
+            LOG(error, "sqliteinterface", "references_saved_db",
+                "Could not clear reference index marker.");
+        }
 
+        return success;
+    }
 
-            rc = sqlite3_step(mark_site_deleted_stmt);
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::save_access_stats_db(
+        const dbinterface::DbBackend::AccessStatsMap &stats)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
 
-            if (rc != SQLITE_DONE)
-            {
-                LOG(error, "sqliteinterface", "delete_site_in_db",
-                    "Could not mark site as deleted: "
-                    + std::string(sqlite3_errstr(rc)));
+        bool success = dbhandle_ptr;
+        int rc = SQLITE_OK;
 
+        for (dbinterface::DbBackend::AccessStatsMap::const_iterator stats_iter =
+                stats.begin();
+            success and (stats_iter != stats.end());
+            ++stats_iter)
+        {
+            if (sqlite3_bind_int(
+                save_access_stmt,
+                sqlite3_bind_parameter_index(save_access_stmt, "$SITEID"),
+                stats_iter->first.get_site_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "save_access_stats_db",
+                    "Could not bind $SITEID");
                 success = false;
             }
 
-            if (sqlite3_bind_int(
-                delete_all_site_entity_id_reuse_stmt,
-                sqlite3_bind_parameter_index(
-                    delete_all_site_entity_id_reuse_stmt,
-                    "$SITEID"),
-                site_id) != SQLITE_OK)
+            if (sqlite3_bind_int64(
+                save_access_stmt,
+                sqlite3_bind_parameter_index(save_access_stmt, "$ENTITYID"),
+                stats_iter->first.get_entity_id()) != SQLITE_OK)
             {
-                LOG(error, "sqliteinterface", "delete_site_in_db",
-                    "For delete_all_site_entity_id_reuse_stmt, could not bind $SITEID");
+                LOG(error, "sqliteinterface", "save_access_stats_db",
+                    "Could not bind $ENTITYID");
+                success = false;
             }
 
-
-            rc = sqlite3_step(delete_all_site_entity_id_reuse_stmt);
-
-            if (rc != SQLITE_DONE)
+            if (sqlite3_bind_int64(
+                save_access_stmt,
+                sqlite3_bind_parameter_index(save_access_stmt, "$TIMESTAMP"),
+                stats_iter->second.first.get_time()) != SQLITE_OK)
             {
-                LOG(error, "sqliteinterface", "delete_site_in_db",
-                    "Could not delete all site reuse entity IDs: "
-                    + std::string(sqlite3_errstr(rc)));
-
+                LOG(error, "sqliteinterface", "save_access_stats_db",
+                    "Could not bind $TIMESTAMP");
                 success = false;
             }
 
-            if (sqlite3_bind_int(
-                delete_site_next_entity_id_stmt,
-                sqlite3_bind_parameter_index(
-                    delete_site_next_entity_id_stmt,
-                    "$SITEID"),
-                site_id) != SQLITE_OK)
+            if (sqlite3_bind_int64(
+                save_access_stmt,
+                sqlite3_bind_parameter_index(save_access_stmt, "$COUNT"),
+                (sqlite3_int64) stats_iter->second.second) != SQLITE_OK)
             {
-                LOG(error, "sqliteinterface", "delete_site_in_db",
-                    "For delete_site_next_entity_id_stmt, could not bind $SITEID");
+                LOG(error, "sqliteinterface", "save_access_stats_db",
+                    "Could not bind $COUNT");
+                success = false;
             }
 
-
-            rc = sqlite3_step(delete_site_next_entity_id_stmt);
-
-            if (rc != SQLITE_DONE)
+            if (success)
             {
-                LOG(error, "sqliteinterface", "delete_site_in_db",
-                    "Could not delete site fresh ID table entry: "
-                    + std::string(sqlite3_errstr(rc)));
+                rc = sqlite3_step(save_access_stmt);
 
-                success = false;
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "save_access_stats_db",
+                        "Could not save access statistics: "
+                        + std::string(sqlite3_errstr(rc)));
+                    success = false;
+                }
             }
 
-            reset(mark_site_deleted_stmt);
-            reset(delete_all_site_entity_id_reuse_stmt);
-            reset(delete_site_next_entity_id_stmt);
+            reset(save_access_stmt);
         }
 
         return success;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::get_site_name_in_db(
-        const dbtype::Id::SiteIdType site_id,
-        std::string &site_name)
+    dbtype::Entity::IdVector SqliteBackend::get_references_to_db(
+        const dbtype::Id &target_id,
+        const dbtype::EntityField field)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        ReadConnectionGuard connection(*this);
 
-        bool success = false;
+        dbtype::Entity::IdVector result;
 
-        site_name.clear();
+        if (sqlite3_bind_int(
+            connection->get_references_to_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_references_to_stmt,
+                "$SITEID"),
+            target_id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_references_to_db",
+                "For get_references_to_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int64(
+            connection->get_references_to_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_references_to_stmt,
+                "$ENTITYID"),
+            target_id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_references_to_db",
+                "For get_references_to_stmt, could not bind $ENTITYID");
+        }
 
         if (sqlite3_bind_int(
-            get_site_name_stmt,
-            sqlite3_bind_parameter_index(get_site_name_stmt, "$SITEID"),
-            site_id) != SQLITE_OK)
+            connection->get_references_to_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_references_to_stmt,
+                "$FIELD"),
+            field) != SQLITE_OK)
         {
-            LOG(error, "sqliteinterface", "get_site_name_in_db",
-                "For get_site_name_stmt, could not bind $SITEID");
+            LOG(error, "sqliteinterface", "get_references_to_db",
+                "For get_references_to_stmt, could not bind $FIELD");
         }
 
-        // Should be 0 or 1 lines
-        //
-        if (sqlite3_step(get_site_name_stmt) == SQLITE_ROW)
+        int rc = sqlite3_step(connection->get_references_to_stmt);
+
+        while (rc == SQLITE_ROW)
         {
-            // Site exists.  Get the name.
-            //
-            success = true;
-            const char *name_char_ptr = (const char *)
-                sqlite3_column_text(get_site_name_stmt, 0);
-            const int name_char_size =
-                sqlite3_column_bytes(get_site_name_stmt, 0);
+            result.push_back(dbtype::Id(
+                (dbtype::Id::SiteIdType) sqlite3_column_int(
+                    connection->get_references_to_stmt, 0),
+                (dbtype::Id::EntityIdType) sqlite3_column_int64(
+                    connection->get_references_to_stmt, 1)));
 
-            if (name_char_size)
-            {
-                site_name.assign(name_char_ptr, name_char_size);
-            }
+            rc = sqlite3_step(connection->get_references_to_stmt);
+        }
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "get_references_to_db",
+                "Error getting references to " + target_id.to_string(true)
+                + ": " + std::string(sqlite3_errstr(rc)));
         }
 
-        reset(get_site_name_stmt);
+        reset(connection->get_references_to_stmt);
 
-        return success;
+        return result;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::set_site_name_in_db(
-        const dbtype::Id::SiteIdType site_id,
-        const std::string &site_name)
+    dbtype::Entity::IdFieldsMap SqliteBackend::get_references_from_db(
+        const dbtype::Id &source_id)
     {
-        bool success = false;
-        int rc = SQLITE_OK;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        ReadConnectionGuard connection(*this);
+
+        dbtype::Entity::IdFieldsMap result;
 
         if (sqlite3_bind_int(
-            set_site_name_stmt,
-            sqlite3_bind_parameter_index(set_site_name_stmt, "$SITEID"),
-            site_id) != SQLITE_OK)
+            connection->get_references_from_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_references_from_stmt,
+                "$SITEID"),
+            source_id.get_site_id()) != SQLITE_OK)
         {
-            LOG(error, "sqliteinterface", "set_site_name_in_db",
-                "For set_site_name_stmt, could not bind $SITEID");
+            LOG(error, "sqliteinterface", "get_references_from_db",
+                "For get_references_from_stmt, could not bind $SITEID");
         }
 
-        if (sqlite3_bind_text(
-            set_site_name_stmt,
+        if (sqlite3_bind_int64(
+            connection->get_references_from_stmt,
             sqlite3_bind_parameter_index(
-                set_site_name_stmt,
-                "$SITENAME"),
-            site_name.c_str(),
-            site_name.size(),
-            SQLITE_TRANSIENT) != SQLITE_OK)
+                connection->get_references_from_stmt,
+                "$ENTITYID"),
+            source_id.get_entity_id()) != SQLITE_OK)
         {
-            LOG(error, "sqliteinterface", "set_site_name_in_db",
-                "For set_site_name_stmt, could not bind $SITENAME");
+            LOG(error, "sqliteinterface", "get_references_from_db",
+                "For get_references_from_stmt, could not bind $ENTITYID");
         }
 
-        rc = sqlite3_step(set_site_name_stmt);
+        int rc = sqlite3_step(connection->get_references_from_stmt);
 
-        if (rc == SQLITE_DONE)
+        while (rc == SQLITE_ROW)
         {
-            success = true;
+            const dbtype::Id target_id(
+                (dbtype::Id::SiteIdType) sqlite3_column_int(
+                    connection->get_references_from_stmt, 0),
+                (dbtype::Id::EntityIdType) sqlite3_column_int64(
+                    connection->get_references_from_stmt, 1));
+
+            result[target_id].insert((dbtype::EntityField)
+                sqlite3_column_int(connection->get_references_from_stmt, 2));
+
+            rc = sqlite3_step(connection->get_references_from_stmt);
         }
-        else
+
+        if (rc != SQLITE_DONE)
         {
-            LOG(error, "sqliteinterface", "set_site_name_in_db",
-                "Could not set site name: " + std::string(sqlite3_errstr(rc)));
+            LOG(error, "sqliteinterface", "get_references_from_db",
+                "Error getting references from " + source_id.to_string(true)
+                + ": " + std::string(sqlite3_errstr(rc)));
         }
 
-        reset(set_site_name_stmt);
+        reset(connection->get_references_from_stmt);
 
-        return success;
+        return result;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::get_site_description_in_db(
+    dbtype::Entity::IdVector SqliteBackend::find_in_db(
         const dbtype::Id::SiteIdType site_id,
-        std::string &site_description)
+        const dbtype::EntityType type,
+        const dbtype::Id::EntityIdType owner_id,
+        const std::string &name,
+        const bool exact)
     {
-        bool success = false;
-
-        boost::lock_guard<boost::mutex> guard(mutex);
-
-        site_description.clear();
+        dbtype::Entity::IdVector result;
 
-        if (sqlite3_bind_int(
-            get_site_description_stmt,
-            sqlite3_bind_parameter_index(get_site_description_stmt, "$SITEID"),
-            site_id) != SQLITE_OK)
+        if (not site_id)
         {
-            LOG(error, "sqliteinterface", "get_site_description_in_db",
-                "For get_site_description_stmt, could not bind $SITEID");
+            LOG(error, "sqliteinterface", "find_in_db()",
+                "Site was not specified; cannot search");
+            return result;
         }
 
-        // Should be 0 or 1 lines
+        ReadConnectionGuard connection(*this);
+
+        sqlite3_stmt *stmt = 0;
+
+        // Figure what type of search they want base don which parameters were
+        // filled in.
         //
-        if (sqlite3_step(get_site_description_stmt) == SQLITE_ROW)
+        if (type == dbtype::ENTITYTYPE_invalid)
         {
-            // Site exists.  Get the description.
-            //
-            success = true;
-            const char *description_char_ptr = (const char *)
-                sqlite3_column_text(get_site_description_stmt, 0);
-            const int description_char_size =
-                sqlite3_column_bytes(get_site_description_stmt, 0);
-
-            if (description_char_size)
+            if (owner_id and (not name.empty()))
             {
-                site_description.assign(
-                    description_char_ptr,
-                    description_char_size);
+                stmt = connection->find_site_owner_name_stmt;
+            }
+            else if (owner_id)
+            {
+                stmt = connection->find_site_owner_stmt;
+            }
+            else if (not name.empty())
+            {
+                stmt = connection->find_site_name_stmt;
+            }
+        }
+        else
+        {
+            if (owner_id and name.empty())
+            {
+                stmt = connection->find_site_owner_type_stmt;
+            }
+            else if (owner_id)
+            {
+                if (exact)
+                {
+                    stmt = connection->find_site_type_owner_name_exact_stmt;
+                }
+                else
+                {
+                    stmt = connection->find_site_type_owner_name_stmt;
+                }
+            }
+            else
+            {
+                if (exact)
+                {
+                    stmt = connection->find_site_type_name_exact_stmt;
+                }
+                else
+                {
+                    stmt = connection->find_site_type_name_stmt;
+                }
             }
         }
 
-        reset(get_site_description_stmt);
-
-        return success;
-    }
-
-    // ----------------------------------------------------------------------
-    bool SqliteBackend::set_site_description_in_db(
-        const dbtype::Id::SiteIdType site_id,
-        const std::string &site_description)
-    {
-        bool success = false;
-        int rc = SQLITE_OK;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        if (not stmt)
+        {
+            LOG(error, "sqliteinterface", "find_in_db()",
+                "Bad combination of parameters given; cannot search");
+            return result;
+        }
 
         if (sqlite3_bind_int(
-            set_site_description_stmt,
-            sqlite3_bind_parameter_index(set_site_description_stmt, "$SITEID"),
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
             site_id) != SQLITE_OK)
         {
-            LOG(error, "sqliteinterface", "set_site_description_in_db",
-                "For set_site_description_stmt, could not bind $SITEID");
+            LOG(error, "sqliteinterface", "find_in_db()",
+                "For stmt, could not bind $SITEID");
         }
 
-        if (sqlite3_bind_text(
-            set_site_description_stmt,
-            sqlite3_bind_parameter_index(
-                set_site_description_stmt,
-                "$SITEDESCRIPTION"),
-            site_description.c_str(),
-            site_description.size(),
-            SQLITE_TRANSIENT) != SQLITE_OK)
+        if (type != dbtype::ENTITYTYPE_invalid)
         {
-            LOG(error, "sqliteinterface", "set_site_description_in_db",
-                "For set_site_description_stmt, could not bind $SITEDESCRIPTION");
+            if (sqlite3_bind_int(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$TYPE"),
+                type) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "find_in_db()",
+                    "For stmt, could not bind $TYPE");
+            }
         }
 
-        rc = sqlite3_step(set_site_description_stmt);
-
-        if (rc == SQLITE_DONE)
+        if (owner_id)
         {
-            success = true;
+            if (sqlite3_bind_int(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$OWNER"),
+                owner_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "find_in_db()",
+                    "For stmt, could not bind $OWNER");
+            }
         }
-        else
+
+        if (not name.empty())
         {
-            LOG(error, "sqliteinterface", "set_site_description_in_db",
-                "Could not set site description: " + std::string(sqlite3_errstr(rc)));
+            if (sqlite3_bind_text(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$NAME"),
+                name.c_str(),
+                name.size(),
+                SQLITE_TRANSIENT) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "find_in_db()",
+                    "For stmt, could not bind $NAME");
+            }
         }
 
-        reset(set_site_description_stmt);
+        add_entity_ids(stmt, site_id, result);
 
-        return success;
+        reset(stmt);
+
+        return result;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::create_tables(void)
+    dbtype::Entity::IdVector SqliteBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id)
     {
-        const std::string create_tables_str =
-         "CREATE TABLE IF NOT EXISTS entities("
-            "site_id INTEGER NOT NULL,"
-            "entity_id INTEGER NOT NULL,"
-            "owner INTEGER,"
-            "type INTEGER NOT NULL,"
-            "version INTEGER NOT NULL,"
-            "name TEXT NOT NULL COLLATE NOCASE,"
-            "data BLOB NOT NULL,"
-         "PRIMARY KEY(site_id, entity_id)) WITHOUT ROWID;"
-         "CREATE INDEX IF NOT EXISTS entity_type_idx ON entities(site_id, name, type);"
+        dbtype::Entity::IdVector result;
 
-         "CREATE TABLE IF NOT EXISTS program_registrations("
-            "site_id INTEGER NOT NULL,"
-            "entity_id INTEGER NOT NULL,"
-            "registration_name TEXT NOT NULL COLLATE NOCASE,"
-         "PRIMARY KEY(site_id, registration_name)) WITHOUT ROWID;"
-         "CREATE INDEX IF NOT EXISTS program_registrations_idx ON program_registrations(site_id, entity_id);"
+        if (not site_id)
+        {
+            LOG(error, "sqliteinterface", "find_in_db(site)",
+                "Site was not specified; cannot search");
+            return result;
+        }
 
-         "CREATE TABLE IF NOT EXISTS sites("
-            "site_id INTEGER NOT NULL,"
-            "deleted INTEGER NOT NULL,"
-            "site_name TEXT NOT NULL,"
-            "site_description TEXT NOT NULL,"
-            "PRIMARY KEY(site_id, deleted)) WITHOUT ROWID;"
+        ReadConnectionGuard connection(*this);
 
-         "CREATE TABLE IF NOT EXISTS id_reuse("
-            "site_id INTEGER NOT NULL,"
-            "deleted_entity_id INTEGER NOT NULL,"
-            "PRIMARY KEY(site_id, deleted_entity_id)) WITHOUT ROWID;"
+        if (sqlite3_bind_int(
+            connection->list_all_entities_site_stmt,
+            sqlite3_bind_parameter_index(
+                connection->list_all_entities_site_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_in_db(site)",
+                "For list_all_entities_site_stmt, could not bind $SITEID");
+        }
 
-         "CREATE TABLE IF NOT EXISTS next_id("
-            "site_id INTEGER NOT NULL,"
-            "next_entity_id INTEGER NOT NULL,"
-            "PRIMARY KEY(site_id)) WITHOUT ROWID;"
+        add_entity_ids(connection->list_all_entities_site_stmt, site_id, result);
 
-         "CREATE TABLE IF NOT EXISTS next_site_id("
-            "site_id INTEGER NOT NULL,"
-            "PRIMARY KEY(site_id)) WITHOUT ROWID;"
+        reset(connection->list_all_entities_site_stmt);
 
-         "CREATE TABLE IF NOT EXISTS display_names("
-            "site_id INTEGER NOT NULL,"
-            "entity_id INTEGER NOT NULL,"
-            "player INTEGER NOT NULL,"
-            "name TEXT NOT NULL COLLATE NOCASE,"
-            "display_name TEXT NOT NULL COLLATE NOCASE,"
-            "PRIMARY KEY(site_id, entity_id),"
-            "FOREIGN KEY(site_id, entity_id) REFERENCES entities(site_id, entity_id)) WITHOUT ROWID;"
-         "CREATE INDEX IF NOT EXISTS display_name_player_idx ON display_names(site_id, player, name, display_name);";
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::visit_site_entities_db(
+        const dbtype::Id::SiteIdType site_id,
+        dbinterface::EntityVisitor &visitor)
+    {
+        if (not site_id)
+        {
+            LOG(error, "sqliteinterface", "visit_site_entities_db",
+                "Site was not specified; cannot visit");
+            return false;
+        }
 
         bool success = true;
-        char *rc_error_str_ptr = 0;
-        const int rc = sqlite3_exec(
-            dbhandle_ptr,
-            create_tables_str.c_str(),
-            0,
-            0,
-            &rc_error_str_ptr);
+        bool more_entities = true;
+        dbtype::Id::EntityIdType after_entity_id = 0;
+        EntityPtrVector page;
 
-        if (rc != SQLITE_OK)
+        page.reserve(VISIT_PAGE_SIZE);
+
+        while (success and more_entities)
         {
-            success = false;
+            // Read in a page, then let go of the connection before visiting
+            // so the visitor can use the database too (for instance, to
+            // load application properties).
+            //
+            {
+                ReadConnectionGuard connection(*this);
+                sqlite3_stmt * const stmt =
+                    connection->list_site_entities_stmt;
+
+                if ((sqlite3_bind_int(
+                        stmt,
+                        sqlite3_bind_parameter_index(stmt, "$SITEID"),
+                        site_id) != SQLITE_OK) or
+                    (sqlite3_bind_int64(
+                        stmt,
+                        sqlite3_bind_parameter_index(stmt, "$AFTERID"),
+                        after_entity_id) != SQLITE_OK) or
+                    (sqlite3_bind_int(
+                        stmt,
+                        sqlite3_bind_parameter_index(stmt, "$LIMIT"),
+                        (int) VISIT_PAGE_SIZE) != SQLITE_OK))
+                {
+                    LOG(error, "sqliteinterface", "visit_site_entities_db",
+                        "For list_site_entities_stmt, could not bind");
+                    success = false;
+                }
+                else
+                {
+                    int rc = sqlite3_step(stmt);
 
-            LOG(fatal, "sqliteinterface", "create_tables",
-                "Unable to create tables: " + std::string(sqlite3_errstr(rc))
-                + "   Full error: " + std::string(rc_error_str_ptr));
+                    while (rc == SQLITE_ROW)
+                    {
+                        after_entity_id = (dbtype::Id::EntityIdType)
+                            sqlite3_column_int64(stmt, 0);
 
-            sqlite3_free(rc_error_str_ptr);
-            rc_error_str_ptr = 0;
+                        dbtype::Entity * const entity_ptr =
+                            make_entity_from_row(
+                                stmt,
+                                1,
+                                dbtype::Id(site_id, after_entity_id),
+                                false);
+
+                        if (entity_ptr)
+                        {
+                            page.push_back(entity_ptr);
+                        }
+                        else
+                        {
+                            success = false;
+                        }
+
+                        rc = sqlite3_step(stmt);
+                    }
+
+                    if (rc != SQLITE_DONE)
+                    {
+                        LOG(error, "sqliteinterface", "visit_site_entities_db",
+                            "Error listing Entities for site "
+                            + text::to_string(site_id) + ": "
+                            + std::string(sqlite3_errstr(rc)));
+                        success = false;
+                    }
+                }
+
+                reset(stmt);
+            }
+
+            more_entities = (page.size() == VISIT_PAGE_SIZE);
+
+            for (EntityPtrVector::iterator entity_iter = page.begin();
+                entity_iter != page.end();
+                ++entity_iter)
+            {
+                if (success)
+                {
+                    success = visitor.visit_entity(*entity_iter);
+                }
+
+                delete *entity_iter;
+            }
+
+            page.clear();
         }
 
         return success;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::sql_init(void)
+    bool SqliteBackend::site_has_entities_db(
+        const dbtype::Id::SiteIdType site_id)
     {
-        bool success = true;
+        ReadConnectionGuard connection(*this);
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT site_id FROM sites WHERE deleted = 0;",
-            -1,
-            &list_sites_stmt,
-            0) != SQLITE_OK)
+        if (sqlite3_bind_int(
+            connection->site_has_entities_stmt,
+            sqlite3_bind_parameter_index(
+                connection->site_has_entities_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for finding valid sites.");
+            LOG(error, "sqliteinterface", "site_has_entities_db",
+                "For site_has_entities_stmt, could not bind $SITEID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT site_id FROM sites WHERE deleted = 1;",
-            -1,
-            &list_deleted_sites_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        // Should be 0 or 1 lines
+        const bool has_entities =
+            (sqlite3_step(connection->site_has_entities_stmt) == SQLITE_ROW);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for finding deleted sites.");
-        }
+        reset(connection->site_has_entities_stmt);
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID;",
-            -1,
-            &list_all_entities_site_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        return has_entities;
+    }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing all of site's entities.");
-        }
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector SqliteBackend::get_recently_accessed_db(
+        const dbtype::Id::SiteIdType site_id,
+        const size_t max_entities)
+    {
+        dbtype::Entity::IdVector result;
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-            "type = $TYPE AND owner = $OWNER AND "
-            "name = $NAME;",
-            -1,
-            &find_site_type_owner_name_exact_stmt,
-            0) != SQLITE_OK)
+        if ((not site_id) or (not max_entities))
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by site, "
-                "type, owner, and exact name");
+            return result;
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-            "type = $TYPE AND owner = $OWNER AND "
-            "name LIKE '%' || $NAME || '%';",
-            -1,
-            &find_site_type_owner_name_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by site, "
-                "type, owner, and name");
-        }
+        ReadConnectionGuard connection(*this);
+        sqlite3_stmt * const stmt = connection->list_recently_accessed_stmt;
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-            "owner = $OWNER AND type = $TYPE;",
-            -1,
-            &find_site_owner_type_stmt,
-            0) != SQLITE_OK)
+        if ((sqlite3_bind_int(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$SITEID"),
+                site_id) != SQLITE_OK) or
+            (sqlite3_bind_int64(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$LIMIT"),
+                max_entities) != SQLITE_OK))
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by site, "
-                "owner, and type");
+            LOG(error, "sqliteinterface", "get_recently_accessed_db",
+                "For list_recently_accessed_stmt, could not bind parameters");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-            "owner = $OWNER AND "
-            "name LIKE '%' || $NAME || '%';",
-            -1,
-            &find_site_owner_name_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by site, "
-                "owner, and name");
-        }
+        add_entity_ids(stmt, site_id, result);
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-            "owner = $OWNER",
-            -1,
-            &find_site_owner_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        reset(stmt);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by site "
-                "and owner");
-        }
+        return result;
+    }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-                "name LIKE '%' || $NAME || '%';",
+    // ----------------------------------------------------------------------
+    dbtype::Id SqliteBackend::find_program_reg_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &registration_name)
+    {
+        ReadConnectionGuard connection(*this);
+        dbtype::Id result;
+
+        if (sqlite3_bind_int(
+            connection->find_program_reg_stmt,
+            sqlite3_bind_parameter_index(
+                connection->find_program_reg_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_program_reg_in_db",
+                "For find_program_reg_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_text(
+            connection->find_program_reg_stmt,
+            sqlite3_bind_parameter_index(
+                connection->find_program_reg_stmt,
+                "$REGNAME"),
+            registration_name.c_str(),
+            registration_name.size(),
+            SQLITE_TRANSIENT) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_program_reg_in_db",
+                "For find_program_reg_stmt, could not bind $REGNAME");
+        }
+
+        const int rc = sqlite3_step(connection->find_program_reg_stmt);
+
+        // Expecting 0 or 1 results.
+        //
+        if (rc == SQLITE_ROW)
+        {
+            // Found a registration
+            //
+            result =
+                dbtype::Id(
+                    site_id,
+                    (dbtype::Id::EntityIdType)
+                        sqlite3_column_int64(connection->find_program_reg_stmt, 0));
+        }
+        else if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "find_program_reg_in_db",
+                "Error getting registration info for program.");
+        }
+
+        reset (connection->find_program_reg_stmt);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SqliteBackend::find_program_reg_name_in_db(
+        const dbtype::Id &id)
+    {
+        ReadConnectionGuard connection(*this);
+        std::string result;
+
+        if (sqlite3_bind_int(
+            connection->find_program_reg_id_stmt,
+            sqlite3_bind_parameter_index(
+                connection->find_program_reg_id_stmt,
+                "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_program_reg_name_in_db",
+                "For find_program_reg_id_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int(
+            connection->find_program_reg_id_stmt,
+            sqlite3_bind_parameter_index(
+                connection->find_program_reg_id_stmt,
+                "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_program_reg_name_in_db",
+                "For find_program_reg_id_stmt, could not bind $REGNAME");
+        }
+
+        const int rc = sqlite3_step(connection->find_program_reg_id_stmt);
+
+        // Expecting 0 or 1 results.
+        //
+        if (rc == SQLITE_ROW)
+        {
+            // Found a registration
+            //
+            const char *reg_char_ptr = (const char *)
+                sqlite3_column_text(connection->find_program_reg_id_stmt, 0);
+            const int reg_char_size =
+                sqlite3_column_bytes(connection->find_program_reg_id_stmt, 0);
+
+            if (reg_char_size)
+            {
+                result.assign(reg_char_ptr, reg_char_size);
+            }
+        }
+        else if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "find_program_reg_name_in_db",
+                "Error getting registration info for program.");
+        }
+
+        reset (connection->find_program_reg_id_stmt);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id::SiteIdVector SqliteBackend::get_site_ids_in_db(void)
+    {
+        ReadConnectionGuard connection(*this);
+
+        dbtype::Id::SiteIdVector result;
+        int rc = sqlite3_step(connection->list_sites_stmt);
+
+        while (rc == SQLITE_ROW)
+        {
+            result.push_back(
+                (dbtype::Id::SiteIdType) sqlite3_column_int(
+                    connection->list_sites_stmt, 0));
+            rc = sqlite3_step(connection->list_sites_stmt);
+        }
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "get_site_ids_in_db",
+                "Error getting list of site IDs: "
+                + std::string(sqlite3_errstr(rc)));
+        }
+
+        reset(connection->list_sites_stmt);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::EntityMetadata
+    SqliteBackend::get_entity_metadata(const dbtype::Id &id)
+    {
+        dbinterface::EntityMetadata result;
+
+        // See if in memory;  If so, use that version instead
+        if (is_mem_owned(id))
+        {
+            dbinterface::EntityRef entity_ref =
+                dbinterface::DatabaseAccess::instance()->get_entity(id);
+
+            if (entity_ref.valid())
+            {
+                concurrency::ReaderLockToken token(*entity_ref.get());
+
+                result.set(
+                    id,
+                    entity_ref->get_entity_owner(token),
+                    entity_ref->get_entity_type(),
+                    entity_ref->get_entity_version(),
+                    entity_ref->get_entity_name(token));
+            }
+
+            return result;
+        }
+
+        // Not in memory, use database metadata.
+        //
+        ReadConnectionGuard connection(*this);
+        get_metadata_internal(*connection, id, result);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::MetadataVector
+    SqliteBackend::get_entity_metadata(const dbtype::Entity::IdVector &ids)
+    {
+        dbinterface::MetadataVector result;
+        std::vector<const dbtype::Id *> not_in_mem;
+
+        not_in_mem.reserve(ids.size());
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            if (is_mem_owned(*id_iter))
+            {
+                // Can look entity up directly in memory
+                //
+                dbinterface::EntityRef entity_ref =
+                    dbinterface::DatabaseAccess::instance()->get_entity(
+                        *id_iter);
+
+                if (entity_ref.valid())
+                {
+                    result.push_back(dbinterface::EntityMetadata());
+                    concurrency::ReaderLockToken token(*entity_ref.get());
+
+                    result.back().set(
+                        *id_iter,
+                        entity_ref->get_entity_owner(token),
+                        entity_ref->get_entity_type(),
+                        entity_ref->get_entity_version(),
+                        entity_ref->get_entity_name(token));
+
+                    if (not result.back().valid())
+                    {
+                        result.pop_back();
+                    }
+                }
+            }
+            else
+            {
+                // Need to look it up in the database in a batch operation.
+                not_in_mem.push_back(&(*id_iter));
+            }
+        }
+
+        if (not not_in_mem.empty())
+        {
+            // Have some IDs to look up direct in the database.
+            // Do them all at once under the same lock for efficiency
+            // (hopefully).
+            //
+            ReadConnectionGuard connection(*this);
+
+            for (std::vector<const dbtype::Id *>::const_iterator id_ptr_iter =
+                not_in_mem.begin();
+                 id_ptr_iter != not_in_mem.end();
+                 ++id_ptr_iter)
+            {
+                result.push_back(dbinterface::EntityMetadata());
+                get_metadata_internal(
+                    *connection,
+                    **id_ptr_iter,
+                    result.back());
+
+                if (not result.back().valid())
+                {
+                    result.pop_back();
+                }
+            }
+
+            not_in_mem.clear();
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::new_site_in_db(dbtype::Id::SiteIdType &site_id)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
+
+        bool success = false;
+        int rc = SQLITE_OK;
+
+        // Query all deleted sites.  Pick first.  Mark as not deleted. Done.
+
+        // See if we can reuse a site that has been deleted.
+        //
+        rc = sqlite3_step(list_deleted_sites_stmt);
+
+        if (rc == SQLITE_ROW)
+        {
+            // Found one we can reuse!
+            //
+            site_id = (dbtype::Id::SiteIdType)
+                sqlite3_column_int(list_deleted_sites_stmt, 0);
+
+            // Update site as no longer deleted.
+            //
+            if (sqlite3_bind_int(
+                undelete_site_stmt,
+                sqlite3_bind_parameter_index(undelete_site_stmt, "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "new_site_in_db",
+                    "For undelete_site_stmt, could not bind $SITEID");
+            }
+
+            rc = sqlite3_step(undelete_site_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "new_site_in_db",
+                    "Could not reuse site: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
+            else
+            {
+                rc = SQLITE_OK;
+                success = true;
+            }
+
+            reset(undelete_site_stmt);
+        }
+        else if (rc != SQLITE_DONE)
+        {
+            // Query errored out
+            LOG(error, "sqliteinterface", "new_site_in_db",
+                "Error getting list of deleted site IDs: "
+                + std::string(sqlite3_errstr(rc)));
+        }
+        else
+        {
+            // So the next section knows it wasn't an error that stopped us
+            // from getting an ID.
+            rc = SQLITE_OK;
+        }
+
+        reset(list_deleted_sites_stmt);
+
+        if ((not success) and (rc == SQLITE_OK))
+        {
+            // No available deleted sites to reuse.  Get a new one.
+            //
+            rc = sqlite3_step(next_site_id_stmt);
+
+            if (rc == SQLITE_ROW)
+            {
+                // Found next ID.  Use it, and increment in table.
+                //
+                site_id = (dbtype::Id::SiteIdType)
+                    sqlite3_column_int(next_site_id_stmt, 0);
+
+                if (sqlite3_bind_int(
+                    update_next_site_id_stmt,
+                    sqlite3_bind_parameter_index(
+                        update_next_site_id_stmt,
+                        "$SITEID"),
+                    site_id + 1) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "For update_next_site_id_stmt, could not bind $SITEID");
+                }
+
+                rc = sqlite3_step(update_next_site_id_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "Could not update next site ID: "
+                        + std::string(sqlite3_errstr(rc)));
+                }
+                else
+                {
+                    rc = SQLITE_OK;
+                    success = true;
+                }
+
+                reset(update_next_site_id_stmt);
+            }
+            else
+            {
+                // No next ID found - first use.  Insert default and
+                // use it.
+                //
+                rc = sqlite3_step(insert_first_next_site_id_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "Could not insert first next site ID: "
+                        + std::string(sqlite3_errstr(rc)));
+                }
+                else
+                {
+                    rc = SQLITE_OK;
+                    success = true;
+                    site_id = 1;
+                }
+
+                reset(insert_first_next_site_id_stmt);
+            }
+
+            reset(next_site_id_stmt);
+
+            if (success)
+            {
+                // Insert the new site into the sites table
+                //
+
+                if (sqlite3_bind_int(
+                    insert_new_site_stmt,
+                    sqlite3_bind_parameter_index(
+                        insert_new_site_stmt,
+                        "$SITEID"),
+                    site_id) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "For insert_new_site_stmt, could not bind $SITEID");
+                }
+
+                const std::string default_site_name =
+                    "Untitled Site " + text::to_string(site_id);
+
+                if (sqlite3_bind_text(
+                    insert_new_site_stmt,
+                    sqlite3_bind_parameter_index(
+                        insert_new_site_stmt,
+                        "$SITENAME"),
+                    default_site_name.c_str(),
+                    default_site_name.size(),
+                    SQLITE_TRANSIENT) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "For insert_new_site_stmt, could not bind $SITENAME");
+                }
+
+                const std::string empty_description;
+
+                if (sqlite3_bind_text(
+                    insert_new_site_stmt,
+                    sqlite3_bind_parameter_index(
+                        insert_new_site_stmt,
+                        "$SITEDESCRIPTION"),
+                    empty_description.c_str(),
+                    empty_description.size(),
+                    SQLITE_TRANSIENT) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "For insert_new_site_stmt, could not bind $SITEDESCRIPTION");
+                }
+
+                rc = sqlite3_step(insert_new_site_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "Could not insert new site: "
+                        + std::string(sqlite3_errstr(rc)));
+
+                    success = false;
+                }
+                else
+                {
+                    rc = SQLITE_OK;
+                }
+
+                reset(insert_new_site_stmt);
+
+                // Delete all existing entity data with that site ID in case
+                // anything is still there.
+                //
+                delete_site_entity_data(site_id);
+            }
+
+            if (success)
+            {
+                if (sqlite3_bind_int(
+                    insert_first_site_entity_id_stmt,
+                    sqlite3_bind_parameter_index(
+                        insert_first_site_entity_id_stmt,
+                        "$SITEID"),
+                    site_id) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "For insert_first_site_entity_id_stmt, could not bind $SITEID");
+                }
+
+                rc = sqlite3_step(insert_first_site_entity_id_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "new_site_in_db",
+                        "Could not insert new site first entity ID: "
+                        + std::string(sqlite3_errstr(rc)));
+
+                    success = false;
+                }
+                else
+                {
+                    rc = SQLITE_OK;
+                }
+
+                reset(insert_first_site_entity_id_stmt);
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::add_site_in_db(const dbtype::Id::SiteIdType site_id)
+    {
+        // Clears out anything left from a site that had the same ID.
+        //
+        bool success = delete_site_in_db(site_id);
+
+        if (success)
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            wait_for_transaction(lock);
+
+            if (sqlite3_bind_int(
+                insert_first_site_entity_id_stmt,
+                sqlite3_bind_parameter_index(
+                    insert_first_site_entity_id_stmt,
+                    "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "add_site_in_db",
+                    "For insert_first_site_entity_id_stmt, could not bind $SITEID");
+            }
+
+            const int rc = sqlite3_step(insert_first_site_entity_id_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "add_site_in_db",
+                    "Could not insert new site first entity ID: "
+                    + std::string(sqlite3_errstr(rc)));
+
+                success = false;
+            }
+
+            reset(insert_first_site_entity_id_stmt);
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::delete_site_in_db(const dbtype::Id::SiteIdType site_id)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
+
+        bool success = delete_site_entity_data(site_id);
+        int rc = SQLITE_OK;
+
+        if (success)
+        {
+            if (sqlite3_bind_int(
+                mark_site_deleted_stmt,
+                sqlite3_bind_parameter_index(
+                    mark_site_deleted_stmt,
+                    "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "delete_site_in_db",
+                    "For mark_site_deleted_stmt, could not bind $SITEID");
+            }
+
+
+            rc = sqlite3_step(mark_site_deleted_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "delete_site_in_db",
+                    "Could not mark site as deleted: "
+                    + std::string(sqlite3_errstr(rc)));
+
+                success = false;
+            }
+
+            if (sqlite3_bind_int(
+                delete_all_site_entity_id_reuse_stmt,
+                sqlite3_bind_parameter_index(
+                    delete_all_site_entity_id_reuse_stmt,
+                    "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "delete_site_in_db",
+                    "For delete_all_site_entity_id_reuse_stmt, could not bind $SITEID");
+            }
+
+
+            rc = sqlite3_step(delete_all_site_entity_id_reuse_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "delete_site_in_db",
+                    "Could not delete all site reuse entity IDs: "
+                    + std::string(sqlite3_errstr(rc)));
+
+                success = false;
+            }
+
+            if (sqlite3_bind_int(
+                delete_site_next_entity_id_stmt,
+                sqlite3_bind_parameter_index(
+                    delete_site_next_entity_id_stmt,
+                    "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "delete_site_in_db",
+                    "For delete_site_next_entity_id_stmt, could not bind $SITEID");
+            }
+
+
+            rc = sqlite3_step(delete_site_next_entity_id_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "delete_site_in_db",
+                    "Could not delete site fresh ID table entry: "
+                    + std::string(sqlite3_errstr(rc)));
+
+                success = false;
+            }
+
+            reset(mark_site_deleted_stmt);
+            reset(delete_all_site_entity_id_reuse_stmt);
+            reset(delete_site_next_entity_id_stmt);
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::get_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_name)
+    {
+        ReadConnectionGuard connection(*this);
+
+        bool success = false;
+
+        site_name.clear();
+
+        if (sqlite3_bind_int(
+            connection->get_site_name_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_site_name_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_site_name_in_db",
+                "For get_site_name_stmt, could not bind $SITEID");
+        }
+
+        // Should be 0 or 1 lines
+        //
+        if (sqlite3_step(connection->get_site_name_stmt) == SQLITE_ROW)
+        {
+            // Site exists.  Get the name.
+            //
+            success = true;
+            const char *name_char_ptr = (const char *)
+                sqlite3_column_text(connection->get_site_name_stmt, 0);
+            const int name_char_size =
+                sqlite3_column_bytes(connection->get_site_name_stmt, 0);
+
+            if (name_char_size)
+            {
+                site_name.assign(name_char_ptr, name_char_size);
+            }
+        }
+
+        reset(connection->get_site_name_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::set_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_name)
+    {
+        bool success = false;
+        int rc = SQLITE_OK;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
+
+        if (sqlite3_bind_int(
+            set_site_name_stmt,
+            sqlite3_bind_parameter_index(set_site_name_stmt, "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "set_site_name_in_db",
+                "For set_site_name_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_text(
+            set_site_name_stmt,
+            sqlite3_bind_parameter_index(
+                set_site_name_stmt,
+                "$SITENAME"),
+            site_name.c_str(),
+            site_name.size(),
+            SQLITE_TRANSIENT) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "set_site_name_in_db",
+                "For set_site_name_stmt, could not bind $SITENAME");
+        }
+
+        rc = sqlite3_step(set_site_name_stmt);
+
+        if (rc == SQLITE_DONE)
+        {
+            success = true;
+        }
+        else
+        {
+            LOG(error, "sqliteinterface", "set_site_name_in_db",
+                "Could not set site name: " + std::string(sqlite3_errstr(rc)));
+        }
+
+        reset(set_site_name_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::get_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_description)
+    {
+        bool success = false;
+
+        ReadConnectionGuard connection(*this);
+
+        site_description.clear();
+
+        if (sqlite3_bind_int(
+            connection->get_site_description_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_site_description_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_site_description_in_db",
+                "For get_site_description_stmt, could not bind $SITEID");
+        }
+
+        // Should be 0 or 1 lines
+        //
+        if (sqlite3_step(connection->get_site_description_stmt) == SQLITE_ROW)
+        {
+            // Site exists.  Get the description.
+            //
+            success = true;
+            const char *description_char_ptr = (const char *)
+                sqlite3_column_text(connection->get_site_description_stmt, 0);
+            const int description_char_size =
+                sqlite3_column_bytes(connection->get_site_description_stmt, 0);
+
+            if (description_char_size)
+            {
+                site_description.assign(
+                    description_char_ptr,
+                    description_char_size);
+            }
+        }
+
+        reset(connection->get_site_description_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::set_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_description)
+    {
+        bool success = false;
+        int rc = SQLITE_OK;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wait_for_transaction(lock);
+
+        if (sqlite3_bind_int(
+            set_site_description_stmt,
+            sqlite3_bind_parameter_index(set_site_description_stmt, "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "set_site_description_in_db",
+                "For set_site_description_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_text(
+            set_site_description_stmt,
+            sqlite3_bind_parameter_index(
+                set_site_description_stmt,
+                "$SITEDESCRIPTION"),
+            site_description.c_str(),
+            site_description.size(),
+            SQLITE_TRANSIENT) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "set_site_description_in_db",
+                "For set_site_description_stmt, could not bind $SITEDESCRIPTION");
+        }
+
+        rc = sqlite3_step(set_site_description_stmt);
+
+        if (rc == SQLITE_DONE)
+        {
+            success = true;
+        }
+        else
+        {
+            LOG(error, "sqliteinterface", "set_site_description_in_db",
+                "Could not set site description: " + std::string(sqlite3_errstr(rc)));
+        }
+
+        reset(set_site_description_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::load_application_properties(
+        const dbtype::Id &entity_id,
+        const std::string &application,
+        dbtype::ApplicationProperties &properties)
+    {
+        ReadConnectionGuard connection(*this);
+
+        bool success = false;
+
+        if (sqlite3_bind_int(
+            connection->get_application_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_application_stmt,
+                "$SITEID"),
+            entity_id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "load_application_properties",
+                "For get_application_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int64(
+            connection->get_application_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_application_stmt,
+                "$ENTITYID"),
+            entity_id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "load_application_properties",
+                "For get_application_stmt, could not bind $ENTITYID");
+        }
+
+        if (sqlite3_bind_text(
+            connection->get_application_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_application_stmt,
+                "$APPLICATION"),
+            application.c_str(),
+            application.size(),
+            SQLITE_STATIC) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "load_application_properties",
+                "For get_application_stmt, could not bind $APPLICATION");
+        }
+
+        // Should be 0 or 1 lines
+        //
+        if (sqlite3_step(connection->get_application_stmt) == SQLITE_ROW)
+        {
+            const void *blob_ptr =
+                sqlite3_column_blob(connection->get_application_stmt, 0);
+            const int blob_size =
+                sqlite3_column_bytes(connection->get_application_stmt, 0);
+
+            success = deserialize_application_properties(
+                blob_ptr,
+                blob_size,
+                properties);
+        }
+        else
+        {
+            LOG(error, "sqliteinterface", "load_application_properties",
+                "Application " + application + " not found for Entity "
+                + entity_id.to_string(true));
+        }
+
+        reset(connection->get_application_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::load_compiled_code(
+        const dbtype::Id &program_id,
+        std::string &compiled_code)
+    {
+        ReadConnectionGuard connection(*this);
+
+        bool success = false;
+
+        if (sqlite3_bind_int(
+            connection->get_program_code_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_program_code_stmt,
+                "$SITEID"),
+            program_id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "load_compiled_code",
+                "For get_program_code_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int64(
+            connection->get_program_code_stmt,
+            sqlite3_bind_parameter_index(
+                connection->get_program_code_stmt,
+                "$ENTITYID"),
+            program_id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "load_compiled_code",
+                "For get_program_code_stmt, could not bind $ENTITYID");
+        }
+
+        // Should be 0 or 1 lines
+        //
+        if (sqlite3_step(connection->get_program_code_stmt) == SQLITE_ROW)
+        {
+            const void *blob_ptr =
+                sqlite3_column_blob(connection->get_program_code_stmt, 0);
+            const int blob_size =
+                sqlite3_column_bytes(connection->get_program_code_stmt, 0);
+
+            if (blob_ptr and (blob_size > 0))
+            {
+                compiled_code.assign((const char *) blob_ptr, blob_size);
+            }
+            else
+            {
+                compiled_code.clear();
+            }
+
+            success = true;
+        }
+        else
+        {
+            LOG(error, "sqliteinterface", "load_compiled_code",
+                "Compiled code not found for Program "
+                + program_id.to_string(true));
+        }
+
+        reset(connection->get_program_code_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::create_tables(void)
+    {
+        const std::string create_tables_str =
+         "CREATE TABLE IF NOT EXISTS entities("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "owner INTEGER,"
+            "type INTEGER NOT NULL,"
+            "version INTEGER NOT NULL,"
+            "name TEXT NOT NULL COLLATE NOCASE,"
+            "data BLOB NOT NULL,"
+         "PRIMARY KEY(site_id, entity_id)) WITHOUT ROWID;"
+         "CREATE INDEX IF NOT EXISTS entity_type_idx ON entities(site_id, name, type);"
+
+         // Searches by owner (a player's puppets, programs, etc) are
+         // otherwise a scan of the entire site.
+         //
+         "CREATE INDEX IF NOT EXISTS entity_owner_idx ON entities(site_id, owner, type);"
+
+         // Trigram index of Entity names, for substring searches.  The rowid
+         // is the site ID in the upper 32 bits and the entity ID in the
+         // lower, so a search can be limited to a site.  The triggers keep
+         // it consistent with the entities table, and the INSERT populates
+         // it the first time a database without it is opened.  Every save
+         // sets the name column, so the update trigger only fires when the
+         // name really changed (compared exactly, since the column is
+         // NOCASE).  It is dropped first to replace the one older databases
+         // have without the WHEN.
+         //
+         "CREATE VIRTUAL TABLE IF NOT EXISTS entity_names USING fts5("
+            "name, tokenize = 'trigram');"
+         "CREATE TRIGGER IF NOT EXISTS entity_names_insert AFTER INSERT ON entities BEGIN "
+            "INSERT INTO entity_names(rowid, name) VALUES ((new.site_id << 32) + new.entity_id, new.name); END;"
+         "DROP TRIGGER IF EXISTS entity_names_update;"
+         "CREATE TRIGGER entity_names_update AFTER UPDATE OF name ON entities "
+            "WHEN old.name IS NOT new.name COLLATE BINARY BEGIN "
+            "UPDATE entity_names SET name = new.name WHERE rowid = (old.site_id << 32) + old.entity_id; END;"
+         "CREATE TRIGGER IF NOT EXISTS entity_names_delete AFTER DELETE ON entities BEGIN "
+            "DELETE FROM entity_names WHERE rowid = (old.site_id << 32) + old.entity_id; END;"
+         "INSERT INTO entity_names(rowid, name) "
+            "SELECT (site_id << 32) + entity_id, name FROM entities "
+            "WHERE NOT EXISTS (SELECT 1 FROM entity_names);"
+
+         // Who references who, by field.  This mirrors the back-references
+         // kept on each Entity, so they can be looked up without loading
+         // anything.  (site_id, entity_id) is referenced by the source's
+         // field.
+         //
+         "CREATE TABLE IF NOT EXISTS entity_references("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "field INTEGER NOT NULL,"
+            "source_site_id INTEGER NOT NULL,"
+            "source_entity_id INTEGER NOT NULL,"
+         "PRIMARY KEY(site_id, entity_id, field, source_site_id, source_entity_id)) WITHOUT ROWID;"
+         "CREATE INDEX IF NOT EXISTS entity_references_source_idx ON entity_references(source_site_id, source_entity_id);"
+
+         // Has a row while the reference index may have changes the saved
+         // Entities don't, such as after a crash between the index being
+         // updated and the Entities being committed.
+         //
+         "CREATE TABLE IF NOT EXISTS reference_index_dirty("
+            "dirty INTEGER NOT NULL,"
+         "PRIMARY KEY(dirty)) WITHOUT ROWID;"
+
+         // Last accessed time and access count.  These change on nearly
+         // every load, so they are kept here rather than in the Entity
+         // data, which would otherwise be rewritten each time.
+         //
+         "CREATE TABLE IF NOT EXISTS entity_access("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "accessed_timestamp INTEGER NOT NULL,"
+            "access_count INTEGER NOT NULL,"
+         "PRIMARY KEY(site_id, entity_id)) WITHOUT ROWID;"
+         "CREATE TRIGGER IF NOT EXISTS entity_access_delete AFTER DELETE ON entities BEGIN "
+            "DELETE FROM entity_access WHERE site_id = old.site_id AND entity_id = old.entity_id; END;"
+
+         "CREATE TABLE IF NOT EXISTS program_registrations("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "registration_name TEXT NOT NULL COLLATE NOCASE,"
+         "PRIMARY KEY(site_id, registration_name)) WITHOUT ROWID;"
+         "CREATE INDEX IF NOT EXISTS program_registrations_idx ON program_registrations(site_id, entity_id);"
+
+         "CREATE TABLE IF NOT EXISTS application_properties("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "application TEXT NOT NULL,"
+            "data BLOB NOT NULL,"
+         "PRIMARY KEY(site_id, entity_id, application)) WITHOUT ROWID;"
+
+         "CREATE TABLE IF NOT EXISTS program_code("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "data BLOB NOT NULL,"
+         "PRIMARY KEY(site_id, entity_id));"
+         "CREATE TRIGGER IF NOT EXISTS program_code_delete AFTER DELETE ON entities BEGIN "
+            "DELETE FROM program_code WHERE site_id = old.site_id AND entity_id = old.entity_id; END;"
+
+         "CREATE TABLE IF NOT EXISTS sites("
+            "site_id INTEGER NOT NULL,"
+            "deleted INTEGER NOT NULL,"
+            "site_name TEXT NOT NULL,"
+            "site_description TEXT NOT NULL,"
+            "PRIMARY KEY(site_id, deleted)) WITHOUT ROWID;"
+
+         "CREATE TABLE IF NOT EXISTS id_reuse("
+            "site_id INTEGER NOT NULL,"
+            "deleted_entity_id INTEGER NOT NULL,"
+            "PRIMARY KEY(site_id, deleted_entity_id)) WITHOUT ROWID;"
+
+         "CREATE TABLE IF NOT EXISTS next_id("
+            "site_id INTEGER NOT NULL,"
+            "next_entity_id INTEGER NOT NULL,"
+            "PRIMARY KEY(site_id)) WITHOUT ROWID;"
+
+         "CREATE TABLE IF NOT EXISTS next_site_id("
+            "site_id INTEGER NOT NULL,"
+            "PRIMARY KEY(site_id)) WITHOUT ROWID;"
+
+         "CREATE TABLE IF NOT EXISTS display_names("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "player INTEGER NOT NULL,"
+            "name TEXT NOT NULL COLLATE NOCASE,"
+            "display_name TEXT NOT NULL COLLATE NOCASE,"
+            "PRIMARY KEY(site_id, entity_id),"
+            "FOREIGN KEY(site_id, entity_id) REFERENCES entities(site_id, entity_id)) WITHOUT ROWID;"
+         "CREATE INDEX IF NOT EXISTS display_name_player_idx ON display_names(site_id, player, name, display_name);";
+
+        bool success = true;
+        bool reference_index_exists = false;
+        sqlite3_stmt *table_exists_stmt = 0;
+
+        // The name index needs FTS5 and its trigram tokenizer, which SQLite
+        // only has from 3.34.0 on, and only when built with FTS5.  Try it
+        // out first so a missing one is reported clearly.
+        //
+        if (sqlite3_exec(
+            dbhandle_ptr,
+            "CREATE VIRTUAL TABLE temp.trigram_check USING fts5("
+                "name, tokenize = 'trigram');"
+            "DROP TABLE temp.trigram_check;",
+            0,
+            0,
+            0) != SQLITE_OK)
+        {
+            LOG(fatal, "sqliteinterface", "create_tables",
+                "SQLite " + std::string(sqlite3_libversion())
+                + " does not support FTS5 with the trigram tokenizer, "
+                  "which the Entity name index needs.  Use SQLite 3.34.0 or "
+                  "newer, built with FTS5.");
+
+            return false;
+        }
+
+        // Determine if the reference index needs to be populated after
+        // it is created.
+        //
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT 1 FROM sqlite_master WHERE type = 'table' AND "
+                "name = 'entity_references';",
+            -1,
+            &table_exists_stmt,
+            0) == SQLITE_OK)
+        {
+            reference_index_exists =
+                (sqlite3_step(table_exists_stmt) == SQLITE_ROW);
+        }
+
+        sqlite3_finalize(table_exists_stmt);
+        table_exists_stmt = 0;
+
+        char *rc_error_str_ptr = 0;
+        const int rc = sqlite3_exec(
+            dbhandle_ptr,
+            create_tables_str.c_str(),
+            0,
+            0,
+            &rc_error_str_ptr);
+
+        if (rc != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "create_tables",
+                "Unable to create tables: " + std::string(sqlite3_errstr(rc))
+                + "   Full error: " + std::string(rc_error_str_ptr));
+
+            sqlite3_free(rc_error_str_ptr);
+            rc_error_str_ptr = 0;
+        }
+        else if (not reference_index_exists)
+        {
+            success = populate_reference_index();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::check_reference_index(void)
+    {
+        bool dirty = false;
+        sqlite3_stmt *dirty_stmt = 0;
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT 1 FROM reference_index_dirty;",
+            -1,
+            &dirty_stmt,
+            0) == SQLITE_OK)
+        {
+            dirty = (sqlite3_step(dirty_stmt) == SQLITE_ROW);
+        }
+
+        sqlite3_finalize(dirty_stmt);
+        dirty_stmt = 0;
+
+        if (not dirty)
+        {
+            return true;
+        }
+
+        LOG(warning, "sqliteinterface", "check_reference_index",
+            "Reference index may not match the saved Entities.  "
+            "Rebuilding it.");
+
+        // If this is interrupted, the marker is still there and it is
+        // done again next time.
+        //
+        return (sqlite3_exec(
+                dbhandle_ptr,
+                "DELETE FROM entity_references;",
+                0,
+                0,
+                0) == SQLITE_OK) and
+            populate_reference_index() and
+            (sqlite3_exec(
+                dbhandle_ptr,
+                "DELETE FROM reference_index_dirty;",
+                0,
+                0,
+                0) == SQLITE_OK);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::populate_reference_index(void)
+    {
+        LOG(info, "sqliteinterface", "populate_reference_index",
+            "Building reference index...");
+
+        bool success = true;
+        sqlite3_stmt *entities_stmt = 0;
+        sqlite3_stmt *insert_stmt = 0;
+
+        if ((sqlite3_prepare_v2(
+                dbhandle_ptr,
+                "SELECT site_id, entity_id, type, data FROM entities;",
+                -1,
+                &entities_stmt,
+                0) != SQLITE_OK) or
+            (sqlite3_prepare_v2(
+                dbhandle_ptr,
+                "INSERT OR IGNORE INTO entity_references(site_id, entity_id, "
+                  "field, source_site_id, source_entity_id) VALUES ($SITEID, "
+                  "$ENTITYID, $FIELD, $SOURCESITEID, $SOURCEENTITYID);",
+                -1,
+                &insert_stmt,
+                0) != SQLITE_OK))
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "populate_reference_index",
+                "Failed prepared statements for building reference index.");
+        }
+        else
+        {
+            success = (sqlite3_exec(
+                dbhandle_ptr,
+                "BEGIN TRANSACTION;",
+                0,
+                0,
+                0) == SQLITE_OK);
+
+            int rc = sqlite3_step(entities_stmt);
+
+            while (success and (rc == SQLITE_ROW))
+            {
+                const dbtype::Id id(
+                    (dbtype::Id::SiteIdType) sqlite3_column_int(entities_stmt, 0),
+                    (dbtype::Id::EntityIdType)
+                        sqlite3_column_int64(entities_stmt, 1));
+                const dbtype::EntityType entity_type =
+                    (dbtype::EntityType) sqlite3_column_int(entities_stmt, 2);
+                const void *blob_ptr = sqlite3_column_blob(entities_stmt, 3);
+                const int blob_size = sqlite3_column_bytes(entities_stmt, 3);
+
+                // The Entity is only needed long enough to read the
+                // back-references it has stored.
+                //
+                dbtype::Entity *entity_ptr = ((not blob_ptr) or (blob_size <= 0))
+                    ? 0 : make_deserialize_entity(
+                        entity_type,
+                        blob_ptr,
+                        blob_size,
+                        true);
+
+                if (not entity_ptr)
+                {
+                    LOG(error, "sqliteinterface", "populate_reference_index",
+                        "Could not deserialize Entity " + id.to_string(true));
+                }
+                else
+                {
+                    const dbtype::Entity::IdFieldsMap references =
+                        entity_ptr->get_all_references();
+
+                    delete entity_ptr;
+                    entity_ptr = 0;
+
+                    for (dbtype::Entity::IdFieldsMap::const_iterator ref_iter =
+                            references.begin();
+                        success and (ref_iter != references.end());
+                        ++ref_iter)
+                    {
+                        for (dbtype::Entity::EntityFieldSet::const_iterator
+                                field_iter = ref_iter->second.begin();
+                            success and (field_iter != ref_iter->second.end());
+                            ++field_iter)
+                        {
+                            success = bind_reference_params(
+                                insert_stmt,
+                                id,
+                                *field_iter,
+                                ref_iter->first) and
+                                (sqlite3_step(insert_stmt) == SQLITE_DONE);
+
+                            reset(insert_stmt);
+                        }
+                    }
+                }
+
+                rc = sqlite3_step(entities_stmt);
+            }
+
+            if (success and (rc != SQLITE_DONE))
+            {
+                success = false;
+            }
+
+            sqlite3_reset(entities_stmt);
+
+            success = success and (sqlite3_exec(
+                dbhandle_ptr,
+                "COMMIT TRANSACTION;",
+                0,
+                0,
+                0) == SQLITE_OK);
+
+            if (not success)
+            {
+                LOG(fatal, "sqliteinterface", "populate_reference_index",
+                    "Could not build reference index: "
+                    + std::string(sqlite3_errmsg(dbhandle_ptr)));
+
+                if (not sqlite3_get_autocommit(dbhandle_ptr))
+                {
+                    sqlite3_exec(
+                        dbhandle_ptr,
+                        "ROLLBACK TRANSACTION;",
+                        0,
+                        0,
+                        0);
+                }
+            }
+        }
+
+        sqlite3_finalize(entities_stmt);
+        sqlite3_finalize(insert_stmt);
+
+        if (success)
+        {
+            LOG(info, "sqliteinterface", "populate_reference_index",
+                "Reference index built.");
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::backup_thread_main(
+        const std::string backup_file,
+        const std::string temp_file,
+        sqlite3 *dest_handle_ptr,
+        sqlite3_backup *backup_ptr)
+    {
+        const int pages_per_step = config::db::backup_pages_per_step();
+        const MG_UnsignedInt step_delay = config::db::backup_step_delay();
+        int rc = SQLITE_OK;
+
+        while (((rc == SQLITE_OK) or (rc == SQLITE_BUSY) or
+                (rc == SQLITE_LOCKED)) and (not backup_cancel.load()))
+        {
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+
+                // Only copy between transactions.  Pages changed by a
+                // transaction are brought into the backup when it commits.
+                //
+                if (not transaction_begun)
+                {
+                    rc = sqlite3_backup_step(backup_ptr, pages_per_step);
+                }
+            }
+
+            {
+                boost::lock_guard<boost::mutex> backup_guard(backup_mutex);
+
+                backup_status.total_pages =
+                    sqlite3_backup_pagecount(backup_ptr);
+                backup_status.remaining_pages =
+                    sqlite3_backup_remaining(backup_ptr);
+            }
+
+            if ((rc != SQLITE_DONE) and step_delay)
+            {
+                // Give everyone else a turn with the database.
+                boost::this_thread::sleep(
+                    boost::posix_time::milliseconds(step_delay));
+            }
+        }
+
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            sqlite3_backup_finish(backup_ptr);
+        }
+
+        std::string failure;
+
+        if (rc != SQLITE_DONE)
+        {
+            failure = backup_cancel.load() ?
+                std::string("Cancelled") :
+                std::string(sqlite3_errstr(rc));
+        }
+
+        if (sqlite3_close(dest_handle_ptr) != SQLITE_OK)
+        {
+            if (failure.empty())
+            {
+                failure = "Unable to close " + temp_file;
+            }
+        }
+
+        if (failure.empty() and
+            (rename(temp_file.c_str(), backup_file.c_str()) != 0))
+        {
+            failure = "Unable to rename " + temp_file + " to " + backup_file;
+        }
+
+        if (not failure.empty())
+        {
+            remove(temp_file.c_str());
+
+            LOG(error, "sqliteinterface", "backup_thread_main",
+                "Backup to " + backup_file + " failed: " + failure);
+        }
+        else
+        {
+            LOG(info, "sqliteinterface", "backup_thread_main",
+                "Backup to " + backup_file + " completed.");
+        }
+
+        boost::lock_guard<boost::mutex> backup_guard(backup_mutex);
+
+        backup_status.in_progress = false;
+        backup_status.completed = failure.empty();
+        backup_status.finished.set_to_now();
+        backup_status.error = failure;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::stop_backup(void)
+    {
+        boost::thread *thread_ptr = 0;
+
+        {
+            boost::lock_guard<boost::mutex> backup_guard(backup_mutex);
+
+            thread_ptr = backup_thread_ptr;
+            backup_thread_ptr = 0;
+        }
+
+        if (thread_ptr)
+        {
+            backup_cancel.store(true);
+            thread_ptr->join();
+            delete thread_ptr;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::set_durability(void)
+    {
+        const std::string &durability = config::db::durability();
+        std::string pragmas;
+
+        // wal_autocheckpoint is in pages.  Checkpointing less often means
+        // fewer syncs, at the cost of a larger WAL file.
+        //
+        if (durability == "fast")
+        {
+            pragmas = "PRAGMA synchronous=OFF; PRAGMA wal_autocheckpoint=10000;";
+        }
+        else if (durability == "full")
+        {
+            pragmas = "PRAGMA synchronous=FULL; PRAGMA wal_autocheckpoint=1000;";
+        }
+        else
+        {
+            pragmas =
+                "PRAGMA synchronous=NORMAL; PRAGMA wal_autocheckpoint=1000;";
+        }
+
+        const int rc = sqlite3_exec(dbhandle_ptr, pragmas.c_str(), 0, 0, 0);
+
+        if (rc != SQLITE_OK)
+        {
+            LOG(fatal, "sqliteinterface", "set_durability",
+                "Unable to set durability: " + std::string(sqlite3_errstr(rc)));
+        }
+        else
+        {
+            LOG(info, "sqliteinterface", "set_durability",
+                "Durability is " + durability);
+        }
+
+        return rc == SQLITE_OK;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::bind_reference_params(
+        sqlite3_stmt *stmt,
+        const dbtype::Id &target_id,
+        const dbtype::EntityField field,
+        const dbtype::Id &source_id)
+    {
+        bool success = true;
+
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
+            target_id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_reference_params",
+                "Could not bind $SITEID");
+            success = false;
+        }
+
+        if (sqlite3_bind_int64(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
+            target_id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_reference_params",
+                "Could not bind $ENTITYID");
+            success = false;
+        }
+
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$FIELD"),
+            field) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_reference_params",
+                "Could not bind $FIELD");
+            success = false;
+        }
+
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SOURCESITEID"),
+            source_id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_reference_params",
+                "Could not bind $SOURCESITEID");
+            success = false;
+        }
+
+        if (sqlite3_bind_int64(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SOURCEENTITYID"),
+            source_id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_reference_params",
+                "Could not bind $SOURCEENTITYID");
+            success = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::sql_init(void)
+    {
+        bool success = true;
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT site_id FROM sites WHERE deleted = 1;",
+            -1,
+            &list_deleted_sites_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for finding deleted sites.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE sites SET deleted = 0 WHERE site_id = $SITEID;",
+            -1,
+            &undelete_site_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for reusing a site.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT site_id FROM next_site_id;",
+            -1,
+            &next_site_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting a new site ID.");
+        }
+
+        // Starts at 2 because this is called after first site created.
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT INTO next_site_id(site_id) VALUES (2);",
+            -1,
+            &insert_first_next_site_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for inserting the first next site ID.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE next_site_id SET site_id = $SITEID;",
+            -1,
+            &update_next_site_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for updating the next site ID.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT INTO sites(site_id, site_name, site_description, deleted) "
+                "VALUES ($SITEID, $SITENAME, $SITEDESCRIPTION, 0);",
+            -1,
+            &insert_new_site_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for inserting a new site.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT INTO next_id(site_id, next_entity_id) VALUES ($SITEID, 1);",
+            -1,
+            &insert_first_site_entity_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for inserting first site ID.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM entities WHERE site_id = $SITEID;",
+            -1,
+            &delete_site_entities_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for delete a site's entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM display_names WHERE site_id = $SITEID;",
+            -1,
+            &delete_site_display_names_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for delete a site's display names.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM application_properties WHERE site_id = $SITEID;",
+            -1,
+            &delete_site_applications_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for delete a site's application properties.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM entity_references WHERE site_id = $SITEID "
+                "OR source_site_id = $SITEID;",
+            -1,
+            &delete_site_references_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for delete a site's references.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE sites SET site_name = $SITENAME WHERE site_id = $SITEID;",
+            -1,
+            &set_site_name_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for setting a site's name.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE sites SET site_description = $SITEDESCRIPTION "
+                "WHERE site_id = $SITEID;",
+            -1,
+            &set_site_description_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for setting a site's description.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE entities SET owner = $OWNER, type = $TYPE, name = $NAME, "
+                                "data = $DATA "
+                "WHERE site_id = $SITEID and entity_id = $ENTITYID;",
+            -1,
+            &update_entity_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for updating an Entity.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT OR REPLACE INTO "
+              "application_properties(site_id, entity_id, application, data) "
+              "VALUES ($SITEID, $ENTITYID, $APPLICATION, $DATA);",
+            -1,
+            &save_application_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for saving application properties.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM application_properties WHERE site_id = $SITEID "
+                "AND entity_id = $ENTITYID AND application = $APPLICATION;",
+            -1,
+            &delete_application_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting application properties.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT OR REPLACE INTO program_code(site_id, entity_id, data) "
+              "VALUES ($SITEID, $ENTITYID, $DATA);",
+            -1,
+            &save_program_code_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for saving program code.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM program_code WHERE site_id = $SITEID "
+                "AND entity_id = $ENTITYID;",
+            -1,
+            &delete_program_code_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting program code.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT OR IGNORE INTO entity_references(site_id, entity_id, field, "
+              "source_site_id, source_entity_id) VALUES ($SITEID, $ENTITYID, "
+              "$FIELD, $SOURCESITEID, $SOURCEENTITYID);",
             -1,
-            &find_site_name_stmt,
+            &insert_reference_stmt,
             0) != SQLITE_OK)
         {
-            success = false;
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for adding a reference.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM entity_references WHERE site_id = $SITEID "
+                "AND entity_id = $ENTITYID AND field = $FIELD "
+                "AND source_site_id = $SOURCESITEID "
+                "AND source_entity_id = $SOURCEENTITYID;",
+            -1,
+            &delete_reference_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting a reference.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT OR REPLACE INTO entity_access(site_id, entity_id, "
+              "accessed_timestamp, access_count) "
+              "SELECT $SITEID, $ENTITYID, $TIMESTAMP, $COUNT WHERE EXISTS "
+              "(SELECT 1 FROM entities WHERE site_id = $SITEID "
+              "AND entity_id = $ENTITYID);",
+            -1,
+            &save_access_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for saving access statistics.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT deleted_entity_id FROM id_reuse WHERE site_id = $SITEID "
+                "ORDER BY deleted_entity_id LIMIT $LIMIT;",
+            -1,
+            &get_deleted_entity_ids_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for get deleted entity IDs.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM id_reuse WHERE site_id = $SITEID "
+                "AND deleted_entity_id <= $ENTITYID;",
+            -1,
+            &mark_deleted_ids_used_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for marking reused entity IDs as used.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT next_entity_id FROM next_id WHERE site_id = $SITEID;",
+            -1,
+            &get_next_entity_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting next fresh entity ID.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE next_id SET next_entity_id = $NEXTID WHERE site_id = $SITEID;",
+            -1,
+            &update_next_entity_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for updating next entity ID counter.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT INTO "
+              "entities(site_id, entity_id, owner, type, version, name, data) "
+              "VALUES ($SITEID, $ENTITYID, $OWNER, $TYPE, $VERSION, $NAME, $DATA);",
+            -1,
+            &add_entity_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for inserting new Entity.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM entities WHERE site_id = $SITEID AND entity_id = $ENTITYID;",
+            -1,
+            &delete_entity_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting an Entity.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT INTO id_reuse(site_id, deleted_entity_id) VALUES "
+                "($SITEID, $ENTITYID);",
+            -1,
+            &add_reuse_entity_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for adding Entity to reuse table.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM id_reuse WHERE site_id = $SITEID "
+                "AND deleted_entity_id = $ENTITYID;",
+            -1,
+            &delete_reuse_entity_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for removing Entity from reuse table.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM application_properties WHERE site_id = $SITEID "
+                "AND entity_id = $ENTITYID;",
+            -1,
+            &delete_entity_applications_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting an Entity's applications.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM entity_references WHERE "
+                "(site_id = $SITEID AND entity_id = $ENTITYID) OR "
+                "(source_site_id = $SITEID AND source_entity_id = $ENTITYID);",
+            -1,
+            &delete_entity_references_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting an Entity's references.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "UPDATE sites SET deleted = 1 WHERE site_id = $SITEID;",
+            -1,
+            &mark_site_deleted_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for marking site as deleted.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM id_reuse WHERE site_id = $SITEID;",
+            -1,
+            &delete_all_site_entity_id_reuse_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting site reuse Entity IDs.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM next_id WHERE site_id = $SITEID;",
+            -1,
+            &delete_site_next_entity_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting site next Entity ID.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT INTO program_registrations(site_id, entity_id, registration_name) VALUES "
+            "($SITEID, $ENTITYID, $REGNAME);",
+            -1,
+            &insert_program_reg_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for inserting a program registration.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM program_registrations WHERE "
+              "site_id = $SITEID AND entity_id = $ENTITYID;",
+            -1,
+            &delete_program_reg_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting  a program registration.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "BEGIN TRANSACTION;",
+            -1,
+            &begin_transaction_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for beginning a transaction.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "COMMIT TRANSACTION;",
+            -1,
+            &commit_transaction_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for committing a transaction.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "ROLLBACK TRANSACTION;",
+            -1,
+            &rollback_transaction_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for rolling back a transaction.");
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::get_metadata_internal(
+        SqliteReadConnection &connection,
+        const dbtype::Id &id,
+        dbinterface::EntityMetadata &metadata)
+    {
+        // Look up the Entity
+        //
+        if (sqlite3_bind_int(
+            connection.get_entity_metadata_stmt,
+            sqlite3_bind_parameter_index(
+                connection.get_entity_metadata_stmt,
+                "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_metadata_internal",
+                "For get_metadata_internal, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int64(
+            connection.get_entity_metadata_stmt,
+            sqlite3_bind_parameter_index(
+                connection.get_entity_metadata_stmt,
+                "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_metadata_internal",
+                "For get_metadata_internal, could not bind $ENTITYID");
+        }
+
+        if (sqlite3_step(connection.get_entity_metadata_stmt) != SQLITE_ROW)
+        {
+            metadata.reset();
+        }
+        else
+        {
+            // Found an entry.  Extract the info.
+            //
+
+            // Owner
+            const dbtype::Id::EntityIdType entity_owner_int =
+                sqlite3_column_int64(connection.get_entity_metadata_stmt, 0);
+            // Type (as int)
+            const int entity_type_int =
+                sqlite3_column_int(connection.get_entity_metadata_stmt, 1);
+            // version
+            const dbtype::Entity::VersionType version =
+                sqlite3_column_int(connection.get_entity_metadata_stmt, 2);
+            // name (string)
+            const char *name_char_ptr = (const char *)
+                sqlite3_column_text(connection.get_entity_metadata_stmt, 3);
+            const int name_char_size =
+                sqlite3_column_bytes(connection.get_entity_metadata_stmt, 3);
+            std::string name;
+
+            if (name_char_size)
+            {
+                name.assign(name_char_ptr, name_char_size);
+            }
+
+            // Type as enum
+            const dbtype::EntityType entity_type =
+                (dbtype::EntityType) entity_type_int;
+
+            metadata.set(
+                id,
+                dbtype::Id(id.get_site_id(), entity_owner_int),
+                entity_type,
+                version,
+                name);
+        }
+
+        reset(connection.get_entity_metadata_stmt);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::delete_site_entity_data(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        bool success = true;
+        int rc = SQLITE_OK;
+
+        // The site's IDs start over.
+        site_id_blocks.erase(site_id);
+
+        if (sqlite3_bind_int(
+            delete_site_entities_stmt,
+            sqlite3_bind_parameter_index(
+                delete_site_entities_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "For delete_site_entities_stmt, could not bind $SITEID");
+        }
+
+        rc = sqlite3_step(delete_site_entities_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "Could not delete site entities: "
+                + std::string(sqlite3_errstr(rc)));
+
+            success = false;
+        }
+        else
+        {
+            rc = SQLITE_OK;
+        }
+
+        reset(delete_site_entities_stmt);
+
+        if (sqlite3_bind_int(
+            delete_site_display_names_stmt,
+            sqlite3_bind_parameter_index(
+                delete_site_display_names_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "For delete_site_display_names_stmt, could not bind $SITEID");
+        }
+
+        rc = sqlite3_step(delete_site_display_names_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "Could not delete site display names: "
+                + std::string(sqlite3_errstr(rc)));
+
+            success = false;
+        }
+        else
+        {
+            rc = SQLITE_OK;
+        }
+
+        reset(delete_site_display_names_stmt);
+
+        if (sqlite3_bind_int(
+            delete_site_applications_stmt,
+            sqlite3_bind_parameter_index(
+                delete_site_applications_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "For delete_site_applications_stmt, could not bind $SITEID");
+        }
+
+        rc = sqlite3_step(delete_site_applications_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "Could not delete site application properties: "
+                + std::string(sqlite3_errstr(rc)));
+
+            success = false;
+        }
+
+        reset(delete_site_applications_stmt);
+
+        if (sqlite3_bind_int(
+            delete_site_references_stmt,
+            sqlite3_bind_parameter_index(
+                delete_site_references_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "For delete_site_references_stmt, could not bind $SITEID");
+        }
+
+        rc = sqlite3_step(delete_site_references_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "Could not delete site references: "
+                + std::string(sqlite3_errstr(rc)));
+
+            success = false;
+        }
+
+        reset(delete_site_references_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *SqliteBackend::make_entity_from_row(
+        sqlite3_stmt *result_stmt_ptr,
+        const int type_column,
+        const dbtype::Id &id,
+        const bool add_to_memory)
+    {
+        dbtype::Entity *entity_ptr = 0;
+        const int entity_type_int =
+            sqlite3_column_int(result_stmt_ptr, type_column);
+        const void *blob_ptr =
+            sqlite3_column_blob(result_stmt_ptr, type_column + 1);
+        const int blob_size =
+            sqlite3_column_bytes(result_stmt_ptr, type_column + 1);
+
+        if ((not blob_ptr) or (blob_size <= 0))
+        {
+            LOG(error, "sqliteinterface", "make_entity_from_row",
+                "No blob data for ID " + id.to_string(true));
+        }
+        else
+        {
+            const dbtype::EntityType entity_type =
+                (dbtype::EntityType) entity_type_int;
+
+            entity_ptr = make_deserialize_entity(
+                entity_type,
+                blob_ptr,
+                blob_size);
+
+            if (not entity_ptr)
+            {
+                LOG(error, "sqliteinterface", "make_entity_from_row",
+                    "Unknown type to deserialize: "
+                      + dbtype::entity_type_to_string(entity_type)
+                      + "  ID: " + id.to_string(true));
+            }
+            else
+            {
+                if (sqlite3_column_type(result_stmt_ptr, type_column + 2) !=
+                    SQLITE_NULL)
+                {
+                    // Access statistics saved after the Entity data was
+                    // last written are newer; use them.
+                    //
+                    entity_ptr->set_entity_accessed_timestamp(
+                        dbtype::TimeStamp(
+                            (osinterface::OsTypes::TimeEpochType)
+                                sqlite3_column_int64(
+                                    result_stmt_ptr,
+                                    type_column + 2)));
+                    entity_ptr->set_entity_access_count(
+                        (dbtype::Entity::AccessCountType)
+                            sqlite3_column_int64(
+                                result_stmt_ptr,
+                                type_column + 3));
+                }
+
+                dbtype::PropertyEntity * const property_entity_ptr =
+                    dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+
+                if (property_entity_ptr)
+                {
+                    // Applications are loaded when first used.
+                    property_entity_ptr->
+                        set_application_properties_loader(this);
+                }
+
+                dbtype::Program * const program_ptr =
+                    dynamic_cast<dbtype::Program *>(entity_ptr);
+
+                if (program_ptr)
+                {
+                    // Compiled code is loaded when about to be run.
+                    program_ptr->set_program_code_loader(this);
+                }
+            }
+
+            if (entity_ptr and add_to_memory and
+                (not added_mem_owned(entity_ptr)))
+            {
+                // Another thread loaded it at the same time on a
+                // different read connection.  Use theirs.
+                //
+                delete entity_ptr;
+                entity_ptr = get_entity_pointer(id);
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::add_entity_ids(
+        sqlite3_stmt *result_stmt_ptr,
+        const dbtype::Id::SiteIdType site_id,
+        dbtype::Entity::IdVector &result)
+    {
+        if (result_stmt_ptr)
+        {
+            int rc = sqlite3_step(result_stmt_ptr);
+
+            while (rc == SQLITE_ROW)
+            {
+                result.push_back(
+                    dbtype::Id(
+                        site_id,
+                        (dbtype::Id::EntityIdType)
+                            sqlite3_column_int64(result_stmt_ptr, 0)));
+                rc = sqlite3_step(result_stmt_ptr);
+            }
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "add_entity_ids",
+                    "Error getting list of entity IDs: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::delete_program_reg(const mutgos::dbtype::Id &id)
+    {
+        if (sqlite3_bind_int(
+            delete_program_reg_stmt,
+            sqlite3_bind_parameter_index(delete_program_reg_stmt, "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_program_reg",
+                "For delete_program_reg_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int64(
+            delete_program_reg_stmt,
+            sqlite3_bind_parameter_index(delete_program_reg_stmt, "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_program_reg",
+                "For delete_program_reg_stmt, could not bind $ENTITYID");
+        }
+
+        const int rc = sqlite3_step(delete_program_reg_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_program_reg",
+                "Could not delete Entity program registration: "
+                + std::string(sqlite3_errstr(rc)));
+        }
+
+        reset(delete_program_reg_stmt);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::insert_program_reg(
+        const mutgos::dbtype::Id &id,
+        const std::string &registration_name)
+    {
+        bool result = true;
+
+        if (sqlite3_bind_int(
+            insert_program_reg_stmt,
+            sqlite3_bind_parameter_index(insert_program_reg_stmt, "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "insert_program_reg",
+                "For insert_program_reg_stmt, could not bind $SITEID");
+        }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by name.");
+        if (sqlite3_bind_int64(
+            insert_program_reg_stmt,
+            sqlite3_bind_parameter_index(insert_program_reg_stmt, "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "insert_program_reg",
+                "For insert_program_reg_stmt, could not bind $ENTITYID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-                "name LIKE '%' || $NAME || '%' AND type = $TYPE;",
-            -1,
-            &find_site_type_name_stmt,
-            0) != SQLITE_OK)
+        if (sqlite3_bind_text(
+            insert_program_reg_stmt,
+            sqlite3_bind_parameter_index(insert_program_reg_stmt, "$REGNAME"),
+            registration_name.c_str(),
+            registration_name.size(),
+            SQLITE_TRANSIENT) != SQLITE_OK)
         {
-            success = false;
+            LOG(error, "sqliteinterface", "insert_program_reg",
+                "For insert_program_reg_stmt, could not bind $REGNAME");
+        }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by name and type.");
+        const int rc = sqlite3_step(insert_program_reg_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "insert_program_reg",
+                "Could not insert Program registration: "
+                + std::string(sqlite3_errstr(rc)));
+
+            result = false;
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-                "name = $NAME AND type = $TYPE;",
-            -1,
-            &find_site_type_name_exact_stmt,
-            0) != SQLITE_OK)
+        reset(insert_program_reg_stmt);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::serialize_entity_row(
+        dbtype::Entity *entity_ptr,
+        EntityApplications &retry_applications,
+        dbtype::Entity::IdSet &retry_program_code,
+        EntitySaveRow &row)
+    {
+        if (not (entity_ptr and is_mem_owned(entity_ptr)))
         {
-            success = false;
+            return false;
+        }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by exact "
-                    "name and type.");
+        concurrency::WriterLockToken token(*entity_ptr);
+        const dbtype::Id &id = entity_ptr->get_entity_id();
+
+        row.id = id;
+        row.owner = entity_ptr->get_entity_owner(token).get_entity_id();
+        row.type = entity_ptr->get_entity_type();
+        row.name = entity_ptr->get_entity_name(token);
+        row.program = false;
+        row.code_changed = false;
+
+        if (not serialize_entity(entity_ptr, row.data))
+        {
+            LOG(error, "sqliteinterface", "serialize_entity_row",
+                "Could not serialize entity!");
+            return false;
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT type FROM entities WHERE site_id = $SITEID "
-            "and entity_id = $ENTITYID;",
-            -1,
-            &get_entity_type_stmt,
-            0) != SQLITE_OK)
+        dbtype::Program * const program_ptr =
+            dynamic_cast<dbtype::Program *>(entity_ptr);
+
+        if (program_ptr)
         {
-            success = false;
+            const std::string *code_ptr = 0;
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting an Entity type.");
+            row.program = true;
+            row.program_reg_name = program_ptr->get_program_reg_name(token);
+
+            // If the compiled code was never loaded, what's in the
+            // database is already current.
+            //
+            row.code_changed = program_ptr->get_compiled_code_for_save(
+                retry_program_code.count(id),
+                code_ptr,
+                token);
+
+            if (row.code_changed)
+            {
+                row.code = *code_ptr;
+            }
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT site_name FROM sites WHERE site_id = $SITEID;",
-            -1,
-            &get_site_name_stmt,
-            0) != SQLITE_OK)
+        retry_program_code.erase(id);
+
+        dbtype::PropertyEntity * const property_entity_ptr =
+            dynamic_cast<dbtype::PropertyEntity *>(entity_ptr);
+        dbtype::PropertyEntity::ApplicationNameSet applications;
+        EntityApplications::iterator retry_iter = retry_applications.find(id);
+
+        if (retry_iter != retry_applications.end())
+        {
+            applications.swap(retry_iter->second);
+            retry_applications.erase(retry_iter);
+        }
+
+        if (property_entity_ptr)
+        {
+            property_entity_ptr->get_changed_applications(applications, token);
+
+            for (dbtype::PropertyEntity::ApplicationNameSet::const_iterator
+                    app_iter = applications.begin();
+                app_iter != applications.end();
+                ++app_iter)
+            {
+                const dbtype::ApplicationProperties *properties_ptr = 0;
+
+                // If the application was never loaded, what's in the
+                // database is already current.
+                //
+                if (property_entity_ptr->get_application_properties_for_save(
+                    *app_iter,
+                    properties_ptr,
+                    token))
+                {
+                    row.applications.push_back(ApplicationRow());
+
+                    ApplicationRow &app_row = row.applications.back();
+
+                    // Null properties means the application was removed.
+                    app_row.application = *app_iter;
+                    app_row.removed = not properties_ptr;
+                    app_row.serialized = app_row.removed or
+                        serialize_application_properties(
+                            *properties_ptr,
+                            app_row.data);
+                }
+            }
+        }
+
+        entity_ptr->clear_dirty(token);
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::write_entity_row(const EntitySaveRow &row)
+    {
+        const dbtype::Id &id = row.id;
+        bool success = true;
+
+        if ((sqlite3_bind_int(
+                update_entity_stmt,
+                sqlite3_bind_parameter_index(update_entity_stmt, "$SITEID"),
+                id.get_site_id()) != SQLITE_OK) or
+            (sqlite3_bind_int64(
+                update_entity_stmt,
+                sqlite3_bind_parameter_index(update_entity_stmt, "$ENTITYID"),
+                id.get_entity_id()) != SQLITE_OK) or
+            (sqlite3_bind_int64(
+                update_entity_stmt,
+                sqlite3_bind_parameter_index(update_entity_stmt, "$OWNER"),
+                row.owner) != SQLITE_OK) or
+            (sqlite3_bind_int(
+                update_entity_stmt,
+                sqlite3_bind_parameter_index(update_entity_stmt, "$TYPE"),
+                row.type) != SQLITE_OK) or
+            (sqlite3_bind_text(
+                update_entity_stmt,
+                sqlite3_bind_parameter_index(update_entity_stmt, "$NAME"),
+                row.name.c_str(),
+                row.name.size(),
+                SQLITE_STATIC) != SQLITE_OK) or
+            (sqlite3_bind_blob(
+                update_entity_stmt,
+                sqlite3_bind_parameter_index(update_entity_stmt, "$DATA"),
+                row.data.data(),
+                row.data.size(),
+                SQLITE_STATIC) != SQLITE_OK))
         {
+            LOG(error, "sqliteinterface", "write_entity_row",
+                "For update_entity_stmt, could not bind parameters");
             success = false;
+        }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting a Site's name.");
+        if (success)
+        {
+            const int rc = sqlite3_step(update_entity_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "write_entity_row",
+                    "Could not update Entity: "
+                    + std::string(sqlite3_errstr(rc)));
+                success = false;
+            }
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT site_description FROM sites WHERE site_id = $SITEID;",
-            -1,
-            &get_site_description_stmt,
-            0) != SQLITE_OK)
+        reset(update_entity_stmt);
+
+        if (not success)
+        {
+            // The Entity is no longer dirty, so whatever goes with the row
+            // has to be remembered for the next time it is saved.
+            //
+            if (row.code_changed)
+            {
+                unsaved_program_code.insert(id);
+            }
+
+            for (ApplicationRows::const_iterator app_iter =
+                    row.applications.begin();
+                app_iter != row.applications.end();
+                ++app_iter)
+            {
+                unsaved_applications[id].insert(app_iter->application);
+            }
+
+            return false;
+        }
+
+        if (row.program)
+        {
+            // For now, brute force update program registration
+            // cache, since updates are expected to be rare and cheap.
+            //
+            if (row.code_changed and (not write_program_code_row(row)))
+            {
+                success = false;
+            }
+
+            delete_program_reg(id);
+
+            if ((not row.program_reg_name.empty()) and
+                (not insert_program_reg(id, row.program_reg_name)))
+            {
+                success = false;
+            }
+        }
+
+        if (not write_application_rows(row))
         {
             success = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::bind_entity_update_params(
+        dbtype::Entity *entity_ptr,
+        concurrency::WriterLockToken &token,
+        sqlite3_stmt *stmt)
+    {
+        bool success = entity_ptr;
+
+        if (success)
+        {
+            const std::string name = entity_ptr->get_entity_name(token);
+            success = serialize_entity(entity_ptr, entity_data_buffer);
+
+            if (not success)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "Could not serialize entity!");
+            }
+
+            if (sqlite3_bind_int64(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$OWNER"),
+                entity_ptr->get_entity_owner(token).get_entity_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $OWNER");
+            }
+
+            if (sqlite3_bind_int(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$TYPE"),
+                entity_ptr->get_entity_type()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $TYPE");
+            }
+
+            if (sqlite3_bind_text(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$NAME"),
+                name.c_str(),
+                name.size(),
+                SQLITE_TRANSIENT) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $NAME");
+            }
+
+            if (sqlite3_bind_int(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$SITEID"),
+                entity_ptr->get_entity_id().get_site_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $SITEID");
+            }
+
+            if (sqlite3_bind_int64(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
+                entity_ptr->get_entity_id().get_entity_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $ENTITYID");
+            }
+
+            if (sqlite3_bind_blob(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$DATA"),
+                entity_data_buffer.data(),
+                entity_data_buffer.size(),
+                SQLITE_STATIC) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $DATA");
+            }
+        }
+
+        return success;
+
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::write_application_rows(const EntitySaveRow &row)
+    {
+        const dbtype::Id &id = row.id;
+        bool success = true;
+
+        for (ApplicationRows::const_iterator app_iter =
+                row.applications.begin();
+            app_iter != row.applications.end();
+            ++app_iter)
+        {
+            sqlite3_stmt * const stmt = app_iter->removed ?
+                delete_application_stmt : save_application_stmt;
+            bool app_saved = app_iter->serialized;
+
+            if (not app_saved)
+            {
+                LOG(error, "sqliteinterface", "write_application_rows",
+                    "Could not serialize application "
+                    + app_iter->application
+                    + " for Entity " + id.to_string(true));
+            }
+            else
+            {
+                if ((not app_iter->removed) and
+                    (sqlite3_bind_blob(
+                        stmt,
+                        sqlite3_bind_parameter_index(stmt, "$DATA"),
+                        app_iter->data.data(),
+                        app_iter->data.size(),
+                        SQLITE_STATIC) != SQLITE_OK))
+                {
+                    LOG(error, "sqliteinterface", "write_application_rows",
+                        "For statement, could not bind $DATA");
+                }
+
+                if (sqlite3_bind_int(
+                    stmt,
+                    sqlite3_bind_parameter_index(stmt, "$SITEID"),
+                    id.get_site_id()) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "write_application_rows",
+                        "For statement, could not bind $SITEID");
+                }
+
+                if (sqlite3_bind_int64(
+                    stmt,
+                    sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
+                    id.get_entity_id()) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "write_application_rows",
+                        "For statement, could not bind $ENTITYID");
+                }
+
+                if (sqlite3_bind_text(
+                    stmt,
+                    sqlite3_bind_parameter_index(stmt, "$APPLICATION"),
+                    app_iter->application.c_str(),
+                    app_iter->application.size(),
+                    SQLITE_STATIC) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "write_application_rows",
+                        "For statement, could not bind $APPLICATION");
+                }
+
+                const int rc = sqlite3_step(stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "write_application_rows",
+                        "Could not save application "
+                        + app_iter->application
+                        + " for Entity " + id.to_string(true) + ": "
+                        + std::string(sqlite3_errstr(rc)));
+                    app_saved = false;
+                }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting a Site's description.");
+                reset(stmt);
+            }
+
+            if (not app_saved)
+            {
+                // Try again next time the Entity is saved.
+                unsaved_applications[id].insert(app_iter->application);
+                success = false;
+            }
+            else if (transaction_begun)
+            {
+                transaction_applications[id].insert(app_iter->application);
+            }
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM program_registrations WHERE "
-              "site_id = $SITEID AND registration_name = $REGNAME;",
-            -1,
-            &find_program_reg_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        return success;
+    }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for finding a program registration.");
+    // ----------------------------------------------------------------------
+    void SqliteBackend::delete_entity_applications(const dbtype::Id &id)
+    {
+        if (sqlite3_bind_int(
+            delete_entity_applications_stmt,
+            sqlite3_bind_parameter_index(
+                delete_entity_applications_stmt,
+                "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_entity_applications",
+                "For delete_entity_applications_stmt, could not bind $SITEID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT registration_name FROM program_registrations WHERE "
-            "site_id = $SITEID AND entity_id = $ENTITYID;",
-            -1,
-            &find_program_reg_id_stmt,
-            0) != SQLITE_OK)
+        if (sqlite3_bind_int64(
+            delete_entity_applications_stmt,
+            sqlite3_bind_parameter_index(
+                delete_entity_applications_stmt,
+                "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for finding a program registration by ID.");
+            LOG(error, "sqliteinterface", "delete_entity_applications",
+                "For delete_entity_applications_stmt, could not bind $ENTITYID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT type FROM entities WHERE site_id = $SITEID "
-            "and entity_id = $ENTITYID;",
-            -1,
-            &entity_exists_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        const int rc = sqlite3_step(delete_entity_applications_stmt);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for checking Entity existence.");
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_entity_applications",
+                "Could not delete Entity application properties: "
+                + std::string(sqlite3_errstr(rc)));
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE sites SET deleted = 0 WHERE site_id = $SITEID;",
-            -1,
-            &undelete_site_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        reset(delete_entity_applications_stmt);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for reusing a site.");
-        }
+        unsaved_applications.erase(id);
+        transaction_applications.erase(id);
+    }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT site_id FROM next_site_id;",
-            -1,
-            &next_site_id_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::write_program_code_row(const EntitySaveRow &row)
+    {
+        const dbtype::Id &id = row.id;
+        bool success = true;
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting a new site ID.");
-        }
+        // Empty code means the compiled code was removed.
+        sqlite3_stmt * const stmt = row.code.empty() ?
+            delete_program_code_stmt : save_program_code_stmt;
 
-        // Starts at 2 because this is called after first site created.
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "INSERT INTO next_site_id(site_id) VALUES (2);",
-            -1,
-            &insert_first_next_site_id_stmt,
-            0) != SQLITE_OK)
+        if ((not row.code.empty()) and
+            (sqlite3_bind_blob(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$DATA"),
+                row.code.data(),
+                row.code.size(),
+                SQLITE_STATIC) != SQLITE_OK))
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for inserting the first next site ID.");
+            LOG(error, "sqliteinterface", "write_program_code_row",
+                "For statement, could not bind $DATA");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE next_site_id SET site_id = $SITEID;",
-            -1,
-            &update_next_site_id_stmt,
-            0) != SQLITE_OK)
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for updating the next site ID.");
+            LOG(error, "sqliteinterface", "write_program_code_row",
+                "For statement, could not bind $SITEID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "INSERT INTO sites(site_id, site_name, site_description, deleted) "
-                "VALUES ($SITEID, $SITENAME, $SITEDESCRIPTION, 0);",
-            -1,
-            &insert_new_site_stmt,
-            0) != SQLITE_OK)
+        if (sqlite3_bind_int64(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for inserting a new site.");
+            LOG(error, "sqliteinterface", "write_program_code_row",
+                "For statement, could not bind $ENTITYID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "INSERT INTO next_id(site_id, next_entity_id) VALUES ($SITEID, 1);",
-            -1,
-            &insert_first_site_entity_id_stmt,
-            0) != SQLITE_OK)
+        const int rc = sqlite3_step(stmt);
+
+        if (rc != SQLITE_DONE)
         {
+            LOG(error, "sqliteinterface", "write_program_code_row",
+                "Could not save compiled code for Program "
+                + id.to_string(true) + ": "
+                + std::string(sqlite3_errstr(rc)));
             success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for inserting first site ID.");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM entities WHERE site_id = $SITEID;",
-            -1,
-            &delete_site_entities_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        reset(stmt);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for delete a site's entities.");
+        if (not success)
+        {
+            // Try again next time the Program is saved.
+            unsaved_program_code.insert(id);
         }
-
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM display_names WHERE site_id = $SITEID;",
-            -1,
-            &delete_site_display_names_stmt,
-            0) != SQLITE_OK)
+        else if (transaction_begun)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for delete a site's display names.");
+            transaction_program_code.insert(id);
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE sites SET site_name = $SITENAME WHERE site_id = $SITEID;",
-            -1,
-            &set_site_name_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        return success;
+    }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for setting a site's name.");
+    // ----------------------------------------------------------------------
+    void SqliteBackend::delete_entity_references(const dbtype::Id &id)
+    {
+        if (sqlite3_bind_int(
+            delete_entity_references_stmt,
+            sqlite3_bind_parameter_index(
+                delete_entity_references_stmt,
+                "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_entity_references",
+                "For delete_entity_references_stmt, could not bind $SITEID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE sites SET site_description = $SITEDESCRIPTION "
-                "WHERE site_id = $SITEID;",
-            -1,
-            &set_site_description_stmt,
-            0) != SQLITE_OK)
+        if (sqlite3_bind_int64(
+            delete_entity_references_stmt,
+            sqlite3_bind_parameter_index(
+                delete_entity_references_stmt,
+                "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for setting a site's description.");
+            LOG(error, "sqliteinterface", "delete_entity_references",
+                "For delete_entity_references_stmt, could not bind $ENTITYID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE entities SET owner = $OWNER, type = $TYPE, name = $NAME, "
-                                "data = $DATA "
-                "WHERE site_id = $SITEID and entity_id = $ENTITYID;",
-            -1,
-            &update_entity_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        const int rc = sqlite3_step(delete_entity_references_stmt);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for updating an Entity.");
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_entity_references",
+                "Could not delete Entity references: "
+                + std::string(sqlite3_errstr(rc)));
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT type, data FROM entities WHERE site_id = $SITEID "
-                "and entity_id = $ENTITYID;",
-            -1,
-            &get_entity_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        reset(delete_entity_references_stmt);
+    }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting an Entity.");
-        }
+    // ----------------------------------------------------------------------
+    dbtype::Id::EntityIdType SqliteBackend::take_entity_id(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        SiteIdBlock &block = site_id_blocks[site_id];
+        dbtype::Id::EntityIdType entity_id = 0;
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT owner, type, version, name FROM entities WHERE "
-            "site_id = $SITEID and entity_id = $ENTITYID;",
-            -1,
-            &get_entity_metadata_stmt,
-            0) != SQLITE_OK)
+        if (block.reused_ids.empty() and (not block.reuse_checked))
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting an Entity metadata.");
+            if (not reserve_reused_ids(site_id, block))
+            {
+                return 0;
+            }
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT deleted_entity_id FROM id_reuse WHERE site_id = $SITEID;",
-            -1,
-            &get_next_deleted_entity_id_stmt,
-            0) != SQLITE_OK)
+        if (not block.reused_ids.empty())
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for get next deleted entity ID.");
+            entity_id = block.reused_ids.front();
+            block.reused_ids.pop_front();
         }
-
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM id_reuse WHERE site_id = $SITEID "
-                "AND deleted_entity_id = $ENTITYID;",
-            -1,
-            &mark_deleted_id_used_stmt,
-            0) != SQLITE_OK)
+        else
         {
-            success = false;
+            if (block.next_fresh_id >= block.end_fresh_id)
+            {
+                if (not reserve_fresh_ids(site_id, block))
+                {
+                    return 0;
+                }
+            }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for marking reused entity ID as used.");
+            entity_id = block.next_fresh_id;
+            ++block.next_fresh_id;
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT next_entity_id FROM next_id WHERE site_id = $SITEID;",
-            -1,
-            &get_next_entity_id_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+        return entity_id;
+    }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting next fresh entity ID.");
-        }
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::reserve_reused_ids(
+        const dbtype::Id::SiteIdType site_id,
+        SiteIdBlock &block)
+    {
+        bool success = true;
+        int rc = SQLITE_OK;
+        dbtype::Id::EntityIdType last_id = 0;
+        size_t reserved = 0;
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE next_id SET next_entity_id = $NEXTID WHERE site_id = $SITEID;",
-            -1,
-            &update_next_entity_id_stmt,
-            0) != SQLITE_OK)
+        if ((sqlite3_bind_int(
+                get_deleted_entity_ids_stmt,
+                sqlite3_bind_parameter_index(get_deleted_entity_ids_stmt,
+                    "$SITEID"),
+                site_id) != SQLITE_OK) or
+            (sqlite3_bind_int(
+                get_deleted_entity_ids_stmt,
+                sqlite3_bind_parameter_index(get_deleted_entity_ids_stmt,
+                    "$LIMIT"),
+                (int) ID_BLOCK_SIZE) != SQLITE_OK))
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for updating next entity ID counter.");
+            LOG(error, "sqliteinterface", "reserve_reused_ids",
+                "For get_deleted_entity_ids_stmt, could not bind parameters");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "INSERT INTO "
-              "entities(site_id, entity_id, owner, type, version, name, data) "
-              "VALUES ($SITEID, $ENTITYID, $OWNER, $TYPE, $VERSION, $NAME, $DATA);",
-            -1,
-            &add_entity_stmt,
-            0) != SQLITE_OK)
+        while ((rc = sqlite3_step(get_deleted_entity_ids_stmt)) == SQLITE_ROW)
         {
-            success = false;
+            last_id = (dbtype::Id::EntityIdType) sqlite3_column_int64(
+                get_deleted_entity_ids_stmt, 0);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for inserting new Entity.");
+            if (last_id)
+            {
+                block.reused_ids.push_back(last_id);
+            }
+
+            ++reserved;
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM entities WHERE site_id = $SITEID AND entity_id = $ENTITYID;",
-            -1,
-            &delete_entity_stmt,
-            0) != SQLITE_OK)
+        if (rc != SQLITE_DONE)
         {
+            LOG(error, "sqliteinterface", "reserve_reused_ids",
+                "Could not get recycled IDs: "
+                + std::string(sqlite3_errstr(rc)));
             success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for deleting an Entity.");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "INSERT INTO id_reuse(site_id, deleted_entity_id) VALUES "
-                "($SITEID, $ENTITYID);",
-            -1,
-            &add_reuse_entity_id_stmt,
-            0) != SQLITE_OK)
+        reset(get_deleted_entity_ids_stmt);
+
+        if (success and reserved)
         {
-            success = false;
+            // Remove the IDs from the reuse table, since they are now
+            // reserved.  They are the lowest, so everything up to the last
+            // one goes.
+            //
+            if (sqlite3_bind_int(
+                mark_deleted_ids_used_stmt,
+                sqlite3_bind_parameter_index(mark_deleted_ids_used_stmt,
+                    "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "reserve_reused_ids",
+                    "For mark_deleted_ids_used_stmt, could not bind $SITEID");
+            }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for adding Entity to reuse table.");
-        }
+            if (sqlite3_bind_int64(
+                mark_deleted_ids_used_stmt,
+                sqlite3_bind_parameter_index(mark_deleted_ids_used_stmt,
+                    "$ENTITYID"),
+                last_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "reserve_reused_ids",
+                    "For mark_deleted_ids_used_stmt, could not bind $ENTITYID");
+            }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "UPDATE sites SET deleted = 1 WHERE site_id = $SITEID;",
-            -1,
-            &mark_site_deleted_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+            rc = sqlite3_step(mark_deleted_ids_used_stmt);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for marking site as deleted.");
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "reserve_reused_ids",
+                    "Could not remove selected IDs from reuse list: "
+                    + std::string(sqlite3_errstr(rc)));
+                success = false;
+            }
+
+            reset(mark_deleted_ids_used_stmt);
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM id_reuse WHERE site_id = $SITEID;",
-            -1,
-            &delete_all_site_entity_id_reuse_stmt,
-            0) != SQLITE_OK)
+        if (success)
         {
-            success = false;
+            // A short block means there is nothing left to reuse until
+            // something else is deleted.
+            block.reuse_checked = (reserved < ID_BLOCK_SIZE);
+        }
+        else
+        {
+            // Not reserved, so they must not be handed out.
+            block.reused_ids.clear();
+        }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for deleting site reuse Entity IDs.");
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::reserve_fresh_ids(
+        const dbtype::Id::SiteIdType site_id,
+        SiteIdBlock &block)
+    {
+        bool success = true;
+        dbtype::Id::EntityIdType next_id = 0;
+
+        if (sqlite3_bind_int(
+            get_next_entity_id_stmt,
+            sqlite3_bind_parameter_index(get_next_entity_id_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "reserve_fresh_ids",
+                "For get_next_entity_id_stmt, could not bind $SITEID");
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM next_id WHERE site_id = $SITEID;",
-            -1,
-            &delete_site_next_entity_id_stmt,
-            0) != SQLITE_OK)
+        int rc = sqlite3_step(get_next_entity_id_stmt);
+
+        if (rc != SQLITE_ROW)
         {
+            LOG(error, "sqliteinterface", "reserve_fresh_ids",
+                "Could not get next fresh ID: "
+                + std::string(sqlite3_errstr(rc)));
             success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for deleting site next Entity ID.");
+        }
+        else
+        {
+            next_id = (dbtype::Id::EntityIdType) sqlite3_column_int64(
+                get_next_entity_id_stmt, 0);
+            success = next_id;
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "INSERT INTO program_registrations(site_id, entity_id, registration_name) VALUES "
-            "($SITEID, $ENTITYID, $REGNAME);",
-            -1,
-            &insert_program_reg_stmt,
-            0) != SQLITE_OK)
+        reset(get_next_entity_id_stmt);
+
+        if (success)
         {
-            success = false;
+            if (sqlite3_bind_int(
+                update_next_entity_id_stmt,
+                sqlite3_bind_parameter_index(
+                    update_next_entity_id_stmt, "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "reserve_fresh_ids",
+                    "For update_next_entity_id_stmt, could not bind $SITEID");
+            }
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for inserting a program registration.");
+            if (sqlite3_bind_int64(
+                update_next_entity_id_stmt,
+                sqlite3_bind_parameter_index(
+                    update_next_entity_id_stmt, "$NEXTID"),
+                next_id + ID_BLOCK_SIZE) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "reserve_fresh_ids",
+                    "For update_next_entity_id_stmt, could not bind $NEXTID");
+            }
+
+            rc = sqlite3_step(update_next_entity_id_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "reserve_fresh_ids",
+                    "Could not update next fresh ID: "
+                    + std::string(sqlite3_errstr(rc)));
+                success = false;
+            }
+
+            reset(update_next_entity_id_stmt);
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "DELETE FROM program_registrations WHERE "
-              "site_id = $SITEID AND entity_id = $ENTITYID;",
-            -1,
-            &delete_program_reg_stmt,
-            0) != SQLITE_OK)
+        if (success)
         {
-            success = false;
-
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for deleting  a program registration.");
+            block.next_fresh_id = next_id;
+            block.end_fresh_id = next_id + ID_BLOCK_SIZE;
         }
 
         return success;
     }
 
-    void SqliteBackend::get_metadata_internal(
-        const dbtype::Id &id,
-        dbinterface::EntityMetadata &metadata)
+    // ----------------------------------------------------------------------
+    void SqliteBackend::release_id_blocks(void)
     {
-        // Look up the Entity
-        //
-        if (sqlite3_bind_int(
-            get_entity_metadata_stmt,
-            sqlite3_bind_parameter_index(get_entity_metadata_stmt, "$SITEID"),
-            id.get_site_id()) != SQLITE_OK)
+        for (SiteIdBlocks::iterator block_iter = site_id_blocks.begin();
+            block_iter != site_id_blocks.end();
+            ++block_iter)
         {
-            LOG(error, "sqliteinterface", "get_metadata_internal",
-                "For get_metadata_internal, could not bind $SITEID");
+            const dbtype::Id::SiteIdType site_id = block_iter->first;
+            SiteIdBlock &block = block_iter->second;
+
+            for (std::deque<dbtype::Id::EntityIdType>::const_iterator id_iter =
+                    block.reused_ids.begin();
+                id_iter != block.reused_ids.end();
+                ++id_iter)
+            {
+                if ((sqlite3_bind_int(
+                        add_reuse_entity_id_stmt,
+                        sqlite3_bind_parameter_index(
+                            add_reuse_entity_id_stmt, "$SITEID"),
+                        site_id) != SQLITE_OK) or
+                    (sqlite3_bind_int64(
+                        add_reuse_entity_id_stmt,
+                        sqlite3_bind_parameter_index(
+                            add_reuse_entity_id_stmt, "$ENTITYID"),
+                        *id_iter) != SQLITE_OK))
+                {
+                    LOG(error, "sqliteinterface", "release_id_blocks",
+                        "For add_reuse_entity_id_stmt, could not bind "
+                        "parameters");
+                }
+
+                const int rc = sqlite3_step(add_reuse_entity_id_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "release_id_blocks",
+                        "Could not return reserved ID to reuse table: "
+                        + std::string(sqlite3_errstr(rc)));
+                }
+
+                reset(add_reuse_entity_id_stmt);
+            }
+
+            if (block.next_fresh_id < block.end_fresh_id)
+            {
+                // Nothing else advances next_id, so the end of the block is
+                // still where it is.
+                //
+                if ((sqlite3_bind_int(
+                        update_next_entity_id_stmt,
+                        sqlite3_bind_parameter_index(
+                            update_next_entity_id_stmt, "$SITEID"),
+                        site_id) != SQLITE_OK) or
+                    (sqlite3_bind_int64(
+                        update_next_entity_id_stmt,
+                        sqlite3_bind_parameter_index(
+                            update_next_entity_id_stmt, "$NEXTID"),
+                        block.next_fresh_id) != SQLITE_OK))
+                {
+                    LOG(error, "sqliteinterface", "release_id_blocks",
+                        "For update_next_entity_id_stmt, could not bind "
+                        "parameters");
+                }
+
+                const int rc = sqlite3_step(update_next_entity_id_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "release_id_blocks",
+                        "Could not return reserved IDs to next ID: "
+                        + std::string(sqlite3_errstr(rc)));
+                }
+
+                reset(update_next_entity_id_stmt);
+            }
         }
 
-        if (sqlite3_bind_int64(
-            get_entity_metadata_stmt,
-            sqlite3_bind_parameter_index(get_entity_metadata_stmt, "$ENTITYID"),
-            id.get_entity_id()) != SQLITE_OK)
+        site_id_blocks.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    SqliteBackend::ReadConnectionGuard::ReadConnectionGuard(
+        SqliteBackend &backend)
+      : pool_backend(backend),
+        connection_ptr(backend.acquire_read_connection())
+    {
+        if (not connection_ptr)
         {
-            LOG(error, "sqliteinterface", "get_metadata_internal",
-                "For get_metadata_internal, could not bind $ENTITYID");
+            // The pool is closed, such as while switching to or from a bulk
+            // load, so read through the writer instead.
+            //
+            writer_lock = boost::unique_lock<boost::mutex>(
+                backend.writer_read_mutex);
+            connection_ptr = &backend.writer_read_connection;
         }
+    }
 
-        if (sqlite3_step(get_entity_metadata_stmt) != SQLITE_ROW)
+    // ----------------------------------------------------------------------
+    SqliteBackend::ReadConnectionGuard::~ReadConnectionGuard()
+    {
+        if (not writer_lock.owns_lock())
         {
-            metadata.reset();
+            pool_backend.release_read_connection(connection_ptr);
         }
-        else
+
+        connection_ptr = 0;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::restore_new_entities(void)
+    {
+        for (NewEntityRows::const_iterator row_iter =
+                transaction_new_entities.begin();
+            row_iter != transaction_new_entities.end();
+            ++row_iter)
         {
-            // Found an entry.  Extract the info.
+            const dbtype::Id &id = row_iter->first;
+            const NewEntityRow &row = row_iter->second;
+
+            if ((sqlite3_bind_int(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$SITEID"),
+                    id.get_site_id()) != SQLITE_OK) or
+                (sqlite3_bind_int64(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$ENTITYID"),
+                    id.get_entity_id()) != SQLITE_OK) or
+                (sqlite3_bind_int64(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$OWNER"),
+                    row.owner) != SQLITE_OK) or
+                (sqlite3_bind_int(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$TYPE"),
+                    row.type) != SQLITE_OK) or
+                (sqlite3_bind_int(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$VERSION"),
+                    row.version) != SQLITE_OK) or
+                (sqlite3_bind_text(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$NAME"),
+                    row.name.c_str(),
+                    row.name.size(),
+                    SQLITE_STATIC) != SQLITE_OK) or
+                (sqlite3_bind_blob(
+                    add_entity_stmt,
+                    sqlite3_bind_parameter_index(add_entity_stmt, "$DATA"),
+                    row.data.data(),
+                    row.data.size(),
+                    SQLITE_STATIC) != SQLITE_OK))
+            {
+                LOG(error, "sqliteinterface", "restore_new_entities",
+                    "For add_entity_stmt, could not bind parameters");
+            }
+
+            int rc = sqlite3_step(add_entity_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "restore_new_entities",
+                    "Could not restore new Entity "
+                    + id.to_string(true) + ": "
+                    + std::string(sqlite3_errstr(rc)));
+            }
+
+            reset(add_entity_stmt);
+
+            // The ID may have come from the reuse table.
             //
+            if ((sqlite3_bind_int(
+                    delete_reuse_entity_id_stmt,
+                    sqlite3_bind_parameter_index(
+                        delete_reuse_entity_id_stmt, "$SITEID"),
+                    id.get_site_id()) != SQLITE_OK) or
+                (sqlite3_bind_int64(
+                    delete_reuse_entity_id_stmt,
+                    sqlite3_bind_parameter_index(
+                        delete_reuse_entity_id_stmt, "$ENTITYID"),
+                    id.get_entity_id()) != SQLITE_OK))
+            {
+                LOG(error, "sqliteinterface", "restore_new_entities",
+                    "For delete_reuse_entity_id_stmt, could not bind "
+                    "parameters");
+            }
 
-            // Owner
-            const dbtype::Id::EntityIdType entity_owner_int =
-                sqlite3_column_int64(get_entity_metadata_stmt, 0);
-            // Type (as int)
-            const int entity_type_int =
-                sqlite3_column_int(get_entity_metadata_stmt, 1);
-            // version
-            const dbtype::Entity::VersionType version =
-                sqlite3_column_int(get_entity_metadata_stmt, 2);
-            // name (string)
-            const char *name_char_ptr = (const char *)
-                sqlite3_column_text(get_entity_metadata_stmt, 3);
-            const int name_char_size =
-                sqlite3_column_bytes(get_entity_metadata_stmt, 3);
-            std::string name;
+            rc = sqlite3_step(delete_reuse_entity_id_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "restore_new_entities",
+                    "Could not remove restored Entity ID from reuse table: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
+
+            reset(delete_reuse_entity_id_stmt);
+
+            // Or it may have been a fresh one.
+            //
+            dbtype::Id::EntityIdType next_id = 0;
+
+            if (sqlite3_bind_int(
+                get_next_entity_id_stmt,
+                sqlite3_bind_parameter_index(get_next_entity_id_stmt,
+                    "$SITEID"),
+                id.get_site_id()) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "restore_new_entities",
+                    "For get_next_entity_id_stmt, could not bind $SITEID");
+            }
 
-            if (name_char_size)
+            if (sqlite3_step(get_next_entity_id_stmt) == SQLITE_ROW)
             {
-                name.assign(name_char_ptr, name_char_size);
+                next_id = (dbtype::Id::EntityIdType) sqlite3_column_int64(
+                    get_next_entity_id_stmt, 0);
             }
 
-            // Type as enum
-            const dbtype::EntityType entity_type =
-                (dbtype::EntityType) entity_type_int;
+            reset(get_next_entity_id_stmt);
 
-            metadata.set(
-                id,
-                dbtype::Id(id.get_site_id(), entity_owner_int),
-                entity_type,
-                version,
-                name);
+            if (next_id and (next_id <= id.get_entity_id()))
+            {
+                if ((sqlite3_bind_int(
+                        update_next_entity_id_stmt,
+                        sqlite3_bind_parameter_index(
+                            update_next_entity_id_stmt, "$SITEID"),
+                        id.get_site_id()) != SQLITE_OK) or
+                    (sqlite3_bind_int64(
+                        update_next_entity_id_stmt,
+                        sqlite3_bind_parameter_index(
+                            update_next_entity_id_stmt, "$NEXTID"),
+                        id.get_entity_id() + 1) != SQLITE_OK))
+                {
+                    LOG(error, "sqliteinterface", "restore_new_entities",
+                        "For update_next_entity_id_stmt, could not bind "
+                        "parameters");
+                }
+
+                rc = sqlite3_step(update_next_entity_id_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "restore_new_entities",
+                        "Could not update next fresh ID: "
+                        + std::string(sqlite3_errstr(rc)));
+                }
+
+                reset(update_next_entity_id_stmt);
+            }
         }
 
-        reset(get_entity_metadata_stmt);
+        if (not transaction_new_entities.empty())
+        {
+            LOG(info, "sqliteinterface", "restore_new_entities",
+                "Restored " + text::to_string(transaction_new_entities.size())
+                + " Entities created during the failed transaction.");
+        }
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::delete_site_entity_data(
-        const dbtype::Id::SiteIdType site_id)
+    bool SqliteBackend::open_read_connections(const bool use_writer)
     {
-        bool success = true;
-        int rc = SQLITE_OK;
-
-        if (sqlite3_bind_int(
-            delete_site_entities_stmt,
-            sqlite3_bind_parameter_index(
-                delete_site_entities_stmt,
-                "$SITEID"),
-            site_id) != SQLITE_OK)
-        {
-            LOG(error, "sqliteinterface", "delete_site_entity_data",
-                "For delete_site_entities_stmt, could not bind $SITEID");
-        }
+        boost::unique_lock<boost::mutex> lock(read_connections_mutex);
 
-        rc = sqlite3_step(delete_site_entities_stmt);
+        bool success = read_connections.empty();
+        const MG_UnsignedInt connection_count = config::db::read_connections();
 
-        if (rc != SQLITE_DONE)
+        for (MG_UnsignedInt index = 0;
+             success and (index < connection_count);
+             ++index)
         {
-            LOG(error, "sqliteinterface", "delete_site_entity_data",
-                "Could not delete site entities: "
-                + std::string(sqlite3_errstr(rc)));
+            SqliteReadConnection * const connection_ptr =
+                new SqliteReadConnection();
 
-            success = false;
-        }
-        else
-        {
-            rc = SQLITE_OK;
+            if (use_writer ?
+                connection_ptr->open(dbhandle_ptr) :
+                connection_ptr->open(database_file))
+            {
+                read_connections.push_back(connection_ptr);
+                idle_read_connections.push_back(connection_ptr);
+            }
+            else
+            {
+                delete connection_ptr;
+                success = false;
+            }
         }
 
-        reset(delete_site_entities_stmt);
-
-        if (sqlite3_bind_int(
-            delete_site_display_names_stmt,
-            sqlite3_bind_parameter_index(
-                delete_site_display_names_stmt,
-                "$SITEID"),
-            site_id) != SQLITE_OK)
+        if (success)
         {
-            LOG(error, "sqliteinterface", "delete_site_entity_data",
-                "For delete_site_display_names_stmt, could not bind $SITEID");
-        }
+            lock.unlock();
 
-        rc = sqlite3_step(delete_site_display_names_stmt);
-
-        if (rc != SQLITE_DONE)
-        {
-            LOG(error, "sqliteinterface", "delete_site_entity_data",
-                "Could not delete site display names: "
-                + std::string(sqlite3_errstr(rc)));
+            // Readers may have been waiting while the pool was closed.
+            read_connections_cond.notify_all();
 
-            success = false;
+            LOG(info, "sqliteinterface", "open_read_connections",
+                "Opened " + text::to_string(connection_count)
+                + " read connections.");
         }
         else
         {
-            rc = SQLITE_OK;
+            LOG(fatal, "sqliteinterface", "open_read_connections",
+                "Unable to open read connections.");
         }
 
-        reset(delete_site_display_names_stmt);
-
         return success;
     }
 
     // ----------------------------------------------------------------------
-    void SqliteBackend::add_entity_ids(
-        sqlite3_stmt *result_stmt_ptr,
-        const dbtype::Id::SiteIdType site_id,
-        dbtype::Entity::IdVector &result)
+    bool SqliteBackend::open_transaction_read_connections(void)
     {
-        if (result_stmt_ptr)
+        boost::lock_guard<boost::mutex> guard(read_connections_mutex);
+
+        bool success = transaction_read_connections.empty();
+        const MG_UnsignedInt connection_count = config::db::read_connections();
+
+        for (MG_UnsignedInt index = 0;
+             success and (index < connection_count);
+             ++index)
         {
-            int rc = sqlite3_step(result_stmt_ptr);
+            SqliteReadConnection * const connection_ptr =
+                new SqliteReadConnection();
 
-            while (rc == SQLITE_ROW)
+            if (connection_ptr->open(dbhandle_ptr))
             {
-                result.push_back(
-                    dbtype::Id(
-                        site_id,
-                        (dbtype::Id::EntityIdType)
-                            sqlite3_column_int64(result_stmt_ptr, 0)));
-                rc = sqlite3_step(result_stmt_ptr);
+                transaction_read_connections.push_back(connection_ptr);
+                idle_transaction_read_connections.push_back(connection_ptr);
             }
-
-            if (rc != SQLITE_DONE)
+            else
             {
-                LOG(error, "sqliteinterface", "add_entity_ids",
-                    "Error getting list of entity IDs: "
-                    + std::string(sqlite3_errstr(rc)));
+                delete connection_ptr;
+                success = false;
             }
         }
-    }
 
-    // ----------------------------------------------------------------------
-    void SqliteBackend::delete_program_reg(const mutgos::dbtype::Id &id)
-    {
-        if (sqlite3_bind_int(
-            delete_program_reg_stmt,
-            sqlite3_bind_parameter_index(delete_program_reg_stmt, "$SITEID"),
-            id.get_site_id()) != SQLITE_OK)
+        if (not success)
         {
-            LOG(error, "sqliteinterface", "delete_program_reg",
-                "For delete_program_reg_stmt, could not bind $SITEID");
+            LOG(fatal, "sqliteinterface", "open_transaction_read_connections",
+                "Unable to open transaction read connections.");
         }
 
-        if (sqlite3_bind_int64(
-            delete_program_reg_stmt,
-            sqlite3_bind_parameter_index(delete_program_reg_stmt, "$ENTITYID"),
-            id.get_entity_id()) != SQLITE_OK)
-        {
-            LOG(error, "sqliteinterface", "delete_program_reg",
-                "For delete_program_reg_stmt, could not bind $ENTITYID");
-        }
+        return success;
+    }
 
-        const int rc = sqlite3_step(delete_program_reg_stmt);
+    // ----------------------------------------------------------------------
+    void SqliteBackend::close_transaction_read_connections(void)
+    {
+        boost::lock_guard<boost::mutex> guard(read_connections_mutex);
 
-        if (rc != SQLITE_DONE)
+        for (ReadConnections::iterator connection_iter =
+                transaction_read_connections.begin();
+             connection_iter != transaction_read_connections.end();
+             ++connection_iter)
         {
-            LOG(error, "sqliteinterface", "delete_program_reg",
-                "Could not delete Entity program registration: "
-                + std::string(sqlite3_errstr(rc)));
+            delete *connection_iter;
         }
 
-        reset(delete_program_reg_stmt);
+        transaction_read_connections.clear();
+        idle_transaction_read_connections.clear();
+
+        // Anyone waiting for one will use the writer instead.
+        read_connections_cond.notify_all();
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::insert_program_reg(
-        const mutgos::dbtype::Id &id,
-        const std::string &registration_name)
+    void SqliteBackend::close_read_connections(void)
     {
-        bool result = true;
+        boost::unique_lock<boost::mutex> lock(read_connections_mutex);
 
-        if (sqlite3_bind_int(
-            insert_program_reg_stmt,
-            sqlite3_bind_parameter_index(insert_program_reg_stmt, "$SITEID"),
-            id.get_site_id()) != SQLITE_OK)
+        // Anyone still reading has to finish before the statements go away.
+        //
+        while (idle_read_connections.size() != read_connections.size())
         {
-            LOG(error, "sqliteinterface", "insert_program_reg",
-                "For insert_program_reg_stmt, could not bind $SITEID");
+            read_connections_cond.wait(lock);
         }
 
-        if (sqlite3_bind_int64(
-            insert_program_reg_stmt,
-            sqlite3_bind_parameter_index(insert_program_reg_stmt, "$ENTITYID"),
-            id.get_entity_id()) != SQLITE_OK)
+        for (ReadConnections::iterator connection_iter =
+                read_connections.begin();
+             connection_iter != read_connections.end();
+             ++connection_iter)
         {
-            LOG(error, "sqliteinterface", "insert_program_reg",
-                "For insert_program_reg_stmt, could not bind $ENTITYID");
+            delete *connection_iter;
         }
 
-        if (sqlite3_bind_text(
-            insert_program_reg_stmt,
-            sqlite3_bind_parameter_index(insert_program_reg_stmt, "$REGNAME"),
-            registration_name.c_str(),
-            registration_name.size(),
-            SQLITE_TRANSIENT) != SQLITE_OK)
+        read_connections.clear();
+        idle_read_connections.clear();
+
+        // Anyone waiting for one will use the writer instead.
+        read_connections_cond.notify_all();
+    }
+
+    // ----------------------------------------------------------------------
+    SqliteReadConnection *SqliteBackend::acquire_read_connection(void)
+    {
+        bool in_transaction = false;
+
         {
-            LOG(error, "sqliteinterface", "insert_program_reg",
-                "For insert_program_reg_stmt, could not bind $REGNAME");
+            boost::lock_guard<boost::mutex> threads_guard(
+                transaction_threads_mutex);
+            in_transaction =
+                transaction_threads.count(boost::this_thread::get_id());
         }
 
-        const int rc = sqlite3_step(insert_program_reg_stmt);
-
-        if (rc != SQLITE_DONE)
+        // A thread in the open transaction has to read through the writer,
+        // or it would not see what it wrote (such as a new Entity's row).
+        //
+        const ReadConnections &connections = in_transaction ?
+            transaction_read_connections : read_connections;
+        ReadConnections &idle_connections = in_transaction ?
+            idle_transaction_read_connections : idle_read_connections;
+        boost::unique_lock<boost::mutex> lock(read_connections_mutex);
+
+        // Only wait if there's something to wait for; a closed pool won't
+        // have any connections come back.
+        //
+        while (idle_connections.empty() and (not connections.empty()))
         {
-            LOG(error, "sqliteinterface", "insert_program_reg",
-                "Could not insert Program registration: "
-                + std::string(sqlite3_errstr(rc)));
+            read_connections_cond.wait(lock);
+        }
 
-            result = false;
+        if (idle_connections.empty())
+        {
+            return 0;
         }
 
-        reset(insert_program_reg_stmt);
+        SqliteReadConnection * const connection_ptr =
+            idle_connections.back();
+        idle_connections.pop_back();
 
-        return result;
+        return connection_ptr;
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::bind_entity_update_params(
-        dbtype::Entity *entity_ptr,
-        concurrency::WriterLockToken &token,
-        sqlite3_stmt *stmt)
+    void SqliteBackend::release_read_connection(
+        SqliteReadConnection *connection_ptr)
     {
-        bool success = entity_ptr;
-
-        if (success)
+        if (connection_ptr)
         {
-            utility::MemoryBuffer buffer;
-            const std::string name = entity_ptr->get_entity_name(token);
-            char *data_ptr = 0;
-            size_t data_size = 0;
-            success = serialize_entity(entity_ptr, buffer) and
-                      buffer.get_data(data_ptr, data_size);
-
-            if (not success)
             {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "Could not serialize entity!");
-            }
-
-            if (sqlite3_bind_int64(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$OWNER"),
-                entity_ptr->get_entity_owner(token).get_entity_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "For statement, could not bind $OWNER");
-            }
-
-            if (sqlite3_bind_int(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$TYPE"),
-                entity_ptr->get_entity_type()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "For statement, could not bind $TYPE");
-            }
-
-            if (sqlite3_bind_text(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$NAME"),
-                name.c_str(),
-                name.size(),
-                SQLITE_TRANSIENT) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "For statement, could not bind $NAME");
-            }
+                boost::lock_guard<boost::mutex> guard(read_connections_mutex);
 
-            if (sqlite3_bind_int(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$SITEID"),
-                entity_ptr->get_entity_id().get_site_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "For statement, could not bind $SITEID");
-            }
-
-            if (sqlite3_bind_int64(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
-                entity_ptr->get_entity_id().get_entity_id()) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "For statement, could not bind $ENTITYID");
+                if (std::find(
+                        transaction_read_connections.begin(),
+                        transaction_read_connections.end(),
+                        connection_ptr) != transaction_read_connections.end())
+                {
+                    idle_transaction_read_connections.push_back(
+                        connection_ptr);
+                }
+                else
+                {
+                    idle_read_connections.push_back(connection_ptr);
+                }
             }
 
-            if (sqlite3_bind_blob(
-                stmt,
-                sqlite3_bind_parameter_index(stmt, "$DATA"),
-                data_ptr,
-                data_size,
-                SQLITE_TRANSIENT) != SQLITE_OK)
-            {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
-                    "For statement, could not bind $DATA");
-            }
+            // Waiters may be after either kind of connection.
+            read_connections_cond.notify_all();
         }
-
-        return success;
-
     }
 
     // ----------------------------------------------------------------------
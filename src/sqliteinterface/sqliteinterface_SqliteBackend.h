@@ -5,14 +5,28 @@
 #ifndef MUTGOS_SQLITEINTERFACE_SQLITEBACKEND_H
 #define MUTGOS_SQLITEINTERFACE_SQLITEBACKEND_H
 
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <string>
 #include <sqlite3.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic/atomic.hpp>
 
 #include "dbinterface/dbinterface_DbBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteReadConnection.h"
 
 #include "concurrency/concurrency_WriterLockToken.h"
 
 #include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_PropertyEntity.h"
+#include "dbtypes/dbtype_Program.h"
+#include "dbtypes/dbtype_ApplicationProperties.h"
+#include "dbtypes/dbtype_ApplicationPropertiesLoader.h"
+#include "dbtypes/dbtype_ProgramCodeLoader.h"
 
 namespace mutgos
 {
@@ -20,14 +34,72 @@ namespace sqliteinterface
 {
     /**
      * Implements a DbBackend that uses SQLite.
+     *
+     * All writes go through a single writer connection, serialized by a
+     * mutex.  Reads (Entity loads, searches, metadata, etc) use a pool of
+     * read-only connections, so they may run in parallel with each other
+     * and with the writer.  Since the database is in WAL mode, readers
+     * will not see changes from a transaction that is still open.
+     *
+     * The application properties of each PropertyEntity are stored in
+     * their own table, one row per application.  Only applications that
+     * changed are written, and they are loaded from the table the first
+     * time they are accessed.  The compiled code of each Program is
+     * likewise kept in its own table, written only when it changes and
+     * loaded only when the code is about to be run.
+     *
+     * Substring name searches use an FTS5 trigram index of Entity names
+     * (requires SQLite built with FTS5), kept current by triggers on the
+     * entities table.  Entity IDs must fit in 32 bits to be indexed.
+     *
+     * Every ID reference between Entities is also kept in a table, so
+     * reverse references and containment can be found without loading
+     * anything.  It is filled in from the Entities the first time a
+     * database without it is opened.
+     *
+     * Access statistics (last accessed time and count) are kept in their
+     * own small table and applied to an Entity as it is loaded, so reading
+     * an Entity never causes its data to be rewritten.
+     *
+     * Online backups use the SQLite backup API on the writer connection,
+     * so writes made during the backup are carried into it.  The backup
+     * runs on its own thread, copying a few pages at a time between
+     * transactions and pausing in between, so the writer is never held
+     * up for long.
+     *
+     * A bulk load runs entirely in one transaction on the writer
+     * connection.  The secondary indexes and the name index are dropped
+     * at the start and rebuilt once at the end, and the read connections
+     * are switched over to the writer connection so reads still see the
+     * uncommitted Entities.  Substring name searches will not find
+     * anything loaded until the bulk load ends.
+     *
+     * Visiting a site's Entities (used when writing a dump) reads them a
+     * page at a time in Entity ID order, resuming after the last ID seen,
+     * so no statement or read connection is held between pages.
+     *
+     * New Entity IDs are handed out from blocks reserved for each site in
+     * memory, so creating an Entity does not normally touch the id_reuse
+     * or next_id tables.  A block is reserved by removing deleted IDs from
+     * id_reuse, or by advancing next_id past a range of fresh IDs, in the
+     * same way a single ID used to be; the reservation is written before
+     * any Entity using the block, so an unclean shutdown can only lose
+     * unused IDs, never hand one out twice.  Unused IDs are given back on a
+     * clean shutdown.
      */
-    class SqliteBackend : public dbinterface::DbBackend
+    class SqliteBackend : public dbinterface::DbBackend,
+        public dbtype::ApplicationPropertiesLoader,
+        public dbtype::ProgramCodeLoader
     {
     public:
         /**
          * Constructor.
+         * @param file[in] The database file to use, including the path, or
+         * empty for the configured one.  Used when sites are kept in
+         * several files.
+         * @see SqliteShardedBackend
          */
-        SqliteBackend(void);
+        SqliteBackend(const std::string &file = std::string());
 
         /**
          * Destructor.
@@ -97,6 +169,21 @@ namespace sqliteinterface
          */
         virtual dbtype::Entity *get_entity_db(const dbtype::Id &id);
 
+        /**
+         * Gets several Entities from the database.  Entities already present
+         * in memory are returned as-is, and the rest are loaded using as
+         * few queries as possible.
+         * Caller must manage the pointers and delete them with
+         * delete_entity_mem().
+         * @param ids[in] The IDs of the Entities to retrieve.
+         * @param entities[out] The Entities retrieved, one per ID and in the
+         * same order as ids.  An Entity not found will be null.  Any
+         * existing contents are replaced.
+         */
+        virtual void get_entities_db(
+            const dbtype::Entity::IdVector &ids,
+            EntityPtrVector &entities);
+
         /**
          * Determines if the given entity ID exists in the database.
          * @param id[in] The ID to check.
@@ -119,6 +206,117 @@ namespace sqliteinterface
          */
         virtual bool save_entity_db(dbtype::Entity *entity_ptr);
 
+        /**
+         * Saves a batch of Entities to the database.  Every Entity is
+         * serialized first, then the database lock is held once to write
+         * them all.
+         * @param entities[in] The Entities to save.
+         * @param failed_ids[out] The IDs of any Entities that could not be
+         * saved will be appended to this.
+         * @return True if all Entities were saved, false if any failed.
+         */
+        virtual bool save_entities_db(
+            const EntityPtrVector &entities,
+            dbtype::Entity::IdVector &failed_ids);
+
+        /**
+         * Starts a transaction.  Until commit_transaction_db() is called,
+         * all modifications to the database made by the calling thread are
+         * grouped together into a single SQLite transaction.  The SQLite
+         * transaction only begins with the calling thread's first write,
+         * and save_entities_db() serializes before writing, so it stays
+         * open only while rows are being written.  While it is open,
+         * other threads (besides those that join_transaction()) wait to
+         * modify the database, so a failed commit never rolls back what
+         * they were told succeeded.
+         * If another thread has a transaction open, this waits for it.
+         * @return True if the transaction was started, false if error or
+         * the calling thread already has one in progress.
+         */
+        virtual bool begin_transaction_db(void);
+
+        /**
+         * Commits the transaction started with begin_transaction_db().
+         * If the commit fails, the transaction is rolled back.
+         * @return True if the transaction was committed, false if error
+         * (rolled back) or no transaction was open.
+         */
+        virtual bool commit_transaction_db(void);
+
+        /**
+         * Lets the calling thread write to the transaction the given
+         * thread has open, as if it were that thread, until the
+         * transaction is committed or rolled back.  This is for helper
+         * threads doing part of the work of a batch.
+         * @param thread_id[in] The thread whose transaction to join.
+         * @return True if joined, false if the given thread has no
+         * transaction open.
+         */
+        bool join_transaction(const boost::thread::id &thread_id);
+
+        /**
+         * @return True if the calling thread began the open transaction
+         * or has joined it.
+         */
+        bool in_transaction(void);
+
+        /**
+         * Rolls back the transaction started with begin_transaction_db(),
+         * or the bulk load started with begin_bulk_load_db().  Everything
+         * written since is discarded, except the rows of Entities the
+         * calling thread created in the meantime, which are still in use.
+         * @return True if the transaction was rolled back, false if error
+         * or no transaction was open.
+         */
+        bool rollback_transaction_db(void);
+
+        /**
+         * Starts a bulk load: opens a transaction that lasts until
+         * end_bulk_load_db(), drops the secondary indexes, and points the
+         * read connections at the writer.  Must be called while the
+         * database is otherwise idle.
+         * @return True if the bulk load was started, false if error or a
+         * transaction or bulk load is already open.
+         */
+        virtual bool begin_bulk_load_db(void);
+
+        /**
+         * Rebuilds the secondary indexes, commits the bulk load
+         * transaction, and reopens the normal read connections.
+         * If the indexes cannot be rebuilt, the partial rebuild is rolled
+         * back and the bulk load stays open, so this can be called again.
+         * @return True if success, false if error (rolled back) or no bulk
+         * load was in progress.
+         */
+        virtual bool end_bulk_load_db(void);
+
+        /**
+         * @return True if a bulk load is open, including one whose
+         * end_bulk_load_db() failed and can be retried.
+         */
+        bool bulk_load_in_progress(void);
+
+        /**
+         * Stops any running backup and waits for the backup thread to
+         * exit.  The partial backup is discarded.
+         */
+        void stop_backup(void);
+
+        /**
+         * Starts copying the database to a backup file on a background
+         * thread.  The backup is written to a temporary file and renamed
+         * to backup_file when complete.
+         * @param backup_file[in] The file to write the backup to.
+         * @return True if the backup was started, false if error or a
+         * backup is already running.
+         */
+        virtual bool start_backup_db(const std::string &backup_file);
+
+        /**
+         * @return The progress of the current or most recent backup.
+         */
+        virtual dbinterface::BackupStatus get_backup_status_db(void);
+
         /**
          * Deletes the given Entity from the database.  If the Entity is
          * currently in memory, deletion will fail.
@@ -134,6 +332,58 @@ namespace sqliteinterface
          */
         virtual dbtype::EntityType get_entity_type_db(const dbtype::Id &id);
 
+        /**
+         * Updates the reference index with the ID fields that changed on
+         * an Entity.
+         * @param source_id[in] The ID of the Entity whose fields changed.
+         * @param changed_fields[in] The IDs removed and added, per field.
+         * @return True if success.
+         */
+        virtual bool update_references_db(
+            const dbtype::Id &source_id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields);
+
+        /**
+         * Clears the marker update_references_db() leaves saying the
+         * reference index may be ahead of the saved Entities.  If the
+         * marker is still there when the database is next opened, the
+         * index is rebuilt from the Entities.
+         * @return True if success.
+         */
+        virtual bool references_saved_db(void);
+
+        /**
+         * Saves access statistics into their own table, apart from the
+         * Entity data.  Statistics for Entities no longer in the database
+         * are skipped.
+         * @param stats[in] The access statistics to save.
+         * @return True if success.
+         */
+        virtual bool save_access_stats_db(
+            const dbinterface::DbBackend::AccessStatsMap &stats);
+
+        /**
+         * Uses the reference index to find the Entities referencing an
+         * Entity by a particular field.
+         * @param target_id[in] The ID of the Entity being referenced.
+         * @param field[in] The field on the other Entities doing the
+         * referencing.
+         * @return The IDs of the Entities whose field references target_id,
+         * or empty if none or error.
+         */
+        virtual dbtype::Entity::IdVector get_references_to_db(
+            const dbtype::Id &target_id,
+            const dbtype::EntityField field);
+
+        /**
+         * Uses the reference index to find everything an Entity references.
+         * @param source_id[in] The ID of the Entity doing the referencing.
+         * @return A map of the referenced IDs to the fields on source_id
+         * that reference them, or empty if none or error.
+         */
+        virtual dbtype::Entity::IdFieldsMap get_references_from_db(
+            const dbtype::Id &source_id);
+
         /**
          * Searches for entities using the parameters specified that
          * contain the given string somewhere in their name, or an exact
@@ -164,6 +414,40 @@ namespace sqliteinterface
         virtual dbtype::Entity::IdVector find_in_db(
             const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * Calls the visitor with every Entity in a site, in Entity ID
+         * order.  Entities are read a page at a time and each is deleted
+         * right after it is visited, so only a page of the site is ever in
+         * memory.  The Entities are copies made from the database, even if
+         * they are also in memory.  No read connection is held while the
+         * visitor is running.
+         * @param site_id[in] The site whose Entities are to be visited.
+         * @param visitor[in] What to call for each Entity.
+         * @return True if every Entity was visited, false if error or the
+         * visitor stopped early.
+         */
+        virtual bool visit_site_entities_db(
+            const dbtype::Id::SiteIdType site_id,
+            dbinterface::EntityVisitor &visitor);
+
+        /**
+         * @param site_id[in] The site to check.
+         * @return True if the site has at least one Entity in the
+         * database.
+         */
+        bool site_has_entities_db(const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * Used to pick what to load into the cache at startup.
+         * @param site_id[in] The site to get Entity IDs for.
+         * @param max_entities[in] The most IDs to return.
+         * @return The IDs of the site's Entities, most recently accessed
+         * first (and then most accessed), up to max_entities.
+         */
+        virtual dbtype::Entity::IdVector get_recently_accessed_db(
+            const dbtype::Id::SiteIdType site_id,
+            const size_t max_entities);
+
         /**
          * Searches the given site for the program registration name.
          * @param site_id[in] The site ID to search for the program
@@ -218,6 +502,17 @@ namespace sqliteinterface
          */
         virtual bool new_site_in_db(dbtype::Id::SiteIdType &site_id);
 
+        /**
+         * Prepares this database to hold the Entities of a site whose ID
+         * was handed out elsewhere.  Any Entity data left over from a
+         * deleted site with the same ID is removed.  Nothing is added to
+         * the sites table.
+         * @param site_id[in] The ID of the site to add.
+         * @return True if success.
+         * @see SqliteShardedBackend
+         */
+        bool add_site_in_db(const dbtype::Id::SiteIdType site_id);
+
         /**
          * Deletes a site and all its entities in the database.  The site ID
          * will then be available for reuse.
@@ -267,7 +562,237 @@ namespace sqliteinterface
             const dbtype::Id::SiteIdType site_id,
             const std::string &site_description);
 
+        /**
+         * Loads an application's properties from the database.  Called
+         * by PropertyEntity the first time an application is accessed.
+         * @param entity_id[in] The ID of the PropertyEntity that owns the
+         * application.
+         * @param application[in] The name of the application to load.
+         * @param properties[out] The loaded application properties.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_application_properties(
+            const dbtype::Id &entity_id,
+            const std::string &application,
+            dbtype::ApplicationProperties &properties);
+
+        /**
+         * Loads a Program's compiled code from the database.  Called by
+         * Program the first time its compiled code is retrieved.
+         * @param program_id[in] The ID of the Program.
+         * @param compiled_code[out] The loaded compiled code.
+         * @return True if success, false if not found or error.
+         */
+        virtual bool load_compiled_code(
+            const dbtype::Id &program_id,
+            std::string &compiled_code);
+
     private:
+        /** How many Entities visit_site_entities_db() reads at a time */
+        static const size_t VISIT_PAGE_SIZE = 256;
+
+        /** How many Entity IDs are reserved for a site at a time */
+        static const size_t ID_BLOCK_SIZE = 128;
+
+        typedef std::vector<SqliteReadConnection *> ReadConnections;
+
+        /**
+         * Entity IDs reserved for a site, not yet given to an Entity.
+         */
+        struct SiteIdBlock
+        {
+            SiteIdBlock(void)
+              : reuse_checked(false),
+                next_fresh_id(0),
+                end_fresh_id(0)
+            {
+            }
+
+            std::deque<dbtype::Id::EntityIdType> reused_ids; ///< From id_reuse, lowest first
+            bool reuse_checked; ///< True if id_reuse had nothing more to reserve
+            dbtype::Id::EntityIdType next_fresh_id; ///< Next fresh ID to give out
+            dbtype::Id::EntityIdType end_fresh_id; ///< One past the last fresh ID reserved
+        };
+
+        /** Maps site ID to its reserved Entity IDs */
+        typedef std::map<dbtype::Id::SiteIdType, SiteIdBlock> SiteIdBlocks;
+
+        /** Maps an Entity ID to the names of some of its applications */
+        typedef std::map<dbtype::Id, dbtype::PropertyEntity::ApplicationNameSet>
+            EntityApplications;
+
+        /** The row first written for a new Entity */
+        struct NewEntityRow
+        {
+            dbtype::Id::EntityIdType owner; ///< Entity ID of the owner
+            dbtype::EntityType type; ///< Type of the Entity
+            dbtype::Entity::VersionType version; ///< Version of the Entity
+            std::string name; ///< Name of the Entity
+            std::string data; ///< The serialized Entity
+        };
+
+        /** Maps an Entity ID to the row first written for it */
+        typedef std::map<dbtype::Id, NewEntityRow> NewEntityRows;
+
+        /** Threads allowed to write to the open transaction */
+        typedef std::set<boost::thread::id> TransactionThreads;
+
+        /** An application of an Entity, serialized for saving */
+        struct ApplicationRow
+        {
+            std::string application; ///< Name of the application
+            bool removed; ///< True if the application's row is deleted
+            bool serialized; ///< False if it could not be serialized
+            std::string data; ///< The serialized application properties
+        };
+
+        /** The applications of an Entity to be saved */
+        typedef std::vector<ApplicationRow> ApplicationRows;
+
+        /** An Entity and what is saved along with it, serialized so it can
+            be written without the Entity locked */
+        struct EntitySaveRow
+        {
+            dbtype::Id id; ///< ID of the Entity
+            dbtype::Id::EntityIdType owner; ///< Entity ID of the owner
+            dbtype::EntityType type; ///< Type of the Entity
+            std::string name; ///< Name of the Entity
+            std::string data; ///< The serialized Entity
+            bool program; ///< True if the Entity is a Program
+            std::string program_reg_name; ///< Registration name of a Program
+            bool code_changed; ///< True if the compiled code is written
+            std::string code; ///< Compiled code, or empty to delete it
+            ApplicationRows applications; ///< Applications to write
+        };
+
+        /** Entities serialized for saving */
+        typedef std::vector<EntitySaveRow> EntitySaveRows;
+
+        /**
+         * Holds a read-only connection from the pool for the life of the
+         * instance, returning it when destructed.  If the pool is closed,
+         * holds the one on the writer connection instead.
+         */
+        class ReadConnectionGuard
+        {
+        public:
+            /**
+             * Waits until a read connection is available and takes it,
+             * or waits for the writer's if the pool is closed.
+             * @param backend[in] The backend whose pool to take from.
+             */
+            ReadConnectionGuard(SqliteBackend &backend);
+
+            /**
+             * Returns the connection to the pool.
+             */
+            ~ReadConnectionGuard();
+
+            /**
+             * @return The read connection being held.
+             */
+            SqliteReadConnection *operator->(void) const
+                { return connection_ptr; }
+
+            /**
+             * @return The read connection being held.
+             */
+            SqliteReadConnection &operator*(void) const
+                { return *connection_ptr; }
+
+        private:
+            SqliteBackend &pool_backend; ///< Where connection came from
+            SqliteReadConnection *connection_ptr; ///< The held connection
+            boost::unique_lock<boost::mutex> writer_lock; ///< Held if using the writer's
+        };
+
+        /**
+         * Writes the rows of Entities created while a transaction was open,
+         * after the transaction failed to commit and was rolled back.  The
+         * Entities are still in use, so without this they would have
+         * nothing in the database.  Their IDs are also taken out of the
+         * reuse table and skipped by the next fresh ID, since the
+         * reservations were rolled back too.
+         * Must be called with the mutex locked and no transaction open.
+         */
+        void restore_new_entities(void);
+
+        /**
+         * Called before every write.  If the calling thread is in the open
+         * transaction, begins it in SQLite if that has not been done yet.
+         * Otherwise waits until no other thread's transaction has begun,
+         * so the write does not become part of it.  Mutex must be locked
+         * before calling.
+         * @param lock[in] The lock held on the mutex.
+         */
+        void wait_for_transaction(boost::unique_lock<boost::mutex> &lock);
+
+        /**
+         * Runs BEGIN for the open transaction.  If that fails, the
+         * transaction is ended so the writes made for it go through on
+         * their own and its commit fails, which has the batch retried.
+         * Mutex must be locked before calling.
+         */
+        void begin_open_transaction(void);
+
+        /**
+         * Lets other threads write again once the open transaction has
+         * been committed or rolled back.  Mutex must be locked before
+         * calling.
+         */
+        void transaction_ended(void);
+
+        /**
+         * Cleans up after the open transaction was rolled back, so what
+         * was lost with it is saved again later.  Mutex must be locked
+         * before calling.
+         */
+        void transaction_rolled_back(void);
+
+        /**
+         * Opens the pool of read-only connections.  The writer connection
+         * must already be open and the tables created.
+         * @param use_writer[in] True to have the read connections share
+         * the writer connection rather than open the database themselves.
+         * @return True if success.
+         */
+        bool open_read_connections(const bool use_writer = false);
+
+        /**
+         * Waits until no read-only connection is in use, then closes and
+         * deletes them all.  Must not be called while holding one.
+         */
+        void close_read_connections(void);
+
+        /**
+         * Opens the read connections used by threads in the open
+         * transaction, which share the writer connection so they see what
+         * the transaction has written.  The writer connection must already
+         * be open and the tables created.
+         * @return True if success.
+         */
+        bool open_transaction_read_connections(void);
+
+        /**
+         * Closes and deletes the read connections opened by
+         * open_transaction_read_connections().
+         */
+        void close_transaction_read_connections(void);
+
+        /**
+         * Waits for a read-only connection to become available and
+         * removes it from the idle list.  A thread in the open transaction
+         * gets one that shares the writer connection.
+         * @return The read-only connection, or null if the pool is closed.
+         * Must be returned via release_read_connection().
+         */
+        SqliteReadConnection *acquire_read_connection(void);
+
+        /**
+         * Returns a read-only connection to the idle list.
+         * @param connection_ptr[in] The connection to return.
+         */
+        void release_read_connection(SqliteReadConnection *connection_ptr);
 
         /**
          * Creates the needed tables in the database if they do not already
@@ -276,6 +801,73 @@ namespace sqliteinterface
          */
         bool create_tables(void);
 
+        /**
+         * Fills in the reference index from the back-references stored in
+         * every Entity.  Used when opening a database that was created
+         * before the index existed, or whose index was left dirty.
+         * Assumes database is already opened and the tables created.
+         * @return True if success.
+         */
+        bool populate_reference_index(void);
+
+        /**
+         * If the reference index was left ahead of the saved Entities
+         * (the server stopped between the index being updated and the
+         * Entities being committed), rebuilds it from the Entities.
+         * Assumes database is already opened, the tables created, and no
+         * transaction is open.
+         * @return True if success.
+         */
+        bool check_reference_index(void);
+
+        /**
+         * Main loop of the backup thread.  Copies the database a few pages
+         * at a time until done, then finishes the backup and updates the
+         * status.
+         * @param backup_file[in] The final name of the backup file.
+         * @param temp_file[in] The file being written to.
+         * @param dest_handle_ptr[in] The open connection to temp_file.
+         * This will be closed.
+         * @param backup_ptr[in] The backup to run.  This will be finished.
+         */
+        void backup_thread_main(
+            const std::string backup_file,
+            const std::string temp_file,
+            sqlite3 *dest_handle_ptr,
+            sqlite3_backup *backup_ptr);
+
+        /**
+         * Sets the synchronous and WAL checkpoint settings to match the
+         * configured durability profile.
+         * @return True if success.
+         */
+        bool set_durability(void);
+
+        /**
+         * Binds the parameters of an insert or delete statement for
+         * a single row in the reference index.
+         * It is assumed the mutex has already been locked.
+         * @param stmt[in,out] The statement to bind to.
+         * @param target_id[in] The ID of the Entity being referenced.
+         * @param field[in] The field doing the referencing.
+         * @param source_id[in] The ID of the Entity doing the referencing.
+         * @return True if success.
+         */
+        bool bind_reference_params(
+            sqlite3_stmt *stmt,
+            const dbtype::Id &target_id,
+            const dbtype::EntityField field,
+            const dbtype::Id &source_id);
+
+        /**
+         * Deletes all references to and from an Entity in the reference
+         * index.
+         * It is assumed the mutex has already been locked.
+         * @param id[in] The ID of the Entity whose references are to be
+         * deleted.
+         */
+        void delete_entity_references(const dbtype::Id &id);
+
         /**
          * Creates prepared statements, does any other prep work after the
          * database has been opened.
@@ -284,15 +876,59 @@ namespace sqliteinterface
         bool sql_init(void);
 
         /**
-         * Gets the metadata for an Entity.  Assumes locking has already
-         * taken place.
+         * Gets the metadata for an Entity.
+         * @param connection[in] The read connection to use.
          * @param id[in] The ID of the Entity's metadata to get.
          * @param metadata[out] The Entity's metadata, or invalid if not found.
          */
          void get_metadata_internal(
+             SqliteReadConnection &connection,
              const dbtype::Id &id,
              dbinterface::EntityMetadata &metadata);
 
+        /**
+         * Takes the next reserved Entity ID for a site, reserving another
+         * block first if needed.  Reused IDs are given out before fresh
+         * ones.
+         * It is assumed the mutex has already been locked.
+         * @param site_id[in] The site to get an ID for.
+         * @return The Entity ID, or 0 if error.
+         */
+        dbtype::Id::EntityIdType take_entity_id(
+            const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * Reserves the lowest deleted IDs for a site, removing them from
+         * id_reuse.
+         * It is assumed the mutex has already been locked.
+         * @param site_id[in] The site to reserve IDs for.
+         * @param block[in,out] The site's reserved IDs, added to.
+         * @return True if success (even if there was nothing to reserve).
+         */
+        bool reserve_reused_ids(
+            const dbtype::Id::SiteIdType site_id,
+            SiteIdBlock &block);
+
+        /**
+         * Reserves a range of fresh IDs for a site, advancing next_id
+         * past it.
+         * It is assumed the mutex has already been locked.
+         * @param site_id[in] The site to reserve IDs for.
+         * @param block[in,out] The site's reserved IDs, updated.
+         * @return True if success.
+         */
+        bool reserve_fresh_ids(
+            const dbtype::Id::SiteIdType site_id,
+            SiteIdBlock &block);
+
+        /**
+         * Gives any unused reserved IDs back to id_reuse and next_id, so
+         * they are not lost.  Used on a clean shutdown.
+         * It is assumed the mutex has already been locked, and that no
+         * transaction is open.
+         */
+        void release_id_blocks(void);
+
         /**
          * Delete all entities and display name lookups for a site.
          * @param site_id[in] The site ID to delete.
@@ -300,6 +936,28 @@ namespace sqliteinterface
          */
         bool delete_site_entity_data(const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * Deserializes an Entity from the current row of a statement, and
+         * adds it to the Entities in memory.  If another thread has already
+         * added the Entity, that one is returned instead.
+         * @param result_stmt_ptr[in] A statement that has just returned a
+         * row containing the Entity type, immediately followed by the
+         * Entity data, the last accessed timestamp, and the access count.
+         * The access statistics come from their own table and may be NULL,
+         * in which case the ones in the Entity data are kept.
+         * @param type_column[in] The column of the Entity type.
+         * @param id[in] The ID of the Entity in the row.
+         * @param add_to_memory[in] If false, the Entity is not added to
+         * the Entities in memory and is always a new copy the caller must
+         * delete.
+         * @return The Entity, or null if error.
+         */
+        dbtype::Entity *make_entity_from_row(
+            sqlite3_stmt *result_stmt_ptr,
+            const int type_column,
+            const dbtype::Id &id,
+            const bool add_to_memory = true);
+
         /**
          * Given a statement with a result, add all IDs present to result.
          * @param result_stmt_ptr[in,out] A statement with parameters bound,
@@ -314,9 +972,44 @@ namespace sqliteinterface
             const dbtype::Id::SiteIdType site_id,
             dbtype::Entity::IdVector &result);
 
+        /**
+         * Serializes an Entity, and whatever is saved along with it, into
+         * a row that can be written by write_entity_row().  Clears the
+         * Entity's dirty information, since the row is what gets saved.
+         * The mutex must not be locked.
+         * @param entity_ptr[in] The Entity to serialize.
+         * @param retry_applications[in,out] Applications written in a
+         * transaction that failed to commit, to be written again.  The
+         * Entity's entry is removed if the Entity was serialized.
+         * @param retry_program_code[in,out] Programs whose compiled code was
+         * written in a transaction that failed to commit.  The Entity is
+         * removed if it was serialized.
+         * @param row[out] The serialized Entity.
+         * @return True if success.
+         */
+        bool serialize_entity_row(
+            dbtype::Entity *entity_ptr,
+            EntityApplications &retry_applications,
+            dbtype::Entity::IdSet &retry_program_code,
+            EntitySaveRow &row);
+
+        /**
+         * Writes an Entity serialized by serialize_entity_row(), along with
+         * its compiled code, program registration, and applications.
+         * Anything that could not be written is remembered so the next
+         * save of the Entity writes it again.
+         * It is assumed the mutex has already been locked.
+         * @param row[in] The serialized Entity.
+         * @return True if success.
+         */
+        bool write_entity_row(const EntitySaveRow &row);
+
         /**
          * Binds common parameters to a create/update entity type statement.
-         * Also serializes the Entity.
+         * Also serializes the Entity into entity_data_buffer, which is bound
+         * without copying; the statement must be reset before the next
+         * Entity is bound.
+         * It is assumed the mutex has already been locked.
          * @param entity_ptr[in] The Entity to be bound to the statement.
          * @param token[in] The lock token for entity_ptr.
          * @param stmt[in,out] The statement to bind to.
@@ -327,6 +1020,35 @@ namespace sqliteinterface
             concurrency::WriterLockToken &token,
             sqlite3_stmt *stmt);
 
+        /**
+         * Writes the serialized applications of an Entity to the
+         * application properties table, and deletes the rows of any that
+         * were removed.
+         * It is assumed the mutex has already been locked.
+         * @param row[in] The serialized Entity whose applications are to
+         * be saved.
+         * @return True if success.
+         */
+        bool write_application_rows(const EntitySaveRow &row);
+
+        /**
+         * Deletes all application properties for an Entity.
+         * It is assumed the mutex has already been locked.
+         * @param id[in] The ID of the Entity whose applications are to be
+         * deleted.
+         */
+        void delete_entity_applications(const dbtype::Id &id);
+
+        /**
+         * Writes the serialized compiled code of a Program to the program
+         * code table, or deletes its row if the compiled code was removed.
+         * It is assumed the mutex has already been locked.
+         * @param row[in] The serialized Program, whose compiled code
+         * changed.
+         * @return True if success.
+         */
+        bool write_program_code_row(const EntitySaveRow &row);
+
         /**
          * Deletes the program registration name in the fast lookup table.
          * It is safe to call this if ID is not a program or even if the
@@ -358,33 +1080,12 @@ namespace sqliteinterface
          */
         void reset(sqlite3_stmt *stmt_ptr);
 
-        sqlite3 *dbhandle_ptr; ///< SQLite handle data structure
-
-        // Searches
-        //
-        sqlite3_stmt *list_sites_stmt; ///< Lists all valid site IDs
-        sqlite3_stmt *list_deleted_sites_stmt; ///< Show all deleted sites
-        sqlite3_stmt *list_all_entities_site_stmt; ///< Show all entities in site
-
-        sqlite3_stmt *find_site_type_owner_name_exact_stmt;  ///< Find site, type, owner, exact name
-        sqlite3_stmt *find_site_type_owner_name_stmt;  ///< Find site, type, owner, partial name
-        sqlite3_stmt *find_site_type_name_exact_stmt; ///< Find site, type, exact name
-        sqlite3_stmt *find_site_type_name_stmt; ///< Find site, type, partial name
-        sqlite3_stmt *find_site_owner_type_stmt;  ///< Find site, owner, type
-
-        sqlite3_stmt *find_site_owner_name_stmt;  ///< Find site, owner, partial name
-        sqlite3_stmt *find_site_owner_stmt;  ///< Find site, owner
-        sqlite3_stmt *find_site_name_stmt;  ///< Find site, partial name
-
-        sqlite3_stmt *get_entity_type_stmt; ///< Gets the type for an Entity
-        sqlite3_stmt *get_site_name_stmt; ///< Gets a site's name.
-        sqlite3_stmt *get_site_description_stmt; ///< Gets a site's description.
-        sqlite3_stmt *find_program_reg_stmt; ///< Find a program by registration name
-        sqlite3_stmt *find_program_reg_id_stmt; ///< Find a program by registration by ID
-        sqlite3_stmt *entity_exists_stmt; ///< Determine if an Entity exists
+        std::string database_file; ///< The database file, including path
+        sqlite3 *dbhandle_ptr; ///< SQLite handle data structure (writer)
 
         // Create, edit, delete sites
         //
+        sqlite3_stmt *list_deleted_sites_stmt; ///< Show all deleted sites
         sqlite3_stmt *undelete_site_stmt; ///< Update deleted site to be active
         sqlite3_stmt *next_site_id_stmt; ///< Get next new site id
         sqlite3_stmt *insert_first_next_site_id_stmt; ///< Insert first site ID
@@ -393,19 +1094,26 @@ namespace sqliteinterface
         sqlite3_stmt *insert_first_site_entity_id_stmt; ///< Insert first entity ID for site
         sqlite3_stmt *delete_site_entities_stmt; ///< Delete all entities of a site
         sqlite3_stmt *delete_site_display_names_stmt; ///< Delete site's display names
+        sqlite3_stmt *delete_site_applications_stmt; ///< Delete site's application properties
+        sqlite3_stmt *delete_site_references_stmt; ///< Delete site's reference index entries
         sqlite3_stmt *set_site_name_stmt; ///< Sets a new name for a site.
         sqlite3_stmt *set_site_description_stmt; ///< Sets a new description for a site.
 
         // Update and load entity
         //
         sqlite3_stmt *update_entity_stmt; ///< Updates Entity data, including blob
-        sqlite3_stmt *get_entity_stmt; ///< Gets the blob data for an Entity
-        sqlite3_stmt *get_entity_metadata_stmt; ///< Gets the entity's metadata
+        sqlite3_stmt *save_application_stmt; ///< Inserts or updates an application
+        sqlite3_stmt *delete_application_stmt; ///< Deletes an application
+        sqlite3_stmt *save_program_code_stmt; ///< Inserts or updates compiled code
+        sqlite3_stmt *delete_program_code_stmt; ///< Deletes compiled code
+        sqlite3_stmt *insert_reference_stmt; ///< Adds a reference index entry
+        sqlite3_stmt *delete_reference_stmt; ///< Deletes a reference index entry
+        sqlite3_stmt *save_access_stmt; ///< Inserts or updates access statistics
 
         // New entity
         //
-        sqlite3_stmt *get_next_deleted_entity_id_stmt; ///< Get next deleted ent ID
-        sqlite3_stmt *mark_deleted_id_used_stmt; ///< Mark a reused ent ID as used
+        sqlite3_stmt *get_deleted_entity_ids_stmt; ///< Get a block of deleted ent IDs
+        sqlite3_stmt *mark_deleted_ids_used_stmt; ///< Mark a block of reused ent IDs as used
         sqlite3_stmt *get_next_entity_id_stmt; ///< Get next fresh entity ID
         sqlite3_stmt *update_next_entity_id_stmt; ///< Update next entity ID counter
         sqlite3_stmt *add_entity_stmt; ///< Inserts complete new entity
@@ -414,6 +1122,9 @@ namespace sqliteinterface
         //
         sqlite3_stmt *delete_entity_stmt; ///< Deletes entity
         sqlite3_stmt *add_reuse_entity_id_stmt; ///< Adds entity ID to reuse table
+        sqlite3_stmt *delete_reuse_entity_id_stmt; ///< Removes entity ID from reuse table
+        sqlite3_stmt *delete_entity_applications_stmt; ///< Deletes entity's applications
+        sqlite3_stmt *delete_entity_references_stmt; ///< Deletes entity's reference index entries
 
         // Delete site
         //
@@ -425,7 +1136,42 @@ namespace sqliteinterface
         sqlite3_stmt *insert_program_reg_stmt; // Adds a new program registration entry
         sqlite3_stmt *delete_program_reg_stmt; // Deletes an existing program registration entry
 
-        boost::mutex mutex; ///< Enforces single access at a time.
+        // Transactions
+        //
+        sqlite3_stmt *begin_transaction_stmt; ///< Starts a transaction
+        sqlite3_stmt *commit_transaction_stmt; ///< Commits a transaction
+        sqlite3_stmt *rollback_transaction_stmt; ///< Rolls back a transaction
+
+        bool transaction_open; ///< True if begin_transaction_db() is active
+        bool transaction_begun; ///< True once BEGIN has run for the open transaction
+        TransactionThreads transaction_threads; ///< Who may write to open transaction
+        boost::mutex transaction_threads_mutex; ///< Also held to change transaction_threads, so readers need only this
+        boost::condition_variable transaction_cond; ///< Signals begun transaction over
+        bool bulk_load_open; ///< True if begin_bulk_load_db() is active
+        bool references_dirty; ///< True if reference index marked dirty
+        std::string entity_data_buffer; ///< Reused to serialize Entities
+        EntityApplications transaction_applications; ///< Apps written in open transaction
+        EntityApplications unsaved_applications; ///< Apps lost to a failed commit
+        dbtype::Entity::IdSet transaction_program_code; ///< Code written in open transaction
+        dbtype::Entity::IdSet unsaved_program_code; ///< Code lost to a failed commit
+        NewEntityRows transaction_new_entities; ///< Created in open transaction
+        SiteIdBlocks site_id_blocks; ///< Entity IDs reserved for new Entities
+
+        boost::mutex mutex; ///< Enforces single access at a time to writer.
+
+        ReadConnections read_connections; ///< All read-only connections
+        ReadConnections idle_read_connections; ///< Read connections not in use
+        ReadConnections transaction_read_connections; ///< Read connections on the writer
+        ReadConnections idle_transaction_read_connections; ///< Those not in use
+        boost::mutex read_connections_mutex; ///< For idle_read_connections
+        boost::condition_variable read_connections_cond; ///< Signals idle
+        SqliteReadConnection writer_read_connection; ///< On the writer, for when pool is closed
+        boost::mutex writer_read_mutex; ///< Held while using writer_read_connection
+
+        boost::mutex backup_mutex; ///< Protects the backup status and thread
+        boost::thread *backup_thread_ptr; ///< Non-null if a backup has run
+        boost::atomic<bool> backup_cancel; ///< True to stop the backup early
+        dbinterface::BackupStatus backup_status; ///< Current or last backup
     };
 }
 }
@@ -0,0 +1,662 @@
+/*
+ * sqliteinterface_SqliteReadConnection.cpp
+ */
+
+#include <string>
+#include <sqlite3.h>
+
+#include "sqliteinterface/sqliteinterface_SqliteReadConnection.h"
+
+#include "logging/log_Logger.h"
+
+namespace
+{
+    /** How long to wait, in milliseconds, if the database is locked */
+    const int READ_BUSY_TIMEOUT_MS = 5000;
+}
+
+namespace mutgos
+{
+namespace sqliteinterface
+{
+    // Statics
+    //
+    const int SqliteReadConnection::GET_ENTITIES_BATCH_SIZE;
+
+    // ----------------------------------------------------------------------
+    SqliteReadConnection::SqliteReadConnection(void)
+      : list_sites_stmt(0),
+        list_all_entities_site_stmt(0),
+        find_site_type_owner_name_exact_stmt(0),
+        find_site_type_owner_name_stmt(0),
+        find_site_type_name_exact_stmt(0),
+        find_site_type_name_stmt(0),
+        find_site_owner_type_stmt(0),
+        find_site_owner_name_stmt(0),
+        find_site_owner_stmt(0),
+        find_site_name_stmt(0),
+        get_entity_type_stmt(0),
+        get_site_name_stmt(0),
+        get_site_description_stmt(0),
+        find_program_reg_stmt(0),
+        find_program_reg_id_stmt(0),
+        entity_exists_stmt(0),
+        site_has_entities_stmt(0),
+        get_entity_stmt(0),
+        list_site_entities_stmt(0),
+        list_recently_accessed_stmt(0),
+        get_entities_stmt(0),
+        get_entity_metadata_stmt(0),
+        get_application_stmt(0),
+        get_program_code_stmt(0),
+        get_references_to_stmt(0),
+        get_references_from_stmt(0),
+        dbhandle_ptr(0),
+        handle_shared(false)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    SqliteReadConnection::~SqliteReadConnection()
+    {
+        close();
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteReadConnection::open(const std::string &db_file)
+    {
+        bool success = not dbhandle_ptr;
+
+        if (success)
+        {
+            // NOMUTEX is safe because SqliteBackend guarantees only one
+            // thread uses this connection at a time.
+            //
+            const int rc = sqlite3_open_v2(
+                db_file.c_str(),
+                &dbhandle_ptr,
+                SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                0);
+            success = (rc == SQLITE_OK);
+
+            if (success)
+            {
+                success = (sqlite3_busy_timeout(
+                    dbhandle_ptr,
+                    READ_BUSY_TIMEOUT_MS) == SQLITE_OK) and
+                    (sqlite3_exec(
+                        dbhandle_ptr,
+                        "PRAGMA main.CACHE_SIZE=4000;",
+                        0,
+                        0,
+                        0) == SQLITE_OK)
+                    and sql_init();
+
+                if (not success)
+                {
+                    LOG(fatal, "sqliteinterface", "open",
+                        "Unable to configure read connection.");
+                }
+            }
+            else
+            {
+                LOG(fatal, "sqliteinterface", "open",
+                    "Unable to open read connection: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
+
+            if (not success)
+            {
+                close();
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteReadConnection::open(sqlite3 *shared_handle_ptr)
+    {
+        bool success = (not dbhandle_ptr) and shared_handle_ptr;
+
+        if (success)
+        {
+            dbhandle_ptr = shared_handle_ptr;
+            handle_shared = true;
+
+            success = sql_init();
+
+            if (not success)
+            {
+                LOG(fatal, "sqliteinterface", "open",
+                    "Unable to configure shared read connection.");
+
+                close();
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteReadConnection::close(void)
+    {
+        bool success = true;
+
+        if (dbhandle_ptr)
+        {
+            sql_finalize();
+
+            if (handle_shared)
+            {
+                // Not ours to close.
+                dbhandle_ptr = 0;
+                handle_shared = false;
+            }
+            else
+            {
+                success = (sqlite3_close(dbhandle_ptr) == SQLITE_OK);
+
+                if (success)
+                {
+                    dbhandle_ptr = 0;
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteReadConnection::sql_init(void)
+    {
+        bool success = true;
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT site_id FROM sites WHERE deleted = 0;",
+            -1,
+            &list_sites_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for finding valid sites.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID;",
+            -1,
+            &list_all_entities_site_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing all of site's entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "type = $TYPE AND owner = $OWNER AND "
+            "name = $NAME;",
+            -1,
+            &find_site_type_owner_name_exact_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by site, "
+                "type, owner, and exact name");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "type = $TYPE AND owner = $OWNER AND "
+            "entity_id IN ("
+            "SELECT rowid - ($SITEID << 32) FROM entity_names WHERE "
+            "name LIKE '%' || $NAME || '%' AND "
+            "rowid BETWEEN ($SITEID << 32) AND ($SITEID << 32) + 4294967295);",
+            -1,
+            &find_site_type_owner_name_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by site, "
+                "type, owner, and name");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "owner = $OWNER AND type = $TYPE;",
+            -1,
+            &find_site_owner_type_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by site, "
+                "owner, and type");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "owner = $OWNER AND "
+            "entity_id IN ("
+            "SELECT rowid - ($SITEID << 32) FROM entity_names WHERE "
+            "name LIKE '%' || $NAME || '%' AND "
+            "rowid BETWEEN ($SITEID << 32) AND ($SITEID << 32) + 4294967295);",
+            -1,
+            &find_site_owner_name_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by site, "
+                "owner, and name");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "owner = $OWNER",
+            -1,
+            &find_site_owner_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by site "
+                "and owner");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "entity_id IN ("
+            "SELECT rowid - ($SITEID << 32) FROM entity_names WHERE "
+            "name LIKE '%' || $NAME || '%' AND "
+            "rowid BETWEEN ($SITEID << 32) AND ($SITEID << 32) + 4294967295);",
+            -1,
+            &find_site_name_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by name.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+            "type = $TYPE AND entity_id IN ("
+            "SELECT rowid - ($SITEID << 32) FROM entity_names WHERE "
+            "name LIKE '%' || $NAME || '%' AND "
+            "rowid BETWEEN ($SITEID << 32) AND ($SITEID << 32) + 4294967295);",
+            -1,
+            &find_site_type_name_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by name and type.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+                "name = $NAME AND type = $TYPE;",
+            -1,
+            &find_site_type_name_exact_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing entity by exact "
+                    "name and type.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT type FROM entities WHERE site_id = $SITEID "
+            "and entity_id = $ENTITYID;",
+            -1,
+            &get_entity_type_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting an Entity type.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT site_name FROM sites WHERE site_id = $SITEID;",
+            -1,
+            &get_site_name_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting a Site's name.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT site_description FROM sites WHERE site_id = $SITEID;",
+            -1,
+            &get_site_description_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting a Site's description.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM program_registrations WHERE "
+              "site_id = $SITEID AND registration_name = $REGNAME;",
+            -1,
+            &find_program_reg_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for finding a program registration.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT registration_name FROM program_registrations WHERE "
+            "site_id = $SITEID AND entity_id = $ENTITYID;",
+            -1,
+            &find_program_reg_id_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for finding a program registration by ID.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT type FROM entities WHERE site_id = $SITEID "
+            "and entity_id = $ENTITYID;",
+            -1,
+            &entity_exists_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for checking Entity existence.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID LIMIT 1;",
+            -1,
+            &site_has_entities_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for checking if a site has "
+                "Entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT e.type, e.data, a.accessed_timestamp, a.access_count "
+                "FROM entities e LEFT JOIN entity_access a "
+                "ON a.site_id = e.site_id AND a.entity_id = e.entity_id "
+                "WHERE e.site_id = $SITEID and e.entity_id = $ENTITYID;",
+            -1,
+            &get_entity_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting an Entity.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT e.entity_id, e.type, e.data, a.accessed_timestamp, "
+                "a.access_count FROM entities e LEFT JOIN entity_access a "
+                "ON a.site_id = e.site_id AND a.entity_id = e.entity_id "
+                "WHERE e.site_id = $SITEID and e.entity_id > $AFTERID "
+                "ORDER BY e.entity_id LIMIT $LIMIT;",
+            -1,
+            &list_site_entities_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing a site's Entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT entity_id FROM entity_access WHERE site_id = $SITEID "
+                "ORDER BY accessed_timestamp DESC, access_count DESC "
+                "LIMIT $LIMIT;",
+            -1,
+            &list_recently_accessed_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for listing recently accessed "
+                "Entities.");
+        }
+
+        std::string get_entities_str =
+            "SELECT e.entity_id, e.type, e.data, a.accessed_timestamp, "
+            "a.access_count FROM entities e LEFT JOIN entity_access a "
+            "ON a.site_id = e.site_id AND a.entity_id = e.entity_id WHERE "
+            "e.site_id = $SITEID and e.entity_id IN (?";
+
+        for (int index = 1; index < GET_ENTITIES_BATCH_SIZE; ++index)
+        {
+            get_entities_str += ", ?";
+        }
+
+        get_entities_str += ");";
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            get_entities_str.c_str(),
+            -1,
+            &get_entities_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting several Entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT owner, type, version, name FROM entities WHERE "
+            "site_id = $SITEID and entity_id = $ENTITYID;",
+            -1,
+            &get_entity_metadata_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting an Entity metadata.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT data FROM application_properties WHERE "
+            "site_id = $SITEID and entity_id = $ENTITYID and "
+            "application = $APPLICATION;",
+            -1,
+            &get_application_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting application properties.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT data FROM program_code WHERE "
+            "site_id = $SITEID and entity_id = $ENTITYID;",
+            -1,
+            &get_program_code_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting program code.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT source_site_id, source_entity_id FROM entity_references "
+            "WHERE site_id = $SITEID and entity_id = $ENTITYID and "
+            "field = $FIELD;",
+            -1,
+            &get_references_to_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting references to an Entity.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "SELECT site_id, entity_id, field FROM entity_references "
+            "WHERE source_site_id = $SITEID and source_entity_id = $ENTITYID;",
+            -1,
+            &get_references_from_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for getting references from an Entity.");
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteReadConnection::sql_finalize(void)
+    {
+        sqlite3_finalize(list_sites_stmt);
+        list_sites_stmt = 0;
+
+        sqlite3_finalize(list_all_entities_site_stmt);
+        list_all_entities_site_stmt = 0;
+
+        sqlite3_finalize(find_site_type_owner_name_exact_stmt);
+        find_site_type_owner_name_exact_stmt = 0;
+
+        sqlite3_finalize(find_site_type_owner_name_stmt);
+        find_site_type_owner_name_stmt = 0;
+
+        sqlite3_finalize(find_site_type_name_exact_stmt);
+        find_site_type_name_exact_stmt = 0;
+
+        sqlite3_finalize(find_site_type_name_stmt);
+        find_site_type_name_stmt = 0;
+
+        sqlite3_finalize(find_site_owner_type_stmt);
+        find_site_owner_type_stmt = 0;
+
+        sqlite3_finalize(find_site_owner_name_stmt);
+        find_site_owner_name_stmt = 0;
+
+        sqlite3_finalize(find_site_owner_stmt);
+        find_site_owner_stmt = 0;
+
+        sqlite3_finalize(find_site_name_stmt);
+        find_site_name_stmt = 0;
+
+        sqlite3_finalize(get_entity_type_stmt);
+        get_entity_type_stmt = 0;
+
+        sqlite3_finalize(get_site_name_stmt);
+        get_site_name_stmt = 0;
+
+        sqlite3_finalize(get_site_description_stmt);
+        get_site_description_stmt = 0;
+
+        sqlite3_finalize(find_program_reg_stmt);
+        find_program_reg_stmt = 0;
+
+        sqlite3_finalize(find_program_reg_id_stmt);
+        find_program_reg_id_stmt = 0;
+
+        sqlite3_finalize(entity_exists_stmt);
+        entity_exists_stmt = 0;
+
+        sqlite3_finalize(site_has_entities_stmt);
+        site_has_entities_stmt = 0;
+
+        sqlite3_finalize(get_entity_stmt);
+        get_entity_stmt = 0;
+
+        sqlite3_finalize(list_site_entities_stmt);
+        list_site_entities_stmt = 0;
+
+        sqlite3_finalize(list_recently_accessed_stmt);
+        list_recently_accessed_stmt = 0;
+
+        sqlite3_finalize(get_entities_stmt);
+        get_entities_stmt = 0;
+
+        sqlite3_finalize(get_entity_metadata_stmt);
+        get_entity_metadata_stmt = 0;
+
+        sqlite3_finalize(get_application_stmt);
+        get_application_stmt = 0;
+
+        sqlite3_finalize(get_program_code_stmt);
+        get_program_code_stmt = 0;
+
+        sqlite3_finalize(get_references_to_stmt);
+        get_references_to_stmt = 0;
+
+        sqlite3_finalize(get_references_from_stmt);
+        get_references_from_stmt = 0;
+    }
+}
+}
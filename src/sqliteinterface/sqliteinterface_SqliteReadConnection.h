@@ -0,0 +1,118 @@
+/*
+ * sqliteinterface_SqliteReadConnection.h
+ */
+
+#ifndef MUTGOS_SQLITEINTERFACE_SQLITEREADCONNECTION_H
+#define MUTGOS_SQLITEINTERFACE_SQLITEREADCONNECTION_H
+
+#include <string>
+#include <sqlite3.h>
+
+namespace mutgos
+{
+namespace sqliteinterface
+{
+    /**
+     * A single read-only connection to the SQLite database, along with
+     * its own copy of every prepared statement used for reading.
+     * SqliteBackend keeps a pool of these so Entity loads and searches
+     * can run in parallel (the database is in WAL mode, so readers never
+     * block the writer or each other).
+     *
+     * This class is not thread safe; only one thread at a time may use
+     * an instance.  The statements are public since this is simply a
+     * holder used internally by SqliteBackend, which manages all access.
+     */
+    class SqliteReadConnection
+    {
+    public:
+        /** How many Entities get_entities_stmt can load at once */
+        static const int GET_ENTITIES_BATCH_SIZE = 16;
+
+        /**
+         * Constructor.  Does not open the connection.
+         */
+        SqliteReadConnection(void);
+
+        /**
+         * Destructor.  Closes the connection if open.
+         */
+        ~SqliteReadConnection();
+
+        /**
+         * Opens the database read-only and prepares all statements.
+         * The database must already exist with all tables created.
+         * @param db_file[in] The database file to open.
+         * @return True if success.
+         */
+        bool open(const std::string &db_file);
+
+        /**
+         * Prepares all statements on a connection owned by someone else,
+         * typically the writer connection.  Reads will then see changes
+         * in the writer's open transaction.  The connection is not closed
+         * by close().
+         * @param shared_handle_ptr[in] The already open connection to use.
+         * @return True if success.
+         */
+        bool open(sqlite3 *shared_handle_ptr);
+
+        /**
+         * Finalizes all statements and closes the connection, if owned.
+         * @return True if success or not open.
+         */
+        bool close(void);
+
+        // Searches
+        //
+        sqlite3_stmt *list_sites_stmt; ///< Lists all valid site IDs
+        sqlite3_stmt *list_all_entities_site_stmt; ///< Show all entities in site
+        sqlite3_stmt *find_site_type_owner_name_exact_stmt;  ///< Find site, type, owner, exact name
+        sqlite3_stmt *find_site_type_owner_name_stmt;  ///< Find site, type, owner, partial name
+        sqlite3_stmt *find_site_type_name_exact_stmt; ///< Find site, type, exact name
+        sqlite3_stmt *find_site_type_name_stmt; ///< Find site, type, partial name
+        sqlite3_stmt *find_site_owner_type_stmt;  ///< Find site, owner, type
+        sqlite3_stmt *find_site_owner_name_stmt;  ///< Find site, owner, partial name
+        sqlite3_stmt *find_site_owner_stmt;  ///< Find site, owner
+        sqlite3_stmt *find_site_name_stmt;  ///< Find site, partial name
+        sqlite3_stmt *get_entity_type_stmt; ///< Gets the type for an Entity
+        sqlite3_stmt *get_site_name_stmt; ///< Gets a site's name.
+        sqlite3_stmt *get_site_description_stmt; ///< Gets a site's description.
+        sqlite3_stmt *find_program_reg_stmt; ///< Find a program by registration name
+        sqlite3_stmt *find_program_reg_id_stmt; ///< Find a program by registration by ID
+        sqlite3_stmt *entity_exists_stmt; ///< Determine if an Entity exists
+        sqlite3_stmt *site_has_entities_stmt; ///< Determine if a site has any Entities
+        sqlite3_stmt *get_entity_stmt; ///< Gets the blob data for an Entity
+        sqlite3_stmt *list_site_entities_stmt; ///< Gets the blob data for a page of a site's Entities, in ID order
+        sqlite3_stmt *list_recently_accessed_stmt; ///< Gets a site's Entity IDs, most recently accessed first
+        sqlite3_stmt *get_entities_stmt; ///< Gets the blob data for several Entities.  $SITEID is parameter 1, entity IDs are 2 onwards (bind NULL to unused)
+        sqlite3_stmt *get_entity_metadata_stmt; ///< Gets the entity's metadata
+        sqlite3_stmt *get_application_stmt; ///< Gets an application's properties
+        sqlite3_stmt *get_program_code_stmt; ///< Gets a Program's compiled code
+        sqlite3_stmt *get_references_to_stmt; ///< Gets who references an Entity via a field
+        sqlite3_stmt *get_references_from_stmt; ///< Gets what an Entity references
+
+    private:
+        /**
+         * Creates prepared statements after the database has been opened.
+         * @return True if success.
+         */
+        bool sql_init(void);
+
+        /**
+         * Finalizes and nulls out all prepared statements.
+         */
+        void sql_finalize(void);
+
+        sqlite3 *dbhandle_ptr; ///< SQLite handle data structure
+        bool handle_shared; ///< True if dbhandle_ptr is owned by someone else
+
+        // No copying
+        //
+        SqliteReadConnection(const SqliteReadConnection &rhs);
+        SqliteReadConnection &operator=(const SqliteReadConnection &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_SQLITEINTERFACE_SQLITEREADCONNECTION_H
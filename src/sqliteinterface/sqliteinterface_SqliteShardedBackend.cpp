@@ -0,0 +1,975 @@
+/*
+ * sqliteinterface_SqliteShardedBackend.cpp
+ */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+#include "utilities/mutgos_config.h"
+#include "text/text_StringConversion.h"
+
+#include "sqliteinterface/sqliteinterface_SqliteShardedBackend.h"
+#include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+
+#include "dbinterface/dbinterface_BackupStatus.h"
+#include "dbinterface/dbinterface_EntityMetadata.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+
+#include "logging/log_Logger.h"
+
+namespace mutgos
+{
+namespace sqliteinterface
+{
+    // ----------------------------------------------------------------------
+    SqliteShardedBackend::SqliteShardedBackend(const size_t shard_count)
+      : jobs_outstanding(0),
+        workers_stop(false)
+    {
+        const size_t count = shard_count ? shard_count : 1;
+
+        shards.reserve(count);
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            shards.push_back(new SqliteBackend(
+                config::db::db_file() + shard_suffix(index)));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    SqliteShardedBackend::~SqliteShardedBackend()
+    {
+        shutdown();
+
+        for (Shards::iterator shard_iter = shards.begin();
+            shard_iter != shards.end();
+            ++shard_iter)
+        {
+            delete *shard_iter;
+        }
+
+        shards.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::init(void)
+    {
+        LOG(info, "sqliteinterface", "init",
+            "Starting up with " + text::to_string(shards.size())
+            + " site files...");
+
+        bool success = catalog.init();
+
+        for (Shards::iterator shard_iter = shards.begin();
+            success and (shard_iter != shards.end());
+            ++shard_iter)
+        {
+            success = (*shard_iter)->init();
+        }
+
+        if (success)
+        {
+            // A database created without site files has the Entities in
+            // the catalog, where they would never be found.
+            //
+            const dbtype::Id::SiteIdVector site_ids =
+                catalog.get_site_ids_in_db();
+
+            for (dbtype::Id::SiteIdVector::const_iterator site_iter =
+                    site_ids.begin();
+                site_iter != site_ids.end();
+                ++site_iter)
+            {
+                if (catalog.site_has_entities_db(*site_iter))
+                {
+                    LOG(fatal, "sqliteinterface", "init",
+                        "Site " + text::to_string(*site_iter)
+                        + " has Entities in the main database file.  The "
+                          "database was not created with site files.");
+                    success = false;
+                    break;
+                }
+            }
+        }
+
+        if (success and (shards.size() > 1))
+        {
+            start_workers();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::shutdown(void)
+    {
+        stop_workers();
+
+        bool success = true;
+
+        for (Shards::iterator shard_iter = shards.begin();
+            shard_iter != shards.end();
+            ++shard_iter)
+        {
+            success = (*shard_iter)->shutdown() and success;
+        }
+
+        return catalog.shutdown() and success;
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SqliteShardedBackend::get_backend_name(void)
+    {
+        return "SQLite3 (" + text::to_string(shards.size())
+            + " site files)";
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::entity_mem_owned_by_this(
+        const dbtype::Entity *entity_ptr)
+    {
+        return entity_ptr and
+            shard_for_site(entity_ptr->get_entity_id().get_site_id()).
+                entity_mem_owned_by_this(entity_ptr);
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::delete_entity_mem(dbtype::Entity *entity_ptr)
+    {
+        if (entity_ptr)
+        {
+            shard_for_site(entity_ptr->get_entity_id().get_site_id()).
+                delete_entity_mem(entity_ptr);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *SqliteShardedBackend::new_entity(
+        const dbtype::EntityType type,
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::Id &owner,
+        const std::string &name)
+    {
+        return shard_for_site(site_id).new_entity(type, site_id, owner, name);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *SqliteShardedBackend::get_entity_db(const dbtype::Id &id)
+    {
+        return shard_for_site(id.get_site_id()).get_entity_db(id);
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::get_entities_db(
+        const dbtype::Entity::IdVector &ids,
+        EntityPtrVector &entities)
+    {
+        entities.assign(ids.size(), 0);
+
+        // Group the IDs by shard, remembering where each one goes.
+        //
+        std::vector<dbtype::Entity::IdVector> shard_ids(shards.size());
+        std::vector<std::vector<size_t> > shard_positions(shards.size());
+
+        for (size_t index = 0; index < ids.size(); ++index)
+        {
+            const size_t shard_index =
+                ids[index].get_site_id() % shards.size();
+
+            shard_ids[shard_index].push_back(ids[index]);
+            shard_positions[shard_index].push_back(index);
+        }
+
+        EntityPtrVector shard_entities;
+
+        for (size_t shard_index = 0; shard_index < shards.size(); ++shard_index)
+        {
+            if (not shard_ids[shard_index].empty())
+            {
+                shards[shard_index]->get_entities_db(
+                    shard_ids[shard_index],
+                    shard_entities);
+
+                for (size_t index = 0;
+                    index < shard_entities.size();
+                    ++index)
+                {
+                    entities[shard_positions[shard_index][index]] =
+                        shard_entities[index];
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::entity_exists_db(const dbtype::Id &id)
+    {
+        return shard_for_site(id.get_site_id()).entity_exists_db(id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::save_entity_db(dbtype::Entity *entity_ptr)
+    {
+        return entity_ptr and
+            shard_for_site(entity_ptr->get_entity_id().get_site_id()).
+                save_entity_db(entity_ptr);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::save_entities_db(
+        const EntityPtrVector &entities,
+        dbtype::Entity::IdVector &failed_ids)
+    {
+        std::vector<EntityPtrVector> shard_entities(shards.size());
+        size_t shards_used = 0;
+
+        for (EntityPtrVector::const_iterator entity_iter = entities.begin();
+            entity_iter != entities.end();
+            ++entity_iter)
+        {
+            if (*entity_iter)
+            {
+                EntityPtrVector &batch = shard_entities[
+                    (*entity_iter)->get_entity_id().get_site_id()
+                        % shards.size()];
+
+                if (batch.empty())
+                {
+                    ++shards_used;
+                }
+
+                batch.push_back(*entity_iter);
+            }
+        }
+
+        if (shards_used <= 1)
+        {
+            // Nothing to gain from another thread.
+            //
+            bool success = true;
+
+            for (size_t index = 0; index < shards.size(); ++index)
+            {
+                if (not shard_entities[index].empty())
+                {
+                    success = shards[index]->save_entities_db(
+                        shard_entities[index],
+                        failed_ids) and success;
+                }
+            }
+
+            return success;
+        }
+
+        // Each shard has its own writer, so save them all at once.
+        //
+        std::vector<dbtype::Entity::IdVector> shard_failed_ids(shards.size());
+        std::deque<bool> results(shards.size(), true);
+        WorkerJobs jobs(shards.size());
+
+        for (size_t index = 0; index < shards.size(); ++index)
+        {
+            if (not shard_entities[index].empty())
+            {
+                jobs[index] = boost::bind(
+                    &SqliteShardedBackend::save_shard_entities,
+                    boost::this_thread::get_id(),
+                    shards[index],
+                    &shard_entities[index],
+                    &shard_failed_ids[index],
+                    &results[index]);
+            }
+        }
+
+        run_worker_jobs(jobs);
+
+        bool success = true;
+
+        for (size_t index = 0; index < shards.size(); ++index)
+        {
+            success = results[index] and success;
+
+            failed_ids.insert(
+                failed_ids.end(),
+                shard_failed_ids[index].begin(),
+                shard_failed_ids[index].end());
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::begin_transaction_db(void)
+    {
+        bool success = true;
+
+        for (size_t index = 0; success and (index < shards.size()); ++index)
+        {
+            success = shards[index]->begin_transaction_db();
+
+            if (not success)
+            {
+                // Undo the ones already begun.
+                //
+                for (size_t begun = 0; begun < index; ++begun)
+                {
+                    shards[begun]->rollback_transaction_db();
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::commit_transaction_db(void)
+    {
+        bool success =
+            call_all_shards(&SqliteBackend::commit_transaction_db);
+        dbtype::Id::SiteIdVector catalog_deletes;
+
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            catalog_deletes.swap(pending_catalog_deletes);
+        }
+
+        if (not success)
+        {
+            // The failed batch is saved again, including the site deletes,
+            // so their catalog rows are removed then.
+            //
+            LOG(error, "sqliteinterface", "commit_transaction_db",
+                "At least one site file failed to commit.");
+        }
+        else
+        {
+            for (dbtype::Id::SiteIdVector::const_iterator site_iter =
+                    catalog_deletes.begin();
+                site_iter != catalog_deletes.end();
+                ++site_iter)
+            {
+                if (not catalog.delete_site_in_db(*site_iter))
+                {
+                    LOG(error, "sqliteinterface", "commit_transaction_db",
+                        "Could not delete site " + text::to_string(*site_iter)
+                        + " from the catalog.");
+                    success = false;
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::begin_bulk_load_db(void)
+    {
+        bool success = true;
+
+        for (size_t index = 0; success and (index < shards.size()); ++index)
+        {
+            success = shards[index]->begin_bulk_load_db();
+
+            if (not success)
+            {
+                // Undo the ones already begun.  Nothing has been loaded
+                // into them yet.
+                //
+                for (size_t begun = 0; begun < index; ++begun)
+                {
+                    shards[begun]->rollback_transaction_db();
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::end_bulk_load_db(void)
+    {
+        // Shards that ended on an earlier, partly failed, call are left
+        // alone so this can be retried.
+        //
+        Shards loading;
+
+        for (Shards::iterator shard_iter = shards.begin();
+             shard_iter != shards.end();
+             ++shard_iter)
+        {
+            if ((*shard_iter)->bulk_load_in_progress())
+            {
+                loading.push_back(*shard_iter);
+            }
+        }
+
+        // The indexes of each shard are rebuilt at the same time.
+        return (not loading.empty()) and
+            call_shards(loading, &SqliteBackend::end_bulk_load_db);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::start_backup_db(const std::string &backup_file)
+    {
+        if (backup_file.empty() or get_backup_status_db().in_progress)
+        {
+            return false;
+        }
+
+        bool success = catalog.start_backup_db(backup_file);
+
+        for (size_t index = 0; success and (index < shards.size()); ++index)
+        {
+            success = shards[index]->start_backup_db(
+                backup_file + shard_suffix(index));
+
+            if (not success)
+            {
+                LOG(error, "sqliteinterface", "start_backup_db",
+                    "Unable to start backup of site file "
+                    + text::to_string(index));
+
+                // A backup missing some files is of no use, so don't
+                // leave the others running.
+                //
+                catalog.stop_backup();
+
+                for (size_t started = 0; started < index; ++started)
+                {
+                    shards[started]->stop_backup();
+                }
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::BackupStatus SqliteShardedBackend::get_backup_status_db(void)
+    {
+        dbinterface::BackupStatus status = catalog.get_backup_status_db();
+
+        for (Shards::iterator shard_iter = shards.begin();
+            shard_iter != shards.end();
+            ++shard_iter)
+        {
+            const dbinterface::BackupStatus shard_status =
+                (*shard_iter)->get_backup_status_db();
+
+            status.in_progress = status.in_progress or
+                shard_status.in_progress;
+            status.completed = status.completed and shard_status.completed;
+            status.total_pages += shard_status.total_pages;
+            status.remaining_pages += shard_status.remaining_pages;
+
+            if (status.finished < shard_status.finished)
+            {
+                status.finished = shard_status.finished;
+            }
+
+            if (status.error.empty())
+            {
+                status.error = shard_status.error;
+            }
+        }
+
+        return status;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::delete_entity_db(const dbtype::Id &id)
+    {
+        return shard_for_site(id.get_site_id()).delete_entity_db(id);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::EntityType SqliteShardedBackend::get_entity_type_db(
+        const dbtype::Id &id)
+    {
+        return shard_for_site(id.get_site_id()).get_entity_type_db(id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::update_references_db(
+        const dbtype::Id &source_id,
+        const dbtype::Entity::ChangedIdFieldsMap &changed_fields)
+    {
+        return shard_for_site(source_id.get_site_id()).update_references_db(
+            source_id,
+            changed_fields);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::references_saved_db(void)
+    {
+        // Each shard keeps the reference index of its own sites.
+        return call_all_shards(&SqliteBackend::references_saved_db);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::save_access_stats_db(
+        const dbinterface::DbBackend::AccessStatsMap &stats)
+    {
+        std::vector<AccessStatsMap> shard_stats(shards.size());
+
+        for (AccessStatsMap::const_iterator stats_iter = stats.begin();
+            stats_iter != stats.end();
+            ++stats_iter)
+        {
+            shard_stats[stats_iter->first.get_site_id() % shards.size()].
+                insert(*stats_iter);
+        }
+
+        bool success = true;
+
+        for (size_t index = 0; index < shards.size(); ++index)
+        {
+            if (not shard_stats[index].empty())
+            {
+                success = shards[index]->save_access_stats_db(
+                    shard_stats[index]) and success;
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector SqliteShardedBackend::get_references_to_db(
+        const dbtype::Id &target_id,
+        const dbtype::EntityField field)
+    {
+        // References are kept with the Entity doing the referencing, which
+        // could be in any site.
+        //
+        dbtype::Entity::IdVector result;
+
+        for (Shards::iterator shard_iter = shards.begin();
+            shard_iter != shards.end();
+            ++shard_iter)
+        {
+            const dbtype::Entity::IdVector shard_result =
+                (*shard_iter)->get_references_to_db(target_id, field);
+
+            result.insert(result.end(), shard_result.begin(), shard_result.end());
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdFieldsMap SqliteShardedBackend::get_references_from_db(
+        const dbtype::Id &source_id)
+    {
+        return shard_for_site(source_id.get_site_id()).get_references_from_db(
+            source_id);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector SqliteShardedBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::EntityType type,
+        const dbtype::Id::EntityIdType owner_id,
+        const std::string &name,
+        const bool exact)
+    {
+        return shard_for_site(site_id).find_in_db(
+            site_id,
+            type,
+            owner_id,
+            name,
+            exact);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector SqliteShardedBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        return shard_for_site(site_id).find_in_db(site_id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::visit_site_entities_db(
+        const dbtype::Id::SiteIdType site_id,
+        dbinterface::EntityVisitor &visitor)
+    {
+        return shard_for_site(site_id).visit_site_entities_db(
+            site_id,
+            visitor);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector SqliteShardedBackend::get_recently_accessed_db(
+        const dbtype::Id::SiteIdType site_id,
+        const size_t max_entities)
+    {
+        return shard_for_site(site_id).get_recently_accessed_db(
+            site_id,
+            max_entities);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id SqliteShardedBackend::find_program_reg_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &registration_name)
+    {
+        return shard_for_site(site_id).find_program_reg_in_db(
+            site_id,
+            registration_name);
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SqliteShardedBackend::find_program_reg_name_in_db(
+        const dbtype::Id &id)
+    {
+        return shard_for_site(id.get_site_id()).find_program_reg_name_in_db(id);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Id::SiteIdVector SqliteShardedBackend::get_site_ids_in_db(void)
+    {
+        return catalog.get_site_ids_in_db();
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::EntityMetadata SqliteShardedBackend::get_entity_metadata(
+        const dbtype::Id &id)
+    {
+        return shard_for_site(id.get_site_id()).get_entity_metadata(id);
+    }
+
+    // ----------------------------------------------------------------------
+    dbinterface::MetadataVector SqliteShardedBackend::get_entity_metadata(
+        const dbtype::Entity::IdVector &ids)
+    {
+        std::vector<dbtype::Entity::IdVector> shard_ids(shards.size());
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            shard_ids[id_iter->get_site_id() % shards.size()].push_back(
+                *id_iter);
+        }
+
+        dbinterface::MetadataVector result;
+
+        for (size_t index = 0; index < shards.size(); ++index)
+        {
+            if (not shard_ids[index].empty())
+            {
+                const dbinterface::MetadataVector shard_result =
+                    shards[index]->get_entity_metadata(shard_ids[index]);
+
+                result.insert(
+                    result.end(),
+                    shard_result.begin(),
+                    shard_result.end());
+            }
+        }
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::new_site_in_db(dbtype::Id::SiteIdType &site_id)
+    {
+        bool success = catalog.new_site_in_db(site_id);
+
+        if (success)
+        {
+            success = shard_for_site(site_id).add_site_in_db(site_id);
+
+            if (not success)
+            {
+                LOG(error, "sqliteinterface", "new_site_in_db",
+                    "Could not add site " + text::to_string(site_id)
+                    + " to its site file.");
+
+                catalog.delete_site_in_db(site_id);
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::delete_site_in_db(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        // The catalog is done last so the ID is not reused before the
+        // site's data is gone.  If the site file delete is part of a
+        // transaction, that means waiting until it commits.
+        //
+        SqliteBackend &shard = shard_for_site(site_id);
+
+        if (not shard.delete_site_in_db(site_id))
+        {
+            return false;
+        }
+
+        if (shard.in_transaction())
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            pending_catalog_deletes.push_back(site_id);
+
+            return true;
+        }
+
+        return catalog.delete_site_in_db(site_id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::get_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_name)
+    {
+        return catalog.get_site_name_in_db(site_id, site_name);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::set_site_name_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_name)
+    {
+        return catalog.set_site_name_in_db(site_id, site_name);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::get_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        std::string &site_description)
+    {
+        return catalog.get_site_description_in_db(site_id, site_description);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::set_site_description_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const std::string &site_description)
+    {
+        return catalog.set_site_description_in_db(site_id, site_description);
+    }
+
+    // ----------------------------------------------------------------------
+    std::string SqliteShardedBackend::shard_suffix(
+        const size_t shard_index) const
+    {
+        return ".site" + text::to_string(shard_index);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::call_all_shards(ShardMethod method)
+    {
+        return call_shards(shards, method);
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteShardedBackend::call_shards(
+        const Shards &which,
+        ShardMethod method)
+    {
+        if (which.size() == 1)
+        {
+            return (which.front()->*method)();
+        }
+
+        std::deque<bool> results(which.size(), false);
+        WorkerJobs jobs(shards.size());
+
+        for (size_t index = 0; index < which.size(); ++index)
+        {
+            jobs[shard_index(which[index])] = boost::bind(
+                &SqliteShardedBackend::call_shard,
+                boost::this_thread::get_id(),
+                which[index],
+                method,
+                &results[index]);
+        }
+
+        run_worker_jobs(jobs);
+
+        bool success = true;
+
+        for (size_t index = 0; index < which.size(); ++index)
+        {
+            success = results[index] and success;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    size_t SqliteShardedBackend::shard_index(const SqliteBackend *shard_ptr) const
+    {
+        size_t index = 0;
+
+        while ((index < shards.size()) and (shards[index] != shard_ptr))
+        {
+            ++index;
+        }
+
+        return index;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::start_workers(void)
+    {
+        boost::lock_guard<boost::mutex> guard(workers_mutex);
+
+        if (worker_threads.empty())
+        {
+            workers_stop = false;
+            worker_jobs.assign(shards.size(), WorkerJob());
+            jobs_outstanding = 0;
+
+            for (size_t index = 0; index < shards.size(); ++index)
+            {
+                worker_threads.push_back(new boost::thread(boost::bind(
+                    &SqliteShardedBackend::worker_thread_main,
+                    this,
+                    index)));
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::stop_workers(void)
+    {
+        WorkerThreads threads;
+
+        {
+            boost::lock_guard<boost::mutex> guard(workers_mutex);
+
+            workers_stop = true;
+            threads.swap(worker_threads);
+        }
+
+        workers_cond.notify_all();
+
+        for (WorkerThreads::iterator thread_iter = threads.begin();
+            thread_iter != threads.end();
+            ++thread_iter)
+        {
+            (*thread_iter)->join();
+            delete *thread_iter;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::run_worker_jobs(const WorkerJobs &jobs)
+    {
+        // One set of jobs at a time, since each worker has one job slot.
+        boost::lock_guard<boost::mutex> dispatch_guard(dispatch_mutex);
+        boost::unique_lock<boost::mutex> lock(workers_mutex);
+
+        if (worker_threads.empty())
+        {
+            // Not started (or already stopped), so do them here.
+            //
+            lock.unlock();
+
+            for (WorkerJobs::const_iterator job_iter = jobs.begin();
+                job_iter != jobs.end();
+                ++job_iter)
+            {
+                if (*job_iter)
+                {
+                    (*job_iter)();
+                }
+            }
+
+            return;
+        }
+
+        for (size_t index = 0; index < jobs.size(); ++index)
+        {
+            if (jobs[index])
+            {
+                worker_jobs[index] = jobs[index];
+                ++jobs_outstanding;
+            }
+        }
+
+        workers_cond.notify_all();
+
+        while (jobs_outstanding)
+        {
+            workers_cond.wait(lock);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::worker_thread_main(const size_t index)
+    {
+        boost::unique_lock<boost::mutex> lock(workers_mutex);
+
+        while (true)
+        {
+            while ((not workers_stop) and worker_jobs[index].empty())
+            {
+                workers_cond.wait(lock);
+            }
+
+            if (worker_jobs[index].empty())
+            {
+                // Stopping, and nothing left to do.
+                break;
+            }
+
+            WorkerJob job;
+            job.swap(worker_jobs[index]);
+
+            lock.unlock();
+            job();
+            lock.lock();
+
+            --jobs_outstanding;
+
+            if (not jobs_outstanding)
+            {
+                workers_cond.notify_all();
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::call_shard(
+        const boost::thread::id caller_id,
+        SqliteBackend *shard_ptr,
+        ShardMethod method,
+        bool *result_ptr)
+    {
+        // Work done for a caller in a transaction goes in the transaction.
+        shard_ptr->join_transaction(caller_id);
+
+        *result_ptr = (shard_ptr->*method)();
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteShardedBackend::save_shard_entities(
+        const boost::thread::id caller_id,
+        SqliteBackend *shard_ptr,
+        const EntityPtrVector *entities_ptr,
+        dbtype::Entity::IdVector *failed_ids_ptr,
+        bool *result_ptr)
+    {
+        shard_ptr->join_transaction(caller_id);
+
+        *result_ptr = shard_ptr->save_entities_db(
+            *entities_ptr,
+            *failed_ids_ptr);
+    }
+}
+}
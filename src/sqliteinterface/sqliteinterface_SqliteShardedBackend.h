@@ -0,0 +1,322 @@
+/*
+ * sqliteinterface_SqliteShardedBackend.h
+ */
+
+#ifndef MUTGOS_SQLITEINTERFACE_SQLITESHARDEDBACKEND_H
+#define MUTGOS_SQLITEINTERFACE_SQLITESHARDEDBACKEND_H
+
+#include <vector>
+#include <string>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/function.hpp>
+
+#include "dbinterface/dbinterface_DbBackend.h"
+#include "dbinterface/dbinterface_BackupStatus.h"
+#include "dbinterface/dbinterface_EntityMetadata.h"
+#include "dbinterface/dbinterface_EntityVisitor.h"
+
+#include "sqliteinterface/sqliteinterface_SqliteBackend.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+
+namespace mutgos
+{
+namespace sqliteinterface
+{
+    /**
+     * Implements a DbBackend that spreads the sites across several SQLite
+     * database files, each opened by its own SqliteBackend with its own
+     * writer connection.  A site always lives in the file picked by its
+     * site ID modulo the number of files, so Entities in different files
+     * can be saved and committed at the same time instead of waiting on
+     * a single writer.
+     *
+     * The main database file is a small catalog holding only the sites
+     * (ID allocation, names, and descriptions).  Everything about the
+     * Entities of a site, including their references, program
+     * registrations, and access statistics, is kept in the site's file.
+     *
+     * Saves of a batch and commits are split up by file and run on a
+     * worker thread kept for each file.  A transaction is therefore only atomic within
+     * each file: if one file fails to commit, the others may still have
+     * committed.  Saving the batch again is harmless, so this only
+     * matters to a caller that expects all or nothing across sites.
+     * The catalog is not part of the transaction; a site deleted in one
+     * is taken out of the catalog only after every file has committed.
+     *
+     * References between Entities in different files are only removed
+     * from the file of the Entity or site doing the referencing.
+     *
+     * Which files the sites are in is fixed when the database is created;
+     * changing the number of files afterwards would lose track of sites.
+     */
+    class SqliteShardedBackend : public dbinterface::DbBackend
+    {
+    public:
+        /**
+         * Constructor.  Nothing is opened until init().
+         * @param shard_count[in] How many files to spread the sites
+         * across, besides the catalog.  Must be at least 1.
+         */
+        SqliteShardedBackend(const size_t shard_count);
+
+        /**
+         * Destructor.
+         */
+        virtual ~SqliteShardedBackend();
+
+        virtual bool init(void);
+
+        virtual bool shutdown(void);
+
+        virtual std::string get_backend_name(void);
+
+        virtual bool entity_mem_owned_by_this(
+            const dbtype::Entity *entity_ptr);
+
+        virtual void delete_entity_mem(dbtype::Entity *entity_ptr);
+
+        virtual dbtype::Entity *new_entity(
+            const dbtype::EntityType type,
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::Id &owner,
+            const std::string &name);
+
+        virtual dbtype::Entity *get_entity_db(const dbtype::Id &id);
+
+        virtual void get_entities_db(
+            const dbtype::Entity::IdVector &ids,
+            EntityPtrVector &entities);
+
+        virtual bool entity_exists_db(const dbtype::Id &id);
+
+        virtual bool save_entity_db(dbtype::Entity *entity_ptr);
+
+        virtual bool save_entities_db(
+            const EntityPtrVector &entities,
+            dbtype::Entity::IdVector &failed_ids);
+
+        virtual bool begin_transaction_db(void);
+
+        virtual bool commit_transaction_db(void);
+
+        virtual bool begin_bulk_load_db(void);
+
+        virtual bool end_bulk_load_db(void);
+
+        /**
+         * Starts a backup of the catalog to backup_file, and of each site
+         * file to backup_file with the same suffix the site file has.
+         * If any of them fail to start, the ones already started are
+         * stopped.
+         * @param backup_file[in] The file to write the catalog backup to.
+         * @return True if the backups were started.
+         */
+        virtual bool start_backup_db(const std::string &backup_file);
+
+        virtual dbinterface::BackupStatus get_backup_status_db(void);
+
+        virtual bool delete_entity_db(const dbtype::Id &id);
+
+        virtual dbtype::EntityType get_entity_type_db(const dbtype::Id &id);
+
+        virtual bool update_references_db(
+            const dbtype::Id &source_id,
+            const dbtype::Entity::ChangedIdFieldsMap &changed_fields);
+
+        virtual bool references_saved_db(void);
+
+        virtual bool save_access_stats_db(
+            const dbinterface::DbBackend::AccessStatsMap &stats);
+
+        virtual dbtype::Entity::IdVector get_references_to_db(
+            const dbtype::Id &target_id,
+            const dbtype::EntityField field);
+
+        virtual dbtype::Entity::IdFieldsMap get_references_from_db(
+            const dbtype::Id &source_id);
+
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::EntityType type,
+            const dbtype::Id::EntityIdType owner_id,
+            const std::string &name,
+            const bool exact);
+
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id);
+
+        virtual bool visit_site_entities_db(
+            const dbtype::Id::SiteIdType site_id,
+            dbinterface::EntityVisitor &visitor);
+
+        virtual dbtype::Entity::IdVector get_recently_accessed_db(
+            const dbtype::Id::SiteIdType site_id,
+            const size_t max_entities);
+
+        virtual dbtype::Id find_program_reg_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &registration_name);
+
+        virtual std::string find_program_reg_name_in_db(const dbtype::Id &id);
+
+        virtual dbtype::Id::SiteIdVector get_site_ids_in_db(void);
+
+        virtual dbinterface::EntityMetadata get_entity_metadata(
+            const dbtype::Id &id);
+
+        virtual dbinterface::MetadataVector get_entity_metadata(
+            const dbtype::Entity::IdVector &ids);
+
+        virtual bool new_site_in_db(dbtype::Id::SiteIdType &site_id);
+
+        virtual bool delete_site_in_db(const dbtype::Id::SiteIdType site_id);
+
+        virtual bool get_site_name_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            std::string &site_name);
+
+        virtual bool set_site_name_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &site_name);
+
+        virtual bool get_site_description_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            std::string &site_description);
+
+        virtual bool set_site_description_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const std::string &site_description);
+
+    private:
+        typedef std::vector<SqliteBackend *> Shards;
+
+        /** Member of SqliteBackend that is called on every shard */
+        typedef bool (SqliteBackend::*ShardMethod)(void);
+
+        /** Something for a worker thread to do */
+        typedef boost::function<void (void)> WorkerJob;
+
+        /** Job for each shard's worker, indexed like shards.  Empty jobs
+            are skipped. */
+        typedef std::vector<WorkerJob> WorkerJobs;
+
+        typedef std::vector<boost::thread *> WorkerThreads;
+
+        /**
+         * @param site_id[in] The site ID.
+         * @return The shard the site lives in.
+         */
+        SqliteBackend &shard_for_site(const dbtype::Id::SiteIdType site_id)
+            { return *shards[site_id % shards.size()]; }
+
+        /**
+         * @param shard_index[in] The index of the shard.
+         * @return What is appended to the catalog's file name (or backup
+         * file name) to get the shard's.
+         */
+        std::string shard_suffix(const size_t shard_index) const;
+
+        /**
+         * @param shard_ptr[in] The shard to look up.
+         * @return The index of the shard in shards.
+         */
+        size_t shard_index(const SqliteBackend *shard_ptr) const;
+
+        /**
+         * Starts a worker thread for each shard, if not already started.
+         */
+        void start_workers(void);
+
+        /**
+         * Stops and joins the worker threads, after they finish what they
+         * were given.
+         */
+        void stop_workers(void);
+
+        /**
+         * Has each shard's worker thread run its job, and waits for them
+         * all to finish.  If the workers are not running, the jobs are run
+         * on the calling thread instead.
+         * @param jobs[in] The job for each shard.
+         */
+        void run_worker_jobs(const WorkerJobs &jobs);
+
+        /**
+         * Worker thread entry point.  Runs the jobs given to one shard
+         * until stopped.
+         * @param index[in] The index of the shard the worker is for.
+         */
+        void worker_thread_main(const size_t index);
+
+        /**
+         * Calls a method on every shard, each on its shard's worker.
+         * @param method[in] The method to call.
+         * @return True if the method returned true on every shard.
+         */
+        bool call_all_shards(ShardMethod method);
+
+        /**
+         * Calls a method on the given shards, each on its shard's worker.
+         * @param which[in] The shards to call.  Must not be empty.
+         * @param method[in] The method to call.
+         * @return True if the method returned true on every given shard.
+         */
+        bool call_shards(const Shards &which, ShardMethod method);
+
+        /**
+         * Worker job that calls a method on one shard.
+         * @param caller_id[in] The thread that wants the method called,
+         * whose transaction (if any) the call is part of.
+         * @param shard_ptr[in] The shard to call.
+         * @param method[in] The method to call.
+         * @param result_ptr[out] What the method returned.
+         */
+        static void call_shard(
+            const boost::thread::id caller_id,
+            SqliteBackend *shard_ptr,
+            ShardMethod method,
+            bool *result_ptr);
+
+        /**
+         * Worker job that saves a batch of Entities on one shard.
+         * @param caller_id[in] The thread that wants the Entities saved,
+         * whose transaction (if any) the saves are part of.
+         * @param shard_ptr[in] The shard to save to.
+         * @param entities_ptr[in] The Entities to save.
+         * @param failed_ids_ptr[out] IDs of Entities that failed to save.
+         * @param result_ptr[out] True if all were saved.
+         */
+        static void save_shard_entities(
+            const boost::thread::id caller_id,
+            SqliteBackend *shard_ptr,
+            const EntityPtrVector *entities_ptr,
+            dbtype::Entity::IdVector *failed_ids_ptr,
+            bool *result_ptr);
+
+        SqliteBackend catalog; ///< Main database file, with the sites
+        Shards shards; ///< The files the sites' data is spread across
+
+        boost::mutex mutex; ///< Protects pending_catalog_deletes
+        boost::mutex dispatch_mutex; ///< Only one run_worker_jobs() at a time
+        boost::mutex workers_mutex; ///< Protects the worker state below
+        boost::condition_variable workers_cond; ///< Signals new jobs, or all done
+        WorkerThreads worker_threads; ///< One per shard, if started
+        WorkerJobs worker_jobs; ///< Job waiting for each shard's worker
+        size_t jobs_outstanding; ///< How many given jobs have not finished
+        bool workers_stop; ///< True when the workers should exit
+        dbtype::Id::SiteIdVector pending_catalog_deletes; ///< Sites to remove from the catalog once their site file commits
+
+        // No copying
+        //
+        SqliteShardedBackend(const SqliteShardedBackend &rhs);
+        SqliteShardedBackend &operator=(const SqliteShardedBackend &rhs);
+    };
+}
+}
+
+#endif //MUTGOS_SQLITEINTERFACE_SQLITESHARDEDBACKEND_H
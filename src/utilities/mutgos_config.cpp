@@ -23,6 +23,7 @@
 #define MINIMUM_DB_NAME_LENGTH 16
 #define MINIMUM_DB_SET_LENGTH 64
 #define MINIMUM_DB_DOCUMENT_LENGTH 64
+#define MINIMUM_DB_LOGSTORE_SEGMENT_SIZE 64
 
 //
 // To add a new key:
@@ -86,8 +87,20 @@ namespace
 
     // db
     //
+    const std::string KEY_DB_BACKEND = "database.backend";
+    std::string config_db_backend = "sqlite";
     const std::string KEY_DB_FILE = "database.db_file";
     std::string config_db_file = MUTGOS_DB_DEFAULT_FILE_NAME;
+    const std::string KEY_DB_SITE_FILES = "database.site_files";
+    MG_UnsignedInt config_db_site_files = 0;
+    const std::string KEY_DB_LOGSTORE_DIRECTORY = "database.logstore.directory";
+    std::string config_db_logstore_directory = "logstore";
+    const std::string KEY_DB_LOGSTORE_SEGMENT_SIZE = "database.logstore.segment_size";
+    MG_UnsignedInt config_db_logstore_segment_size = 65536;
+    const std::string KEY_DB_LOGSTORE_COMPACT_GARBAGE = "database.logstore.compact_garbage";
+    MG_UnsignedInt config_db_logstore_compact_garbage = 50;
+    const std::string KEY_DB_LOGSTORE_COMPACT_INTERVAL = "database.logstore.compact_interval";
+    MG_UnsignedInt config_db_logstore_compact_interval = 30;
     const std::string KEY_DB_PASSWORD_WORKFACTOR = "database.password_workfactor";
     MG_UnsignedInt config_db_password_workfactor = 10;
     const std::string KEY_DB_LIMIT_STRING = "database.limits.string";
@@ -104,6 +117,30 @@ namespace
     MG_UnsignedInt config_db_limit_document_lines = 1024;
     const std::string KEY_DB_LIMIT_PROGRAM_LINES = "database.limits.program.lines";
     MG_UnsignedInt config_db_limit_program_lines = 32768;
+    const std::string KEY_DB_READ_CONNECTIONS = "database.read_connections";
+    MG_UnsignedInt config_db_read_connections = 4;
+    const std::string KEY_DB_CACHE_MAX_SITE_MEMORY = "database.cache.max_site_memory";
+    MG_UnsignedInt config_db_cache_max_site_memory = 262144;
+    const std::string KEY_DB_COMMIT_INTERVAL = "database.commit.interval";
+    MG_UnsignedInt config_db_commit_interval = 5;
+    const std::string KEY_DB_COMMIT_MAX_ENTITIES = "database.commit.max_entities";
+    MG_UnsignedInt config_db_commit_max_entities = 2000;
+    const std::string KEY_DB_COMMIT_MAX_MEMORY = "database.commit.max_memory";
+    MG_UnsignedInt config_db_commit_max_memory = 8192;
+    const std::string KEY_DB_DURABILITY = "database.durability";
+    std::string config_db_durability = "normal";
+    const std::string KEY_DB_BACKUP_FILE = "database.backup.file";
+    std::string config_db_backup_file = "mutgos_backup.db";
+    const std::string KEY_DB_BACKUP_INTERVAL = "database.backup.interval";
+    MG_UnsignedInt config_db_backup_interval = 0;
+    const std::string KEY_DB_BACKUP_PAGES_PER_STEP = "database.backup.pages_per_step";
+    MG_UnsignedInt config_db_backup_pages_per_step = 64;
+    const std::string KEY_DB_BACKUP_STEP_DELAY = "database.backup.step_delay";
+    MG_UnsignedInt config_db_backup_step_delay = 20;
+    const std::string KEY_DB_WARMUP_ENTITIES = "database.warmup.entities";
+    MG_UnsignedInt config_db_warmup_entities = 0;
+    const std::string KEY_DB_WARMUP_THREADS = "database.warmup.threads";
+    MG_UnsignedInt config_db_warmup_threads = 4;
 
     // AngelScript
     //
@@ -221,6 +258,59 @@ namespace config
         }
     }
 
+    /**
+     * Validates and adjusts a directory to have a prefixed path, if
+     * appropriate.  The directory does not have to exist yet.
+     * @param key[in] The key name, for logging purposes.
+     * @param data_dir_prefix[in] The prefix to the data directory, with a
+     * trailing slash.
+     * @param directory[in,out] The directory to validate.  It may be
+     * modified to be normalized for the platform and have a prefixed path.
+     * @param success[out] If the value does not validate, this will be set
+     * to false.
+     */
+    void validate_directory(
+        const std::string &key,
+        const std::string &data_dir_prefix,
+        std::string &directory,
+        bool &success)
+    {
+        if (directory.empty())
+        {
+            success = false;
+            LOG(fatal, "config", "validate_directory",
+                "Directory name is empty for key: " + key);
+        }
+        else
+        {
+            boost::filesystem::path normalized_dir;
+
+            if ((directory[0] == '/') or (directory[0] == '\\'))
+            {
+                // Starts with a separator, so it's absolute
+                normalized_dir = directory;
+            }
+            else
+            {
+                // Relative
+                normalized_dir = data_dir_prefix + directory;
+            }
+
+            directory = normalized_dir.native();
+
+            LOG(info, "config", "validate_directory",
+                key + " set to " + directory);
+
+            if (boost::filesystem::exists(normalized_dir) and
+                (not boost::filesystem::is_directory(normalized_dir)))
+            {
+                success = false;
+                LOG(fatal, "config", "validate_directory",
+                    "For key " + key + ", not a directory: " + directory);
+            }
+        }
+    }
+
 
     /**
      * Parses the config file and sets all the file-scope variables.
@@ -303,10 +393,28 @@ namespace config
 
             // db
             //
+            (KEY_DB_BACKEND.c_str(),
+                boost::program_options::value<std::string>()->
+                    default_value(config_db_backend), "")
             (KEY_DB_FILE.c_str(),
                 boost::program_options::value<std::string>()->
                     default_value(config_db_file), "")
-            (KEY_DB_PASSWORD_WORKFACTOR.c_str(),
+            (KEY_DB_SITE_FILES.c_str(),
+                boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_site_files), "")
+            (KEY_DB_LOGSTORE_DIRECTORY.c_str(),
+               boost::program_options::value<std::string>()->
+                    default_value(config_db_logstore_directory), "")
+           (KEY_DB_LOGSTORE_SEGMENT_SIZE.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_logstore_segment_size), "")
+           (KEY_DB_LOGSTORE_COMPACT_GARBAGE.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_logstore_compact_garbage), "")
+           (KEY_DB_LOGSTORE_COMPACT_INTERVAL.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_logstore_compact_interval), "")
+           (KEY_DB_PASSWORD_WORKFACTOR.c_str(),
                 boost::program_options::value<MG_UnsignedInt>()->
                     default_value(config_db_password_workfactor), "")
            (KEY_DB_LIMIT_STRING.c_str(),
@@ -330,6 +438,42 @@ namespace config
            (KEY_DB_LIMIT_PROGRAM_LINES.c_str(),
                boost::program_options::value<MG_UnsignedInt>()->
                     default_value(config_db_limit_program_lines), "")
+           (KEY_DB_READ_CONNECTIONS.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_read_connections), "")
+           (KEY_DB_CACHE_MAX_SITE_MEMORY.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_cache_max_site_memory), "")
+           (KEY_DB_COMMIT_INTERVAL.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_commit_interval), "")
+           (KEY_DB_COMMIT_MAX_ENTITIES.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_commit_max_entities), "")
+           (KEY_DB_COMMIT_MAX_MEMORY.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_commit_max_memory), "")
+           (KEY_DB_DURABILITY.c_str(),
+               boost::program_options::value<std::string>()->
+                    default_value(config_db_durability), "")
+           (KEY_DB_BACKUP_FILE.c_str(),
+               boost::program_options::value<std::string>()->
+                    default_value(config_db_backup_file), "")
+           (KEY_DB_BACKUP_INTERVAL.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_backup_interval), "")
+           (KEY_DB_BACKUP_PAGES_PER_STEP.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_backup_pages_per_step), "")
+           (KEY_DB_BACKUP_STEP_DELAY.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_backup_step_delay), "")
+           (KEY_DB_WARMUP_ENTITIES.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_warmup_entities), "")
+           (KEY_DB_WARMUP_THREADS.c_str(),
+               boost::program_options::value<MG_UnsignedInt>()->
+                    default_value(config_db_warmup_threads), "")
 
             // Angelscript
             //
@@ -485,6 +629,22 @@ namespace config
             // db
             //
 
+            config_db_backend = vars[KEY_DB_BACKEND].as<std::string>();
+
+            if ((config_db_backend != "sqlite") and
+                (config_db_backend != "memory") and
+                (config_db_backend != "logstore"))
+            {
+                LOG(fatal, "config", "do_parse",
+                    KEY_DB_BACKEND + " must be sqlite, memory, or logstore.");
+                success = false;
+            }
+            else
+            {
+                LOG(info, "config", "do_parse",
+                    KEY_DB_BACKEND + " set to " + config_db_backend);
+            }
+
             config_db_file = vars[KEY_DB_FILE].as<std::string>();
             // Database file may not exist if this is the import program;
             // it will be automatically created.
@@ -495,6 +655,47 @@ namespace config
                 config_db_file,
                 success);
 
+            config_db_site_files =
+                vars[KEY_DB_SITE_FILES].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_SITE_FILES,
+                config_db_site_files,
+                success,
+                0);
+
+            config_db_logstore_directory =
+                vars[KEY_DB_LOGSTORE_DIRECTORY].as<std::string>();
+            // Directory will be created when the log store is first used.
+            validate_directory(
+                KEY_DB_LOGSTORE_DIRECTORY,
+                data_dir_prefix,
+                config_db_logstore_directory,
+                success);
+
+            config_db_logstore_segment_size =
+                vars[KEY_DB_LOGSTORE_SEGMENT_SIZE].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_LOGSTORE_SEGMENT_SIZE,
+                config_db_logstore_segment_size,
+                success,
+                MINIMUM_DB_LOGSTORE_SEGMENT_SIZE);
+
+            config_db_logstore_compact_garbage =
+                vars[KEY_DB_LOGSTORE_COMPACT_GARBAGE].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_LOGSTORE_COMPACT_GARBAGE,
+                config_db_logstore_compact_garbage,
+                success,
+                1,
+                100);
+
+            config_db_logstore_compact_interval =
+                vars[KEY_DB_LOGSTORE_COMPACT_INTERVAL].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_LOGSTORE_COMPACT_INTERVAL,
+                config_db_logstore_compact_interval,
+                success);
+
             config_db_password_workfactor =
                 vars[KEY_DB_PASSWORD_WORKFACTOR].as<MG_UnsignedInt>();
             validate_uint(
@@ -558,6 +759,107 @@ namespace config
                 success,
                 MINIMUM_DB_DOCUMENT_LENGTH);
 
+            config_db_read_connections =
+                vars[KEY_DB_READ_CONNECTIONS].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_READ_CONNECTIONS,
+                config_db_read_connections,
+                success);
+
+            config_db_cache_max_site_memory =
+                vars[KEY_DB_CACHE_MAX_SITE_MEMORY].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_CACHE_MAX_SITE_MEMORY,
+                config_db_cache_max_site_memory,
+                success,
+                0);
+
+            config_db_commit_interval =
+                vars[KEY_DB_COMMIT_INTERVAL].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_COMMIT_INTERVAL,
+                config_db_commit_interval,
+                success);
+
+            config_db_commit_max_entities =
+                vars[KEY_DB_COMMIT_MAX_ENTITIES].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_COMMIT_MAX_ENTITIES,
+                config_db_commit_max_entities,
+                success,
+                0);
+
+            config_db_commit_max_memory =
+                vars[KEY_DB_COMMIT_MAX_MEMORY].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_COMMIT_MAX_MEMORY,
+                config_db_commit_max_memory,
+                success,
+                0);
+
+            config_db_durability = vars[KEY_DB_DURABILITY].as<std::string>();
+
+            if ((config_db_durability != "fast") and
+                (config_db_durability != "normal") and
+                (config_db_durability != "full"))
+            {
+                LOG(fatal, "config", "do_parse",
+                    KEY_DB_DURABILITY + " must be fast, normal, or full.");
+                success = false;
+            }
+            else
+            {
+                LOG(info, "config", "do_parse",
+                    KEY_DB_DURABILITY + " set to " + config_db_durability);
+            }
+
+            config_db_backup_file = vars[KEY_DB_BACKUP_FILE].as<std::string>();
+            // Backup file will be created when the first backup is made.
+            validate_file(
+                KEY_DB_BACKUP_FILE,
+                data_dir_prefix,
+                false,
+                config_db_backup_file,
+                success);
+
+            config_db_backup_interval =
+                vars[KEY_DB_BACKUP_INTERVAL].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_BACKUP_INTERVAL,
+                config_db_backup_interval,
+                success,
+                0);
+
+            config_db_backup_pages_per_step =
+                vars[KEY_DB_BACKUP_PAGES_PER_STEP].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_BACKUP_PAGES_PER_STEP,
+                config_db_backup_pages_per_step,
+                success);
+
+            config_db_backup_step_delay =
+                vars[KEY_DB_BACKUP_STEP_DELAY].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_BACKUP_STEP_DELAY,
+                config_db_backup_step_delay,
+                success,
+                0);
+
+            config_db_warmup_entities =
+                vars[KEY_DB_WARMUP_ENTITIES].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_WARMUP_ENTITIES,
+                config_db_warmup_entities,
+                success,
+                0);
+
+            config_db_warmup_threads =
+                vars[KEY_DB_WARMUP_THREADS].as<MG_UnsignedInt>();
+            validate_uint(
+                KEY_DB_WARMUP_THREADS,
+                config_db_warmup_threads,
+                success);
+
             // Angelscript
             //
             config_angel_max_heap = vars[KEY_ANGEL_MAX_HEAP].as<MG_UnsignedInt>();
@@ -832,12 +1134,48 @@ namespace comm
 
 namespace db
 {
+    // ----------------------------------------------------------------------
+    const std::string &backend(void)
+    {
+        return config_db_backend;
+    }
+
     // ----------------------------------------------------------------------
     const std::string &db_file(void)
     {
         return config_db_file;
     }
 
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt site_files(void)
+    {
+        return config_db_site_files;
+    }
+
+    // ----------------------------------------------------------------------
+    const std::string &logstore_directory(void)
+    {
+        return config_db_logstore_directory;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt logstore_segment_size(void)
+    {
+        return config_db_logstore_segment_size;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt logstore_compact_garbage(void)
+    {
+        return config_db_logstore_compact_garbage;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt logstore_compact_interval(void)
+    {
+        return config_db_logstore_compact_interval;
+    }
+
     // ----------------------------------------------------------------------
     MG_UnsignedInt password_workfactor(void)
     {
@@ -885,6 +1223,78 @@ namespace db
     {
         return config_db_limit_program_lines;
     }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt read_connections(void)
+    {
+        return config_db_read_connections;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt cache_max_site_memory(void)
+    {
+        return config_db_cache_max_site_memory;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt commit_interval(void)
+    {
+        return config_db_commit_interval;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt commit_max_entities(void)
+    {
+        return config_db_commit_max_entities;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt commit_max_memory(void)
+    {
+        return config_db_commit_max_memory;
+    }
+
+    // ----------------------------------------------------------------------
+    const std::string &durability(void)
+    {
+        return config_db_durability;
+    }
+
+    // ----------------------------------------------------------------------
+    const std::string &backup_file(void)
+    {
+        return config_db_backup_file;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt backup_interval(void)
+    {
+        return config_db_backup_interval;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt backup_pages_per_step(void)
+    {
+        return config_db_backup_pages_per_step;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt backup_step_delay(void)
+    {
+        return config_db_backup_step_delay;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt warmup_entities(void)
+    {
+        return config_db_warmup_entities;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt warmup_threads(void)
+    {
+        return config_db_warmup_threads;
+    }
 }
 
 namespace angelscript
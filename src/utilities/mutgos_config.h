@@ -136,11 +136,48 @@ namespace config
      */
     namespace db
     {
+        /**
+         * @return Which database backend to use: "sqlite", "memory" for
+         * one that keeps everything in memory and never saves it, or
+         * "logstore" for one that appends everything to log segments.
+         */
+        const std::string &backend(void);
+
         /**
          * @return The database filename, including the path.
          */
         const std::string &db_file(void);
 
+        /**
+         * @return For the sqlite backend, how many database files (besides
+         * db_file) the sites are spread across, so different sites can be
+         * written in parallel.  0 to keep everything in db_file.
+         */
+        MG_UnsignedInt site_files(void);
+
+        /**
+         * @return The directory log store segments are kept in, including
+         * the path.
+         */
+        const std::string &logstore_directory(void);
+
+        /**
+         * @return Size, in kilobytes, a log store segment may grow to
+         * before a new one is started.
+         */
+        MG_UnsignedInt logstore_segment_size(void);
+
+        /**
+         * @return Percentage of a log store segment that must be
+         * superseded or deleted records before it is compacted.
+         */
+        MG_UnsignedInt logstore_compact_garbage(void);
+
+        /**
+         * @return Seconds between checks for log store segments to compact.
+         */
+        MG_UnsignedInt logstore_compact_interval(void);
+
         /**
          * @return The 'work factor' for database password encryption.
          */
@@ -181,6 +218,80 @@ namespace config
          * @return Line limit of program Documents.
          */
         MG_UnsignedInt limits_program_lines(void);
+
+        /**
+         * @return Number of read-only connections to open to the database.
+         * Reads (loading Entities, searches, etc) can run in parallel with
+         * each other and with writes, up to this many at a time.
+         */
+        MG_UnsignedInt read_connections(void);
+
+        /**
+         * @return Approximate maximum memory, in kilobytes, that cached Entities
+         * for a single site may use before unused Entities are evicted.
+         * 0 means no limit.
+         */
+        MG_UnsignedInt cache_max_site_memory(void);
+
+        /**
+         * @return Maximum seconds from the end of one database commit to
+         * the start of the next.
+         */
+        MG_UnsignedInt commit_interval(void);
+
+        /**
+         * @return How many changed Entities may be waiting before they are
+         * committed early.  0 means no limit.
+         */
+        MG_UnsignedInt commit_max_entities(void);
+
+        /**
+         * @return Approximate memory, in kilobytes, of changed Entities that
+         * may be waiting before they are committed early.  0 means no limit.
+         */
+        MG_UnsignedInt commit_max_memory(void);
+
+        /**
+         * @return The durability profile for database commits: "fast",
+         * "normal", or "full".
+         */
+        const std::string &durability(void);
+
+        /**
+         * @return The file online backups are written to, including the
+         * path.
+         */
+        const std::string &backup_file(void);
+
+        /**
+         * @return Minutes between automatic online backups, or 0 for none.
+         */
+        MG_UnsignedInt backup_interval(void);
+
+        /**
+         * @return How many database pages an online backup copies at a
+         * time.
+         */
+        MG_UnsignedInt backup_pages_per_step(void);
+
+        /**
+         * @return Milliseconds an online backup pauses between copying
+         * pages, to let the database get other work done.
+         */
+        MG_UnsignedInt backup_step_delay(void);
+
+        /**
+         * @return How many of the most recently accessed Entities of each
+         * site to load into the cache when the server starts, or 0 for
+         * none.
+         */
+        MG_UnsignedInt warmup_entities(void);
+
+        /**
+         * @return How many threads load Entities into the cache when the
+         * server starts.
+         */
+        MG_UnsignedInt warmup_threads(void);
     }
 
 